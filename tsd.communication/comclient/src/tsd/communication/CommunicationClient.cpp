@@ -594,11 +594,13 @@ bool CommunicationClient::send(std::auto_ptr<tsd::communication::event::TsdEvent
       tsd::common::system::MutexGuard guard(m_SndBufferMux);
 
       do {
-         rpcBuf.init((char*) m_SndBuffer, m_SndBufferSize);
+         rpcBuf.init((char*) m_SndBuffer, m_SndBufferSize * 4u);
          m_Serializer->serialize(rpcBuf, *tsdevent.get());
          if (rpcBuf.didOverflow()) {
+            // grow to the exact size if the event knows it, double otherwise
+            uint32_t needed = (m_Serializer->serializedSize(*tsdevent.get()) + 3u) / 4u;
             delete [] m_SndBuffer;
-            m_SndBufferSize *= 2;
+            m_SndBufferSize = (needed > m_SndBufferSize) ? needed : m_SndBufferSize * 2;
             m_SndBuffer = new uint32_t[m_SndBufferSize];
          }
       } while (rpcBuf.didOverflow());
@@ -48,6 +48,15 @@ void TsdEventSerializer::serialize(tsd::common::ipc::RpcBuffer& buf, const tsd::
    obj.serialize(buf);
 }
 
+uint32_t TsdEventSerializer::serializedSize(const tsd::communication::event::TsdEvent& obj)
+{
+   uint32_t size = obj.serializedSize();
+   if (size == 0U) {
+      return 0U;
+   }
+   return tsd::communication::event::serializedSizeOf(obj.getEventId()) + size;
+}
+
 std::auto_ptr<tsd::communication::event::TsdEvent> TsdEventSerializer::deserialize(tsd::common::ipc::RpcBuffer& buf)
 {
    std::auto_ptr<event::TsdEvent> ret;
@@ -55,6 +55,12 @@ public:
    //! \param object [in]  Object to serialize
    virtual void serialize(common::ipc::RpcBuffer& buf, const event::TsdEvent& obj);
 
+   //! Get the number of bytes that serialize() writes for an object
+   //! \param object [in]  Object to serialize
+   //! return             Size of the serialized object including its header,
+   //!                    0 if the event does not know its size
+   uint32_t serializedSize(const event::TsdEvent& obj);
+
    //! Deserialize object from buffer.
    //! \param buffer [in] Buffer containing serialized object
    //! return             Deserialized object
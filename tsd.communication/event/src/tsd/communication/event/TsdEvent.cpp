@@ -29,6 +29,13 @@ void TsdEvent::serialize(tsd::common::ipc::RpcBuffer& /*buf*/) const
    //buf << m_EventId;
 }
 
+//! virtual function to get the number of bytes that serialize() writes
+//! @return 0, the size of an arbitrary event is not known
+uint32_t TsdEvent::serializedSize(void) const
+{
+   return 0U;
+}
+
 //! virtual function to deserialize object data from given buffer
 //! @param[out] buf Buffer with serialized data
 void TsdEvent::deserialize(tsd::common::ipc::RpcBuffer& /*buf*/)
@@ -51,6 +51,11 @@ public:
    //! @param[in] buf Buffer to store serializes data
    virtual void serialize(tsd::common::ipc::RpcBuffer& buf) const;
 
+   //! virtual function to get the number of bytes that serialize() writes
+   //! Events that know their size without serializing should override it.
+   //! @return exact size of the serialized data, 0 if it is not known
+   virtual uint32_t serializedSize(void) const;
+
    //! virtual function to deserialize object data from given buffer
    //! @param[out] buf Buffer with serialized data
    virtual void deserialize(tsd::common::ipc::RpcBuffer& buf);
@@ -82,6 +87,72 @@ private:
 TSD_COMMUNICATION_EVENT_DLLEXPORT tsd::common::ipc::RpcBuffer& operator<<(tsd::common::ipc::RpcBuffer& buffer, const tsd::communication::event::TsdEvent& event);
 TSD_COMMUNICATION_EVENT_DLLEXPORT tsd::common::ipc::RpcBuffer& operator>>(tsd::common::ipc::RpcBuffer& buffer, tsd::communication::event::TsdEvent& event);
 
+//! number of bytes that the streaming operator writes for a value of type T
+//! Only types with a fixed size know it, get() returns 0 for all others.
+template <class T>
+struct SerializedSize
+{
+   static inline uint32_t get(const T& /*value*/) { return 0U; }
+};
+
+//! base of the SerializedSize specialisations for types with a fixed size
+//! The size is counted once per type by streaming a default value.
+template <class T>
+struct FixedSerializedSize
+{
+   static inline uint32_t get(const T& /*value*/)
+   {
+      static const uint32_t size = count();
+      return size;
+   }
+
+private:
+   static uint32_t count(void)
+   {
+      char scratch[32];
+      tsd::common::ipc::RpcBuffer buf;
+      buf.init(scratch, sizeof(scratch));
+      buf << T();
+      return buf.didOverflow() ? 0U : static_cast<uint32_t>(buf.getSize());
+   }
+};
+
+template <> struct SerializedSize<bool> : FixedSerializedSize<bool> { };
+template <> struct SerializedSize<char> : FixedSerializedSize<char> { };
+template <> struct SerializedSize<signed char> : FixedSerializedSize<signed char> { };
+template <> struct SerializedSize<unsigned char> : FixedSerializedSize<unsigned char> { };
+template <> struct SerializedSize<short> : FixedSerializedSize<short> { };
+template <> struct SerializedSize<unsigned short> : FixedSerializedSize<unsigned short> { };
+template <> struct SerializedSize<int> : FixedSerializedSize<int> { };
+template <> struct SerializedSize<unsigned int> : FixedSerializedSize<unsigned int> { };
+template <> struct SerializedSize<long> : FixedSerializedSize<long> { };
+template <> struct SerializedSize<unsigned long> : FixedSerializedSize<unsigned long> { };
+template <> struct SerializedSize<long long> : FixedSerializedSize<long long> { };
+template <> struct SerializedSize<unsigned long long> : FixedSerializedSize<unsigned long long> { };
+template <> struct SerializedSize<float> : FixedSerializedSize<float> { };
+template <> struct SerializedSize<double> : FixedSerializedSize<double> { };
+
+//! get the number of bytes that the streaming operator writes for a value
+//! @param[in] value value to measure
+//! @return exact size of the serialized value, 0 if it is not known
+template <class T>
+inline uint32_t serializedSizeOf(const T& value)
+{
+   return SerializedSize<T>::get(value);
+}
+
+//! add the serialized size of a value to a running total
+//! @param[in,out] total sum of the sizes so far
+//! @param[in] value value to measure
+//! @return false if the size of the value is not known
+template <class T>
+inline bool addSerializedSize(uint32_t& total, const T& value)
+{
+   uint32_t size = SerializedSize<T>::get(value);
+   total += size;
+   return size != 0U;
+}
+
 } /* namespace event */} /* namespace communication */ } /* namespace tsd */
 
 
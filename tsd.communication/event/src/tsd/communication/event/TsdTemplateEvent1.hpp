@@ -28,6 +28,10 @@ public:
    //! @param[in] buf Buffer to store serializes data
    virtual void serialize(tsd::common::ipc::RpcBuffer& buf) const;
 
+   //! virtual function to get the number of bytes that serialize() writes
+   //! @return sum of the serialized sizes of the data elements, 0 if one is not known
+   virtual uint32_t serializedSize(void) const;
+
    //! virtual function to deserialize object data from given buffer
    //! @param[out] buf Buffer with serialized data
    virtual void deserialize(tsd::common::ipc::RpcBuffer& buf);
@@ -63,6 +67,12 @@ void TsdTemplateEvent1<T1>::serialize(tsd::common::ipc::RpcBuffer& buf) const
    buf << m_Data1;
 }
 
+template <class T1>
+uint32_t TsdTemplateEvent1<T1>::serializedSize(void) const
+{
+   return serializedSizeOf(m_Data1);
+}
+
 template <class T1>
 void TsdTemplateEvent1<T1>::deserialize(tsd::common::ipc::RpcBuffer& buf)
 {
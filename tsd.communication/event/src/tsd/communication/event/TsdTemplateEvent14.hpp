@@ -46,6 +46,10 @@ public:
    //! @param[in] buf Buffer to store serializes data
    virtual void serialize(tsd::common::ipc::RpcBuffer& buf) const;
 
+   //! virtual function to get the number of bytes that serialize() writes
+   //! @return sum of the serialized sizes of the data elements, 0 if one is not known
+   virtual uint32_t serializedSize(void) const;
+
    //! virtual function to deserialize object data from given buffer
    //! @param[out] buf Buffer with serialized data
    virtual void deserialize(tsd::common::ipc::RpcBuffer& buf);
@@ -199,6 +203,27 @@ void TsdTemplateEvent14<T1, T2, T3, T4, T5, T6, T7, T8, T9, T10, T11, T12, T13,
    buf << m_Data14;
 }
 
+template <class T1, class T2, class T3, class T4, class T5, class T6, class T7, class T8, class T9, class T10, class T11, class T12, class T13, class T14>
+uint32_t TsdTemplateEvent14<T1, T2, T3, T4, T5, T6, T7, T8, T9, T10, T11, T12, T13, T14>::serializedSize(void) const
+{
+   uint32_t size = 0U;
+   bool known = addSerializedSize(size, m_Data1)
+             && addSerializedSize(size, m_Data2)
+             && addSerializedSize(size, m_Data3)
+             && addSerializedSize(size, m_Data4)
+             && addSerializedSize(size, m_Data5)
+             && addSerializedSize(size, m_Data6)
+             && addSerializedSize(size, m_Data7)
+             && addSerializedSize(size, m_Data8)
+             && addSerializedSize(size, m_Data9)
+             && addSerializedSize(size, m_Data10)
+             && addSerializedSize(size, m_Data11)
+             && addSerializedSize(size, m_Data12)
+             && addSerializedSize(size, m_Data13)
+             && addSerializedSize(size, m_Data14);
+   return known ? size : 0U;
+}
+
 template <class T1, class T2, class T3, class T4, class T5, class T6, class T7, class T8, class T9, class T10, class T11, class T12, class T13, class T14>
 void TsdTemplateEvent14<T1, T2, T3, T4, T5, T6, T7, T8, T9, T10, T11, T12, T13, T14>::deserialize(tsd::common::ipc::RpcBuffer& buf)
 {
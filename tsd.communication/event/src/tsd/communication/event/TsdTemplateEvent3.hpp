@@ -30,6 +30,10 @@ public:
    //! @param[in] buf Buffer to store serializes data
    virtual void serialize(tsd::common::ipc::RpcBuffer& buf) const;
 
+   //! virtual function to get the number of bytes that serialize() writes
+   //! @return sum of the serialized sizes of the data elements, 0 if one is not known
+   virtual uint32_t serializedSize(void) const;
+
    //! virtual function to deserialize object data from given buffer
    //! @param[out] buf Buffer with serialized data
    virtual void deserialize(tsd::common::ipc::RpcBuffer& buf);
@@ -79,6 +83,16 @@ void TsdTemplateEvent3<T1, T2, T3>::serialize(tsd::common::ipc::RpcBuffer& buf)
    buf << m_Data3;
 }
 
+template <class T1, class T2, class T3>
+uint32_t TsdTemplateEvent3<T1, T2, T3>::serializedSize(void) const
+{
+   uint32_t size = 0U;
+   bool known = addSerializedSize(size, m_Data1)
+             && addSerializedSize(size, m_Data2)
+             && addSerializedSize(size, m_Data3);
+   return known ? size : 0U;
+}
+
 template <class T1, class T2, class T3>
 void TsdTemplateEvent3<T1, T2, T3>::deserialize(tsd::common::ipc::RpcBuffer& buf)
 {
@@ -33,6 +33,10 @@ public:
    //! @param[in] buf Buffer to store serializes data
    virtual void serialize(tsd::common::ipc::RpcBuffer& buf) const;
 
+   //! virtual function to get the number of bytes that serialize() writes
+   //! @return sum of the serialized sizes of the data elements, 0 if one is not known
+   virtual uint32_t serializedSize(void) const;
+
    //! virtual function to deserialize object data from given buffer
    //! @param[out] buf Buffer with serialized data
    virtual void deserialize(tsd::common::ipc::RpcBuffer& buf);
@@ -103,6 +107,19 @@ void TsdTemplateEvent6<T1, T2, T3, T4, T5, T6>::serialize(tsd::common::ipc::RpcB
    buf << m_Data6;
 }
 
+template <class T1, class T2, class T3, class T4, class T5, class T6>
+uint32_t TsdTemplateEvent6<T1, T2, T3, T4, T5, T6>::serializedSize(void) const
+{
+   uint32_t size = 0U;
+   bool known = addSerializedSize(size, m_Data1)
+             && addSerializedSize(size, m_Data2)
+             && addSerializedSize(size, m_Data3)
+             && addSerializedSize(size, m_Data4)
+             && addSerializedSize(size, m_Data5)
+             && addSerializedSize(size, m_Data6);
+   return known ? size : 0U;
+}
+
 template <class T1, class T2, class T3, class T4, class T5, class T6>
 void TsdTemplateEvent6<T1, T2, T3, T4, T5, T6>::deserialize(tsd::common::ipc::RpcBuffer& buf)
 {
@@ -44,6 +44,11 @@ void TsdEventTest::test_Deserialize_JustRun_NothingHappens()
    CPPUNIT_ASSERT_NO_THROW_MESSAGE("Deserialize is empty method", m_TestObj->deserialize(rpcBuffer));
 }
 
+void TsdEventTest::test_SerializedSize_JustRun_ZeroReturned()
+{
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Empty event is not expected to have a size", 0U, m_TestObj->serializedSize());
+}
+
 void TsdEventTest::test_Clone_JustRun_ClonedObjectReturned()
 {
    constexpr IfcAddr_t       sender(1U);
@@ -48,6 +48,13 @@ public:
     * @tsd_testexpected nothing happens
     */
    void test_Deserialize_JustRun_NothingHappens();
+   /**
+    * @brief Test scenario: just run
+    *
+    * @tsd_testobject tsd::communication::event::TsdEvent::SerializedSize
+    * @tsd_testexpected zero returned
+    */
+   void test_SerializedSize_JustRun_ZeroReturned();
    /**
     * @brief Test scenario: just run
     *
@@ -83,6 +90,7 @@ private:
    CPPUNIT_TEST_SUITE(TsdEventTest);
    CPPUNIT_TEST(test_Serialize_JustRun_NothingHappens);
    CPPUNIT_TEST(test_Deserialize_JustRun_NothingHappens);
+   CPPUNIT_TEST(test_SerializedSize_JustRun_ZeroReturned);
    CPPUNIT_TEST(test_Clone_JustRun_ClonedObjectReturned);
    CPPUNIT_TEST(test_GetEventId_JustRun_EventIdReturned);
    CPPUNIT_TEST(test_SetSenderAddr_SetNewAddress_AddressSet);
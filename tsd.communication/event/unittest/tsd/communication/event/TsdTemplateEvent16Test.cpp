@@ -147,6 +147,38 @@ void TsdTemplateEvent16Test::test_Serialize_SerializeAndDeserializeData_DataDese
    CPPUNIT_ASSERT_EQUAL_MESSAGE("Failed to serialize/deserialize data 16", actualResult.getData16(), testObj.getData16());
 }
 
+void TsdTemplateEvent16Test::test_SerializedSize_ComparedWithSerializedData_LengthReturned()
+{
+   constexpr size_t            size = 100;
+   char                        buffer[size]{0};
+   const uint32_t              expectedValues[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 0xffffffffU};
+   tsd::common::ipc::RpcBuffer rpcBuffer;
+   Uint32TsdTemplateEvent16    testObj(EVENT_ID,
+                                    expectedValues[0],
+                                    expectedValues[1],
+                                    expectedValues[2],
+                                    expectedValues[3],
+                                    expectedValues[4],
+                                    expectedValues[5],
+                                    expectedValues[6],
+                                    expectedValues[7],
+                                    expectedValues[8],
+                                    expectedValues[9],
+                                    expectedValues[10],
+                                    expectedValues[11],
+                                    expectedValues[12],
+                                    expectedValues[13],
+                                    expectedValues[14],
+                                    expectedValues[15]);
+
+   rpcBuffer.init(buffer, size);
+
+   testObj.serialize(rpcBuffer);
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Serialized size is not as expected", static_cast<uint32_t>(rpcBuffer.getSize()),
+                                testObj.serializedSize());
+}
+
 void TsdTemplateEvent16Test::test_Clone_JustRun_ClonedObjectReturned()
 {
    const uint32_t                            expectedValues[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
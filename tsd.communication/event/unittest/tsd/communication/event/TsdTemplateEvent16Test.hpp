@@ -45,6 +45,13 @@ public:
     * @tsd_testexpected data deserialized
     */
    void test_Serialize_SerializeAndDeserializeData_DataDeserialized();
+   /**
+    * @brief Test scenario: compared with serialized data
+    *
+    * @tsd_testobject tsd::communication::event::TsdTemplateEvent16::SerializedSize
+    * @tsd_testexpected length of serialized data returned
+    */
+   void test_SerializedSize_ComparedWithSerializedData_LengthReturned();
    /**
     * @brief Test scenario: just run
     *
@@ -169,6 +176,7 @@ public:
    CPPUNIT_TEST(test_Constructor_WithEventid_ObjectCreated);
    CPPUNIT_TEST(test_Constructor_WithEventidAndValues_ObjectCreated);
    CPPUNIT_TEST(test_Serialize_SerializeAndDeserializeData_DataDeserialized);
+   CPPUNIT_TEST(test_SerializedSize_ComparedWithSerializedData_LengthReturned);
    CPPUNIT_TEST(test_Clone_JustRun_ClonedObjectReturned);
    CPPUNIT_TEST(test_SetData1_SetNewValue_NewValueSet);
    CPPUNIT_TEST(test_SetData2_SetNewValue_NewValueSet);
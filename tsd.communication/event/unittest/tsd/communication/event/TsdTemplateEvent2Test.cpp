@@ -10,6 +10,8 @@
 #include "TsdTemplateEvent2Test.hpp"
 #include <tsd/communication/event/TsdTemplateEvent2.hpp>
 
+#include <string>
+
 namespace tsd {
 namespace communication {
 namespace event {
@@ -56,6 +58,28 @@ void TsdTemplateEvent2Test::test_Serialize_SerializeAndDeserializeData_DataDeser
    CPPUNIT_ASSERT_EQUAL_MESSAGE("Failed to serialize/deserialize data 2", actualResult.getData2(), testObj.getData2());
 }
 
+void TsdTemplateEvent2Test::test_SerializedSize_ComparedWithSerializedData_LengthReturned()
+{
+   constexpr size_t            size = 100;
+   char                        buffer[size]{0};
+   const uint32_t              expectedValues[] = {0, 0xffffffffU};
+   tsd::common::ipc::RpcBuffer rpcBuffer;
+   Uint32TsdTemplateEvent2     testObj(EVENT_ID, expectedValues[0], expectedValues[1]);
+   rpcBuffer.init(buffer, size);
+
+   testObj.serialize(rpcBuffer);
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Serialized size is not as expected", static_cast<uint32_t>(rpcBuffer.getSize()),
+                                testObj.serializedSize());
+}
+
+void TsdTemplateEvent2Test::test_SerializedSize_DataOfUnknownSize_ZeroReturned()
+{
+   TsdTemplateEvent2<uint32_t, std::string> testObj(EVENT_ID, 1U, "data");
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Size of a string is not expected to be known", 0U, testObj.serializedSize());
+}
+
 void TsdTemplateEvent2Test::test_Clone_JustRun_ClonedObjectReturned()
 {
    const uint32_t                           expectedValues[] = {0, 1};
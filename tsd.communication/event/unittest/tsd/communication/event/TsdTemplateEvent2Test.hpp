@@ -45,6 +45,20 @@ public:
     * @tsd_testexpected data deserialized
     */
    void test_Serialize_SerializeAndDeserializeData_DataDeserialized();
+   /**
+    * @brief Test scenario: compared with serialized data
+    *
+    * @tsd_testobject tsd::communication::event::TsdTemplateEvent2::SerializedSize
+    * @tsd_testexpected length of serialized data returned
+    */
+   void test_SerializedSize_ComparedWithSerializedData_LengthReturned();
+   /**
+    * @brief Test scenario: data of unknown size
+    *
+    * @tsd_testobject tsd::communication::event::TsdTemplateEvent2::SerializedSize
+    * @tsd_testexpected zero returned
+    */
+   void test_SerializedSize_DataOfUnknownSize_ZeroReturned();
    /**
     * @brief Test scenario: just run
     *
@@ -71,6 +85,8 @@ public:
    CPPUNIT_TEST(test_Constructor_WithEventid_ObjectCreated);
    CPPUNIT_TEST(test_Constructor_WithEventIdAndValues_ObjectCreated);
    CPPUNIT_TEST(test_Serialize_SerializeAndDeserializeData_DataDeserialized);
+   CPPUNIT_TEST(test_SerializedSize_ComparedWithSerializedData_LengthReturned);
+   CPPUNIT_TEST(test_SerializedSize_DataOfUnknownSize_ZeroReturned);
    CPPUNIT_TEST(test_Clone_JustRun_ClonedObjectReturned);
    CPPUNIT_TEST(test_SetData1_SetNewValue_NewValueSet);
    CPPUNIT_TEST(test_SetData2_SetNewValue_NewValueSet);
@@ -0,0 +1,735 @@
+/**
+ * Bytes on the wire benchmark.
+ *
+ * Replays a traffic mix over a TCP connection once with the fixed packet
+ * header and once with the compact one and counts the bytes in both
+ * directions. Optionally a third run compresses the payloads, too. A service
+ * process listens on the server transport. A client process connects to it
+ * through a TCP relay that is run by the benchmark itself and counts the
+ * traffic.
+ *
+ * The mix is a list of message classes with their share of the traffic:
+ *
+ *    # state broadcasts of the service: ind SIZE WEIGHT
+ *    ind 4 30
+ *    # requests of the client and replies of the service: req SIZE REPLY WEIGHT
+ *    req 32 128 10
+ *
+ * SIZE is the length of the serialized message payload. Both processes draw
+ * the same message sequence from the mix. Without a mix file a built-in
+ * default is used.
+ */
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <tsd/communication/messaging/ConnectionException.hpp>
+#include <tsd/communication/messaging/Connection.hpp>
+#include <tsd/communication/messaging/Queue.hpp>
+
+using namespace tsd::communication::event;
+using namespace tsd::communication::messaging;
+
+namespace {
+
+const uint32_t STATE_IND = 1;
+const uint32_t DATA_REQ = 2;
+const uint32_t DATA_REPLY = 3;
+const uint32_t START_REQ = 4;
+
+/*
+ * Payload that resembles serialized records, e.g. a route list, so that
+ * compression behaves roughly like on real traffic.
+ */
+std::string makePayload(size_t size)
+{
+   static std::string pattern;
+   if (pattern.empty()) {
+      for (unsigned long i = 0; pattern.size() < 65536u; i++) {
+         std::stringstream rec;
+         rec << "{id:" << i << ",name:\"segment " << (i * 7919u) % 1000u
+             << "\",lat:48." << (i * 104729u) % 10000u
+             << ",lon:11." << (i * 1299709u) % 10000u << "}";
+         pattern += rec.str();
+      }
+   }
+
+   std::string ret;
+   while (ret.size() < size) {
+      ret += pattern.substr(0, size - ret.size());
+   }
+   return ret;
+}
+
+/*
+ * All messages carry an opaque payload. The sizes include the length prefix
+ * of the serialized string.
+ */
+class DataMsg
+   : public TsdEvent
+{
+   std::string m_data;
+   uint32_t m_reply;
+
+public:
+   DataMsg(uint32_t id, size_t size = 0, uint32_t reply = 0)
+      : TsdEvent(id)
+      , m_data(makePayload(size > sizeof(uint32_t) ? size - sizeof(uint32_t) : 0))
+      , m_reply(reply)
+   { }
+
+   void serialize(tsd::common::ipc::RpcBuffer& buf) const
+   {
+      buf << m_data;
+      if (getEventId() == DATA_REQ) {
+         buf << m_reply;
+      }
+   }
+
+   void deserialize(tsd::common::ipc::RpcBuffer& buf)
+   {
+      buf >> m_data;
+      if (getEventId() == DATA_REQ) {
+         buf >> m_reply;
+      }
+   }
+
+   TsdEvent* clone(void) const
+   {
+      DataMsg *ret = new DataMsg(getEventId());
+      ret->m_data = m_data;
+      ret->m_reply = m_reply;
+      return ret;
+   }
+
+   inline uint32_t getReplySize() const { return m_reply; }
+};
+
+class DataFactory
+   : public IMessageFactory
+{
+public:
+   std::auto_ptr<TsdEvent> createEvent(uint32_t msgId) const
+   {
+      std::auto_ptr<TsdEvent> ret;
+      switch (msgId) {
+         case STATE_IND:
+         case DATA_REQ:
+         case DATA_REPLY:
+         case START_REQ:
+            ret.reset(new DataMsg(msgId));
+            break;
+      }
+      return ret;
+   }
+
+   static IMessageFactory& getInstance()
+   {
+      static DataFactory factory;
+      return factory;
+   }
+};
+
+const char SERVICE_NAME[] = "header-bench-service";
+
+/*****************************************************************************/
+
+struct MixEntry
+{
+   bool m_request;
+   uint32_t m_size;
+   uint32_t m_reply;
+   unsigned long m_weight;
+};
+
+typedef std::vector<MixEntry> Mix;
+
+/*
+ * Built-in mix: mostly small state broadcasts with some request/reply pairs
+ * and a few bulk transfers.
+ */
+const char DEFAULT_MIX[] =
+   "ind 4 30\n"
+   "ind 16 25\n"
+   "ind 64 12\n"
+   "ind 512 3\n"
+   "req 8 8 15\n"
+   "req 32 128 10\n"
+   "req 256 2048 5\n";
+
+bool parseMix(std::istream &in, Mix &mix)
+{
+   std::string line;
+   while (std::getline(in, line)) {
+      std::istringstream fields(line);
+      std::string kind;
+      if (!(fields >> kind) || kind[0] == '#') {
+         continue;
+      }
+
+      MixEntry entry = { false, 0, 0, 0 };
+      if (kind == "ind") {
+         fields >> entry.m_size >> entry.m_weight;
+      } else if (kind == "req") {
+         entry.m_request = true;
+         fields >> entry.m_size >> entry.m_reply >> entry.m_weight;
+      } else {
+         return false;
+      }
+      if (fields.fail()) {
+         return false;
+      }
+      mix.push_back(entry);
+   }
+
+   return !mix.empty();
+}
+
+bool loadMix(const std::string &file, Mix &mix)
+{
+   if (file == "-") {
+      std::istringstream in(DEFAULT_MIX);
+      return parseMix(in, mix);
+   }
+
+   std::ifstream in(file.c_str());
+   return in && parseMix(in, mix);
+}
+
+/**
+ * Deterministic message sequence of a mix.
+ */
+class MixSequence
+{
+   const Mix &m_mix;
+   unsigned long m_total;
+   uint32_t m_state;
+
+public:
+   MixSequence(const Mix &mix)
+      : m_mix(mix)
+      , m_total(0)
+      , m_state(12345)
+   {
+      for (Mix::const_iterator it(mix.begin()); it != mix.end(); ++it) {
+         m_total += it->m_weight;
+      }
+   }
+
+   const MixEntry& next()
+   {
+      m_state = m_state * 1103515245u + 12345u;
+      unsigned long pick = (m_state >> 8) % m_total;
+      Mix::const_iterator it(m_mix.begin());
+      while (pick >= it->m_weight) {
+         pick -= it->m_weight;
+         ++it;
+      }
+      return *it;
+   }
+};
+
+/*****************************************************************************/
+
+/**
+ * Answer the requests of the client and broadcast the state messages of the
+ * mix when the client asks for it.
+ */
+int runService(const std::string &url, const Mix &mix, unsigned long count)
+{
+   std::auto_ptr<IConnection> conn;
+   try {
+      conn.reset(listenDownstream(url));
+   } catch (ConnectionException &e) {
+      std::cerr << "Listen failed: " << e.what() << &std::endl;
+      return 1;
+   }
+
+   std::auto_ptr<IQueue> queue(createQueue("header-bench-service"));
+   ILocalIfc *ifc = queue->registerInterface(DataFactory::getInstance(), SERVICE_NAME);
+
+   std::cout << "ready" << &std::endl;
+
+   for (;;) {
+      std::auto_ptr<TsdEvent> msg = queue->readMessage();
+      DataMsg *data = dynamic_cast<DataMsg*>(msg.get());
+      if (data == NULL) {
+         continue;
+      }
+
+      if (msg->getEventId() == DATA_REQ) {
+         ifc->sendMessage(msg->getSenderAddr(), std::auto_ptr<TsdEvent>(
+            new DataMsg(DATA_REPLY, data->getReplySize())));
+      } else if (msg->getEventId() == START_REQ) {
+         MixSequence seq(mix);
+         for (unsigned long i = 0; i < count; i++) {
+            const MixEntry &entry = seq.next();
+            if (!entry.m_request) {
+               ifc->broadcastMessage(std::auto_ptr<TsdEvent>(new DataMsg(STATE_IND, entry.m_size)));
+            }
+         }
+      }
+   }
+}
+
+/**
+ * Send the requests of the mix with at most @p window outstanding replies and
+ * wait until all replies and broadcasts have arrived.
+ */
+int runClient(const std::string &url, const Mix &mix, unsigned long count,
+              unsigned long window)
+{
+   std::auto_ptr<IConnection> conn;
+   try {
+      conn.reset(connectUpstream(url));
+   } catch (ConnectionException &e) {
+      std::cerr << "Connect failed: " << e.what() << &std::endl;
+      return 1;
+   }
+
+   std::auto_ptr<IQueue> queue(createQueue("header-bench-client"));
+   std::auto_ptr<IRemoteIfc> ifc(queue->connectInterface(SERVICE_NAME,
+      DataFactory::getInstance(), 5000));
+   if (ifc.get() == NULL) {
+      std::cerr << "Service not found" << &std::endl;
+      return 2;
+   }
+   ifc->subscribe(STATE_IND);
+
+   // split the sequence
+   std::vector<const MixEntry*> requests;
+   unsigned long pendingInds = 0;
+   MixSequence seq(mix);
+   for (unsigned long i = 0; i < count; i++) {
+      const MixEntry &entry = seq.next();
+      if (entry.m_request) {
+         requests.push_back(&entry);
+      } else {
+         pendingInds++;
+      }
+   }
+
+   ifc->sendMessage(std::auto_ptr<TsdEvent>(new DataMsg(START_REQ)));
+
+   size_t sent = 0;
+   unsigned long pendingReplies = requests.size();
+   while (sent < requests.size() && sent < window) {
+      ifc->sendMessage(std::auto_ptr<TsdEvent>(new DataMsg(DATA_REQ,
+         requests[sent]->m_size, requests[sent]->m_reply)));
+      sent++;
+   }
+
+   while (pendingReplies > 0 || pendingInds > 0) {
+      std::auto_ptr<TsdEvent> msg = queue->readMessage(10000);
+      if (msg.get() == NULL) {
+         std::cerr << "Lost " << pendingReplies << " replies and "
+                   << pendingInds << " broadcasts" << &std::endl;
+         return 3;
+      }
+
+      if (msg->getEventId() == STATE_IND) {
+         pendingInds--;
+      } else if (msg->getEventId() == DATA_REPLY) {
+         pendingReplies--;
+         if (sent < requests.size()) {
+            ifc->sendMessage(std::auto_ptr<TsdEvent>(new DataMsg(DATA_REQ,
+               requests[sent]->m_size, requests[sent]->m_reply)));
+            sent++;
+         }
+      }
+   }
+
+   std::cout << "done " << (count + requests.size()) << &std::endl;
+   return 0;
+}
+
+/*****************************************************************************/
+
+/**
+ * TCP relay between the client and the service that counts the bytes.
+ */
+class Relay
+{
+   int m_listen;
+   int m_client;
+   int m_server;
+   struct sockaddr_in m_target;
+   unsigned long long m_upstream;
+   unsigned long long m_downstream;
+
+   bool forward(int from, int to, unsigned long long &counter)
+   {
+      char buf[65536];
+      ssize_t len = ::read(from, buf, sizeof(buf));
+      if (len <= 0) {
+         return false;
+      }
+
+      counter += static_cast<unsigned long long>(len);
+      for (ssize_t done = 0; done < len; ) {
+         ssize_t ret = ::write(to, buf + done, len - done);
+         if (ret <= 0) {
+            return false;
+         }
+         done += ret;
+      }
+
+      return true;
+   }
+
+   void drop()
+   {
+      if (m_client >= 0) {
+         ::close(m_client);
+         m_client = -1;
+      }
+      if (m_server >= 0) {
+         ::close(m_server);
+         m_server = -1;
+      }
+   }
+
+public:
+   Relay(uint16_t targetPort)
+      : m_listen(-1)
+      , m_client(-1)
+      , m_server(-1)
+      , m_upstream(0)
+      , m_downstream(0)
+   {
+      std::memset(&m_target, 0, sizeof(m_target));
+      m_target.sin_family = AF_INET;
+      m_target.sin_port = htons(targetPort);
+      m_target.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   }
+
+   ~Relay()
+   {
+      drop();
+      if (m_listen >= 0) {
+         ::close(m_listen);
+      }
+   }
+
+   bool open(uint16_t port)
+   {
+      m_listen = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      if (m_listen < 0) {
+         return false;
+      }
+
+      int one = 1;
+      ::setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+      struct sockaddr_in addr;
+      std::memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(port);
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      return ::bind(m_listen, (struct sockaddr *) &addr, sizeof(addr)) == 0 &&
+             ::listen(m_listen, 1) == 0;
+   }
+
+   /**
+    * Forget the current connection and reset the counters.
+    */
+   void reset()
+   {
+      drop();
+      m_upstream = m_downstream = 0;
+   }
+
+   inline unsigned long long getUpstream() const { return m_upstream; }
+   inline unsigned long long getDownstream() const { return m_downstream; }
+
+   /**
+    * Shuffle data for up to @p timeout ms or until @p fd is readable.
+    *
+    * @return True if @p fd is readable
+    */
+   bool poll(int fd, int timeout)
+   {
+      struct pollfd fds[4] = {
+         { fd, POLLIN, 0 },
+         { m_listen, POLLIN, 0 },
+         { m_client, POLLIN, 0 },
+         { m_server, POLLIN, 0 },
+      };
+
+      if (::poll(fds, 4, timeout) <= 0) {
+         return false;
+      }
+
+      if (fds[1].revents != 0 && m_client < 0) {
+         m_client = ::accept4(m_listen, NULL, NULL, SOCK_CLOEXEC);
+         m_server = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+         if (m_client >= 0 && m_server >= 0 &&
+             ::connect(m_server, (struct sockaddr *) &m_target, sizeof(m_target)) == 0) {
+            int one = 1;
+            ::setsockopt(m_client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            ::setsockopt(m_server, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+         } else {
+            drop();
+         }
+      }
+
+      bool alive = true;
+      if (fds[2].revents != 0 && m_client >= 0) {
+         alive = forward(m_client, m_server, m_upstream);
+      }
+      if (alive && fds[3].revents != 0 && m_server >= 0) {
+         alive = forward(m_server, m_client, m_downstream);
+      }
+      if (!alive) {
+         drop();
+      }
+
+      return fds[0].revents != 0;
+   }
+};
+
+struct Child
+{
+   pid_t m_pid;
+   FILE *m_output;
+};
+
+/**
+ * Start another instance of this program in the given @p mode.
+ *
+ * @return Child process or m_pid == -1 on error
+ */
+Child spawn(const char *mode, const std::string &url, const std::string &mixFile,
+            unsigned long count, unsigned long window)
+{
+   Child ret = { -1, NULL };
+
+   std::stringstream countStr, windowStr;
+   countStr << count;
+   windowStr << window;
+   std::string countArg(countStr.str()), windowArg(windowStr.str());
+
+   int out[2];
+   if (::pipe(out) < 0) {
+      return ret;
+   }
+
+   ret.m_pid = ::fork();
+   if (ret.m_pid == 0) {
+      ::dup2(out[1], STDOUT_FILENO);
+      ::close(out[0]);
+      ::close(out[1]);
+
+      const char *argv[] = { "header-bench", "-x", mode, url.c_str(),
+         mixFile.c_str(), countArg.c_str(), windowArg.c_str(), NULL };
+      ::execv("/proc/self/exe", const_cast<char * const *>(argv));
+      ::_exit(127);
+   }
+
+   ::close(out[1]);
+   if (ret.m_pid < 0) {
+      ::close(out[0]);
+   } else {
+      ret.m_output = ::fdopen(out[0], "r");
+   }
+
+   return ret;
+}
+
+void reap(Child &child, bool kill)
+{
+   if (child.m_pid <= 0) {
+      return;
+   }
+
+   if (kill) {
+      ::kill(child.m_pid, SIGTERM);
+   }
+   int status = 0;
+   ::waitpid(child.m_pid, &status, 0);
+   if (child.m_output != NULL) {
+      ::fclose(child.m_output);
+   }
+   child.m_pid = -1;
+}
+
+/**
+ * Keep the relay going until the child printed a line or exited.
+ */
+bool readLine(Relay &relay, Child &child, std::string &line)
+{
+   line.clear();
+
+   for (;;) {
+      if (!relay.poll(::fileno(child.m_output), 1000)) {
+         continue;
+      }
+
+      char c;
+      if (::read(::fileno(child.m_output), &c, 1) != 1) {
+         return false;
+      }
+      if (c == '\n') {
+         return true;
+      }
+      line += c;
+   }
+}
+
+/**
+ * Replay the mix with the URL @p options and print the traffic.
+ */
+bool runMode(const char *header, const std::string &options, uint16_t port,
+             const std::string &mixFile, unsigned long count, unsigned long window)
+{
+   std::stringstream serviceUrl, clientUrl;
+   serviceUrl << "tcp://127.0.0.1:" << port << "?" << options;
+   clientUrl << "tcp://127.0.0.1:" << (port + 1) << "?" << options;
+
+   Relay relay(port);
+   if (!relay.open(static_cast<uint16_t>(port + 1))) {
+      std::cerr << "Cannot open relay" << &std::endl;
+      return false;
+   }
+
+   std::string line;
+   Child service = spawn("service", serviceUrl.str(), mixFile, count, window);
+   if (service.m_pid < 0 || !readLine(relay, service, line) || line != "ready") {
+      std::cerr << header << ": service did not start" << &std::endl;
+      reap(service, true);
+      return false;
+   }
+
+   Child client = spawn("client", clientUrl.str(), mixFile, count, window);
+   unsigned long messages = 0;
+   bool ok = client.m_pid >= 0 && readLine(relay, client, line) &&
+             std::sscanf(line.c_str(), "done %lu", &messages) == 1;
+   reap(client, !ok);
+   reap(service, true);
+
+   if (!ok) {
+      std::cerr << header << ": client failed" << &std::endl;
+      return false;
+   }
+
+   unsigned long long total = relay.getUpstream() + relay.getDownstream();
+   std::cout << std::setw(8) << header
+             << std::setw(11) << messages
+             << std::setw(14) << relay.getUpstream()
+             << std::setw(16) << relay.getDownstream()
+             << std::setw(12) << std::fixed << std::setprecision(1)
+             << static_cast<double>(total) / static_cast<double>(messages)
+             << &std::endl;
+
+   return true;
+}
+
+} // namespace
+
+/*****************************************************************************/
+
+static void usage()
+{
+   std::cout << "Usage: tsd.communication.messaging.app.header-bench [-n NUM] [-w WINDOW] [-f MIXFILE]\n"
+             << "                                                  [-t PORT] [-z BYTES]\n"
+             << "\nOptions:\n"
+             << "  -n NUM        Number of messages drawn from the mix (default: 100000)\n"
+             << "  -w WINDOW     Maximum outstanding requests (default: 64)\n"
+             << "  -f MIXFILE    Traffic mix, see source (default: built-in mix)\n"
+             << "  -t PORT       TCP port of the service, the relay uses PORT+1\n"
+             << "                (default: 34580)\n"
+             << "  -z BYTES      Additional run with the compact header that compresses\n"
+             << "                payloads of at least BYTES\n"
+             << "\n"
+             << "Counts the bytes on the wire for a traffic mix with the fixed and with\n"
+             << "the compact packet header."
+             << &std::endl;
+   std::exit(1);
+}
+
+int main(int /*argc*/, const char * const *argv)
+{
+   unsigned long count = 100000;
+   unsigned long window = 64;
+   unsigned long port = 34580;
+   unsigned long compress = 0;
+   std::string mixFile("-");
+
+   // child modes, only used internally
+   if (argv[1] != 0 && std::strcmp(argv[1], "-x") == 0) {
+      for (int i = 2; i <= 6; i++) {
+         if (argv[i] == 0) { usage(); }
+      }
+      Mix mix;
+      if (!loadMix(argv[4], mix)) {
+         return 1;
+      }
+      count = std::strtoul(argv[5], 0, 0);
+      window = std::strtoul(argv[6], 0, 0);
+      if (std::strcmp(argv[2], "service") == 0) {
+         return runService(argv[3], mix, count);
+      } else if (std::strcmp(argv[2], "client") == 0) {
+         return runClient(argv[3], mix, count, window);
+      }
+      usage();
+   }
+
+   for (const char * const *arg = argv+1; *arg != 0; arg++) {
+      if (std::strcmp(*arg, "-n") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         count = std::strtoul(*arg, 0, 0);
+         if (count == 0 || count == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-w") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         window = std::strtoul(*arg, 0, 0);
+         if (window == 0 || window == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-f") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         mixFile = *arg;
+      } else if (std::strcmp(*arg, "-t") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         port = std::strtoul(*arg, 0, 0);
+         if (port == 0 || port >= 65535) { usage(); }
+      } else if (std::strcmp(*arg, "-z") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         compress = std::strtoul(*arg, 0, 0);
+         if (compress == 0 || compress == ULONG_MAX) { usage(); }
+      } else {
+         usage();
+      }
+   }
+
+   Mix mix;
+   if (!loadMix(mixFile, mix)) {
+      std::cerr << "Invalid mix: " << mixFile << &std::endl;
+      return 1;
+   }
+
+   std::cout << "  header   messages   upstream[B]  downstream[B]  bytes/msg" << &std::endl;
+   bool ok = runMode("fixed", "header=fixed", static_cast<uint16_t>(port), mixFile, count, window) &&
+             runMode("compact", "header=compact", static_cast<uint16_t>(port + 2), mixFile, count, window);
+   if (ok && compress > 0) {
+      std::stringstream options;
+      options << "header=compact&compress=" << compress;
+      ok = runMode("lz", options.str(), static_cast<uint16_t>(port + 4), mixFile, count, window);
+   }
+
+   return ok ? 0 : 2;
+}
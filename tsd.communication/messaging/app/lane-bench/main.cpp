@@ -0,0 +1,727 @@
+/**
+ * Priority lane latency benchmark.
+ *
+ * A service process streams bulk messages to a client process as fast as the
+ * client acknowledges them. At the same time the client pings an echo
+ * interface of the service with small messages and records the round trip
+ * times. The client is connected through a TCP relay that is run by the
+ * benchmark itself and limits the rate towards the client. The bulk stream
+ * thus keeps the send queue of the service port filled and the pings measure
+ * how long a small message waits behind the bulk data.
+ *
+ * The benchmark runs twice: once with all queues at PRIORITY_NORMAL, i.e. one
+ * FIFO send queue, and once with the bulk queues at PRIORITY_BULK and the
+ * ping queues at PRIORITY_REALTIME.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <tsd/common/system/Thread.hpp>
+
+#include <tsd/communication/messaging/ConnectionException.hpp>
+#include <tsd/communication/messaging/Connection.hpp>
+#include <tsd/communication/messaging/Queue.hpp>
+
+using namespace tsd::communication::event;
+using namespace tsd::communication::messaging;
+
+namespace {
+
+const uint32_t START_REQ = 1;
+const uint32_t BULK_DATA = 2;
+const uint32_t BULK_ACK = 3;
+const uint32_t PING_REQ = 4;
+const uint32_t PING_RSP = 5;
+const uint32_t STOP_IND = 6;
+
+const char BULK_SERVICE[] = "lane-bench-bulk";
+const char ECHO_SERVICE[] = "lane-bench-echo";
+
+/*
+ * Socket buffer size on the slow side of the relay. Whatever sits in the
+ * kernel buffers can not be overtaken.
+ */
+const size_t SOCKET_BUFFER = 65536;
+
+class BenchMsg
+   : public TsdEvent
+{
+   std::string m_data;
+   uint32_t m_seq;
+
+public:
+   BenchMsg(uint32_t id, size_t size = 0, uint32_t seq = 0)
+      : TsdEvent(id)
+      , m_data(size, 'x')
+      , m_seq(seq)
+   { }
+
+   void serialize(tsd::common::ipc::RpcBuffer& buf) const
+   {
+      buf << m_data << m_seq;
+   }
+
+   void deserialize(tsd::common::ipc::RpcBuffer& buf)
+   {
+      buf >> m_data >> m_seq;
+   }
+
+   TsdEvent* clone(void) const
+   {
+      BenchMsg *ret = new BenchMsg(getEventId());
+      ret->m_data = m_data;
+      ret->m_seq = m_seq;
+      return ret;
+   }
+
+   inline size_t getSize() const { return m_data.size(); }
+   inline uint32_t getSeq() const { return m_seq; }
+};
+
+class BenchFactory
+   : public IMessageFactory
+{
+public:
+   std::auto_ptr<TsdEvent> createEvent(uint32_t msgId) const
+   {
+      std::auto_ptr<TsdEvent> ret;
+      switch (msgId) {
+         case START_REQ:
+         case BULK_DATA:
+         case BULK_ACK:
+         case PING_REQ:
+         case PING_RSP:
+            ret.reset(new BenchMsg(msgId));
+            break;
+      }
+      return ret;
+   }
+
+   static IMessageFactory& getInstance()
+   {
+      static BenchFactory factory;
+      return factory;
+   }
+};
+
+uint64_t nowUs()
+{
+   struct timespec ts;
+   ::clock_gettime(CLOCK_MONOTONIC, &ts);
+   return static_cast<uint64_t>(ts.tv_sec) * 1000000u + static_cast<uint64_t>(ts.tv_nsec) / 1000u;
+}
+
+struct Params
+{
+   bool m_lanes;
+   unsigned long m_count;
+   unsigned long m_size;
+   unsigned long m_window;
+};
+
+/*****************************************************************************/
+
+/**
+ * Stream the bulk messages to whoever sent the START_REQ with at most
+ * m_window unacknowledged messages.
+ */
+class BulkStreamer
+   : public tsd::common::system::Thread
+{
+   const Params &m_params;
+   std::auto_ptr<IQueue> m_queue;
+   std::auto_ptr<ILocalIfc> m_ifc;
+
+public:
+   BulkStreamer(const Params &params)
+      : tsd::common::system::Thread("BulkStreamer")
+      , m_params(params)
+      , m_queue(createQueue("lane-bench-bulk"))
+   {
+      m_queue->setPriority(params.m_lanes ? PRIORITY_BULK : PRIORITY_NORMAL);
+      m_ifc.reset(m_queue->registerInterface(BenchFactory::getInstance(), BULK_SERVICE));
+   }
+
+   void run()
+   {
+      IfcAddr_t client = 0;
+      unsigned long sent = 0;
+
+      for (;;) {
+         std::auto_ptr<TsdEvent> msg = m_queue->readMessage();
+         if (msg->getEventId() == START_REQ) {
+            client = msg->getSenderAddr();
+            sent = 0;
+            while (sent < m_params.m_window && sent < m_params.m_count) {
+               m_ifc->sendMessage(client, std::auto_ptr<TsdEvent>(
+                  new BenchMsg(BULK_DATA, m_params.m_size)));
+               sent++;
+            }
+         } else if (msg->getEventId() == BULK_ACK && sent < m_params.m_count) {
+            m_ifc->sendMessage(client, std::auto_ptr<TsdEvent>(
+               new BenchMsg(BULK_DATA, m_params.m_size)));
+            sent++;
+         }
+      }
+   }
+};
+
+int runService(const std::string &url, const Params &params)
+{
+   std::auto_ptr<IConnection> conn;
+   try {
+      conn.reset(listenDownstream(url));
+   } catch (ConnectionException &e) {
+      std::cerr << "Listen failed: " << e.what() << &std::endl;
+      return 1;
+   }
+
+   std::auto_ptr<IQueue> queue(createQueue("lane-bench-echo"));
+   queue->setPriority(params.m_lanes ? PRIORITY_REALTIME : PRIORITY_NORMAL);
+   std::auto_ptr<ILocalIfc> ifc(queue->registerInterface(BenchFactory::getInstance(), ECHO_SERVICE));
+
+   BulkStreamer streamer(params);
+   streamer.start();
+
+   std::cout << "ready" << &std::endl;
+
+   for (;;) {
+      std::auto_ptr<TsdEvent> msg = queue->readMessage();
+      BenchMsg *ping = dynamic_cast<BenchMsg*>(msg.get());
+      if (ping != NULL && msg->getEventId() == PING_REQ) {
+         ifc->sendMessage(msg->getSenderAddr(), std::auto_ptr<TsdEvent>(
+            new BenchMsg(PING_RSP, ping->getSize(), ping->getSeq())));
+      }
+   }
+}
+
+/*****************************************************************************/
+
+class StopInd
+   : public TsdEvent
+{
+public:
+   StopInd() : TsdEvent(STOP_IND) { }
+   void serialize(tsd::common::ipc::RpcBuffer& /*buf*/) const { }
+   void deserialize(tsd::common::ipc::RpcBuffer& /*buf*/) { }
+   TsdEvent* clone(void) const { return new StopInd; }
+};
+
+/**
+ * Acknowledge all bulk messages and stop the pinger when the last one has
+ * arrived.
+ */
+class BulkSink
+   : public tsd::common::system::Thread
+{
+   const Params &m_params;
+   IQueue &m_pinger;
+   std::auto_ptr<IQueue> m_queue;
+   std::auto_ptr<IRemoteIfc> m_ifc;
+   uint64_t m_elapsed;
+   bool m_complete;
+
+public:
+   BulkSink(const Params &params, IQueue &pinger)
+      : tsd::common::system::Thread("BulkSink")
+      , m_params(params)
+      , m_pinger(pinger)
+      , m_queue(createQueue("lane-bench-sink"))
+      , m_elapsed(0)
+      , m_complete(false)
+   {
+      m_queue->setPriority(params.m_lanes ? PRIORITY_BULK : PRIORITY_NORMAL);
+   }
+
+   bool init()
+   {
+      m_ifc.reset(m_queue->connectInterface(BULK_SERVICE, BenchFactory::getInstance(), 5000));
+      return m_ifc.get() != NULL;
+   }
+
+   void run()
+   {
+      uint64_t start = nowUs();
+      m_ifc->sendMessage(std::auto_ptr<TsdEvent>(new BenchMsg(START_REQ)));
+
+      unsigned long received = 0;
+      while (received < m_params.m_count) {
+         std::auto_ptr<TsdEvent> msg = m_queue->readMessage(10000);
+         if (msg.get() == NULL) {
+            break;
+         }
+         if (msg->getEventId() == BULK_DATA) {
+            received++;
+            m_ifc->sendMessage(std::auto_ptr<TsdEvent>(new BenchMsg(BULK_ACK)));
+         }
+      }
+
+      m_elapsed = nowUs() - start;
+      m_complete = received == m_params.m_count;
+      m_pinger.sendSelfMessage(std::auto_ptr<TsdEvent>(new StopInd));
+   }
+
+   inline uint64_t getElapsed() const { return m_elapsed; }
+   inline bool isComplete() const { return m_complete; }
+};
+
+/**
+ * Ping the echo interface back to back while the bulk stream runs and print
+ * the round trip percentiles.
+ */
+int runClient(const std::string &url, const Params &params, unsigned long pingSize)
+{
+   std::auto_ptr<IConnection> conn;
+   try {
+      conn.reset(connectUpstream(url));
+   } catch (ConnectionException &e) {
+      std::cerr << "Connect failed: " << e.what() << &std::endl;
+      return 1;
+   }
+
+   std::auto_ptr<IQueue> queue(createQueue("lane-bench-pinger"));
+   queue->setPriority(params.m_lanes ? PRIORITY_REALTIME : PRIORITY_NORMAL);
+   std::auto_ptr<IRemoteIfc> ifc(queue->connectInterface(ECHO_SERVICE,
+      BenchFactory::getInstance(), 5000));
+   BulkSink sink(params, *queue);
+   if (ifc.get() == NULL || !sink.init()) {
+      std::cerr << "Service not found" << &std::endl;
+      return 2;
+   }
+
+   sink.start();
+
+   std::vector<uint64_t> rtt;
+   bool running = true;
+   while (running) {
+      uint32_t seq = static_cast<uint32_t>(rtt.size());
+      uint64_t start = nowUs();
+      ifc->sendMessage(std::auto_ptr<TsdEvent>(new BenchMsg(PING_REQ, pingSize, seq)));
+
+      for (;;) {
+         std::auto_ptr<TsdEvent> msg = queue->readMessage(10000);
+         if (msg.get() == NULL || msg->getEventId() == STOP_IND) {
+            running = false;
+            break;
+         }
+         BenchMsg *pong = dynamic_cast<BenchMsg*>(msg.get());
+         if (pong != NULL && msg->getEventId() == PING_RSP && pong->getSeq() == seq) {
+            rtt.push_back(nowUs() - start);
+            break;
+         }
+      }
+   }
+
+   sink.join();
+   if (!sink.isComplete() || rtt.empty()) {
+      std::cerr << "Bulk stream incomplete" << &std::endl;
+      return 3;
+   }
+
+   std::sort(rtt.begin(), rtt.end());
+   std::cout << "done " << rtt.size()
+             << " " << rtt[rtt.size() / 2]
+             << " " << rtt[rtt.size() * 99 / 100]
+             << " " << rtt.back()
+             << " " << sink.getElapsed()
+             << &std::endl;
+   return 0;
+}
+
+/*****************************************************************************/
+
+/**
+ * TCP relay between the client and the service that limits the downstream
+ * rate to emulate a slow link. The socket buffers towards the service are
+ * kept small so that the backlog stays in the send queue of the service.
+ */
+class Relay
+{
+   int m_listen;
+   int m_client;
+   int m_server;
+   struct sockaddr_in m_target;
+   unsigned long m_rate;   // bytes per millisecond
+   uint64_t m_refill;
+   size_t m_budget;
+
+   bool forward(int from, int to, size_t max)
+   {
+      char buf[65536];
+      ssize_t len = ::read(from, buf, std::min(max, sizeof(buf)));
+      if (len <= 0) {
+         return false;
+      }
+
+      for (ssize_t done = 0; done < len; ) {
+         ssize_t ret = ::write(to, buf + done, len - done);
+         if (ret <= 0) {
+            return false;
+         }
+         done += ret;
+      }
+
+      if (from == m_server) {
+         m_budget -= static_cast<size_t>(len);
+      }
+      return true;
+   }
+
+   void refill()
+   {
+      uint64_t now = nowUs();
+      uint64_t add = (now - m_refill) * m_rate / 1000u;
+      if (add > 0) {
+         m_budget = static_cast<size_t>(std::min<uint64_t>(m_budget + add, SOCKET_BUFFER));
+         m_refill = now;
+      }
+   }
+
+   void drop()
+   {
+      if (m_client >= 0) {
+         ::close(m_client);
+         m_client = -1;
+      }
+      if (m_server >= 0) {
+         ::close(m_server);
+         m_server = -1;
+      }
+   }
+
+public:
+   Relay(uint16_t targetPort, unsigned long rate)
+      : m_listen(-1)
+      , m_client(-1)
+      , m_server(-1)
+      , m_rate(rate)
+      , m_refill(nowUs())
+      , m_budget(0)
+   {
+      std::memset(&m_target, 0, sizeof(m_target));
+      m_target.sin_family = AF_INET;
+      m_target.sin_port = htons(targetPort);
+      m_target.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   }
+
+   ~Relay()
+   {
+      drop();
+      if (m_listen >= 0) {
+         ::close(m_listen);
+      }
+   }
+
+   bool open(uint16_t port)
+   {
+      m_listen = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      if (m_listen < 0) {
+         return false;
+      }
+
+      int one = 1;
+      ::setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+      struct sockaddr_in addr;
+      std::memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(port);
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      return ::bind(m_listen, (struct sockaddr *) &addr, sizeof(addr)) == 0 &&
+             ::listen(m_listen, 1) == 0;
+   }
+
+   /**
+    * Shuffle data for up to @p timeout ms or until @p fd is readable.
+    *
+    * @return True if @p fd is readable
+    */
+   bool poll(int fd, int timeout)
+   {
+      refill();
+      bool throttled = m_budget == 0;
+
+      struct pollfd fds[4] = {
+         { fd, POLLIN, 0 },
+         { m_listen, POLLIN, 0 },
+         { m_client, POLLIN, 0 },
+         { throttled ? -1 : m_server, POLLIN, 0 },
+      };
+
+      if (::poll(fds, 4, throttled ? 1 : timeout) <= 0) {
+         return false;
+      }
+
+      if (fds[1].revents != 0 && m_client < 0) {
+         m_client = ::accept4(m_listen, NULL, NULL, SOCK_CLOEXEC);
+         m_server = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+         int size = SOCKET_BUFFER;
+         if (m_server >= 0) {
+            ::setsockopt(m_server, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+         }
+         if (m_client >= 0 && m_server >= 0 &&
+             ::connect(m_server, (struct sockaddr *) &m_target, sizeof(m_target)) == 0) {
+            int one = 1;
+            ::setsockopt(m_client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            ::setsockopt(m_server, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+         } else {
+            drop();
+         }
+      }
+
+      bool alive = true;
+      if (fds[2].revents != 0 && m_client >= 0) {
+         alive = forward(m_client, m_server, SOCKET_BUFFER);
+      }
+      if (alive && fds[3].revents != 0 && m_server >= 0) {
+         alive = forward(m_server, m_client, m_budget);
+      }
+      if (!alive) {
+         drop();
+      }
+
+      return fds[0].revents != 0;
+   }
+};
+
+struct Child
+{
+   pid_t m_pid;
+   FILE *m_output;
+};
+
+/**
+ * Start another instance of this program in the given @p mode.
+ *
+ * @return Child process or m_pid == -1 on error
+ */
+Child spawn(const char *mode, const std::string &url, const Params &params,
+            unsigned long pingSize)
+{
+   Child ret = { -1, NULL };
+
+   std::stringstream args;
+   args << (params.m_lanes ? 1 : 0) << " " << params.m_count << " " << params.m_size
+        << " " << params.m_window << " " << pingSize;
+   std::string lanesArg, countArg, sizeArg, windowArg, pingArg;
+   args >> lanesArg >> countArg >> sizeArg >> windowArg >> pingArg;
+
+   int out[2];
+   if (::pipe(out) < 0) {
+      return ret;
+   }
+
+   ret.m_pid = ::fork();
+   if (ret.m_pid == 0) {
+      ::dup2(out[1], STDOUT_FILENO);
+      ::close(out[0]);
+      ::close(out[1]);
+
+      const char *argv[] = { "lane-bench", "-x", mode, url.c_str(), lanesArg.c_str(),
+         countArg.c_str(), sizeArg.c_str(), windowArg.c_str(), pingArg.c_str(), NULL };
+      ::execv("/proc/self/exe", const_cast<char * const *>(argv));
+      ::_exit(127);
+   }
+
+   ::close(out[1]);
+   if (ret.m_pid < 0) {
+      ::close(out[0]);
+   } else {
+      ret.m_output = ::fdopen(out[0], "r");
+   }
+
+   return ret;
+}
+
+void reap(Child &child, bool kill)
+{
+   if (child.m_pid <= 0) {
+      return;
+   }
+
+   if (kill) {
+      ::kill(child.m_pid, SIGTERM);
+   }
+   int status = 0;
+   ::waitpid(child.m_pid, &status, 0);
+   if (child.m_output != NULL) {
+      ::fclose(child.m_output);
+   }
+   child.m_pid = -1;
+}
+
+/**
+ * Keep the relay going until the child printed a line or exited.
+ */
+bool readLine(Relay &relay, Child &child, std::string &line)
+{
+   line.clear();
+
+   for (;;) {
+      if (!relay.poll(::fileno(child.m_output), 1000)) {
+         continue;
+      }
+
+      char c;
+      if (::read(::fileno(child.m_output), &c, 1) != 1) {
+         return false;
+      }
+      if (c == '\n') {
+         return true;
+      }
+      line += c;
+   }
+}
+
+bool runMode(const char *name, const Params &params, uint16_t port, unsigned long rate,
+             unsigned long pingSize)
+{
+   std::stringstream serviceUrl, clientUrl;
+   serviceUrl << "tcp://127.0.0.1:" << port << "?sndbuf=" << SOCKET_BUFFER;
+   clientUrl << "tcp://127.0.0.1:" << (port + 1);
+
+   Relay relay(port, rate);
+   if (!relay.open(static_cast<uint16_t>(port + 1))) {
+      std::cerr << "Cannot open relay" << &std::endl;
+      return false;
+   }
+
+   std::string line;
+   Child service = spawn("service", serviceUrl.str(), params, pingSize);
+   if (service.m_pid < 0 || !readLine(relay, service, line) || line != "ready") {
+      std::cerr << name << ": service did not start" << &std::endl;
+      reap(service, true);
+      return false;
+   }
+
+   Child client = spawn("client", clientUrl.str(), params, pingSize);
+   unsigned long pings = 0, p50 = 0, p99 = 0, max = 0, elapsed = 0;
+   bool ok = client.m_pid >= 0 && readLine(relay, client, line) &&
+             std::sscanf(line.c_str(), "done %lu %lu %lu %lu %lu",
+                         &pings, &p50, &p99, &max, &elapsed) == 5;
+   reap(client, !ok);
+   reap(service, true);
+
+   if (!ok) {
+      std::cerr << name << ": client failed" << &std::endl;
+      return false;
+   }
+
+   double throughput = elapsed ? static_cast<double>(params.m_count) * static_cast<double>(params.m_size) /
+                                 static_cast<double>(elapsed) : 0.0;
+   std::cout << std::setw(6) << name
+             << std::setw(9) << pings
+             << std::setw(10) << p50
+             << std::setw(10) << p99
+             << std::setw(10) << max
+             << std::setw(12) << std::fixed << std::setprecision(1) << throughput
+             << &std::endl;
+
+   return true;
+}
+
+} // namespace
+
+/*****************************************************************************/
+
+static void usage()
+{
+   std::cout << "Usage: tsd.communication.messaging.app.lane-bench [-n NUM] [-s SIZE] [-w WINDOW]\n"
+             << "                                                [-m SIZE] [-r RATE] [-t PORT]\n"
+             << "\nOptions:\n"
+             << "  -n NUM        Number of bulk messages (default: 2000)\n"
+             << "  -s SIZE       Size of a bulk message (default: 65536)\n"
+             << "  -w WINDOW     Maximum unacknowledged bulk messages (default: 64)\n"
+             << "  -m SIZE       Size of a ping (default: 16)\n"
+             << "  -r RATE       Link rate in kB/s (default: 20000)\n"
+             << "  -t PORT       TCP port of the service, the relay uses PORT+1\n"
+             << "                (default: 34590)\n"
+             << "\n"
+             << "Measures the round trip time of small realtime messages while a bulk\n"
+             << "transfer saturates the link, once without and once with priority lanes."
+             << &std::endl;
+   std::exit(1);
+}
+
+int main(int /*argc*/, const char * const *argv)
+{
+   Params params = { false, 2000, 65536, 64 };
+   unsigned long pingSize = 16;
+   unsigned long rate = 20000;
+   unsigned long port = 34590;
+
+   // child modes, only used internally
+   if (argv[1] != 0 && std::strcmp(argv[1], "-x") == 0) {
+      for (int i = 2; i <= 8; i++) {
+         if (argv[i] == 0) { usage(); }
+      }
+      params.m_lanes = std::strtoul(argv[4], 0, 0) != 0;
+      params.m_count = std::strtoul(argv[5], 0, 0);
+      params.m_size = std::strtoul(argv[6], 0, 0);
+      params.m_window = std::strtoul(argv[7], 0, 0);
+      pingSize = std::strtoul(argv[8], 0, 0);
+      if (std::strcmp(argv[2], "service") == 0) {
+         return runService(argv[3], params);
+      } else if (std::strcmp(argv[2], "client") == 0) {
+         return runClient(argv[3], params, pingSize);
+      }
+      usage();
+   }
+
+   for (const char * const *arg = argv+1; *arg != 0; arg++) {
+      if (std::strcmp(*arg, "-n") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         params.m_count = std::strtoul(*arg, 0, 0);
+         if (params.m_count == 0 || params.m_count == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-s") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         params.m_size = std::strtoul(*arg, 0, 0);
+         if (params.m_size == 0 || params.m_size == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-w") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         params.m_window = std::strtoul(*arg, 0, 0);
+         if (params.m_window == 0 || params.m_window == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-m") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         pingSize = std::strtoul(*arg, 0, 0);
+         if (pingSize == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-r") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         rate = std::strtoul(*arg, 0, 0);
+         if (rate == 0 || rate == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-t") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         port = std::strtoul(*arg, 0, 0);
+         if (port == 0 || port >= 65534) { usage(); }
+      } else {
+         usage();
+      }
+   }
+
+   std::cout << "  mode    pings   p50[us]   p99[us]   max[us]  bulk[MB/s]" << &std::endl;
+   params.m_lanes = false;
+   bool ok = runMode("fifo", params, static_cast<uint16_t>(port), rate, pingSize);
+   params.m_lanes = true;
+   ok = ok && runMode("lanes", params, static_cast<uint16_t>(port + 2), rate, pingSize);
+
+   return ok ? 0 : 2;
+}
@@ -0,0 +1,237 @@
+/**
+ * Name lookup benchmark.
+ *
+ * Simulates the startup of a system where many components resolve their
+ * peers by name. A number of interfaces is registered and then resolved
+ * twice. The first round hits the name servers, the second round should be
+ * answered by the lookup cache of the local router.
+ *
+ * By default everything runs in a single process. With "-s" the interfaces
+ * are registered by a server instance and a second instance resolves them
+ * through the given transport.
+ */
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <tsd/common/system/Clock.hpp>
+#include <tsd/common/system/Thread.hpp>
+#include <tsd/communication/messaging/ConnectionException.hpp>
+#include <tsd/communication/messaging/Connection.hpp>
+#include <tsd/communication/messaging/Queue.hpp>
+
+using namespace tsd::communication::event;
+using namespace tsd::communication::messaging;
+
+namespace {
+
+class BenchMsgFactory
+   : public IMessageFactory
+{
+public:
+   std::auto_ptr<TsdEvent> createEvent(uint32_t /*msgId*/) const
+   {
+      return std::auto_ptr<TsdEvent>();
+   }
+
+   static IMessageFactory& getInstance()
+   {
+      static BenchMsgFactory factory;
+      return factory;
+   }
+};
+
+std::string interfaceName(const std::string &prefix, unsigned long i)
+{
+   std::ostringstream s;
+   s << prefix << "ns-bench-" << i;
+   return s.str();
+}
+
+/*****************************************************************************/
+
+/**
+ * Resolves all names once.
+ */
+class Resolver
+   : public tsd::common::system::Thread
+{
+   std::auto_ptr<IQueue> m_queue;
+   std::string m_prefix;
+   unsigned long m_count;
+   unsigned long m_resolved;
+
+   void run(); // tsd::common::system::Thread
+
+public:
+   Resolver(const std::string &prefix, unsigned long count);
+
+   inline unsigned long getResolved() const { return m_resolved; }
+};
+
+Resolver::Resolver(const std::string &prefix, unsigned long count)
+   : tsd::common::system::Thread("Resolver")
+   , m_queue(createQueue("ns-bench-client"))
+   , m_prefix(prefix)
+   , m_count(count)
+   , m_resolved(0)
+{
+}
+
+void Resolver::run()
+{
+   for (unsigned long i = 0; i < m_count; i++) {
+      std::auto_ptr<IRemoteIfc> ifc(m_queue->connectInterface(interfaceName(m_prefix, i),
+         BenchMsgFactory::getInstance(), 3000));
+      if (ifc.get() != NULL) {
+         m_resolved++;
+      }
+   }
+}
+
+/**
+ * Resolve all names with @p threads parallel resolvers.
+ *
+ * All resolvers look up the same names in the same order. Concurrent lookups
+ * of one name are coalesced by the name server.
+ *
+ * @return Number of successful lookups
+ */
+unsigned long runRound(const std::string &prefix, unsigned long count, unsigned long threads,
+                       uint32_t &elapsed)
+{
+   std::vector<Resolver*> resolvers;
+   for (unsigned long i = 0; i < threads; i++) {
+      resolvers.push_back(new Resolver(prefix, count));
+   }
+
+   uint32_t start = tsd::common::system::Clock::getTickCounter();
+   for (std::vector<Resolver*>::iterator it(resolvers.begin()); it != resolvers.end(); ++it) {
+      (*it)->start();
+   }
+
+   unsigned long resolved = 0;
+   for (std::vector<Resolver*>::iterator it(resolvers.begin()); it != resolvers.end(); ++it) {
+      (*it)->join();
+      resolved += (*it)->getResolved();
+   }
+   elapsed = tsd::common::system::Clock::getTickCounter() - start;
+
+   for (std::vector<Resolver*>::iterator it(resolvers.begin()); it != resolvers.end(); ++it) {
+      delete *it;
+   }
+
+   return resolved;
+}
+
+} // namespace
+
+/*****************************************************************************/
+
+static void usage()
+{
+   std::cout << "Usage: tsd.communication.messaging.app.ns-bench [-s] [-n NUM] [-j THREADS]\n"
+             << "                                                [-t TRANSPORT] [-p PREFIX]\n"
+             << "\nOptions:\n"
+             << "  -n NUM        Register and resolve NUM names (default: 500)\n"
+             << "  -j THREADS    Resolve with THREADS parallel threads (default: 1)\n"
+             << "  -s            Server mode, only register the names\n"
+             << "  -t TRANSPORT  Connect via TRANSPORT\n"
+             << "  -p PREFIX     Prefix of the resolved names, e.g. \"/ns-bench/\"\n"
+             << "\n"
+             << "Without '-s' and '-t' the names are registered and resolved in the same\n"
+             << "process. Otherwise start a server instance with '-s' first and point the\n"
+             << "client with '-p' to the domain of the server."
+             << &std::endl;
+   std::exit(1);
+}
+
+int main(int /*argc*/, const char * const *argv)
+{
+   unsigned long count = 500;
+   unsigned long threads = 1;
+   std::string transport;
+   std::string prefix;
+   bool server = false;
+
+   for (const char * const *arg = argv+1; *arg != 0; arg++) {
+      if (std::strcmp(*arg, "-n") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         count = std::strtoul(*arg, 0, 0);
+         if (count == 0 || count == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-j") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         threads = std::strtoul(*arg, 0, 0);
+         if (threads == 0 || threads == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-t") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         transport = *arg;
+      } else if (std::strcmp(*arg, "-p") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         prefix = *arg;
+      } else if (std::strcmp(*arg, "-s") == 0) {
+         server = true;
+      } else {
+         usage();
+      }
+   }
+
+   std::auto_ptr<IConnection> conn;
+   if (server || !transport.empty()) {
+      try {
+         conn.reset(connectUpstream(transport, server ? "ns-bench" : ""));
+      } catch (ConnectionException &e) {
+         std::cerr << "Connection failed: " << e.what() << &std::endl;
+         return 1;
+      }
+   }
+
+   std::auto_ptr<IQueue> queue;
+   std::vector<ILocalIfc*> interfaces;
+   if (server || transport.empty()) {
+      queue.reset(createQueue("ns-bench-server"));
+      for (unsigned long i = 0; i < count; i++) {
+         interfaces.push_back(queue->registerInterface(BenchMsgFactory::getInstance(),
+                                                       interfaceName("", i)));
+      }
+   }
+
+   int ret = 0;
+   if (server) {
+      std::cout << count << " names registered. Press ENTER to exit." << &std::endl;
+      std::string dummy;
+      std::getline(std::cin, dummy);
+   } else {
+      std::cout << "   round    lookups   time[ms]   lookups/s" << &std::endl;
+      const char *rounds[] = { "cold", "cached" };
+      for (unsigned i = 0; i < sizeof(rounds)/sizeof(rounds[0]); i++) {
+         uint32_t elapsed = 0;
+         unsigned long total = runRound(prefix, count, threads, elapsed);
+         unsigned long rate = elapsed ? static_cast<unsigned long>(total * 1000.0 / elapsed) : 0;
+
+         std::cout << std::setw(8) << rounds[i]
+                   << std::setw(11) << total
+                   << std::setw(11) << elapsed
+                   << std::setw(12) << rate
+                   << &std::endl;
+
+         if (total != count * threads) {
+            std::cout << "Failed to resolve " << (count * threads - total) << " names!" << &std::endl;
+            ret = 2;
+            break;
+         }
+      }
+   }
+
+   for (std::vector<ILocalIfc*>::iterator it(interfaces.begin()); it != interfaces.end(); ++it) {
+      delete *it;
+   }
+
+   return ret;
+}
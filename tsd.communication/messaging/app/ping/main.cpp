@@ -11,6 +11,7 @@
 #include <iostream>
 #include <string>
 
+#include <tsd/common/system/Clock.hpp>
 #include <tsd/common/system/Thread.hpp>
 #include <tsd/communication/messaging/AddressInUseException.hpp>
 #include <tsd/communication/messaging/ConnectionException.hpp>
@@ -200,11 +201,12 @@ class EchoService
    {
       std::auto_ptr<IQueue> m_queue;
       std::auto_ptr<ILocalIfc> m_ifc;
+      bool m_quiet;
 
       void run(); // tsd::common::system::Thread
 
    public:
-      Impl();
+      Impl(bool quiet);
       ~Impl();
 
       bool init(const std::string &name);
@@ -217,11 +219,12 @@ public:
    EchoService();
    ~EchoService();
 
-   bool init(const std::string &name);
+   bool init(const std::string &name, bool quiet = false);
 };
 
-EchoService::Impl::Impl()
+EchoService::Impl::Impl(bool quiet)
    : tsd::common::system::Thread("EchoService")
+   , m_quiet(quiet)
 { }
 
 EchoService::Impl::~Impl()
@@ -243,8 +246,10 @@ void EchoService::Impl::run()
                EchoReq *req = dynamic_cast<EchoReq*>(msg.get());
                m_ifc->sendMessage(msg->getSenderAddr(),
                   std::auto_ptr<TsdEvent>(new EchoReply("Hello " + req->getMsg())));
-               std::cout.put('.');
-               std::cout.flush();
+               if (!m_quiet) {
+                  std::cout.put('.');
+                  std::cout.flush();
+               }
                break;
             }
             default:
@@ -300,9 +305,9 @@ EchoService::~EchoService()
    }
 }
 
-bool EchoService::init(const std::string &name)
+bool EchoService::init(const std::string &name, bool quiet)
 {
-   m_impl = new Impl();
+   m_impl = new Impl(quiet);
    return m_impl->init(name);
 }
 
@@ -315,14 +320,18 @@ bool EchoService::init(const std::string &name)
 static void usage()
 {
    std::cout << "Usage: tsd.communication.messaging.app.ping [-s] [-n NUM] [-t TRANSPORT] SERVICE\n"
+             << "                                          [-w WINDOW] [-m SIZE] [-q]\n"
              << "\nArguments:\n"
              << "  SERVICE       Service name of Ping-Service\n"
              << "\nOptions:\n"
              << "  -b            Beacon listening mode\n"
              << "  -l            Use listenDownstream instead of connectUpstream\n"
+             << "  -m SIZE       Pad the ping requests to SIZE bytes\n"
              << "  -n NUM        Repeat ping NUM times\n"
+             << "  -q            Quiet server, do not print a dot for every request\n"
              << "  -s            Server mode\n"
              << "  -t TRANSPORT  Connect via TRANSPORT\n"
+             << "  -w WINDOW     Flood mode, keep WINDOW requests in flight\n"
              << "\n"
              << "By default the application will connect via the default transport to a\n"
              << "router and send a ping request to the specified SERVICE. The server side\n"
@@ -330,7 +339,10 @@ static void usage()
              << "\n"
              << "The default transport may be changed by specifying a different with the '-t'\n"
              << "option. Normally the app will connect to a router. With '-l' the app will\n"
-             << "create a listening port for the transport"
+             << "create a listening port for the transport.\n"
+             << "\n"
+             << "In flood mode the client does not wait for each reply before sending the\n"
+             << "next request and prints the achieved message rate instead."
              << &std::endl;
    std::exit(1);
 }
@@ -340,7 +352,10 @@ int main(int /*argc*/, const char * const *argv)
    std::string serviceName;
    std::string transport;
    unsigned long repeats = 1;
+   unsigned long window = 0;
+   unsigned long size = 0;
    bool server = false;
+   bool quiet = false;
    bool beacon = false;
    bool listen = false;
 
@@ -354,6 +369,16 @@ int main(int /*argc*/, const char * const *argv)
          beacon = true;
       } else if (std::strcmp(*arg, "-l") == 0) {
          listen = true;
+      } else if (std::strcmp(*arg, "-q") == 0) {
+         quiet = true;
+      } else if (std::strcmp(*arg, "-m") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         size = std::strtoul(*arg, 0, 0);
+         if (size == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-w") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         window = std::strtoul(*arg, 0, 0);
+         if (window == 0 || window == ULONG_MAX) { usage(); }
       } else if (std::strcmp(*arg, "-n") == 0) {
          arg++; if (*arg == 0) { usage(); }
          repeats = std::strtoul(*arg, 0, 0);
@@ -385,7 +410,7 @@ int main(int /*argc*/, const char * const *argv)
 
       // start echo server
       EchoService echo;
-      if (!echo.init(serviceName)) {
+      if (!echo.init(serviceName, quiet)) {
          std::cout << "Echo service init failed!" << &std::endl;
          return 1;
       }
@@ -413,6 +438,10 @@ int main(int /*argc*/, const char * const *argv)
       }
 
       std::string reply;
+      std::string ping("World");
+      if (ping.size() < size) {
+         ping.resize(size, '.');
+      }
 
       if (beacon) {
          std::auto_ptr<TsdEvent> msg;
@@ -430,9 +459,40 @@ int main(int /*argc*/, const char * const *argv)
          } while (msg.get());
 
          std::cout << "Timeout waiting for beacon" << &std::endl;
+      } else if (window > 0) {
+         unsigned long sent = 0;
+         unsigned long received = 0;
+         uint32_t start = tsd::common::system::Clock::getTickCounter();
+
+         while (sent < repeats && sent < window) {
+            ifc->sendMessage(std::auto_ptr<TsdEvent>(new EchoReq(ping)));
+            sent++;
+         }
+
+         while (received < repeats) {
+            std::auto_ptr<TsdEvent> msg = q->readMessage(300);
+            if (msg.get() == 0) {
+               std::cout << "Timeout waiting for reply after " << received
+                         << " replies" << &std::endl;
+               return 2;
+            }
+
+            if (msg->getEventId() == ECHO_REPLY) {
+               received++;
+               if (sent < repeats) {
+                  ifc->sendMessage(std::auto_ptr<TsdEvent>(new EchoReq(ping)));
+                  sent++;
+               }
+            }
+         }
+
+         uint32_t elapsed = tsd::common::system::Clock::getTickCounter() - start;
+         unsigned long rate = elapsed ? static_cast<unsigned long>(received * 1000.0 / elapsed) : 0;
+         std::cout << received << " replies in " << elapsed << "ms, "
+                   << rate << " msgs/s" << &std::endl;
       } else {
          for (unsigned int i = 0; i < repeats; i++) {
-            ifc->sendMessage(std::auto_ptr<TsdEvent>(new EchoReq("World")));
+            ifc->sendMessage(std::auto_ptr<TsdEvent>(new EchoReq(ping)));
             std::auto_ptr<TsdEvent> msg = q->readMessage(300);
 
             if (msg.get() == 0) {
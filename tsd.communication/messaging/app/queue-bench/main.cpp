@@ -0,0 +1,192 @@
+/**
+ * Queue read benchmark.
+ *
+ * A sender thread floods a single receiver queue. The receiver drains it
+ * either with IQueue::readMessage() one message at a time or in batches with
+ * IQueue::readMessages(). Both rounds report the achieved message rate.
+ */
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <tsd/common/system/Clock.hpp>
+#include <tsd/common/system/Thread.hpp>
+#include <tsd/communication/messaging/Queue.hpp>
+
+using namespace tsd::communication::event;
+using namespace tsd::communication::messaging;
+
+namespace {
+
+const uint32_t BENCH_MSG = 1;
+
+class BenchMsg
+   : public TsdEvent
+{
+public:
+   BenchMsg() : TsdEvent(BENCH_MSG) { }
+   void serialize(tsd::common::ipc::RpcBuffer& /*buf*/) const { }
+   void deserialize(tsd::common::ipc::RpcBuffer& /*buf*/) { }
+   TsdEvent* clone(void) const { return new BenchMsg; }
+};
+
+class BenchMsgFactory
+   : public IMessageFactory
+{
+public:
+   std::auto_ptr<TsdEvent> createEvent(uint32_t msgId) const
+   {
+      std::auto_ptr<TsdEvent> ret;
+      if (msgId == BENCH_MSG) {
+         ret.reset(new BenchMsg);
+      }
+      return ret;
+   }
+
+   static IMessageFactory& getInstance()
+   {
+      static BenchMsgFactory factory;
+      return factory;
+   }
+};
+
+/*****************************************************************************/
+
+class Sender
+   : public tsd::common::system::Thread
+{
+   std::auto_ptr<IQueue> m_queue;
+   std::auto_ptr<IRemoteIfc> m_ifc;
+   unsigned long m_count;
+
+   void run(); // tsd::common::system::Thread
+
+public:
+   Sender(const ILocalIfc *receiver, unsigned long count);
+};
+
+Sender::Sender(const ILocalIfc *receiver, unsigned long count)
+   : tsd::common::system::Thread("Sender")
+   , m_queue(createQueue("queue-bench-tx"))
+   , m_count(count)
+{
+   m_ifc.reset(m_queue->connectInterface(receiver, BenchMsgFactory::getInstance()));
+}
+
+void Sender::run()
+{
+   for (unsigned long i = 0; i < m_count; i++) {
+      m_ifc->sendMessage(std::auto_ptr<TsdEvent>(new BenchMsg));
+   }
+}
+
+/**
+ * Run one round and drain the queue with batches of @p batch messages.
+ *
+ * A batch size of zero uses readMessage() instead of readMessages().
+ *
+ * @return Number of received messages
+ */
+unsigned long runRound(unsigned long count, size_t batch, uint32_t &elapsed)
+{
+   std::auto_ptr<IQueue> queue(createQueue("queue-bench-rx"));
+   std::auto_ptr<ILocalIfc> ifc(queue->registerInterface(BenchMsgFactory::getInstance()));
+   std::auto_ptr<Sender> sender(new Sender(ifc.get(), count));
+
+   unsigned long received = 0;
+   std::vector<TsdEvent*> events;
+   events.reserve(batch);
+
+   uint32_t start = tsd::common::system::Clock::getTickCounter();
+   sender->start();
+
+   while (received < count) {
+      if (batch == 0) {
+         std::auto_ptr<TsdEvent> msg = queue->readMessage(1000);
+         if (msg.get() == NULL) {
+            break;
+         }
+         received++;
+      } else {
+         size_t num = queue->readMessages(events, batch, 1000);
+         if (num == 0) {
+            break;
+         }
+         for (std::vector<TsdEvent*>::iterator it(events.begin()); it != events.end(); ++it) {
+            delete *it;
+         }
+         events.clear();
+         received += num;
+      }
+   }
+
+   sender->join();
+   elapsed = tsd::common::system::Clock::getTickCounter() - start;
+
+   // the sender references our interface
+   sender.reset();
+
+   return received;
+}
+
+} // namespace
+
+/*****************************************************************************/
+
+static void usage()
+{
+   std::cout << "Usage: tsd.communication.messaging.app.queue-bench [-n NUM] [-b BATCH]\n"
+             << "\nOptions:\n"
+             << "  -n NUM        Send NUM messages per round (default: 1000000)\n"
+             << "  -b BATCH      Maximum batch size for readMessages() (default: 64)\n"
+             << "\n"
+             << "Compares the receive rate of readMessage() and readMessages() on a\n"
+             << "single queue."
+             << &std::endl;
+   std::exit(1);
+}
+
+int main(int /*argc*/, const char * const *argv)
+{
+   unsigned long count = 1000000;
+   unsigned long batch = 64;
+
+   for (const char * const *arg = argv+1; *arg != 0; arg++) {
+      if (std::strcmp(*arg, "-n") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         count = std::strtoul(*arg, 0, 0);
+         if (count == 0 || count == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-b") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         batch = std::strtoul(*arg, 0, 0);
+         if (batch == 0 || batch == ULONG_MAX) { usage(); }
+      } else {
+         usage();
+      }
+   }
+
+   std::cout << "         mode      msgs   time[ms]      msgs/s" << &std::endl;
+   const size_t rounds[] = { 0, batch };
+   for (unsigned i = 0; i < sizeof(rounds)/sizeof(rounds[0]); i++) {
+      uint32_t elapsed = 0;
+      unsigned long total = runRound(count, rounds[i], elapsed);
+      unsigned long rate = elapsed ? static_cast<unsigned long>(total * 1000.0 / elapsed) : 0;
+
+      std::cout << std::setw(13) << (rounds[i] ? "readMessages" : "readMessage")
+                << std::setw(10) << total
+                << std::setw(11) << elapsed
+                << std::setw(12) << rate
+                << &std::endl;
+
+      if (total != count) {
+         std::cout << "Lost " << (count - total) << " messages!" << &std::endl;
+         return 2;
+      }
+   }
+
+   return 0;
+}
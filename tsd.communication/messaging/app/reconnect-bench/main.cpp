@@ -0,0 +1,802 @@
+/**
+ * Uplink restart recovery benchmark.
+ *
+ * Measures how long a router needs until all its subscriptions receive
+ * events again after the connection to its upstream router was interrupted.
+ * A publisher process listens on the server transport and broadcasts a tick
+ * on each of its interfaces periodically. The subscriber process connects
+ * through a TCP relay that is run by the benchmark itself and subscribes to
+ * every interface. The relay is closed for a while and opened again to
+ * simulate the restart of the uplink.
+ *
+ * Without reconnect mode the subscriber gets death notifications and has to
+ * connect again, look up all interfaces and subscribe again like any other
+ * application. In reconnect mode the connection restores the subscriptions
+ * by itself. The recovery time is measured from the moment the relay accepts
+ * connections again until the subscriber has received a tick on every
+ * subscription that was sent after that moment.
+ */
+
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <tsd/common/system/Clock.hpp>
+#include <tsd/common/system/Thread.hpp>
+#include <tsd/communication/messaging/ConnectionException.hpp>
+#include <tsd/communication/messaging/Connection.hpp>
+#include <tsd/communication/messaging/Queue.hpp>
+
+using namespace tsd::communication::event;
+using namespace tsd::communication::messaging;
+
+namespace {
+
+const uint32_t TICK_IND = 1;
+const uint32_t DEAD_IND = 2;
+const uint32_t UP_IND = 3;
+const uint32_t QUIT_IND = 4;
+
+class TickInd
+   : public TsdEvent
+{
+   uint32_t m_stamp;
+
+public:
+   TickInd(uint32_t stamp = 0) : TsdEvent(TICK_IND), m_stamp(stamp) { }
+   void serialize(tsd::common::ipc::RpcBuffer& buf) const { buf << m_stamp; }
+   void deserialize(tsd::common::ipc::RpcBuffer& buf) { buf >> m_stamp; }
+   TsdEvent* clone(void) const { return new TickInd(m_stamp); }
+
+   inline uint32_t getStamp() const { return m_stamp; }
+};
+
+/*
+ * Local events of the subscriber.
+ */
+
+class DeadInd
+   : public TsdEvent
+{
+   unsigned m_generation;
+
+public:
+   DeadInd(unsigned generation) : TsdEvent(DEAD_IND), m_generation(generation) { }
+   void serialize(tsd::common::ipc::RpcBuffer& /*buf*/) const { }
+   void deserialize(tsd::common::ipc::RpcBuffer& /*buf*/) { }
+   TsdEvent* clone(void) const { return new DeadInd(m_generation); }
+
+   inline unsigned getGeneration() const { return m_generation; }
+};
+
+class UpInd
+   : public TsdEvent
+{
+   uint32_t m_stamp;
+
+public:
+   UpInd(uint32_t stamp) : TsdEvent(UP_IND), m_stamp(stamp) { }
+   void serialize(tsd::common::ipc::RpcBuffer& /*buf*/) const { }
+   void deserialize(tsd::common::ipc::RpcBuffer& /*buf*/) { }
+   TsdEvent* clone(void) const { return new UpInd(m_stamp); }
+
+   inline uint32_t getStamp() const { return m_stamp; }
+};
+
+class QuitInd
+   : public TsdEvent
+{
+public:
+   QuitInd() : TsdEvent(QUIT_IND) { }
+   void serialize(tsd::common::ipc::RpcBuffer& /*buf*/) const { }
+   void deserialize(tsd::common::ipc::RpcBuffer& /*buf*/) { }
+   TsdEvent* clone(void) const { return new QuitInd; }
+};
+
+class TickFactory
+   : public IMessageFactory
+{
+public:
+   std::auto_ptr<TsdEvent> createEvent(uint32_t msgId) const
+   {
+      std::auto_ptr<TsdEvent> ret;
+      switch (msgId) {
+         case TICK_IND:
+            ret.reset(new TickInd);
+            break;
+      }
+      return ret;
+   }
+
+   static IMessageFactory& getInstance()
+   {
+      static TickFactory factory;
+      return factory;
+   }
+};
+
+std::string publisherName(unsigned long id)
+{
+   std::stringstream name;
+   name << "reconnect-bench-pub-" << id;
+   return name.str();
+}
+
+/*****************************************************************************/
+
+/**
+ * Broadcast a tick on @p count interfaces every @p period ms.
+ *
+ * Runs until it is killed.
+ */
+int runPublisher(const std::string &url, unsigned long count, unsigned long period)
+{
+   std::auto_ptr<IConnection> conn;
+   try {
+      conn.reset(listenDownstream(url));
+   } catch (ConnectionException &e) {
+      std::cerr << "Listen failed: " << e.what() << &std::endl;
+      return 1;
+   }
+
+   std::auto_ptr<IQueue> queue(createQueue("reconnect-bench-pub"));
+   std::vector<ILocalIfc*> ifcs;
+   for (unsigned long i = 0; i < count; i++) {
+      ifcs.push_back(queue->registerInterface(TickFactory::getInstance(), publisherName(i)));
+   }
+
+   std::cout << "ready" << &std::endl;
+
+   for (;;) {
+      tsd::common::system::Thread::sleep(static_cast<uint32_t>(period));
+      uint32_t now = tsd::common::system::Clock::getTickCounter();
+      for (std::vector<ILocalIfc*>::iterator it(ifcs.begin()); it != ifcs.end(); ++it) {
+         (*it)->broadcastMessage(std::auto_ptr<TsdEvent>(new TickInd(now)));
+      }
+   }
+}
+
+/**
+ * Forwards the commands of the benchmark from stdin to the subscriber queue.
+ */
+class ControlReader
+   : public tsd::common::system::Thread
+{
+   IQueue &m_queue;
+
+public:
+   ControlReader(IQueue &queue)
+      : tsd::common::system::Thread("control")
+      , m_queue(queue)
+   { }
+
+   void run()
+   {
+      char line[64];
+      while (std::fgets(line, sizeof(line), stdin) != NULL) {
+         unsigned long stamp = 0;
+         if (std::sscanf(line, "up %lu", &stamp) == 1) {
+            m_queue.sendSelfMessage(std::auto_ptr<TsdEvent>(
+               new UpInd(static_cast<uint32_t>(stamp))));
+         }
+      }
+      m_queue.sendSelfMessage(std::auto_ptr<TsdEvent>(new QuitInd));
+   }
+};
+
+class Subscriber
+{
+   typedef std::map<IfcAddr_t, unsigned long> Subscriptions;
+
+   std::string m_url;
+   unsigned long m_count;
+   unsigned long m_retry;
+   std::auto_ptr<IConnection> m_conn;
+   std::auto_ptr<IQueue> m_queue;
+   std::vector<IRemoteIfc*> m_ifcs;
+   Subscriptions m_subscriptions;
+   unsigned m_generation;
+
+public:
+   Subscriber(const std::string &url, unsigned long count, unsigned long retry)
+      : m_url(url)
+      , m_count(count)
+      , m_retry(retry)
+      , m_queue(createQueue("reconnect-bench-sub"))
+      , m_generation(0)
+   { }
+
+   ~Subscriber()
+   {
+      disconnect();
+   }
+
+   inline IQueue& getQueue() { return *m_queue; }
+
+   /**
+    * Connect to the upstream router until it works and subscribe to all
+    * interfaces.
+    */
+   bool connect()
+   {
+      while (m_conn.get() == NULL) {
+         try {
+            m_conn.reset(connectUpstream(m_url));
+         } catch (ConnectionException &) {
+            tsd::common::system::Thread::sleep(static_cast<uint32_t>(m_retry));
+         }
+      }
+
+      for (unsigned long i = 0; i < m_count; i++) {
+         IRemoteIfc *ifc = m_queue->connectInterface(publisherName(i),
+            TickFactory::getInstance(), 5000);
+         if (ifc == NULL) {
+            std::cerr << "Interface not found: " << publisherName(i) << &std::endl;
+            return false;
+         }
+         ifc->subscribe(TICK_IND);
+         ifc->monitor(std::auto_ptr<TsdEvent>(new DeadInd(m_generation)));
+         m_ifcs.push_back(ifc);
+         m_subscriptions[ifc->getLocalIfcAddr()] = i;
+      }
+
+      return true;
+   }
+
+   void disconnect()
+   {
+      for (std::vector<IRemoteIfc*>::iterator it(m_ifcs.begin()); it != m_ifcs.end(); ++it) {
+         delete *it;
+      }
+      m_ifcs.clear();
+      m_subscriptions.clear();
+      m_conn.reset();
+      m_generation++;
+   }
+
+   /**
+    * Get the subscription of a tick. Returns m_count for stale ticks.
+    */
+   unsigned long getSubscription(IfcAddr_t addr) const
+   {
+      Subscriptions::const_iterator it(m_subscriptions.find(addr));
+      return it != m_subscriptions.end() ? it->second : m_count;
+   }
+
+   inline bool isCurrent(unsigned generation) const { return generation == m_generation; }
+};
+
+/**
+ * Subscribe to @p count publishers and report on stdout when every
+ * subscription has received a tick that was sent after the last "up" command.
+ * Lost subscriptions are rebuilt from scratch.
+ */
+int runSubscriber(const std::string &url, unsigned long count, unsigned long retry)
+{
+   Subscriber sub(url, count, retry);
+   if (!sub.connect()) {
+      return 2;
+   }
+
+   ControlReader control(sub.getQueue());
+   control.start();
+
+   std::vector<bool> recovered(count, false);
+   unsigned long pending = count;
+   uint32_t since = tsd::common::system::Clock::getTickCounter();
+   unsigned long rebuilds = 0;
+   bool ready = false;
+   bool running = true;
+
+   while (running) {
+      std::auto_ptr<TsdEvent> msg = sub.getQueue().readMessage();
+
+      switch (msg->getEventId()) {
+         case TICK_IND:
+         {
+            TickInd *tick = dynamic_cast<TickInd*>(msg.get());
+            unsigned long i = sub.getSubscription(msg->getReceiverAddr());
+            if (tick == NULL || i >= count || recovered[i] ||
+                tsd::common::system::Clock::tickTimeBefore(tick->getStamp(), since)) {
+               break;
+            }
+
+            recovered[i] = true;
+            if (--pending == 0) {
+               if (ready) {
+                  std::cout << "recovered " << tsd::common::system::Clock::getTickCounter()
+                            << " " << rebuilds << &std::endl;
+                  rebuilds = 0;
+               } else {
+                  std::cout << "ready" << &std::endl;
+                  ready = true;
+               }
+            }
+            break;
+         }
+
+         case DEAD_IND:
+         {
+            DeadInd *ind = dynamic_cast<DeadInd*>(msg.get());
+            if (ind == NULL || !sub.isCurrent(ind->getGeneration())) {
+               break;
+            }
+
+            // the upstream router is gone, start over like any application
+            rebuilds++;
+            sub.disconnect();
+            if (!sub.connect()) {
+               return 2;
+            }
+            break;
+         }
+
+         case UP_IND:
+         {
+            UpInd *ind = dynamic_cast<UpInd*>(msg.get());
+            since = ind->getStamp();
+            recovered.assign(count, false);
+            pending = count;
+            break;
+         }
+
+         case QUIT_IND:
+            running = false;
+            break;
+      }
+   }
+
+   control.join();
+   return 0;
+}
+
+/*****************************************************************************/
+
+/**
+ * Simple TCP relay between the subscriber and the publisher.
+ */
+class Relay
+{
+   typedef std::vector< std::pair<int, int> > Links;
+
+   uint16_t m_port;
+   struct sockaddr_in m_target;
+   int m_listen;
+   Links m_links;
+
+   void forward(int from, int to, bool &alive)
+   {
+      char buf[65536];
+      ssize_t len = ::read(from, buf, sizeof(buf));
+      if (len <= 0) {
+         alive = false;
+         return;
+      }
+
+      for (ssize_t done = 0; done < len; ) {
+         ssize_t ret = ::write(to, buf + done, len - done);
+         if (ret <= 0) {
+            alive = false;
+            return;
+         }
+         done += ret;
+      }
+   }
+
+public:
+   Relay(uint16_t port, uint16_t targetPort)
+      : m_port(port)
+      , m_listen(-1)
+   {
+      std::memset(&m_target, 0, sizeof(m_target));
+      m_target.sin_family = AF_INET;
+      m_target.sin_port = htons(targetPort);
+      m_target.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   }
+
+   ~Relay()
+   {
+      close();
+   }
+
+   bool open()
+   {
+      m_listen = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      if (m_listen < 0) {
+         return false;
+      }
+
+      int one = 1;
+      ::setsockopt(m_listen, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+      struct sockaddr_in addr;
+      std::memset(&addr, 0, sizeof(addr));
+      addr.sin_family = AF_INET;
+      addr.sin_port = htons(m_port);
+      addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+      if (::bind(m_listen, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+          ::listen(m_listen, 8) < 0) {
+         ::close(m_listen);
+         m_listen = -1;
+         return false;
+      }
+
+      return true;
+   }
+
+   /**
+    * Drop all connections and refuse new ones.
+    */
+   void close()
+   {
+      for (Links::iterator it(m_links.begin()); it != m_links.end(); ++it) {
+         ::close(it->first);
+         ::close(it->second);
+      }
+      m_links.clear();
+
+      if (m_listen >= 0) {
+         ::close(m_listen);
+         m_listen = -1;
+      }
+   }
+
+   /**
+    * Shuffle data for up to @p timeout ms or until @p fd is readable.
+    *
+    * @return True if @p fd is readable
+    */
+   bool poll(int fd, int timeout)
+   {
+      std::vector<struct pollfd> fds;
+      struct pollfd pfd = { fd, POLLIN, 0 };
+      fds.push_back(pfd);
+      if (m_listen >= 0) {
+         pfd.fd = m_listen;
+         fds.push_back(pfd);
+      }
+      for (Links::iterator it(m_links.begin()); it != m_links.end(); ++it) {
+         pfd.fd = it->first;
+         fds.push_back(pfd);
+         pfd.fd = it->second;
+         fds.push_back(pfd);
+      }
+
+      if (::poll(&fds[0], fds.size(), timeout) <= 0) {
+         return false;
+      }
+
+      size_t i = 1;
+      if (m_listen >= 0) {
+         if (fds[i].revents != 0) {
+            int client = ::accept4(m_listen, NULL, NULL, SOCK_CLOEXEC);
+            int server = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (client >= 0 && server >= 0 &&
+                ::connect(server, (struct sockaddr *) &m_target, sizeof(m_target)) == 0) {
+               int one = 1;
+               ::setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+               ::setsockopt(server, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+               m_links.push_back(std::make_pair(client, server));
+            } else {
+               if (client >= 0) { ::close(client); }
+               if (server >= 0) { ::close(server); }
+            }
+         }
+         i++;
+      }
+
+      Links::iterator it(m_links.begin());
+      while (it != m_links.end() && i < fds.size()) {
+         bool alive = true;
+         if (fds[i].revents != 0) {
+            forward(it->first, it->second, alive);
+         }
+         if (alive && fds[i+1].revents != 0) {
+            forward(it->second, it->first, alive);
+         }
+         i += 2;
+
+         if (!alive) {
+            ::close(it->first);
+            ::close(it->second);
+            it = m_links.erase(it);
+         } else {
+            ++it;
+         }
+      }
+
+      return fds[0].revents != 0;
+   }
+};
+
+struct Child
+{
+   pid_t m_pid;
+   int m_input;
+   FILE *m_output;
+};
+
+/**
+ * Start another instance of this program in the given client @p mode.
+ *
+ * @return Child process or m_pid == -1 on error
+ */
+Child spawn(const char *mode, const std::string &url, unsigned long count,
+            unsigned long param)
+{
+   Child ret = { -1, -1, NULL };
+
+   std::stringstream countStr, paramStr;
+   countStr << count;
+   paramStr << param;
+   std::string countArg(countStr.str()), paramArg(paramStr.str());
+
+   int in[2], out[2];
+   if (::pipe(in) < 0) {
+      return ret;
+   }
+   if (::pipe(out) < 0) {
+      ::close(in[0]);
+      ::close(in[1]);
+      return ret;
+   }
+
+   ret.m_pid = ::fork();
+   if (ret.m_pid == 0) {
+      ::dup2(in[0], STDIN_FILENO);
+      ::dup2(out[1], STDOUT_FILENO);
+      ::close(in[0]);
+      ::close(in[1]);
+      ::close(out[0]);
+      ::close(out[1]);
+
+      const char *argv[] = { "reconnect-bench", "-x", mode, url.c_str(),
+         countArg.c_str(), paramArg.c_str(), NULL };
+      ::execv("/proc/self/exe", const_cast<char * const *>(argv));
+      ::_exit(127);
+   }
+
+   ::close(in[0]);
+   ::close(out[1]);
+   if (ret.m_pid < 0) {
+      ::close(in[1]);
+      ::close(out[0]);
+   } else {
+      ret.m_input = in[1];
+      ret.m_output = ::fdopen(out[0], "r");
+   }
+
+   return ret;
+}
+
+void reap(Child &child, bool kill)
+{
+   if (child.m_pid <= 0) {
+      return;
+   }
+
+   if (kill) {
+      ::kill(child.m_pid, SIGTERM);
+   }
+   if (child.m_input >= 0) {
+      ::close(child.m_input);
+   }
+   int status = 0;
+   ::waitpid(child.m_pid, &status, 0);
+   if (child.m_output != NULL) {
+      ::fclose(child.m_output);
+   }
+   child.m_pid = -1;
+}
+
+/**
+ * Keep the relay going until the child printed a line.
+ */
+bool readLine(Relay &relay, Child &child, std::string &line, uint32_t timeout)
+{
+   uint32_t deadline = tsd::common::system::Clock::getTickCounter() + timeout;
+   line.clear();
+
+   for (;;) {
+      uint32_t now = tsd::common::system::Clock::getTickCounter();
+      if (!tsd::common::system::Clock::tickTimeBefore(now, deadline)) {
+         return false;
+      }
+      if (!relay.poll(::fileno(child.m_output), static_cast<int>(deadline - now))) {
+         continue;
+      }
+
+      char c;
+      if (::read(::fileno(child.m_output), &c, 1) != 1) {
+         return false;
+      }
+      if (c == '\n') {
+         return true;
+      }
+      line += c;
+   }
+}
+
+/**
+ * Interrupt the uplink of a subscriber @p rounds times for @p downtime ms and
+ * print the recovery times.
+ */
+bool runMode(const char *name, const std::string &url, Relay &relay,
+             unsigned long count, unsigned long retry, unsigned long rounds,
+             unsigned long downtime)
+{
+   Child sub = spawn("sub", url, count, retry);
+   if (sub.m_pid < 0) {
+      return false;
+   }
+
+   std::string line;
+   if (!readLine(relay, sub, line, 60000) || line != "ready") {
+      std::cerr << name << ": subscriber did not start" << &std::endl;
+      reap(sub, true);
+      return false;
+   }
+
+   bool ret = true;
+   for (unsigned long round = 1; round <= rounds && ret; round++) {
+      relay.close();
+      tsd::common::system::Thread::sleep(static_cast<uint32_t>(downtime));
+
+      uint32_t up = tsd::common::system::Clock::getTickCounter();
+      if (!relay.open()) {
+         std::cerr << "Cannot open relay" << &std::endl;
+         ret = false;
+         break;
+      }
+
+      std::stringstream cmd;
+      cmd << "up " << up << "\n";
+      std::string cmdStr(cmd.str());
+      if (::write(sub.m_input, cmdStr.data(), cmdStr.size()) < 0) {
+         ret = false;
+         break;
+      }
+
+      unsigned long done = 0, rebuilds = 0;
+      if (!readLine(relay, sub, line, 60000) ||
+          std::sscanf(line.c_str(), "recovered %lu %lu", &done, &rebuilds) != 2) {
+         std::cerr << name << ": subscriber did not recover" << &std::endl;
+         ret = false;
+         break;
+      }
+
+      std::cout << std::setw(10) << name
+                << std::setw(7) << round
+                << std::setw(14) << static_cast<uint32_t>(done - up)
+                << std::setw(9) << rebuilds
+                << &std::endl;
+   }
+
+   reap(sub, false);
+   return ret;
+}
+
+} // namespace
+
+/*****************************************************************************/
+
+static void usage()
+{
+   std::cout << "Usage: tsd.communication.messaging.app.reconnect-bench [-n NUM] [-r ROUNDS] [-d DOWNTIME]\n"
+             << "                                                     [-p PERIOD] [-b BACKOFF] [-t PORT]\n"
+             << "\nOptions:\n"
+             << "  -n NUM        Number of subscriptions (default: 1000)\n"
+             << "  -r ROUNDS     Uplink restarts per mode (default: 5)\n"
+             << "  -d DOWNTIME   Time in ms the uplink is down (default: 500)\n"
+             << "  -p PERIOD     Tick period of the publishers in ms (default: 100)\n"
+             << "  -b BACKOFF    Initial reconnect delay in ms (default: 50)\n"
+             << "  -t PORT       TCP port of the publisher, the relay uses PORT+1\n"
+             << "                (default: 34570)\n"
+             << "\n"
+             << "Measures the time until all subscriptions receive events again after\n"
+             << "the uplink was restarted, once with applications that rebuild their\n"
+             << "subscriptions and once in reconnect mode."
+             << &std::endl;
+   std::exit(1);
+}
+
+int main(int /*argc*/, const char * const *argv)
+{
+   unsigned long count = 1000;
+   unsigned long rounds = 5;
+   unsigned long downtime = 500;
+   unsigned long period = 100;
+   unsigned long backoff = 50;
+   unsigned long port = 34570;
+
+   // client modes, only used internally
+   if (argv[1] != 0 && std::strcmp(argv[1], "-x") == 0) {
+      for (int i = 2; i <= 5; i++) {
+         if (argv[i] == 0) { usage(); }
+      }
+      count = std::strtoul(argv[4], 0, 0);
+      unsigned long param = std::strtoul(argv[5], 0, 0);
+      if (std::strcmp(argv[2], "pub") == 0) {
+         return runPublisher(argv[3], count, param);
+      } else if (std::strcmp(argv[2], "sub") == 0) {
+         return runSubscriber(argv[3], count, param);
+      }
+      usage();
+   }
+
+   for (const char * const *arg = argv+1; *arg != 0; arg++) {
+      if (std::strcmp(*arg, "-n") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         count = std::strtoul(*arg, 0, 0);
+         if (count == 0 || count == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-r") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         rounds = std::strtoul(*arg, 0, 0);
+         if (rounds == 0 || rounds == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-d") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         downtime = std::strtoul(*arg, 0, 0);
+         if (downtime == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-p") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         period = std::strtoul(*arg, 0, 0);
+         if (period == 0 || period == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-b") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         backoff = std::strtoul(*arg, 0, 0);
+         if (backoff == 0 || backoff == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-t") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         port = std::strtoul(*arg, 0, 0);
+         if (port == 0 || port >= 65535) { usage(); }
+      } else {
+         usage();
+      }
+   }
+
+   std::stringstream pubUrl, legacyUrl, reconnectUrl;
+   pubUrl << "tcp://127.0.0.1:" << port;
+   legacyUrl << "tcp://127.0.0.1:" << (port + 1);
+   reconnectUrl << legacyUrl.str() << "?reconnect=" << backoff << "&maxbackoff=" << (backoff * 8);
+
+   Relay relay(static_cast<uint16_t>(port + 1), static_cast<uint16_t>(port));
+   Child pub = spawn("pub", pubUrl.str(), count, period);
+   std::string line;
+   if (pub.m_pid < 0 || !readLine(relay, pub, line, 60000) || line != "ready") {
+      std::cerr << "Publisher did not start" << &std::endl;
+      reap(pub, true);
+      return 1;
+   }
+
+   if (!relay.open()) {
+      std::cerr << "Cannot open relay" << &std::endl;
+      reap(pub, true);
+      return 1;
+   }
+
+   std::cout << "      mode  round  recovery[ms] rebuilds" << &std::endl;
+   bool ok = runMode("rebuild", legacyUrl.str(), relay, count, backoff, rounds, downtime) &&
+             runMode("reconnect", reconnectUrl.str(), relay, count, backoff, rounds, downtime);
+
+   relay.close();
+   reap(pub, true);
+
+   return ok ? 0 : 2;
+}
@@ -0,0 +1,311 @@
+
+/**
+ * Multi-threaded routing benchmark.
+ *
+ * Spawns a configurable number of sender/receiver thread pairs in the local
+ * address space. Every pair has its own queues so the only shared resource is
+ * the router. The message rate is measured for 1, 2, 4, ... pairs up to the
+ * given maximum to show how unicast routing scales with the number of threads.
+ *
+ * All heap allocations are counted while the messages flow. Except for the
+ * messages themselves, which are allocated by the application, the library
+ * should not need any in the steady state.
+ */
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include <tsd/common/system/Clock.hpp>
+#include <tsd/common/system/Thread.hpp>
+#include <tsd/communication/messaging/Queue.hpp>
+
+using namespace tsd::communication::event;
+using namespace tsd::communication::messaging;
+
+namespace {
+
+const uint32_t BENCH_MSG = 1;
+
+/*
+ * Number of calls to the global operator new and new[], see below.
+ */
+unsigned long g_allocs = 0;
+
+class BenchMsg
+   : public TsdEvent
+{
+public:
+   BenchMsg() : TsdEvent(BENCH_MSG) { }
+   void serialize(tsd::common::ipc::RpcBuffer& /*buf*/) const { }
+   void deserialize(tsd::common::ipc::RpcBuffer& /*buf*/) { }
+   TsdEvent* clone(void) const { return new BenchMsg; }
+
+   // not counted, the messages are allocated by the application
+   static void* operator new(size_t size);
+   static void operator delete(void *ptr) { std::free(ptr); }
+};
+
+void* BenchMsg::operator new(size_t size)
+{
+   void *ret = std::malloc(size);
+   if (ret == NULL) {
+      throw std::bad_alloc();
+   }
+   return ret;
+}
+
+class BenchMsgFactory
+   : public IMessageFactory
+{
+public:
+   std::auto_ptr<TsdEvent> createEvent(uint32_t msgId) const
+   {
+      std::auto_ptr<TsdEvent> ret;
+      if (msgId == BENCH_MSG) {
+         ret.reset(new BenchMsg);
+      }
+      return ret;
+   }
+
+   static IMessageFactory& getInstance()
+   {
+      static BenchMsgFactory factory;
+      return factory;
+   }
+};
+
+/*****************************************************************************/
+
+class Receiver
+   : public tsd::common::system::Thread
+{
+   std::auto_ptr<IQueue> m_queue;
+   std::auto_ptr<ILocalIfc> m_ifc;
+   unsigned long m_count;
+   unsigned long m_received;
+
+   void run(); // tsd::common::system::Thread
+
+public:
+   Receiver(unsigned long count);
+
+   inline const ILocalIfc* getIfc() const { return m_ifc.get(); }
+   inline unsigned long getReceived() const { return m_received; }
+};
+
+Receiver::Receiver(unsigned long count)
+   : tsd::common::system::Thread("Receiver")
+   , m_queue(createQueue("route-bench-rx"))
+   , m_count(count)
+   , m_received(0)
+{
+   m_ifc.reset(m_queue->registerInterface(BenchMsgFactory::getInstance()));
+}
+
+void Receiver::run()
+{
+   while (m_received < m_count) {
+      std::auto_ptr<TsdEvent> msg = m_queue->readMessage(1000);
+      if (msg.get() == NULL) {
+         break;
+      }
+      m_received++;
+   }
+}
+
+class Sender
+   : public tsd::common::system::Thread
+{
+   std::auto_ptr<IQueue> m_queue;
+   std::auto_ptr<IRemoteIfc> m_ifc;
+   unsigned long m_count;
+
+   void run(); // tsd::common::system::Thread
+
+public:
+   Sender(const Receiver &receiver, unsigned long count);
+};
+
+Sender::Sender(const Receiver &receiver, unsigned long count)
+   : tsd::common::system::Thread("Sender")
+   , m_queue(createQueue("route-bench-tx"))
+   , m_count(count)
+{
+   m_ifc.reset(m_queue->connectInterface(receiver.getIfc(), BenchMsgFactory::getInstance()));
+}
+
+void Sender::run()
+{
+   for (unsigned long i = 0; i < m_count; i++) {
+      m_ifc->sendMessage(std::auto_ptr<TsdEvent>(new BenchMsg));
+   }
+}
+
+/**
+ * Run one round with @p pairs sender/receiver pairs.
+ *
+ * @return Total number of messages received
+ */
+unsigned long runRound(unsigned pairs, unsigned long count, uint32_t &elapsed,
+                       unsigned long &allocs)
+{
+   std::vector<Receiver*> receivers;
+   std::vector<Sender*> senders;
+
+   for (unsigned i = 0; i < pairs; i++) {
+      receivers.push_back(new Receiver(count));
+      senders.push_back(new Sender(*receivers.back(), count));
+   }
+
+   unsigned long startAllocs = __sync_fetch_and_add(&g_allocs, 0ul);
+   uint32_t start = tsd::common::system::Clock::getTickCounter();
+   for (unsigned i = 0; i < pairs; i++) {
+      receivers[i]->start();
+      senders[i]->start();
+   }
+
+   unsigned long total = 0;
+   for (unsigned i = 0; i < pairs; i++) {
+      senders[i]->join();
+      receivers[i]->join();
+      total += receivers[i]->getReceived();
+   }
+   elapsed = tsd::common::system::Clock::getTickCounter() - start;
+   allocs = __sync_fetch_and_add(&g_allocs, 0ul) - startAllocs;
+
+   // senders first: they reference the interfaces of the receivers
+   for (unsigned i = 0; i < pairs; i++) {
+      delete senders[i];
+      delete receivers[i];
+   }
+
+   return total;
+}
+
+} // namespace
+
+/*****************************************************************************/
+
+/*
+ * All forms of the global new and delete are replaced. They have to agree on
+ * malloc() and free(), otherwise a block could be released by a delete of the
+ * runtime that does not know where it came from.
+ */
+
+static void* countedAlloc(size_t size)
+{
+   __sync_fetch_and_add(&g_allocs, 1ul);
+   return std::malloc(size != 0 ? size : 1);
+}
+
+void* operator new(size_t size)
+{
+   void *ret = countedAlloc(size);
+   if (ret == NULL) {
+      throw std::bad_alloc();
+   }
+   return ret;
+}
+
+void* operator new[](size_t size)
+{
+   void *ret = countedAlloc(size);
+   if (ret == NULL) {
+      throw std::bad_alloc();
+   }
+   return ret;
+}
+
+void* operator new(size_t size, const std::nothrow_t &) throw()
+{
+   return countedAlloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t &) throw()
+{
+   return countedAlloc(size);
+}
+
+void operator delete(void *ptr) throw()
+{
+   std::free(ptr);
+}
+
+void operator delete[](void *ptr) throw()
+{
+   std::free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) throw()
+{
+   std::free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) throw()
+{
+   std::free(ptr);
+}
+
+/*****************************************************************************/
+
+static void usage()
+{
+   std::cout << "Usage: tsd.communication.messaging.app.route-bench [-n NUM] [-p PAIRS]\n"
+             << "\nOptions:\n"
+             << "  -n NUM        Send NUM messages per sender (default: 100000)\n"
+             << "  -p PAIRS      Maximum number of sender/receiver pairs (default: 8)\n"
+             << "\n"
+             << "Measures the local unicast message rate with 1, 2, 4, ... up to PAIRS\n"
+             << "concurrent sender/receiver thread pairs. The heap allocations of the\n"
+             << "library are reported per message."
+             << &std::endl;
+   std::exit(1);
+}
+
+int main(int /*argc*/, const char * const *argv)
+{
+   unsigned long count = 100000;
+   unsigned long maxPairs = 8;
+
+   for (const char * const *arg = argv+1; *arg != 0; arg++) {
+      if (std::strcmp(*arg, "-n") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         count = std::strtoul(*arg, 0, 0);
+         if (count == 0 || count == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-p") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         maxPairs = std::strtoul(*arg, 0, 0);
+         if (maxPairs == 0 || maxPairs == ULONG_MAX) { usage(); }
+      } else {
+         usage();
+      }
+   }
+
+   std::cout << " pairs      msgs   time[ms]      msgs/s  allocs/msg" << &std::endl;
+   for (unsigned long pairs = 1; pairs <= maxPairs; pairs *= 2) {
+      uint32_t elapsed = 0;
+      unsigned long allocs = 0;
+      unsigned long total = runRound(static_cast<unsigned>(pairs), count, elapsed, allocs);
+      unsigned long rate = elapsed ? static_cast<unsigned long>(total * 1000.0 / elapsed) : 0;
+
+      std::cout << std::setw(6) << pairs
+                << std::setw(10) << total
+                << std::setw(11) << elapsed
+                << std::setw(12) << rate
+                << std::setw(12) << std::fixed << std::setprecision(3)
+                << (total ? static_cast<double>(allocs) / total : 0.0)
+                << &std::endl;
+
+      if (total != pairs * count) {
+         std::cout << "Lost " << (pairs * count - total) << " messages!" << &std::endl;
+         return 2;
+      }
+   }
+
+   return 0;
+}
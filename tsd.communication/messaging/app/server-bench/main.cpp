@@ -0,0 +1,416 @@
+/**
+ * Downstream server scaling benchmark.
+ *
+ * Measures the aggregate message rate that a router forwards between its
+ * downstream routers depending on the number of I/O threads of the listening
+ * port. For every round the benchmark opens a listening port with 1, 2, 4,
+ * ... I/O threads and spawns a number of source/sink process pairs that
+ * connect to it. Every source sends its messages to the sink of its pair
+ * through the server, i.e. the server has to receive and send every message
+ * exactly once.
+ *
+ * The sources use a simple window based flow control. Sinks acknowledge every
+ * half window so that the queues in the server stay bounded.
+ */
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <tsd/common/system/Clock.hpp>
+#include <tsd/communication/messaging/ConnectionException.hpp>
+#include <tsd/communication/messaging/Connection.hpp>
+#include <tsd/communication/messaging/Queue.hpp>
+
+using namespace tsd::communication::event;
+using namespace tsd::communication::messaging;
+
+namespace {
+
+const uint32_t BENCH_MSG = 1;
+const uint32_t BENCH_ACK = 2;
+
+class BenchMsg
+   : public TsdEvent
+{
+public:
+   BenchMsg() : TsdEvent(BENCH_MSG) { }
+   void serialize(tsd::common::ipc::RpcBuffer& /*buf*/) const { }
+   void deserialize(tsd::common::ipc::RpcBuffer& /*buf*/) { }
+   TsdEvent* clone(void) const { return new BenchMsg; }
+};
+
+class BenchAck
+   : public TsdEvent
+{
+public:
+   BenchAck() : TsdEvent(BENCH_ACK) { }
+   void serialize(tsd::common::ipc::RpcBuffer& /*buf*/) const { }
+   void deserialize(tsd::common::ipc::RpcBuffer& /*buf*/) { }
+   TsdEvent* clone(void) const { return new BenchAck; }
+};
+
+class BenchMsgFactory
+   : public IMessageFactory
+{
+public:
+   std::auto_ptr<TsdEvent> createEvent(uint32_t msgId) const
+   {
+      std::auto_ptr<TsdEvent> ret;
+      switch (msgId) {
+         case BENCH_MSG:
+            ret.reset(new BenchMsg);
+            break;
+         case BENCH_ACK:
+            ret.reset(new BenchAck);
+            break;
+      }
+      return ret;
+   }
+
+   static IMessageFactory& getInstance()
+   {
+      static BenchMsgFactory factory;
+      return factory;
+   }
+};
+
+std::string sinkName(unsigned long id)
+{
+   std::stringstream name;
+   name << "server-bench-sink-" << id;
+   return name.str();
+}
+
+/*****************************************************************************/
+
+/**
+ * Receive @p count messages and print the tick counter of the first and last
+ * message to stdout.
+ */
+int runSink(const std::string &url, unsigned long id, unsigned long count,
+            unsigned long window)
+{
+   std::auto_ptr<IConnection> conn;
+   try {
+      conn.reset(connectUpstream(url));
+   } catch (ConnectionException &e) {
+      std::cerr << "Connection failed: " << e.what() << &std::endl;
+      return 1;
+   }
+
+   std::auto_ptr<IQueue> queue(createQueue("server-bench-sink"));
+   std::auto_ptr<ILocalIfc> ifc(queue->registerInterface(BenchMsgFactory::getInstance(),
+      sinkName(id)));
+
+   unsigned long ackEvery = window > 1 ? window / 2 : 1;
+   unsigned long received = 0;
+   uint32_t first = 0;
+   uint32_t last = 0;
+
+   while (received < count) {
+      std::auto_ptr<TsdEvent> msg = queue->readMessage(5000);
+      if (msg.get() == NULL) {
+         break;
+      }
+      if (msg->getEventId() != BENCH_MSG) {
+         continue;
+      }
+
+      last = tsd::common::system::Clock::getTickCounter();
+      if (received++ == 0) {
+         first = last;
+      }
+      if (received % ackEvery == 0) {
+         ifc->sendMessage(msg->getSenderAddr(), std::auto_ptr<TsdEvent>(new BenchAck));
+      }
+   }
+
+   std::cout << received << " " << first << " " << last << &std::endl;
+   return 0;
+}
+
+/**
+ * Send @p count messages to the sink with the same @p id.
+ */
+int runSource(const std::string &url, unsigned long id, unsigned long count,
+              unsigned long window)
+{
+   std::auto_ptr<IConnection> conn;
+   try {
+      conn.reset(connectUpstream(url));
+   } catch (ConnectionException &e) {
+      std::cerr << "Connection failed: " << e.what() << &std::endl;
+      return 1;
+   }
+
+   std::auto_ptr<IQueue> queue(createQueue("server-bench-source"));
+   std::auto_ptr<IRemoteIfc> ifc(queue->connectInterface(sinkName(id),
+      BenchMsgFactory::getInstance(), 5000));
+   if (ifc.get() == NULL) {
+      std::cerr << "Interface not found: " << sinkName(id) << &std::endl;
+      return 2;
+   }
+
+   unsigned long ackEvery = window > 1 ? window / 2 : 1;
+   unsigned long sent = 0;
+   unsigned long acked = 0;
+
+   while (sent < count) {
+      while (sent - acked >= window) {
+         std::auto_ptr<TsdEvent> msg = queue->readMessage(5000);
+         if (msg.get() == NULL) {
+            std::cerr << "Sink " << id << " stalled" << &std::endl;
+            return 2;
+         }
+         if (msg->getEventId() == BENCH_ACK) {
+            acked += ackEvery;
+         }
+      }
+
+      ifc->sendMessage(std::auto_ptr<TsdEvent>(new BenchMsg));
+      sent++;
+   }
+
+   // give the router a chance to flush the send queue
+   while (acked + ackEvery <= sent) {
+      std::auto_ptr<TsdEvent> msg = queue->readMessage(5000);
+      if (msg.get() == NULL) {
+         break;
+      }
+      if (msg->getEventId() == BENCH_ACK) {
+         acked += ackEvery;
+      }
+   }
+
+   return 0;
+}
+
+/*****************************************************************************/
+
+struct Child
+{
+   pid_t m_pid;
+   FILE *m_output;
+};
+
+/**
+ * Start another instance of this program in the given client @p mode.
+ *
+ * @return Child process or m_pid == -1 on error
+ */
+Child spawn(const char *mode, const std::string &url, unsigned long id,
+            unsigned long count, unsigned long window)
+{
+   Child ret = { -1, NULL };
+
+   std::stringstream idStr, countStr, windowStr;
+   idStr << id;
+   countStr << count;
+   windowStr << window;
+   std::string idArg(idStr.str()), countArg(countStr.str()), windowArg(windowStr.str());
+
+   int fds[2];
+   if (::pipe(fds) < 0) {
+      return ret;
+   }
+
+   ret.m_pid = ::fork();
+   if (ret.m_pid == 0) {
+      ::dup2(fds[1], STDOUT_FILENO);
+      ::close(fds[0]);
+      ::close(fds[1]);
+
+      const char *argv[] = { "server-bench", "-x", mode, url.c_str(), idArg.c_str(),
+         countArg.c_str(), windowArg.c_str(), NULL };
+      ::execv("/proc/self/exe", const_cast<char * const *>(argv));
+      ::_exit(127);
+   }
+
+   ::close(fds[1]);
+   if (ret.m_pid < 0) {
+      ::close(fds[0]);
+   } else {
+      ret.m_output = ::fdopen(fds[0], "r");
+   }
+
+   return ret;
+}
+
+bool reap(Child &child)
+{
+   int status = 0;
+   ::waitpid(child.m_pid, &status, 0);
+   if (child.m_output != NULL) {
+      ::fclose(child.m_output);
+   }
+   return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * Run one round with @p pairs source/sink processes that talk through a
+ * server with @p threads I/O threads.
+ *
+ * @return Total number of messages received by the sinks
+ */
+unsigned long runRound(const std::string &url, unsigned threads, unsigned pairs,
+                       unsigned long count, unsigned long window, uint32_t &elapsed)
+{
+   std::stringstream serverUrl;
+   serverUrl << url << (url.find('?') == std::string::npos ? "?" : "&")
+             << "iothreads=" << threads;
+
+   std::auto_ptr<IConnection> server;
+   try {
+      server.reset(listenDownstream(serverUrl.str()));
+   } catch (ConnectionException &e) {
+      std::cerr << "Listen failed: " << e.what() << &std::endl;
+      return 0;
+   }
+
+   std::vector<Child> sinks;
+   std::vector<Child> sources;
+   for (unsigned i = 0; i < pairs; i++) {
+      sinks.push_back(spawn("sink", url, i, count, window));
+   }
+   for (unsigned i = 0; i < pairs; i++) {
+      sources.push_back(spawn("source", url, i, count, window));
+   }
+
+   // all sinks run concurrently, so the round lasts from the earliest first
+   // to the latest last message
+   unsigned long total = 0;
+   uint32_t first = 0;
+   uint32_t last = 0;
+   bool valid = false;
+
+   for (unsigned i = 0; i < pairs; i++) {
+      unsigned long received = 0, sinkFirst = 0, sinkLast = 0;
+      if (sinks[i].m_output != NULL &&
+          std::fscanf(sinks[i].m_output, "%lu %lu %lu", &received, &sinkFirst, &sinkLast) == 3 &&
+          received > 0)
+      {
+         if (!valid || tsd::common::system::Clock::tickTimeBefore(sinkFirst, first)) {
+            first = static_cast<uint32_t>(sinkFirst);
+         }
+         if (!valid || tsd::common::system::Clock::tickTimeAfter(sinkLast, last)) {
+            last = static_cast<uint32_t>(sinkLast);
+         }
+         valid = true;
+         total += received;
+      }
+   }
+
+   for (unsigned i = 0; i < pairs; i++) {
+      if (sources[i].m_pid > 0 && !reap(sources[i])) {
+         std::cerr << "Source " << i << " failed" << &std::endl;
+      }
+      if (sinks[i].m_pid > 0 && !reap(sinks[i])) {
+         std::cerr << "Sink " << i << " failed" << &std::endl;
+      }
+   }
+
+   elapsed = valid ? last - first : 0;
+   return total;
+}
+
+} // namespace
+
+/*****************************************************************************/
+
+static void usage()
+{
+   std::cout << "Usage: tsd.communication.messaging.app.server-bench [-n NUM] [-c PAIRS] [-j THREADS]\n"
+             << "                                                  [-w WINDOW] [-t URL]\n"
+             << "\nOptions:\n"
+             << "  -n NUM        Send NUM messages per source (default: 100000)\n"
+             << "  -c PAIRS      Number of source/sink process pairs (default: 8)\n"
+             << "  -j THREADS    Maximum number of server I/O threads (default: 8)\n"
+             << "  -w WINDOW     Unacknowledged messages per source (default: 256)\n"
+             << "  -t URL        Server transport (default: tcp://127.0.0.1:34567)\n"
+             << "\n"
+             << "Measures the aggregate forwarding rate of a listening port with\n"
+             << "1, 2, 4, ... up to THREADS I/O threads."
+             << &std::endl;
+   std::exit(1);
+}
+
+int main(int /*argc*/, const char * const *argv)
+{
+   unsigned long count = 100000;
+   unsigned long pairs = 8;
+   unsigned long maxThreads = 8;
+   unsigned long window = 256;
+   std::string url("tcp://127.0.0.1:34567");
+
+   // client modes, only used internally
+   if (argv[1] != 0 && std::strcmp(argv[1], "-x") == 0) {
+      for (int i = 2; i <= 6; i++) {
+         if (argv[i] == 0) { usage(); }
+      }
+      unsigned long id = std::strtoul(argv[4], 0, 0);
+      count = std::strtoul(argv[5], 0, 0);
+      window = std::strtoul(argv[6], 0, 0);
+      if (std::strcmp(argv[2], "sink") == 0) {
+         return runSink(argv[3], id, count, window);
+      } else if (std::strcmp(argv[2], "source") == 0) {
+         return runSource(argv[3], id, count, window);
+      }
+      usage();
+   }
+
+   for (const char * const *arg = argv+1; *arg != 0; arg++) {
+      if (std::strcmp(*arg, "-n") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         count = std::strtoul(*arg, 0, 0);
+         if (count == 0 || count == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-c") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         pairs = std::strtoul(*arg, 0, 0);
+         if (pairs == 0 || pairs == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-j") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         maxThreads = std::strtoul(*arg, 0, 0);
+         if (maxThreads == 0 || maxThreads == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-w") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         window = std::strtoul(*arg, 0, 0);
+         if (window == 0 || window == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-t") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         url = *arg;
+      } else {
+         usage();
+      }
+   }
+
+   std::cout << "threads      msgs   time[ms]      msgs/s" << &std::endl;
+   for (unsigned long threads = 1; threads <= maxThreads; threads *= 2) {
+      uint32_t elapsed = 0;
+      unsigned long total = runRound(url, static_cast<unsigned>(threads),
+         static_cast<unsigned>(pairs), count, window, elapsed);
+      unsigned long rate = elapsed ? static_cast<unsigned long>(total * 1000.0 / elapsed) : 0;
+
+      std::cout << std::setw(7) << threads
+                << std::setw(10) << total
+                << std::setw(11) << elapsed
+                << std::setw(12) << rate
+                << &std::endl;
+
+      if (total != pairs * count) {
+         std::cout << "Lost " << (pairs * count - total) << " messages!" << &std::endl;
+         return 2;
+      }
+   }
+
+   return 0;
+}
@@ -0,0 +1,147 @@
+/**
+ * Queue timer benchmark.
+ *
+ * Arms a large number of one-shot timers on a single queue like a protocol
+ * stack with many outstanding retransmissions does. Half of them are stopped
+ * again before they expire, the rest is received from the queue. Every phase
+ * reports the achieved rate. The expiry phase additionally reports how late
+ * the latest timer message was received.
+ */
+
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <tsd/common/system/Clock.hpp>
+#include <tsd/communication/messaging/Queue.hpp>
+
+using namespace tsd::communication::event;
+using namespace tsd::communication::messaging;
+
+namespace {
+
+const uint32_t TIMER_MSG = 1;
+
+class TimerMsg
+   : public TsdEvent
+{
+public:
+   uint32_t m_deadline;
+
+   TimerMsg(uint32_t deadline) : TsdEvent(TIMER_MSG), m_deadline(deadline) { }
+   void serialize(tsd::common::ipc::RpcBuffer& /*buf*/) const { }
+   void deserialize(tsd::common::ipc::RpcBuffer& /*buf*/) { }
+   TsdEvent* clone(void) const { return new TimerMsg(m_deadline); }
+};
+
+void report(const char *phase, unsigned long count, uint32_t elapsed)
+{
+   unsigned long rate = elapsed ? static_cast<unsigned long>(count * 1000.0 / elapsed) : 0;
+   std::cout << std::setw(9) << phase
+             << std::setw(10) << count
+             << std::setw(11) << elapsed
+             << std::setw(12) << rate
+             << &std::endl;
+}
+
+} // namespace
+
+/*****************************************************************************/
+
+static void usage()
+{
+   std::cout << "Usage: tsd.communication.messaging.app.timer-bench [-n NUM] [-t MS]\n"
+             << "\nOptions:\n"
+             << "  -n NUM        Number of timers (default: 100000)\n"
+             << "  -t MS         Timers expire within MS milliseconds (default: 1000)\n"
+             << "\n"
+             << "Starts NUM one-shot timers on a single queue, stops every second\n"
+             << "one and receives the remaining timer messages."
+             << &std::endl;
+   std::exit(1);
+}
+
+int main(int /*argc*/, const char * const *argv)
+{
+   unsigned long count = 100000;
+   unsigned long spread = 1000;
+
+   for (const char * const *arg = argv+1; *arg != 0; arg++) {
+      if (std::strcmp(*arg, "-n") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         count = std::strtoul(*arg, 0, 0);
+         if (count == 0 || count == ULONG_MAX) { usage(); }
+      } else if (std::strcmp(*arg, "-t") == 0) {
+         arg++; if (*arg == 0) { usage(); }
+         spread = std::strtoul(*arg, 0, 0);
+         if (spread == 0 || spread == ULONG_MAX) { usage(); }
+      } else {
+         usage();
+      }
+   }
+
+   std::auto_ptr<IQueue> queue(createQueue("timer-bench"));
+   std::vector<TimerRef_t> timers;
+   timers.reserve(count);
+
+   std::cout << "    phase    timers   time[ms]       ops/s" << &std::endl;
+
+   // Arm timers with pseudo-random timeouts, i.e. not in expiry order
+   uint32_t start = tsd::common::system::Clock::getTickCounter();
+   uint32_t seed = 1;
+   for (unsigned long i = 0; i < count; i++) {
+      seed = seed * 1103515245u + 12345u;
+      uint32_t ms = 1 + (seed >> 8) % spread;
+      timers.push_back(queue->startTimer(std::auto_ptr<TsdEvent>(new TimerMsg(start + ms)),
+                                         ms, false));
+   }
+   uint32_t now = tsd::common::system::Clock::getTickCounter();
+   report("start", count, now - start);
+
+   // Stop every second timer, most of them are still pending
+   start = now;
+   unsigned long stopped = 0;
+   for (unsigned long i = 0; i < count; i += 2) {
+      queue->stopTimer(timers[i]);
+      stopped++;
+   }
+   now = tsd::common::system::Clock::getTickCounter();
+   report("stop", stopped, now - start);
+
+   // Receive the remaining timer messages
+   start = now;
+   unsigned long expired = 0;
+   uint32_t maxLate = 0;
+   std::vector<TsdEvent*> events;
+   events.reserve(64);
+   while (expired < count - stopped) {
+      size_t num = queue->readMessages(events, 64, spread + 1000);
+      if (num == 0) {
+         break;
+      }
+      now = tsd::common::system::Clock::getTickCounter();
+      for (std::vector<TsdEvent*>::iterator it(events.begin()); it != events.end(); ++it) {
+         uint32_t late = now - static_cast<TimerMsg*>(*it)->m_deadline;
+         if (tsd::common::system::Clock::tickTimeAfter(now, static_cast<TimerMsg*>(*it)->m_deadline)
+             && late > maxLate) {
+            maxLate = late;
+         }
+         delete *it;
+      }
+      events.clear();
+      expired += num;
+   }
+   now = tsd::common::system::Clock::getTickCounter();
+   report("expire", expired, now - start);
+   std::cout << "Latest timer message received " << maxLate << "ms late" << &std::endl;
+
+   if (expired != count - stopped) {
+      std::cout << "Lost " << (count - stopped - expired) << " timers!" << &std::endl;
+      return 2;
+   }
+
+   return 0;
+}
@@ -3,8 +3,31 @@
 
 #include <string>
 
+#include <tsd/common/types/typedef.hpp>
+
 namespace tsd { namespace communication { namespace messaging {
 
+   /**
+    * Payload compression statistics of a connection.
+    *
+    * The compression ratio is m_compressedBytes / m_rawBytes. Payloads that
+    * did not shrink are sent uncompressed and only counted as skipped but
+    * their CPU time is included.
+    */
+   struct CompressionStats
+   {
+      uint64_t m_compressedPackets;    ///< Packets sent compressed
+      uint64_t m_skippedPackets;       ///< Packets above the threshold that did not compress
+      uint64_t m_rawBytes;             ///< Payload of m_compressedPackets before...
+      uint64_t m_compressedBytes;      ///< ...and after compression
+      uint64_t m_compressTime;         ///< CPU time of all attempts in microseconds
+      uint64_t m_decompressedPackets;  ///< Compressed packets received
+      uint64_t m_decompressTime;       ///< CPU time in microseconds
+
+      CompressionStats();
+      CompressionStats& operator+=(const CompressionStats &other);
+   };
+
    /**
     * Abstract connection class.
     *
@@ -21,6 +44,33 @@ namespace tsd { namespace communication { namespace messaging {
        * Shutdown connection.
        */
       virtual void disconnect() = 0;
+
+      /**
+       * Get number of messages that were dropped because the send queue of
+       * the connection was full.
+       *
+       * The default implementation returns zero for connections without a
+       * send queue limit.
+       */
+      virtual uint64_t getDroppedPackets();
+
+      /**
+       * Get number of messages that were dropped from the send queue of the
+       * connection because their deadline had passed, see
+       * IQueue::setTimeToLive().
+       *
+       * The default implementation returns zero for connections without a
+       * send queue.
+       */
+      virtual uint64_t getExpiredPackets();
+
+      /**
+       * Get the payload compression statistics of the connection.
+       *
+       * The default implementation returns zeros for connections that do not
+       * compress.
+       */
+      virtual CompressionStats getCompressionStats();
    };
 
    class ConnectionImpl;
@@ -64,6 +114,28 @@ namespace tsd { namespace communication { namespace messaging {
       bool connectUpstream(const std::string &subDomain = "");
       bool listenDownstream();
       void disconnect();
+      uint64_t getExpiredPackets();
+      CompressionStats getCompressionStats();
+
+      /**
+       * Compress payloads of at least @p threshold bytes with @p codec if the
+       * peer has enabled compression, too. Zero disables compression, which
+       * is the default. Must be called before connectUpstream() or
+       * listenDownstream().
+       *
+       * @return False if the codec is unknown
+       */
+      bool setCompression(size_t threshold, const std::string &codec = "lz");
+
+      /**
+       * Send payloads of more than @p fragmentSize bytes in fragments if the
+       * peer can reassemble them, so that other messages are not stuck
+       * behind large ones. Zero disables fragmentation. Incoming fragments
+       * are reassembled with at most @p reassemblyLimit bytes of messages in
+       * progress. Must be called before connectUpstream() or
+       * listenDownstream().
+       */
+      void setFragmentation(size_t fragmentSize, size_t reassemblyLimit);
    };
 
    /**
@@ -80,6 +152,46 @@ namespace tsd { namespace communication { namespace messaging {
     * Currently supported protocols:
     *  * TCP: "tcp://[x.x.x.x[:port]]"
     *  * UIO: "uio:///dev/uioX"
+    *  * Shared memory on the same host: "shm://[name]"
+    *
+    * The send queue of TCP and unix connections can be limited by appending
+    * options to the URL, e.g. "tcp://10.0.0.1?sendqueue=1000&overflow=coalesce":
+    *  * sendqueue=N: maximum number of queued messages
+    *  * overflow=block|drop-oldest|drop-newest|coalesce: see OverflowPolicy,
+    *    default is drop-newest
+    *  * blocktimeout=MS: maximum blocking time for overflow=block, at most
+    *    MAX_BLOCK_TIMEOUT
+    *  * zerocopy=BYTES: send messages of at least BYTES payload with
+    *    MSG_ZEROCOPY (TCP only, ignored if the kernel does not support it)
+    *  * header=compact|fixed: packet header on the wire (TCP and UIO only).
+    *    The compact header uses variable length fields and is only used if
+    *    the peer supports it. Otherwise both sides keep the fixed header,
+    *    which is the default.
+    *  * compress=BYTES: compress payloads of at least BYTES (TCP and UIO
+    *    only). Only effective if both sides enable it and the compact header
+    *    is used. Payloads that do not shrink are sent as they are.
+    *  * codec=NAME: compression algorithm, default is "lz"
+    *  * sndbuf=BYTES, rcvbuf=BYTES: socket buffer sizes (TCP only). Data in
+    *    the kernel buffers can not be overtaken by messages of a higher
+    *    priority, see IQueue::setPriority(). Default is the system setting.
+    *  * fragment=BYTES: send larger payloads in fragments of BYTES that are
+    *    interleaved with other messages (default: 16384). Only effective if
+    *    the compact header is used. 0 sends every message in one piece.
+    *  * reassembly=BYTES: memory for partially received messages (default:
+    *    16 MiB). A message that exceeds it is dropped unless it is the only
+    *    one in progress.
+    *
+    * TCP and unix connections can survive short outages of the upstream
+    * router with "reconnect=MS". If the connection breaks a new one is tried
+    * after MS milliseconds, doubling the delay after every failed attempt.
+    * Meanwhile all messages to the upstream router are dropped. On success the
+    * previous subnet is requested again and the name registrations and
+    * subscriptions are restored, i.e. local interfaces keep their addresses
+    * and remote interfaces stay connected. If the subnet is lost anyway the
+    * usual death notifications are sent as without reconnecting.
+    *  * reconnect=MS: initial reconnect delay, 0 (default) disables
+    *    reconnecting
+    *  * maxbackoff=MS: maximum reconnect delay (default: 10000)
     *
     * @throw ConnectionException Connection could not be esablished
     *
@@ -95,6 +207,13 @@ namespace tsd { namespace communication { namespace messaging {
     * Currently supported protocols:
     *  * TCP: "tcp://[x.x.x.x[:port]]"
     *  * UIO: "uio:///dev/uioX"
+    *  * Shared memory on the same host: "shm://[name]"
+    *
+    * The same send queue options as for connectUpstream() are supported. They
+    * apply to every connected downstream router individually. TCP and unix
+    * servers additionally accept:
+    *  * iothreads=N: serve the downstream routers with N distinct I/O threads
+    *    of the pool (see configureIoThreads()), growing the pool if needed
     *
     * @throw ConnectionException Connection could not be esablished
     *
@@ -103,6 +222,23 @@ namespace tsd { namespace communication { namespace messaging {
     */
    IConnection *listenDownstream(const std::string &url);
 
+   /**
+    * Configure the I/O threads of the process.
+    *
+    * All TCP and unix connections of a process share a pool of I/O threads
+    * instead of running one thread per connection. The defaults are taken
+    * from the TSD_COMMUNICATION_REACTOR_THREADS and
+    * TSD_COMMUNICATION_REACTOR_CPUS environment variables. Changes only
+    * affect threads that are started afterwards, i.e. this should be called
+    * before the first connection is established.
+    *
+    * @param threads  Number of I/O threads (default: 1)
+    * @param cpus     Comma separated list of CPUs to pin the threads to,
+    *                 e.g. "2,3". Thread N uses the N-th CPU modulo the
+    *                 length of the list. No pinning if empty.
+    */
+   void configureIoThreads(unsigned threads, const std::string &cpus = "");
+
 } } }
 
 #endif
@@ -2,6 +2,7 @@
 #define TSD_COMMUNICATION_MESSAGING_ILOCALIFC_HPP
 
 #include <memory>
+#include <vector>
 
 #include <tsd/communication/event/TsdEvent.hpp>
 #include <tsd/communication/messaging/types.hpp>
@@ -63,6 +64,22 @@ namespace tsd { namespace communication { namespace messaging {
        */
       virtual void broadcastMessage(std::auto_ptr<tsd::communication::event::TsdEvent> msg) = 0;
 
+      /**
+       * Keep the last broadcast of the given events.
+       *
+       * Interfaces that subscribe to one of these events receive the last
+       * value that was broadcast right away instead of waiting for the next
+       * broadcastMessage(). This is meant for events that describe a state.
+       * A subscriber might see the same value twice if it is broadcast while
+       * the subscription is made.
+       *
+       * Calling the method again replaces the set of cached events. An empty
+       * set disables the cache.
+       *
+       * @param events  IDs of the events whose last broadcast is kept
+       */
+      virtual void setLastValueCache(const std::vector<uint32_t> &events) = 0;
+
       /**
        * Start monitoring a remote interface.
        *
@@ -41,6 +41,21 @@ namespace tsd { namespace communication { namespace messaging {
        * @return vector of supported message IDs
        */
       virtual std::vector<uint32_t> getEventIds() const;
+
+      /**
+       * Check if a message only carries the latest state of its event.
+       *
+       * Conflatable messages that are sent through the interface replace an
+       * older message with the same event ID, sender and receiver which is
+       * still waiting in the send queue of a port. A receiver behind a slow
+       * link thus gets the current state instead of working through all the
+       * stale ones. Messages are never reordered relative to messages that
+       * are not conflatable. The default implementation returns false.
+       *
+       * @param  msgId    Message-Id of the event
+       * @return True if older messages of the event may be discarded
+       */
+      virtual bool isConflatable(uint32_t msgId) const;
    };
 
    /**
@@ -53,16 +68,82 @@ namespace tsd { namespace communication { namespace messaging {
     */
    class IMessageSelector {
    public:
+      /**
+       * Kind of selector.
+       *
+       * The queue knows how the built-in kinds match and can find their
+       * messages without calling filterEvent() for every queued message.
+       */
+      enum SelectorKind {
+         SELECT_GENERIC,   ///< Only filterEvent() knows
+         SELECT_EVENT_ID,  ///< Messages with a certain event ID
+         SELECT_SENDER,    ///< Messages from a certain sender address
+         SELECT_MONITOR    ///< Messages of a certain monitor
+      };
+
+      IMessageSelector();
+
       /**
        * Selector function for IQueue::readMessage().
        *
-       * The method must not modify any external state. It is unspecified in
-       * which context and how often the method is called.
+       * The method must not modify any external state nor the event. It is
+       * unspecified in which context and how often the method is called.
+       * Multicast events are shared with the other receivers until they are
+       * read. Their receiver address is only valid after they were read.
        *
        * @param event  The event that should be checked
        * @return True if the message should be received.
        */
       virtual bool filterEvent(tsd::communication::event::TsdEvent *event) const = 0;
+
+      inline SelectorKind getKind() const { return m_kind; }
+      inline uint64_t getKey() const { return m_key; }
+
+   protected:
+      IMessageSelector(SelectorKind kind, uint64_t key);
+
+   private:
+      SelectorKind m_kind;
+      uint64_t m_key;
+   };
+
+   /**
+    * Select messages by their event ID.
+    */
+   class EventIdSelector
+      : public IMessageSelector
+   {
+   public:
+      explicit EventIdSelector(uint32_t eventId);
+      bool filterEvent(tsd::communication::event::TsdEvent *event) const;
+   };
+
+   /**
+    * Select messages by the address of their sender.
+    *
+    * Typically used to wait for the reply of a certain remote interface.
+    */
+   class SenderSelector
+      : public IMessageSelector
+   {
+   public:
+      explicit SenderSelector(tsd::communication::event::IfcAddr_t sender);
+      bool filterEvent(tsd::communication::event::TsdEvent *event) const;
+   };
+
+   /**
+    * Select the message of a monitor.
+    *
+    * The monitor reference is not part of the message. This selector works
+    * therefore only with the queue of the monitoring interface and
+    * filterEvent() always returns false.
+    */
+   class MonitorSelector
+      : public IMessageSelector
+   {
+   public:
+      explicit MonitorSelector(MonitorRef_t monitor);
+      bool filterEvent(tsd::communication::event::TsdEvent *event) const;
    };
 
    /**
@@ -178,7 +259,10 @@ namespace tsd { namespace communication { namespace messaging {
        * The function blocks until a new message is in the queue or the timeout
        * is reached. Multiple threads may call this function to share the work.
        * If a @p selector is given only messages that pass the selector are
-       * returned. Any other messages are left in the queue.
+       * returned. Any other messages are left in the queue. The built-in
+       * selectors (EventIdSelector, SenderSelector, MonitorSelector) are
+       * matched by the queue directly and do not need to inspect every queued
+       * message while waiting.
        *
        * @param timeout Timeout in ms to wait for new messages
        * @param selector Selector to restrict messages to a certain subset
@@ -188,6 +272,25 @@ namespace tsd { namespace communication { namespace messaging {
       readMessage(uint32_t timeout = INFINITE_TIMEOUT,
                   IMessageSelector *selector = NULL) = 0;
 
+      /**
+       * Pull a batch of messages from the queue.
+       *
+       * Works like readMessage() but takes all messages that are ready, up to
+       * @p max, at once. The call blocks only until the first message is
+       * available or the timeout has passed. The messages are appended to
+       * @p events in queue order. The caller takes ownership of them and is
+       * responsible to delete them.
+       *
+       * @param events   Vector where the received messages are appended
+       * @param max      Maximum number of messages to read
+       * @param timeout  Timeout in ms to wait for the first message
+       * @param selector Selector to restrict messages to a certain subset
+       * @return Number of messages that were appended to @p events
+       */
+      virtual size_t readMessages(std::vector<tsd::communication::event::TsdEvent*> &events,
+                                  size_t max, uint32_t timeout = INFINITE_TIMEOUT,
+                                  IMessageSelector *selector = NULL) = 0;
+
       /**
        * Send message to the loopback interface of this queue.
        *
@@ -224,6 +327,72 @@ namespace tsd { namespace communication { namespace messaging {
        * @return True if the timer was still pending.
        */
       virtual bool stopTimer(TimerRef_t timer) = 0;
+
+      /**
+       * Limit the number of messages in the queue.
+       *
+       * By default a queue is unbounded. Once the limit is set and the queue
+       * is full the @p policy decides what happens to new messages. Note that
+       * every dropped message voids the second ordering guarantee of the
+       * queue.
+       *
+       * Blocking senders do not hold any lock of the message router but
+       * removing an interface of this queue waits for them. Keep
+       * @p blockTimeout short, it is limited to MAX_BLOCK_TIMEOUT. A thread
+       * that sends to its own queue must never rely on OVERFLOW_BLOCK.
+       *
+       * @param capacity      Maximum number of messages or UNLIMITED_CAPACITY
+       * @param policy        What to do if the queue is full
+       * @param blockTimeout  Maximum time in ms a sender is blocked if
+       *                      @p policy is OVERFLOW_BLOCK
+       */
+      virtual void setCapacity(uint32_t capacity,
+                               OverflowPolicy policy = OVERFLOW_DROP_NEWEST,
+                               uint32_t blockTimeout = 100) = 0;
+
+      /**
+       * Get number of messages that were lost because the queue was full.
+       *
+       * Messages that were replaced by OVERFLOW_COALESCE are counted too.
+       *
+       * @return Number of dropped messages since the queue was created
+       */
+      virtual uint64_t getDroppedMessages() = 0;
+
+      /**
+       * Set the scheduling class of the messages that are sent from the
+       * interfaces of this queue.
+       *
+       * The class only matters for messages that leave the local address
+       * space. It is kept on every hop. Should be set before the first
+       * message is sent. The default is PRIORITY_NORMAL.
+       *
+       * @param priority  Scheduling class, see MessagePriority
+       */
+      virtual void setPriority(MessagePriority priority) = 0;
+
+      /**
+       * Set how long the messages that are sent from the interfaces of this
+       * queue stay relevant.
+       *
+       * Each message gets a deadline of @p ms after it was sent. Messages
+       * that are still queued when their deadline passes are dropped, both
+       * by the ports on the way and by the receiving queue. The deadline is
+       * only kept across routers that negotiated the compact packet header.
+       * Behind other hops the message never expires. The default is zero,
+       * i.e. messages never expire.
+       *
+       * @param ms  Time to live in ms or zero for no deadline
+       */
+      virtual void setTimeToLive(uint32_t ms) = 0;
+
+      /**
+       * Get number of messages that were dropped from this queue because
+       * their deadline had passed before they were read.
+       *
+       * @return Number of expired messages since the queue was created
+       */
+      virtual uint64_t getExpiredMessages() = 0;
    };
 
 } } }
@@ -20,6 +20,84 @@ namespace tsd { namespace communication { namespace messaging {
     */
    static const uint32_t INFINITE_TIMEOUT = uint32_t(-1);
 
+   /**
+    * Constant representing a queue without capacity limit.
+    */
+   static const uint32_t UNLIMITED_CAPACITY = 0;
+
+   /**
+    * Upper bound of the time in ms that OVERFLOW_BLOCK may block a sender.
+    * Larger timeouts, including INFINITE_TIMEOUT, are reduced to it.
+    */
+   static const uint32_t MAX_BLOCK_TIMEOUT = 10000;
+
+   /**
+    * Policy that is applied if a message hits a full queue.
+    *
+    * Only regular messages are subject to the policy. Timer messages, self
+    * messages and internal control traffic are always queued.
+    */
+   enum OverflowPolicy {
+      /**
+       * The sender waits until there is room again. The waiting time is
+       * bounded by a timeout after which the new message is dropped. Messages
+       * that are received through a connection to another router or that are
+       * sent while the router updates its multicast groups are never blocked
+       * but dropped immediately.
+       */
+      OVERFLOW_BLOCK,
+
+      /**
+       * The oldest message is discarded to make room for the new one.
+       */
+      OVERFLOW_DROP_OLDEST,
+
+      /**
+       * The new message is discarded.
+       */
+      OVERFLOW_DROP_NEWEST,
+
+      /**
+       * Last value wins: a queued message with the same event ID, sender and
+       * receiver is replaced by the new message. The new message is put at
+       * the tail of the queue. If there is no such message the new one is
+       * discarded. Meant for state events where only the latest value is of
+       * interest.
+       */
+      OVERFLOW_COALESCE
+   };
+
+   /**
+    * Scheduling class of messages that leave the router through a connection.
+    *
+    * Every connection keeps a send queue per class. Control traffic is always
+    * sent first. The other classes share the remaining bandwidth weighted
+    * in favour of the more urgent ones. Messages between the same sender and
+    * receiver are never reordered, even if their class changes.
+    */
+   enum MessagePriority {
+      /**
+       * Routing and name server traffic. Strict priority over everything
+       * else. Multicast management and death notifications always use it.
+       */
+      PRIORITY_CONTROL,
+
+      /**
+       * Small latency sensitive events.
+       */
+      PRIORITY_REALTIME,
+
+      /**
+       * Default class of all messages.
+       */
+      PRIORITY_NORMAL,
+
+      /**
+       * Large transfers that should not delay other traffic.
+       */
+      PRIORITY_BULK
+   };
+
 } } }
 
 #endif
@@ -0,0 +1,336 @@
+#include <pthread.h>
+
+#include <tsd/common/system/Mutex.hpp>
+#include <tsd/common/system/MutexGuard.hpp>
+
+#include "BlockPool.hpp"
+#include "ShardedLock.hpp"
+
+namespace tsd { namespace communication { namespace messaging {
+
+namespace {
+
+   /*
+    * Idle bytes that a shard keeps per size class, but never more than
+    * SHARD_BLOCKS and never less than two blocks. Beyond that half of them
+    * are passed to the central list at once to keep the central lock cold.
+    * All shards together pin less than 2MB this way.
+    */
+   const size_t SHARD_BYTES = 16u * 1024u;
+   const size_t SHARD_BLOCKS = 64;
+
+   /*
+    * Upper bound of idle bytes per size class in the central list. Anything
+    * beyond is freed to give the memory back after a burst.
+    */
+   const size_t CENTRAL_LIMIT = 256u * 1024u;
+
+   /*
+    * Idle bytes that a thread caches per size class without any lock, at
+    * least one block. Blocks are exchanged with the shard of the thread in
+    * batches of half of that. A thread pins less than 32KB this way.
+    */
+   const size_t CACHE_BYTES = 4u * 1024u;
+   const size_t CACHE_BLOCKS = 16;
+
+   struct FreeBlock {
+      FreeBlock *m_next;
+   };
+
+   struct FreeList {
+      FreeBlock *m_head;
+      size_t m_count;
+
+      FreeList() : m_head(NULL), m_count(0) { }
+
+      inline void push(FreeBlock *block)
+      {
+         block->m_next = m_head;
+         m_head = block;
+         m_count++;
+      }
+
+      inline FreeBlock *pop()
+      {
+         FreeBlock *block = m_head;
+         m_head = block->m_next;
+         m_count--;
+         return block;
+      }
+   };
+
+   struct Shard {
+      tsd::common::system::Mutex m_lock;
+      FreeList m_lists[BlockPool::NUM_CLASSES];
+      // keep shards on separate cache lines
+      char m_padding[64];
+   };
+
+   struct Pool {
+      Shard m_shards[ShardedLock::NUM_SHARDS];
+      tsd::common::system::Mutex m_lock;
+      FreeList m_central[BlockPool::NUM_CLASSES];
+   };
+
+   /*
+    * Per-thread cache in front of the shards. Zero initialized, as required
+    * for __thread. Registered with a pthread key on first use, so that the
+    * cached blocks are passed on to the shard when the thread exits.
+    */
+   struct ThreadCache {
+      FreeBlock *m_heads[BlockPool::NUM_CLASSES];
+      size_t m_counts[BlockPool::NUM_CLASSES];
+      bool m_registered;
+   };
+
+   __thread ThreadCache s_cache;
+   pthread_key_t s_cacheKey;
+   pthread_once_t s_cacheOnce = PTHREAD_ONCE_INIT;
+
+   /*
+    * Never destroyed. Packets may still be around while static objects are
+    * destructed.
+    */
+   Pool& getPool()
+   {
+      static Pool *pool = new Pool;
+      return *pool;
+   }
+
+   inline unsigned sizeClass(size_t size)
+   {
+      unsigned cls = 0;
+      size_t block = BlockPool::MIN_BLOCK;
+      while (block < size) {
+         block <<= 1;
+         cls++;
+      }
+      return cls;
+   }
+
+   inline size_t classSize(unsigned cls)
+   {
+      return static_cast<size_t>(BlockPool::MIN_BLOCK) << cls;
+   }
+
+   inline size_t shardLimit(unsigned cls)
+   {
+      size_t limit = SHARD_BYTES / classSize(cls);
+      if (limit > SHARD_BLOCKS) {
+         limit = SHARD_BLOCKS;
+      } else if (limit < 2) {
+         limit = 2;
+      }
+      return limit;
+   }
+
+   inline size_t batchSize(unsigned cls)
+   {
+      return shardLimit(cls) / 2;
+   }
+
+   inline size_t cacheLimit(unsigned cls)
+   {
+      size_t limit = CACHE_BYTES / classSize(cls);
+      if (limit > CACHE_BLOCKS) {
+         limit = CACHE_BLOCKS;
+      } else if (limit < 1) {
+         limit = 1;
+      }
+      return limit;
+   }
+
+   inline size_t cacheBatch(unsigned cls)
+   {
+      size_t batch = cacheLimit(cls) / 2;
+      return batch < 1 ? 1 : batch;
+   }
+
+   inline size_t countBytes(const FreeList &list, unsigned cls)
+   {
+      return list.m_count * classSize(cls);
+   }
+
+   /*
+    * Take up to cacheBatch() blocks from the shard of the calling thread,
+    * which refills from the central list if it ran empty.
+    */
+   void refillCache(ThreadCache &cache, unsigned cls)
+   {
+      Pool &pool = getPool();
+      Shard &shard = pool.m_shards[ShardedLock::currentShard()];
+      tsd::common::system::MutexGuard g(shard.m_lock);
+      FreeList &list = shard.m_lists[cls];
+      if (list.m_head == NULL) {
+         tsd::common::system::MutexGuard cg(pool.m_lock);
+         FreeList &central = pool.m_central[cls];
+         size_t batch = batchSize(cls);
+         while (central.m_head != NULL && list.m_count < batch) {
+            list.push(central.pop());
+         }
+      }
+
+      size_t batch = cacheBatch(cls);
+      while (list.m_head != NULL && cache.m_counts[cls] < batch) {
+         FreeBlock *block = list.pop();
+         block->m_next = cache.m_heads[cls];
+         cache.m_heads[cls] = block;
+         cache.m_counts[cls]++;
+      }
+   }
+
+   /*
+    * Give @p blocks to the shard of the calling thread. If it grows beyond
+    * its limit a batch is passed on to the central list and whatever does
+    * not fit there goes back to the heap.
+    */
+   void releaseToShard(FreeList &blocks, unsigned cls)
+   {
+      Pool &pool = getPool();
+      Shard &shard = pool.m_shards[ShardedLock::currentShard()];
+      FreeList excess;
+      {
+         tsd::common::system::MutexGuard g(shard.m_lock);
+         FreeList &list = shard.m_lists[cls];
+         while (blocks.m_head != NULL) {
+            list.push(blocks.pop());
+         }
+         if (list.m_count <= shardLimit(cls)) {
+            return;
+         }
+
+         tsd::common::system::MutexGuard cg(pool.m_lock);
+         FreeList &central = pool.m_central[cls];
+         size_t limit = CENTRAL_LIMIT / classSize(cls);
+         size_t keep = shardLimit(cls) - batchSize(cls);
+         while (list.m_count > keep) {
+            if (central.m_count < limit) {
+               central.push(list.pop());
+            } else {
+               excess.push(list.pop());
+            }
+         }
+      }
+
+      // free outside of the locks
+      while (excess.m_head != NULL) {
+         ::operator delete(excess.pop());
+      }
+   }
+
+   /*
+    * Destructor of s_cacheKey, called when a thread exits.
+    */
+   void flushCache(void *arg)
+   {
+      ThreadCache &cache = *static_cast<ThreadCache*>(arg);
+      for (unsigned cls = 0; cls < BlockPool::NUM_CLASSES; cls++) {
+         FreeList blocks;
+         blocks.m_head = cache.m_heads[cls];
+         blocks.m_count = cache.m_counts[cls];
+         cache.m_heads[cls] = NULL;
+         cache.m_counts[cls] = 0;
+         releaseToShard(blocks, cls);
+      }
+
+      // blocks that are released later by the same thread register it again
+      cache.m_registered = false;
+   }
+
+   void createCacheKey()
+   {
+      (void)pthread_key_create(&s_cacheKey, flushCache);
+   }
+
+   inline ThreadCache& getCache()
+   {
+      ThreadCache &cache = s_cache;
+      if (!cache.m_registered) {
+         (void)pthread_once(&s_cacheOnce, createCacheKey);
+         (void)pthread_setspecific(s_cacheKey, &cache);
+         cache.m_registered = true;
+      }
+      return cache;
+   }
+
+}
+
+void* BlockPool::allocate(size_t size)
+{
+   if (size > MAX_BLOCK) {
+      return ::operator new(size);
+   }
+
+   unsigned cls = sizeClass(size);
+   ThreadCache &cache = getCache();
+   if (cache.m_heads[cls] == NULL) {
+      refillCache(cache, cls);
+   }
+
+   FreeBlock *block = cache.m_heads[cls];
+   if (block != NULL) {
+      cache.m_heads[cls] = block->m_next;
+      cache.m_counts[cls]--;
+      return block;
+   }
+
+   return ::operator new(classSize(cls));
+}
+
+void BlockPool::release(void *block, size_t size)
+{
+   if (block == NULL) {
+      return;
+   }
+   if (size > MAX_BLOCK) {
+      ::operator delete(block);
+      return;
+   }
+
+   unsigned cls = sizeClass(size);
+   ThreadCache &cache = getCache();
+   FreeBlock *freed = static_cast<FreeBlock*>(block);
+   freed->m_next = cache.m_heads[cls];
+   cache.m_heads[cls] = freed;
+   cache.m_counts[cls]++;
+   if (cache.m_counts[cls] <= cacheLimit(cls)) {
+      return;
+   }
+
+   FreeList blocks;
+   for (size_t i = cacheBatch(cls); i > 0; i--) {
+      FreeBlock *b = cache.m_heads[cls];
+      cache.m_heads[cls] = b->m_next;
+      cache.m_counts[cls]--;
+      blocks.push(b);
+   }
+   releaseToShard(blocks, cls);
+}
+
+size_t BlockPool::getBlockSize(size_t size)
+{
+   return size > MAX_BLOCK ? size : classSize(sizeClass(size));
+}
+
+size_t BlockPool::getIdleBytes()
+{
+   Pool &pool = getPool();
+   size_t bytes = 0;
+
+   for (unsigned i = 0; i < ShardedLock::NUM_SHARDS; i++) {
+      Shard &shard = pool.m_shards[i];
+      tsd::common::system::MutexGuard g(shard.m_lock);
+      for (unsigned cls = 0; cls < NUM_CLASSES; cls++) {
+         bytes += countBytes(shard.m_lists[cls], cls);
+      }
+   }
+
+   tsd::common::system::MutexGuard g(pool.m_lock);
+   for (unsigned cls = 0; cls < NUM_CLASSES; cls++) {
+      bytes += countBytes(pool.m_central[cls], cls);
+   }
+
+   return bytes;
+}
+
+} } }
@@ -0,0 +1,132 @@
+#ifndef TSD_COMMUNICATION_MESSAGING_BLOCKPOOL_HPP
+#define TSD_COMMUNICATION_MESSAGING_BLOCKPOOL_HPP
+
+#include <stddef.h>
+
+#include <limits>
+#include <new>
+
+namespace tsd { namespace communication { namespace messaging {
+
+/**
+ * Size class allocator for the small objects on the message paths.
+ *
+ * Requests are rounded up to a power of two between MIN_BLOCK and MAX_BLOCK.
+ * Freed blocks are kept on per-class free lists and handed out again, so a
+ * steady message flow does not call the heap at all. Larger requests go
+ * directly to the heap.
+ *
+ * Every thread keeps a few blocks per class in a cache of its own that is
+ * used without any lock. It exchanges batches of blocks with the free lists
+ * behind it and hands all of them on when the thread exits.
+ *
+ * The free lists are split into shards like ShardedLock. Every thread uses
+ * the shard that belongs to it and hence does (mostly) not contend with the
+ * others. A shard that grows beyond its limit passes a batch of blocks to a
+ * central list where other shards can refill from. This balances the typical
+ * case of one thread allocating and another thread freeing. Only blocks
+ * beyond the limit of the central list are given back to the heap. All
+ * limits are in bytes, so fewer large blocks are kept than small ones.
+ *
+ * The caller has to pass the requested size again when freeing a block.
+ */
+class BlockPool
+{
+public:
+   enum {
+      MIN_BLOCK = 32,
+      MAX_BLOCK = 8192,
+      NUM_CLASSES = 9   // MIN_BLOCK << (NUM_CLASSES-1) == MAX_BLOCK
+   };
+
+   /**
+    * Get a block of at least @p size bytes. Never returns NULL.
+    */
+   static void* allocate(size_t size);
+
+   /**
+    * Give back a block that was allocated with the same @p size.
+    */
+   static void release(void *block, size_t size);
+
+   /**
+    * Number of usable bytes of a block that was allocated for @p size.
+    */
+   static size_t getBlockSize(size_t size);
+
+   /**
+    * Number of bytes that are kept in the free lists for reuse. Blocks in the
+    * caches of the threads are not included.
+    */
+   static size_t getIdleBytes();
+};
+
+/**
+ * Standard allocator on top of BlockPool, e.g. for the nodes of containers.
+ */
+template<typename T>
+class PoolAllocator
+{
+public:
+   typedef T value_type;
+   typedef T* pointer;
+   typedef const T* const_pointer;
+   typedef T& reference;
+   typedef const T& const_reference;
+   typedef size_t size_type;
+   typedef ptrdiff_t difference_type;
+
+   template<typename U>
+   struct rebind {
+      typedef PoolAllocator<U> other;
+   };
+
+   PoolAllocator() { }
+   PoolAllocator(const PoolAllocator &) { }
+   template<typename U>
+   PoolAllocator(const PoolAllocator<U> &) { }
+
+   inline pointer address(reference x) const { return &x; }
+   inline const_pointer address(const_reference x) const { return &x; }
+
+   inline pointer allocate(size_type n, const void * = 0)
+   {
+      return static_cast<pointer>(BlockPool::allocate(n * sizeof(T)));
+   }
+
+   inline void deallocate(pointer p, size_type n)
+   {
+      BlockPool::release(p, n * sizeof(T));
+   }
+
+   inline size_type max_size() const
+   {
+      return std::numeric_limits<size_type>::max() / sizeof(T);
+   }
+
+   inline void construct(pointer p, const T &val)
+   {
+      new (static_cast<void*>(p)) T(val);
+   }
+
+   inline void destroy(pointer p)
+   {
+      p->~T();
+   }
+};
+
+template<typename T, typename U>
+inline bool operator==(const PoolAllocator<T> &, const PoolAllocator<U> &)
+{
+   return true;
+}
+
+template<typename T, typename U>
+inline bool operator!=(const PoolAllocator<T> &, const PoolAllocator<U> &)
+{
+   return false;
+}
+
+} } }
+
+#endif
@@ -0,0 +1,310 @@
+#include <cstring>
+
+#include <tsd/common/ipc/networkinteger.h>
+#include <tsd/communication/messaging/utils.hpp>
+
+#include "CompactHeader.hpp"
+#include "Packet.hpp"
+
+using tsd::common::ipc::NetworkInteger;
+using tsd::communication::event::IfcAddr_t;
+using tsd::communication::messaging::CompactHeader;
+using tsd::communication::messaging::HeaderFields;
+using tsd::communication::messaging::Packet;
+
+namespace {
+
+   enum AddrMode {
+      ADDR_LITERAL   = 0,
+      ADDR_LOCAL     = 1,  // relative to the local base of the sender
+      ADDR_PEER      = 2,  // relative to the peer base of the sender
+   };
+
+   const uint8_t MODE_EXTENSION = 0x80u;
+
+   const unsigned EXT_FRAGMENT_SHIFT = 2;
+   const uint8_t EXT_TIME_TO_LIVE = 0x10u;
+   const uint8_t EXT_CONFLATABLE = 0x20u;
+
+   inline tsd::communication::messaging::MessagePriority defaultPriority(uint8_t type)
+   {
+      return Packet::isMessage(static_cast<Packet::Type>(type))
+         ? tsd::communication::messaging::PRIORITY_NORMAL
+         : tsd::communication::messaging::PRIORITY_CONTROL;
+   }
+
+   // Payload of Packet::COMPACT_HEADER
+   struct CompactMarker {
+      NetworkInteger<uint32_t>   m_version;
+      NetworkInteger<uint32_t>   m_codecs;     // codecs (bit 0-15) and features (bit 16-31)
+      NetworkInteger<uint64_t>   m_localBase;
+      NetworkInteger<uint64_t>   m_peerBase;
+   };
+
+   inline size_t varintSize(uint64_t val)
+   {
+      size_t ret = 1;
+      while (val >= 0x80u) {
+         val >>= 7;
+         ret++;
+      }
+      return ret;
+   }
+
+   inline uint8_t* putVarint(uint8_t *p, uint64_t val)
+   {
+      while (val >= 0x80u) {
+         *p++ = static_cast<uint8_t>(val | 0x80u);
+         val >>= 7;
+      }
+      *p++ = static_cast<uint8_t>(val);
+      return p;
+   }
+
+   /**
+    * Read a varint of at most @p maxBytes bytes. Longer ones are cut off
+    * which yields garbage but keeps the stream in sync.
+    *
+    * @return Position behind the varint or NULL if the buffer ends before
+    */
+   inline const uint8_t* getVarint(const uint8_t *p, const uint8_t *end,
+                                   size_t maxBytes, uint64_t &val)
+   {
+      val = 0;
+      for (size_t i = 0; i < maxBytes; i++) {
+         if (p == end) {
+            return NULL;
+         }
+         uint8_t b = *p++;
+         val |= static_cast<uint64_t>(b & 0x7fu) << (7u * i);
+         if ((b & 0x80u) == 0) {
+            break;
+         }
+      }
+      return p;
+   }
+
+   inline uint64_t hostDelta(IfcAddr_t addr, IfcAddr_t base)
+   {
+      return (addr ^ base) >> tsd::communication::messaging::INTERFACE_ADDR_SIZE;
+   }
+
+   inline size_t relativeSize(IfcAddr_t addr, IfcAddr_t base)
+   {
+      return varintSize(hostDelta(addr, base)) +
+             varintSize(addr & tsd::communication::messaging::INTERFACE_ADDR_MASK);
+   }
+
+   AddrMode selectMode(IfcAddr_t addr, IfcAddr_t localBase, IfcAddr_t peerBase)
+   {
+      AddrMode mode = ADDR_LITERAL;
+      size_t best = varintSize(addr);
+
+      size_t size = relativeSize(addr, localBase);
+      if (size < best) {
+         mode = ADDR_LOCAL;
+         best = size;
+      }
+      size = relativeSize(addr, peerBase);
+      if (size < best) {
+         mode = ADDR_PEER;
+      }
+
+      return mode;
+   }
+
+   uint8_t* putAddr(uint8_t *p, AddrMode mode, IfcAddr_t addr, IfcAddr_t base)
+   {
+      if (mode == ADDR_LITERAL) {
+         return putVarint(p, addr);
+      }
+
+      p = putVarint(p, hostDelta(addr, base));
+      return putVarint(p, addr & tsd::communication::messaging::INTERFACE_ADDR_MASK);
+   }
+
+   const uint8_t* getAddr(const uint8_t *p, const uint8_t *end, unsigned mode,
+                          IfcAddr_t localBase, IfcAddr_t peerBase, IfcAddr_t &addr)
+   {
+      if (mode == ADDR_LITERAL) {
+         return getVarint(p, end, 10, addr);
+      }
+
+      uint64_t delta, ifc;
+      p = getVarint(p, end, 6, delta);
+      if (p != NULL) {
+         p = getVarint(p, end, 4, ifc);
+      }
+      if (p != NULL) {
+         IfcAddr_t base = (mode == ADDR_PEER) ? peerBase : localBase;
+         addr = ((delta << tsd::communication::messaging::INTERFACE_ADDR_SIZE) ^ base) &
+                tsd::communication::messaging::HOST_ADDR_MASK;
+         addr |= ifc & tsd::communication::messaging::INTERFACE_ADDR_MASK;
+      }
+      return p;
+   }
+
+}
+
+CompactHeader::CompactHeader()
+   : m_localBase(0)
+   , m_peerBase(0)
+   , m_codecs(0)
+   , m_features(0)
+{
+}
+
+CompactHeader::CompactHeader(IfcAddr_t localBase, IfcAddr_t peerBase)
+   : m_localBase(localBase)
+   , m_peerBase(peerBase)
+   , m_codecs(0)
+   , m_features(0)
+{
+}
+
+size_t CompactHeader::encode(uint8_t *buf, const Packet &pkt) const
+{
+   return encode(buf, pkt, static_cast<uint32_t>(pkt.getBufferLength()), 0);
+}
+
+size_t CompactHeader::encode(uint8_t *buf, const Packet &pkt, uint32_t length, uint8_t fragment,
+                             uint32_t timeToLive) const
+{
+   AddrMode senderMode = selectMode(pkt.getSenderAddr(), m_localBase, m_peerBase);
+   AddrMode receiverMode = selectMode(pkt.getReceiverAddr(), m_localBase, m_peerBase);
+
+   uint8_t modes = static_cast<uint8_t>(senderMode | (receiverMode << 2) | ((pkt.getCodec() & 7u) << 4));
+   bool extension = fragment != 0 || timeToLive != 0 || pkt.isConflatable() ||
+                    pkt.getPriority() != defaultPriority(static_cast<uint8_t>(pkt.getType()));
+   if (extension) {
+      modes |= MODE_EXTENSION;
+   }
+
+   uint8_t *p = buf;
+   *p++ = static_cast<uint8_t>(pkt.getType());
+   *p++ = modes;
+   if (extension) {
+      uint8_t ext = static_cast<uint8_t>((pkt.getPriority() & 3u) | ((fragment & 3u) << EXT_FRAGMENT_SHIFT));
+      if (timeToLive != 0) {
+         ext |= EXT_TIME_TO_LIVE;
+      }
+      if (pkt.isConflatable()) {
+         ext |= EXT_CONFLATABLE;
+      }
+      *p++ = ext;
+      if (fragment == FRAGMENT_MORE) {
+         p = putVarint(p, pkt.getBufferLength());
+      }
+      if (timeToLive != 0) {
+         p = putVarint(p, timeToLive);
+      }
+   }
+   p = putVarint(p, length);
+   p = putVarint(p, pkt.getEventId());
+   p = putAddr(p, senderMode, pkt.getSenderAddr(),
+               senderMode == ADDR_PEER ? m_peerBase : m_localBase);
+   p = putAddr(p, receiverMode, pkt.getReceiverAddr(),
+               receiverMode == ADDR_PEER ? m_peerBase : m_localBase);
+
+   return static_cast<size_t>(p - buf);
+}
+
+size_t CompactHeader::decode(const uint8_t *buf, size_t len, HeaderFields &hdr) const
+{
+   if (len < 2) {
+      return 0;
+   }
+
+   const uint8_t *end = buf + len;
+   const uint8_t *p = buf + 2;
+   uint64_t msgLen, eventId;
+
+   hdr.m_priority = static_cast<uint8_t>(defaultPriority(buf[0]));
+   hdr.m_fragment = 0;
+   hdr.m_totalLen = 0;
+   hdr.m_timeToLive = 0;
+   hdr.m_conflatable = false;
+   if (buf[1] & MODE_EXTENSION) {
+      if (p == end) {
+         return 0;
+      }
+      uint8_t ext = *p++;
+      hdr.m_priority = ext & 3u;
+      hdr.m_fragment = (ext >> EXT_FRAGMENT_SHIFT) & 3u;
+      hdr.m_conflatable = (ext & EXT_CONFLATABLE) != 0;
+      if (hdr.m_fragment == FRAGMENT_MORE) {
+         uint64_t totalLen;
+         p = getVarint(p, end, 5, totalLen);
+         if (p == NULL) {
+            return 0;
+         }
+         hdr.m_totalLen = static_cast<uint32_t>(totalLen);
+      }
+      if (ext & EXT_TIME_TO_LIVE) {
+         uint64_t timeToLive;
+         p = getVarint(p, end, 5, timeToLive);
+         if (p == NULL) {
+            return 0;
+         }
+         hdr.m_timeToLive = static_cast<uint32_t>(timeToLive);
+      }
+   }
+
+   p = getVarint(p, end, 5, msgLen);
+   if (p != NULL) {
+      p = getVarint(p, end, 5, eventId);
+   }
+   if (p != NULL) {
+      p = getAddr(p, end, buf[1] & 3u, m_localBase, m_peerBase, hdr.m_senderAddr);
+   }
+   if (p != NULL) {
+      p = getAddr(p, end, (buf[1] >> 2) & 3u, m_localBase, m_peerBase, hdr.m_receiverAddr);
+   }
+   if (p == NULL) {
+      return 0;
+   }
+
+   hdr.m_type = buf[0];
+   hdr.m_codec = (buf[1] >> 4) & 7u;
+   hdr.m_msgLen = static_cast<uint32_t>(msgLen);
+   hdr.m_eventId = static_cast<uint32_t>(eventId);
+
+   return static_cast<size_t>(p - buf);
+}
+
+std::auto_ptr<Packet> CompactHeader::createMarker() const
+{
+   CompactMarker marker;
+   std::memset(&marker, 0, sizeof(marker));
+   marker.m_version = 1;
+   marker.m_codecs = (m_codecs & 0xffffu) | (m_features << 16);
+   marker.m_localBase = m_localBase;
+   marker.m_peerBase = m_peerBase;
+
+   return std::auto_ptr<Packet>(new Packet(Packet::COMPACT_HEADER, 0, 0, 0,
+      (const char*)&marker, sizeof(marker)));
+}
+
+bool CompactHeader::parseMarker(Packet &pkt)
+{
+   CompactMarker marker;
+   if (pkt.getBufferLength() != sizeof(marker)) {
+      return false;
+   }
+   std::memcpy(&marker, pkt.getBufferPtr(), sizeof(marker));
+
+   if (marker.m_version != 1) {
+      return false;
+   }
+
+   m_localBase = marker.m_localBase;
+   m_peerBase = marker.m_peerBase;
+   m_codecs = marker.m_codecs & 0xffffu;
+   m_features = marker.m_codecs >> 16;
+   return true;
+}
+
+CompactHeader CompactHeader::reverse() const
+{
+   return CompactHeader(m_peerBase, m_localBase);
+}
@@ -0,0 +1,192 @@
+#ifndef TSD_COMMUNICATION_MESSAGING_COMPACTHEADER_HPP
+#define TSD_COMMUNICATION_MESSAGING_COMPACTHEADER_HPP
+
+#include <stddef.h>
+#include <memory>
+
+#include <tsd/common/types/typedef.hpp>
+#include <tsd/communication/event/TsdEvent.hpp>
+
+namespace tsd { namespace communication { namespace messaging {
+
+class Packet;
+
+/**
+ * Position of a fragment in its packet, see HeaderFields::m_fragment.
+ */
+enum FragmentFlags {
+   FRAGMENT_MORE = 1,   // more fragments follow
+   FRAGMENT_CONT = 2    // continues a packet, i.e. not the first fragment
+};
+
+enum {
+   DEFAULT_FRAGMENT_SIZE = 16384,                  // fits into a ReceiveSlab
+   DEFAULT_REASSEMBLY_LIMIT = 16 * 1024 * 1024     // bytes of packets in progress
+};
+
+/**
+ * Packet header fields as they were read from a stream transport.
+ */
+struct HeaderFields {
+   uint32_t m_msgLen;
+   uint32_t m_eventId;
+   tsd::communication::event::IfcAddr_t m_senderAddr;
+   tsd::communication::event::IfcAddr_t m_receiverAddr;
+   uint8_t m_type;
+   uint8_t m_codec;     // see PayloadCodec, always zero in the fixed header
+   uint8_t m_priority;  // MessagePriority
+   uint8_t m_fragment;  // FragmentFlags, zero for a whole packet
+   uint32_t m_totalLen; // payload of the whole packet, only in the first fragment
+   uint32_t m_timeToLive; // remaining ms until the message is stale, zero if it never is
+   bool m_conflatable;  // see Packet::isConflatable()
+};
+
+/**
+ * Variable length packet header of the stream transports.
+ *
+ * The stream transports start with a fixed size header on every connection.
+ * If the downstream router offers it, the upstream side switches to the
+ * compact header by sending a Packet::COMPACT_HEADER packet. It is the last
+ * packet with a fixed header in this direction. The type is reserved for the
+ * marker. Other packets never switch the header, whatever their type. The other side answers with
+ * its own marker and switches the reverse direction.
+ *
+ * The marker carries two base addresses, normally the local and peer address
+ * of the sending port. Every address is transmitted relative to the closer
+ * base, so only the differing host bits and the interface go over the wire.
+ * Lengths and event IDs are varints. The layout is:
+ *
+ *    type        1 byte
+ *    modes       1 byte, address encoding of sender (bit 0-1) and receiver (bit 2-3),
+ *                payload codec (bit 4-6), extension present (bit 7)
+ *    extension   1 byte if present, priority (bit 0-1), FragmentFlags (bit 2-3),
+ *                time to live present (bit 4), conflatable (bit 5)
+ *    totalLen    varint, only in the first fragment
+ *    timeToLive  varint, remaining ms until the message is stale
+ *    msgLen      varint
+ *    eventId     varint
+ *    sender      varint or varint host delta + varint interface
+ *    receiver    varint or varint host delta + varint interface
+ *
+ * The extension is only sent for fragments, messages with a deadline,
+ * conflatable messages and if the priority is not the default of the packet
+ * type, see Packet::getPriority(). Older peers ignore the conflatable bit.
+ * The deadline travels as the remaining time because the tick counters of
+ * the routers are not related.
+ *
+ * The encoding is determined by the sender's bases. The receiver must use the
+ * bases of the marker it got from its peer. Additionally the marker tells
+ * the peer which payload codecs and features the sender can decode. They
+ * share one field on the wire, codecs in the lower and features in the upper
+ * 16 bits.
+ */
+class CompactHeader
+{
+   tsd::communication::event::IfcAddr_t m_localBase;
+   tsd::communication::event::IfcAddr_t m_peerBase;
+   uint32_t m_codecs;
+   uint32_t m_features;
+
+public:
+   enum { MAX_SIZE = 1 + 1 + 1 + 5 + 5 + 5 + 5 + 10 + 10 };
+
+   enum Feature {
+      FEATURE_FRAGMENTS = 1,     // reassembles fragmented packets
+      FEATURE_TIME_TO_LIVE = 2   // decodes the time to live of messages
+   };
+
+   CompactHeader();
+   CompactHeader(tsd::communication::event::IfcAddr_t localBase,
+                 tsd::communication::event::IfcAddr_t peerBase);
+
+   inline tsd::communication::event::IfcAddr_t getLocalBase() const
+   {
+      return m_localBase;
+   }
+
+   inline tsd::communication::event::IfcAddr_t getPeerBase() const
+   {
+      return m_peerBase;
+   }
+
+   /**
+    * Bit mask of the PayloadCodec IDs that the sender of the marker decodes.
+    */
+   inline uint32_t getCodecs() const
+   {
+      return m_codecs;
+   }
+
+   inline void setCodecs(uint32_t codecs)
+   {
+      m_codecs = codecs;
+   }
+
+   /**
+    * Bit mask of the features that the sender of the marker supports.
+    */
+   inline uint32_t getFeatures() const
+   {
+      return m_features;
+   }
+
+   inline void setFeatures(uint32_t features)
+   {
+      m_features = features;
+   }
+
+   /**
+    * Encode the header of @p pkt.
+    *
+    * @param buf  Buffer of at least MAX_SIZE bytes
+    * @return Size of the header
+    */
+   size_t encode(uint8_t *buf, const Packet &pkt) const;
+
+   /**
+    * Encode the header of a fragment of @p pkt with @p length bytes of
+    * payload. The first fragment carries the payload length of @p pkt.
+    *
+    * @param buf         Buffer of at least MAX_SIZE bytes
+    * @param fragment    FragmentFlags, zero for the whole packet
+    * @param timeToLive  Remaining ms of the message, zero if it has no
+    *                    deadline. Only for peers with FEATURE_TIME_TO_LIVE.
+    * @return Size of the header
+    */
+   size_t encode(uint8_t *buf, const Packet &pkt, uint32_t length, uint8_t fragment,
+                 uint32_t timeToLive = 0) const;
+
+   /**
+    * Decode a header.
+    *
+    * @param buf  Received data
+    * @param len  Number of bytes available at @p buf
+    * @param hdr  Decoded fields
+    * @return Size of the header or 0 if it is not complete yet
+    */
+   size_t decode(const uint8_t *buf, size_t len, HeaderFields &hdr) const;
+
+   /**
+    * Create the marker that announces this encoding to the peer.
+    */
+   std::auto_ptr<Packet> createMarker() const;
+
+   /**
+    * Take over the bases, codecs and features of a marker that was sent by
+    * the peer.
+    *
+    * @return False if the marker is malformed
+    */
+   bool parseMarker(Packet &pkt);
+
+   /**
+    * Bases of the answer to a marker. They are the bases of the peer's
+    * marker seen from this side of the connection. The codecs and features
+    * are not taken over.
+    */
+   CompactHeader reverse() const;
+};
+
+} } }
+
+#endif
@@ -13,8 +13,10 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
+#include "Reactor.hpp"
 #include "TcpClientPort.hpp"
 #include "TcpServerPort.hpp"
+#include "ShmPort.hpp"
 #include "UioShmPort.hpp"
 
 namespace {
@@ -42,9 +44,125 @@ namespace {
 
    const std::string DEFAULT_UNIX_PATH("@tsd.communication.commgr");
 
+   struct SendQueueOptions {
+      uint32_t m_capacity;
+      tsd::communication::messaging::OverflowPolicy m_policy;
+      uint32_t m_blockTimeout;
+      size_t m_zeroCopyThreshold;
+      unsigned m_ioThreads;
+      uint32_t m_reconnect;
+      uint32_t m_maxBackoff;
+      bool m_compactHeaders;
+      size_t m_compressThreshold;
+      std::string m_codec;
+      uint32_t m_sndBuf;
+      uint32_t m_rcvBuf;
+      size_t m_fragmentSize;
+      size_t m_reassemblyLimit;
+
+      SendQueueOptions()
+         : m_capacity(tsd::communication::messaging::UNLIMITED_CAPACITY)
+         , m_policy(tsd::communication::messaging::OVERFLOW_DROP_NEWEST)
+         , m_blockTimeout(100)
+         , m_zeroCopyThreshold(0)
+         , m_ioThreads(1)
+         , m_reconnect(0)
+         , m_maxBackoff(10000)
+         , m_compactHeaders(false)
+         , m_compressThreshold(0)
+         , m_codec("lz")
+         , m_sndBuf(0)
+         , m_rcvBuf(0)
+         , m_fragmentSize(tsd::communication::messaging::DEFAULT_FRAGMENT_SIZE)
+         , m_reassemblyLimit(tsd::communication::messaging::DEFAULT_REASSEMBLY_LIMIT)
+      { }
+   };
+
+   /**
+    * Strip "?key=value&..." options from the URL and parse them.
+    */
+   bool parseOptions(std::string &url, SendQueueOptions &opts)
+   {
+      std::string::size_type query = url.find('?');
+      if (query == std::string::npos) {
+         return true;
+      }
+
+      std::string options(url.substr(query + 1));
+      url.erase(query);
+
+      bool ret = true;
+      std::string::size_type pos = 0;
+      while (ret && pos < options.length()) {
+         std::string::size_type end = options.find('&', pos);
+         if (end == std::string::npos) {
+            end = options.length();
+         }
+
+         std::string option(options.substr(pos, end - pos));
+         std::string::size_type eq = option.find('=');
+         std::string key(option.substr(0, eq));
+         std::string value(eq != std::string::npos ? option.substr(eq + 1) : "");
+
+         if (key == "sendqueue") {
+            opts.m_capacity = static_cast<uint32_t>(std::atol(value.c_str()));
+         } else if (key == "blocktimeout") {
+            opts.m_blockTimeout = static_cast<uint32_t>(std::atol(value.c_str()));
+         } else if (key == "zerocopy") {
+            opts.m_zeroCopyThreshold = static_cast<size_t>(std::atol(value.c_str()));
+         } else if (key == "iothreads") {
+            opts.m_ioThreads = static_cast<unsigned>(std::atol(value.c_str()));
+            ret = opts.m_ioThreads > 0;
+         } else if (key == "reconnect") {
+            opts.m_reconnect = static_cast<uint32_t>(std::atol(value.c_str()));
+         } else if (key == "maxbackoff") {
+            opts.m_maxBackoff = static_cast<uint32_t>(std::atol(value.c_str()));
+         } else if (key == "compress") {
+            opts.m_compressThreshold = static_cast<size_t>(std::atol(value.c_str()));
+         } else if (key == "codec") {
+            opts.m_codec = value;
+         } else if (key == "sndbuf") {
+            opts.m_sndBuf = static_cast<uint32_t>(std::atol(value.c_str()));
+         } else if (key == "rcvbuf") {
+            opts.m_rcvBuf = static_cast<uint32_t>(std::atol(value.c_str()));
+         } else if (key == "fragment") {
+            opts.m_fragmentSize = static_cast<size_t>(std::atol(value.c_str()));
+         } else if (key == "reassembly") {
+            opts.m_reassemblyLimit = static_cast<size_t>(std::atol(value.c_str()));
+         } else if (key == "header") {
+            if (value == "compact") {
+               opts.m_compactHeaders = true;
+            } else if (value == "fixed") {
+               opts.m_compactHeaders = false;
+            } else {
+               ret = false;
+            }
+         } else if (key == "overflow") {
+            if (value == "block") {
+               opts.m_policy = tsd::communication::messaging::OVERFLOW_BLOCK;
+            } else if (value == "drop-oldest") {
+               opts.m_policy = tsd::communication::messaging::OVERFLOW_DROP_OLDEST;
+            } else if (value == "drop-newest") {
+               opts.m_policy = tsd::communication::messaging::OVERFLOW_DROP_NEWEST;
+            } else if (value == "coalesce") {
+               opts.m_policy = tsd::communication::messaging::OVERFLOW_COALESCE;
+            } else {
+               ret = false;
+            }
+         } else {
+            ret = false;
+         }
+
+         pos = end + 1;
+      }
+
+      return ret;
+   }
+
 }
 #endif
 
+using tsd::communication::messaging::CompressionStats;
 using tsd::communication::messaging::Connection;
 using tsd::communication::messaging::ConnectionException;
 using tsd::communication::messaging::IConnection;
@@ -55,6 +173,44 @@ IConnection::~IConnection()
 {
 }
 
+uint64_t IConnection::getDroppedPackets()
+{
+   return 0;
+}
+
+uint64_t IConnection::getExpiredPackets()
+{
+   return 0;
+}
+
+CompressionStats IConnection::getCompressionStats()
+{
+   return CompressionStats();
+}
+
+CompressionStats::CompressionStats()
+   : m_compressedPackets(0)
+   , m_skippedPackets(0)
+   , m_rawBytes(0)
+   , m_compressedBytes(0)
+   , m_compressTime(0)
+   , m_decompressedPackets(0)
+   , m_decompressTime(0)
+{
+}
+
+CompressionStats& CompressionStats::operator+=(const CompressionStats &other)
+{
+   m_compressedPackets += other.m_compressedPackets;
+   m_skippedPackets += other.m_skippedPackets;
+   m_rawBytes += other.m_rawBytes;
+   m_compressedBytes += other.m_compressedBytes;
+   m_compressTime += other.m_compressTime;
+   m_decompressedPackets += other.m_decompressedPackets;
+   m_decompressTime += other.m_decompressTime;
+   return *this;
+}
+
 
 IConnection*
 tsd::communication::messaging::connectUpstream(const std::string &url,
@@ -63,7 +219,13 @@ tsd::communication::messaging::connectUpstream(const std::string &url,
    IConnection *connection = NULL;
 
 #ifdef TARGET_OS_POSIX_LINUX
-   if (url.empty()) {
+   std::string address(url);
+   SendQueueOptions opts;
+   if (!parseOptions(address, opts)) {
+      throw ConnectionException("Invalid options: " + url);
+   }
+
+   if (address.empty()) {
       std::auto_ptr<TcpClientPort> p(new TcpClientPort(Router::getLocalRouter(), subDomain));
 #ifdef TARGET_TYPE_EMBEDDED
       p->initUnix(DEFAULT_UNIX_PATH);
@@ -71,24 +233,45 @@ tsd::communication::messaging::connectUpstream(const std::string &url,
       p->initV4();
 #endif
       connection = p.release();
-   } else if (url.compare(0, 6, "tcp://") == 0) {
+   } else if (address.compare(0, 6, "tcp://") == 0) {
       std::auto_ptr<TcpClientPort> p(new TcpClientPort(Router::getLocalRouter(), subDomain));
       uint32_t addr = INADDR_LOOPBACK;
       uint16_t port = 24710;
-      if (parseV4(url.substr(6), addr, port)) {
-         p->initV4(addr, port);
+      p->setSendQueueLimit(opts.m_capacity, opts.m_policy, opts.m_blockTimeout);
+      p->setZeroCopyThreshold(opts.m_zeroCopyThreshold);
+      p->setReconnect(opts.m_reconnect, opts.m_maxBackoff);
+      p->setCompactHeaders(opts.m_compactHeaders);
+      p->setFragmentation(opts.m_fragmentSize, opts.m_reassemblyLimit);
+      if (!p->setCompression(opts.m_compressThreshold, opts.m_codec)) {
+         throw ConnectionException("Unknown codec: " + url);
+      }
+      if (parseV4(address.substr(6), addr, port)) {
+         p->initV4(addr, port, opts.m_sndBuf, opts.m_rcvBuf);
          connection = p.release();
       } else {
          throw ConnectionException("Could not parse: " + url);
       }
-   } else if (url.compare(0, 7, "unix://") == 0) {
+   } else if (address.compare(0, 7, "unix://") == 0) {
       std::auto_ptr<TcpClientPort> p(new TcpClientPort(Router::getLocalRouter(), subDomain));
-      std::string path(url.substr(7));
+      std::string path(address.substr(7));
+      p->setSendQueueLimit(opts.m_capacity, opts.m_policy, opts.m_blockTimeout);
+      p->setReconnect(opts.m_reconnect, opts.m_maxBackoff);
+      p->setCompactHeaders(opts.m_compactHeaders);
+      p->setFragmentation(opts.m_fragmentSize, opts.m_reassemblyLimit);
       p->initUnix(path.empty() ? DEFAULT_UNIX_PATH : path);
       connection = p.release();
-   } else if (url.compare(0, 6, "uio://") == 0) {
+   } else if (address.compare(0, 6, "uio://") == 0) {
       std::auto_ptr<UioShmPort> p(new UioShmPort(Router::getLocalRouter()));
-      p->connectUpstream(url.substr(6), subDomain);
+      p->setCompactHeaders(opts.m_compactHeaders);
+      p->setFragmentation(opts.m_fragmentSize, opts.m_reassemblyLimit);
+      if (!p->setCompression(opts.m_compressThreshold, opts.m_codec)) {
+         throw ConnectionException("Unknown codec: " + url);
+      }
+      p->connectUpstream(address.substr(6), subDomain);
+      connection = p.release();
+   } else if (address.compare(0, 6, "shm://") == 0) {
+      std::auto_ptr<ShmPort> p(new ShmPort(Router::getLocalRouter()));
+      p->connectUpstream(address.substr(6), subDomain);
       connection = p.release();
    }
 #else
@@ -113,24 +296,51 @@ tsd::communication::messaging::listenDownstream(const std::string &url)
    IConnection *connection = NULL;
 
 #ifdef TARGET_OS_POSIX_LINUX
-   if (url.compare(0, 6, "tcp://") == 0) {
+   std::string address(url);
+   SendQueueOptions opts;
+   if (!parseOptions(address, opts)) {
+      throw ConnectionException("Invalid options: " + url);
+   }
+
+   if (address.compare(0, 6, "tcp://") == 0) {
       std::auto_ptr<TcpServerPort> p(new TcpServerPort(Router::getLocalRouter()));
       uint32_t addr = INADDR_ANY;
       uint16_t port = 24710;
-      if (parseV4(url.substr(6), addr, port)) {
-         p->initV4(addr, port);
+      p->setSendQueueLimit(opts.m_capacity, opts.m_policy, opts.m_blockTimeout);
+      p->setZeroCopyThreshold(opts.m_zeroCopyThreshold);
+      p->setIoThreads(opts.m_ioThreads);
+      p->setCompactHeaders(opts.m_compactHeaders);
+      p->setFragmentation(opts.m_fragmentSize, opts.m_reassemblyLimit);
+      if (!p->setCompression(opts.m_compressThreshold, opts.m_codec)) {
+         throw ConnectionException("Unknown codec: " + url);
+      }
+      if (parseV4(address.substr(6), addr, port)) {
+         p->initV4(addr, port, opts.m_sndBuf, opts.m_rcvBuf);
          connection = p.release();
       } else {
          throw ConnectionException("Could not parse: " + url);
       }
-   } else if (url.compare(0, 7, "unix://") == 0) {
+   } else if (address.compare(0, 7, "unix://") == 0) {
       std::auto_ptr<TcpServerPort> p(new TcpServerPort(Router::getLocalRouter()));
-      std::string path(url.substr(7));
+      std::string path(address.substr(7));
+      p->setSendQueueLimit(opts.m_capacity, opts.m_policy, opts.m_blockTimeout);
+      p->setIoThreads(opts.m_ioThreads);
+      p->setCompactHeaders(opts.m_compactHeaders);
+      p->setFragmentation(opts.m_fragmentSize, opts.m_reassemblyLimit);
       p->initUnix(path.empty() ? DEFAULT_UNIX_PATH : path);
       connection = p.release();
-   } else if (url.compare(0, 6, "uio://") == 0) {
+   } else if (address.compare(0, 6, "uio://") == 0) {
       std::auto_ptr<UioShmPort> p(new UioShmPort(Router::getLocalRouter()));
-      p->listenDownstream(url.substr(6));
+      p->setCompactHeaders(opts.m_compactHeaders);
+      p->setFragmentation(opts.m_fragmentSize, opts.m_reassemblyLimit);
+      if (!p->setCompression(opts.m_compressThreshold, opts.m_codec)) {
+         throw ConnectionException("Unknown codec: " + url);
+      }
+      p->listenDownstream(address.substr(6));
+      connection = p.release();
+   } else if (address.compare(0, 6, "shm://") == 0) {
+      std::auto_ptr<ShmPort> p(new ShmPort(Router::getLocalRouter()));
+      p->listenDownstream(address.substr(6));
       connection = p.release();
    }
 #endif
@@ -142,6 +352,17 @@ tsd::communication::messaging::listenDownstream(const std::string &url)
    return connection;
 }
 
+void
+tsd::communication::messaging::configureIoThreads(unsigned threads, const std::string &cpus)
+{
+#ifdef TARGET_OS_POSIX_LINUX
+   Reactor::configure(threads, cpus);
+#else
+   (void)threads;
+   (void)cpus;
+#endif
+}
+
 /*****************************************************************************/
 
 IConnectionCallbacks::~IConnectionCallbacks()
@@ -201,3 +422,23 @@ void Connection::disconnect()
 {
    m_p->disconnect();
 }
+
+uint64_t Connection::getExpiredPackets()
+{
+   return m_p->getExpiredPackets();
+}
+
+CompressionStats Connection::getCompressionStats()
+{
+   return m_p->getCompressionStats();
+}
+
+bool Connection::setCompression(size_t threshold, const std::string &codec)
+{
+   return m_p->setCompression(threshold, codec);
+}
+
+void Connection::setFragmentation(size_t fragmentSize, size_t reassemblyLimit)
+{
+   m_p->setFragmentation(fragmentSize, reassemblyLimit);
+}
@@ -2,6 +2,7 @@
 #include <cstring>
 
 #include <tsd/common/ipc/networkinteger.h>
+#include <tsd/common/system/Clock.hpp>
 #include <tsd/common/system/Mutex.hpp>
 #include <tsd/common/system/MutexGuard.hpp>
 
@@ -10,6 +11,7 @@
 #include "ConnectionImpl.hpp"
 #include "IPort.hpp"
 #include "Packet.hpp"
+#include "ReceiveSlab.hpp"
 #include "Router.hpp"
 
 
@@ -21,10 +23,19 @@ ConnectionImpl::ConnectionImpl(IConnectionCallbacks &cb, Router &router)
    : IPort(router)
    , m_cb(cb)
    , m_connected(false)
-   , m_outgoingPkt(0)
    , m_outgoingOffset(0)
+   , m_outgoingHdrLen(0)
+   , m_outgoingMarkerQueued(false)
+   , m_outgoingMarker(NULL)
+   , m_outgoingIsCompact(false)
+   , m_outgoingTimeToLive(false)
    , m_incomingHdrSize(0)
+   , m_incomingHdrLen(0)
+   , m_incomingIsCompact(false)
+   , m_fragmentSize(DEFAULT_FRAGMENT_SIZE)
 {
+   std::memset(&m_outgoingChunk, 0, sizeof(m_outgoingChunk));
+   m_reassembler.setLimit(DEFAULT_REASSEMBLY_LIMIT);
 }
 
 ConnectionImpl::~ConnectionImpl()
@@ -34,55 +45,196 @@ ConnectionImpl::~ConnectionImpl()
 
 void ConnectionImpl::nextPacket()
 {
-   if (m_outgoingPkt != 0) {
-      delete m_outgoingPkt;
-      m_outgoingPkt = 0;
+   if (m_outgoingChunk.m_packet != NULL) {
+      if (m_outgoingChunk.isLast()) {
+         delete m_outgoingChunk.m_packet;
+      }
+      m_outgoingChunk.m_packet = NULL;
       m_outgoingOffset = 0;
    }
 
-   if (!m_outgoingQueue.empty()) {
-      m_outgoingPkt = m_outgoingQueue.front();
-      m_outgoingQueue.pop_front();
+   // expired messages are dropped on the way
+   if (m_outgoingQueue.pop(m_outgoingChunk, tsd::common::system::Clock::getTickCounter())) {
+      const Packet *pkt = m_outgoingChunk.m_packet;
+      if (m_outgoingIsCompact) {
+         m_outgoingHdrLen = m_outgoingCompact.encode(m_outgoingHdr, *pkt,
+                                                     m_outgoingChunk.m_length,
+                                                     m_outgoingChunk.m_fragment,
+                                                     m_outgoingTimeToLive
+                                                        ? m_outgoingChunk.m_timeToLive : 0);
+      } else {
+         // fragments are only sent behind the marker
+         PacketHeader hdr;
+         std::memset(&hdr, 0, sizeof(hdr));
+         hdr.m_msgLen = static_cast<uint32_t>(pkt->getBufferLength());
+         hdr.m_eventId = pkt->getEventId();
+         hdr.m_senderAddr = pkt->getSenderAddr();
+         hdr.m_receiverAddr = pkt->getReceiverAddr();
+         hdr.m_type = pkt->getType();
+         hdr.m_priority = static_cast<uint8_t>(pkt->getPriority() + 1);
+         hdr.m_flags = pkt->isConflatable() ? static_cast<uint8_t>(HEADER_CONFLATABLE) : 0u;
+         std::memcpy(m_outgoingHdr, &hdr, sizeof(hdr));
+         m_outgoingHdrLen = sizeof(hdr);
+
+         // the marker is the last packet with a fixed header
+         if (pkt == m_outgoingMarker) {
+            m_outgoingIsCompact = true;
+            m_outgoingMarker = NULL;
+         }
+      }
+   }
+}
 
-      std::memset(&m_outgoingHdr, 0, sizeof(m_outgoingHdr));
-      m_outgoingHdr.m_msgLen = static_cast<uint32_t>(m_outgoingPkt->getBufferLength());
-      m_outgoingHdr.m_eventId = m_outgoingPkt->getEventId();
-      m_outgoingHdr.m_senderAddr = m_outgoingPkt->getSenderAddr();
-      m_outgoingHdr.m_receiverAddr = m_outgoingPkt->getReceiverAddr();
-      m_outgoingHdr.m_type = m_outgoingPkt->getType();
+/**
+ * Parse the header in m_incomingHdrBuf.
+ *
+ * @return Size of the header or 0 if it is not complete yet
+ */
+size_t ConnectionImpl::parseHeader()
+{
+   if (m_incomingIsCompact) {
+      return m_incomingCompact.decode(m_incomingHdrBuf, m_incomingHdrSize, m_incomingHdr);
    }
+
+   if (m_incomingHdrSize < sizeof(PacketHeader)) {
+      return 0;
+   }
+
+   PacketHeader hdr;
+   std::memcpy(&hdr, m_incomingHdrBuf, sizeof(hdr));
+   m_incomingHdr.m_msgLen = hdr.m_msgLen;
+   m_incomingHdr.m_eventId = hdr.m_eventId;
+   m_incomingHdr.m_senderAddr = hdr.m_senderAddr;
+   m_incomingHdr.m_receiverAddr = hdr.m_receiverAddr;
+   m_incomingHdr.m_type = hdr.m_type;
+   m_incomingHdr.m_codec = 0;
+   m_incomingHdr.m_priority = hdr.m_priority != 0 ? hdr.m_priority - 1u : static_cast<unsigned>(PRIORITY_NORMAL);
+   m_incomingHdr.m_fragment = 0;
+   m_incomingHdr.m_totalLen = 0;
+   m_incomingHdr.m_timeToLive = 0;
+   m_incomingHdr.m_conflatable = (hdr.m_flags & HEADER_CONFLATABLE) != 0;
+
+   return sizeof(hdr);
 }
 
 void ConnectionImpl::processPacket(const uint8_t *p)
 {
-   Packet *pkt = new Packet(static_cast<tsd::communication::messaging::Packet::Type>(m_incomingHdr.m_type),
-                            m_incomingHdr.m_senderAddr,
-                            m_incomingHdr.m_receiverAddr,
-                            m_incomingHdr.m_eventId,
-                            reinterpret_cast<const char *>(p),
-                            m_incomingHdr.m_msgLen);
+   std::auto_ptr<Packet> pkt;
+   if (m_incomingHdr.m_fragment != 0) {
+      // broken fragments are dropped like corrupt packets
+      ReceiveSlab *slab;
+      if (!m_reassembler.add(m_incomingHdr, reinterpret_cast<const char *>(p), slab) ||
+          slab == NULL) {
+         return;
+      }
+      if (m_incomingHdr.m_codec != 0) {
+         pkt = m_compressor.decompress(m_incomingHdr, slab->getData());
+      } else {
+         pkt.reset(new Packet(static_cast<tsd::communication::messaging::Packet::Type>(m_incomingHdr.m_type),
+                              m_incomingHdr.m_senderAddr,
+                              m_incomingHdr.m_receiverAddr,
+                              m_incomingHdr.m_eventId,
+                              slab, 0,
+                              m_incomingHdr.m_msgLen));
+      }
+      slab->deref();
+      if (pkt.get() == NULL) {
+         return;
+      }
+   } else if (m_incomingHdr.m_codec != 0) {
+      // corrupt packets are dropped
+      pkt = m_compressor.decompress(m_incomingHdr, reinterpret_cast<const char *>(p));
+      if (pkt.get() == NULL) {
+         return;
+      }
+   } else {
+      pkt.reset(new Packet(static_cast<tsd::communication::messaging::Packet::Type>(m_incomingHdr.m_type),
+                           m_incomingHdr.m_senderAddr,
+                           m_incomingHdr.m_receiverAddr,
+                           m_incomingHdr.m_eventId,
+                           reinterpret_cast<const char *>(p),
+                           m_incomingHdr.m_msgLen));
+   }
+   pkt->setPriority(static_cast<MessagePriority>(m_incomingHdr.m_priority));
+   pkt->setConflatable(m_incomingHdr.m_conflatable);
+   if (m_incomingHdr.m_timeToLive != 0) {
+      pkt->setDeadline(Packet::makeDeadline(tsd::common::system::Clock::getTickCounter(),
+                                            m_incomingHdr.m_timeToLive));
+   }
+
+   if (pkt->getType() == Packet::COMPACT_HEADER) {
+      // the peer switched, answer unless we started
+      if (!m_incomingIsCompact && m_incomingCompact.parseMarker(*pkt)) {
+         m_incomingIsCompact = true;
+         sendCompactMarker(m_incomingCompact.reverse());
+         m_compressor.setPeerCodecs(m_incomingCompact.getCodecs());
+         tsd::common::system::MutexGuard g(m_lock);
+         if (m_incomingCompact.getFeatures() & CompactHeader::FEATURE_FRAGMENTS) {
+            m_outgoingQueue.setFragmentSize(m_fragmentSize);
+         }
+         m_outgoingTimeToLive =
+            (m_incomingCompact.getFeatures() & CompactHeader::FEATURE_TIME_TO_LIVE) != 0;
+      }
+      return;
+   }
+
+   receivedPacket(pkt);
+}
+
+/**
+ * Send the marker of @p header. Only the first call has an effect.
+ */
+void ConnectionImpl::sendCompactMarker(const CompactHeader &header)
+{
+   CompactHeader marker(header);
+   marker.setCodecs(m_compressor.getLocalCodecs());
+   marker.setFeatures(CompactHeader::FEATURE_FRAGMENTS | CompactHeader::FEATURE_TIME_TO_LIVE);
+   std::auto_ptr<Packet> pkt(marker.createMarker());
+
+   tsd::common::system::MutexGuard g(m_lock);
+   if (m_outgoingMarkerQueued) {
+      return;
+   }
+   m_outgoingMarkerQueued = true;
+   m_outgoingMarker = pkt.get();
+   m_outgoingCompact = header;
+   g.unlock();
 
-   receivedPacket(std::auto_ptr<Packet>(pkt));
+   sendPacket(pkt);
+}
+
+void ConnectionImpl::startCompactHeaders(tsd::communication::event::IfcAddr_t localBase,
+                                         tsd::communication::event::IfcAddr_t peerBase)
+{
+   sendCompactMarker(CompactHeader(localBase, peerBase));
 }
 
 void ConnectionImpl::purgeQueue()
 {
    m_incomingHdrSize = 0;
+   m_incomingHdrLen = 0;
+   m_incomingIsCompact = false;
    m_incomingPkt.clear();
+   m_reassembler.reset();
+   m_compressor.reset();
 
    tsd::common::system::MutexGuard g(m_lock);
 
-   while (!m_outgoingQueue.empty()) {
-      delete m_outgoingQueue.front();
-      m_outgoingQueue.pop_front();
+   if (m_outgoingChunk.m_packet != NULL) {
+      if (m_outgoingChunk.isLast()) {
+         delete m_outgoingChunk.m_packet;
+      }
+      m_outgoingChunk.m_packet = NULL;
    }
 
-   if (m_outgoingPkt != 0) {
-      delete m_outgoingPkt;
-      m_outgoingPkt = NULL;
-   }
+   m_outgoingQueue.clear();
+   m_outgoingQueue.setFragmentSize(0);
+   m_outgoingTimeToLive = false;
 
    m_outgoingOffset = 0;
+   m_outgoingMarkerQueued = false;
+   m_outgoingMarker = NULL;
+   m_outgoingIsCompact = false;
 }
 
 bool ConnectionImpl::startPort()
@@ -99,6 +251,8 @@ void ConnectionImpl::stopPort()
 
 bool ConnectionImpl::sendPacket(std::auto_ptr<Packet> pkt)
 {
+   pkt = m_compressor.compress(pkt);
+
    tsd::common::system::MutexGuard g(m_lock);
 
    bool ret = false;
@@ -106,8 +260,13 @@ bool ConnectionImpl::sendPacket(std::auto_ptr<Packet> pkt)
    if (m_connected) {
       bool wake = false;
 
-      m_outgoingQueue.push_back(pkt.release());
-      if (m_outgoingPkt == 0) {
+      if (pkt->isConflatable() && m_outgoingQueue.replace(pkt.get())) {
+         pkt.release();
+         return true;
+      }
+
+      m_outgoingQueue.push(pkt.release());
+      if (m_outgoingChunk.m_packet == NULL) {
          nextPacket();
          wake = true;
       }
@@ -117,6 +276,9 @@ bool ConnectionImpl::sendPacket(std::auto_ptr<Packet> pkt)
          m_cb.wakeup();
       }
       ret = true;
+   } else if (pkt.get() == m_outgoingMarker) {
+      // dropped, must not match a later packet at the same address
+      m_outgoingMarker = NULL;
    }
 
    return ret;
@@ -149,19 +311,26 @@ void ConnectionImpl::processData(const void* data, size_t size)
    const uint8_t* p = static_cast<const uint8_t*>(data);
 
    while (size > 0) {
-      if (m_incomingHdrSize < sizeof(PacketHeader)) {
+      if (m_incomingHdrLen == 0) {
          // we always need a full header first
-         size_t remaining = std::min(sizeof(PacketHeader) - m_incomingHdrSize, size);
-         std::memcpy(reinterpret_cast<uint8_t*>(&m_incomingHdr) + m_incomingHdrSize, p, remaining);
-         m_incomingHdrSize += remaining; p += remaining; size -= remaining;
+         size_t remaining = std::min(sizeof(m_incomingHdrBuf) - m_incomingHdrSize, size);
+         std::memcpy(m_incomingHdrBuf + m_incomingHdrSize, p, remaining);
+         size_t before = m_incomingHdrSize;
+         m_incomingHdrSize += remaining;
+         m_incomingHdrLen = parseHeader();
+         if (m_incomingHdrLen > 0) {
+            // anything behind the header is already payload
+            remaining = m_incomingHdrLen - before;
+         }
+         p += remaining; size -= remaining;
       }
-      if (m_incomingHdrSize == sizeof(PacketHeader)) {
+      if (m_incomingHdrLen > 0) {
          if (m_incomingPkt.empty() && m_incomingHdr.m_msgLen <= size) {
             // fast path: the payload is completely in the buffer and we have no backlog
             processPacket(p);
             p += m_incomingHdr.m_msgLen;
             size -= m_incomingHdr.m_msgLen;
-            m_incomingHdrSize = 0;
+            m_incomingHdrSize = m_incomingHdrLen = 0;
          } else {
             // slow path: accumulate packet
             m_incomingPkt.reserve(m_incomingHdr.m_msgLen);
@@ -170,7 +339,7 @@ void ConnectionImpl::processData(const void* data, size_t size)
             p += remaining; size -= remaining;
             if (m_incomingPkt.size() >= m_incomingHdr.m_msgLen) {
                processPacket(&m_incomingPkt.front());
-               m_incomingHdrSize = 0;
+               m_incomingHdrSize = m_incomingHdrLen = 0;
                m_incomingPkt.clear();
             }
          }
@@ -182,17 +351,17 @@ bool ConnectionImpl::getData(const void*& data, size_t& size)
 {
    tsd::common::system::MutexGuard g(m_lock);
 
-   if (m_outgoingPkt == 0) {
+   if (m_outgoingChunk.m_packet == NULL) {
       return false;
    }
 
-   if (m_outgoingOffset < sizeof(PacketHeader)) {
-      data = reinterpret_cast<uint8_t*>(&m_outgoingHdr) + m_outgoingOffset;
-      size = sizeof(PacketHeader) - m_outgoingOffset;
+   if (m_outgoingOffset < m_outgoingHdrLen) {
+      data = m_outgoingHdr + m_outgoingOffset;
+      size = m_outgoingHdrLen - m_outgoingOffset;
    } else {
-      size_t offset = m_outgoingOffset - sizeof(PacketHeader);
-      data = m_outgoingPkt->getBufferPtr() + offset;
-      size = m_outgoingPkt->getBufferLength() - offset;
+      size_t offset = m_outgoingOffset - m_outgoingHdrLen;
+      data = m_outgoingChunk.m_packet->getBufferPtr() + m_outgoingChunk.m_offset + offset;
+      size = m_outgoingChunk.m_length - offset;
    }
 
    return true;
@@ -202,9 +371,9 @@ void ConnectionImpl::consumeData(size_t amount)
 {
    tsd::common::system::MutexGuard g(m_lock);
 
-   if (m_outgoingPkt != 0) {
+   if (m_outgoingChunk.m_packet != NULL) {
       m_outgoingOffset += amount;
-      if (m_outgoingOffset >= (sizeof(PacketHeader) + m_outgoingPkt->getBufferLength())) {
+      if (m_outgoingOffset >= (m_outgoingHdrLen + m_outgoingChunk.m_length)) {
          nextPacket();
       }
    }
@@ -224,3 +393,34 @@ void ConnectionImpl::disconnect()
 {
    finish();
 }
+
+/**
+ * Compress payloads of at least @p threshold bytes, see PacketCompressor.
+ * Must be called before connectUpstream() or listenDownstream().
+ */
+bool ConnectionImpl::setCompression(size_t threshold, const std::string &codec)
+{
+   return m_compressor.configure(threshold, codec);
+}
+
+/**
+ * Send payloads of more than @p fragmentSize bytes in fragments, see
+ * TcpEndpoint::setFragmentation(). Must be called before connectUpstream()
+ * or listenDownstream().
+ */
+void ConnectionImpl::setFragmentation(size_t fragmentSize, size_t reassemblyLimit)
+{
+   m_fragmentSize = static_cast<uint32_t>(fragmentSize);
+   m_reassembler.setLimit(reassemblyLimit);
+}
+
+tsd::communication::messaging::CompressionStats ConnectionImpl::getCompressionStats()
+{
+   return m_compressor.getStats();
+}
+
+uint64_t ConnectionImpl::getExpiredPackets()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   return m_outgoingQueue.getExpired();
+}
@@ -1,13 +1,16 @@
 #ifndef TSD_COMMUNICATION_MESSAGING_CONNECTIONIMPL_HPP
 #define TSD_COMMUNICATION_MESSAGING_CONNECTIONIMPL_HPP
 
-#include <deque>
 #include <vector>
 
 #include <tsd/common/ctassert.hpp>
 #include <tsd/communication/messaging/Connection.hpp>
 
+#include "CompactHeader.hpp"
 #include "IPort.hpp"
+#include "PacketCompressor.hpp"
+#include "PacketReassembler.hpp"
+#include "SendScheduler.hpp"
 
 namespace tsd { namespace communication { namespace messaging {
 
@@ -16,38 +19,57 @@ namespace tsd { namespace communication { namespace messaging {
    class ConnectionImpl
       : private IPort
    {
-      typedef std::deque<Packet*> PacketQueue;
-
       struct PacketHeader {
          tsd::common::ipc::NetworkInteger<uint32_t>   m_msgLen;
          tsd::common::ipc::NetworkInteger<uint32_t>   m_eventId;
          tsd::common::ipc::NetworkInteger<uint64_t>   m_senderAddr;
          tsd::common::ipc::NetworkInteger<uint64_t>   m_receiverAddr;
          uint8_t                                      m_type;
-         uint8_t                                      m_padding[7];
+         uint8_t                                      m_priority;    // MessagePriority + 1, zero from older peers
+         uint8_t                                      m_flags;       // HEADER_CONFLATABLE, zero from older peers
+         uint8_t                                      m_padding[5];
       };
+      enum { HEADER_CONFLATABLE = 1 };
       compile_time_assert(sizeof(PacketHeader) == 32);
 
       IConnectionCallbacks &m_cb;
       tsd::common::system::Mutex m_lock;
       bool m_connected;
 
-      PacketQueue m_outgoingQueue;
-      Packet *m_outgoingPkt;
+      SendScheduler m_outgoingQueue;
+      SendChunk m_outgoingChunk;       // m_packet is NULL if there is none
       size_t m_outgoingOffset;
-      PacketHeader m_outgoingHdr;
+      uint8_t m_outgoingHdr[CompactHeader::MAX_SIZE];
+      size_t m_outgoingHdrLen;
+      CompactHeader m_outgoingCompact;
+      bool m_outgoingMarkerQueued;
+      const Packet *m_outgoingMarker;  // queued marker, NULL once its header is prepared
+      bool m_outgoingIsCompact;
+      bool m_outgoingTimeToLive;   // peer decodes the time to live of messages
 
       std::vector<uint8_t> m_incomingPkt;
-      PacketHeader m_incomingHdr;
+      uint8_t m_incomingHdrBuf[CompactHeader::MAX_SIZE];
       size_t m_incomingHdrSize;
+      size_t m_incomingHdrLen;     // 0 until the header is complete
+      HeaderFields m_incomingHdr;
+      CompactHeader m_incomingCompact;
+      bool m_incomingIsCompact;
+      PacketReassembler m_reassembler;
+
+      PacketCompressor m_compressor;
+      uint32_t m_fragmentSize;
 
       void nextPacket();
+      size_t parseHeader();
       void processPacket(const uint8_t* p);
       void purgeQueue();
+      void sendCompactMarker(const CompactHeader &header);
 
       bool startPort(); // IPort
       void stopPort(); // IPort
       bool sendPacket(std::auto_ptr<Packet> pkt); // IPort
+      void startCompactHeaders(tsd::communication::event::IfcAddr_t localBase,
+                               tsd::communication::event::IfcAddr_t peerBase); // IPort
 
    public:
       ConnectionImpl(IConnectionCallbacks &cb, Router &router);
@@ -63,6 +85,12 @@ namespace tsd { namespace communication { namespace messaging {
       bool connectUpstream(const std::string &subDomain);
       bool listenDownstream();
       void disconnect();
+
+      using IPort::setCompactHeaders;
+      bool setCompression(size_t threshold, const std::string &codec);
+      void setFragmentation(size_t fragmentSize, size_t reassemblyLimit);
+      CompressionStats getCompressionStats();
+      uint64_t getExpiredPackets();
    };
 
 } } }
@@ -19,11 +19,29 @@ namespace {
    struct DhcpOffer {
       NetworkInteger<uint32_t>   m_version;
       uint8_t                    m_prefixLength;
-      uint8_t                    m_padding[3];
+      uint8_t                    m_flags;
+      uint8_t                    m_padding[2];
       NetworkInteger<uint64_t>   m_addr;
       NetworkInteger<uint64_t>   m_nameServer;
    };
 
+   // The offering router accepts a DhcpRequest. Older routers send zero.
+   const uint8_t DHCP_FLAG_REQUEST = 1u;
+
+   // The offering router understands the compact packet header.
+   const uint8_t DHCP_FLAG_COMPACT = 2u;
+
+   /*
+    * Sent by a reconnecting router that wants its previous address back. It
+    * is answered by another offer with the granted address.
+    */
+   struct DhcpRequest {
+      NetworkInteger<uint32_t>   m_version;
+      uint8_t                    m_prefixLength;
+      uint8_t                    m_padding[3];
+      NetworkInteger<uint64_t>   m_addr;
+   };
+
 }
 
 IPort::IPort(Router &router)
@@ -36,6 +54,13 @@ IPort::IPort(Router &router)
    , m_upstream(false)
    , m_nameServer(0)
    , m_ioThreadId(0)
+   , m_persistent(false)
+   , m_compactHeaders(false)
+   , m_offerOpen(false)
+   , m_requested(false)
+   , m_leaseAddr(0)
+   , m_leasePrefixLength(0)
+   , m_routerPins(0)
 {
 }
 
@@ -155,6 +180,9 @@ void IPort::finish()
        << "IPort::finish on [" << m_router.getName() << "]: state: " << m_state
        << &std::endl;
 
+   // going down for good
+   m_persistent = false;
+
    /*
     * First stop port if it is still running. stopPort() is expected to block
     * until the io-thread of the port is finished. This implies that no
@@ -165,6 +193,9 @@ void IPort::finish()
       case DOWNSTREAM_UNCONNECTED:
       case UPSTREAM_CONNECTED:
       case UPSTREAM_DEAD:
+      case UPSTREAM_SUSPENDED:
+      case UPSTREAM_REBINDING:
+      case UPSTREAM_REBOUND:
          g.unlock();
          stopPort();
          g.lock();
@@ -190,6 +221,9 @@ void IPort::finish()
 
       case DOWNSTREAM_CONNECTED:
       case UPSTREAM_CONNECTED:
+      case UPSTREAM_SUSPENDED:
+      case UPSTREAM_REBINDING:
+      case UPSTREAM_REBOUND:
       {
          State oldState = m_state;
          IfcAddr_t oldAddr = m_localAddr;
@@ -221,6 +255,10 @@ void IPort::finish()
          m_prefixLength = 0;
          break;
    }
+   g.unlock();
+
+   // the router may still be delivering packets that it routed before
+   m_router.waitUnpinned(m_routerPins);
 }
 
 bool IPort::connected()
@@ -246,10 +284,16 @@ bool IPort::connected()
             m_prefixLength = prefixLength;
             m_state = DOWNSTREAM_CONNECTED;
 
+            m_offerOpen = true;
+
             DhcpOffer offer;
             std::memset(&offer, 0, sizeof(offer));
             offer.m_version = 1;
             offer.m_prefixLength = prefixLength;
+            offer.m_flags = DHCP_FLAG_REQUEST;
+            if (m_compactHeaders) {
+               offer.m_flags |= DHCP_FLAG_COMPACT;
+            }
             offer.m_addr = addr;
             offer.m_nameServer = nameServer;
             std::auto_ptr<Packet> pkt(new Packet(Packet::DHCP_OFFER, 0, 0, 0, (const
@@ -265,6 +309,12 @@ bool IPort::connected()
          ret = true;
          break;
 
+      case UPSTREAM_SUSPENDED:
+         m_state = UPSTREAM_REBINDING;
+         m_requested = false;
+         ret = true;
+         break;
+
       default:
          // protocol violation
          break;
@@ -288,6 +338,15 @@ void IPort::disconnected()
          m_stateCondition.signal();
          break;
       case UPSTREAM_CONNECTED:
+         if (m_persistent) {
+            m_state = UPSTREAM_SUSPENDED;
+            log << tsd::common::logging::LogLevel::Warn
+                << "IPort::disconnected upstream on [" << m_router.getName() << "]: suspended"
+                << &std::endl;
+            g.unlock();
+            m_router.suspendUpstreamPort(this);
+            break;
+         }
          m_state = UPSTREAM_DEAD;
          m_stateCondition.signal();
          log << tsd::common::logging::LogLevel::Error
@@ -296,6 +355,12 @@ void IPort::disconnected()
          g.unlock();
          m_router.delPort(this);
          break;
+      case UPSTREAM_REBINDING:
+      case UPSTREAM_REBOUND:
+         // still registered on the router, see resumeUpstream()
+         m_state = UPSTREAM_SUSPENDED;
+         m_stateCondition.signal();
+         break;
       case DOWNSTREAM_CONNECTED:
          m_state = DOWNSTREAM_UNCONNECTED;
          log << tsd::common::logging::LogLevel::Warn
@@ -308,6 +373,7 @@ void IPort::disconnected()
 
       case UNINITIALIZED:
       case UPSTREAM_DEAD:
+      case UPSTREAM_SUSPENDED:
       case DOWNSTREAM_UNCONNECTED:
          // do nothing
          break;
@@ -322,14 +388,24 @@ void IPort::receivedPacket(std::auto_ptr<Packet> pkt)
    assert(m_ioThreadId == tsd::common::system::Thread::myself());
 
    switch (m_state) {
+      case DOWNSTREAM_CONNECTED:
+         if (pkt->getType() == Packet::DHCP_REQUEST) {
+            processDhcpRequest(pkt, g);
+            break;
+         }
+         m_offerOpen = false;
+         g.unlock();
+         m_router.routePacket(pkt, this);
+         break;
       case UPSTREAM_BOUND:
+      case UPSTREAM_REBOUND:
       case UPSTREAM_CONNECTED:
-      case DOWNSTREAM_CONNECTED:
          g.unlock();
          m_router.routePacket(pkt, this);
          break;
       case UPSTREAM_UNBOUND:
-         processUnboundPacket(pkt);
+      case UPSTREAM_REBINDING:
+         processUnboundPacket(pkt, g);
          break;
       default:
          // ignore packet
@@ -337,24 +413,67 @@ void IPort::receivedPacket(std::auto_ptr<Packet> pkt)
    }
 }
 
-void IPort::processUnboundPacket(std::auto_ptr<Packet> pkt)
+void IPort::processUnboundPacket(std::auto_ptr<Packet> pkt, tsd::common::system::MutexGuard &g)
 {
+   State failed = (m_state == UPSTREAM_REBINDING) ? UPSTREAM_SUSPENDED : UPSTREAM_DEAD;
+
    if (pkt->getType() != Packet::DHCP_OFFER) {
-      m_state = UPSTREAM_DEAD;
+      m_state = failed;
       m_stateCondition.signal();
       return;
    }
 
    DhcpOffer offer;
    if (pkt->getBufferLength() != sizeof(offer)) {
-      m_state = UPSTREAM_DEAD;
+      m_state = failed;
       m_stateCondition.signal();
       return;
    }
    std::memcpy(&offer, pkt->getBufferPtr(), sizeof(offer));
 
    if (offer.m_version != 1) {
-      m_state = UPSTREAM_DEAD;
+      m_state = failed;
+      m_stateCondition.signal();
+      return;
+   }
+
+   if (m_state == UPSTREAM_REBINDING) {
+      /*
+       * Reconnected. The address is only applied by resumeUpstream() because
+       * the port is still registered on the router. If the peer offers
+       * another subnet than before ask once for the old one.
+       */
+      bool same = offer.m_addr == m_peerAddr && offer.m_prefixLength == m_prefixLength;
+      if (!same && !m_requested && (offer.m_flags & DHCP_FLAG_REQUEST) != 0) {
+         m_requested = true;
+
+         DhcpRequest req;
+         std::memset(&req, 0, sizeof(req));
+         req.m_version = 1;
+         req.m_prefixLength = m_prefixLength;
+         req.m_addr = m_peerAddr;
+         std::auto_ptr<Packet> reqPkt(new Packet(Packet::DHCP_REQUEST, 0, 0, 0,
+            (const char*)&req, sizeof(req)));
+
+         g.unlock();
+         sendPacket(reqPkt);
+         g.lock();
+         return;
+      }
+   }
+
+   if (m_compactHeaders && (offer.m_flags & DHCP_FLAG_COMPACT) != 0) {
+      // before anybody can send with the new address
+      g.unlock();
+      startCompactHeaders(offer.m_addr + (1u << INTERFACE_ADDR_SIZE), offer.m_addr);
+      g.lock();
+   }
+
+   if (m_state == UPSTREAM_REBINDING) {
+      m_leaseAddr = offer.m_addr;
+      m_leasePrefixLength = offer.m_prefixLength;
+      m_nameServer = offer.m_nameServer;
+      m_state = UPSTREAM_REBOUND;
       m_stateCondition.signal();
       return;
    }
@@ -370,3 +489,141 @@ void IPort::processUnboundPacket(std::auto_ptr<Packet> pkt)
 
    return;
 }
+
+/**
+ * A reconnected router asks for its previous subnet.
+ *
+ * This is only honored before the peer sent anything else. Up to then nobody
+ * can know the offered address, so the port may be moved to the requested
+ * subnet if it is still free. The peer always gets a new offer with the
+ * final address.
+ */
+void IPort::processDhcpRequest(std::auto_ptr<Packet> pkt, tsd::common::system::MutexGuard &g)
+{
+   DhcpRequest req;
+   if (!m_offerOpen || pkt->getBufferLength() != sizeof(req)) {
+      return;
+   }
+   std::memcpy(&req, pkt->getBufferPtr(), sizeof(req));
+   m_offerOpen = false;
+
+   if (req.m_version != 1) {
+      return;
+   }
+
+   IfcAddr_t oldAddr = m_localAddr;
+   IfcAddr_t newAddr = req.m_addr;
+   uint8_t prefixLength = m_prefixLength;
+   IfcAddr_t nameServer = 0;
+   g.unlock();
+
+   if (newAddr != oldAddr && req.m_prefixLength == prefixLength &&
+       m_router.reserveDownstreamAddr(newAddr, prefixLength, nameServer))
+   {
+      m_router.delPort(this);
+      m_router.freeDownstreamAddr(oldAddr);
+      g.lock();
+      m_localAddr = newAddr;
+      m_peerAddr = newAddr + (1u << INTERFACE_ADDR_SIZE);
+      g.unlock();
+      m_router.addDownstreamPort(this);
+   } else {
+      newAddr = oldAddr;
+      nameServer = oldAddr | m_router.getNameServer();
+   }
+
+   DhcpOffer offer;
+   std::memset(&offer, 0, sizeof(offer));
+   offer.m_version = 1;
+   offer.m_prefixLength = prefixLength;
+   offer.m_flags = m_compactHeaders ? DHCP_FLAG_COMPACT : 0;
+   offer.m_addr = newAddr;
+   offer.m_nameServer = nameServer;
+   sendPacket(std::auto_ptr<Packet>(new Packet(Packet::DHCP_OFFER, 0, 0, 0,
+      (const char*)&offer, sizeof(offer))));
+
+   g.lock();
+}
+
+void IPort::setPersistent(bool persistent)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   m_persistent = persistent;
+}
+
+void IPort::setCompactHeaders(bool enable)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   m_compactHeaders = enable;
+}
+
+void IPort::startCompactHeaders(IfcAddr_t localBase, IfcAddr_t peerBase)
+{
+   (void)localBase;
+   (void)peerBase;
+}
+
+bool IPort::isSuspended()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   return m_state == UPSTREAM_SUSPENDED;
+}
+
+bool IPort::resumeUpstream(const std::string &subDomain)
+{
+   tsd::common::logging::Logger log("tsd.communication.messaging");
+   tsd::common::system::MutexGuard g(m_lock);
+
+   while (m_state == UPSTREAM_REBINDING) {
+      m_stateCondition.wait(m_lock);
+   }
+
+   if (m_state != UPSTREAM_REBOUND) {
+      return false;
+   }
+
+   bool ret;
+   if (m_leaseAddr == m_peerAddr && m_leasePrefixLength == m_prefixLength) {
+      IfcAddr_t nameServer = m_nameServer;
+      g.unlock();
+      ret = m_router.resumeUpstreamPort(this, nameServer, subDomain);
+      g.lock();
+   } else {
+      log << tsd::common::logging::LogLevel::Warn
+          << "IPort::resumeUpstream on [" << m_router.getName()
+          << "]: previous subnet not available" << &std::endl;
+
+      // Start from scratch. Everything behind the old address is dead.
+      g.unlock();
+      m_router.delPort(this);
+      g.lock();
+      m_localAddr = m_leaseAddr + (1u << INTERFACE_ADDR_SIZE);
+      m_peerAddr = m_leaseAddr;
+      m_prefixLength = m_leasePrefixLength;
+      IfcAddr_t nameServer = m_nameServer;
+      g.unlock();
+      ret = m_router.addUpstreamPort(this, nameServer, subDomain);
+      g.lock();
+   }
+
+   if (!ret) {
+      log << tsd::common::logging::LogLevel::Error
+          << "IPort::resumeUpstream on [" << m_router.getName() << "]: router rejected port"
+          << &std::endl;
+      m_state = UPSTREAM_DEAD;
+      m_stateCondition.signal();
+   } else if (m_state == UPSTREAM_REBOUND) {
+      m_state = UPSTREAM_CONNECTED;
+      log << tsd::common::logging::LogLevel::Info
+          << "IPort::resumeUpstream on [" << m_router.getName() << "]: resumed"
+          << &std::endl;
+   } else {
+      // connection broke again while resuming
+      g.unlock();
+      m_router.suspendUpstreamPort(this);
+      g.lock();
+      ret = false;
+   }
+
+   return ret;
+}
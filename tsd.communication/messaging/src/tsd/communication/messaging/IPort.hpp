@@ -32,7 +32,8 @@ class Router;
  * state.  The main thread may call finish() at any time to tear down the port.
  * This will invoke stopPort() that must only return after the io-thread was
  * reaped. The sub-class may still receive sendPacket() calls until the
- * finish() method has returned to the main thread.
+ * finish() method has returned to the main thread. The router calls
+ * sendPacket() without holding its lock, finish() waits for these calls.
  *
  * The sendPacket() method may be called by any thread and must synchronize
  * itself as necessary.
@@ -45,6 +46,9 @@ class IPort
       UPSTREAM_BOUND,
       UPSTREAM_CONNECTED,
       UPSTREAM_DEAD,
+      UPSTREAM_SUSPENDED,
+      UPSTREAM_REBINDING,
+      UPSTREAM_REBOUND,
       DOWNSTREAM_UNCONNECTED,
       DOWNSTREAM_CONNECTED,
    };
@@ -60,8 +64,18 @@ class IPort
    tsd::common::system::CondVar m_stateCondition;
    tsd::communication::event::IfcAddr_t m_nameServer;
    thread_id_t m_ioThreadId;
+   bool m_persistent;
+   bool m_compactHeaders;
+   bool m_offerOpen;    // downstream: peer may still request another address
+   bool m_requested;    // upstream: asked peer for our previous address
+   tsd::communication::event::IfcAddr_t m_leaseAddr;
+   uint8_t m_leasePrefixLength;
+   uint32_t m_routerPins;  // sendPacket() calls of the router in flight
 
-   void processUnboundPacket(std::auto_ptr<Packet> pkt);
+   friend class Router;
+
+   void processUnboundPacket(std::auto_ptr<Packet> pkt, tsd::common::system::MutexGuard &g);
+   void processDhcpRequest(std::auto_ptr<Packet> pkt, tsd::common::system::MutexGuard &g);
 
 protected:
    /**
@@ -114,6 +128,61 @@ protected:
     */
    virtual void stopPort() = 0;
 
+   /**
+    * Keep the upstream registration when the connection breaks.
+    *
+    * Instead of removing the port from the router disconnected() will only
+    * suspend it. Interface addresses, multicast groups and name registrations
+    * stay valid while the port is suspended and all packets to the upstream
+    * router are dropped. The sub-class is expected to establish a new
+    * connection, call connected() again and finally resumeUpstream(). Must be
+    * set before initUpstream().
+    */
+   void setPersistent(bool persistent);
+
+   /**
+    * Negotiate the compact packet header with the peer, see CompactHeader.
+    *
+    * A downstream port offers it to its peer. An upstream port calls
+    * startCompactHeaders() when the offer of its peer includes it. Must be
+    * set before the port is connected.
+    */
+   void setCompactHeaders(bool enable);
+
+   /**
+    * Switch the outgoing direction to the compact header.
+    *
+    * Called by the io-thread of an upstream port when the peer offered the
+    * compact header. The sub-class must send the marker packet of a
+    * CompactHeader with the given bases before any other packet. The default
+    * implementation does nothing which keeps the fixed header in both
+    * directions.
+    */
+   virtual void startCompactHeaders(tsd::communication::event::IfcAddr_t localBase,
+                                    tsd::communication::event::IfcAddr_t peerBase);
+
+   /**
+    * Check if the port lost its connection and waits for resumeUpstream().
+    */
+   bool isSuspended();
+
+   /**
+    * Resume a suspended port on the new connection.
+    *
+    * Called by the sub-class from any thread but the io-thread after the new
+    * connection was signalled by connected(). Waits for the address offer of
+    * the upstream router and asks for the previous subnet if the router
+    * supports it. If the previous subnet is granted the router state is
+    * synchronized with the upstream router. Otherwise the port is registered
+    * anew like in initUpstream() which drops all state that referred to the
+    * old addresses.
+    *
+    * @return True if the port is connected again. If false is returned the
+    *         port is either still suspended, i.e. the connection broke again,
+    *         or it is dead for good.
+    */
+   bool resumeUpstream(const std::string &subDomain);
+
 public:
    IPort(Router &router);
    virtual ~IPort();
@@ -8,6 +8,53 @@ std::vector<uint32_t> IMessageFactory::getEventIds() const
    return std::vector<uint32_t>();
 }
 
+bool IMessageFactory::isConflatable(uint32_t /*msgId*/) const
+{
+   return false;
+}
+
+IMessageSelector::IMessageSelector()
+   : m_kind(SELECT_GENERIC)
+   , m_key(0)
+{
+}
+
+IMessageSelector::IMessageSelector(SelectorKind kind, uint64_t key)
+   : m_kind(kind)
+   , m_key(key)
+{
+}
+
+EventIdSelector::EventIdSelector(uint32_t eventId)
+   : IMessageSelector(SELECT_EVENT_ID, eventId)
+{
+}
+
+bool EventIdSelector::filterEvent(tsd::communication::event::TsdEvent *event) const
+{
+   return event->getEventId() == getKey();
+}
+
+SenderSelector::SenderSelector(tsd::communication::event::IfcAddr_t sender)
+   : IMessageSelector(SELECT_SENDER, sender)
+{
+}
+
+bool SenderSelector::filterEvent(tsd::communication::event::TsdEvent *event) const
+{
+   return event->getSenderAddr() == getKey();
+}
+
+MonitorSelector::MonitorSelector(MonitorRef_t monitor)
+   : IMessageSelector(SELECT_MONITOR, monitor)
+{
+}
+
+bool MonitorSelector::filterEvent(tsd::communication::event::TsdEvent * /*event*/) const
+{
+   return false;
+}
+
 IQueue::~IQueue()
 {
 }
@@ -6,6 +6,7 @@
  *    * clean up statele entries when networks vanish (may be multi-hop)
  */
 #include <iomanip>
+#include <iterator>
 
 #include <tsd/common/system/Clock.hpp>
 #include <tsd/common/system/MutexGuard.hpp>
@@ -17,6 +18,7 @@
 #include "utils.hpp"
 
 #define CACHE_TIMEOUT 1000
+#define REPUBLISH_TIMEOUT 5000
 
 using tsd::communication::event::IfcAddr_t;
 using tsd::communication::event::TsdEvent;
@@ -57,6 +59,10 @@ static const uint32_t QUERY_NAME_REPLY = 7;
 static const uint32_t REDIRECT_REPLY = 8;
 
 static const uint32_t NAME_REGISTERED_IND = 16;
+static const uint32_t NAME_DEREGISTERED_IND = 18;
+
+// local only, never sent over the wire
+static const uint32_t INTERFACE_DIED_IND = 17;
 
 class QuitInd
    : public TsdEvent
@@ -349,6 +355,52 @@ public:
    TsdEvent* clone(void) const { return new NameRegisteredInd; }
 };
 
+class NameDeregisteredInd
+   : public TsdEvent
+{
+   std::string m_interfaceName;
+
+public:
+   NameDeregisteredInd()
+      : TsdEvent(NAME_DEREGISTERED_IND)
+   { }
+
+   NameDeregisteredInd(const std::string &interfaceName)
+      : TsdEvent(NAME_DEREGISTERED_IND)
+      , m_interfaceName(interfaceName)
+   { }
+
+   void serialize(tsd::common::ipc::RpcBuffer& buf) const
+   {
+      buf << m_interfaceName;
+   }
+
+   void deserialize(tsd::common::ipc::RpcBuffer& buf)
+   {
+      buf >> m_interfaceName;
+   }
+
+   TsdEvent *clone() const
+   {
+      return new NameDeregisteredInd(m_interfaceName);
+   }
+
+   std::string interfaceName() const
+   {
+      return m_interfaceName;
+   }
+};
+
+class InterfaceDiedInd
+   : public TsdEvent
+{
+public:
+   InterfaceDiedInd() : TsdEvent(INTERFACE_DIED_IND) { }
+   void serialize(tsd::common::ipc::RpcBuffer& /*buf*/) const { }
+   void deserialize(tsd::common::ipc::RpcBuffer& /*buf*/) { }
+   TsdEvent* clone(void) const { return new InterfaceDiedInd; }
+};
+
 class NameServerProtocol
    : public IMessageFactory
 {
@@ -380,6 +432,9 @@ class NameServerProtocol
          case NAME_REGISTERED_IND:
             ret.reset(new NameRegisteredInd);
             break;
+         case NAME_DEREGISTERED_IND:
+            ret.reset(new NameDeregisteredInd);
+            break;
       };
 
       return ret;
@@ -396,6 +451,7 @@ class NameServerProtocol
       ret.push_back(QUERY_NAME_REPLY);
       ret.push_back(REDIRECT_REPLY);
       ret.push_back(NAME_REGISTERED_IND);
+      ret.push_back(NAME_DEREGISTERED_IND);
       return ret;
    }
 };
@@ -415,9 +471,11 @@ NameServer::NameServer(Router &router)
    , m_log("tsd.communication.messaging.nameserver")
    , m_queue(new Queue("ns-srv", m_router))
    , m_ifc(m_queue->registerInterface(nsProtocol))
+   , m_cacheGeneration(0)
    , m_upstreamNameServer(LOOPBACK_ADDRESS)
    , m_stubResolver(false)
 {
+   m_queue->setPriority(PRIORITY_CONTROL);
    m_authDomainVec.push_back("");
 }
 
@@ -434,6 +492,11 @@ void NameServer::fini()
 {
    m_queue->sendSelfMessage(std::auto_ptr<TsdEvent>(new QuitInd));
    join();
+
+   tsd::common::system::MutexGuard g(m_lock);
+   dropWatches();
+   g.unlock();
+   dropStaleMonitors();
 }
 
 IfcAddr_t NameServer::getInterfaceAddr() const
@@ -454,6 +517,19 @@ NameServer::run()
             running = false;
             break;
 
+         case INTERFACE_DIED_IND:
+            // monitor of a cached interface fired
+            invalidateCache(msg->getSenderAddr());
+            break;
+
+         case NAME_DEREGISTERED_IND:
+         {
+            // a name server that answered one of our lookups lost the name
+            NameDeregisteredInd *ind = dynamic_cast<NameDeregisteredInd*>(msg.get());
+            invalidateCache(ind->interfaceName());
+            break;
+         }
+
          case REGISTER_NAME_REQ:
          {
             RegisterNameReq *req = dynamic_cast<RegisterNameReq*>(msg.get());
@@ -545,6 +621,8 @@ NameServer::run()
             break;
          }
       }
+
+      dropStaleMonitors();
    }
 }
 
@@ -591,6 +669,7 @@ NameServer::publishInterfaceLocal(const std::string &interfaceName,
    Entry &e = m_interfaces[interfaceName];
    e.m_addr = address;
    e.m_isNameServer = isNameServer;
+   invalidateCache(interfaceName);
    g.unlock();
    m_ifc->broadcastMessage(std::auto_ptr<TsdEvent>(new NameRegisteredInd));
 
@@ -605,6 +684,7 @@ NameServer::publishInterfaceUpstream(const std::string &interfaceName,
 {
    tsd::common::system::MutexGuard g(m_lock);
    std::auto_ptr<Queue> q(new Queue("ns-publish", m_router));
+   q->setPriority(PRIORITY_CONTROL);
    IfcAddr_t nameServer = m_upstreamNameServer;
    g.unlock();
 
@@ -643,6 +723,77 @@ NameServer::publishInterfaceUpstream(const std::string &interfaceName,
    return success;
 }
 
+/**
+ * Register many names at once.
+ *
+ * All requests are sent up front and the replies are collected afterwards.
+ * The upstream name server answers in order, so the n-th reply belongs to the
+ * n-th request. Redirected registrations are retried one by one.
+ *
+ * @return Number of names that could not be registered
+ */
+size_t
+NameServer::publishInterfacesUpstream(const Interfaces &interfaces, std::string *prefix)
+{
+   if (interfaces.empty()) {
+      return 0;
+   }
+
+   tsd::common::system::MutexGuard g(m_lock);
+   std::auto_ptr<Queue> q(new Queue("ns-republish", m_router));
+   q->setPriority(PRIORITY_CONTROL);
+   IfcAddr_t nameServer = m_upstreamNameServer;
+   g.unlock();
+
+   std::auto_ptr<IRemoteIfc> ifc(q->connectInterface(nameServer, nsProtocol));
+   for (Interfaces::const_iterator it(interfaces.begin()); it != interfaces.end(); ++it) {
+      ifc->sendMessage(std::auto_ptr<TsdEvent>(
+         new RegisterNameReq(it->first, it->second.m_addr, it->second.m_isNameServer)));
+   }
+
+   Interfaces redirected;
+   size_t failed = 0;
+   Interfaces::const_iterator pending(interfaces.begin());
+   while (pending != interfaces.end()) {
+      std::auto_ptr<TsdEvent> m = q->readMessage(REPUBLISH_TIMEOUT);
+      if (m.get() == NULL) {
+         m_log << tsd::common::logging::LogLevel::Warn
+               << m_router.getName() << ": publishInterfacesUpstream: timeout" << &std::endl;
+         failed += std::distance(pending, interfaces.end());
+         break;
+      }
+
+      switch (m->getEventId()) {
+         case REGISTER_NAME_REPLY:
+         {
+            RegisterNameReply *reply = dynamic_cast<RegisterNameReply*>(m.get());
+            if (!reply->success()) {
+               m_log << tsd::common::logging::LogLevel::Warn
+                     << m_router.getName() << ": publishInterfacesUpstream("
+                     << pending->first << ") failed" << &std::endl;
+               failed++;
+            } else if (prefix != NULL) {
+               *prefix = reply->prefix();
+            }
+            ++pending;
+            break;
+         }
+         case REDIRECT_REPLY:
+            redirected.insert(*pending);
+            ++pending;
+            break;
+      }
+   }
+
+   for (Interfaces::const_iterator it(redirected.begin()); it != redirected.end(); ++it) {
+      if (!publishInterfaceUpstream(it->first, it->second.m_addr, it->second.m_isNameServer, prefix)) {
+         failed++;
+      }
+   }
+
+   return failed;
+}
+
 void
 NameServer::unpublishInterface(const std::string &interfaceName,
                                tsd::communication::event::IfcAddr_t address)
@@ -653,11 +804,11 @@ NameServer::unpublishInterface(const std::string &interfaceName,
          << std::hex << std::setfill('0') << std::setw(16) << address << ")" << &std::endl;
 
    tsd::common::system::MutexGuard g(m_lock);
+   bool stubResolver = m_stubResolver;
+   g.unlock();
 
-   if (m_stubResolver) {
-      g.unlock();
+   if (stubResolver) {
       unpublishInterfaceUpstream(interfaceName, address);
-      g.lock();
    }
    unpublishInterfaceLocal(interfaceName, address);
 }
@@ -666,9 +817,18 @@ void
 NameServer::unpublishInterfaceLocal(const std::string &interfaceName, IfcAddr_t address)
 {
    tsd::common::system::MutexGuard g(m_lock);
+   bool erased = false;
    Interfaces::iterator i(m_interfaces.find(interfaceName));
    if (i != m_interfaces.end() && i->second.m_addr == address) {
       m_interfaces.erase(i);
+      erased = true;
+   }
+   invalidateCache(interfaceName);
+   g.unlock();
+
+   // name servers that cached the name from us drop it, too
+   if (erased) {
+      m_ifc->broadcastMessage(std::auto_ptr<TsdEvent>(new NameDeregisteredInd(interfaceName)));
    }
 }
 
@@ -677,6 +837,7 @@ NameServer::unpublishInterfaceUpstream(const std::string &interfaceName, IfcAddr
 {
    tsd::common::system::MutexGuard g(m_lock);
    std::auto_ptr<Queue> q(new Queue("ns-depublish", m_router));
+   q->setPriority(PRIORITY_CONTROL);
    IfcAddr_t nameServer = m_upstreamNameServer;
    g.unlock();
 
@@ -701,14 +862,134 @@ NameServer::lookupInterface(const std::string &interfaceName, uint32_t timeout,
       ? tsd::common::system::Clock::getTickCounter()
       : 0;
 
+   dropStaleMonitors();
+
    tsd::common::system::MutexGuard g(m_lock);
 
    IfcAddr_t nameServer = getInterfaceAddr();
+
+   /*
+    * Answer from the cache or wait for a lookup of the same name that is
+    * already in progress. If that lookup fails before our own timeout has
+    * passed we try again ourself.
+    */
+   for (;;) {
+      Cache::iterator c(m_cache.find(interfaceName));
+      if (c != m_cache.end()) {
+         if (c->second.m_found) {
+            remoteAddr = c->second.m_addr;
+            m_log << tsd::common::logging::LogLevel::Debug
+                  << m_router.getName() << ": lookupInterface(" << interfaceName
+                  << "): cached " << std::hex << std::setfill('0') << std::setw(16) << remoteAddr
+                  << &std::endl;
+            return true;
+         } else if (tsd::common::system::Clock::tickTimeBefore(
+                       tsd::common::system::Clock::getTickCounter(), c->second.m_expires)) {
+            /*
+             * Recently not found. A non-blocking lookup can fail right away.
+             * Everybody else still has to wait for the registration but can
+             * skip the redirects and ask the responsible name server directly.
+             */
+            if (timeout == 0) {
+               return false;
+            }
+            nameServer = c->second.m_addr;
+         } else {
+            eraseCacheEntry(c);
+         }
+      }
+
+      Lookups::iterator l(m_lookups.find(interfaceName));
+      if (l == m_lookups.end()) {
+         break;
+      }
+
+      Lookup *lookup = l->second;
+      lookup->m_waiters++;
+      bool expired = false;
+      while (!lookup->m_done && !expired) {
+         if (timeout == INFINITE_TIMEOUT) {
+            m_lookupDone.wait(m_lock);
+         } else {
+            uint32_t elapsed = tsd::common::system::Clock::getTickCounter() - startTime;
+            if (elapsed < timeout) {
+               m_lookupDone.wait(m_lock, timeout - elapsed);
+            } else {
+               expired = true;
+            }
+         }
+      }
+
+      bool done = lookup->m_done;
+      bool found = lookup->m_found;
+      remoteAddr = lookup->m_addr;
+      if (--lookup->m_waiters == 0 && done) {
+         delete lookup;
+      }
+
+      if (found) {
+         return true;
+      } else if (expired) {
+         return false;
+      }
+   }
+
+   Lookup *lookup = new Lookup;
+   lookup->m_waiters = 0;
+   lookup->m_done = false;
+   lookup->m_found = false;
+   lookup->m_addr = LOOPBACK_ADDRESS;
+   m_lookups[interfaceName] = lookup;
+   g.unlock();
+
+   bool negative = false;
+   bool found = resolveInterface(interfaceName, timeout, startTime, nameServer, remoteAddr,
+                                 negative);
+
+   g.lock();
+   m_lookups.erase(interfaceName);
+   lookup->m_done = true;
+   lookup->m_found = found;
+   lookup->m_addr = remoteAddr;
+   if (lookup->m_waiters == 0) {
+      delete lookup;
+   } else {
+      m_lookupDone.broadcast();
+   }
+
+   if (found) {
+      g.unlock();
+      cacheInterface(interfaceName, remoteAddr);
+      watchNameServer(nameServer);
+   } else if (negative) {
+      CacheEntry &e = m_cache[interfaceName];
+      e.m_addr = nameServer;
+      e.m_found = false;
+      e.m_expires = tsd::common::system::Clock::getTickCounter() + CACHE_TIMEOUT;
+      e.m_monitor = 0;
+      e.m_generation = ++m_cacheGeneration;
+   }
+
+   return found;
+}
+
+/**
+ * Query the name servers for an interface.
+ *
+ * Starts at @p nameServer and follows redirects. On return @p nameServer is
+ * the last name server that was asked. @p negative is set if this name
+ * server replied that the name is unknown.
+ */
+bool
+NameServer::resolveInterface(const std::string &interfaceName, uint32_t timeout,
+                             uint32_t startTime, IfcAddr_t &nameServer,
+                             IfcAddr_t &remoteAddr, bool &negative)
+{
    bool found = false;
    int redirects = 42;
 
    std::auto_ptr<Queue> q(new Queue("ns-query@"+interfaceName, m_router));
-   g.unlock();
+   q->setPriority(PRIORITY_CONTROL);
    std::auto_ptr<IRemoteIfc> ifc(q->connectInterface(nameServer, nsProtocol));
    ifc->subscribe(NAME_REGISTERED_IND);
    ifc->sendMessage(std::auto_ptr<TsdEvent>(new QueryNameReq(interfaceName)));
@@ -719,11 +1000,7 @@ NameServer::lookupInterface(const std::string &interfaceName, uint32_t timeout,
          << &std::endl;
 
    while (!found && redirects > 0) {
-      std::auto_ptr<TsdEvent> m = q->readMessage(timeout);
-      if (m.get() == NULL) {
-         break;
-      }
-
+      // the time spent waiting for another lookup counts too
       if (timeout != INFINITE_TIMEOUT) {
          uint32_t endTime = tsd::common::system::Clock::getTickCounter();
          uint32_t elapsed = endTime - startTime;
@@ -735,6 +1012,11 @@ NameServer::lookupInterface(const std::string &interfaceName, uint32_t timeout,
          }
       }
 
+      std::auto_ptr<TsdEvent> m = q->readMessage(timeout);
+      if (m.get() == NULL) {
+         break;
+      }
+
       switch (m->getEventId()) {
          case QUERY_NAME_REPLY:
          {
@@ -747,6 +1029,7 @@ NameServer::lookupInterface(const std::string &interfaceName, uint32_t timeout,
                }
                found = true;
             } else {
+               negative = true;
                m_log << tsd::common::logging::LogLevel::Trace
                      << m_router.getName() << ": lookupInterface(" << interfaceName
                      << "): got negative reply"
@@ -759,6 +1042,7 @@ NameServer::lookupInterface(const std::string &interfaceName, uint32_t timeout,
          {
             RedirectReply *reply = dynamic_cast<RedirectReply*>(m.get());
             nameServer = reply->address();
+            negative = false;
             ifc.reset(q->connectInterface(nameServer, nsProtocol));
             ifc->subscribe(NAME_REGISTERED_IND);
             ifc->sendMessage(std::auto_ptr<TsdEvent>(new QueryNameReq(interfaceName)));
@@ -803,6 +1087,210 @@ NameServer::lookupInterface(const std::string &interfaceName, uint32_t timeout,
    return found;
 }
 
+/**
+ * Add positive cache entry and monitor the interface.
+ *
+ * The entry is added before the monitor is installed. If the interface is
+ * already dead the monitor fires immediately and the death notification is
+ * guaranteed to find the entry.
+ */
+void
+NameServer::cacheInterface(const std::string &interfaceName, IfcAddr_t remoteAddr)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   Cache::iterator c(m_cache.find(interfaceName));
+   if (c != m_cache.end()) {
+      eraseCacheEntry(c);
+   }
+
+   CacheEntry &e = m_cache[interfaceName];
+   e.m_addr = remoteAddr;
+   e.m_found = true;
+   e.m_expires = 0;
+   e.m_monitor = 0;
+   e.m_generation = ++m_cacheGeneration;
+   uint32_t generation = e.m_generation;
+
+   // joinGroup() takes the router lock which must not nest inside m_lock
+   g.unlock();
+   MonitorRef_t ref = m_ifc->monitor(std::auto_ptr<TsdEvent>(new InterfaceDiedInd), remoteAddr);
+   g.lock();
+
+   c = m_cache.find(interfaceName);
+   if (c != m_cache.end() && c->second.m_generation == generation) {
+      c->second.m_monitor = ref;
+   } else {
+      // invalidated in the meantime
+      m_staleMonitors.push_back(ref);
+   }
+}
+
+/**
+ * Subscribe to the deregistrations of a name server that answered a lookup.
+ *
+ * The interface of a cached name may outlive its registration. A name that is
+ * deregistered on @p nameServer is then dropped from our cache, too. A
+ * deregistration that overtakes the subscription is missed. The monitor still
+ * catches the interface dying in this case.
+ */
+void
+NameServer::watchNameServer(IfcAddr_t nameServer)
+{
+   if (nameServer == getInterfaceAddr()) {
+      // our own names are invalidated directly
+      return;
+   }
+
+   tsd::common::system::MutexGuard g(m_lock);
+   if (m_watches.find(nameServer) != m_watches.end()) {
+      return;
+   }
+
+   // joinGroup() takes the router lock which must not nest inside m_lock
+   g.unlock();
+   std::auto_ptr<IRemoteIfc> ifc(m_queue->connectInterface(nameServer, nsProtocol));
+   ifc->subscribe(NAME_DEREGISTERED_IND);
+   g.lock();
+
+   if (m_watches.find(nameServer) == m_watches.end()) {
+      m_watches[nameServer] = ifc.release();
+   } else {
+      // another lookup was faster
+      m_staleWatches.push_back(ifc.release());
+   }
+}
+
+/**
+ * Queue all name server subscriptions for removal. Must be called with
+ * m_lock held.
+ */
+void
+NameServer::dropWatches()
+{
+   for (Watches::iterator it(m_watches.begin()); it != m_watches.end(); ++it) {
+      m_staleWatches.push_back(it->second);
+   }
+   m_watches.clear();
+}
+
+/**
+ * Drop all cache entries for a name that was (de-)registered.
+ *
+ * Fully qualified lookups are matched by their last path element.
+ */
+void
+NameServer::invalidateCache(const std::string &interfaceName)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   Cache::iterator it(m_cache.begin());
+   while (it != m_cache.end()) {
+      const std::string &key = it->first;
+      bool match = (key == interfaceName);
+      if (!match && key.size() > interfaceName.size()) {
+         std::string::size_type pos = key.size() - interfaceName.size();
+         match = key[pos-1] == '/' && key.compare(pos, std::string::npos, interfaceName) == 0;
+      }
+
+      if (match) {
+         eraseCacheEntry(it++);
+      } else {
+         ++it;
+      }
+   }
+}
+
+/**
+ * Drop positive cache entries of an interface that died.
+ */
+void
+NameServer::invalidateCache(IfcAddr_t addr)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   Cache::iterator it(m_cache.begin());
+   while (it != m_cache.end()) {
+      if (it->second.m_found && it->second.m_addr == addr) {
+         eraseCacheEntry(it++);
+      } else {
+         ++it;
+      }
+   }
+}
+
+/**
+ * Drop all cache entries that point into a vanished network.
+ */
+void
+NameServer::invalidateCache(IfcAddr_t netaddr, IfcAddr_t netmask)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   Cache::iterator it(m_cache.begin());
+   while (it != m_cache.end()) {
+      if (isNetworkAddr(it->second.m_addr, netaddr, netmask)) {
+         eraseCacheEntry(it++);
+      } else {
+         ++it;
+      }
+   }
+
+   Watches::iterator w(m_watches.begin());
+   while (w != m_watches.end()) {
+      if (isNetworkAddr(w->first, netaddr, netmask)) {
+         m_staleWatches.push_back(w->second);
+         m_watches.erase(w++);
+      } else {
+         ++w;
+      }
+   }
+}
+
+void
+NameServer::flushCache()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   while (!m_cache.empty()) {
+      eraseCacheEntry(m_cache.begin());
+   }
+   dropWatches();
+}
+
+/**
+ * Remove cache entry. Must be called with m_lock held.
+ *
+ * The monitor is only queued for removal. demonitor() must not be called
+ * with m_lock held as the router might call us with its own lock held.
+ */
+void
+NameServer::eraseCacheEntry(Cache::iterator it)
+{
+   if (it->second.m_monitor != 0) {
+      m_staleMonitors.push_back(it->second.m_monitor);
+   }
+   m_cache.erase(it);
+}
+
+void
+NameServer::dropStaleMonitors()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   std::vector<MonitorRef_t> monitors;
+   monitors.swap(m_staleMonitors);
+   std::vector<IRemoteIfc*> watches;
+   watches.swap(m_staleWatches);
+   g.unlock();
+
+   for (std::vector<MonitorRef_t>::iterator it(monitors.begin()); it != monitors.end(); ++it) {
+      m_ifc->demonitor(*it);
+   }
+   for (std::vector<IRemoteIfc*>::iterator it(watches.begin()); it != watches.end(); ++it) {
+      delete *it;
+   }
+}
+
 tsd::communication::event::IfcAddr_t
 NameServer::queryInterface(const std::string &interfaceName, bool &success, bool &redirect, bool &isNameServer)
 {
@@ -886,6 +1374,7 @@ NameServer::makeLocal()
    m_authDomainStr = "";
    m_authDomainVec.clear();
    m_authDomainVec.push_back("");
+   flushCache();
 }
 
 bool
@@ -899,6 +1388,7 @@ NameServer::makeStubResolver(tsd::communication::event::IfcAddr_t address)
 
    m_upstreamNameServer = address;
    m_stubResolver = true;
+   flushCache();
 
    // FIXME: propagate registrations to upstream server
 
@@ -931,6 +1421,7 @@ NameServer::makeAuthorative(tsd::communication::event::IfcAddr_t address, const
    } else {
       m_upstreamNameServer = LOOPBACK_ADDRESS;
    }
+   flushCache();
 
    // let everybody retry as we have a upstream name server now
    g.unlock();
@@ -939,6 +1430,52 @@ NameServer::makeAuthorative(tsd::communication::event::IfcAddr_t address, const
    return ret;
 }
 
+/**
+ * Upstream connection is back after it was lost.
+ *
+ * The upstream name server has dropped our registrations. Register them again
+ * in one go: all local names as stub resolver or our own domain as
+ * authorative name server. Cached lookups are kept as the upstream addresses
+ * did not change.
+ */
+bool
+NameServer::resumeUpstream(tsd::communication::event::IfcAddr_t address, const std::string &host)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   m_upstreamNameServer = address;
+   bool stubResolver = m_stubResolver;
+
+   Interfaces names;
+   if (stubResolver) {
+      names = m_interfaces;
+   } else {
+      Entry &e = names[host];
+      e.m_addr = getInterfaceAddr();
+      e.m_isNameServer = true;
+   }
+   g.unlock();
+
+   std::string prefix;
+   size_t failed = publishInterfacesUpstream(names, stubResolver ? NULL : &prefix);
+
+   m_log << tsd::common::logging::LogLevel::Info
+         << m_router.getName() << ": resumeUpstream: registered "
+         << (names.size() - failed) << " of " << names.size() << " names" << &std::endl;
+
+   if (!stubResolver && failed == 0) {
+      g.lock();
+      m_authDomainStr = prefix + "/" + host;
+      split(m_authDomainVec, m_authDomainStr, '/');
+      g.unlock();
+   }
+
+   // let everybody retry as we have a upstream name server again
+   m_ifc->broadcastMessage(std::auto_ptr<TsdEvent>(new NameRegisteredInd));
+
+   return failed == 0;
+}
+
 void
 NameServer::portVanished(IfcAddr_t netaddr, IfcAddr_t netmask)
 {
@@ -958,6 +1495,8 @@ NameServer::portVanished(IfcAddr_t netaddr, IfcAddr_t netmask)
       }
    }
 
+   invalidateCache(netaddr, netmask);
+
    // TODO: inform upstream server, if any
    if (m_stubResolver) {
       g.unlock();
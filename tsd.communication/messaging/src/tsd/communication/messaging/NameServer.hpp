@@ -7,14 +7,17 @@
 #include <vector>
 
 #include <tsd/common/logging/Logger.hpp>
+#include <tsd/common/system/CondVar.hpp>
 #include <tsd/common/system/Thread.hpp>
 #include <tsd/communication/event/TsdEvent.hpp>
+#include <tsd/communication/messaging/types.hpp>
 
 namespace tsd { namespace communication { namespace messaging {
 
 class Queue;
 class Router;
 class ILocalIfc;
+class IRemoteIfc;
 
 class NameServer
    : protected tsd::common::system::Thread
@@ -25,6 +28,33 @@ class NameServer
    };
    typedef std::map<std::string, Entry> Interfaces;
 
+   /*
+    * Result of a previous lookupInterface(). Positive entries are valid until
+    * the interface dies, is deregistered or its port vanishes. Negative
+    * entries remember the name server that gave the final answer and expire
+    * after CACHE_TIMEOUT.
+    */
+   struct CacheEntry {
+      tsd::communication::event::IfcAddr_t m_addr;     // interface or name server
+      bool m_found;
+      uint32_t m_expires;                              // negative entries only
+      MonitorRef_t m_monitor;                          // positive entries only
+      uint32_t m_generation;
+   };
+   typedef std::map<std::string, CacheEntry> Cache;
+
+   // lookupInterface() in progress, shared by all callers of the same name
+   struct Lookup {
+      unsigned m_waiters;
+      bool m_done;
+      bool m_found;
+      tsd::communication::event::IfcAddr_t m_addr;
+   };
+   typedef std::map<std::string, Lookup*> Lookups;
+
+   // name servers that answered lookups, subscribed to their deregistrations
+   typedef std::map<tsd::communication::event::IfcAddr_t, IRemoteIfc*> Watches;
+
    Router &m_router;
    tsd::common::logging::Logger m_log;
    std::auto_ptr<Queue> m_queue;
@@ -32,6 +62,13 @@ class NameServer
 
    tsd::common::system::Mutex m_lock;
    Interfaces m_interfaces;
+   Cache m_cache;
+   uint32_t m_cacheGeneration;
+   std::vector<MonitorRef_t> m_staleMonitors;
+   Lookups m_lookups;
+   tsd::common::system::CondVar m_lookupDone;
+   Watches m_watches;
+   std::vector<IRemoteIfc*> m_staleWatches;
 
    tsd::communication::event::IfcAddr_t m_upstreamNameServer;
    std::string m_authDomainStr;
@@ -42,6 +79,7 @@ class NameServer
       bool &success, bool &redirect, bool &isNameServer);
    bool publishInterfaceUpstream(const std::string &interfaceName,
       tsd::communication::event::IfcAddr_t address, bool isNameServer, std::string *prefix);
+   size_t publishInterfacesUpstream(const Interfaces &interfaces, std::string *prefix);
    bool publishInterfaceLocal(const std::string &interfaceName,
                                   tsd::communication::event::IfcAddr_t address,
                                   bool isNameServer);
@@ -52,6 +90,20 @@ class NameServer
    bool queryInterfaceLocal(const std::string &interfaceName,
                                 tsd::communication::event::IfcAddr_t &remoteAddr,
                                 bool &isNameServer);
+   bool resolveInterface(const std::string &interfaceName, uint32_t timeout, uint32_t startTime,
+                         tsd::communication::event::IfcAddr_t &nameServer,
+                         tsd::communication::event::IfcAddr_t &remoteAddr, bool &negative);
+   void cacheInterface(const std::string &interfaceName,
+                       tsd::communication::event::IfcAddr_t remoteAddr);
+   void watchNameServer(tsd::communication::event::IfcAddr_t nameServer);
+   void dropWatches();
+   void invalidateCache(const std::string &interfaceName);
+   void invalidateCache(tsd::communication::event::IfcAddr_t addr);
+   void invalidateCache(tsd::communication::event::IfcAddr_t netaddr,
+                        tsd::communication::event::IfcAddr_t netmask);
+   void eraseCacheEntry(Cache::iterator it);
+   void flushCache();
+   void dropStaleMonitors();
 
 protected:
    void run();
@@ -72,6 +124,7 @@ public:
    void makeLocal();
    bool makeStubResolver(tsd::communication::event::IfcAddr_t address);
    bool makeAuthorative(tsd::communication::event::IfcAddr_t address, const std::string &host);
+   bool resumeUpstream(tsd::communication::event::IfcAddr_t address, const std::string &host);
 
    void portVanished(tsd::communication::event::IfcAddr_t netaddr,
                      tsd::communication::event::IfcAddr_t netmask);
@@ -4,31 +4,86 @@
 
 #include <tsd/common/ipc/rpcbuffer.h>
 
+#include "BlockPool.hpp"
 #include "Packet.hpp"
+#include "ReceiveSlab.hpp"
 
+using tsd::communication::messaging::BlockPool;
 using tsd::communication::messaging::Packet;
 
+namespace {
+
+   /*
+    * Block that events of unknown size are serialized into first. Covers the
+    * vast majority of events without wasting much memory on the small ones.
+    */
+   const size_t SERIALIZE_BLOCK = 512;
+
+   /*
+    * Serialized size of the event if it knows it, @p fallback otherwise.
+    */
+   inline size_t payloadSize(const tsd::communication::event::TsdEvent *msg, size_t fallback)
+   {
+      uint32_t size = msg->serializedSize();
+      return size != 0U ? size : fallback;
+   }
+
+}
+
 Packet::Packet(const Packet &obj)
    : m_senderAddr(obj.m_senderAddr)
    , m_receiverAddr(obj.m_receiverAddr)
    , m_eventId(obj.m_eventId)
-   , m_buffer(obj.m_buffer)
+   , m_codec(obj.m_codec)
+   , m_priority(obj.m_priority)
+   , m_conflatable(obj.m_conflatable)
+   , m_deadline(obj.m_deadline)
+   , m_payload(obj.m_payload)
+   , m_slab(obj.m_slab)
+   , m_data(obj.m_data)
+   , m_length(obj.m_length)
    , m_type(obj.m_type)
 {
-   // FIXME: reference count buffer instead of memcpy
+   if (m_payload != NULL) {
+      m_payload->m_refcnt.increment();
+   }
+   if (m_slab != NULL) {
+      m_slab->ref();
+   }
 }
 
-Packet::Packet(tsd::communication::event::TsdEvent *msg, bool multicast)
+Packet::Packet(const tsd::communication::event::TsdEvent *msg, bool multicast)
    : m_senderAddr(msg->getSenderAddr())
    , m_receiverAddr(msg->getReceiverAddr())
    , m_eventId(msg->getEventId())
+   , m_codec(0)
+   , m_priority(PRIORITY_NORMAL)
+   , m_conflatable(false)
+   , m_deadline(0)
+   , m_payload(Payload::create(payloadSize(msg, SERIALIZE_BLOCK - sizeof(Payload))))
+   , m_slab(NULL)
+   , m_data(NULL)
+   , m_length(0)
    , m_type(multicast ? MULTICAST_MESSAGE : UNICAST_MESSAGE)
 {
-   m_buffer.reserve(4096);
-
    tsd::common::ipc::RpcBuffer rpcBuf;
-   rpcBuf.init(&m_buffer);
+   rpcBuf.init(m_payload->getData(), m_payload->getCapacity());
    msg->serialize(rpcBuf);
+
+   if (!rpcBuf.didOverflow()) {
+      m_length = static_cast<uint32_t>(rpcBuf.getSize());
+      m_data = m_payload->getData();
+   } else {
+      // large event, serialize once more into a growing buffer
+      tsd::common::ipc::RpcBuffer vecBuf;
+      vecBuf.init(&m_payload->m_buffer);
+      msg->serialize(vecBuf);
+
+      m_length = static_cast<uint32_t>(m_payload->m_buffer.size());
+      if (m_length > 0) {
+         m_data = &(m_payload->m_buffer[0]);
+      }
+   }
 }
 
 Packet::Packet(Type type, tsd::communication::event::IfcAddr_t sender,
@@ -36,6 +91,14 @@ Packet::Packet(Type type, tsd::communication::event::IfcAddr_t sender,
    : m_senderAddr(sender)
    , m_receiverAddr(receiver)
    , m_eventId(0)
+   , m_codec(0)
+   , m_priority(isMessage(type) ? PRIORITY_NORMAL : PRIORITY_CONTROL)
+   , m_conflatable(false)
+   , m_deadline(0)
+   , m_payload(NULL)
+   , m_slab(NULL)
+   , m_data(NULL)
+   , m_length(0)
    , m_type(type)
 {
 }
@@ -46,13 +109,106 @@ Packet::Packet(Type type, tsd::communication::event::IfcAddr_t sender,
    : m_senderAddr(sender)
    , m_receiverAddr(receiver)
    , m_eventId(eventId)
+   , m_codec(0)
+   , m_priority(isMessage(type) ? PRIORITY_NORMAL : PRIORITY_CONTROL)
+   , m_conflatable(false)
+   , m_deadline(0)
+   , m_payload(Payload::create(bufferLength))
+   , m_slab(NULL)
+   , m_data(m_payload->getData())
+   , m_length(bufferLength)
+   , m_type(type)
+{
+   if (bufferLength > 0) {
+      std::memcpy(m_data, buffer, bufferLength);
+   }
+}
+
+/**
+ * Borrow the payload from a receive slab without copying it. The packet takes
+ * its own reference of the slab.
+ */
+Packet::Packet(Type type, tsd::communication::event::IfcAddr_t sender,
+               tsd::communication::event::IfcAddr_t receiver, uint32_t eventId,
+               ReceiveSlab *slab, size_t offset, uint32_t bufferLength)
+   : m_senderAddr(sender)
+   , m_receiverAddr(receiver)
+   , m_eventId(eventId)
+   , m_codec(0)
+   , m_priority(isMessage(type) ? PRIORITY_NORMAL : PRIORITY_CONTROL)
+   , m_conflatable(false)
+   , m_deadline(0)
+   , m_payload(NULL)
+   , m_slab(slab)
+   , m_data(slab->getData() + offset)
+   , m_length(bufferLength)
+   , m_type(type)
+{
+   m_slab->ref();
+}
+
+/**
+ * Take over the contents of @p buffer without copying. The buffer is empty
+ * afterwards.
+ */
+Packet::Packet(Type type, tsd::communication::event::IfcAddr_t sender,
+               tsd::communication::event::IfcAddr_t receiver, uint32_t eventId,
+               std::vector<char> &buffer)
+   : m_senderAddr(sender)
+   , m_receiverAddr(receiver)
+   , m_eventId(eventId)
+   , m_codec(0)
+   , m_priority(isMessage(type) ? PRIORITY_NORMAL : PRIORITY_CONTROL)
+   , m_conflatable(false)
+   , m_deadline(0)
+   , m_payload(Payload::create(0))
+   , m_slab(NULL)
+   , m_data(NULL)
+   , m_length(static_cast<uint32_t>(buffer.size()))
    , m_type(type)
 {
-   m_buffer.resize(bufferLength);
-   std::memcpy(&(m_buffer[0]), buffer, bufferLength);
+   m_payload->m_buffer.swap(buffer);
+   if (m_length > 0) {
+      m_data = &(m_payload->m_buffer[0]);
+   }
 }
 
 Packet::~Packet()
 {
+   if (m_payload != NULL) {
+      m_payload->deref();
+   }
+   if (m_slab != NULL) {
+      m_slab->deref();
+   }
+}
+
+void* Packet::operator new(size_t size)
+{
+   return BlockPool::allocate(size);
+}
+
+void Packet::operator delete(void *ptr, size_t size)
+{
+   BlockPool::release(ptr, size);
+}
+
+/**
+ * Allocate a payload with room for at least @p length bytes. The block is
+ * rounded up to its size class, see getCapacity().
+ */
+Packet::Payload* Packet::Payload::create(size_t length)
+{
+   size_t blockSize = BlockPool::getBlockSize(sizeof(Payload) + length);
+   return new (BlockPool::allocate(blockSize)) Payload(blockSize);
+}
+
+void Packet::Payload::deref()
+{
+   if (m_refcnt.decrement() == 1) {
+      size_t blockSize = m_blockSize;
+      this->~Payload();
+      BlockPool::release(this, blockSize);
+   }
 }
 
@@ -3,11 +3,14 @@
 
 #include <vector>
 
+#include <tsd/common/system/AtomicInteger.hpp>
 #include <tsd/communication/event/TsdEvent.hpp>
+#include <tsd/communication/messaging/types.hpp>
 
 namespace tsd { namespace communication { namespace messaging {
 
-// TODO: add TTL!
+class ReceiveSlab;
+
 class Packet
 {
 public:
@@ -19,19 +22,35 @@ public:
       MULTICAST_MESSAGE    = 3,
       DEATH_NOTIFICATION   = 4,
       DHCP_OFFER           = 5,
+      MULTICAST_SUBSCRIBE  = 6,
+      DHCP_REQUEST         = 7,
 
       OOB_BASE             = 128,   // OOB data is used by the transports
+      COMPACT_HEADER       = 255,   // reserved, see CompactHeader.hpp
    };
 
    Packet(const Packet &obj); // copy constructor
-   Packet(tsd::communication::event::TsdEvent *msg, bool multicast);
+   Packet(const tsd::communication::event::TsdEvent *msg, bool multicast);
    Packet(Type type, tsd::communication::event::IfcAddr_t sender,
       tsd::communication::event::IfcAddr_t receiver);
    Packet(Type type, tsd::communication::event::IfcAddr_t sender,
       tsd::communication::event::IfcAddr_t receiver, uint32_t eventId,
       const char *buffer, uint32_t bufferLength);
+   Packet(Type type, tsd::communication::event::IfcAddr_t sender,
+      tsd::communication::event::IfcAddr_t receiver, uint32_t eventId,
+      ReceiveSlab *slab, size_t offset, uint32_t bufferLength);
+   Packet(Type type, tsd::communication::event::IfcAddr_t sender,
+      tsd::communication::event::IfcAddr_t receiver, uint32_t eventId,
+      std::vector<char> &buffer);
    ~Packet();
 
+   /*
+    * Packets are created and destroyed for every routed message. Take them
+    * from the BlockPool instead of the heap.
+    */
+   static void* operator new(size_t size);
+   static void operator delete(void *ptr, size_t size);
+
    inline Type getType() const
    {
       return m_type;
@@ -64,19 +83,166 @@ public:
 
    inline size_t getBufferLength() const
    {
-      return m_buffer.size();
+      return m_length;
+   }
+
+   /**
+    * Codec of a compressed payload, see PacketCompressor. Zero if the payload
+    * is not compressed, which is always the case outside of the ports.
+    */
+   inline uint8_t getCodec() const
+   {
+      return m_codec;
+   }
+
+   inline void setCodec(uint8_t codec)
+   {
+      m_codec = codec;
+   }
+
+   /**
+    * Scheduling class in the send queues of the ports. Packets other than
+    * messages are always PRIORITY_CONTROL.
+    */
+   inline MessagePriority getPriority() const
+   {
+      return static_cast<MessagePriority>(m_priority);
+   }
+
+   /**
+    * Set the scheduling class of a message. Unknown values from the wire
+    * become PRIORITY_BULK.
+    */
+   inline void setPriority(MessagePriority priority)
+   {
+      if (isMessage(m_type)) {
+         m_priority = static_cast<uint8_t>(priority > PRIORITY_BULK ? PRIORITY_BULK : priority);
+      }
+   }
+
+   /**
+    * A conflatable message only carries the latest state of its event. The
+    * send queues of the ports replace it by a newer message with the same
+    * event ID, sender and receiver, see SendScheduler::replace().
+    */
+   inline bool isConflatable() const
+   {
+      return m_conflatable;
+   }
+
+   inline void setConflatable(bool conflatable)
+   {
+      if (isMessage(m_type)) {
+         m_conflatable = conflatable;
+      }
+   }
+
+   /**
+    * Tick count in ms after which the message is stale, zero if it never
+    * expires. See makeDeadline().
+    */
+   inline uint32_t getDeadline() const
+   {
+      return m_deadline;
+   }
+
+   inline void setDeadline(uint32_t deadline)
+   {
+      m_deadline = deadline;
+   }
+
+   /**
+    * Check if the deadline of the packet has passed at tick count @p now.
+    */
+   inline bool isExpired(uint32_t now) const
+   {
+      return isExpired(m_deadline, now);
    }
 
+   /**
+    * Deadline of a message that is sent at tick count @p now and lives for
+    * @p timeToLive ms. Zero means no deadline in both cases, hence a
+    * deadline that happens to be zero is moved by a millisecond.
+    */
+   static inline uint32_t makeDeadline(uint32_t now, uint32_t timeToLive)
+   {
+      if (timeToLive == 0) {
+         return 0;
+      }
+      uint32_t deadline = now + timeToLive;
+      return deadline != 0 ? deadline : 1;
+   }
+
+   /**
+    * Check if @p deadline has passed at tick count @p now. The tick counter
+    * wraps, so deadlines must be less than 2^31 ms away.
+    */
+   static inline bool isExpired(uint32_t deadline, uint32_t now)
+   {
+      return deadline != 0 && static_cast<int32_t>(now - deadline) >= 0;
+   }
+
+   /**
+    * Check if packets of @p type carry application messages.
+    */
+   static inline bool isMessage(Type type)
+   {
+      return type == UNICAST_MESSAGE || type == MULTICAST_MESSAGE;
+   }
+
+   /**
+    * Get payload data.
+    *
+    * The payload is shared between copies of the packet. It must not be
+    * modified.
+    */
    inline char *getBufferPtr()
    {
-      return &(m_buffer[0]);
+      return m_length > 0 ? m_data : NULL;
    }
 
 private:
+   /**
+    * Reference counted payload. Copies of a packet only duplicate the header
+    * and share the payload. Received packets borrow their payload from a
+    * ReceiveSlab instead.
+    *
+    * The payload is a BlockPool block with the data directly behind the
+    * header. Only buffers that are taken over from the caller are kept in
+    * m_buffer.
+    */
+   struct Payload {
+      tsd::common::system::AtomicInteger m_refcnt;
+      size_t m_blockSize;
+      std::vector<char> m_buffer;
+
+      explicit Payload(size_t blockSize) : m_refcnt(1), m_blockSize(blockSize) { }
+
+      static Payload* create(size_t length);
+      void deref();
+
+      inline char* getData()
+      {
+         return reinterpret_cast<char*>(this + 1);
+      }
+
+      inline size_t getCapacity() const
+      {
+         return m_blockSize - sizeof(Payload);
+      }
+   };
+
    tsd::communication::event::IfcAddr_t m_senderAddr;
    tsd::communication::event::IfcAddr_t m_receiverAddr;
    uint32_t m_eventId;
-   std::vector<char> m_buffer;
+   uint8_t m_codec;
+   uint8_t m_priority;
+   bool m_conflatable;
+   uint32_t m_deadline;
+   Payload *m_payload;
+   ReceiveSlab *m_slab;
+   char *m_data;
+   uint32_t m_length;
    Type m_type;
 
    // not assignable
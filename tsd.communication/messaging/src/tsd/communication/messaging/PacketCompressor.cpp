@@ -0,0 +1,177 @@
+#include <cstring>
+#include <time.h>
+#include <vector>
+
+#include <tsd/common/ipc/networkinteger.h>
+#include <tsd/common/system/MutexGuard.hpp>
+
+#include "Packet.hpp"
+#include "PacketCompressor.hpp"
+#include "PayloadCodec.hpp"
+
+using tsd::common::ipc::NetworkInteger;
+using tsd::communication::messaging::CompressionStats;
+using tsd::communication::messaging::HeaderFields;
+using tsd::communication::messaging::Packet;
+using tsd::communication::messaging::PacketCompressor;
+using tsd::communication::messaging::PayloadCodec;
+
+namespace {
+
+   const size_t PREFIX_SIZE = sizeof(NetworkInteger<uint32_t>);
+
+   /*
+    * Upper bound of the compression ratio that is accepted from the peer.
+    * Keeps corrupt headers from allocating huge buffers.
+    */
+   const size_t MAX_RATIO = 256;
+
+   /**
+    * CPU time of the calling thread in microseconds.
+    */
+   uint64_t threadTime()
+   {
+#ifdef CLOCK_THREAD_CPUTIME_ID
+      struct timespec ts;
+      if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) == 0) {
+         return static_cast<uint64_t>(ts.tv_sec) * 1000000u + static_cast<uint64_t>(ts.tv_nsec) / 1000u;
+      }
+#endif
+      return 0;
+   }
+
+}
+
+PacketCompressor::PacketCompressor()
+   : m_codec(NULL)
+   , m_threshold(0)
+   , m_txCodec(NULL)
+{
+}
+
+bool PacketCompressor::configure(size_t threshold, const std::string &codec)
+{
+   const PayloadCodec *c = PayloadCodec::find(codec);
+   if (c == NULL) {
+      return false;
+   }
+
+   m_codec = (threshold > 0) ? c : NULL;
+   m_threshold = threshold;
+   return true;
+}
+
+uint32_t PacketCompressor::getLocalCodecs() const
+{
+   return (m_codec != NULL) ? PayloadCodec::getSupported() : 0;
+}
+
+void PacketCompressor::setPeerCodecs(uint32_t codecs)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   if (m_codec != NULL && (codecs & (1u << m_codec->getId())) != 0) {
+      m_txCodec = m_codec;
+   }
+}
+
+void PacketCompressor::reset()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   m_txCodec = NULL;
+}
+
+std::auto_ptr<Packet> PacketCompressor::compress(std::auto_ptr<Packet> pkt)
+{
+   size_t len = pkt->getBufferLength();
+   if (m_codec == NULL || len < m_threshold || len <= PREFIX_SIZE) {
+      return pkt;
+   }
+
+   tsd::common::system::MutexGuard g(m_lock);
+   const PayloadCodec *codec = m_txCodec;
+   g.unlock();
+
+   if (codec == NULL || (pkt->getType() != Packet::UNICAST_MESSAGE &&
+                         pkt->getType() != Packet::MULTICAST_MESSAGE)) {
+      return pkt;
+   }
+
+   uint64_t start = threadTime();
+
+   // must save at least 1/16 including the prefix
+   std::vector<char> buf(len - len / 16u);
+   size_t compressed = codec->compress(reinterpret_cast<const uint8_t *>(pkt->getBufferPtr()), len,
+                                       reinterpret_cast<uint8_t *>(&buf[PREFIX_SIZE]),
+                                       buf.size() - PREFIX_SIZE);
+   if (compressed > 0) {
+      NetworkInteger<uint32_t> rawLen;
+      rawLen = static_cast<uint32_t>(len);
+      std::memcpy(&buf[0], &rawLen, PREFIX_SIZE);
+      buf.resize(PREFIX_SIZE + compressed);
+
+      std::auto_ptr<Packet> tmp(new Packet(pkt->getType(), pkt->getSenderAddr(),
+                                           pkt->getReceiverAddr(), pkt->getEventId(), buf));
+      tmp->setCodec(static_cast<uint8_t>(codec->getId()));
+      tmp->setPriority(pkt->getPriority());
+      tmp->setConflatable(pkt->isConflatable());
+      tmp->setDeadline(pkt->getDeadline());
+      pkt = tmp;
+   }
+
+   uint64_t elapsed = threadTime() - start;
+
+   g.lock();
+   m_stats.m_compressTime += elapsed;
+   if (compressed > 0) {
+      m_stats.m_compressedPackets++;
+      m_stats.m_rawBytes += len;
+      m_stats.m_compressedBytes += pkt->getBufferLength();
+   } else {
+      m_stats.m_skippedPackets++;
+   }
+
+   return pkt;
+}
+
+std::auto_ptr<Packet> PacketCompressor::decompress(const HeaderFields &hdr, const char *data)
+{
+   std::auto_ptr<Packet> ret;
+
+   const PayloadCodec *codec = PayloadCodec::find(hdr.m_codec);
+   if (codec == NULL || hdr.m_msgLen < PREFIX_SIZE) {
+      return ret;
+   }
+
+   NetworkInteger<uint32_t> prefix;
+   std::memcpy(&prefix, data, PREFIX_SIZE);
+   uint32_t rawLen = prefix;
+   size_t len = hdr.m_msgLen - PREFIX_SIZE;
+   if (rawLen > len * MAX_RATIO) {
+      return ret;
+   }
+
+   uint64_t start = threadTime();
+
+   std::vector<char> buf(rawLen);
+   if (codec->decompress(reinterpret_cast<const uint8_t *>(data + PREFIX_SIZE), len,
+                         reinterpret_cast<uint8_t *>(buf.empty() ? NULL : &buf[0]), rawLen)) {
+      ret.reset(new Packet(static_cast<Packet::Type>(hdr.m_type), hdr.m_senderAddr,
+                           hdr.m_receiverAddr, hdr.m_eventId, buf));
+   }
+
+   uint64_t elapsed = threadTime() - start;
+
+   tsd::common::system::MutexGuard g(m_lock);
+   m_stats.m_decompressTime += elapsed;
+   if (ret.get() != NULL) {
+      m_stats.m_decompressedPackets++;
+   }
+
+   return ret;
+}
+
+CompressionStats PacketCompressor::getStats()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   return m_stats;
+}
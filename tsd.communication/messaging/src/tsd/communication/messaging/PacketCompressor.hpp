@@ -0,0 +1,85 @@
+#ifndef TSD_COMMUNICATION_MESSAGING_PACKETCOMPRESSOR_HPP
+#define TSD_COMMUNICATION_MESSAGING_PACKETCOMPRESSOR_HPP
+
+#include <memory>
+#include <string>
+
+#include <tsd/common/system/Mutex.hpp>
+#include <tsd/communication/messaging/Connection.hpp>
+
+#include "CompactHeader.hpp"
+
+namespace tsd { namespace communication { namespace messaging {
+
+class Packet;
+class PayloadCodec;
+
+/**
+ * Payload compression of a port.
+ *
+ * Compression is off unless configure() selected a codec. Both sides
+ * advertise the codecs they decode in their compact header marker. Packets
+ * are only compressed after the peer advertised the configured codec, i.e.
+ * compression needs the compact header which carries the codec ID of every
+ * packet.
+ *
+ * A compressed payload starts with the uncompressed length as 32 bit network
+ * integer, followed by the output of the codec. Payloads that do not shrink
+ * by at least 1/16 are sent as they are.
+ */
+class PacketCompressor
+{
+   const PayloadCodec *m_codec;     // NULL if compression is disabled
+   size_t m_threshold;
+
+   tsd::common::system::Mutex m_lock;
+   const PayloadCodec *m_txCodec;   // m_codec once the peer accepted it
+   CompressionStats m_stats;
+
+public:
+   PacketCompressor();
+
+   /**
+    * Compress payloads of at least @p threshold bytes. Zero disables
+    * compression. Must be called before the port is started.
+    *
+    * @return False if @p codec is unknown
+    */
+   bool configure(size_t threshold, const std::string &codec);
+
+   /**
+    * @return Codecs to advertise to the peer, zero if compression is disabled
+    */
+   uint32_t getLocalCodecs() const;
+
+   /**
+    * Start compressing if @p codecs contains the configured codec.
+    */
+   void setPeerCodecs(uint32_t codecs);
+
+   /**
+    * Stop compressing until the next setPeerCodecs().
+    */
+   void reset();
+
+   /**
+    * Compress the payload of @p pkt if it is worth it. May be called
+    * concurrently by different senders.
+    *
+    * @return Compressed packet or @p pkt
+    */
+   std::auto_ptr<Packet> compress(std::auto_ptr<Packet> pkt);
+
+   /**
+    * Create a packet from a received compressed payload.
+    *
+    * @return Decompressed packet or NULL if the payload is corrupt
+    */
+   std::auto_ptr<Packet> decompress(const HeaderFields &hdr, const char *data);
+
+   CompressionStats getStats();
+};
+
+} } }
+
+#endif
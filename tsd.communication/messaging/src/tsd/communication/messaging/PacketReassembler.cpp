@@ -0,0 +1,110 @@
+
+#include <cstring>
+
+#include "PacketReassembler.hpp"
+#include "ReceiveSlab.hpp"
+
+using tsd::communication::messaging::HeaderFields;
+using tsd::communication::messaging::PacketReassembler;
+using tsd::communication::messaging::ReceiveSlab;
+
+PacketReassembler::PacketReassembler()
+   : m_limit(0)
+   , m_used(0)
+   , m_dropped(0)
+{
+}
+
+PacketReassembler::~PacketReassembler()
+{
+   reset();
+}
+
+void PacketReassembler::setLimit(size_t limit)
+{
+   m_limit = limit;
+}
+
+/**
+ * A fragment that does not fit discards the packet in progress of the same
+ * sender and receiver, if any.
+ */
+bool PacketReassembler::add(HeaderFields &hdr, const char *data, ReceiveSlab *&slab)
+{
+   slab = NULL;
+   Key key(hdr.m_senderAddr, hdr.m_receiverAddr);
+
+   if ((hdr.m_fragment & FRAGMENT_CONT) == 0) {
+      // first fragment, the last one has the continuation flag
+      if ((hdr.m_fragment & FRAGMENT_MORE) == 0 || hdr.m_totalLen <= hdr.m_msgLen) {
+         return false;
+      }
+      PartialMap::iterator it = m_partial.find(key);
+      if (it != m_partial.end()) {
+         discard(it);
+         return false;
+      }
+
+      Partial partial;
+      partial.m_slab = NULL;
+      partial.m_totalLen = hdr.m_totalLen;
+      partial.m_received = hdr.m_msgLen;
+      if (m_partial.empty() || m_used + hdr.m_totalLen <= m_limit) {
+         partial.m_slab = ReceiveSlab::allocate(hdr.m_totalLen);
+         std::memcpy(partial.m_slab->getData(), data, hdr.m_msgLen);
+         m_used += hdr.m_totalLen;
+      } else {
+         m_dropped++;
+      }
+      m_partial.insert(std::make_pair(key, partial));
+      return true;
+   }
+
+   PartialMap::iterator it = m_partial.find(key);
+   if (it == m_partial.end()) {
+      return false;
+   }
+
+   Partial &partial = it->second;
+   uint32_t received = partial.m_received + hdr.m_msgLen;
+   bool last = (hdr.m_fragment & FRAGMENT_MORE) == 0;
+   if (received < partial.m_received || received > partial.m_totalLen ||
+       last != (received == partial.m_totalLen)) {
+      discard(it);
+      return false;
+   }
+
+   if (partial.m_slab != NULL) {
+      std::memcpy(partial.m_slab->getData() + partial.m_received, data, hdr.m_msgLen);
+   }
+   partial.m_received = received;
+
+   if (last) {
+      if (partial.m_slab != NULL) {
+         slab = partial.m_slab;
+         m_used -= partial.m_totalLen;
+      }
+      hdr.m_msgLen = partial.m_totalLen;
+      hdr.m_fragment = 0;
+      hdr.m_totalLen = 0;
+      m_partial.erase(it);
+   }
+
+   return true;
+}
+
+void PacketReassembler::discard(PartialMap::iterator it)
+{
+   if (it->second.m_slab != NULL) {
+      it->second.m_slab->deref();
+      m_used -= it->second.m_totalLen;
+   }
+   m_partial.erase(it);
+}
+
+void PacketReassembler::reset()
+{
+   while (!m_partial.empty()) {
+      discard(m_partial.begin());
+   }
+}
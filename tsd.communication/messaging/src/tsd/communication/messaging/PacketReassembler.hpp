@@ -0,0 +1,95 @@
+#ifndef TSD_COMMUNICATION_MESSAGING_PACKETREASSEMBLER_HPP
+#define TSD_COMMUNICATION_MESSAGING_PACKETREASSEMBLER_HPP
+
+#include <map>
+#include <utility>
+
+#include <tsd/common/types/typedef.hpp>
+#include <tsd/communication/event/TsdEvent.hpp>
+
+#include "CompactHeader.hpp"
+
+namespace tsd { namespace communication { namespace messaging {
+
+class ReceiveSlab;
+
+/**
+ * Reassembly of fragmented packets on the receiving side of a stream
+ * transport.
+ *
+ * The sender never interleaves the fragments of two packets with the same
+ * sender and receiver, see SendScheduler. Hence at most one packet per
+ * address pair is in progress. Its payload is collected in a dedicated slab
+ * that is allocated with the size that the first fragment announces.
+ *
+ * The memory of all packets in progress is bounded by the limit. A packet
+ * that would exceed it is dropped, unless no other packet is in progress.
+ * Thus every single packet can still be received, but only one at a time if
+ * it is larger than the limit.
+ *
+ * The class is not thread safe. It is only used by the receiving thread of
+ * a port.
+ */
+class PacketReassembler
+{
+   typedef std::pair<tsd::communication::event::IfcAddr_t,
+                     tsd::communication::event::IfcAddr_t> Key;
+
+   struct Partial {
+      ReceiveSlab *m_slab;    // NULL if the packet is dropped
+      uint32_t m_totalLen;
+      uint32_t m_received;
+   };
+
+   typedef std::map<Key, Partial> PartialMap;
+
+   PartialMap m_partial;
+   size_t m_limit;
+   size_t m_used;
+   uint64_t m_dropped;
+
+   void discard(PartialMap::iterator it);
+
+   // not copyable
+   PacketReassembler(const PacketReassembler &);
+   PacketReassembler& operator=(const PacketReassembler &);
+
+public:
+   PacketReassembler();
+   ~PacketReassembler();
+
+   /**
+    * Maximum number of bytes of all packets in progress.
+    */
+   void setLimit(size_t limit);
+
+   /**
+    * Add a received fragment.
+    *
+    * @param hdr   Header of the fragment. Describes the whole packet
+    *              afterwards if it is complete.
+    * @param data  Payload of the fragment
+    * @param slab  Set to the slab with the payload of the whole packet at
+    *              offset zero, NULL if the packet is not complete or was
+    *              dropped. The caller takes over the reference.
+    * @return False if the fragment does not fit to the previous ones
+    */
+   bool add(HeaderFields &hdr, const char *data, ReceiveSlab *&slab);
+
+   /**
+    * Forget all packets in progress.
+    */
+   void reset();
+
+   /**
+    * Number of packets that were dropped because of the limit.
+    */
+   inline uint64_t getDropped() const
+   {
+      return m_dropped;
+   }
+};
+
+} } }
+
+#endif
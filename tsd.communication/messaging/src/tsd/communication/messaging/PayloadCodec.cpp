@@ -0,0 +1,274 @@
+#include <cstring>
+
+#include "PayloadCodec.hpp"
+
+using tsd::communication::messaging::PayloadCodec;
+
+namespace {
+
+   const unsigned HASH_BITS = 12;
+   const size_t MIN_MATCH = 4;
+   const size_t MAX_OFFSET = 65535;
+   const size_t LAST_LITERALS = 5;  // matches stop before the last bytes
+   const size_t MIN_INPUT = 13;     // shorter inputs are stored as literals
+
+   inline uint32_t read32(const uint8_t *p)
+   {
+      uint32_t val;
+      std::memcpy(&val, p, sizeof(val));
+      return val;
+   }
+
+   inline unsigned hash32(uint32_t val)
+   {
+      return (val * 2654435761u) >> (32u - HASH_BITS);
+   }
+
+   inline uint8_t* putLength(uint8_t *op, size_t len)
+   {
+      while (len >= 255u) {
+         *op++ = 255u;
+         len -= 255u;
+      }
+      *op++ = static_cast<uint8_t>(len);
+      return op;
+   }
+
+   inline bool getLength(const uint8_t * &ip, const uint8_t *end, size_t &len)
+   {
+      uint8_t b;
+      do {
+         if (ip == end) {
+            return false;
+         }
+         b = *ip++;
+         len += b;
+      } while (b == 255u);
+      return true;
+   }
+
+   /**
+    * Append a sequence of literals and a match. The final sequence has only
+    * literals and @p matchLen is zero.
+    *
+    * @return New output position or NULL if the sequence does not fit
+    */
+   uint8_t* putSequence(uint8_t *op, uint8_t *end, const uint8_t *lit, size_t litLen,
+                        size_t offset, size_t matchLen)
+   {
+      size_t need = 1 + litLen + litLen / 255u + 1;
+      if (matchLen > 0) {
+         need += 2 + (matchLen - MIN_MATCH) / 255u + 1;
+      }
+      if (need > static_cast<size_t>(end - op)) {
+         return NULL;
+      }
+
+      uint8_t *token = op++;
+      *token = static_cast<uint8_t>((litLen < 15u ? litLen : 15u) << 4);
+      if (litLen >= 15u) {
+         op = putLength(op, litLen - 15u);
+      }
+      std::memcpy(op, lit, litLen);
+      op += litLen;
+
+      if (matchLen > 0) {
+         *op++ = static_cast<uint8_t>(offset);
+         *op++ = static_cast<uint8_t>(offset >> 8);
+         size_t len = matchLen - MIN_MATCH;
+         *token = static_cast<uint8_t>(*token | (len < 15u ? len : 15u));
+         if (len >= 15u) {
+            op = putLength(op, len - 15u);
+         }
+      }
+
+      return op;
+   }
+
+   /**
+    * Byte oriented LZ77 codec in the spirit of LZ4.
+    *
+    * The stream is a sequence of a token byte, literals, a 16 bit little
+    * endian offset and a match. The token holds the literal length in the
+    * upper and the match length minus 4 in the lower nibble. A nibble of 15
+    * is continued by bytes that are added up until one is below 255. The last
+    * sequence ends after its literals.
+    *
+    * The compressor is greedy with a single hash table on the stack and skips
+    * faster through data that does not match, so incompressible payloads are
+    * rejected cheaply.
+    */
+   class LzCodec
+      : public PayloadCodec
+   {
+   public:
+      LzCodec() { }
+
+      unsigned getId() const
+      {
+         return LZ;
+      }
+
+      const char *getName() const
+      {
+         return "lz";
+      }
+
+      size_t compress(const uint8_t *src, size_t len, uint8_t *dst, size_t cap) const;
+      bool decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t rawLen) const;
+   };
+
+   size_t LzCodec::compress(const uint8_t *src, size_t len, uint8_t *dst, size_t cap) const
+   {
+      uint32_t table[1u << HASH_BITS];    // position + 1, zero is empty
+      uint8_t *op = dst;
+      uint8_t *end = dst + cap;
+      size_t anchor = 0;
+
+      if (len >= MIN_INPUT) {
+         const size_t matchLimit = len - LAST_LITERALS;
+         const size_t last = len - MIN_INPUT + 1;
+         size_t ip = 0;
+         size_t misses = 0;
+
+         std::memset(table, 0, sizeof(table));
+
+         while (ip < last) {
+            uint32_t seq = read32(src + ip);
+            unsigned h = hash32(seq);
+            size_t ref = table[h];
+            table[h] = static_cast<uint32_t>(ip + 1);
+
+            if (ref == 0 || ip - (ref - 1) > MAX_OFFSET || read32(src + ref - 1) != seq) {
+               ip += 1 + (misses++ >> 6);
+               continue;
+            }
+
+            ref--;
+            size_t matchLen = MIN_MATCH;
+            while (ip + matchLen < matchLimit && src[ref + matchLen] == src[ip + matchLen]) {
+               matchLen++;
+            }
+
+            op = putSequence(op, end, src + anchor, ip - anchor, ip - ref, matchLen);
+            if (op == NULL) {
+               return 0;
+            }
+
+            ip += matchLen;
+            anchor = ip;
+            misses = 0;
+            table[hash32(read32(src + ip - 2))] = static_cast<uint32_t>(ip - 1);
+         }
+      }
+
+      op = putSequence(op, end, src + anchor, len - anchor, 0, 0);
+      return (op != NULL) ? static_cast<size_t>(op - dst) : 0;
+   }
+
+   bool LzCodec::decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t rawLen) const
+   {
+      const uint8_t *ip = src;
+      const uint8_t *iend = src + len;
+      uint8_t *op = dst;
+      uint8_t *oend = dst + rawLen;
+
+      for (;;) {
+         if (ip == iend) {
+            return false;
+         }
+         unsigned token = *ip++;
+
+         size_t litLen = token >> 4;
+         if (litLen == 15u && !getLength(ip, iend, litLen)) {
+            return false;
+         }
+         if (litLen > static_cast<size_t>(iend - ip) || litLen > static_cast<size_t>(oend - op)) {
+            return false;
+         }
+         std::memcpy(op, ip, litLen);
+         ip += litLen;
+         op += litLen;
+
+         if (ip == iend) {
+            break;
+         }
+
+         if (iend - ip < 2) {
+            return false;
+         }
+         size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+         ip += 2;
+         if (offset == 0 || offset > static_cast<size_t>(op - dst)) {
+            return false;
+         }
+
+         size_t matchLen = token & 15u;
+         if (matchLen == 15u && !getLength(ip, iend, matchLen)) {
+            return false;
+         }
+         matchLen += MIN_MATCH;
+         if (matchLen > static_cast<size_t>(oend - op)) {
+            return false;
+         }
+
+         const uint8_t *match = op - offset;
+         if (offset >= matchLen) {
+            std::memcpy(op, match, matchLen);
+            op += matchLen;
+         } else {
+            // overlapping match repeats the last offset bytes
+            for (size_t i = 0; i < matchLen; i++) {
+               *op++ = *match++;
+            }
+         }
+      }
+
+      return op == oend;
+   }
+
+   const LzCodec LZ_CODEC;
+
+   const PayloadCodec * const CODECS[] = {
+      &LZ_CODEC,
+   };
+
+   const size_t NUM_CODECS = sizeof(CODECS) / sizeof(CODECS[0]);
+
+}
+
+PayloadCodec::~PayloadCodec()
+{
+}
+
+const PayloadCodec *PayloadCodec::find(unsigned id)
+{
+   for (size_t i = 0; i < NUM_CODECS; i++) {
+      if (CODECS[i]->getId() == id) {
+         return CODECS[i];
+      }
+   }
+
+   return NULL;
+}
+
+const PayloadCodec *PayloadCodec::find(const std::string &name)
+{
+   for (size_t i = 0; i < NUM_CODECS; i++) {
+      if (name == CODECS[i]->getName()) {
+         return CODECS[i];
+      }
+   }
+
+   return NULL;
+}
+
+uint32_t PayloadCodec::getSupported()
+{
+   uint32_t ret = 0;
+   for (size_t i = 0; i < NUM_CODECS; i++) {
+      ret |= 1u << CODECS[i]->getId();
+   }
+
+   return ret;
+}
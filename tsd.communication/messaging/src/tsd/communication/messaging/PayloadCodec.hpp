@@ -0,0 +1,72 @@
+#ifndef TSD_COMMUNICATION_MESSAGING_PAYLOADCODEC_HPP
+#define TSD_COMMUNICATION_MESSAGING_PAYLOADCODEC_HPP
+
+#include <stddef.h>
+#include <string>
+
+#include <tsd/common/types/typedef.hpp>
+
+namespace tsd { namespace communication { namespace messaging {
+
+/**
+ * Payload compression algorithm of the stream transports.
+ *
+ * Codecs are identified on the wire by their ID. Both sides advertise the
+ * IDs they can decode as a bit mask (see CompactHeader) and a port only
+ * compresses with a codec that the peer understands. To add a codec derive
+ * from this class and put an instance into the table in PayloadCodec.cpp.
+ *
+ * Implementations must be stateless because they are shared by all ports and
+ * called from any sending thread.
+ */
+class PayloadCodec
+{
+public:
+   // WARNING: do not change IDs! The numbers are transmitted over networks.
+   enum {
+      NONE = 0,
+      LZ   = 1,
+
+      MAX_ID = 7     // three bits in the compact header
+   };
+
+   virtual ~PayloadCodec();
+
+   virtual unsigned getId() const = 0;
+   virtual const char *getName() const = 0;
+
+   /**
+    * Compress @p len bytes at @p src.
+    *
+    * @param dst  Output buffer of @p cap bytes
+    * @return Compressed size or 0 if the result would not fit into @p cap
+    */
+   virtual size_t compress(const uint8_t *src, size_t len, uint8_t *dst, size_t cap) const = 0;
+
+   /**
+    * Decompress @p len bytes at @p src into exactly @p rawLen bytes at
+    * @p dst. Must cope with arbitrary input.
+    *
+    * @return False if the input is corrupt
+    */
+   virtual bool decompress(const uint8_t *src, size_t len, uint8_t *dst, size_t rawLen) const = 0;
+
+   /**
+    * @return Codec with the given ID or NULL if it is unknown
+    */
+   static const PayloadCodec *find(unsigned id);
+
+   /**
+    * @return Codec with the given name or NULL if it is unknown
+    */
+   static const PayloadCodec *find(const std::string &name);
+
+   /**
+    * @return Bit mask of all codec IDs that can be decoded
+    */
+   static uint32_t getSupported();
+};
+
+} } }
+
+#endif
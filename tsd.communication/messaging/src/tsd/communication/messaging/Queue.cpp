@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <set>
 #include <string>
 #include <utility>
@@ -13,6 +14,8 @@
 #include "QueueInternal.hpp"
 #include "Router.hpp"
 #include "Packet.hpp"
+#include "SharedEvent.hpp"
+#include "ShardedLock.hpp"
 #include "utils.hpp"
 
 using tsd::communication::event::TsdEvent;
@@ -57,6 +60,7 @@ public:
 
    void sendMessage(IfcAddr_t remoteIfc, std::auto_ptr<TsdEvent> msg);
    void broadcastMessage(std::auto_ptr<TsdEvent> msg);
+   void setLastValueCache(const std::vector<uint32_t> &events);
    MonitorRef_t monitor(std::auto_ptr<TsdEvent> event, IfcAddr_t addr);
    void demonitor(MonitorRef_t monitor);
 
@@ -74,8 +78,11 @@ class RemoteIfc
    bool m_dead;
    Monitors m_monitors;
    tsd::common::system::Mutex m_lock;
+   tsd::common::system::Mutex m_subscribeLock;
    std::set<uint32_t> m_subscriptions;
 
+   void announceSubscriptions(tsd::common::system::MutexGuard &g);
+
 public:
    RemoteIfc(Queue *queue, const std::string &interfaceName,
              IfcAddr_t localAddr, IfcAddr_t remoteAddr,
@@ -167,12 +174,23 @@ bool LocalIfc::isSubscribed(uint32_t /*event*/)
 
 void LocalIfc::sendMessage(IfcAddr_t remoteIfc, std::auto_ptr<TsdEvent> msg)
 {
-   m_queue->getRouter().sendUnicastMessage(getLocalIfcAddr(), remoteIfc, msg);
+   bool conflatable = m_factory.isConflatable(msg->getEventId());
+   m_queue->getRouter().sendUnicastMessage(getLocalIfcAddr(), remoteIfc, msg,
+                                         m_queue->getPriority(), m_queue->getDeadline(),
+                                         conflatable);
 }
 
 void LocalIfc::broadcastMessage(std::auto_ptr<TsdEvent> msg)
 {
-   m_queue->getRouter().sendBroadcastMessage(getLocalIfcAddr(), msg);
+   bool conflatable = m_factory.isConflatable(msg->getEventId());
+   m_queue->getRouter().sendBroadcastMessage(getLocalIfcAddr(), msg, m_queue->getPriority(),
+                                           m_queue->getDeadline(), conflatable);
+}
+
+void LocalIfc::setLastValueCache(const std::vector<uint32_t> &events)
+{
+   m_queue->getRouter().setLastValueCache(getLocalIfcAddr(),
+                                          std::set<uint32_t>(events.begin(), events.end()));
 }
 
 MonitorRef_t LocalIfc::monitor(std::auto_ptr<TsdEvent> event, IfcAddr_t addr)
@@ -304,7 +322,10 @@ bool RemoteIfc::isSubscribed(uint32_t event)
 
 void RemoteIfc::sendMessage(std::auto_ptr<TsdEvent> msg)
 {
-   m_queue->getRouter().sendUnicastMessage(getLocalIfcAddr(), getRemoteIfcAddr(), msg);
+   bool conflatable = m_factory.isConflatable(msg->getEventId());
+   m_queue->getRouter().sendUnicastMessage(getLocalIfcAddr(), getRemoteIfcAddr(), msg,
+                                         m_queue->getPriority(), m_queue->getDeadline(),
+                                         conflatable);
 }
 
 MonitorRef_t RemoteIfc::monitor(std::auto_ptr<TsdEvent> event)
@@ -349,30 +370,51 @@ void RemoteIfc::demonitor(MonitorRef_t monitor)
    m_queue->purgeMessages(monitor);
 }
 
+/*
+ * The subscriptions are announced to the router so that unwanted multicast
+ * messages are not even sent. m_subscribeLock keeps the announcements in
+ * order. It must not be m_lock because the router may call isSubscribed()
+ * while we wait for it.
+ */
+void RemoteIfc::announceSubscriptions(tsd::common::system::MutexGuard &g)
+{
+   std::set<uint32_t> subscriptions(m_subscriptions);
+   g.unlock();
+   m_queue->getRouter().setSubscriptions(getRemoteIfcAddr(), getLocalIfcAddr(), subscriptions);
+}
+
 void RemoteIfc::subscribe(uint32_t event)
 {
+   tsd::common::system::MutexGuard s(m_subscribeLock);
    tsd::common::system::MutexGuard g(m_lock);
    m_subscriptions.insert(event);
+   announceSubscriptions(g);
 }
 
 void RemoteIfc::subscribe(const std::vector<uint32_t> &events)
 {
+   tsd::common::system::MutexGuard s(m_subscribeLock);
    tsd::common::system::MutexGuard g(m_lock);
    m_subscriptions.insert(events.begin(), events.end());
+   announceSubscriptions(g);
 }
 
 void RemoteIfc::unsubscribe(uint32_t event)
 {
+   tsd::common::system::MutexGuard s(m_subscribeLock);
    tsd::common::system::MutexGuard g(m_lock);
    m_subscriptions.erase(event);
+   announceSubscriptions(g);
 }
 
 void RemoteIfc::unsubscribe(const std::vector<uint32_t> &events)
 {
+   tsd::common::system::MutexGuard s(m_subscribeLock);
    tsd::common::system::MutexGuard g(m_lock);
    for (std::vector<uint32_t>::const_iterator it(events.begin()); it != events.end(); ++it) {
       m_subscriptions.erase(*it);
    }
+   announceSubscriptions(g);
 }
 
 /*
@@ -381,9 +423,53 @@ void RemoteIfc::unsubscribe(const std::vector<uint32_t> &events)
  * The queue is 
  */
 
+/**
+ * Get the event of the slot.
+ *
+ * Shared multicast events are converted into a private copy on first access.
+ * This is deferred as long as possible to spare the copy if the event is
+ * dropped anyway.
+ */
+TsdEvent *Queue::EventSlot::getEvent()
+{
+   if (m_shared != NULL) {
+      m_event = m_shared->take(m_receiverAddr).release();
+      m_shared = NULL;
+   }
+
+   return m_event;
+}
+
+const TsdEvent *Queue::EventSlot::peekEvent() const
+{
+   return (m_shared != NULL) ? m_shared->get() : m_event;
+}
+
+void Queue::EventSlot::release()
+{
+   if (m_shared != NULL) {
+      m_shared->deref();
+   } else {
+      delete m_event;
+   }
+}
+
 Queue::Queue(const std::string &name, Router &router)
    : m_name(name)
    , m_log("tsd.communication.messaging.queue")
+   , m_waitingReaders(0)
+   , m_selectiveReaders(0)
+   , m_indexedReaders(0)
+   , m_deadSlots(0)
+   , m_capacity(UNLIMITED_CAPACITY)
+   , m_overflowPolicy(OVERFLOW_DROP_NEWEST)
+   , m_blockTimeout(0)
+   , m_blockedSenders(0)
+   , m_droppedMessages(0)
+   , m_expiredMessages(0)
+   , m_priority(PRIORITY_NORMAL)
+   , m_timeToLive(0)
+   , m_slotSeqNum(0)
    , m_router(router)
    , m_numInterfaces(0)
    , m_refSeqNum(0)
@@ -399,10 +485,7 @@ Queue::~Queue()
             << &std::endl;
    }
    for (EventQueue::iterator it(m_queue.begin()); it != m_queue.end(); ++it) {
-      delete it->m_event;
-   }
-   for (Timers::iterator it(m_timers.begin()); it != m_timers.end(); ++it) {
-      delete it->m_event;
+      it->release();
    }
 }
 
@@ -425,13 +508,15 @@ void Queue::interfaceRemoved(IfcAddr_t ifc)
    // remove all messages that are for the removed interface
    EventQueue::iterator it(m_queue.begin());
    while (it != m_queue.end()) {
-      if (it->m_event->getReceiverAddr() == ifc) {
-         delete it->m_event;
-         it = m_queue.erase(it);
+      if (!it->isDead() && it->m_receiverAddr == ifc) {
+         it->release();
+         it = removeSlot(it);
       } else {
          ++it;
       }
    }
+   trimSlots();
+   spaceAvailable();
 }
 
 ILocalIfc *Queue::registerInterface(const IMessageFactory &factory,
@@ -514,7 +599,44 @@ IRemoteIfc *Queue::connectInterface(const ILocalIfc *localIfc,
 std::auto_ptr<TsdEvent> Queue::readMessage(uint32_t timeout, IMessageSelector *selector)
 {
    tsd::common::system::MutexGuard g(m_lock);
+   return waitMessage(timeout, selector);
+}
+
+size_t Queue::readMessages(std::vector<TsdEvent*> &events, size_t max, uint32_t timeout,
+                           IMessageSelector *selector)
+{
+   size_t ret = 0;
+
+   if (max > 0) {
+      tsd::common::system::MutexGuard g(m_lock);
+
+      /*
+       * Only wait for the first message. Expired timers were queued by
+       * waitMessage() and every pushMessage() queues expired timers before the
+       * new message. Draining the queue as it is keeps the order therefore.
+       */
+      std::auto_ptr<TsdEvent> msg(waitMessage(timeout, selector));
+      while (msg.get() != NULL) {
+         events.push_back(msg.get());
+         msg.release();
+         if (++ret >= max) {
+            break;
+         }
+         msg = pullMessage(selector);
+      }
+   }
+
+   return ret;
+}
 
+/**
+ * Wait for the next message.
+ *
+ * Must be called with m_lock held exactly once. The lock is dropped while
+ * waiting.
+ */
+std::auto_ptr<TsdEvent> Queue::waitMessage(uint32_t timeout, IMessageSelector *selector)
+{
    uint32_t startTime = 0;
    uint32_t nextTimer = 0;
    if (m_timers.empty()) {
@@ -526,15 +648,27 @@ std::auto_ptr<TsdEvent> Queue::readMessage(uint32_t timeout, IMessageSelector *s
       nextTimer = checkTimerExpired(startTime);
    }
 
-   std::auto_ptr<TsdEvent> ret;
-   while ((ret = pullMessage(selector)).get() == NULL && timeout) {
+   /*
+    * Keep the index of a built-in selector while we wait, even if the queue
+    * runs empty in the meantime. New messages are indexed as they arrive.
+    */
+   std::auto_ptr<TsdEvent> ret(pullMessage(selector));
+   SelectIndexes::iterator idx(m_selectIndexes.end());
+   if (ret.get() == NULL && timeout && selector != NULL &&
+       selector->getKind() != IMessageSelector::SELECT_GENERIC) {
+      idx = m_selectIndexes.insert(std::make_pair(
+         SelectKey(selector->getKind(), selector->getKey()), SelectIndex())).first;
+      idx->second.m_readers++;
+   }
+
+   while (ret.get() == NULL && timeout) {
       uint32_t loopTimeout = timeout;
       if (nextTimer && nextTimer < timeout) {
          loopTimeout = nextTimer;
       }
 
       if (loopTimeout != INFINITE_TIMEOUT) {
-         m_queueCondition.wait(m_lock, loopTimeout);
+         waitReader(selector, loopTimeout);
 
          uint32_t endTime = tsd::common::system::Clock::getTickCounter();
          uint32_t elapsed = endTime - startTime;
@@ -554,7 +688,7 @@ std::auto_ptr<TsdEvent> Queue::readMessage(uint32_t timeout, IMessageSelector *s
             }
          }
       } else {
-         m_queueCondition.wait(m_lock);
+         waitReader(selector, INFINITE_TIMEOUT);
 
          /*
           * We have slept unconditionally. Either a message was put into the
@@ -565,64 +699,271 @@ std::auto_ptr<TsdEvent> Queue::readMessage(uint32_t timeout, IMessageSelector *s
             nextTimer = checkTimerExpired(tsd::common::system::Clock::getTickCounter());
          }
       }
+
+      ret = pullMessage(selector);
+   }
+
+   if (idx != m_selectIndexes.end() && --idx->second.m_readers == 0 && m_queue.empty()) {
+      m_selectIndexes.erase(idx);
    }
 
    return ret;
 }
 
+/**
+ * Take the next message that matches @p selector.
+ *
+ * Expired messages are dropped as they are passed. Those behind the message
+ * that is taken stay in the queue until a later read passes them.
+ */
 std::auto_ptr<TsdEvent> Queue::pullMessage(IMessageSelector *selector)
 {
    std::auto_ptr<TsdEvent> ret;
 
-   if (!m_queue.empty()) {
-      if (selector == NULL) {
-         ret.reset(m_queue.front().m_event);
-         m_queue.pop_front();
-      } else {
-         for (EventQueue::iterator it(m_queue.begin()); it != m_queue.end(); ++it) {
-            if (selector->filterEvent(it->m_event)) {
-               ret.reset(it->m_event);
-               m_queue.erase(it);
-               break;
-            }
+   if (m_queue.empty()) {
+      // nothing to do
+   } else if (selector == NULL) {
+      EventQueue::iterator it(m_queue.begin());
+      while (it != m_queue.end()) {
+         if (it->isDead()) {
+            ++it;
+         } else if (isExpired(*it)) {
+            it = dropExpired(it);
+         } else {
+            ret = takeMessage(it);
+            break;
+         }
+      }
+   } else if (selector->getKind() == IMessageSelector::SELECT_GENERIC) {
+      /*
+       * Filter the events as they are queued. Multicast events stay shared
+       * and only the matching one is turned into a private copy.
+       */
+      EventQueue::iterator it(m_queue.begin());
+      while (it != m_queue.end()) {
+         if (it->isDead()) {
+            ++it;
+         } else if (isExpired(*it)) {
+            it = dropExpired(it);
+         } else if (selector->filterEvent(const_cast<TsdEvent*>(it->peekEvent()))) {
+            ret = takeMessage(it);
+            break;
+         } else {
+            ++it;
+         }
+      }
+   } else {
+      SelectKey key(selector->getKind(), selector->getKey());
+      SelectIndexes::iterator idx(m_selectIndexes.find(key));
+      if (idx == m_selectIndexes.end()) {
+         idx = buildIndex(key);
+      }
+
+      std::deque<uint32_t> &seqs = idx->second.m_seqs;
+      while (ret.get() == NULL && !seqs.empty()) {
+         EventQueue::iterator it(findSlot(seqs.front()));
+         seqs.pop_front();
+         if (it == m_queue.end() || it->isDead()) {
+            // taken by other means
+         } else if (isExpired(*it)) {
+            dropExpired(it);
+         } else {
+            ret = takeMessage(it);
          }
       }
    }
 
+   trimSlots();
    return ret;
 }
 
-uint32_t Queue::checkTimerExpired(uint32_t now)
+/**
+ * Remove message from the queue and hand it out.
+ */
+std::auto_ptr<TsdEvent> Queue::takeMessage(EventQueue::iterator it)
 {
-   uint32_t ret = 0;
-
-   while (!m_timers.empty()) {
-      Timers::iterator next(m_timers.begin());
-      uint32_t nextTimer = next->m_expires;
-      if (tsd::common::system::Clock::tickTimeAfterEq(now, nextTimer)) {
-         bool rearm = next->m_interval != 0;
-
-         EventSlot slot;
-         slot.m_event = rearm ? next->m_event->clone() : next->m_event;
-         slot.m_ref = next->m_ref;
-         m_queue.push_back(slot);
-         m_queueCondition.broadcast();
-
-         if (rearm) {
-            Timer t(*next);
-            m_timers.erase(next);
-            t.m_expires += t.m_interval;
-            m_timers.insert(t);
+   std::auto_ptr<TsdEvent> ret(it->getEvent());
+   uint32_t ref = it->m_ref;
+   removeSlot(it);
+
+   if (ref & 1u) {
+      timerMessageDone(ref);
+   }
+   spaceAvailable();
+
+   return ret;
+}
+
+/**
+ * Check if the deadline of a queued message has passed. The clock is only
+ * read for messages that have one.
+ */
+bool Queue::isExpired(const EventSlot &slot)
+{
+   return slot.m_deadline != 0 &&
+          Packet::isExpired(slot.m_deadline, tsd::common::system::Clock::getTickCounter());
+}
+
+/**
+ * Remove an expired message from the queue.
+ *
+ * @return Iterator to the message behind it
+ */
+Queue::EventQueue::iterator Queue::dropExpired(EventQueue::iterator it)
+{
+   m_log << tsd::common::logging::LogLevel::Debug
+         << m_name << ": readMessage(" << it->peekEvent()->getEventId() << ") expired"
+         << & std::endl;
+
+   uint32_t ref = it->m_ref;
+   it->release();
+   it = removeSlot(it);
+   m_expiredMessages++;
+
+   if (ref & 1u) {
+      timerMessageDone(ref);
+   }
+   spaceAvailable();
+
+   return it;
+}
+
+/**
+ * Check if a queued message matches a built-in selector.
+ */
+bool Queue::slotMatches(const EventSlot &slot, IMessageSelector::SelectorKind kind, uint64_t key)
+{
+   switch (kind) {
+      case IMessageSelector::SELECT_EVENT_ID:
+         return slot.peekEvent()->getEventId() == key;
+      case IMessageSelector::SELECT_SENDER:
+         return slot.peekEvent()->getSenderAddr() == key;
+      case IMessageSelector::SELECT_MONITOR:
+         return slot.m_ref != 0 && slot.m_ref == key;
+      default:
+         return false;
+   }
+}
+
+/**
+ * Find queued message by its sequence number.
+ *
+ * The queue is sorted by sequence number. The comparison must cope with
+ * wrapped sequence numbers.
+ *
+ * @return Iterator to the message or m_queue.end() if it is gone
+ */
+Queue::EventQueue::iterator Queue::findSlot(uint32_t seq)
+{
+   EventQueue::iterator lo(m_queue.begin());
+   size_t count = m_queue.size();
+   while (count > 0) {
+      size_t step = count / 2;
+      EventQueue::iterator mid(lo + step);
+      if (static_cast<int32_t>(mid->m_seq - seq) < 0) {
+         lo = mid + 1;
+         count -= step + 1;
+      } else {
+         count = step;
+      }
+   }
+
+   return (lo != m_queue.end() && lo->m_seq == seq) ? lo : m_queue.end();
+}
+
+/**
+ * Mark a taken or released message as dead.
+ *
+ * Erasing from the middle of the deque would move the messages behind it.
+ * Dead slots stay in place instead until trimSlots() drops them.
+ *
+ * @return Iterator to the slot behind it
+ */
+Queue::EventQueue::iterator Queue::removeSlot(EventQueue::iterator it)
+{
+   it->m_event = NULL;
+   it->m_shared = NULL;
+   m_deadSlots++;
+
+   return it + 1;
+}
+
+/**
+ * Drop dead slots from both ends of the queue. The remaining ones are
+ * compacted once they outnumber the queued messages, which keeps the cost
+ * constant per removed message.
+ *
+ * Invalidates all iterators. The indexes of the built-in selectors are
+ * released when the queue runs empty unless some reader waits for them.
+ */
+void Queue::trimSlots()
+{
+   while (!m_queue.empty() && m_queue.front().isDead()) {
+      m_queue.pop_front();
+      m_deadSlots--;
+   }
+   while (!m_queue.empty() && m_queue.back().isDead()) {
+      m_queue.pop_back();
+      m_deadSlots--;
+   }
+
+   if (m_deadSlots > countMessages()) {
+      EventQueue::iterator out(m_queue.begin());
+      for (EventQueue::iterator it(m_queue.begin()); it != m_queue.end(); ++it) {
+         if (!it->isDead()) {
+            *out++ = *it;
+         }
+      }
+      m_queue.erase(out, m_queue.end());
+      m_deadSlots = 0;
+   }
+
+   if (m_queue.empty()) {
+      SelectIndexes::iterator idx(m_selectIndexes.begin());
+      while (idx != m_selectIndexes.end()) {
+         if (idx->second.m_readers == 0) {
+            m_selectIndexes.erase(idx++);
          } else {
-            m_timers.erase(next);
+            idx->second.m_seqs.clear();
+            ++idx;
          }
+      }
+   }
+}
+
+uint32_t Queue::checkTimerExpired(uint32_t now)
+{
+   TimerWheel::Timer *t;
+   while ((t = m_timers.expire(now)) != NULL) {
+      TsdEvent *event;
+      if (t->m_interval != 0) {
+         event = t->m_event->clone();
+         t->m_expires += t->m_interval;
+         m_timers.rearm(t);
       } else {
-         ret = nextTimer - now;
-         break;
+         // the one-shot timer stays allocated until its message is gone
+         event = t->m_event;
+         t->m_event = NULL;
       }
+
+      appendSlot(EventSlot(event, t->m_ref));
+      t->m_queued++;
    }
 
-   return ret;
+   return m_timers.nextTimeout(now);
+}
+
+/**
+ * Account for a timer message that left the queue.
+ *
+ * Frees expired one-shot timers when their last message is gone.
+ */
+void Queue::timerMessageDone(TimerRef_t ref)
+{
+   TimerWheel::Timer *t = m_timers.find(ref);
+   if (t != NULL && --t->m_queued == 0 && !t->isArmed()) {
+      m_timers.remove(t);
+   }
 }
 
 void Queue::sendSelfMessage(std::auto_ptr<TsdEvent> message)
@@ -631,7 +972,8 @@ void Queue::sendSelfMessage(std::auto_ptr<TsdEvent> message)
    pushMessage(message);
 }
 
-void Queue::pushMessage(std::auto_ptr<TsdEvent> message, uint32_t ref, bool multicast)
+void Queue::pushMessage(std::auto_ptr<TsdEvent> message, uint32_t ref, bool multicast,
+                        bool mayBlock, uint32_t deadline)
 {
    tsd::common::system::MutexGuard g(m_lock);
 
@@ -657,22 +999,72 @@ void Queue::pushMessage(std::auto_ptr<TsdEvent> message, uint32_t ref, bool mult
       }
    }
 
+   if (!admitMessage(message.get(), message->getReceiverAddr(), mayBlock)) {
+      m_log << tsd::common::logging::LogLevel::Debug
+            << m_name << ": pushMessage(" << message->getEventId() << ") overflow dropped"
+            << & std::endl;
+      return;
+   }
+
    m_log << tsd::common::logging::LogLevel::Trace
          << m_name << ": pushMessage(" << message->getEventId() << ")" << & std::endl;
 
-   EventSlot slot;
-   slot.m_event = message.release();
-   slot.m_ref = ref;
-   m_queue.push_back(slot);
-   m_queueCondition.broadcast();
+   appendSlot(EventSlot(message.get(), ref, deadline));
+   message.release();
    g.unlock();
 }
 
+/**
+ * Queue a shared multicast event.
+ *
+ * Same as pushMessage() for multicast messages but the event is shared with
+ * other receivers. A reference is only taken if the event is actually queued.
+ */
+void Queue::pushMulticastMessage(SharedEvent *event, IfcAddr_t receiver, uint32_t deadline)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   if (!m_timers.empty()) {
+      checkTimerExpired(tsd::common::system::Clock::getTickCounter());
+   }
+
+   uint32_t eventId = event->get()->getEventId();
+   InterfaceNotifications::const_iterator it(m_ifcNotifications.find(getInterface(receiver)));
+   if (it == m_ifcNotifications.end() || !it->second->isSubscribed(eventId)) {
+      m_log << tsd::common::logging::LogLevel::Trace
+            << m_name << ": pushMessage(" << eventId << ") multicast dropped"
+            << & std::endl;
+      return;
+   }
+
+   if (!admitMessage(event->get(), receiver, true)) {
+      m_log << tsd::common::logging::LogLevel::Debug
+            << m_name << ": pushMessage(" << eventId << ") overflow dropped"
+            << & std::endl;
+      return;
+   }
+
+   m_log << tsd::common::logging::LogLevel::Trace
+         << m_name << ": pushMessage(" << eventId << ") shared" << & std::endl;
+
+   event->ref();
+   appendSlot(EventSlot(event, receiver, deadline));
+}
+
 bool Queue::pushPacket(std::auto_ptr<Packet> evt, bool multicast)
 {
    tsd::common::system::MutexGuard g(m_lock);
 
    bool routed = false;
+   if (evt->getDeadline() != 0 && evt->isExpired(tsd::common::system::Clock::getTickCounter())) {
+      // stale already, no need to deserialize it
+      m_log << tsd::common::logging::LogLevel::Debug
+            << m_name << ": pushMessage(" << std::dec << evt->getEventId() << ") expired"
+            << &std::endl;
+      m_expiredMessages++;
+      return true;
+   }
+
    InterfaceFactories::const_iterator it(m_ifcFactories.find(getInterface(evt->getReceiverAddr())));
    if (it != m_ifcFactories.end()) {
       std::auto_ptr<TsdEvent> msg(it->second->createEvent(evt->getEventId()));
@@ -686,7 +1078,7 @@ bool Queue::pushPacket(std::auto_ptr<Packet> evt, bool multicast)
          // TODO: check RpcBuffer underflow
          msg->setSenderAddr(evt->getSenderAddr());
          msg->setReceiverAddr(evt->getReceiverAddr());
-         pushMessage(msg, 0, multicast);
+         pushMessage(msg, 0, multicast, false, evt->getDeadline());
          routed = true;
       } else {
          m_log << tsd::common::logging::LogLevel::Error
@@ -708,47 +1100,306 @@ void Queue::purgeMessages(uint32_t ref)
 
       EventQueue::iterator it(m_queue.begin());
       while (it != m_queue.end()) {
-         if (it->m_ref == ref) {
-            delete it->m_event;
-            it = m_queue.erase(it);
+         if (!it->isDead() && it->m_ref == ref) {
+            it->release();
+            it = removeSlot(it);
          } else {
             ++it;
          }
       }
+      trimSlots();
+      spaceAvailable();
    }
 }
 
-TimerRef_t Queue::startTimer(std::auto_ptr<TsdEvent> event, uint32_t ms, bool cyclic)
+/**
+ * Make room for a new message.
+ *
+ * Applies the overflow policy if the queue is full. Must be called with m_lock
+ * held which might be dropped temporarily to block the sender. A sender that
+ * holds a router lock is never blocked because other senders and the router
+ * management would wait for it. Messages to the loopback interface (timers,
+ * self messages) are always accepted.
+ *
+ * @return True if the message should be queued, false if it must be dropped.
+ */
+bool Queue::admitMessage(const TsdEvent *event, IfcAddr_t receiver, bool mayBlock)
 {
-   tsd::common::system::MutexGuard g(m_lock);
+   if (m_capacity == UNLIMITED_CAPACITY || countMessages() < m_capacity ||
+       receiver == LOOPBACK_ADDRESS) {
+      return true;
+   }
 
-   // allocate unique reference
-   TimerRef_t ref;
-   bool found;
-   do {
-      found = false;
-      ref = makeRef() | 1u;
-      for (Timers::iterator it(m_timers.begin()); it != m_timers.end(); ++it) {
-         if (it->m_ref == ref) {
-            found = true;
-            break;
+   switch (m_overflowPolicy) {
+      case OVERFLOW_BLOCK:
+         if (mayBlock && !ShardedLock::isHeldByCurrentThread() && waitForSpace()) {
+            return true;
+         }
+         break;
+
+      case OVERFLOW_DROP_OLDEST:
+         for (EventQueue::iterator it(m_queue.begin()); it != m_queue.end(); ++it) {
+            if (!it->isDead() && it->m_ref == 0 && it->m_receiverAddr != LOOPBACK_ADDRESS) {
+               it->release();
+               removeSlot(it);
+               trimSlots();
+               m_droppedMessages++;
+               return true;
+            }
          }
+         break;
+
+      case OVERFLOW_COALESCE:
+         for (EventQueue::iterator it(m_queue.end()); it != m_queue.begin(); ) {
+            --it;
+            if (it->isDead()) {
+               continue;
+            }
+            const TsdEvent *queued = it->peekEvent();
+            if (it->m_ref == 0 && it->m_receiverAddr == receiver &&
+                queued->getEventId() == event->getEventId() &&
+                queued->getSenderAddr() == event->getSenderAddr()) {
+               it->release();
+               removeSlot(it);
+               trimSlots();
+               m_droppedMessages++;
+               return true;
+            }
+         }
+         break;
+
+      case OVERFLOW_DROP_NEWEST:
+         break;
+   }
+
+   m_droppedMessages++;
+   return false;
+}
+
+/**
+ * Block the sender until the queue has room for another message.
+ *
+ * @return True if there is room, false if m_blockTimeout passed before.
+ */
+bool Queue::waitForSpace()
+{
+   uint32_t timeout = m_blockTimeout;
+   uint32_t startTime = tsd::common::system::Clock::getTickCounter();
+
+   m_blockedSenders++;
+   while (m_capacity != UNLIMITED_CAPACITY && countMessages() >= m_capacity && timeout) {
+      m_spaceCondition.wait(m_lock, timeout);
+
+      uint32_t endTime = tsd::common::system::Clock::getTickCounter();
+      uint32_t elapsed = endTime - startTime;
+      startTime = endTime;
+      timeout = (elapsed >= timeout) ? 0 : timeout - elapsed;
+   }
+   m_blockedSenders--;
+
+   return m_capacity == UNLIMITED_CAPACITY || countMessages() < m_capacity;
+}
+
+/**
+ * Append message to the queue and wake up the readers.
+ */
+void Queue::appendSlot(const EventSlot &slot)
+{
+   m_queue.push_back(slot);
+   EventSlot &queued = m_queue.back();
+   queued.m_seq = m_slotSeqNum++;
+
+   bool indexed = false;
+   if (!m_selectIndexes.empty()) {
+      const TsdEvent *event = queued.peekEvent();
+      indexed |= indexSlot(IMessageSelector::SELECT_EVENT_ID, event->getEventId(), queued.m_seq);
+      indexed |= indexSlot(IMessageSelector::SELECT_SENDER, event->getSenderAddr(), queued.m_seq);
+      if (queued.m_ref != 0) {
+         indexed |= indexSlot(IMessageSelector::SELECT_MONITOR, queued.m_ref, queued.m_seq);
       }
-   } while (found);
+   }
+
+   messageAvailable(indexed);
+}
+
+/**
+ * Create the index of a built-in selector from the queued messages.
+ */
+Queue::SelectIndexes::iterator Queue::buildIndex(const SelectKey &key)
+{
+   SelectIndexes::iterator idx(m_selectIndexes.insert(
+      std::make_pair(key, SelectIndex())).first);
+
+   for (EventQueue::const_iterator it(m_queue.begin()); it != m_queue.end(); ++it) {
+      if (!it->isDead() && slotMatches(*it, key.first, key.second)) {
+         idx->second.m_seqs.push_back(it->m_seq);
+      }
+   }
+
+   return idx;
+}
+
+/**
+ * Add message to the index of a built-in selector if there is one.
+ *
+ * Entries of messages that were taken by other means are pruned from the
+ * front so that the index cannot outgrow the queue.
+ *
+ * @return True if some reader waits for the message
+ */
+bool Queue::indexSlot(IMessageSelector::SelectorKind kind, uint64_t key, uint32_t seq)
+{
+   SelectIndexes::iterator idx(m_selectIndexes.find(SelectKey(kind, key)));
+   if (idx == m_selectIndexes.end()) {
+      return false;
+   }
+
+   std::deque<uint32_t> &seqs = idx->second.m_seqs;
+   uint32_t front = m_queue.front().m_seq;
+   while (!seqs.empty() && static_cast<int32_t>(seqs.front() - front) < 0) {
+      seqs.pop_front();
+   }
+   seqs.push_back(seq);
+
+   return idx->second.m_readers > 0;
+}
+
+/**
+ * Block a reader until a message might be available.
+ *
+ * Keeps track of the waiting readers so that messageAvailable() knows whom to
+ * wake up.
+ */
+void Queue::waitReader(IMessageSelector *selector, uint32_t timeout)
+{
+   IMessageSelector::SelectorKind kind =
+      (selector != NULL) ? selector->getKind() : IMessageSelector::SELECT_GENERIC;
+
+   m_waitingReaders++;
+   if (selector == NULL) {
+      // plain reader
+   } else if (kind == IMessageSelector::SELECT_GENERIC) {
+      m_selectiveReaders++;
+   } else {
+      m_indexedReaders++;
+   }
+
+   if (timeout != INFINITE_TIMEOUT) {
+      m_queueCondition.wait(m_lock, timeout);
+   } else {
+      m_queueCondition.wait(m_lock);
+   }
+
+   if (selector == NULL) {
+      // plain reader
+   } else if (kind == IMessageSelector::SELECT_GENERIC) {
+      m_selectiveReaders--;
+   } else {
+      m_indexedReaders--;
+   }
+   m_waitingReaders--;
+}
+
+/**
+ * Wake up a reader for a newly queued message.
+ *
+ * A single reader is enough because it will take the message. This does not
+ * hold if some reader uses a selector. It might not be interested in the
+ * message and would swallow the wakeup. Wake everybody in this case. Readers
+ * with a built-in selector are only of concern if the message was put into
+ * their index or if they could swallow the wakeup of a plain reader.
+ *
+ * @param indexed  True if the message matched the index of a waiting reader
+ */
+void Queue::messageAvailable(bool indexed)
+{
+   uint32_t plainReaders = m_waitingReaders - m_selectiveReaders - m_indexedReaders;
+
+   if (m_selectiveReaders > 0 || (m_indexedReaders > 0 && (indexed || plainReaders > 0))) {
+      m_queueCondition.broadcast();
+   } else if (plainReaders > 0) {
+      m_queueCondition.signal();
+   }
+}
+
+/**
+ * Wake up blocked senders after messages were removed from the queue.
+ */
+void Queue::spaceAvailable()
+{
+   if (m_blockedSenders > 0) {
+      m_spaceCondition.broadcast();
+   }
+}
+
+void Queue::setCapacity(uint32_t capacity, OverflowPolicy policy, uint32_t blockTimeout)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   m_capacity = capacity;
+   m_overflowPolicy = policy;
+   m_blockTimeout = std::min(blockTimeout, MAX_BLOCK_TIMEOUT);
+
+   // the new limit might be more relaxed or a different policy
+   spaceAvailable();
+}
+
+uint64_t Queue::getDroppedMessages()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   return m_droppedMessages;
+}
+
+/**
+ * The class is read without the lock by the sending interfaces. It is
+ * picked up by messages that are sent afterwards.
+ */
+void Queue::setPriority(MessagePriority priority)
+{
+   m_priority = priority;
+}
+
+/**
+ * The time to live is read without the lock by the sending interfaces like
+ * the priority.
+ */
+void Queue::setTimeToLive(uint32_t ms)
+{
+   m_timeToLive = ms;
+}
+
+uint64_t Queue::getExpiredMessages()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   return m_expiredMessages;
+}
+
+/**
+ * Deadline of a message that is sent now from an interface of this queue.
+ */
+uint32_t Queue::getDeadline() const
+{
+   uint32_t ttl = m_timeToLive;
+   return ttl != 0 ? Packet::makeDeadline(tsd::common::system::Clock::getTickCounter(), ttl) : 0;
+}
+
+TimerRef_t Queue::startTimer(std::auto_ptr<TsdEvent> event, uint32_t ms, bool cyclic)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   uint32_t now = tsd::common::system::Clock::getTickCounter();
+   uint32_t nextTimer = m_timers.nextTimeout(now);
 
-   // insert
    event->setReceiverAddr(LOOPBACK_ADDRESS);
-   Timer t;
-   t.m_event = event.release();
-   t.m_expires = tsd::common::system::Clock::getTickCounter() + ms;
-   t.m_interval = cyclic ? ms : 0;
-   t.m_ref = ref;
-   m_timers.insert(t);
+   TimerRef_t ref = m_timers.add(event.release(), now, ms, cyclic)->m_ref;
 
    /*
-    * Wake all readers. There is a timer and they have to adjust their timeout.
+    * Wake all readers if the next deadline moved. They have to adjust their
+    * timeout. A later timer is picked up when they wake up for the earlier one.
     */
-   m_queueCondition.broadcast();
+   if ((nextTimer == 0 || ms < nextTimer) && m_waitingReaders > 0) {
+      m_queueCondition.broadcast();
+   }
 
    return ref;
 }
@@ -759,21 +1410,20 @@ bool Queue::stopTimer(TimerRef_t timer)
 
    // pending and expired?
    bool pending = false;
-   Timers::iterator it(m_timers.begin());
-   while (it != m_timers.end()) {
-      if (it->m_ref == timer) {
-         pending = (it->m_interval > 0) || tsd::common::system::Clock::tickTimeBefore(
-            tsd::common::system::Clock::getTickCounter(), it->m_expires);
-         delete it->m_event;
-         m_timers.erase(it);
-         break;
-      } else {
-         ++it;
+   TimerWheel::Timer *t = m_timers.find(timer);
+   if (t != NULL) {
+      if (t->isArmed()) {
+         pending = (t->m_interval > 0) || tsd::common::system::Clock::tickTimeBefore(
+            tsd::common::system::Clock::getTickCounter(), t->m_expires);
       }
-   }
 
-   // timer message still in the queue?
-   purgeMessages(timer);
+      // timer message still in the queue?
+      if (t->m_queued > 0) {
+         purgeMessages(timer);
+      }
+
+      m_timers.remove(t);
+   }
 
    return pending;
 }
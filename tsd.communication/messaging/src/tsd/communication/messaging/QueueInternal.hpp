@@ -4,8 +4,8 @@
 #include <deque>
 #include <map>
 #include <memory>
-#include <set>
 #include <string>
+#include <vector>
 
 #include <tsd/common/logging/Logger.hpp>
 #include <tsd/common/system/CondVar.hpp>
@@ -14,50 +14,127 @@
 
 #include <tsd/communication/messaging/Queue.hpp>
 
+#include "BlockPool.hpp"
+#include "TimerWheel.hpp"
+
 namespace tsd { namespace communication { namespace messaging {
 
 class Router;
 class Packet;
 class IIfcNotifiy;
+class SharedEvent;
 
 class Queue
    : public IQueue
 {
    struct EventSlot {
       tsd::communication::event::TsdEvent *m_event;
+      SharedEvent *m_shared;  // multicast fan-out, used instead of m_event
+      tsd::communication::event::IfcAddr_t m_receiverAddr;
       uint32_t m_ref;
+      uint32_t m_seq;  // position in queue, assigned by appendSlot()
+      uint32_t m_deadline;  // see Packet::getDeadline()
+
+      EventSlot(tsd::communication::event::TsdEvent *event, uint32_t ref,
+                uint32_t deadline = 0)
+         : m_event(event), m_shared(NULL)
+         , m_receiverAddr(event->getReceiverAddr()), m_ref(ref), m_seq(0)
+         , m_deadline(deadline)
+      { }
+
+      EventSlot(SharedEvent *shared, tsd::communication::event::IfcAddr_t receiver,
+                uint32_t deadline)
+         : m_event(NULL), m_shared(shared)
+         , m_receiverAddr(receiver), m_ref(0), m_seq(0)
+         , m_deadline(deadline)
+      { }
+
+      tsd::communication::event::TsdEvent *getEvent();
+      const tsd::communication::event::TsdEvent *peekEvent() const;
+      void release();
+
+      // message was taken or released, see removeSlot()
+      inline bool isDead() const
+      {
+         return m_event == NULL && m_shared == NULL;
+      }
    };
-   typedef std::deque<EventSlot> EventQueue;
+   typedef std::deque<EventSlot, PoolAllocator<EventSlot> > EventQueue;
    typedef std::map<tsd::communication::event::IfcAddr_t, const IMessageFactory*> InterfaceFactories;
    typedef std::map<tsd::communication::event::IfcAddr_t, IIfcNotifiy*> InterfaceNotifications;
 
-   struct Timer {
-      tsd::communication::event::TsdEvent *m_event;
-      uint32_t m_expires;
-      uint32_t m_interval;
-      TimerRef_t m_ref;
-
-      inline bool operator<(const Timer& rhs) const
-      {
-         return m_expires < rhs.m_expires;
-      }
+   /*
+    * Index of queued messages for the built-in selectors. An index is built
+    * by the first read with the selector and kept up to date as long as the
+    * queue holds messages or some reader waits with the selector. It holds
+    * the sequence numbers of matching messages in queue order. Messages that
+    * were taken by other means are skipped lazily.
+    */
+   struct SelectIndex {
+      uint32_t m_readers;
+      std::deque<uint32_t> m_seqs;
+
+      SelectIndex() : m_readers(0) { }
    };
-   typedef std::multiset<Timer> Timers;
+   typedef std::pair<IMessageSelector::SelectorKind, uint64_t> SelectKey;
+   typedef std::map<SelectKey, SelectIndex> SelectIndexes;
 
    std::string m_name;
    tsd::common::logging::Logger m_log;
    tsd::common::system::Mutex m_lock;
    tsd::common::system::CondVar m_queueCondition;
+   uint32_t m_waitingReaders;
+   uint32_t m_selectiveReaders;
+   uint32_t m_indexedReaders;
+   tsd::common::system::CondVar m_spaceCondition;
    EventQueue m_queue;
+   size_t m_deadSlots;
+   uint32_t m_capacity;
+   OverflowPolicy m_overflowPolicy;
+   uint32_t m_blockTimeout;
+   uint32_t m_blockedSenders;
+   uint64_t m_droppedMessages;
+   uint64_t m_expiredMessages;
+   MessagePriority m_priority;
+   uint32_t m_timeToLive;
    InterfaceFactories m_ifcFactories;
    InterfaceNotifications m_ifcNotifications;
+   SelectIndexes m_selectIndexes;
+   uint32_t m_slotSeqNum;
    Router &m_router;
    uint32_t m_numInterfaces;
    uint32_t m_refSeqNum;
-   Timers m_timers;
+   TimerWheel m_timers;
 
    std::auto_ptr<tsd::communication::event::TsdEvent> pullMessage(IMessageSelector *selector);
+   std::auto_ptr<tsd::communication::event::TsdEvent> takeMessage(EventQueue::iterator it);
+   bool isExpired(const EventSlot &slot);
+   EventQueue::iterator dropExpired(EventQueue::iterator it);
+   EventQueue::iterator findSlot(uint32_t seq);
+   EventQueue::iterator removeSlot(EventQueue::iterator it);
+   void trimSlots();
+
+   inline size_t countMessages() const
+   {
+      return m_queue.size() - m_deadSlots;
+   }
+
+   void appendSlot(const EventSlot &slot);
+   SelectIndexes::iterator buildIndex(const SelectKey &key);
+   bool indexSlot(IMessageSelector::SelectorKind kind, uint64_t key, uint32_t seq);
+   static bool slotMatches(const EventSlot &slot, IMessageSelector::SelectorKind kind,
+                           uint64_t key);
+   std::auto_ptr<tsd::communication::event::TsdEvent> waitMessage(uint32_t timeout,
+                                                                   IMessageSelector *selector);
    uint32_t checkTimerExpired(uint32_t now);
+   void timerMessageDone(TimerRef_t ref);
+   bool admitMessage(const tsd::communication::event::TsdEvent *event,
+                     tsd::communication::event::IfcAddr_t receiver,
+                     bool mayBlock);
+   bool waitForSpace();
+   void spaceAvailable();
+   void messageAvailable(bool indexed);
+   void waitReader(IMessageSelector *selector, uint32_t timeout);
 
 public:
    Queue(const std::string &name, Router &router);
@@ -76,9 +153,18 @@ public:
    std::auto_ptr<tsd::communication::event::TsdEvent> readMessage(
       uint32_t timeout = INFINITE_TIMEOUT,
       IMessageSelector *selector = NULL);
+   size_t readMessages(std::vector<tsd::communication::event::TsdEvent*> &events,
+                       size_t max, uint32_t timeout = INFINITE_TIMEOUT,
+                       IMessageSelector *selector = NULL);
    void sendSelfMessage(std::auto_ptr<tsd::communication::event::TsdEvent> msg);
    TimerRef_t startTimer(std::auto_ptr<tsd::communication::event::TsdEvent> event, uint32_t ms, bool cyclic);
    bool stopTimer(TimerRef_t timer);
+   void setCapacity(uint32_t capacity, OverflowPolicy policy = OVERFLOW_DROP_NEWEST,
+                    uint32_t blockTimeout = 100);
+   uint64_t getDroppedMessages();
+   void setPriority(MessagePriority priority);
+   void setTimeToLive(uint32_t ms);
+   uint64_t getExpiredMessages();
 
    // iternal methods
 
@@ -88,10 +174,15 @@ public:
    void interfaceRemoved(tsd::communication::event::IfcAddr_t ifc);
 
    void pushMessage(std::auto_ptr<tsd::communication::event::TsdEvent> msg,
-                    uint32_t ref = 0, bool multicast = false);
+                    uint32_t ref = 0, bool multicast = false, bool mayBlock = false,
+                    uint32_t deadline = 0);
+   void pushMulticastMessage(SharedEvent *event, tsd::communication::event::IfcAddr_t receiver,
+                             uint32_t deadline = 0);
    bool pushPacket(std::auto_ptr<Packet> evt, bool multicast);
    void purgeMessages(uint32_t ref);
    inline Router& getRouter() { return m_router; }
+   inline MessagePriority getPriority() const { return m_priority; }
+   uint32_t getDeadline() const;
 
    IRemoteIfc *connectInterface(tsd::communication::event::IfcAddr_t remoteAddr,
                                 const IMessageFactory &factory);
@@ -0,0 +1,307 @@
+/**
+ * @file Reactor.cpp
+ *
+ * Process wide pool of event loops for the socket ports.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <pthread.h>
+#include <sched.h>
+#include <sstream>
+
+#include <tsd/common/system/MutexGuard.hpp>
+
+#include "Reactor.hpp"
+
+namespace tsd { namespace communication { namespace messaging {
+
+IReactorTask::~IReactorTask()
+{
+}
+
+/*****************************************************************************/
+
+ReactorLoop::ReactorLoop(const std::string &name, int cpu)
+   : tsd::common::system::Thread(name)
+   , m_log("tsd.communication.messaging.Reactor")
+   , m_running(false)
+   , m_threadId(0)
+   , m_cpu(cpu)
+   , m_users(0)
+{
+}
+
+ReactorLoop::~ReactorLoop()
+{
+}
+
+bool ReactorLoop::startLoop()
+{
+   if (!m_select.init()) {
+      return false;
+   }
+
+   m_running = true;
+   start();
+   return true;
+}
+
+void ReactorLoop::stopLoop()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   m_running = false;
+   g.unlock();
+
+   m_select.interrupt();
+   join();
+}
+
+bool ReactorLoop::isLoopThread() const
+{
+   return m_threadId == tsd::common::system::Thread::myself();
+}
+
+void ReactorLoop::post(IReactorTask *task)
+{
+   PendingTask pending = { task, NULL };
+
+   tsd::common::system::MutexGuard g(m_lock);
+   m_tasks.push_back(pending);
+   g.unlock();
+
+   m_select.interrupt();
+}
+
+void ReactorLoop::call(IReactorTask &task)
+{
+   if (isLoopThread()) {
+      task.reactorRun();
+      return;
+   }
+
+   bool done = false;
+   PendingTask pending = { &task, &done };
+
+   tsd::common::system::MutexGuard g(m_lock);
+   m_tasks.push_back(pending);
+   g.unlock();
+
+   m_select.interrupt();
+
+   g.lock();
+   while (!done) {
+      m_callDone.wait(m_lock);
+   }
+}
+
+/**
+ * The loop dispatches the Select until it is interrupted and then works off
+ * the queued tasks. Tasks that are queued while the loop is stopped are still
+ * executed before the thread exits.
+ */
+void ReactorLoop::run()
+{
+   m_threadId = tsd::common::system::Thread::myself();
+
+   if (m_cpu >= 0) {
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(m_cpu, &cpus);
+      int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+      if (err != 0) {
+         m_log << tsd::common::logging::LogLevel::Warn
+               << "Cannot pin reactor thread to CPU " << m_cpu << ": " << err
+               << &std::endl;
+      }
+   }
+
+   tsd::common::system::MutexGuard g(m_lock);
+
+   for (;;) {
+      while (!m_tasks.empty()) {
+         PendingTask pending = m_tasks.front();
+         m_tasks.pop_front();
+
+         g.unlock();
+         pending.m_task->reactorRun();
+         g.lock();
+
+         if (pending.m_done != NULL) {
+            *pending.m_done = true;
+            m_callDone.broadcast();
+         }
+      }
+
+      if (!m_running) {
+         break;
+      }
+
+      g.unlock();
+      m_select.dispatch();
+      g.lock();
+   }
+}
+
+/*****************************************************************************/
+
+Reactor::Reactor()
+   : m_log("tsd.communication.messaging.Reactor")
+   , m_threads(1)
+{
+   const char *threads = std::getenv("TSD_COMMUNICATION_REACTOR_THREADS");
+   const char *cpus = std::getenv("TSD_COMMUNICATION_REACTOR_CPUS");
+
+   configureLocked(threads != NULL ? std::strtoul(threads, NULL, 0) : 1,
+                   cpus != NULL ? cpus : "");
+}
+
+Reactor::~Reactor()
+{
+}
+
+/**
+ * The pool is never destroyed. Ports may still be around while static
+ * objects are destructed.
+ */
+Reactor& Reactor::getInstance()
+{
+   static Reactor *instance = new Reactor;
+   return *instance;
+}
+
+void Reactor::configureLocked(unsigned threads, const std::string &cpus)
+{
+   m_threads = threads > 0 ? threads : 1;
+
+   m_cpus.clear();
+   std::stringstream list(cpus);
+   std::string cpu;
+   while (std::getline(list, cpu, ',')) {
+      char *end = NULL;
+      unsigned long num = std::strtoul(cpu.c_str(), &end, 0);
+      if (cpu.empty() || *end != '\0' || num >= CPU_SETSIZE) {
+         m_log << tsd::common::logging::LogLevel::Warn
+               << "Ignoring invalid reactor CPU '" << cpu << "'" << &std::endl;
+      } else {
+         m_cpus.push_back(static_cast<int>(num));
+      }
+   }
+}
+
+/**
+ * Start a new loop in @p slot. Called with the lock held.
+ */
+ReactorLoop* Reactor::startLoop(size_t slot)
+{
+   std::ostringstream name;
+   name << "Reactor";
+   if (slot > 0) {
+      name << "." << slot;
+   }
+
+   int cpu = m_cpus.empty() ? -1 : m_cpus[slot % m_cpus.size()];
+   ReactorLoop *loop = new ReactorLoop(name.str(), cpu);
+   if (!loop->startLoop()) {
+      m_log << tsd::common::logging::LogLevel::Error
+            << "Reactor: Selector init failed!" << &std::endl;
+      delete loop;
+      return NULL;
+   }
+
+   if (slot >= m_loops.size()) {
+      m_loops.resize(slot + 1, NULL);
+   }
+   m_loops[slot] = loop;
+
+   return loop;
+}
+
+void Reactor::configure(unsigned threads, const std::string &cpus)
+{
+   Reactor &self = getInstance();
+
+   tsd::common::system::MutexGuard g(self.m_lock);
+   self.configureLocked(threads, cpus);
+}
+
+ReactorLoop* Reactor::attach()
+{
+   std::vector<ReactorLoop*> loops;
+   return attach(1, loops) ? loops.front() : NULL;
+}
+
+/**
+ * Pick the least used loops. An idle slot is preferred over a loop that is
+ * already in use as long as the pool has not reached its size.
+ */
+bool Reactor::attach(unsigned count, std::vector<ReactorLoop*> &loops)
+{
+   Reactor &self = getInstance();
+   tsd::common::system::MutexGuard g(self.m_lock);
+
+   size_t limit = std::max<size_t>(self.m_threads, count);
+   std::vector<ReactorLoop*> chosen;
+
+   while (chosen.size() < count) {
+      ReactorLoop *best = NULL;
+      size_t freeSlot = limit;
+
+      for (size_t slot = 0; slot < limit; slot++) {
+         ReactorLoop *loop = slot < self.m_loops.size() ? self.m_loops[slot] : NULL;
+         if (loop == NULL) {
+            if (freeSlot == limit) {
+               freeSlot = slot;
+            }
+         } else if (std::find(chosen.begin(), chosen.end(), loop) == chosen.end() &&
+                    (best == NULL || loop->m_users < best->m_users)) {
+            best = loop;
+         }
+      }
+
+      if ((best == NULL || best->m_users > 0) && freeSlot < limit) {
+         ReactorLoop *loop = self.startLoop(freeSlot);
+         if (loop != NULL) {
+            best = loop;
+         }
+      }
+
+      if (best == NULL) {
+         break;
+      }
+
+      best->m_users++;
+      chosen.push_back(best);
+   }
+
+   if (chosen.size() < count) {
+      g.unlock();
+      for (std::vector<ReactorLoop*>::iterator it(chosen.begin()); it != chosen.end(); ++it) {
+         detach(*it);
+      }
+      return false;
+   }
+
+   loops.insert(loops.end(), chosen.begin(), chosen.end());
+   return true;
+}
+
+void Reactor::detach(ReactorLoop *loop)
+{
+   Reactor &self = getInstance();
+   tsd::common::system::MutexGuard g(self.m_lock);
+
+   if (--loop->m_users == 0) {
+      for (LoopList::iterator it(self.m_loops.begin()); it != self.m_loops.end(); ++it) {
+         if (*it == loop) {
+            *it = NULL;
+         }
+      }
+      g.unlock();
+
+      loop->stopLoop();
+      delete loop;
+   }
+}
+
+} } }
@@ -0,0 +1,190 @@
+/**
+ * @file Reactor.hpp
+ *
+ * Process wide pool of event loops for the socket ports.
+ */
+
+#ifndef TSD_COMMUNICATION_MESSAGING_REACTOR_HPP
+#define TSD_COMMUNICATION_MESSAGING_REACTOR_HPP
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <tsd/common/logging/Logger.hpp>
+#include <tsd/common/system/CondVar.hpp>
+#include <tsd/common/system/Mutex.hpp>
+#include <tsd/common/system/Thread.hpp>
+
+#include "Select.hpp"
+
+namespace tsd { namespace communication { namespace messaging {
+
+/**
+ * Work item that is executed by a ReactorLoop.
+ */
+class IReactorTask
+{
+public:
+   virtual ~IReactorTask();
+
+   virtual void reactorRun() = 0;
+};
+
+/**
+ * One thread of the reactor pool.
+ *
+ * The Select of the loop is single threaded like any other. Every access to
+ * it, including adding and disposing sources, must happen on the loop
+ * thread. Other threads hand over their work with post() or call().
+ */
+class ReactorLoop
+   : private tsd::common::system::Thread
+{
+   friend class Reactor;
+
+   /**
+    * Adapter to run a member function as IReactorTask.
+    */
+   template <class T>
+   class MethodTask
+      : public IReactorTask
+   {
+      T &m_obj;
+      void (T::*m_method)();
+
+   public:
+      MethodTask(T &obj, void (T::*method)()) : m_obj(obj), m_method(method) { }
+      void reactorRun() { (m_obj.*m_method)(); }
+   };
+
+   struct PendingTask {
+      IReactorTask *m_task;
+      bool *m_done;  // set for synchronous calls
+   };
+
+   typedef std::deque<PendingTask> TaskQueue;
+
+   tsd::common::logging::Logger m_log;
+   Select m_select;
+   tsd::common::system::Mutex m_lock;
+   tsd::common::system::CondVar m_callDone;
+   TaskQueue m_tasks;
+   bool m_running;
+   thread_id_t m_threadId;
+   int m_cpu;          // -1 if not pinned
+   unsigned m_users;   // protected by the lock of the Reactor
+
+   ReactorLoop(const std::string &name, int cpu);
+   ~ReactorLoop();
+
+   bool startLoop();
+   void stopLoop();
+   void run(); // tsd::common::system::Thread
+
+public:
+   /**
+    * Event loop of the thread. Must only be used on the loop thread.
+    */
+   inline Select& getSelect() { return m_select; }
+
+   /**
+    * Check if the caller runs on the loop thread.
+    */
+   bool isLoopThread() const;
+
+   /**
+    * Queue task for execution on the loop thread. May be called from any
+    * thread.
+    *
+    * The task is not owned by the loop and must stay valid until it was run.
+    * Tasks are executed in the order they were posted.
+    */
+   void post(IReactorTask *task);
+
+   /**
+    * Execute task on the loop thread and wait for its completion.
+    *
+    * From other threads the task is queued behind the tasks that were posted
+    * before, which have thus finished when the method returns. On the loop
+    * thread the task runs directly instead. Waiting for it would deadlock.
+    * Tasks that are still queued then run after it.
+    */
+   void call(IReactorTask &task);
+
+   template <class T>
+   inline void call(T &obj, void (T::*method)())
+   {
+      MethodTask<T> task(obj, method);
+      call(task);
+   }
+};
+
+/**
+ * Process wide pool of event loops.
+ *
+ * Instead of spawning an own thread per connection the socket ports attach to
+ * one of the loops of the pool. The loops are started on demand and stopped
+ * when the last port detached from them.
+ *
+ * The pool size is taken from the TSD_COMMUNICATION_REACTOR_THREADS
+ * environment variable (default: 1) or set by configure(). Loops can be
+ * pinned to CPUs by a comma separated list in TSD_COMMUNICATION_REACTOR_CPUS,
+ * where loop N uses the N-th entry modulo the list length.
+ */
+class Reactor
+{
+   typedef std::vector<ReactorLoop*> LoopList;
+
+   tsd::common::logging::Logger m_log;
+   tsd::common::system::Mutex m_lock;
+   LoopList m_loops;            // by slot, NULL if not running
+   unsigned m_threads;
+   std::vector<int> m_cpus;
+
+   Reactor();
+   ~Reactor();
+
+   static Reactor& getInstance();
+
+   ReactorLoop* startLoop(size_t slot);
+   void configureLocked(unsigned threads, const std::string &cpus);
+
+public:
+   /**
+    * Set pool size and CPU affinity.
+    *
+    * Only affects loops that are started afterwards.
+    *
+    * @param threads  Maximum number of loops that are shared by the ports
+    * @param cpus     Comma separated list of CPUs, empty for no pinning
+    */
+   static void configure(unsigned threads, const std::string &cpus);
+
+   /**
+    * Attach to the least used loop.
+    *
+    * @return Loop or NULL if no loop could be started
+    */
+   static ReactorLoop* attach();
+
+   /**
+    * Attach to @p count distinct loops.
+    *
+    * The pool is grown beyond its configured size if it has less than
+    * @p count loops.
+    *
+    * @return True if all loops could be attached. Nothing is attached if
+    *         false is returned.
+    */
+   static bool attach(unsigned count, std::vector<ReactorLoop*> &loops);
+
+   /**
+    * Release loop. Must not be called from the loop thread.
+    */
+   static void detach(ReactorLoop *loop);
+};
+
+} } }
+
+#endif
@@ -0,0 +1,92 @@
+#include <cstdlib>
+
+#include <tsd/common/assert.hpp>
+#include <tsd/common/system/Mutex.hpp>
+#include <tsd/common/system/MutexGuard.hpp>
+
+#include "ReceiveSlab.hpp"
+
+namespace tsd { namespace communication { namespace messaging {
+
+namespace {
+
+   /*
+    * Upper bound of idle slabs that are kept for reuse. Anything beyond is
+    * freed to give the memory back after a burst.
+    */
+   const size_t MAX_POOLED = 64;
+
+   struct SlabPool {
+      tsd::common::system::Mutex m_lock;
+      ReceiveSlab *m_free;
+      size_t m_count;
+
+      SlabPool() : m_free(NULL), m_count(0) { }
+   };
+
+   /*
+    * Never destroyed. Packets may still be around while static objects are
+    * destructed.
+    */
+   SlabPool& getPool()
+   {
+      static SlabPool *pool = new SlabPool;
+      return *pool;
+   }
+
+}
+
+ReceiveSlab::ReceiveSlab(size_t size)
+   : m_refcnt(1)
+   , m_data(static_cast<char*>(std::malloc(size)))
+   , m_size(size)
+   , m_next(NULL)
+{
+   ASSERT_FATAL(m_data != NULL, "Out of memory");
+}
+
+ReceiveSlab::~ReceiveSlab()
+{
+   std::free(m_data);
+}
+
+ReceiveSlab* ReceiveSlab::allocate(size_t size)
+{
+   if (size <= DEFAULT_SIZE) {
+      SlabPool &pool = getPool();
+      tsd::common::system::MutexGuard g(pool.m_lock);
+      ReceiveSlab *slab = pool.m_free;
+      if (slab != NULL) {
+         pool.m_free = slab->m_next;
+         pool.m_count--;
+         slab->m_next = NULL;
+         slab->m_refcnt = 1;
+         return slab;
+      }
+      size = DEFAULT_SIZE;
+   }
+
+   return new ReceiveSlab(size);
+}
+
+void ReceiveSlab::deref()
+{
+   if (m_refcnt.decrement() != 1) {
+      return;
+   }
+
+   if (m_size == DEFAULT_SIZE) {
+      SlabPool &pool = getPool();
+      tsd::common::system::MutexGuard g(pool.m_lock);
+      if (pool.m_count < MAX_POOLED) {
+         m_next = pool.m_free;
+         pool.m_free = this;
+         pool.m_count++;
+         return;
+      }
+   }
+
+   delete this;
+}
+
+} } }
@@ -0,0 +1,70 @@
+#ifndef TSD_COMMUNICATION_MESSAGING_RECEIVESLAB_HPP
+#define TSD_COMMUNICATION_MESSAGING_RECEIVESLAB_HPP
+
+#include <stddef.h>
+
+#include <tsd/common/system/AtomicInteger.hpp>
+
+namespace tsd { namespace communication { namespace messaging {
+
+/**
+ * Reference counted receive buffer.
+ *
+ * Transports read from the socket directly into a slab. Every packet that is
+ * dissected from it borrows its payload as a slice of the slab and holds a
+ * reference. The slab is recycled when the last packet is destroyed. Slabs
+ * of the default size are kept in a process wide pool to save the
+ * allocations.
+ *
+ * The reader owns the slab exclusively as long as it holds the only
+ * reference. Only then may it overwrite data that was already dissected.
+ */
+class ReceiveSlab
+{
+   tsd::common::system::AtomicInteger m_refcnt;
+   char *m_data;
+   size_t m_size;
+   ReceiveSlab *m_next;    // pool link
+
+   explicit ReceiveSlab(size_t size);
+   ~ReceiveSlab();
+
+   // not copyable
+   ReceiveSlab(const ReceiveSlab &);
+   ReceiveSlab& operator=(const ReceiveSlab &);
+
+public:
+   enum { DEFAULT_SIZE = 32768 };
+
+   /**
+    * Get a slab of at least @p size bytes. The caller holds the initial
+    * reference.
+    */
+   static ReceiveSlab* allocate(size_t size = DEFAULT_SIZE);
+
+   inline char* getData()
+   {
+      return m_data;
+   }
+
+   inline size_t getSize() const
+   {
+      return m_size;
+   }
+
+   inline bool isShared()
+   {
+      return !(m_refcnt == 1);
+   }
+
+   inline void ref()
+   {
+      m_refcnt.increment();
+   }
+
+   void deref();
+};
+
+} } }
+
+#endif
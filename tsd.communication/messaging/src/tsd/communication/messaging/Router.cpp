@@ -1,7 +1,10 @@
 
+#include <cstring>
 #include <iomanip>
 
+#include <tsd/common/ipc/networkinteger.h>
 #include <tsd/common/ipc/rpcbuffer.h>
+#include <tsd/common/system/Clock.hpp>
 #include <tsd/common/system/MutexGuard.hpp>
 #include <tsd/communication/messaging/BaseException.hpp>
 #include <tsd/communication/messaging/InvalidArgumentException.hpp>
@@ -11,6 +14,7 @@
 #include "QueueInternal.hpp"
 #include "Router.hpp"
 #include "Packet.hpp"
+#include "SharedEvent.hpp"
 
 using tsd::communication::event::TsdEvent;
 using tsd::communication::event::IfcAddr_t;
@@ -21,8 +25,10 @@ namespace tsd { namespace communication { namespace messaging {
 Router::Router(const std::string &name)
    : m_name(name)
    , m_log("tsd.communication.messaging.router")
+   , m_pinWaiters(0)
    , m_ifcSeqNum(1) // TODO: random?
    , m_defaultGateway(NULL)
+   , m_gatewaySuspended(false)
    , m_subNetPrefixLength(8)
    , m_subNetSeqNum(1) // TODO: random?
 {
@@ -33,6 +39,9 @@ Router::Router(const std::string &name)
 Router::~Router()
 {
    m_nameServer->fini();
+   for (LastValueCaches::iterator it(m_lastValues.begin()); it != m_lastValues.end(); ++it) {
+      clearLastValues(it->second);
+   }
 }
 
 IfcAddr_t Router::allocateIfcAddrInternal()
@@ -53,22 +62,83 @@ void Router::freeIfcAddrInternal(IfcAddr_t address)
 
 IfcAddr_t Router::allocateIfcAddr(Queue *queue)
 {
-   tsd::common::system::MutexGuard g(m_lock);
+   ShardedLock::WriteGuard g(m_lock);
 
    IfcAddr_t newAddr = allocateIfcAddrInternal();
-   m_addr2Queue[newAddr] = queue;
+   m_addr2Queue[newAddr] = QueueEntry(queue);
    return newAddr;
 }
 
 void Router::freeIfcAddr(IfcAddr_t address)
 {
-   tsd::common::system::MutexGuard g(m_lock);
+   ShardedLock::WriteGuard g(m_lock);
 
-   m_addr2Queue.erase(address);
+   /*
+    * The interface cannot be resolved anymore but messages that were routed
+    * before might still be on their way into the queue. Wait for them because
+    * the caller removes the interface from the queue right after.
+    */
+   Addr2Queue::iterator it(m_addr2Queue.find(address));
+   if (it != m_addr2Queue.end()) {
+      it->second.m_freed = true;
+      if (__atomic_load_n(&it->second.m_pins, __ATOMIC_SEQ_CST) != 0) {
+         g.unlock();
+         waitUnpinned(it->second.m_pins);
+         g.lock();
+      }
+      m_addr2Queue.erase(address);
+   }
    freeIfcAddrInternal(address);
+   LastValueCaches::iterator cache(m_lastValues.find(address));
+   if (cache != m_lastValues.end()) {
+      clearLastValues(cache->second);
+      m_lastValues.erase(cache);
+   }
    sendDeathMessage(address, address);
 }
 
+/**
+ * Look up the queue of a local interface. Called with the lock held.
+ *
+ * @return The entry or NULL if the interface is unknown or being freed.
+ */
+Router::QueueEntry* Router::findQueue(IfcAddr_t address)
+{
+   Addr2Queue::iterator it(m_addr2Queue.find(address));
+   if (it == m_addr2Queue.end() || it->second.m_freed) {
+      return NULL;
+   }
+
+   return &it->second;
+}
+
+void Router::unpin(uint32_t &pins)
+{
+   if (__sync_sub_and_fetch(&pins, 1u) == 0 &&
+       __atomic_load_n(&m_pinWaiters, __ATOMIC_SEQ_CST) != 0) {
+      tsd::common::system::MutexGuard g(m_pinLock);
+      m_pinCondition.broadcast();
+   }
+}
+
+/**
+ * Wait until the deliveries to a removed Queue interface or IPort are done.
+ *
+ * Must be called without the router lock. The target must not be reachable
+ * through the router tables anymore, otherwise new pins could be taken
+ * while waiting.
+ */
+void Router::waitUnpinned(uint32_t &pins)
+{
+   tsd::common::system::MutexGuard g(m_pinLock);
+
+   __sync_fetch_and_add(&m_pinWaiters, 1u);
+   while (__atomic_load_n(&pins, __ATOMIC_SEQ_CST) != 0) {
+      m_pinCondition.wait(m_pinLock);
+   }
+   __sync_fetch_and_sub(&m_pinWaiters, 1u);
+}
+
 /**
  * Configure prefix length for address allocation.
  *
@@ -77,7 +147,7 @@ void Router::freeIfcAddr(IfcAddr_t address)
  */
 bool Router::setSubnetConfig(uint8_t prefixLength)
 {
-   tsd::common::system::MutexGuard g(m_lock);
+   ShardedLock::WriteGuard g(m_lock);
 
    bool ret = false;
    if (m_subNets.empty()) {
@@ -88,28 +158,46 @@ bool Router::setSubnetConfig(uint8_t prefixLength)
    return ret;
 }
 
+/**
+ * Get the network that downstream subnets are allocated from. Called with
+ * the lock held.
+ *
+ * @param netAddr       Network address of the router
+ * @param prefixLength  Prefix length of the downstream subnets
+ * @param seqMask       Address bits of the downstream subnet number
+ */
+void Router::getDownstreamNet(IfcAddr_t &netAddr, uint8_t &prefixLength,
+                              IfcAddr_t &seqMask) const
+{
+   uint8_t ourPrefixLength = (m_defaultGateway != NULL)
+      ? m_defaultGateway->getPrefixLength()
+      : 0;
+   netAddr = (m_defaultGateway != NULL)
+      ? (m_defaultGateway->getLocalAddr() & m_defaultGateway->getMask())
+      : 0;
+
+   prefixLength = static_cast<uint8_t>(ourPrefixLength + m_subNetPrefixLength);
+   uint8_t newPrefixShift = static_cast<uint8_t>(64u - prefixLength);
+
+   seqMask = ((UINT64_C(1) << m_subNetPrefixLength) - 1u) << newPrefixShift;
+}
+
 bool Router::allocateDownstreamAddr(tsd::communication::event::IfcAddr_t &addr,
                                     uint8_t &prefix,
                                     tsd::communication::event::IfcAddr_t &nameServer)
 {
-   tsd::common::system::MutexGuard g(m_lock);
+   ShardedLock::WriteGuard g(m_lock);
 
    if (m_subNetPrefixLength == 0) {
       return false;
    }
 
-   uint8_t ourPrefixLength = (m_defaultGateway != NULL)
-      ? m_defaultGateway->getPrefixLength()
-      : 0;
-   tsd::communication::event::IfcAddr_t ourNetAddr = (m_defaultGateway != NULL)
-      ? (m_defaultGateway->getLocalAddr() & m_defaultGateway->getMask())
-      : 0;
-
-   uint8_t newPrefixLength = static_cast<uint8_t>(ourPrefixLength + m_subNetPrefixLength);
+   tsd::communication::event::IfcAddr_t ourNetAddr;
+   uint8_t newPrefixLength;
+   tsd::communication::event::IfcAddr_t seqMask;
+   getDownstreamNet(ourNetAddr, newPrefixLength, seqMask);
    uint8_t newPrefixShift = static_cast<uint8_t>(64u - newPrefixLength);
 
-   tsd::communication::event::IfcAddr_t seqMask =
-      ((UINT64_C(1) << m_subNetPrefixLength) - 1u) << newPrefixShift;
    tsd::communication::event::IfcAddr_t newAddr;
 
    // prevent endless loop if no addresses are free
@@ -139,9 +227,43 @@ bool Router::allocateDownstreamAddr(tsd::communication::event::IfcAddr_t &addr,
    return true;
 }
 
+/**
+ * Allocate a specific downstream subnet.
+ *
+ * Used by reconnecting routers that want to keep their previous subnet.
+ *
+ * @return True if @p addr is a valid subnet of this router and was free
+ */
+bool Router::reserveDownstreamAddr(tsd::communication::event::IfcAddr_t addr,
+                                   uint8_t prefix,
+                                   tsd::communication::event::IfcAddr_t &nameServer)
+{
+   ShardedLock::WriteGuard g(m_lock);
+
+   if (m_subNetPrefixLength == 0) {
+      return false;
+   }
+
+   tsd::communication::event::IfcAddr_t ourNetAddr;
+   uint8_t newPrefixLength;
+   tsd::communication::event::IfcAddr_t seqMask;
+   getDownstreamNet(ourNetAddr, newPrefixLength, seqMask);
+
+   if (prefix != newPrefixLength || (addr & ~seqMask) != ourNetAddr ||
+       (addr & seqMask) == 0u || m_subNets.find(addr) != m_subNets.end())
+   {
+      return false;
+   }
+
+   m_subNets.insert(addr);
+   nameServer = addr | getNameServer();
+
+   return true;
+}
+
 void Router::freeDownstreamAddr(tsd::communication::event::IfcAddr_t address)
 {
-   tsd::common::system::MutexGuard g(m_lock);
+   ShardedLock::WriteGuard g(m_lock);
    m_subNets.erase(address);
 }
 
@@ -159,7 +281,7 @@ void Router::addDownstreamPort(IPort *port)
          << std::setw(16) << port->getMask()
          << std::endl;
 
-   tsd::common::system::MutexGuard g(m_lock);
+   ShardedLock::WriteGuard g(m_lock);
    m_ports.push_back(port);
 }
 
@@ -167,7 +289,7 @@ bool Router::addUpstreamPort(IPort *port,
                              tsd::communication::event::IfcAddr_t nameServer,
                              const std::string &subDomain)
 {
-   tsd::common::system::MutexGuard g(m_lock);
+   ShardedLock::WriteGuard g(m_lock);
 
    // there can only be one upstream port
    if (m_defaultGateway != NULL) {
@@ -187,6 +309,7 @@ bool Router::addUpstreamPort(IPort *port,
    bool ret = true;
    m_ports.push_back(port);
    m_defaultGateway = port;
+   m_gatewaySuspended = false;
 
    g.unlock();
    if (subDomain.empty()) {
@@ -219,7 +342,7 @@ void Router::delPort(IPort *port)
          << std::setw(16) << port->getMask()
          << std::endl;
 
-   tsd::common::system::MutexGuard g(m_lock);
+   ShardedLock::WriteGuard g(m_lock);
 
    /*
     * First remove the port from all data structures. Multicast groups are
@@ -240,6 +363,7 @@ void Router::delPort(IPort *port)
    if (m_defaultGateway == port) {
       m_nameServer->makeLocal();
       m_defaultGateway = NULL;
+      m_gatewaySuspended = false;
       wasDefaultGw = true;
    }
 
@@ -250,6 +374,90 @@ void Router::delPort(IPort *port)
    clearGroups(port, wasDefaultGw);
 }
 
+/**
+ * Upstream connection was lost but is expected to come back.
+ *
+ * The port stays the default gateway and all packets for it are dropped. Our
+ * interface addresses and the stubbed groups of upstream senders stay valid
+ * until the port is resumed or deleted. Only receivers behind the port are
+ * removed from the multicast groups because the upstream router forgets
+ * about them.
+ */
+void Router::suspendUpstreamPort(IPort *port)
+{
+   m_log << tsd::common::logging::LogLevel::Debug
+         << m_name << ": suspend upstream port "
+         << std::hex << std::setfill('0')
+         << std::setw(16) << port->getLocalAddr() << "/"
+         << std::setw(16) << port->getMask()
+         << std::endl;
+
+   ShardedLock::WriteGuard g(m_lock);
+
+   if (m_defaultGateway != port) {
+      return;
+   }
+
+   m_gatewaySuspended = true;
+   clearGroups(port, true, false);
+}
+
+/**
+ * Suspended upstream port is connected again with its previous address.
+ *
+ * The upstream router has to learn our state again. All stubbed groups of
+ * senders behind the port are joined again and their subscriptions are
+ * announced. The packets are sent back to back so that the port can write
+ * them in batches. Then the name registrations are replayed.
+ */
+bool Router::resumeUpstreamPort(IPort *port,
+                                tsd::communication::event::IfcAddr_t nameServer,
+                                const std::string &subDomain)
+{
+   typedef std::list< std::pair<IfcAddr_t, IfcAddr_t> > JoinQueue;
+
+   m_log << tsd::common::logging::LogLevel::Debug
+         << m_name << ": resume upstream port "
+         << std::hex << std::setfill('0')
+         << std::setw(16) << port->getLocalAddr() << "/"
+         << std::setw(16) << port->getMask()
+         << std::endl;
+
+   ShardedLock::WriteGuard g(m_lock);
+
+   if (m_defaultGateway != port) {
+      return false;
+   }
+   m_gatewaySuspended = false;
+
+   JoinQueue joinQueue;
+   for (MulticastStubs::const_iterator it(m_multicastStubs.begin()); it != m_multicastStubs.end(); ++it) {
+      if (isEgressPort(it->first, port, true)) {
+         joinQueue.push_back(std::make_pair(it->second, it->first));
+      }
+   }
+
+   for (JoinQueue::iterator it(joinQueue.begin()); it != joinQueue.end(); ++it) {
+      MulticastGroup &group = m_multicastGroups[it->first];
+
+      // the upstream router forwards everything until told otherwise
+      group.m_announcedFiltered = false;
+      group.m_announced.clear();
+      group.m_alive = routePacket(std::auto_ptr<Packet>(
+         new Packet(Packet::MULTICAST_JOIN, it->first, it->second)));
+      announceSubscriptions(it->second, it->first);
+   }
+
+   m_log << tsd::common::logging::LogLevel::Info
+         << m_name << ": rejoined " << std::dec << joinQueue.size() << " groups"
+         << &std::endl;
+
+   g.unlock();
+   m_nameServer->resumeUpstream(nameServer, subDomain);
+
+   return true;
+}
+
 /**
  * Check if address matches any port address.
  *
@@ -259,7 +467,7 @@ void Router::delPort(IPort *port)
  */
 bool Router::isAnyPortAddr(tsd::communication::event::IfcAddr_t addr)
 {
-   tsd::common::system::MutexGuard g(m_lock);
+   ShardedLock::ReadGuard g(m_lock);
 
    // upstream
    if (m_defaultGateway != NULL && m_defaultGateway->isPortAddr(addr)) {
@@ -284,7 +492,7 @@ bool Router::isAnyPortAddr(tsd::communication::event::IfcAddr_t addr)
  */
 bool Router::hasUpstreamPort()
 {
-   tsd::common::system::MutexGuard g(m_lock);
+   ShardedLock::ReadGuard g(m_lock);
 
    return m_defaultGateway != NULL;
 }
@@ -306,9 +514,10 @@ bool Router::lookupInterface(const std::string &interfaceName, uint32_t timeout,
    return m_nameServer->lookupInterface(interfaceName, timeout, remoteAddr);
 }
 
-void Router::routeLocalEvent(std::auto_ptr<TsdEvent> msg, bool multicast)
+void Router::routeLocalEvent(std::auto_ptr<TsdEvent> msg, bool multicast,
+                             MessagePriority priority, uint32_t deadline, bool conflatable)
 {
-   tsd::common::system::MutexGuard g(m_lock);
+   ShardedLock::ReadGuard g(m_lock);
 
    m_log << tsd::common::logging::LogLevel::Trace
          << "routeLocalEvent(" << m_name << ", " << std::dec << msg->getEventId() << "): "
@@ -319,21 +528,30 @@ void Router::routeLocalEvent(std::auto_ptr<TsdEvent> msg, bool multicast)
 
    IfcAddr_t dest = msg->getReceiverAddr();
    if (isLocalAddr(dest)) {
-      Addr2Queue::const_iterator it(m_addr2Queue.find(dest));
-      if (it != m_addr2Queue.end()) {
-         it->second->pushMessage(msg, 0, multicast);
+      QueueEntry *entry = findQueue(dest);
+      if (entry != NULL) {
+         Queue *queue = entry->m_queue;
+         Pin pin(*this, entry->m_pins);
+         g.unlock();
+         // only local senders may be blocked by a full queue
+         queue->pushMessage(msg, 0, multicast, true, deadline);
       } else {
          m_log << tsd::common::logging::LogLevel::Trace
                << "message lost" << & std::endl;
       }
    } else {
-      routePacket(std::auto_ptr<Packet>(new Packet(msg.get(), multicast)));
+      g.unlock();
+      std::auto_ptr<Packet> pkt(new Packet(msg.get(), multicast));
+      pkt->setPriority(priority);
+      pkt->setConflatable(conflatable);
+      pkt->setDeadline(deadline);
+      routePacket(pkt);
    }
 }
 
 bool Router::routeLocalPacket(std::auto_ptr<Packet> pkt, bool multicast)
 {
-   tsd::common::system::MutexGuard g(m_lock);
+   ShardedLock::ReadGuard g(m_lock);
 
    m_log << tsd::common::logging::LogLevel::Trace
          << "routeLocalPacket(" << m_name << ", " << std::dec << pkt->getType() << "): "
@@ -345,14 +563,18 @@ bool Router::routeLocalPacket(std::auto_ptr<Packet> pkt, bool multicast)
    bool routed = false;
    IfcAddr_t dest = pkt->getReceiverAddr();
    if (isLocalAddr(dest)) {
-      Addr2Queue::const_iterator a2q(m_addr2Queue.find(dest));
-      if (a2q != m_addr2Queue.end()) {
-         routed = a2q->second->pushPacket(pkt, multicast);
+      QueueEntry *entry = findQueue(dest);
+      if (entry != NULL) {
+         Queue *queue = entry->m_queue;
+         Pin pin(*this, entry->m_pins);
+         g.unlock();
+         routed = queue->pushPacket(pkt, multicast);
       } else {
          m_log << tsd::common::logging::LogLevel::Trace
                << "packet lost" << &std::endl;
       }
    } else {
+      g.unlock();
       routed = routePacket(pkt);
    }
 
@@ -418,8 +640,43 @@ bool Router::isEgressPort(IfcAddr_t dest, IPort *port, bool isDefaultGw)
 
 bool Router::routePacket(std::auto_ptr<Packet> evt, IPort *ingressPort)
 {
-   tsd::common::system::MutexGuard g(m_lock);
+   /*
+    * Multicast management packets that are received from a port modify the
+    * multicast groups. They need the writer lock which must be taken up front
+    * because a reader may never upgrade its lock. Everything else is only
+    * reading the routing tables.
+    */
+   if (ingressPort != NULL) {
+      switch (evt->getType()) {
+      case Packet::MULTICAST_JOIN:
+      case Packet::MULTICAST_LEAVE:
+      case Packet::MULTICAST_SUBSCRIBE:
+      case Packet::DEATH_NOTIFICATION:
+      {
+         ShardedLock::WriteGuard g(m_lock);
+         return routePacketLocked(evt, ingressPort);
+      }
+
+      default:
+         break;
+      }
+   }
 
+   ShardedLock::ReadGuard g(m_lock);
+   return routePacketLocked(evt, ingressPort, &g);
+}
+
+/**
+ * Route a packet with the lock held.
+ *
+ * If @p guard is given it is released before the packet is delivered to its
+ * queue or port. Otherwise the packet is delivered with the lock held which
+ * is the case for the packets that are sent while managing the multicast
+ * groups.
+ */
+bool Router::routePacketLocked(std::auto_ptr<Packet> evt, IPort *ingressPort,
+                               ShardedLock::ReadGuard *guard)
+{
    // Get destination port
    IfcAddr_t dest = evt->getReceiverAddr();
    IPort *egressPort = getEgressPort(dest);
@@ -453,7 +710,9 @@ bool Router::routePacket(std::auto_ptr<Packet> evt, IPort *ingressPort)
    if (ingressPort != NULL) {
       switch (evt->getType()) {
       case Packet::MULTICAST_JOIN:
-         if (!joinGroup(dest, evt->getSenderAddr())) {
+         // Remote receivers get everything until they announce their
+         // subscriptions. Older peers will never do that.
+         if (!joinGroupInternal(dest, evt->getSenderAddr(), false)) {
             routeDeathMessage(dest, evt->getSenderAddr());
          }
          return true;
@@ -462,6 +721,10 @@ bool Router::routePacket(std::auto_ptr<Packet> evt, IPort *ingressPort)
          leaveGroup(dest, evt->getSenderAddr());
          return true;
 
+      case Packet::MULTICAST_SUBSCRIBE:
+         receivedSubscriptions(dest, *evt);
+         return true;
+
       case Packet::DEATH_NOTIFICATION:
          sendDeathMessage(dest, evt->getSenderAddr());
          return true;
@@ -476,6 +739,9 @@ bool Router::routePacket(std::auto_ptr<Packet> evt, IPort *ingressPort)
    if (isLocalAddr(dest)) {
       switch (evt->getType()) {
       case Packet::UNICAST_MESSAGE:
+         if (guard != NULL) {
+            guard->unlock();
+         }
          routed = routeLocalPacket(evt, false);
          break;
 
@@ -492,7 +758,17 @@ bool Router::routePacket(std::auto_ptr<Packet> evt, IPort *ingressPort)
              * might try to forward packets to non-existent addresses which is
              * ok as it will simply drop them.
              */
-            MulticastReceivers observers(group->second.m_receivers);
+            MulticastReceivers observers;
+            for (MulticastReceivers::const_iterator it(group->second.m_receivers.begin());
+                 it != group->second.m_receivers.end(); ++it) {
+               if (group->second.isSubscribed(*it, evt->getEventId())) {
+                  observers.push_back(*it);
+               }
+            }
+            if (guard != NULL) {
+               guard->unlock();
+            }
+
             for (MulticastReceivers::const_iterator it(observers.begin()); it != observers.end(); ++it) {
                if (found != LOOPBACK_ADDRESS) {
                   std::auto_ptr<Packet> tmp(new Packet(*(evt.get())));
@@ -516,7 +792,11 @@ bool Router::routePacket(std::auto_ptr<Packet> evt, IPort *ingressPort)
          break;
       }
    } else {
-      if (egressPort != NULL) {
+      if (egressPort != NULL && !(egressPort == m_defaultGateway && m_gatewaySuspended)) {
+         Pin pin(*this, egressPort->m_routerPins);
+         if (guard != NULL) {
+            guard->unlock();
+         }
          routed = egressPort->sendPacket(evt);
       }
    }
@@ -524,32 +804,24 @@ bool Router::routePacket(std::auto_ptr<Packet> evt, IPort *ingressPort)
    return routed;
 }
 
-void Router::sendUnicastMessage(IfcAddr_t localAddr, IfcAddr_t remoteAddr, std::auto_ptr<TsdEvent> msg)
+void Router::sendUnicastMessage(IfcAddr_t localAddr, IfcAddr_t remoteAddr, std::auto_ptr<TsdEvent> msg,
+                                MessagePriority priority, uint32_t deadline, bool conflatable)
 {
    msg->setSenderAddr(localAddr);
    msg->setReceiverAddr(remoteAddr);
-   routeLocalEvent(msg, false);
+   routeLocalEvent(msg, false, priority, deadline, conflatable);
 }
 
-void Router::routeBroadcastMessage(IfcAddr_t localAddr, IfcAddr_t remoteAddr, std::auto_ptr<TsdEvent> msg)
+bool Router::joinGroup(IfcAddr_t sender, IfcAddr_t receiver)
 {
-   m_log << tsd::common::logging::LogLevel::Trace
-         << "routeBroadcastMessage(" << m_name << "): "
-         << std::hex << std::setfill('0')
-         << std::setw(16) << localAddr << " -> "
-         << std::setw(16) << remoteAddr << ", "
-         << std::dec << msg->getEventId()
-         << std::endl;
+   ShardedLock::WriteGuard g(m_lock);
 
-   msg->setSenderAddr(localAddr);
-   msg->setReceiverAddr(remoteAddr);
-   routeLocalEvent(msg, true);
+   // Local receivers announce their subscriptions through setSubscriptions().
+   return joinGroupInternal(sender, receiver, true);
 }
 
-bool Router::joinGroup(IfcAddr_t sender, IfcAddr_t receiver)
+bool Router::joinGroupInternal(IfcAddr_t sender, IfcAddr_t receiver, bool filtered)
 {
-   tsd::common::system::MutexGuard g(m_lock);
-
    m_log << tsd::common::logging::LogLevel::Debug
          << "joinGroup(" << m_name << "): "
          << std::hex << std::setfill('0')
@@ -559,24 +831,40 @@ bool Router::joinGroup(IfcAddr_t sender, IfcAddr_t receiver)
 
    bool alive;
    if (isLocalAddr(sender)) {
-      alive = m_addr2Queue.find(sender) != m_addr2Queue.end();
-      m_multicastGroups[sender].m_receivers.push_back(receiver);
-      m_multicastGroups[sender].m_alive = alive;
+      MulticastGroup &group = m_multicastGroups[sender];
+      alive = findQueue(sender) != NULL;
+      group.m_receivers.push_back(receiver);
+      group.m_alive = alive;
+      if (filtered) {
+         group.m_filters.insert(std::make_pair(receiver, EventSet()));
+      } else {
+         group.m_filters.erase(receiver);
+         group.m_unannounced.insert(receiver);
+      }
    } else {
+      IfcAddr_t stub;
       MulticastStubs::const_iterator it(m_multicastStubs.find(sender));
       if (it != m_multicastStubs.end()) {
          // already stubbed
-         m_multicastGroups[it->second].m_receivers.push_back(receiver);
-         alive = m_multicastGroups[it->second].m_alive;
+         stub = it->second;
+         alive = m_multicastGroups[stub].m_alive;
       } else {
-         IfcAddr_t stub = allocateIfcAddrInternal();
+         stub = allocateIfcAddrInternal();
          m_multicastStubs[sender] = stub;
          // if packet is gets lost the group is dead
          alive = routePacket(std::auto_ptr<Packet>(
             new Packet(Packet::MULTICAST_JOIN, stub, sender)));
-         m_multicastGroups[stub].m_receivers.push_back(receiver);
          m_multicastGroups[stub].m_alive = alive;
       }
+
+      MulticastGroup &group = m_multicastGroups[stub];
+      group.m_receivers.push_back(receiver);
+      if (filtered) {
+         group.m_filters.insert(std::make_pair(receiver, EventSet()));
+      } else {
+         group.m_filters.erase(receiver);
+      }
+      announceSubscriptions(sender, stub);
    }
 
    return alive;
@@ -585,7 +873,7 @@ bool Router::joinGroup(IfcAddr_t sender, IfcAddr_t receiver)
 bool Router::leaveGroup(IfcAddr_t sender, IfcAddr_t receiver)
 {
    bool ret = false;
-   tsd::common::system::MutexGuard g(m_lock);
+   ShardedLock::WriteGuard g(m_lock);
 
    m_log << tsd::common::logging::LogLevel::Debug
          << "leaveGroup(" << m_name << "): "
@@ -608,6 +896,9 @@ bool Router::leaveGroup(IfcAddr_t sender, IfcAddr_t receiver)
       ret = observers.empty();
       if (ret) {
          m_multicastGroups.erase(sender);
+      } else {
+         m_multicastGroups[sender].m_filters.erase(receiver);
+         m_multicastGroups[sender].m_unannounced.erase(receiver);
       }
    } else {
       MulticastStubs::iterator it(m_multicastStubs.find(sender));
@@ -619,6 +910,8 @@ bool Router::leaveGroup(IfcAddr_t sender, IfcAddr_t receiver)
             freeIfcAddrInternal(stub);
             routePacket(std::auto_ptr<Packet>(
                new Packet(Packet::MULTICAST_LEAVE, stub, sender)));
+         } else {
+            announceSubscriptions(sender, stub);
          }
       }
    }
@@ -626,7 +919,156 @@ bool Router::leaveGroup(IfcAddr_t sender, IfcAddr_t receiver)
    return ret;
 }
 
-void Router::clearGroups(IPort *oldPort, bool wasDefaultGw)
+/**
+ * Set the multicast subscriptions of a receiver.
+ *
+ * Broadcasts of @p sender are only forwarded to @p receiver if their event ID
+ * is in @p events. If the group is stubbed the union of all subscriptions is
+ * announced to the next hop so that unwanted messages are already dropped
+ * there.
+ */
+void Router::setSubscriptions(IfcAddr_t sender, IfcAddr_t receiver, const std::set<uint32_t> &events)
+{
+   ShardedLock::WriteGuard g(m_lock);
+   setSubscriptionsInternal(sender, receiver, true, events);
+}
+
+void Router::setSubscriptionsInternal(IfcAddr_t sender, IfcAddr_t receiver, bool filtered,
+                                      const EventSet &events)
+{
+   m_log << tsd::common::logging::LogLevel::Debug
+         << "setSubscriptions(" << m_name << "): "
+         << std::hex << std::setfill('0')
+         << std::setw(16) << sender << " -> "
+         << std::setw(16) << receiver << ", "
+         << std::dec << (filtered ? events.size() : 0u)
+         << (filtered ? " events" : " all events")
+         << std::endl;
+
+   IfcAddr_t group = sender;
+   if (!isLocalAddr(sender)) {
+      MulticastStubs::const_iterator it(m_multicastStubs.find(sender));
+      if (it == m_multicastStubs.end()) {
+         return;
+      }
+      group = it->second;
+   }
+
+   MulticastGroups::iterator it(m_multicastGroups.find(group));
+   if (it == m_multicastGroups.end()) {
+      return;
+   }
+
+   /*
+    * Only the owner of a group has the last values of the sender. A receiver
+    * gets the cached values of the events that it did not receive so far.
+    * Remote receivers are unfiltered until they announce their subscriptions
+    * for the first time. That announcement replays all of them.
+    */
+   bool replay = false;
+   EventSet previous;
+   if (group == sender) {
+      MulticastGroup &mg = it->second;
+      ReceiverFilters::const_iterator f(mg.m_filters.find(receiver));
+      if (mg.m_unannounced.erase(receiver) != 0) {
+         replay = true;
+      } else if (f != mg.m_filters.end()) {
+         replay = true;
+         previous = f->second;
+      }
+   }
+
+   if (filtered) {
+      it->second.m_filters[receiver] = events;
+   } else {
+      it->second.m_filters.erase(receiver);
+   }
+
+   if (group != sender) {
+      announceSubscriptions(sender, group);
+   } else if (replay) {
+      sendLastValues(sender, receiver, filtered, events, previous);
+   }
+}
+
+/**
+ * Tell the next hop which events are needed by the receivers of a stub.
+ *
+ * The message is only sent if the union of all subscriptions has changed.
+ * Until the first announcement the next hop will forward all events.
+ */
+void Router::announceSubscriptions(IfcAddr_t sender, IfcAddr_t stub)
+{
+   typedef tsd::common::ipc::NetworkInteger<uint32_t> WireInt;
+
+   MulticastGroups::iterator it(m_multicastGroups.find(stub));
+   if (it == m_multicastGroups.end()) {
+      return;
+   }
+
+   MulticastGroup &group = it->second;
+   bool filtered = true;
+   EventSet events;
+   for (MulticastReceivers::const_iterator r(group.m_receivers.begin()); r != group.m_receivers.end(); ++r) {
+      ReceiverFilters::const_iterator f(group.m_filters.find(*r));
+      if (f == group.m_filters.end()) {
+         filtered = false;
+         events.clear();
+         break;
+      }
+      events.insert(f->second.begin(), f->second.end());
+   }
+
+   if (filtered == group.m_announcedFiltered && events == group.m_announced) {
+      return;
+   }
+   group.m_announcedFiltered = filtered;
+   group.m_announced = events;
+
+   // first word: filter flag, followed by the event IDs
+   std::vector<WireInt> payload(events.size() + 1u);
+   payload[0] = filtered ? 1u : 0u;
+   size_t i = 1;
+   for (EventSet::const_iterator e(events.begin()); e != events.end(); ++e) {
+      payload[i++] = *e;
+   }
+
+   routePacket(std::auto_ptr<Packet>(new Packet(Packet::MULTICAST_SUBSCRIBE,
+      stub, sender, 0, reinterpret_cast<const char*>(&payload[0]),
+      static_cast<uint32_t>(payload.size() * sizeof(WireInt)))));
+}
+
+void Router::receivedSubscriptions(IfcAddr_t sender, Packet &pkt)
+{
+   typedef tsd::common::ipc::NetworkInteger<uint32_t> WireInt;
+
+   size_t len = pkt.getBufferLength();
+   if (len < sizeof(WireInt) || (len % sizeof(WireInt)) != 0) {
+      m_log << tsd::common::logging::LogLevel::Warn
+            << m_name << ": malformed subscription from "
+            << std::hex << std::setfill('0') << std::setw(16) << pkt.getSenderAddr()
+            << &std::endl;
+      return;
+   }
+
+   std::vector<WireInt> payload(len / sizeof(WireInt));
+   std::memcpy(&payload[0], pkt.getBufferPtr(), len);
+
+   EventSet events;
+   for (size_t i = 1; i < payload.size(); i++) {
+      events.insert(payload[i]);
+   }
+
+   setSubscriptionsInternal(sender, pkt.getSenderAddr(), payload[0] != 0u, events);
+}
+
+/**
+ * Remove everything from the multicast groups that is behind @p oldPort.
+ *
+ * If @p sendersVanished is false the groups of senders behind the port are
+ * kept and their receivers do not get a death notification.
+ */
+void Router::clearGroups(IPort *oldPort, bool wasDefaultGw, bool sendersVanished)
 {
    typedef std::list<Packet*> PacketQueue;
    typedef std::list< std::pair<IfcAddr_t, IfcAddr_t> > DeathQueue;
@@ -653,6 +1095,8 @@ void Router::clearGroups(IPort *oldPort, bool wasDefaultGw)
                   << std::setw(16) << oldPort->getMask()
                   << std::endl;
 
+            mgIt->second.m_filters.erase(dest);
+            mgIt->second.m_unannounced.erase(dest);
             obsIt = observers.erase(obsIt);
          } else {
             ++obsIt;
@@ -697,7 +1141,8 @@ void Router::clearGroups(IPort *oldPort, bool wasDefaultGw)
     * local monitors and send a death notification to all subscribers.
     */
    DeathQueue deathQueue;
-   for (MulticastStubs::iterator it(m_multicastStubs.begin()); it != m_multicastStubs.end(); ++it) {
+   for (MulticastStubs::iterator it(m_multicastStubs.begin());
+        sendersVanished && it != m_multicastStubs.end(); ++it) {
       IfcAddr_t sender = it->first;
       if (isEgressPort(sender, oldPort, wasDefaultGw)) {
          deathQueue.push_back(std::make_pair(it->second, sender));
@@ -717,40 +1162,273 @@ void Router::clearGroups(IPort *oldPort, bool wasDefaultGw)
    }
 }
 
-void Router::sendBroadcastMessage(IfcAddr_t localAddr, std::auto_ptr<TsdEvent> msg)
+void Router::sendBroadcastMessage(IfcAddr_t localAddr, std::auto_ptr<TsdEvent> msg,
+                                  MessagePriority priority, uint32_t deadline, bool conflatable)
 {
-   tsd::common::system::MutexGuard g(m_lock);
+   ShardedLock::ReadGuard g(m_lock);
 
-   IfcAddr_t found = LOOPBACK_ADDRESS;
+   /*
+    * Cached events are shared right away because the cache keeps a reference
+    * even if nobody is subscribed at the moment.
+    */
+   uint32_t eventId = msg->getEventId();
+   SharedEvent *shared = NULL;
+   LastValueCaches::iterator cache(m_lastValues.find(localAddr));
+   if (cache != m_lastValues.end()) {
+      LastValues::iterator value(cache->second.find(eventId));
+      if (value != cache->second.end()) {
+         msg->setSenderAddr(localAddr);
+         shared = new SharedEvent(msg);
+         storeLastValue(value->second, shared, priority, deadline, conflatable);
+      }
+   }
+
+   bool found = false;
    MulticastGroups::const_iterator group(m_multicastGroups.find(localAddr));
-   if (group != m_multicastGroups.end()) {
+   if (group != m_multicastGroups.end() && !group->second.m_receivers.empty()) {
+      /*
+       * Make a copy of the subscribed multicast observers. Routing a packet
+       * might modify m_multicastGroups which invalidates our iterator. We
+       * don't care about vanishing ports here because forwarding packets to
+       * non-existent addresses which is ok as the router will simply drop
+       * them.
+       */
+      MulticastReceivers observers;
+      for (MulticastReceivers::const_iterator it(group->second.m_receivers.begin());
+           it != group->second.m_receivers.end(); ++it) {
+         if (group->second.isSubscribed(*it, eventId)) {
+            observers.push_back(*it);
+         }
+      }
+
+      // nobody interested
+      if (observers.empty()) {
+         m_log << tsd::common::logging::LogLevel::Trace
+               << m_name << ": sendBroadcastMessage: no subscriber for event " << eventId
+               << &std::endl;
+         if (shared != NULL) {
+            shared->deref();
+         }
+         return;
+      }
+      found = true;
+
       /*
-       * Make a copy of the multicast observers. Routing a packet might modify
-       * m_multicastGroups which invalidates our iterator. We don't care about
-       * vanishing ports here because forwarding packets to non-existent
-       * addresses which is ok as the router will simply drop them.
+       * The event is shared by all local receivers. They will only make a copy
+       * when actually reading it from their queue. For remote receivers the
+       * event is serialized only once and all packets share the payload.
        */
-      MulticastReceivers observers(group->second.m_receivers);
+      if (shared == NULL) {
+         msg->setSenderAddr(localAddr);
+         shared = new SharedEvent(msg);
+      }
 
+      /*
+       * Pin the queues of the local receivers and deliver after dropping the
+       * lock. Remote receivers are routed one by one afterwards.
+       */
+      std::vector<std::pair<IfcAddr_t, QueueEntry*> > local;
+      MulticastReceivers remote;
       for (MulticastReceivers::const_iterator it(observers.begin()); it != observers.end(); ++it) {
-         if (found != LOOPBACK_ADDRESS) {
-            routeBroadcastMessage(localAddr, found, std::auto_ptr<TsdEvent>(msg->clone()));
+         if (isLocalAddr(*it)) {
+            QueueEntry *entry = findQueue(*it);
+            if (entry != NULL) {
+               __sync_fetch_and_add(&entry->m_pins, 1u);
+               local.push_back(std::make_pair(*it, entry));
+            } else {
+               m_log << tsd::common::logging::LogLevel::Trace
+                     << "message lost" << & std::endl;
+            }
+         } else {
+            remote.push_back(*it);
          }
-         found = *it;
       }
+      g.unlock();
+
+      for (size_t i = 0; i < local.size(); i++) {
+         m_log << tsd::common::logging::LogLevel::Trace
+               << "sendBroadcastMessage(" << m_name << "): "
+               << std::hex << std::setfill('0')
+               << std::setw(16) << localAddr << " -> "
+               << std::setw(16) << local[i].first << ", "
+               << std::dec << eventId
+               << std::endl;
 
-      if (found != LOOPBACK_ADDRESS) {
-         routeBroadcastMessage(localAddr, found, msg);
+         local[i].second->m_queue->pushMulticastMessage(shared, local[i].first, deadline);
+         unpin(local[i].second->m_pins);
+      }
+
+      std::auto_ptr<Packet> serialized;
+      for (MulticastReceivers::const_iterator it(remote.begin()); it != remote.end(); ++it) {
+         IfcAddr_t remoteAddr = *it;
+
+         m_log << tsd::common::logging::LogLevel::Trace
+               << "sendBroadcastMessage(" << m_name << "): "
+               << std::hex << std::setfill('0')
+               << std::setw(16) << localAddr << " -> "
+               << std::setw(16) << remoteAddr << ", "
+               << std::dec << eventId
+               << std::endl;
+
+         if (serialized.get() == NULL) {
+            serialized.reset(new Packet(shared->get(), true));
+            serialized->setPriority(priority);
+            serialized->setConflatable(conflatable);
+            serialized->setDeadline(deadline);
+         }
+         std::auto_ptr<Packet> pkt(new Packet(*serialized));
+         pkt->setReceiverAddr(remoteAddr);
+         routePacket(pkt);
       }
    }
 
-   if (found == LOOPBACK_ADDRESS) {
+   if (shared != NULL) {
+      shared->deref();
+   }
+
+   if (!found) {
       m_log << tsd::common::logging::LogLevel::Trace
-            << m_name << ": sendBroadcastMessage: lost event " << msg->getEventId()
+            << m_name << ": sendBroadcastMessage: lost event " << eventId
             << &std::endl;
    }
 }
 
+/**
+ * Keep the last broadcast of @p events for the interface @p localAddr.
+ *
+ * Receivers that subscribe to one of these events later get the cached value
+ * right away. The cache is dropped together with the interface. An empty set
+ * disables it.
+ */
+void Router::setLastValueCache(IfcAddr_t localAddr, const std::set<uint32_t> &events)
+{
+   ShardedLock::WriteGuard g(m_lock);
+
+   LastValueCaches::iterator cache(m_lastValues.find(localAddr));
+   if (cache == m_lastValues.end()) {
+      if (events.empty()) {
+         return;
+      }
+      cache = m_lastValues.insert(std::make_pair(localAddr, LastValues())).first;
+   }
+
+   LastValues &values = cache->second;
+   LastValues::iterator it(values.begin());
+   while (it != values.end()) {
+      if (events.find(it->first) == events.end()) {
+         if (it->second.m_event != NULL) {
+            it->second.m_event->deref();
+         }
+         values.erase(it++);
+      } else {
+         ++it;
+      }
+   }
+   for (EventSet::const_iterator e(events.begin()); e != events.end(); ++e) {
+      values.insert(std::make_pair(*e, LastValue()));
+   }
+
+   if (values.empty()) {
+      m_lastValues.erase(cache);
+   }
+}
+
+/**
+ * Replace the cached value of an event.
+ *
+ * Called with the reader lock held, so the set of cached events is stable.
+ * Concurrent broadcasts of the same interface are serialized by
+ * m_lastValueLock.
+ */
+void Router::storeLastValue(LastValue &value, SharedEvent *shared,
+                            MessagePriority priority, uint32_t deadline, bool conflatable)
+{
+   shared->ref();
+
+   tsd::common::system::MutexGuard g(m_lastValueLock);
+   SharedEvent *old = value.m_event;
+   value.m_event = shared;
+   value.m_priority = priority;
+   value.m_deadline = deadline;
+   value.m_conflatable = conflatable;
+   g.unlock();
+
+   if (old != NULL) {
+      old->deref();
+   }
+}
+
+/**
+ * Send the cached values of @p sender to a receiver whose subscriptions have
+ * changed. Events in @p previous were already subscribed before and are
+ * skipped. Expired values are not sent.
+ *
+ * Called with the writer lock held, so no broadcast is modifying the cache.
+ */
+void Router::sendLastValues(IfcAddr_t sender, IfcAddr_t receiver, bool filtered,
+                            const EventSet &events, const EventSet &previous)
+{
+   typedef std::vector<LastValue> ValueQueue;
+
+   LastValueCaches::const_iterator cache(m_lastValues.find(sender));
+   if (cache == m_lastValues.end()) {
+      return;
+   }
+
+   uint32_t now = tsd::common::system::Clock::getTickCounter();
+   ValueQueue replay;
+   for (LastValues::const_iterator it(cache->second.begin()); it != cache->second.end(); ++it) {
+      const LastValue &value = it->second;
+      if (value.m_event == NULL ||
+          (filtered && events.find(it->first) == events.end()) ||
+          previous.find(it->first) != previous.end() ||
+          (value.m_deadline != 0 && Packet::isExpired(value.m_deadline, now))) {
+         continue;
+      }
+      value.m_event->ref();
+      replay.push_back(value);
+   }
+
+   m_log << tsd::common::logging::LogLevel::Debug
+         << "sendLastValues(" << m_name << "): "
+         << std::hex << std::setfill('0')
+         << std::setw(16) << sender << " -> "
+         << std::setw(16) << receiver << ", "
+         << std::dec << replay.size() << " events"
+         << std::endl;
+
+   /*
+    * The events are delivered after iterating the cache because routing a
+    * packet might delete a port and thus modify the router tables.
+    */
+   for (ValueQueue::iterator it(replay.begin()); it != replay.end(); ++it) {
+      if (isLocalAddr(receiver)) {
+         QueueEntry *entry = findQueue(receiver);
+         if (entry != NULL) {
+            entry->m_queue->pushMulticastMessage(it->m_event, receiver, it->m_deadline);
+         }
+      } else {
+         std::auto_ptr<Packet> pkt(new Packet(it->m_event->get(), true));
+         pkt->setPriority(it->m_priority);
+         pkt->setConflatable(it->m_conflatable);
+         pkt->setDeadline(it->m_deadline);
+         pkt->setReceiverAddr(receiver);
+         routePacket(pkt);
+      }
+      it->m_event->deref();
+   }
+}
+
+void Router::clearLastValues(LastValues &values)
+{
+   for (LastValues::iterator it(values.begin()); it != values.end(); ++it) {
+      if (it->second.m_event != NULL) {
+         it->second.m_event->deref();
+      }
+   }
+   values.clear();
+}
+
 void Router::sendDeathMessage(IfcAddr_t localAddr, IfcAddr_t source)
 {
    typedef std::list< std::pair<IfcAddr_t, IfcAddr_t> > DeathQueue;
@@ -780,9 +1458,9 @@ void Router::routeDeathMessage(IfcAddr_t sender, IfcAddr_t receiver)
          << std::endl;
 
    if (isLocalAddr(receiver)) {
-      Addr2Queue::const_iterator it(m_addr2Queue.find(receiver));
-      if (it != m_addr2Queue.end()) {
-         it->second->dead(sender, receiver);
+      QueueEntry *entry = findQueue(receiver);
+      if (entry != NULL) {
+         entry->m_queue->dead(sender, receiver);
       }
    } else {
       routePacket(std::auto_ptr<Packet>(
@@ -7,32 +7,63 @@
 #include <vector>
 
 #include <tsd/common/logging/Logger.hpp>
+#include <tsd/common/system/CondVar.hpp>
 #include <tsd/common/system/Mutex.hpp>
 
 #include <tsd/communication/event/TsdEvent.hpp>
 #include <tsd/communication/messaging/Queue.hpp>
 
+#include "ShardedLock.hpp"
+
 namespace tsd { namespace communication { namespace messaging {
 
 class IPort;
 class Queue;
 class NameServer;
 class Packet;
+class SharedEvent;
 
 /**
  * Packet router and distributor
  */
 class Router
 {
-   typedef std::map<tsd::communication::event::IfcAddr_t, Queue*> Addr2Queue;
+   struct QueueEntry {
+      Queue *m_queue;
+      uint32_t m_pins;   // deliveries in flight, see Pin
+      bool m_freed;      // freeIfcAddr() waits for the pins to drain
+
+      QueueEntry(Queue *queue = NULL)
+         : m_queue(queue)
+         , m_pins(0)
+         , m_freed(false)
+      { }
+   };
+   typedef std::map<tsd::communication::event::IfcAddr_t, QueueEntry> Addr2Queue;
    typedef std::vector<tsd::communication::event::IfcAddr_t> MulticastReceivers;
+   typedef std::set<uint32_t> EventSet;
+   typedef std::map<tsd::communication::event::IfcAddr_t, EventSet> ReceiverFilters;
+   typedef std::set<tsd::communication::event::IfcAddr_t> ReceiverSet;
    struct MulticastGroup {
       MulticastReceivers m_receivers;
+      ReceiverFilters m_filters;    // receivers without entry get everything
+      ReceiverSet m_unannounced;    // remote receivers without subscriptions yet
       bool m_alive;
 
+      // stubbed groups: subscriptions that were announced upstream
+      bool m_announcedFiltered;
+      EventSet m_announced;
+
       MulticastGroup()
          : m_alive(true)
+         , m_announcedFiltered(false)
       { }
+
+      inline bool isSubscribed(tsd::communication::event::IfcAddr_t receiver, uint32_t eventId) const
+      {
+         ReceiverFilters::const_iterator it(m_filters.find(receiver));
+         return it == m_filters.end() || it->second.find(eventId) != it->second.end();
+      }
    };
    typedef std::map<tsd::communication::event::IfcAddr_t, MulticastGroup> MulticastGroups;
    typedef std::vector<IPort*> Ports;
@@ -42,16 +73,78 @@ class Router
    typedef std::map<tsd::communication::event::IfcAddr_t,
       tsd::communication::event::IfcAddr_t> MulticastStubs;
 
+   struct LastValue {
+      SharedEvent *m_event;    // NULL until the first broadcast
+      MessagePriority m_priority;
+      uint32_t m_deadline;
+      bool m_conflatable;
+
+      LastValue()
+         : m_event(NULL)
+         , m_priority(PRIORITY_NORMAL)
+         , m_deadline(0)
+         , m_conflatable(false)
+      { }
+   };
+   typedef std::map<uint32_t, LastValue> LastValues;
+   typedef std::map<tsd::communication::event::IfcAddr_t, LastValues> LastValueCaches;
+
+   /*
+    * Keeps the target of a delivery alive after the reader lock was dropped.
+    * Taken with the lock held on a target that was just looked up. Neither
+    * freeIfcAddr() nor IPort::finish() return before the pins are released.
+    */
+   class Pin
+   {
+      Router &m_router;
+      uint32_t &m_pins;
+
+      Pin(const Pin&);
+      Pin& operator=(const Pin&);
+
+   public:
+      Pin(Router &router, uint32_t &pins)
+         : m_router(router)
+         , m_pins(pins)
+      {
+         __sync_fetch_and_add(&m_pins, 1u);
+      }
+
+      ~Pin()
+      {
+         m_router.unpin(m_pins);
+      }
+   };
+
    std::string m_name;
    tsd::common::logging::Logger m_log;
-   tsd::common::system::Mutex m_lock;
+   /*
+    * Routing only reads the tables below and takes a reader lock. The lock
+    * is only held to resolve the target Queue or IPort which is then pinned.
+    * The message is delivered after the lock was released. A sender that is
+    * blocked by a full queue does thus not stall the other senders of its
+    * lock shard. Management of the multicast groups takes the writer lock
+    * and delivers its packets with the lock held.
+    */
+   ShardedLock m_lock;
    Addr2Queue m_addr2Queue;
    MulticastGroups m_multicastGroups;
    MulticastStubs m_multicastStubs;
+   /*
+    * The cached event IDs are only changed with the writer lock. The values
+    * are replaced by broadcasts that hold the reader lock and additionally
+    * take m_lastValueLock.
+    */
+   LastValueCaches m_lastValues;
+   tsd::common::system::Mutex m_lastValueLock;
+   tsd::common::system::Mutex m_pinLock;
+   tsd::common::system::CondVar m_pinCondition;
+   uint32_t m_pinWaiters;
    uint32_t m_ifcSeqNum;
    IfcAddrs m_ifcAddrs;
    Ports m_ports;
    IPort *m_defaultGateway;
+   bool m_gatewaySuspended;
    uint8_t m_subNetPrefixLength;
    uint32_t m_subNetSeqNum;
    SubNets m_subNets;
@@ -62,14 +155,31 @@ class Router
 
    tsd::communication::event::IfcAddr_t allocateIfcAddrInternal();
    void freeIfcAddrInternal(tsd::communication::event::IfcAddr_t address);
+   QueueEntry* findQueue(tsd::communication::event::IfcAddr_t address);
+   void unpin(uint32_t &pins);
 
-   void routeLocalEvent(std::auto_ptr<tsd::communication::event::TsdEvent> msg, bool multicast);
+   void routeLocalEvent(std::auto_ptr<tsd::communication::event::TsdEvent> msg, bool multicast,
+                        MessagePriority priority, uint32_t deadline, bool conflatable);
    bool routeLocalPacket(std::auto_ptr<Packet> pkt, bool multicast);
-   void routeBroadcastMessage(tsd::communication::event::IfcAddr_t localAddr, tsd::communication::event::IfcAddr_t remoteAddr, std::auto_ptr<tsd::communication::event::TsdEvent> msg);
+   bool routePacketLocked(std::auto_ptr<Packet> evt, IPort *ingressPort,
+                          ShardedLock::ReadGuard *guard = NULL);
 
    IPort* getEgressPort(tsd::communication::event::IfcAddr_t &dest);
    bool isEgressPort(tsd::communication::event::IfcAddr_t dest, IPort *port, bool isDefaultGw);
-   void clearGroups(IPort *oldPort, bool wasDefaultGw);
+   void clearGroups(IPort *oldPort, bool wasDefaultGw, bool sendersVanished = true);
+   void getDownstreamNet(tsd::communication::event::IfcAddr_t &netAddr, uint8_t &prefixLength,
+      tsd::communication::event::IfcAddr_t &seqMask) const;
+
+   bool joinGroupInternal(tsd::communication::event::IfcAddr_t sender, tsd::communication::event::IfcAddr_t receiver, bool filtered);
+   void setSubscriptionsInternal(tsd::communication::event::IfcAddr_t sender, tsd::communication::event::IfcAddr_t receiver, bool filtered, const EventSet &events);
+   void announceSubscriptions(tsd::communication::event::IfcAddr_t sender, tsd::communication::event::IfcAddr_t stub);
+   void receivedSubscriptions(tsd::communication::event::IfcAddr_t sender, Packet &pkt);
+
+   void storeLastValue(LastValue &value, SharedEvent *shared,
+                       MessagePriority priority, uint32_t deadline, bool conflatable);
+   void sendLastValues(tsd::communication::event::IfcAddr_t sender, tsd::communication::event::IfcAddr_t receiver,
+                       bool filtered, const EventSet &events, const EventSet &previous);
+   void clearLastValues(LastValues &values);
 
    void sendDeathMessage(tsd::communication::event::IfcAddr_t localAddr, tsd::communication::event::IfcAddr_t source);
    void routeDeathMessage(tsd::communication::event::IfcAddr_t sender, tsd::communication::event::IfcAddr_t receiver);
@@ -90,12 +200,20 @@ public:
    bool allocateDownstreamAddr(tsd::communication::event::IfcAddr_t &addr,
       uint8_t &prefix,
       tsd::communication::event::IfcAddr_t &nameServer);
+   bool reserveDownstreamAddr(tsd::communication::event::IfcAddr_t addr,
+      uint8_t prefix,
+      tsd::communication::event::IfcAddr_t &nameServer);
    void freeDownstreamAddr(tsd::communication::event::IfcAddr_t address);
    void addDownstreamPort(IPort *port);
    bool addUpstreamPort(IPort *port,
       tsd::communication::event::IfcAddr_t nameServer,
       const std::string &subDomain);
+   void suspendUpstreamPort(IPort *port);
+   bool resumeUpstreamPort(IPort *port,
+      tsd::communication::event::IfcAddr_t nameServer,
+      const std::string &subDomain);
    void delPort(IPort *port);
+   void waitUnpinned(uint32_t &pins);
    bool isAnyPortAddr(tsd::communication::event::IfcAddr_t addr);
    bool hasUpstreamPort();
 
@@ -107,11 +225,17 @@ public:
    // multicast
    bool joinGroup(tsd::communication::event::IfcAddr_t sender, tsd::communication::event::IfcAddr_t receiver);
    bool leaveGroup(tsd::communication::event::IfcAddr_t sender, tsd::communication::event::IfcAddr_t receiver);
+   void setSubscriptions(tsd::communication::event::IfcAddr_t sender, tsd::communication::event::IfcAddr_t receiver, const std::set<uint32_t> &events);
+   void setLastValueCache(tsd::communication::event::IfcAddr_t localAddr, const std::set<uint32_t> &events);
 
    // routing
    bool routePacket(std::auto_ptr<Packet> evt, IPort *ingressPort = NULL);
-   void sendUnicastMessage(tsd::communication::event::IfcAddr_t localAddr, tsd::communication::event::IfcAddr_t remoteAddr, std::auto_ptr<tsd::communication::event::TsdEvent> msg);
-   void sendBroadcastMessage(tsd::communication::event::IfcAddr_t localAddr, std::auto_ptr<tsd::communication::event::TsdEvent> msg);
+   void sendUnicastMessage(tsd::communication::event::IfcAddr_t localAddr, tsd::communication::event::IfcAddr_t remoteAddr, std::auto_ptr<tsd::communication::event::TsdEvent> msg,
+                           MessagePriority priority = PRIORITY_NORMAL, uint32_t deadline = 0,
+                           bool conflatable = false);
+   void sendBroadcastMessage(tsd::communication::event::IfcAddr_t localAddr, std::auto_ptr<tsd::communication::event::TsdEvent> msg,
+                             MessagePriority priority = PRIORITY_NORMAL, uint32_t deadline = 0,
+                             bool conflatable = false);
 
    // misc
    inline std::string getName() const { return m_name; }
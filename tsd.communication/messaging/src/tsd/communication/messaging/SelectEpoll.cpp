@@ -12,7 +12,7 @@
 
 #include "SelectEpoll.hpp"
 
-static const int MAX_EVENTS = 8;
+static const int MAX_EVENTS = 64;
 
 namespace tsd { namespace communication { namespace messaging {
 
@@ -0,0 +1,276 @@
+
+#include <algorithm>
+
+#include "Packet.hpp"
+#include "SendScheduler.hpp"
+
+using tsd::communication::messaging::Packet;
+using tsd::communication::messaging::SendChunk;
+using tsd::communication::messaging::SendScheduler;
+
+namespace {
+
+   /*
+    * Inverse weights of the lanes. A lane advances its tags by the packet
+    * size times this factor. The control lane is not part of the fair
+    * queuing.
+    */
+   const uint64_t LANE_COST[] = { 0, 1, 2, 8 };
+
+   /*
+    * Header and syscall overhead of a packet in bytes. Keeps a flood of empty
+    * messages from being free.
+    */
+   const uint64_t PACKET_OVERHEAD = 32;
+
+   inline uint8_t bucketOf(const Packet *pkt)
+   {
+      uint64_t h = (pkt->getSenderAddr() ^ (pkt->getReceiverAddr() * UINT64_C(0x9e3779b97f4a7c15))) *
+                   UINT64_C(0x9e3779b97f4a7c15);
+      return static_cast<uint8_t>(h >> 56);
+   }
+
+}
+
+SendScheduler::SendScheduler()
+   : m_virtualTime(0)
+   , m_size(0)
+   , m_fragmentSize(0)
+   , m_expired(0)
+{
+   for (unsigned i = 0; i < NUM_LANES; i++) {
+      m_lanes[i].m_finish = 0;
+   }
+   for (unsigned i = 0; i < NUM_BUCKETS; i++) {
+      m_buckets[i].m_lane = 0;
+      m_buckets[i].m_count = 0;
+   }
+}
+
+SendScheduler::~SendScheduler()
+{
+   clear();
+}
+
+void SendScheduler::push(Packet *pkt)
+{
+   Entry entry;
+   entry.m_packet = pkt;
+   entry.m_start = 0;
+   entry.m_offset = 0;
+   entry.m_bucket = NO_BUCKET;
+
+   unsigned laneNum = PRIORITY_CONTROL;
+   if (pkt->getType() < Packet::OOB_BASE) {
+      // stay behind the queued packets of the same sender and receiver
+      entry.m_bucket = bucketOf(pkt);
+      Bucket &bucket = m_buckets[entry.m_bucket];
+      if (bucket.m_count == 0) {
+         bucket.m_lane = static_cast<uint8_t>(pkt->getPriority());
+      }
+      bucket.m_count++;
+      laneNum = bucket.m_lane;
+   }
+
+   Lane &lane = m_lanes[laneNum];
+   if (laneNum != PRIORITY_CONTROL) {
+      entry.m_start = std::max(m_virtualTime, lane.m_finish);
+      lane.m_finish = entry.m_start +
+         (pkt->getBufferLength() + PACKET_OVERHEAD) * LANE_COST[laneNum];
+   }
+
+   lane.m_entries.push_back(entry);
+   m_size++;
+}
+
+bool SendScheduler::pop(SendChunk &chunk)
+{
+   if (m_size == 0) {
+      return false;
+   }
+
+   unsigned laneNum = PRIORITY_CONTROL;
+   if (m_lanes[PRIORITY_CONTROL].m_entries.empty()) {
+      laneNum = NUM_LANES;
+      for (unsigned i = PRIORITY_REALTIME; i < NUM_LANES; i++) {
+         const Lane &lane = m_lanes[i];
+         if (!lane.m_entries.empty() &&
+             (laneNum == NUM_LANES ||
+              lane.m_entries.front().m_start < m_lanes[laneNum].m_entries.front().m_start)) {
+            laneNum = i;
+         }
+      }
+      m_virtualTime = m_lanes[laneNum].m_entries.front().m_start;
+   }
+
+   Lane &lane = m_lanes[laneNum];
+   Entry &head = lane.m_entries.front();
+   size_t remaining = head.m_packet->getBufferLength() - head.m_offset;
+
+   chunk.m_packet = head.m_packet;
+   chunk.m_offset = head.m_offset;
+   chunk.m_fragment = (head.m_offset > 0) ? FRAGMENT_CONT : 0;
+   chunk.m_timeToLive = 0;
+
+   if (m_fragmentSize > 0 && remaining > m_fragmentSize &&
+       head.m_packet->getType() < Packet::OOB_BASE) {
+      // the rest competes with the other lanes again
+      chunk.m_length = m_fragmentSize;
+      chunk.m_fragment |= FRAGMENT_MORE;
+      head.m_offset += m_fragmentSize;
+      head.m_start += (m_fragmentSize + PACKET_OVERHEAD) * LANE_COST[laneNum];
+   } else {
+      chunk.m_length = static_cast<uint32_t>(remaining);
+      take(lane, lane.m_entries.begin());
+   }
+
+   return true;
+}
+
+/**
+ * Only the heads of the lanes are checked. A stale message behind a fresh one
+ * is dropped once it moved up, still before it is sent.
+ */
+bool SendScheduler::pop(SendChunk &chunk, uint32_t now)
+{
+   for (unsigned i = 0; i < NUM_LANES; i++) {
+      Lane &lane = m_lanes[i];
+      while (!lane.m_entries.empty() && lane.m_entries.front().m_offset == 0 &&
+             lane.m_entries.front().m_packet->isExpired(now)) {
+         delete take(lane, lane.m_entries.begin());
+         m_expired++;
+      }
+   }
+
+   if (!pop(chunk)) {
+      return false;
+   }
+
+   uint32_t deadline = chunk.m_packet->getDeadline();
+   if (deadline != 0) {
+      chunk.m_timeToLive = Packet::isExpired(deadline, now) ? 1u : deadline - now;
+   }
+   return true;
+}
+
+void SendScheduler::setFragmentSize(uint32_t size)
+{
+   m_fragmentSize = size;
+}
+
+/**
+ * Remove an entry from @p lane and release its bucket.
+ */
+Packet *SendScheduler::take(Lane &lane, EntryQueue::iterator it)
+{
+   Packet *ret = it->m_packet;
+   if (it->m_bucket != NO_BUCKET) {
+      m_buckets[it->m_bucket].m_count--;
+   }
+   lane.m_entries.erase(it);
+   m_size--;
+
+   return ret;
+}
+
+void SendScheduler::clear()
+{
+   for (unsigned i = 0; i < NUM_LANES; i++) {
+      Lane &lane = m_lanes[i];
+      for (EntryQueue::iterator it(lane.m_entries.begin()); it != lane.m_entries.end(); ++it) {
+         delete it->m_packet;
+      }
+      lane.m_entries.clear();
+      lane.m_finish = 0;
+   }
+   for (unsigned i = 0; i < NUM_BUCKETS; i++) {
+      m_buckets[i].m_count = 0;
+   }
+
+   m_virtualTime = 0;
+   m_size = 0;
+}
+
+bool SendScheduler::dropOldest()
+{
+   for (unsigned i = NUM_LANES; i-- > 0; ) {
+      Lane &lane = m_lanes[i];
+      for (EntryQueue::iterator it(lane.m_entries.begin()); it != lane.m_entries.end(); ++it) {
+         if (Packet::isMessage(it->m_packet->getType()) && it->m_offset == 0) {
+            delete take(lane, it);
+            return true;
+         }
+      }
+   }
+
+   return false;
+}
+
+bool SendScheduler::dropMatching(const Packet *pkt)
+{
+   // a matching packet can only be in the lane of the bucket
+   const Bucket &bucket = m_buckets[bucketOf(pkt)];
+   if (bucket.m_count == 0) {
+      return false;
+   }
+
+   Lane &lane = m_lanes[bucket.m_lane];
+   for (EntryQueue::iterator it(lane.m_entries.end()); it != lane.m_entries.begin(); ) {
+      --it;
+      const Packet *queued = it->m_packet;
+      if (it->m_offset == 0 &&
+          queued->getType() == pkt->getType() &&
+          queued->getEventId() == pkt->getEventId() &&
+          queued->getSenderAddr() == pkt->getSenderAddr() &&
+          queued->getReceiverAddr() == pkt->getReceiverAddr()) {
+         delete take(lane, it);
+         return true;
+      }
+   }
+
+   return false;
+}
+
+/**
+ * The replacement keeps the position and start tag of the queued message, so
+ * the newest state goes out as early as the stale one would have. Other
+ * conflatable messages of the same sender and receiver may be overtaken by
+ * it. The tags behind it are moved by the size difference to keep the share
+ * of the lane as if the replacement had been queued in the first place.
+ */
+bool SendScheduler::replace(Packet *pkt)
+{
+   const Bucket &bucket = m_buckets[bucketOf(pkt)];
+   if (bucket.m_count == 0) {
+      return false;
+   }
+
+   unsigned laneNum = bucket.m_lane;
+   Lane &lane = m_lanes[laneNum];
+   for (EntryQueue::iterator it(lane.m_entries.end()); it != lane.m_entries.begin(); ) {
+      --it;
+      const Packet *queued = it->m_packet;
+      if (queued->getSenderAddr() != pkt->getSenderAddr() ||
+          queued->getReceiverAddr() != pkt->getReceiverAddr()) {
+         continue;
+      }
+      if (it->m_offset != 0 || !queued->isConflatable()) {
+         return false;
+      }
+      if (queued->getType() == pkt->getType() && queued->getEventId() == pkt->getEventId()) {
+         // the packets behind were tagged with the old size, move them by the difference
+         uint64_t oldCost = queued->getBufferLength() * LANE_COST[laneNum];
+         uint64_t newCost = pkt->getBufferLength() * LANE_COST[laneNum];
+         for (EntryQueue::iterator later(it + 1); later != lane.m_entries.end(); ++later) {
+            later->m_start = later->m_start + newCost - oldCost;
+         }
+         lane.m_finish = lane.m_finish + newCost - oldCost;
+
+         delete it->m_packet;
+         it->m_packet = pkt;
+         return true;
+      }
+   }
+
+   return false;
+}
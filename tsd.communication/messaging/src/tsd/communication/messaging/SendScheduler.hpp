@@ -0,0 +1,192 @@
+#ifndef TSD_COMMUNICATION_MESSAGING_SENDSCHEDULER_HPP
+#define TSD_COMMUNICATION_MESSAGING_SENDSCHEDULER_HPP
+
+#include <deque>
+
+#include <tsd/common/types/typedef.hpp>
+#include <tsd/communication/messaging/types.hpp>
+
+#include "BlockPool.hpp"
+#include "CompactHeader.hpp"
+
+namespace tsd { namespace communication { namespace messaging {
+
+class Packet;
+
+/**
+ * Part of a queued packet as it is handed out by SendScheduler::pop().
+ */
+struct SendChunk {
+   Packet *m_packet;
+   uint32_t m_offset;      // of the payload
+   uint32_t m_length;      // payload bytes
+   uint8_t m_fragment;     // FragmentFlags, zero for the whole packet
+   uint32_t m_timeToLive;  // remaining ms of the message when it was popped, zero if none
+
+   /**
+    * The last chunk of a packet owns it. The earlier ones only borrow the
+    * payload and must be sent before.
+    */
+   inline bool isLast() const
+   {
+      return (m_fragment & FRAGMENT_MORE) == 0;
+   }
+};
+
+/**
+ * Send queue of a port with one lane per MessagePriority.
+ *
+ * The control lane is always served first. The other lanes share the link
+ * by start-time fair queuing: every packet gets a start tag when it is
+ * queued and the lane with the smallest tag at its head is served next. The
+ * tags advance by the packet size divided by the weight of the lane, so a
+ * backlogged realtime lane gets eight times the bytes of a backlogged bulk
+ * lane. Idle lanes do not save up credit.
+ *
+ * Packets between the same sender and receiver must never overtake each
+ * other. The address pairs are hashed into buckets and all queued packets of
+ * a bucket are kept in the same lane. A packet therefore joins the lane of
+ * its bucket while the bucket is in use, whatever its own priority is.
+ * Out-of-band packets of the transport are not related to any messages and
+ * always go into the control lane.
+ *
+ * Messages whose deadline has passed are dropped when they reach the head of
+ * their lane, unless they are partially sent already.
+ *
+ * A conflatable message can take the place of a queued one of the same
+ * event, see replace(). It must not overtake a message of the same sender
+ * and receiver that is not conflatable.
+ *
+ * Payloads above the fragment size are handed out in chunks of that size.
+ * The rest of the packet stays at the head of its lane and competes with the
+ * other lanes again, so other traffic can be sent between the chunks. No
+ * other packet of the same lane is handed out before the last chunk, which
+ * keeps the fragments of a sender and receiver pair contiguous.
+ *
+ * The class is not thread safe. The ports protect it by their own lock.
+ */
+class SendScheduler
+{
+   enum {
+      NUM_LANES = PRIORITY_BULK + 1,
+      NUM_BUCKETS = 256,
+      NO_BUCKET = NUM_BUCKETS
+   };
+
+   struct Entry {
+      Packet *m_packet;
+      uint64_t m_start;       // start tag, unused in the control lane
+      uint32_t m_offset;      // payload handed out already
+      uint16_t m_bucket;
+   };
+
+   typedef std::deque<Entry, PoolAllocator<Entry> > EntryQueue;
+
+   struct Lane {
+      EntryQueue m_entries;
+      uint64_t m_finish;      // finish tag of the last queued packet
+   };
+
+   struct Bucket {
+      uint8_t m_lane;
+      uint32_t m_count;
+   };
+
+   Lane m_lanes[NUM_LANES];
+   Bucket m_buckets[NUM_BUCKETS];
+   uint64_t m_virtualTime;
+   size_t m_size;
+   uint32_t m_fragmentSize;
+   uint64_t m_expired;
+
+   Packet *take(Lane &lane, EntryQueue::iterator it);
+
+   // not copyable
+   SendScheduler(const SendScheduler &);
+   SendScheduler& operator=(const SendScheduler &);
+
+public:
+   SendScheduler();
+   ~SendScheduler();
+
+   /**
+    * Queue @p pkt. The scheduler takes ownership.
+    */
+   void push(Packet *pkt);
+
+   /**
+    * Take the next chunk that should be sent.
+    *
+    * @return False if the scheduler is empty. The caller takes ownership of
+    *         the packet with its last chunk.
+    */
+   bool pop(SendChunk &chunk);
+
+   /**
+    * Same as pop() but drops expired messages on the way and fills in the
+    * remaining time to live of the chunk. The rest of a partially sent
+    * message goes out even if it expired meanwhile.
+    *
+    * @param now  Current tick count, see Packet::isExpired()
+    */
+   bool pop(SendChunk &chunk, uint32_t now);
+
+   /**
+    * Hand out payloads of more than @p size bytes in fragments. Zero sends
+    * whole packets, only the rest of a packet that was fragmented already
+    * still goes out as its last fragment.
+    */
+   void setFragmentSize(uint32_t size);
+
+   /**
+    * Delete all queued packets.
+    */
+   void clear();
+
+   /**
+    * Drop the oldest message of the least urgent lane that has one. Control
+    * packets and partially sent messages are never dropped.
+    *
+    * @return False if no message is queued
+    */
+   bool dropOldest();
+
+   /**
+    * Drop the newest queued message with the same type, event ID, sender
+    * and receiver as @p pkt unless it is partially sent.
+    *
+    * @return False if there is no such message
+    */
+   bool dropMatching(const Packet *pkt);
+
+   /**
+    * Replace the queued message that is superseded by the conflatable
+    * message @p pkt. The scheduler takes ownership of @p pkt on success.
+    *
+    * @return False if there is no such message or @p pkt would overtake a
+    *         message that is not conflatable. The caller has to push() it.
+    */
+   bool replace(Packet *pkt);
+
+   /**
+    * Number of messages that were dropped because their deadline passed.
+    */
+   inline uint64_t getExpired() const
+   {
+      return m_expired;
+   }
+
+   inline bool empty() const
+   {
+      return m_size == 0;
+   }
+
+   inline size_t size() const
+   {
+      return m_size;
+   }
+};
+
+} } }
+
+#endif
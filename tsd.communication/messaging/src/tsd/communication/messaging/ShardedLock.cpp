@@ -0,0 +1,43 @@
+#include <tsd/common/system/Thread.hpp>
+
+#include "ShardedLock.hpp"
+
+namespace tsd { namespace communication { namespace messaging {
+
+__thread unsigned ShardedLock::s_held = 0;
+
+ShardedLock::ShardedLock()
+{
+}
+
+unsigned ShardedLock::currentShard()
+{
+   /*
+    * Thread ids are usually addresses of the thread control block and thus
+    * share their lower bits. Mix them (Fibonacci hashing) to spread the
+    * threads evenly across the shards.
+    */
+   uint64_t id = static_cast<uint64_t>(tsd::common::system::Thread::myself());
+   id ^= id >> 17;
+   id *= UINT64_C(0x9E3779B97F4A7C15);
+   return static_cast<unsigned>(id >> 32) % NUM_SHARDS;
+}
+
+void ShardedLock::lockExclusive()
+{
+   // always in ascending order to prevent dead-locks between writers
+   for (unsigned i = 0; i < NUM_SHARDS; i++) {
+      m_shards[i].m_mutex.lock();
+   }
+   s_held++;
+}
+
+void ShardedLock::unlockExclusive()
+{
+   s_held--;
+   for (unsigned i = NUM_SHARDS; i > 0; i--) {
+      m_shards[i-1].m_mutex.unlock();
+   }
+}
+
+} } }
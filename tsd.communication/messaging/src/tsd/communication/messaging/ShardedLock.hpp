@@ -0,0 +1,130 @@
+#ifndef TSD_COMMUNICATION_MESSAGING_SHARDEDLOCK_HPP
+#define TSD_COMMUNICATION_MESSAGING_SHARDEDLOCK_HPP
+
+#include <stdint.h>
+
+#include <tsd/common/system/Mutex.hpp>
+
+namespace tsd { namespace communication { namespace messaging {
+
+/**
+ * Read-mostly lock split into independent shards.
+ *
+ * Readers lock only the shard that belongs to the calling thread. Different
+ * threads will therefore (mostly) not contend with each other. Writers have to
+ * lock all shards in ascending order which makes them considerably more
+ * expensive. Use this for data that is read on every hot path and modified
+ * only rarely, e.g. the routing tables.
+ *
+ * The shards are recursive mutexes. A thread holding the write lock may
+ * freely take the read lock again. The opposite is *not* allowed: a reader
+ * must never try to upgrade to the write lock as two such readers would
+ * dead-lock each other.
+ *
+ * Every thread counts the shards that it holds across all instances. Code
+ * that might wait for other threads checks isHeldByCurrentThread() first.
+ */
+class ShardedLock
+{
+public:
+   enum { NUM_SHARDS = 16 };
+
+private:
+   struct Shard {
+      tsd::common::system::Mutex m_mutex;
+      // keep shards on separate cache lines
+      char m_padding[64];
+   };
+
+   Shard m_shards[NUM_SHARDS];
+   static __thread unsigned s_held;
+
+   ShardedLock(const ShardedLock&);
+   ShardedLock& operator=(const ShardedLock&);
+
+public:
+   ShardedLock();
+
+   /**
+    * Get the shard that the calling thread should use for reading.
+    */
+   static unsigned currentShard();
+
+   /**
+    * Check if the calling thread holds a reader or writer lock of any
+    * instance. It must not block on other threads in this case.
+    */
+   static inline bool isHeldByCurrentThread() { return s_held != 0; }
+
+   inline void lockShared(unsigned shard) { m_shards[shard].m_mutex.lock(); s_held++; }
+   inline void unlockShared(unsigned shard) { s_held--; m_shards[shard].m_mutex.unlock(); }
+
+   void lockExclusive();
+   void unlockExclusive();
+
+   /**
+    * Scoped reader lock. Takes the shard of the calling thread.
+    */
+   class ReadGuard
+   {
+      ShardedLock &m_lock;
+      unsigned m_shard;
+      bool m_locked;
+
+      ReadGuard(const ReadGuard&);
+      ReadGuard& operator=(const ReadGuard&);
+
+   public:
+      explicit ReadGuard(ShardedLock &lock)
+         : m_lock(lock)
+         , m_shard(currentShard())
+         , m_locked(true)
+      {
+         m_lock.lockShared(m_shard);
+      }
+
+      ~ReadGuard()
+      {
+         if (m_locked) {
+            m_lock.unlockShared(m_shard);
+         }
+      }
+
+      inline void lock() { m_lock.lockShared(m_shard); m_locked = true; }
+      inline void unlock() { m_locked = false; m_lock.unlockShared(m_shard); }
+   };
+
+   /**
+    * Scoped writer lock. Takes all shards.
+    */
+   class WriteGuard
+   {
+      ShardedLock &m_lock;
+      bool m_locked;
+
+      WriteGuard(const WriteGuard&);
+      WriteGuard& operator=(const WriteGuard&);
+
+   public:
+      explicit WriteGuard(ShardedLock &lock)
+         : m_lock(lock)
+         , m_locked(true)
+      {
+         m_lock.lockExclusive();
+      }
+
+      ~WriteGuard()
+      {
+         if (m_locked) {
+            m_lock.unlockExclusive();
+         }
+      }
+
+      inline void lock() { m_lock.lockExclusive(); m_locked = true; }
+      inline void unlock() { m_locked = false; m_lock.unlockExclusive(); }
+   };
+};
+
+} } }
+
+#endif
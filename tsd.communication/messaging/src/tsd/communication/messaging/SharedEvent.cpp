@@ -0,0 +1,53 @@
+#include "SharedEvent.hpp"
+
+using tsd::communication::event::TsdEvent;
+using tsd::communication::event::IfcAddr_t;
+
+namespace tsd { namespace communication { namespace messaging {
+
+SharedEvent::SharedEvent(std::auto_ptr<TsdEvent> event)
+   : m_refcnt(1)
+   , m_event(event.release())
+{
+}
+
+SharedEvent::~SharedEvent()
+{
+   delete m_event;
+}
+
+void SharedEvent::deref()
+{
+   if (m_refcnt.decrement() == 1) {
+      delete this;
+   }
+}
+
+std::auto_ptr<TsdEvent> SharedEvent::take(IfcAddr_t receiver)
+{
+   std::auto_ptr<TsdEvent> ret;
+   IfcAddr_t sender = m_event->getSenderAddr();
+
+   /*
+    * References are only added while the event is distributed by the sender
+    * which itself holds a reference. If we see a count of one nobody else can
+    * hold a reference anymore and we may steal the original. Otherwise clone
+    * it *before* dropping our reference as the event might be freed by the
+    * last owner right afterwards.
+    */
+   if (m_refcnt == 1) {
+      ret.reset(m_event);
+      m_event = NULL;
+      delete this;
+   } else {
+      ret.reset(m_event->clone());
+      deref();
+   }
+
+   // clone() does not preserve the addresses
+   ret->setSenderAddr(sender);
+   ret->setReceiverAddr(receiver);
+   return ret;
+}
+
+} } }
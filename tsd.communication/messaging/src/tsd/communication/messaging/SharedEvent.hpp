@@ -0,0 +1,64 @@
+#ifndef TSD_COMMUNICATION_MESSAGING_SHAREDEVENT_HPP
+#define TSD_COMMUNICATION_MESSAGING_SHAREDEVENT_HPP
+
+#include <memory>
+
+#include <tsd/common/system/AtomicInteger.hpp>
+#include <tsd/communication/event/TsdEvent.hpp>
+
+namespace tsd { namespace communication { namespace messaging {
+
+/**
+ * Reference counted, immutable event.
+ *
+ * Used to fan out a multicast message to many local receivers without
+ * cloning it for every one of them. The event must not be modified while it
+ * is shared. Each receiver gets its own copy only when it actually pulls the
+ * message out of its queue. The last reference gets the original event
+ * without any copy.
+ */
+class SharedEvent
+{
+   tsd::common::system::AtomicInteger m_refcnt;
+   tsd::communication::event::TsdEvent *m_event;
+
+   ~SharedEvent();
+
+   // not copyable
+   SharedEvent(const SharedEvent &);
+   SharedEvent& operator=(const SharedEvent &);
+
+public:
+   /**
+    * Create shared event. The caller holds the initial reference.
+    */
+   explicit SharedEvent(std::auto_ptr<tsd::communication::event::TsdEvent> event);
+
+   inline const tsd::communication::event::TsdEvent* get() const
+   {
+      return m_event;
+   }
+
+   inline void ref()
+   {
+      m_refcnt.increment();
+   }
+
+   void deref();
+
+   /**
+    * Convert a reference into a private event.
+    *
+    * Consumes the reference of the caller. The event is cloned unless the
+    * caller holds the last reference.
+    *
+    * @param receiver  Receiver address of the returned event
+    * @return Event that is exclusively owned by the caller
+    */
+   std::auto_ptr<tsd::communication::event::TsdEvent> take(
+      tsd::communication::event::IfcAddr_t receiver);
+};
+
+} } }
+
+#endif
@@ -0,0 +1,856 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <tsd/common/system/Thread.hpp>
+#include <tsd/communication/messaging/ConnectionException.hpp>
+
+#include "ConnectionImpl.hpp"
+#include "ShmPort.hpp"
+#include "SocketHelper.hpp"
+
+namespace {
+
+   const uint32_t SHM_MAGIC = 0x54534d31; // "TSM1"
+   const uint32_t RING_SIZE = 512u * 1024u; // per direction, must be a power of two
+   const unsigned SPIN_LOOPS = 1000;
+   const int HANDSHAKE_TIMEOUT = 3000; // ms
+   const std::string SOCKET_PREFIX("@tsd.communication.shm/");
+
+   enum {
+      SIDE_LISTENER = 0,
+      SIDE_CONNECTOR = 1,
+      CACHE_LINE = 64
+   };
+
+   /*
+    * Control block of one side. Only written by the owning side, except
+    * m_sleeping which is cleared by the peer when it sends the wakeup.
+    */
+   struct SideCtrl {
+      volatile uint32_t m_head;       // bytes written into our tx ring
+      volatile uint32_t m_tail;       // bytes consumed from our rx ring
+      volatile uint32_t m_sleeping;   // we are about to block and need a wakeup
+      uint8_t m_padding[CACHE_LINE - 3 * sizeof(uint32_t)];
+   };
+
+   /*
+    * Start of the shared memory segment. The tx ring of each side follows
+    * directly: first SIDE_LISTENER, then SIDE_CONNECTOR.
+    */
+   struct ShmHeader {
+      uint32_t m_magic;
+      uint32_t m_ringSize;
+      uint8_t m_padding[CACHE_LINE - 2 * sizeof(uint32_t)];
+      SideCtrl m_side[2];
+   };
+
+   /*
+    * Handshake message. Carries the shared memory, the eventfd of the
+    * connector and the eventfd of the listener.
+    */
+   struct Hello {
+      uint32_t m_magic;
+      uint32_t m_ringSize;
+   };
+
+   const size_t NUM_FDS = 3;
+   const size_t SHM_SIZE = sizeof(ShmHeader) + 2u * RING_SIZE;
+
+   inline uint32_t loadAcquire(const volatile uint32_t *p)
+   {
+      return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+   }
+
+   inline void storeRelease(volatile uint32_t *p, uint32_t val)
+   {
+      __atomic_store_n(p, val, __ATOMIC_RELEASE);
+   }
+
+   inline void fullBarrier()
+   {
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   }
+
+   inline void cpuRelax()
+   {
+#if defined(__i386__) || defined(__x86_64__)
+      __asm__ __volatile__("pause");
+#elif defined(__arm__) || defined(__aarch64__)
+      __asm__ __volatile__("yield");
+#endif
+   }
+
+   std::string socketPath(const std::string &name)
+   {
+      return SOCKET_PREFIX + (name.empty() ? std::string("commgr") : name);
+   }
+
+   int createSharedMemory()
+   {
+#ifdef MFD_CLOEXEC
+      int fd = memfd_create("tsd.communication.shm", MFD_CLOEXEC);
+#else
+      // no memfd: use a POSIX shm object that is unlinked immediately
+      static unsigned counter = 0;
+      char name[64];
+      std::snprintf(name, sizeof(name), "/tsd.communication.shm.%d.%u", getpid(),
+                    __sync_fetch_and_add(&counter, 1u));
+      int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+      if (fd != -1) {
+         shm_unlink(name);
+      }
+#endif
+
+      if (fd != -1 && ftruncate(fd, static_cast<off_t>(SHM_SIZE)) == -1) {
+         close(fd);
+         fd = -1;
+      }
+
+      return fd;
+   }
+
+   bool sendHello(int sock, const int fds[NUM_FDS])
+   {
+      Hello hello;
+      hello.m_magic = SHM_MAGIC;
+      hello.m_ringSize = RING_SIZE;
+
+      struct iovec iov;
+      iov.iov_base = &hello;
+      iov.iov_len = sizeof(hello);
+
+      char control[CMSG_SPACE(sizeof(int) * NUM_FDS)];
+      std::memset(control, 0, sizeof(control));
+
+      struct msghdr msg;
+      std::memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+
+      struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type = SCM_RIGHTS;
+      cmsg->cmsg_len = CMSG_LEN(sizeof(int) * NUM_FDS);
+      std::memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * NUM_FDS);
+
+      ssize_t ret;
+      do {
+         ret = sendmsg(sock, &msg, MSG_NOSIGNAL);
+      } while (ret == -1 && errno == EINTR);
+
+      return ret == static_cast<ssize_t>(sizeof(hello));
+   }
+
+   bool receiveHello(int sock, int fds[NUM_FDS])
+   {
+      struct pollfd pfd;
+      pfd.fd = sock;
+      pfd.events = POLLIN;
+      pfd.revents = 0;
+
+      int ret;
+      do {
+         ret = poll(&pfd, 1, HANDSHAKE_TIMEOUT);
+      } while (ret == -1 && errno == EINTR);
+      if (ret != 1) {
+         return false;
+      }
+
+      Hello hello;
+      struct iovec iov;
+      iov.iov_base = &hello;
+      iov.iov_len = sizeof(hello);
+
+      char control[CMSG_SPACE(sizeof(int) * NUM_FDS)];
+      struct msghdr msg;
+      std::memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+
+      ssize_t len;
+      do {
+         len = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+      } while (len == -1 && errno == EINTR);
+
+      struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+      if (cmsg == NULL || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS ||
+          cmsg->cmsg_len != CMSG_LEN(sizeof(int) * NUM_FDS)) {
+         return false;
+      }
+      std::memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * NUM_FDS);
+
+      if (len != static_cast<ssize_t>(sizeof(hello)) || hello.m_magic != SHM_MAGIC ||
+          hello.m_ringSize != RING_SIZE) {
+         for (size_t i = 0; i < NUM_FDS; i++) {
+            close(fds[i]);
+         }
+         return false;
+      }
+
+      return true;
+   }
+
+}
+
+namespace tsd { namespace communication { namespace messaging {
+
+   class Router;
+
+   class ShmPortHalf
+      : public IConnectionCallbacks
+   {
+      const unsigned m_side;
+      unsigned m_spinLoops;
+      int m_socket;
+      int m_peerWakeFd;
+      void *m_shmPtr;
+      volatile bool m_finish;
+      volatile uint32_t m_sleeping;
+
+      inline ShmHeader *header() const
+      {
+         return static_cast<ShmHeader*>(m_shmPtr);
+      }
+
+      inline uint8_t *ring(unsigned side) const
+      {
+         return static_cast<uint8_t*>(m_shmPtr) + sizeof(ShmHeader) + side * RING_SIZE;
+      }
+
+      bool receive();
+      bool transmit();
+      bool pending();
+      bool waitForWakeup();
+      void notifyPeer();
+
+   protected:
+      int m_wakeFd;
+      ConnectionImpl *m_connection;
+
+      ShmPortHalf(Router &router, unsigned side);
+      ~ShmPortHalf();
+
+      bool attach(int sock, int shmFd, int peerWakeFd);
+      void detach();
+      bool operate();
+      void finish();
+      void resetFinish();
+      bool finishRequested() const;
+
+      // IConnectionCallbacks
+      void wakeup();
+
+   public:
+      void disconnect();
+   };
+
+   class ShmPort::Listener
+      : public ShmPortHalf
+      , protected tsd::common::system::Thread
+   {
+      int m_listenFd;
+
+      int waitForConnect();
+      bool setupSession(int sock);
+
+   protected:
+      void run(); // tsd::common::system::Thread
+      bool setupConnection(); // IConnectionCallbacks
+      void teardownConnection(); // IConnectionCallbacks
+
+   public:
+      Listener(Router &router);
+      ~Listener();
+
+      void initListen(const std::string &name);
+   };
+
+   class ShmPort::Connector
+      : public ShmPortHalf
+      , protected tsd::common::system::Thread
+   {
+   protected:
+      void run(); // tsd::common::system::Thread
+      bool setupConnection(); // IConnectionCallbacks
+      void teardownConnection(); // IConnectionCallbacks
+
+   public:
+      Connector(Router &router);
+      ~Connector();
+
+      void initConnect(const std::string &name, const std::string &subDomain);
+   };
+
+} } }
+
+using tsd::communication::messaging::ShmPort;
+using tsd::communication::messaging::ShmPortHalf;
+
+/*****************************************************************************/
+
+ShmPortHalf::ShmPortHalf(Router &router, unsigned side)
+   : m_side(side)
+   , m_spinLoops(SPIN_LOOPS)
+   , m_socket(-1)
+   , m_peerWakeFd(-1)
+   , m_shmPtr(MAP_FAILED)
+   , m_finish(false)
+   , m_sleeping(0)
+   , m_wakeFd(-1)
+   , m_connection(0)
+{
+   // spinning only helps if the peer can run in the meantime
+   if (sysconf(_SC_NPROCESSORS_ONLN) < 2) {
+      m_spinLoops = 0;
+   }
+
+   m_connection = new ConnectionImpl(*this, router);
+}
+
+ShmPortHalf::~ShmPortHalf()
+{
+   m_connection->disconnect();
+   delete m_connection;
+
+   detach();
+
+   if (m_wakeFd != -1) {
+      close(m_wakeFd);
+   }
+}
+
+/**
+ * Map the shared memory of a new session.
+ *
+ * Takes ownership of @p sock and @p peerWakeFd. The shared memory file
+ * descriptor is not needed after the mapping and stays with the caller.
+ */
+bool ShmPortHalf::attach(int sock, int shmFd, int peerWakeFd)
+{
+   m_socket = sock;
+   m_peerWakeFd = peerWakeFd;
+   m_shmPtr = mmap(NULL, SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shmFd, 0);
+   if (m_shmPtr == MAP_FAILED) {
+      return false;
+   }
+
+   if (m_side == SIDE_LISTENER) {
+      std::memset(m_shmPtr, 0, sizeof(ShmHeader));
+      header()->m_magic = SHM_MAGIC;
+      header()->m_ringSize = RING_SIZE;
+   }
+
+   return header()->m_magic == SHM_MAGIC && header()->m_ringSize == RING_SIZE;
+}
+
+void ShmPortHalf::detach()
+{
+   if (m_shmPtr != MAP_FAILED) {
+      munmap(m_shmPtr, SHM_SIZE);
+      m_shmPtr = MAP_FAILED;
+   }
+
+   if (m_peerWakeFd != -1) {
+      close(m_peerWakeFd);
+      m_peerWakeFd = -1;
+   }
+
+   // the peer sees the hangup and terminates the session too
+   if (m_socket != -1) {
+      close(m_socket);
+      m_socket = -1;
+   }
+}
+
+/**
+ * Move data between the rings and the ConnectionImpl.
+ *
+ * Keeps polling the rings for a short while after the last transfer. Only
+ * then the thread announces in the shared memory that it is going to
+ * sleep. As long as it is not sleeping the peer does not need to send any
+ * wakeups.
+ *
+ * @return True if the peer went away, false if finish() was called.
+ */
+bool ShmPortHalf::operate()
+{
+   unsigned idle = 0;
+   volatile uint32_t *sleeping = &header()->m_side[m_side].m_sleeping;
+
+   while (!m_finish) {
+      bool progress = receive();
+      progress = transmit() || progress;
+
+      if (progress) {
+         idle = 0;
+      } else if (idle < m_spinLoops) {
+         idle++;
+         cpuRelax();
+      } else {
+         // Announce sleep and check again. Either we see the new data or
+         // the peer (or local sender) sees the flag and wakes us up.
+         m_sleeping = 1;
+         storeRelease(sleeping, 1);
+         fullBarrier();
+
+         bool alive = pending() || waitForWakeup();
+
+         storeRelease(sleeping, 0);
+         m_sleeping = 0;
+         idle = 0;
+
+         if (!alive) {
+            // pick up whatever the peer sent before it left
+            receive();
+            return true;
+         }
+      }
+   }
+
+   return false;
+}
+
+bool ShmPortHalf::receive()
+{
+   SideCtrl &self = header()->m_side[m_side];
+   SideCtrl &peer = header()->m_side[1 - m_side];
+
+   uint32_t tail = self.m_tail;
+   uint32_t head = loadAcquire(&peer.m_head);
+   if (head == tail) {
+      return false;
+   }
+
+   // never trust the peer further than the ring
+   uint32_t avail = std::min(head - tail, RING_SIZE);
+   const uint8_t *data = ring(1 - m_side);
+   while (avail > 0) {
+      uint32_t offset = tail & (RING_SIZE - 1u);
+      uint32_t chunk = std::min(avail, RING_SIZE - offset);
+      m_connection->processData(data + offset, chunk);
+      tail += chunk;
+      avail -= chunk;
+   }
+
+   storeRelease(&self.m_tail, tail);
+   notifyPeer();
+
+   return true;
+}
+
+bool ShmPortHalf::transmit()
+{
+   SideCtrl &self = header()->m_side[m_side];
+   SideCtrl &peer = header()->m_side[1 - m_side];
+
+   uint32_t head = self.m_head;
+   uint32_t space = RING_SIZE - (head - loadAcquire(&peer.m_tail));
+   uint8_t *data = ring(m_side);
+   bool ret = false;
+
+   const void *buf;
+   size_t size;
+   while (space > 0 && m_connection->getData(buf, size)) {
+      uint32_t offset = head & (RING_SIZE - 1u);
+      uint32_t chunk = std::min(space, RING_SIZE - offset);
+      if (size < chunk) {
+         chunk = static_cast<uint32_t>(size);
+      }
+
+      std::memcpy(data + offset, buf, chunk);
+      m_connection->consumeData(chunk);
+      head += chunk;
+      space -= chunk;
+      ret = true;
+   }
+
+   if (ret) {
+      storeRelease(&self.m_head, head);
+      notifyPeer();
+   }
+
+   return ret;
+}
+
+/**
+ * Check if there is something to do right now.
+ */
+bool ShmPortHalf::pending()
+{
+   SideCtrl &self = header()->m_side[m_side];
+   SideCtrl &peer = header()->m_side[1 - m_side];
+
+   if (loadAcquire(&peer.m_head) != self.m_tail) {
+      return true;
+   }
+
+   const void *buf;
+   size_t size;
+   return self.m_head - loadAcquire(&peer.m_tail) < RING_SIZE &&
+          m_connection->getData(buf, size);
+}
+
+/**
+ * Wake the peer if it announced that it is sleeping.
+ *
+ * The flag is cleared by us so that the peer gets exactly one wakeup per
+ * sleep, no matter how many messages we send in the meantime.
+ */
+void ShmPortHalf::notifyPeer()
+{
+   fullBarrier();
+   if (__atomic_exchange_n(&header()->m_side[1 - m_side].m_sleeping, 0u, __ATOMIC_SEQ_CST)) {
+      eventfd_write(m_peerWakeFd, 1);
+   }
+}
+
+/**
+ * Block until we are woken up.
+ *
+ * @return False if the peer closed the connection.
+ */
+bool ShmPortHalf::waitForWakeup()
+{
+   struct pollfd pfd[2];
+   pfd[0].fd = m_wakeFd;
+   pfd[0].events = POLLIN;
+   pfd[0].revents = 0;
+   pfd[1].fd = m_socket;
+   pfd[1].events = POLLIN;
+   pfd[1].revents = 0;
+
+   int ret;
+   do {
+      ret = poll(pfd, 2, -1);
+   } while (ret == -1 && errno == EINTR);
+
+   if (ret < 0) {
+      return false;
+   }
+
+   if (pfd[0].revents & POLLIN) {
+      eventfd_t unused;
+      eventfd_read(m_wakeFd, &unused);
+   }
+
+   // nothing is sent on the socket after the handshake
+   return pfd[1].revents == 0;
+}
+
+void ShmPortHalf::finish()
+{
+   m_finish = true;
+   eventfd_write(m_wakeFd, 1);
+}
+
+void ShmPortHalf::resetFinish()
+{
+   m_finish = false;
+}
+
+bool ShmPortHalf::finishRequested() const
+{
+   return m_finish;
+}
+
+// IConnectionCallbacks
+void ShmPortHalf::wakeup()
+{
+   // the io-thread will see the new data by itself if it is not sleeping
+   fullBarrier();
+   if (m_sleeping) {
+      eventfd_write(m_wakeFd, 1);
+   }
+}
+
+void ShmPortHalf::disconnect()
+{
+   m_connection->disconnect();
+}
+
+/*****************************************************************************/
+
+ShmPort::Listener::Listener(Router &router)
+   : ShmPortHalf(router, SIDE_LISTENER)
+   , tsd::common::system::Thread("tsd.communication.messaging.ShmPort.Listener")
+   , m_listenFd(-1)
+{ }
+
+ShmPort::Listener::~Listener()
+{
+   // the thread must have been stopped before the socket is gone
+   m_connection->disconnect();
+
+   if (m_listenFd != -1) {
+      close(m_listenFd);
+   }
+}
+
+void ShmPort::Listener::initListen(const std::string &name)
+{
+   struct sockaddr_un sockaddr;
+   socklen_t sockaddrLen;
+
+   tsd::communication::messaging::parseUnixPath(socketPath(name), sockaddr, sockaddrLen);
+
+   m_wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+   if (m_wakeFd == -1) {
+      int err = errno;
+      throw ConnectionException(std::string("Cannot create eventfd: ") +
+         std::strerror(err));
+   }
+
+   m_listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+   if (m_listenFd == -1) {
+      int err = errno;
+      throw ConnectionException(std::string("Could not create socket: ") +
+         std::strerror(err));
+   }
+
+   if (bind(m_listenFd, reinterpret_cast<struct sockaddr*>(&sockaddr), sockaddrLen) == -1 ||
+       listen(m_listenFd, 1) == -1) {
+      int err = errno;
+      throw ConnectionException("Could not listen on shm://" + name + ": " +
+         std::strerror(err));
+   }
+
+   if (!m_connection->listenDownstream()) {
+      throw ConnectionException("listenDownstream failed");
+   }
+}
+
+/**
+ * Wait for the next peer.
+ *
+ * @return Socket of the peer or -1 if finish() was called.
+ */
+int ShmPort::Listener::waitForConnect()
+{
+   int ret = -1;
+
+   while (ret == -1 && !finishRequested()) {
+      struct pollfd pfd[2];
+      pfd[0].fd = m_wakeFd;
+      pfd[0].events = POLLIN;
+      pfd[0].revents = 0;
+      pfd[1].fd = m_listenFd;
+      pfd[1].events = POLLIN;
+      pfd[1].revents = 0;
+
+      if (poll(pfd, 2, -1) == -1) {
+         continue;
+      }
+
+      if (pfd[0].revents & POLLIN) {
+         eventfd_t unused;
+         eventfd_read(m_wakeFd, &unused);
+      }
+
+      if (pfd[1].revents & POLLIN) {
+         ret = accept4(m_listenFd, NULL, NULL, SOCK_CLOEXEC);
+      }
+   }
+
+   if (ret != -1 && finishRequested()) {
+      close(ret);
+      ret = -1;
+   }
+
+   return ret;
+}
+
+/**
+ * Create the shared memory for a new peer and hand it over.
+ */
+bool ShmPort::Listener::setupSession(int sock)
+{
+   int shmFd = createSharedMemory();
+   int peerWakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+   if (shmFd == -1 || peerWakeFd == -1) {
+      if (shmFd != -1) {
+         close(shmFd);
+      }
+      if (peerWakeFd != -1) {
+         close(peerWakeFd);
+      }
+      close(sock);
+      return false;
+   }
+
+   // from here on detach() cleans up
+   bool ok = attach(sock, shmFd, peerWakeFd);
+   if (ok) {
+      int fds[NUM_FDS] = { shmFd, peerWakeFd, m_wakeFd };
+      ok = sendHello(sock, fds);
+   }
+
+   close(shmFd);
+
+   return ok;
+}
+
+void ShmPort::Listener::run()
+{
+   bool ok;
+
+   do {
+      int sock = waitForConnect();
+      ok = sock != -1;
+      if (ok && setupSession(sock)) {
+         m_connection->setConnected();
+         ok = operate();
+         m_connection->setDisconnected();
+      }
+      detach();
+   } while (ok);
+}
+
+bool ShmPort::Listener::setupConnection()
+{
+   resetFinish();
+   start();
+   return true;
+}
+
+void ShmPort::Listener::teardownConnection()
+{
+   finish();
+   join();
+}
+
+/*****************************************************************************/
+
+ShmPort::Connector::Connector(Router &router)
+   : ShmPortHalf(router, SIDE_CONNECTOR)
+   , tsd::common::system::Thread("tsd.communication.messaging.ShmPort.Connector")
+{ }
+
+ShmPort::Connector::~Connector()
+{
+   m_connection->disconnect();
+}
+
+void ShmPort::Connector::initConnect(const std::string &name, const std::string &subDomain)
+{
+   struct sockaddr_un sockaddr;
+   socklen_t sockaddrLen;
+
+   tsd::communication::messaging::parseUnixPath(socketPath(name), sockaddr, sockaddrLen);
+
+   int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+   if (sock == -1) {
+      int err = errno;
+      throw ConnectionException(std::string("Could not create socket: ") +
+         std::strerror(err));
+   }
+
+   if (connect(sock, reinterpret_cast<struct sockaddr*>(&sockaddr), sockaddrLen) == -1) {
+      int err = errno;
+      close(sock);
+      throw ConnectionException("Could not connect to shm://" + name + ": " +
+         std::strerror(err));
+   }
+
+   int fds[NUM_FDS];
+   if (!receiveHello(sock, fds)) {
+      close(sock);
+      throw ConnectionException("Handshake with shm://" + name + " failed");
+   }
+
+   m_wakeFd = fds[1];
+   bool ok = attach(sock, fds[0], fds[2]);
+   close(fds[0]);
+   if (!ok) {
+      throw ConnectionException("Cannot map shared memory of shm://" + name);
+   }
+
+   if (!m_connection->connectUpstream(subDomain)) {
+      throw ConnectionException("connectUpstream failed");
+   }
+}
+
+void ShmPort::Connector::run()
+{
+   m_connection->setConnected();
+   operate();
+   m_connection->setDisconnected();
+}
+
+bool ShmPort::Connector::setupConnection()
+{
+   resetFinish();
+   start();
+   return true;
+}
+
+void ShmPort::Connector::teardownConnection()
+{
+   finish();
+   join();
+}
+
+/*****************************************************************************/
+
+ShmPort::ShmPort(Router &router)
+   : m_router(router)
+   , m_listener(0)
+   , m_connector(0)
+{ }
+
+ShmPort::~ShmPort()
+{
+   ShmPort::disconnect();
+}
+
+void ShmPort::connectUpstream(const std::string &name, const std::string &subDomain)
+{
+   if (m_connector || m_listener) {
+      throw ConnectionException("Already connected");
+   }
+
+   std::auto_ptr<Connector> connector(new Connector(m_router));
+   connector->initConnect(name, subDomain);
+   m_connector = connector.release();
+}
+
+void ShmPort::listenDownstream(const std::string &name)
+{
+   if (m_connector || m_listener) {
+      throw ConnectionException("Already connected");
+   }
+
+   std::auto_ptr<Listener> listener(new Listener(m_router));
+   listener->initListen(name);
+   m_listener = listener.release();
+}
+
+void ShmPort::disconnect()
+{
+   if (m_listener != 0) {
+      m_listener->disconnect();
+      delete m_listener;
+      m_listener = 0;
+   }
+
+   if (m_connector != 0) {
+      m_connector->disconnect();
+      delete m_connector;
+      m_connector = 0;
+   }
+}
@@ -0,0 +1,43 @@
+#ifndef TSD_COMMUNICATION_MESSAGING_SHMPORT_HPP
+#define TSD_COMMUNICATION_MESSAGING_SHMPORT_HPP
+
+#include <string>
+
+#include <tsd/communication/messaging/Connection.hpp>
+
+namespace tsd { namespace communication { namespace messaging {
+
+class Router;
+
+/**
+ * Point-to-point transport through shared memory on the same host.
+ *
+ * The listening side accepts peers on a unix socket in the abstract
+ * namespace. For every peer it creates an anonymous shared memory segment
+ * with one ring buffer per direction and hands it over together with the
+ * eventfd's that are used for wakeups. The socket stays open to detect if
+ * the peer went away. Only one peer can be connected at a time.
+ */
+class ShmPort
+   : public IConnection
+{
+   class Listener;
+   class Connector;
+
+   Router &m_router;
+   Listener *m_listener;
+   Connector *m_connector;
+
+public:
+   ShmPort(Router &router);
+   ~ShmPort();
+
+   void connectUpstream(const std::string &name, const std::string &subDomain);
+   void listenDownstream(const std::string &name);
+
+   void disconnect(); // IConnection
+};
+
+} } }
+
+#endif
@@ -1,4 +1,5 @@
 
+#include <algorithm>
 #include <arpa/inet.h>
 #include <cstdlib>
 #include <cstring>
@@ -13,14 +14,16 @@
 #include <unistd.h>
 
 #include <tsd/common/logging/Logger.hpp>
+#include <tsd/common/system/Clock.hpp>
+#include <tsd/common/system/CondVar.hpp>
 #include <tsd/common/system/Mutex.hpp>
 #include <tsd/common/system/Thread.hpp>
 #include <tsd/communication/messaging/ConnectionException.hpp>
 
 #include "IPort.hpp"
 #include "Packet.hpp"
+#include "Reactor.hpp"
 #include "Router.hpp"
-#include "Select.hpp"
 #include "SocketHelper.hpp"
 #include "TcpClientPort.hpp"
 #include "TcpEndpoint.hpp"
@@ -46,30 +49,92 @@ namespace {
 
 namespace tsd { namespace communication { namespace messaging {
 
+   /**
+    * Client side of a socket connection.
+    *
+    * The port has no thread of its own. The socket is served by a loop of the
+    * process wide Reactor. Everything that touches the Select or calls
+    * connected()/disconnected() runs on that loop.
+    *
+    * In reconnect mode a lost connection only suspends the port. A helper
+    * thread connects again with exponential backoff and resumes the port.
+    * It cannot run on the loop because resuming waits for the upstream
+    * router.
+    */
    class TcpClientPort::Impl
-      : private tsd::common::system::Thread
-      , private TcpEndpoint
+      : private TcpEndpoint
       , private IPort
+      , private IReactorTask
    {
-      void run(); // tsd::common::system::Thread
+      class ReconnectThread
+         : public tsd::common::system::Thread
+      {
+         Impl &m_port;
+
+      public:
+         ReconnectThread(Impl &port)
+            : tsd::common::system::Thread("TcpReconnect")
+            , m_port(port)
+         { }
+
+         void run() { m_port.reconnect(); }
+      };
+
       void epReceivedPacket(std::auto_ptr<Packet> pkt);  // TcpEndpoint
       void epDisconnected();  // TcpEndpoint
       bool sendPacket(std::auto_ptr<Packet> pkt);  // IPort
       bool startPort(); // IPort
       void stopPort();  // IPort
+      void startCompactHeaders(tsd::communication::event::IfcAddr_t localBase,
+                               tsd::communication::event::IfcAddr_t peerBase); // IPort
+      void reactorRun(); // IReactorTask
+
+      void attachLoop();
+      int openSocket(std::string &error);
+      void startIo();
+      void stopIo();
+      void resetIo();
+      void releaseIo();
+      void startReconnect();
+      void reconnect();
 
       Router &m_router;
       std::string m_subDomain;
       bool m_running;
-      Select m_select;
+      bool m_disconnectPending;
+      bool m_active;       // loop thread only: connected() was called
+      bool m_started;      // loop thread only: result of startIo()
+      int m_socket;        // until handed over to the TcpEndpoint
+      ReactorLoop *m_loop;
       tsd::common::logging::Logger m_log;
       tsd::common::system::Mutex m_lock;
 
+      // peer address, kept for reconnects
+      struct sockaddr_storage m_peer;
+      socklen_t m_peerLen;
+      uint32_t m_sndBuf;
+      uint32_t m_rcvBuf;
+
+      uint32_t m_minBackoff;     // 0: reconnect disabled
+      uint32_t m_maxBackoff;
+      bool m_reconnecting;       // reconnect thread is busy
+      std::auto_ptr<ReconnectThread> m_reconnectThread;
+      tsd::common::system::CondVar m_reconnectCondition;
+
    public:
       Impl(Router &router, const std::string &subDomain);
       ~Impl();
 
       void disconnect();
+      using TcpEndpoint::setSendQueueLimit;
+      using TcpEndpoint::setZeroCopyThreshold;
+      using TcpEndpoint::getDroppedPackets;
+      using TcpEndpoint::getExpiredPackets;
+      using TcpEndpoint::setCompression;
+      using TcpEndpoint::setFragmentation;
+      using TcpEndpoint::getCompressionStats;
+      using IPort::setCompactHeaders;
+      void setReconnect(uint32_t minBackoff, uint32_t maxBackoff);
       void initV4(uint32_t addr, uint16_t port, uint32_t sndBuf, uint32_t rcvBuf);
       void initUnix(const std::string &path);
    };
@@ -80,19 +145,39 @@ namespace tsd { namespace communication { namespace messaging {
 
 TcpClientPort::Impl::Impl(tsd::communication::messaging::Router &router,
                           const std::string &subDomain)
-   : tsd::common::system::Thread("TcpClientPort")
-   , TcpEndpoint(m_log)
+   : TcpEndpoint(m_log)
    , tsd::communication::messaging::IPort(router)
    , m_router(router)
    , m_subDomain(subDomain)
    , m_running(false)
+   , m_disconnectPending(false)
+   , m_active(false)
+   , m_started(false)
+   , m_socket(-1)
+   , m_loop(NULL)
    , m_log("tsd.communication.TcpClientPort")
+   , m_peerLen(0)
+   , m_sndBuf(0)
+   , m_rcvBuf(0)
+   , m_minBackoff(0)
+   , m_maxBackoff(0)
+   , m_reconnecting(false)
 {
+   std::memset(&m_peer, 0, sizeof(m_peer));
 }
 
 TcpClientPort::Impl::~Impl()
 {
-   TcpEndpoint::cleanup();
+   if (m_loop != NULL) {
+      m_loop->call(*this, &Impl::releaseIo);
+      Reactor::detach(m_loop);
+   } else {
+      TcpEndpoint::cleanup();
+   }
+
+   if (m_socket != -1) {
+      close(m_socket);
+   }
 }
 
 void TcpClientPort::Impl::disconnect()
@@ -100,24 +185,83 @@ void TcpClientPort::Impl::disconnect()
    finish();
 }
 
+void TcpClientPort::Impl::setReconnect(uint32_t minBackoff, uint32_t maxBackoff)
+{
+   m_minBackoff = minBackoff;
+   m_maxBackoff = std::max(minBackoff, maxBackoff);
+   setPersistent(minBackoff > 0);
+}
+
 void TcpClientPort::Impl::initV4(uint32_t addr, uint16_t port, uint32_t sndBuf, uint32_t rcvBuf)
 {
    signal(SIGPIPE, SIG_IGN);
 
-   bool ok = m_select.init();
-   if (!ok) {
-      throw ConnectionException("Selector init failed!");
+   attachLoop();
+
+   struct sockaddr_in *sockaddr = reinterpret_cast<struct sockaddr_in*>(&m_peer);
+   std::memset(&m_peer, 0, sizeof(m_peer));
+   sockaddr->sin_family = AF_INET;
+   sockaddr->sin_port = static_cast<in_port_t>(htons(port));
+   sockaddr->sin_addr.s_addr = htonl(addr);
+   m_peerLen = sizeof(*sockaddr);
+   m_sndBuf = sndBuf;
+   m_rcvBuf = rcvBuf;
+
+   std::string error;
+   m_socket = openSocket(error);
+   if (m_socket < 0) {
+      throw ConnectionException(error);
    }
 
-   int sock = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+   if (!initUpstream(m_subDomain)) {
+      throw ConnectionException("initUpstream failed");
+   }
+}
+
+void TcpClientPort::Impl::initUnix(const std::string &path)
+{
+   struct sockaddr_un sockaddr;
+   socklen_t sockaddrLen;
+
+   tsd::communication::messaging::parseUnixPath(path, sockaddr, sockaddrLen);
+
+   signal(SIGPIPE, SIG_IGN);
+
+   attachLoop();
+
+   std::memset(&m_peer, 0, sizeof(m_peer));
+   std::memcpy(&m_peer, &sockaddr, sockaddrLen);
+   m_peerLen = sockaddrLen;
+
+   std::string error;
+   m_socket = openSocket(error);
+   if (m_socket < 0) {
+      throw ConnectionException(error);
+   }
+
+   if (!initUpstream(m_subDomain)) {
+      throw ConnectionException("initUpstream failed");
+   }
+}
+
+/**
+ * Create a socket and connect it to the peer.
+ *
+ * @return Connected socket or -1 with the reason in @p error
+ */
+int TcpClientPort::Impl::openSocket(std::string &error)
+{
+   bool inet = m_peer.ss_family == AF_INET;
+
+   int sock = socket(m_peer.ss_family, SOCK_STREAM | SOCK_CLOEXEC | (inet ? 0 : SOCK_NONBLOCK), 0);
    if (sock < 0) {
       int err = errno;
-      throw ConnectionException(std::string("Could not create socket: ") +
-         std::strerror(err));
+      error = std::string("Could not create socket: ") + std::strerror(err);
+      return -1;
    }
 
-   if (sndBuf > 0) {
-      int size = sndBuf;
+   if (m_sndBuf > 0) {
+      int size = m_sndBuf;
       if (setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) != 0) {
          int err = errno;
          m_log << tsd::common::logging::LogLevel::Error
@@ -126,8 +270,8 @@ void TcpClientPort::Impl::initV4(uint32_t addr, uint16_t port, uint32_t sndBuf,
       }
    }
 
-   if (rcvBuf > 0) {
-      int size = rcvBuf;
+   if (m_rcvBuf > 0) {
+      int size = m_rcvBuf;
       if (setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) != 0) {
          int err = errno;
          m_log << tsd::common::logging::LogLevel::Error
@@ -136,132 +280,262 @@ void TcpClientPort::Impl::initV4(uint32_t addr, uint16_t port, uint32_t sndBuf,
       }
    }
 
-   struct sockaddr_in sockaddr;
-
-   std::memset(&sockaddr, 0, sizeof(sockaddr));
-   sockaddr.sin_family = AF_INET;
-   sockaddr.sin_port = static_cast<in_port_t>(htons(port));
-   sockaddr.sin_addr.s_addr = htonl(addr);
-
    int ret;
    do {
-      ret = connect(sock, (struct sockaddr *) &sockaddr, sizeof(sockaddr));
+      ret = connect(sock, (struct sockaddr *) &m_peer, m_peerLen);
    } while (ret < 0 && errno == EINTR);
    if (ret < 0) {
       int err = errno;
       close(sock);
-      throw ConnectionException(std::string("connect failed: ") +
-         std::strerror(err));
+      error = std::string("connect failed: ") + std::strerror(err);
+      return -1;
    }
 
-   setTcpNoDelay(sock);
-   setNonBlocking(sock);
-
-   if (!TcpEndpoint::init(sock, m_select)) {
-      throw ConnectionException("TcpEndpoint init failed");
+   if (inet) {
+      setTcpNoDelay(sock);
+      setNonBlocking(sock);
    }
 
-   if (!initUpstream(m_subDomain)) {
-      throw ConnectionException("initUpstream failed");
-   }
+   return sock;
 }
 
-void TcpClientPort::Impl::initUnix(const std::string &path)
+bool TcpClientPort::Impl::sendPacket(std::auto_ptr<Packet> pkt)
 {
-   struct sockaddr_un sockaddr;
-   socklen_t sockaddrLen;
+   return epSendPacket(pkt);
+}
 
-   tsd::communication::messaging::parseUnixPath(path, sockaddr, sockaddrLen);
+void TcpClientPort::Impl::startCompactHeaders(tsd::communication::event::IfcAddr_t localBase,
+                                              tsd::communication::event::IfcAddr_t peerBase)
+{
+   sendCompactMarker(CompactHeader(localBase, peerBase));
+}
 
-   signal(SIGPIPE, SIG_IGN);
+void TcpClientPort::Impl::epReceivedPacket(std::auto_ptr<Packet> pkt)
+{
+   receivedPacket(pkt);
+}
 
-   bool ok = m_select.init();
-   if (!ok) {
-      throw ConnectionException("Selector init failed!");
-   }
+void TcpClientPort::Impl::epDisconnected()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   m_log << tsd::common::logging::LogLevel::Warn
+         << "Peer disconnected!" << &std::endl;
 
-   int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
-   if (sock < 0) {
-      int err = errno;
-      throw ConnectionException(std::string("Could not create socket: ") +
-         std::strerror(err));
+   // regardless of the context we hand this over to the loop
+   if (m_running && !m_disconnectPending) {
+      m_disconnectPending = true;
+      g.unlock();
+      m_loop->post(this);
    }
+}
 
-   int ret;
-   do {
-      ret = connect(sock, (struct sockaddr *) &sockaddr, sockaddrLen);
-   } while (ret < 0 && errno == EINTR);
-   if (ret < 0) {
-      int err = errno;
-      close(sock);
-      throw ConnectionException(std::string("connect failed: ") +
-         std::strerror(err));
-   }
+bool TcpClientPort::Impl::startPort()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   m_running = true;
+   g.unlock();
 
-   if (!TcpEndpoint::init(sock, m_select)) {
-      throw ConnectionException("TcpEndpoint init failed");
+   m_loop->call(*this, &Impl::startIo);
+   if (!m_started) {
+      g.lock();
+      m_running = false;
    }
 
-   if (!initUpstream(m_subDomain)) {
-      throw ConnectionException("initUpstream failed");
+   return m_started;
+}
+
+void TcpClientPort::Impl::stopPort()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   m_running = false;
+   m_reconnectCondition.signal();
+   g.unlock();
+
+   // Also waits for a disconnect that might still be queued on the loop. A
+   // reconnect in progress is interrupted by this.
+   m_loop->call(*this, &Impl::stopIo);
+
+   if (m_reconnectThread.get() != NULL) {
+      m_reconnectThread->join();
+      m_reconnectThread.reset();
    }
 }
 
-bool TcpClientPort::Impl::sendPacket(std::auto_ptr<Packet> pkt)
+/**
+ * Queued by epDisconnected().
+ */
+void TcpClientPort::Impl::reactorRun()
 {
-   return epSendPacket(pkt);
+   tsd::common::system::MutexGuard g(m_lock);
+   m_disconnectPending = false;
+   g.unlock();
+
+   stopIo();
+
+   // only happens in reconnect mode
+   if (isSuspended()) {
+      startReconnect();
+   }
 }
 
-void TcpClientPort::Impl::epReceivedPacket(std::auto_ptr<Packet> pkt)
+void TcpClientPort::Impl::attachLoop()
 {
-   receivedPacket(pkt);
+   m_loop = Reactor::attach();
+   if (m_loop == NULL) {
+      throw ConnectionException("Selector init failed!");
+   }
 }
 
-void TcpClientPort::Impl::epDisconnected()
+/**
+ * Start watching the socket. Runs on the loop.
+ */
+void TcpClientPort::Impl::startIo()
 {
    tsd::common::system::MutexGuard g(m_lock);
-   m_log << tsd::common::logging::LogLevel::Warn
-         << "Peer disconnected!" << &std::endl;
-
-   // regardless of the context we hand this over to the io-thread
-   m_running = false;
+   bool running = m_running;
+   int sock = m_socket;
+   m_socket = -1;
    g.unlock();
 
-   m_select.interrupt();
+   if (!running) {
+      // stopped while reconnecting
+      close(sock);
+      m_started = false;
+      return;
+   }
+
+   m_started = TcpEndpoint::init(sock, m_loop->getSelect());
+   if (m_started) {
+      m_active = true;
+      connected();
+   } else {
+      m_log << tsd::common::logging::LogLevel::Error
+            << "TcpEndpoint init failed" << &std::endl;
+   }
 }
 
-bool TcpClientPort::Impl::startPort()
+/**
+ * Stop watching the socket. Runs on the loop.
+ */
+void TcpClientPort::Impl::stopIo()
 {
-   m_running = true;
-   start();
-   return true;
+   if (m_active) {
+      m_active = false;
+      detachSelect();
+      disconnected();
+   }
 }
 
-void TcpClientPort::Impl::stopPort()
+/**
+ * Drop the broken connection before reconnecting. Runs on the loop.
+ */
+void TcpClientPort::Impl::resetIo()
+{
+   stopIo();
+   TcpEndpoint::reset();
+}
+
+/**
+ * Final cleanup. Runs on the loop.
+ */
+void TcpClientPort::Impl::releaseIo()
+{
+   TcpEndpoint::cleanup();
+}
+
+/**
+ * Kick the reconnect thread. Runs on the loop.
+ */
+void TcpClientPort::Impl::startReconnect()
 {
    tsd::common::system::MutexGuard g(m_lock);
-   m_running = false;
+   if (!m_running) {
+      return;
+   }
+
+   if (m_reconnecting) {
+      // broke again while resuming, the thread keeps trying
+      return;
+   }
+
+   m_reconnecting = true;
+   std::auto_ptr<ReconnectThread> old(m_reconnectThread);
+   m_reconnectThread.reset(new ReconnectThread(*this));
    g.unlock();
-   m_select.interrupt();
-   join();
+
+   // has already finished
+   if (old.get() != NULL) {
+      old->join();
+   }
+
+   m_reconnectThread->start();
 }
 
-void TcpClientPort::Impl::run()
+/**
+ * Reconnect with exponential backoff until the port is resumed or stopped.
+ * Runs on the reconnect thread.
+ */
+void TcpClientPort::Impl::reconnect()
 {
-   connected();
+   uint32_t start = tsd::common::system::Clock::getTickCounter();
+   uint32_t backoff = m_minBackoff;
+   unsigned attempts = 0;
 
    tsd::common::system::MutexGuard g(m_lock);
-
    while (m_running) {
-      // dispatch and wait for interrupt
+      uint32_t deadline = tsd::common::system::Clock::getTickCounter() + backoff;
+      uint32_t now;
+      while (m_running && tsd::common::system::Clock::tickTimeBefore(
+                now = tsd::common::system::Clock::getTickCounter(), deadline)) {
+         m_reconnectCondition.wait(m_lock, deadline - now);
+      }
+      if (!m_running) {
+         break;
+      }
       g.unlock();
-      m_select.dispatch();
+
+      attempts++;
+      m_loop->call(*this, &Impl::resetIo);
+
+      bool resumed = false;
+      bool dead = false;
+      std::string error;
+      int sock = openSocket(error);
+      if (sock >= 0) {
+         g.lock();
+         m_socket = sock;
+         g.unlock();
+
+         m_loop->call(*this, &Impl::startIo);
+         if (m_started) {
+            resumed = resumeUpstream(m_subDomain);
+            dead = !resumed && !isSuspended();
+         }
+      } else {
+         m_log << tsd::common::logging::LogLevel::Debug
+               << "Reconnect failed: " << error << &std::endl;
+      }
+
       g.lock();
-   }
+      if (resumed) {
+         m_log << tsd::common::logging::LogLevel::Info
+               << "Reconnected after " << attempts << " attempts in "
+               << (tsd::common::system::Clock::getTickCounter() - start) << "ms"
+               << &std::endl;
+         break;
+      } else if (dead) {
+         m_log << tsd::common::logging::LogLevel::Error
+               << "Reconnect failed for good" << &std::endl;
+         g.unlock();
+         m_loop->call(*this, &Impl::stopIo);
+         g.lock();
+         break;
+      }
 
-   g.unlock();
+      backoff = (backoff > m_maxBackoff / 2u) ? m_maxBackoff : backoff * 2u;
+   }
 
-   disconnected();
+   m_reconnecting = false;
 }
 
 /*****************************************************************************/
@@ -283,6 +557,52 @@ void TcpClientPort::disconnect()
    m_p->disconnect();
 }
 
+uint64_t TcpClientPort::getDroppedPackets()
+{
+   return m_p->getDroppedPackets();
+}
+
+uint64_t TcpClientPort::getExpiredPackets()
+{
+   return m_p->getExpiredPackets();
+}
+
+tsd::communication::messaging::CompressionStats TcpClientPort::getCompressionStats()
+{
+   return m_p->getCompressionStats();
+}
+
+void TcpClientPort::setSendQueueLimit(uint32_t capacity, OverflowPolicy policy,
+                                      uint32_t blockTimeout)
+{
+   m_p->setSendQueueLimit(capacity, policy, blockTimeout);
+}
+
+void TcpClientPort::setZeroCopyThreshold(size_t threshold)
+{
+   m_p->setZeroCopyThreshold(threshold);
+}
+
+void TcpClientPort::setCompactHeaders(bool enable)
+{
+   m_p->setCompactHeaders(enable);
+}
+
+bool TcpClientPort::setCompression(size_t threshold, const std::string &codec)
+{
+   return m_p->setCompression(threshold, codec);
+}
+
+void TcpClientPort::setFragmentation(size_t fragmentSize, size_t reassemblyLimit)
+{
+   m_p->setFragmentation(fragmentSize, reassemblyLimit);
+}
+
+void TcpClientPort::setReconnect(uint32_t minBackoff, uint32_t maxBackoff)
+{
+   m_p->setReconnect(minBackoff, maxBackoff);
+}
+
 void TcpClientPort::initV4(uint32_t addr, uint16_t port, uint32_t sndBuf, uint32_t rcvBuf)
 {
    m_p->initV4(addr, port, sndBuf, rcvBuf);
@@ -4,6 +4,7 @@
 #include <netinet/in.h>
 
 #include <tsd/communication/messaging/Connection.hpp>
+#include <tsd/communication/messaging/types.hpp>
 
 namespace tsd { namespace communication { namespace messaging {
 
@@ -18,6 +19,48 @@ public:
    ~TcpClientPort();
 
    void disconnect(); // IConnection
+   uint64_t getDroppedPackets(); // IConnection
+   uint64_t getExpiredPackets(); // IConnection
+   CompressionStats getCompressionStats(); // IConnection
+
+   void setSendQueueLimit(uint32_t capacity, OverflowPolicy policy,
+                          uint32_t blockTimeout = 100);
+   void setZeroCopyThreshold(size_t threshold);
+
+   /**
+    * Switch to the compact packet header if the peer offers it. Must be
+    * called before initV4() or initUnix(). Disabled by default.
+    */
+   void setCompactHeaders(bool enable);
+
+   /**
+    * Compress payloads of at least @p threshold bytes if the peer enabled
+    * compression, too. Zero disables compression, which is the default. Must
+    * be called before initV4() or initUnix().
+    *
+    * @return False if the codec is unknown
+    */
+   bool setCompression(size_t threshold, const std::string &codec = "lz");
+
+   /**
+    * Send payloads of more than @p fragmentSize bytes in fragments if the
+    * peer can reassemble them, zero disables it. Incoming fragments are
+    * reassembled with at most @p reassemblyLimit bytes in progress. Must be
+    * called before initV4() or initUnix().
+    */
+   void setFragmentation(size_t fragmentSize, size_t reassemblyLimit);
+
+   /**
+    * Enable reconnect mode. Must be called before initV4() or initUnix().
+    *
+    * If the connection breaks the port is suspended instead of being torn
+    * down and a new connection is attempted after @p minBackoff ms. The delay
+    * is doubled after every failed attempt up to @p maxBackoff ms.
+    *
+    * @param minBackoff  Initial delay in ms, 0 disables reconnecting
+    * @param maxBackoff  Maximum delay in ms
+    */
+   void setReconnect(uint32_t minBackoff, uint32_t maxBackoff);
 
    void initV4(uint32_t addr = INADDR_LOOPBACK, uint16_t port = 24710,
                uint32_t sndBuf = 0, uint32_t rcvBuf = 0);
@@ -1,37 +1,64 @@
 #include <errno.h>
+#include <limits.h>
+#include <netinet/in.h>
 #include <sys/socket.h>
 #include <sys/uio.h>
 #include <unistd.h>
-#include <cstdlib>
+#include <algorithm>
 #include <cstring>
 
-#include <tsd/common/assert.hpp>
+#ifdef TARGET_OS_POSIX_LINUX
+#include <linux/errqueue.h>
+#endif
+
 #include <tsd/common/ipc/networkinteger.h>
+#include <tsd/common/system/Clock.hpp>
+#include <tsd/common/system/MutexGuard.hpp>
+#include <tsd/common/system/Thread.hpp>
 
 #include "Packet.hpp"
+#include "ReceiveSlab.hpp"
+#include "ShardedLock.hpp"
 #include "TcpEndpoint.hpp"
 
 using tsd::communication::messaging::TcpEndpoint;
 using tsd::common::ipc::NetworkInteger;
+using tsd::communication::messaging::CompactHeader;
+using tsd::communication::messaging::CompressionStats;
+using tsd::communication::messaging::HeaderFields;
+using tsd::communication::messaging::Packet;
+using tsd::communication::messaging::ReceiveSlab;
+using tsd::communication::messaging::SendChunk;
+
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
 
 namespace {
 
-   const ssize_t PARTIAL_PACKET_DONE = -1;
-   const ssize_t PARTIAL_PACKET_DISCONNECTED = -2;
+   /*
+    * Maximum number of IO vectors per writev(). Every packet needs two, one
+    * for the header and one for the payload.
+    */
+   const size_t MAX_IOV = (IOV_MAX < 1024) ? IOV_MAX : 1024;
 
-   template<typename T>
-   T readUnaligned(void *buf)
-   {
-      if (reinterpret_cast<uintptr_t>(buf) & (sizeof(T)-1)) {
-         // unaligned
-         T tmp;
-         std::memcpy(&tmp, buf, sizeof(T));
-         return tmp;
-      } else {
-         // aligned
-         return *(T*)buf;
-      }
-   }
+   /*
+    * Packets are only taken from the send lanes while less than this many
+    * bytes of the batch are unsent. Picked packets can not be overtaken by
+    * more urgent ones anymore.
+    */
+   const size_t MAX_BATCH_BYTES = 65536;
+
+   /*
+    * Minimum free space at the end of a receive slab that is worth another
+    * read(). Otherwise the next slab is started.
+    */
+   const size_t MIN_READ_SPACE = 1024;
+
+   /*
+    * Flags of the fixed header. Older peers send and ignore zero.
+    */
+   const uint8_t HEADER_CONFLATABLE = 1u;
 
    /**
     * Eat up IO vector by @p skip bytes.
@@ -51,6 +78,15 @@ namespace {
       }
    }
 
+   /**
+    * Only messages are subject to the send queue limit. Control packets must
+    * never be dropped or the routers would get out of sync.
+    */
+   bool isDataPacket(const Packet *pkt)
+   {
+      return Packet::isMessage(pkt->getType());
+   }
+
 }
 
 #define HEADER_SIZE  (  4 + /* msgLen */        \
@@ -58,7 +94,9 @@ namespace {
                         8 + /* senderAddr */    \
                         8 + /* receiverAddr */  \
                         1 + /* type */          \
-                        3   /* padding */       \
+                        1 + /* priority */      \
+                        1 + /* flags */         \
+                        1   /* padding */       \
                      )
 
 struct PacketHeader {
@@ -67,54 +105,165 @@ struct PacketHeader {
    NetworkInteger<uint64_t>   m_senderAddr;
    NetworkInteger<uint64_t>   m_receiverAddr;
    uint8_t                    m_type;
-   uint8_t                    m_padding[3];
+   uint8_t                    m_priority;    // MessagePriority + 1, zero from older peers
+   uint8_t                    m_flags;       // HEADER_CONFLATABLE, zero from older peers
+   uint8_t                    m_padding;
+};
+
+/*
+ * Scratch space of the thread that is flushing the send queue.
+ */
+struct TcpEndpoint::SendBatch {
+   struct iovec m_iov[MAX_IOV];
+   uint8_t m_hdr[MAX_IOV / 2][CompactHeader::MAX_SIZE];   // fixed or compact
+   size_t m_hdrLen[MAX_IOV / 2];
+   size_t m_num;
 };
 
 TcpEndpoint::TcpEndpoint(tsd::common::logging::Logger &log)
    : m_log(log)
    , m_socket(-1)
    , m_selectSource(NULL)
+   , m_sendQueuePackets(0)
    , m_sendOffset(0)
+   , m_flushing(false)
+   , m_writePending(false)
+   , m_batch(new SendBatch)
+   , m_zeroCopyThreshold(0)
+   , m_zeroCopy(false)
+   , m_zeroCopySeq(0)
+   , m_sendCapacity(tsd::communication::messaging::UNLIMITED_CAPACITY)
+   , m_overflowPolicy(tsd::communication::messaging::OVERFLOW_DROP_NEWEST)
+   , m_blockTimeout(0)
+   , m_blockedSenders(0)
+   , m_droppedPackets(0)
+   , m_ioThread(0)
+   , m_txMarkerQueued(false)
+   , m_txMarker(NULL)
+   , m_txCompact(false)
+   , m_fragmentSize(tsd::communication::messaging::DEFAULT_FRAGMENT_SIZE)
+   , m_txTimeToLive(false)
+   , m_slab(NULL)
+   , m_inPtr(0)
+   , m_outPtr(0)
+   , m_rxCompact(false)
    , m_alive(false)
 {
-   m_bufferSize = 32768;
-   m_buffer = static_cast<char*>(std::malloc(m_bufferSize));
-   ASSERT_FATAL(m_buffer != NULL, "Out of memory");
-   m_inPtr = m_outPtr = 0;
+   m_reassembler.setLimit(tsd::communication::messaging::DEFAULT_REASSEMBLY_LIMIT);
 }
 
 TcpEndpoint::~TcpEndpoint()
 {
    cleanup();
    while (!m_sendQueue.empty()) {
-      delete m_sendQueue.front();
+      if (m_sendQueue.front().isLast()) {
+         delete m_sendQueue.front().m_packet;
+      }
       m_sendQueue.pop_front();
    }
-   std::free(m_buffer);
+   while (!m_zeroCopyPending.empty()) {
+      delete m_zeroCopyPending.front().m_packet;
+      m_zeroCopyPending.pop_front();
+   }
+   delete m_batch;
+   if (m_slab != NULL) {
+      m_slab->deref();
+   }
 }
 
 bool TcpEndpoint::init(int fd, Select &selector)
 {
+   tsd::common::system::MutexGuard g(m_lock);
    m_socket = fd;
    m_alive = true;
+   m_ioThread = tsd::common::system::Thread::myself();
+
+   m_zeroCopy = false;
+   m_zeroCopySeq = 0;
+   if (m_zeroCopyThreshold > 0) {
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+      int one = 1;
+      m_zeroCopy = setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0;
+#endif
+      if (!m_zeroCopy) {
+         m_log << tsd::common::logging::LogLevel::Info
+               << "TcpEndpoint: MSG_ZEROCOPY not supported, using plain writes"
+               << &std::endl;
+      }
+   }
+   g.unlock();
+
    m_selectSource = selector.add(fd, this);
    return m_selectSource != NULL;
 }
 
-void TcpEndpoint::cleanup()
+/**
+ * Remove the socket from the Select. Must be called from the thread that
+ * dispatches the Select.
+ */
+void TcpEndpoint::detachSelect()
 {
-   m_alive = false;
-
    if (m_selectSource != NULL) {
       m_selectSource->dispose();
       m_selectSource = NULL;
    }
+}
+
+void TcpEndpoint::cleanup()
+{
+   m_alive = false;
+
+   detachSelect();
 
    if (m_socket != -1) {
       shutdown(m_socket, SHUT_RDWR);
       close(m_socket);
       m_socket = -1;
    }
+
+   // the kernel keeps its own page references after the socket is closed
+   tsd::common::system::MutexGuard g(m_lock);
+   while (!m_zeroCopyPending.empty()) {
+      delete m_zeroCopyPending.front().m_packet;
+      m_zeroCopyPending.pop_front();
+   }
+}
+
+/**
+ * Close the socket and forget everything that was in transit. Afterwards the
+ * endpoint can be initialized again with a new socket. Must be called from
+ * the thread that dispatches the Select while nobody is sending.
+ */
+void TcpEndpoint::reset()
+{
+   cleanup();
+
+   tsd::common::system::MutexGuard g(m_lock);
+   while (!m_sendQueue.empty()) {
+      if (m_sendQueue.front().isLast()) {
+         delete m_sendQueue.front().m_packet;
+      }
+      m_sendQueue.pop_front();
+   }
+   m_sendQueuePackets = 0;
+   m_sendLanes.clear();
+   m_sendLanes.setFragmentSize(0);
+   m_txTimeToLive = false;
+   m_sendOffset = 0;
+   m_writePending = false;
+   m_txMarkerQueued = false;
+   m_txMarker = NULL;
+   m_txCompact = false;
+   m_compressor.reset();
+
+   // received packets may still reference the slab
+   if (m_slab != NULL) {
+      m_slab->deref();
+      m_slab = NULL;
+   }
+   m_inPtr = m_outPtr = 0;
+   m_rxCompact = false;
+   m_reassembler.reset();
 }
 
 void TcpEndpoint::setDisconnected()
@@ -122,22 +271,75 @@ void TcpEndpoint::setDisconnected()
    tsd::common::system::MutexGuard g(m_lock);
    if (m_alive) {
       m_alive = false;
+      m_sendCondition.broadcast();
       g.unlock();
       epDisconnected();
    }
 }
 
+/**
+ * Make sure the slab has room for the partially received message at m_outPtr
+ * which needs @p pending bytes in total.
+ *
+ * Packets borrow their payload from the slab. The data is only moved if the
+ * message does not fit behind its current position. A slab that is still
+ * referenced by packets is never overwritten but replaced by a new one.
+ */
+void TcpEndpoint::prepareSlab(size_t pending)
+{
+   size_t partial = m_inPtr - m_outPtr;
+
+   if (m_slab != NULL) {
+      if (partial == 0 && !m_slab->isShared()) {
+         // everything consumed and no packet left behind
+         m_inPtr = m_outPtr = 0;
+         return;
+      }
+      if (m_outPtr + std::max(pending, partial + MIN_READ_SPACE) <= m_slab->getSize()) {
+         // continue behind the packets that were already dissected
+         return;
+      }
+      if (m_outPtr > 0 && pending <= m_slab->getSize() && !m_slab->isShared()) {
+         std::memmove(m_slab->getData(), m_slab->getData() + m_outPtr, partial);
+         m_inPtr = partial;
+         m_outPtr = 0;
+         return;
+      }
+   }
+
+   ReceiveSlab *slab = ReceiveSlab::allocate(pending);
+   if (partial > 0) {
+      std::memcpy(slab->getData(), m_slab->getData() + m_outPtr, partial);
+   }
+   if (m_slab != NULL) {
+      m_slab->deref();
+   }
+   m_slab = slab;
+   m_inPtr = partial;
+   m_outPtr = 0;
+}
+
 bool TcpEndpoint::selectReadable()
 {
    ssize_t len;
    bool didReceive, ret = true;
 
+   HeaderFields hdr;
+   size_t hdrLen;
+
    do {
       didReceive = false;
 
+      // make room for (at least) the next message
+      size_t pending = CompactHeader::MAX_SIZE;
+      if (m_slab != NULL && (hdrLen = parseHeader(hdr)) > 0) {
+         pending = hdrLen + hdr.m_msgLen;
+      }
+      prepareSlab(pending);
+
       // read new data
       do {
-         len = read(m_socket, &m_buffer[m_inPtr], m_bufferSize - m_inPtr);
+         len = read(m_socket, m_slab->getData() + m_inPtr, m_slab->getSize() - m_inPtr);
       } while (len < 0 && errno == EINTR);
 
       // check if remote end has disconnected
@@ -158,40 +360,20 @@ bool TcpEndpoint::selectReadable()
       }
 
       // dissect what we have
-      uint32_t msgLen = 0;
-      while (m_inPtr-m_outPtr >= sizeof(uint32_t)) {
-         msgLen = readUnaligned<uint32_t>(&m_buffer[m_outPtr]) + HEADER_SIZE; // FIXME: NetworkInteger
+      while ((hdrLen = parseHeader(hdr)) > 0) {
+         size_t msgLen = hdrLen + hdr.m_msgLen;
 
          // do we have a full message yet?
          if (m_inPtr-m_outPtr < msgLen)
             break;
 
-         received(&m_buffer[m_outPtr]);
+         if (!received(hdr, m_outPtr + hdrLen)) {
+            setDisconnected();
+            return false;
+         }
          m_outPtr += msgLen;
          didReceive = true;
       }
-
-      // allocate bigger buffer or, at least, move everything to front of buffer
-      if (msgLen > m_bufferSize) {
-         // reallocate buffer because it's too small
-         while (m_bufferSize < msgLen)
-            m_bufferSize *= 2;
-
-         char *newBuffer = static_cast<char*>(std::malloc(m_bufferSize));
-         ASSERT_FATAL(newBuffer != NULL, "Out of memory");
-         std::memcpy(newBuffer, &m_buffer[m_outPtr], m_inPtr-m_outPtr);
-         std::free(m_buffer);
-         m_buffer = newBuffer;
-         m_inPtr -= m_outPtr;
-         m_outPtr = 0;
-      } else if (m_outPtr == m_inPtr) {
-         m_outPtr = m_inPtr = 0;
-      } else if (m_outPtr > 0) {
-         // move to the front
-         std::memmove(m_buffer, &m_buffer[m_outPtr], m_inPtr-m_outPtr);
-         m_inPtr -= m_outPtr;
-         m_outPtr = 0;
-      }
    } while (len > 0 || didReceive);
 
    return ret;
@@ -202,21 +384,13 @@ bool TcpEndpoint::selectWritable()
    bool ret = true;
    tsd::common::system::MutexGuard g(m_lock);
 
-   while (!m_sendQueue.empty()) {
-      Packet *pkt = m_sendQueue.front();
-      ssize_t offset = sendPartialPacket(pkt, m_sendOffset);
-      if (offset == PARTIAL_PACKET_DONE) {
-         delete pkt;
-         m_sendQueue.pop_front();
-         m_sendOffset = 0;
-      } else if (offset == PARTIAL_PACKET_DISCONNECTED) {
-         g.unlock();
-         setDisconnected();
-         ret = false;
-      } else {
-         m_sendOffset = offset;
-         break;
-      }
+   // see admitPacket()
+   m_ioThread = tsd::common::system::Thread::myself();
+
+   if (!flushSendQueue(g)) {
+      g.unlock();
+      setDisconnected();
+      ret = false;
    }
 
    return ret;
@@ -224,6 +398,17 @@ bool TcpEndpoint::selectWritable()
 
 bool TcpEndpoint::selectError()
 {
+   if (m_zeroCopy) {
+      // MSG_ZEROCOPY completions are reported through the error queue
+      reapZeroCopy();
+
+      int err = 0;
+      socklen_t len = sizeof(err);
+      if (getsockopt(m_socket, SOL_SOCKET, SO_ERROR, &err, &len) == 0 && err == 0) {
+         return true;
+      }
+   }
+
    m_log << tsd::common::logging::LogLevel::Warn
          << "TcpEndpoint: socket error state!"
          << std::endl;
@@ -235,81 +420,243 @@ bool TcpEndpoint::selectError()
 bool TcpEndpoint::epSendPacket(std::auto_ptr<Packet> pkt)
 {
    bool ret = true;
+   if (pkt.get() == NULL) {
+      return ret;
+   }
+
+   // outside of the lock, other senders keep going meanwhile
+   pkt = m_compressor.compress(pkt);
+
    tsd::common::system::MutexGuard g(m_lock);
 
-   if (m_sendQueue.empty()) {
-      ssize_t offset = sendPartialPacket(pkt.get(), 0);
-      if (offset >= 0) {
-         // The socket was full. This will trigger a selectWritable() once
-         // there is enough room.
-         m_sendQueue.push_back(pkt.release());
-         m_sendOffset = offset;
-      } else if (offset == PARTIAL_PACKET_DISCONNECTED) {
-         g.unlock();
-         setDisconnected();
-         ret = false;
-      }
-   } else {
-      m_sendQueue.push_back(pkt.release());
+   if (pkt->isConflatable() && m_sendLanes.replace(pkt.get())) {
+      pkt.release();
+      return ret;
+   }
+
+   if (getQueuedPackets() > 0 && !admitPacket(pkt.get())) {
+      m_log << tsd::common::logging::LogLevel::Debug
+            << "TcpEndpoint: send queue full, packet dropped" << &std::endl;
+      return ret;
+   }
+
+   /*
+    * If the queue is empty the socket has room and we write directly.
+    * Otherwise the packet is picked up by whoever is flushing the queue right
+    * now or by selectWritable() once the socket drained.
+    */
+   bool idle = getQueuedPackets() == 0 && !m_flushing;
+   m_sendLanes.push(pkt.release());
+   if (idle && !flushSendQueue(g)) {
+      g.unlock();
+      setDisconnected();
+      ret = false;
    }
 
    return ret;
 }
 
-void TcpEndpoint::received(const char *buffer)
+/**
+ * Write as many queued packets as the socket takes.
+ *
+ * Must be called with m_lock held through @p g. Only one thread flushes at a
+ * time. The lock is dropped while writing so that other senders can queue
+ * their packets in the meantime. They are written with the next batch,
+ * which coalesces small messages into a single writev().
+ *
+ * @return False if the connection broke
+ */
+bool TcpEndpoint::flushSendQueue(tsd::common::system::MutexGuard &g)
 {
-   const PacketHeader *hdr = reinterpret_cast<const PacketHeader *>(buffer);
-   Packet *pkt = new Packet(static_cast<tsd::communication::messaging::Packet::Type>(hdr->m_type),
-                            hdr->m_senderAddr, hdr->m_receiverAddr,
-                            hdr->m_eventId, buffer + HEADER_SIZE,
-                            hdr->m_msgLen);
+   if (m_flushing) {
+      // make the current flusher try again
+      m_writePending = true;
+      return true;
+   }
+
+   bool ret = true;
+   m_flushing = true;
+
+   do {
+      m_writePending = false;
+
+      while (ret && getQueuedPackets() > 0) {
+         if (!m_alive) {
+            // drop packets
+            while (!m_sendQueue.empty()) {
+               if (m_sendQueue.front().isLast()) {
+                  delete m_sendQueue.front().m_packet;
+               }
+               m_sendQueue.pop_front();
+            }
+            m_sendQueuePackets = 0;
+            m_sendLanes.clear();
+            m_sendOffset = 0;
+            m_txMarker = NULL;
+            break;
+         }
+
+         size_t iovcnt = 0;
+         bool zeroCopy = false;
+         size_t pending = prepareBatch(iovcnt, zeroCopy);
+         uint32_t calls = 0;
 
-   epReceivedPacket(std::auto_ptr<Packet>(pkt));
+         g.unlock();
+         ssize_t written = writeBatch(iovcnt, zeroCopy, calls);
+         g.lock();
+
+         m_zeroCopySeq += calls;
+         if (written < 0) {
+            ret = false;
+         } else {
+            completeBatch(static_cast<size_t>(written), zeroCopy);
+            if (static_cast<size_t>(written) < pending) {
+               // socket is full, selectWritable() will continue
+               break;
+            }
+         }
+      }
+   } while (ret && m_writePending);
+
+   m_flushing = false;
+   return ret;
 }
 
-ssize_t TcpEndpoint::sendPartialPacket(Packet *pkt, size_t offset)
+/**
+ * Gather chunks from the head of the send queue into m_batch.
+ *
+ * Must be called with m_lock held. Chunks that are left over from the
+ * previous batch go first, the rest is taken from m_sendLanes until
+ * MAX_BATCH_BYTES are pending. Once a chunk was picked its position on the
+ * wire is fixed. Expired messages are dropped before they are picked.
+ *
+ * Chunks of packets with a payload of at least m_zeroCopyThreshold bytes are
+ * sent on their own with MSG_ZEROCOPY if the socket supports it.
+ *
+ * @return Number of bytes in the batch that are not sent yet
+ */
+size_t TcpEndpoint::prepareBatch(size_t &iovcnt, bool &zeroCopy)
 {
-   if (!m_alive) {
-      // drop packet
-      return PARTIAL_PACKET_DONE;
-   }
-
-   // construct IOV
-   struct iovec iov[2];
-   int iovcnt = 0;
-
-   PacketHeader hdr;
-   std::memset(&hdr, 0, sizeof(hdr));
-   hdr.m_msgLen = static_cast<uint32_t>(pkt->getBufferLength());
-   hdr.m_eventId = pkt->getEventId();
-   hdr.m_senderAddr = pkt->getSenderAddr();
-   hdr.m_receiverAddr = pkt->getReceiverAddr();
-   hdr.m_type = pkt->getType();
-   iov[iovcnt].iov_base = &hdr;
-   iov[iovcnt].iov_len  = HEADER_SIZE;
-   iovcnt++;
-
-   if (pkt->getBufferLength() > 0) {
-      iov[iovcnt].iov_base = pkt->getBufferPtr();
-      iov[iovcnt].iov_len  = pkt->getBufferLength();
+   size_t num = 0;
+   size_t bytes = 0;
+   bool compact = m_txCompact;
+   uint32_t now = tsd::common::system::Clock::getTickCounter();
+
+   iovcnt = 0;
+   zeroCopy = false;
+
+   while (num < MAX_IOV / 2) {
+      if (num == m_sendQueue.size()) {
+         if (bytes >= m_sendOffset + MAX_BATCH_BYTES) {
+            break;
+         }
+         SendChunk next;
+         if (!m_sendLanes.pop(next, now)) {
+            break;
+         }
+         if (!m_txTimeToLive) {
+            // decided once, leftovers of a batch must get the same header again
+            next.m_timeToLive = 0;
+         }
+         m_sendQueue.push_back(next);
+         if (next.isLast()) {
+            m_sendQueuePackets++;
+         }
+      }
+
+      const SendChunk &chunk = m_sendQueue[num];
+      Packet *pkt = chunk.m_packet;
+      bool large = m_zeroCopy && pkt->getBufferLength() >= m_zeroCopyThreshold;
+      if (large && num > 0) {
+         break;
+      }
+
+      uint8_t *hdrBuf = m_batch->m_hdr[num];
+      size_t hdrLen;
+      if (compact) {
+         hdrLen = m_txHeader.encode(hdrBuf, *pkt, chunk.m_length, chunk.m_fragment,
+                                    chunk.m_timeToLive);
+      } else {
+         // fragments are only sent behind the marker
+         PacketHeader hdr;
+         std::memset(&hdr, 0, sizeof(hdr));
+         hdr.m_msgLen = static_cast<uint32_t>(pkt->getBufferLength());
+         hdr.m_eventId = pkt->getEventId();
+         hdr.m_senderAddr = pkt->getSenderAddr();
+         hdr.m_receiverAddr = pkt->getReceiverAddr();
+         hdr.m_type = pkt->getType();
+         hdr.m_priority = static_cast<uint8_t>(pkt->getPriority() + 1);
+         hdr.m_flags = pkt->isConflatable() ? HEADER_CONFLATABLE : 0u;
+         std::memcpy(hdrBuf, &hdr, HEADER_SIZE);
+         hdrLen = HEADER_SIZE;
+
+         // the marker is the last packet with a fixed header
+         compact = pkt == m_txMarker;
+      }
+      m_batch->m_hdrLen[num] = hdrLen;
+      m_batch->m_iov[iovcnt].iov_base = hdrBuf;
+      m_batch->m_iov[iovcnt].iov_len  = hdrLen;
       iovcnt++;
+
+      if (chunk.m_length > 0) {
+         m_batch->m_iov[iovcnt].iov_base = pkt->getBufferPtr() + chunk.m_offset;
+         m_batch->m_iov[iovcnt].iov_len  = chunk.m_length;
+         iovcnt++;
+      }
+
+      bytes += hdrLen + chunk.m_length;
+      num++;
+
+      if (large) {
+         zeroCopy = true;
+         break;
+      }
    }
 
+   m_batch->m_num = num;
+   return bytes - m_sendOffset;
+}
+
+/**
+ * Put the prepared batch into the socket.
+ *
+ * Called without m_lock. The chunks of the batch stay in m_sendQueue which
+ * the senders never touch.
+ *
+ * @return Number of bytes written or -1 if the connection broke
+ */
+ssize_t TcpEndpoint::writeBatch(size_t iovcnt, bool zeroCopy, uint32_t &calls)
+{
    // skip already sent data
-   struct iovec *pending_iov = iov;
-   int pending_num = iovcnt;
-   advanceIOV(pending_iov, pending_num, offset);
+   struct iovec *pending_iov = m_batch->m_iov;
+   int pending_num = static_cast<int>(iovcnt);
+   advanceIOV(pending_iov, pending_num, m_sendOffset);
 
    // put as much data into the socket as possible
+   size_t total = 0;
    ssize_t written;
    do {
       do {
-         written = writev(m_socket, pending_iov, pending_num);
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+         if (zeroCopy) {
+            struct msghdr msg;
+            std::memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = pending_iov;
+            msg.msg_iovlen = pending_num;
+            written = sendmsg(m_socket, &msg, MSG_ZEROCOPY);
+         } else
+#endif
+         {
+            written = writev(m_socket, pending_iov, pending_num);
+         }
       } while (written < 0 && errno == EINTR);
 
       if (written > 0) {
          advanceIOV(pending_iov, pending_num, written);
-         offset += written;
+         total += written;
+         if (zeroCopy) {
+            calls++;
+         }
       }
    } while (written > 0 && pending_num > 0);
 
@@ -318,9 +665,395 @@ ssize_t TcpEndpoint::sendPartialPacket(Packet *pkt, size_t offset)
       m_log << tsd::common::logging::LogLevel::Warn
             << "TcpEndpoint write failed: " << std::strerror(err)
             << std::endl;
-      return PARTIAL_PACKET_DISCONNECTED;
+      return -1;
+   }
+
+   return static_cast<ssize_t>(total);
+}
+
+/**
+ * Release the packets whose last chunk was written completely.
+ *
+ * Must be called with m_lock held. Packets that were sent with MSG_ZEROCOPY
+ * are kept until the kernel has released their buffers. This includes
+ * packets of which only earlier chunks went out with MSG_ZEROCOPY.
+ */
+void TcpEndpoint::completeBatch(size_t written, bool zeroCopy)
+{
+   size_t done = m_sendOffset + written;
+   bool released = false;
+
+   for (size_t i = 0; i < m_batch->m_num; i++) {
+      SendChunk chunk = m_sendQueue.front();
+      Packet *pkt = chunk.m_packet;
+      size_t len = m_batch->m_hdrLen[i] + chunk.m_length;
+      if (done < len) {
+         break;
+      }
+
+      done -= len;
+      m_sendQueue.pop_front();
+      if (chunk.isLast()) {
+         m_sendQueuePackets--;
+      }
+
+      if (pkt == m_txMarker) {
+         m_txCompact = true;
+         m_txMarker = NULL;
+      }
+
+      if (zeroCopy || (chunk.isLast() && !m_zeroCopyPending.empty())) {
+         ZeroCopyPacket zc;
+         zc.m_packet = chunk.isLast() ? pkt : NULL;
+         zc.m_seq = m_zeroCopySeq - 1u;
+         m_zeroCopyPending.push_back(zc);
+      } else if (chunk.isLast()) {
+         delete pkt;
+      }
+      released = released || chunk.isLast();
+   }
+
+   m_sendOffset = done;
+   if (released && m_blockedSenders > 0) {
+      m_sendCondition.broadcast();
+   }
+}
+
+/**
+ * Free packets whose MSG_ZEROCOPY transmission has completed.
+ *
+ * TCP reports the completions in order. Every notification covers a range
+ * of send calls and releases all packets up to its upper bound.
+ */
+void TcpEndpoint::reapZeroCopy()
+{
+#if defined(SO_EE_ORIGIN_ZEROCOPY)
+   for (;;) {
+      char control[128];
+      struct msghdr msg;
+      std::memset(&msg, 0, sizeof(msg));
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+
+      ssize_t ret;
+      do {
+         ret = recvmsg(m_socket, &msg, MSG_ERRQUEUE);
+      } while (ret < 0 && errno == EINTR);
+
+      if (ret < 0) {
+         break;
+      }
+
+      for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+         if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+             !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+            continue;
+         }
+
+         const struct sock_extended_err *serr =
+            reinterpret_cast<const struct sock_extended_err *>(CMSG_DATA(cm));
+         if (serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+            continue;
+         }
+
+         tsd::common::system::MutexGuard g(m_lock);
+         while (!m_zeroCopyPending.empty() &&
+                static_cast<int32_t>(m_zeroCopyPending.front().m_seq - serr->ee_data) <= 0) {
+            delete m_zeroCopyPending.front().m_packet;
+            m_zeroCopyPending.pop_front();
+         }
+      }
+   }
+#endif
+}
+
+/**
+ * Make room in the send queue for a new packet.
+ *
+ * Must be called with m_lock held. Applies the overflow policy if the send
+ * queue is full. Only m_sendLanes is touched, the packets in m_sendQueue
+ * might be sent partially already or are written right now. Senders are
+ * never blocked on the io-thread because only the io-thread can drain the
+ * queue. Senders that hold a router lock are not blocked either.
+ *
+ * @return True if the packet should be queued, false if it must be dropped.
+ */
+bool TcpEndpoint::admitPacket(const Packet *pkt)
+{
+   if (m_sendCapacity == UNLIMITED_CAPACITY || getQueuedPackets() < m_sendCapacity ||
+       !isDataPacket(pkt)) {
+      return true;
+   }
+
+   switch (m_overflowPolicy) {
+      case OVERFLOW_BLOCK:
+         if (m_ioThread != tsd::common::system::Thread::myself() &&
+             !ShardedLock::isHeldByCurrentThread() && waitForSpace()) {
+            return true;
+         }
+         break;
+
+      case OVERFLOW_DROP_OLDEST:
+         if (m_sendLanes.dropOldest()) {
+            m_droppedPackets++;
+            return true;
+         }
+         break;
+
+      case OVERFLOW_COALESCE:
+         if (m_sendLanes.dropMatching(pkt)) {
+            m_droppedPackets++;
+            return true;
+         }
+         break;
+
+      case OVERFLOW_DROP_NEWEST:
+         break;
+   }
+
+   m_droppedPackets++;
+   return false;
+}
+
+/**
+ * Block the sender until the send queue has room or the connection is gone.
+ *
+ * @return True if the packet can be queued, false if m_blockTimeout passed.
+ */
+bool TcpEndpoint::waitForSpace()
+{
+   uint32_t timeout = m_blockTimeout;
+   uint32_t startTime = tsd::common::system::Clock::getTickCounter();
+
+   m_blockedSenders++;
+   while (m_alive && m_sendCapacity != UNLIMITED_CAPACITY &&
+          getQueuedPackets() >= m_sendCapacity && timeout) {
+      m_sendCondition.wait(m_lock, timeout);
+
+      uint32_t endTime = tsd::common::system::Clock::getTickCounter();
+      uint32_t elapsed = endTime - startTime;
+      startTime = endTime;
+      timeout = (elapsed >= timeout) ? 0 : timeout - elapsed;
+   }
+   m_blockedSenders--;
+
+   return !m_alive || m_sendCapacity == UNLIMITED_CAPACITY ||
+          getQueuedPackets() < m_sendCapacity;
+}
+
+void TcpEndpoint::setSendQueueLimit(uint32_t capacity, OverflowPolicy policy,
+                                    uint32_t blockTimeout)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   m_sendCapacity = capacity;
+   m_overflowPolicy = policy;
+   m_blockTimeout = std::min(blockTimeout, MAX_BLOCK_TIMEOUT);
+   if (m_blockedSenders > 0) {
+      m_sendCondition.broadcast();
+   }
+}
+
+/**
+ * Send packets with at least @p threshold bytes of payload with MSG_ZEROCOPY.
+ *
+ * Zero means never. Takes effect with the next init() and is silently
+ * ignored if the socket does not support it.
+ */
+void TcpEndpoint::setZeroCopyThreshold(size_t threshold)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   m_zeroCopyThreshold = threshold;
+}
+
+uint64_t TcpEndpoint::getDroppedPackets()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   return m_droppedPackets;
+}
+
+uint64_t TcpEndpoint::getExpiredPackets()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   return m_sendLanes.getExpired();
+}
+
+/**
+ * Compress payloads of at least @p threshold bytes, see PacketCompressor.
+ * Must be called before init().
+ *
+ * @return False if the codec is unknown
+ */
+bool TcpEndpoint::setCompression(size_t threshold, const std::string &codec)
+{
+   return m_compressor.configure(threshold, codec);
+}
+
+CompressionStats TcpEndpoint::getCompressionStats()
+{
+   return m_compressor.getStats();
+}
+
+/**
+ * Send payloads of more than @p fragmentSize bytes in fragments of that size
+ * so that other messages can be sent in between. Zero disables it. Only
+ * effective with the compact header and if the peer can reassemble them.
+ * Incoming fragments are reassembled with at most @p reassemblyLimit bytes
+ * of packets in progress. Must be called before init().
+ */
+void TcpEndpoint::setFragmentation(size_t fragmentSize, size_t reassemblyLimit)
+{
+   m_fragmentSize = static_cast<uint32_t>(fragmentSize);
+   m_reassembler.setLimit(reassemblyLimit);
+}
+
+/**
+ * Switch to the compact header after the peer's marker.
+ *
+ * Everything that is queued behind the marker is sent with the compact
+ * header. Only the first call has an effect.
+ */
+void TcpEndpoint::sendCompactMarker(const CompactHeader &header)
+{
+   CompactHeader marker(header);
+   marker.setCodecs(m_compressor.getLocalCodecs());
+   marker.setFeatures(CompactHeader::FEATURE_FRAGMENTS | CompactHeader::FEATURE_TIME_TO_LIVE);
+   std::auto_ptr<Packet> pkt(marker.createMarker());
+
+   tsd::common::system::MutexGuard g(m_lock);
+   if (m_txMarkerQueued) {
+      return;
+   }
+   m_txMarkerQueued = true;
+   m_txMarker = pkt.get();
+   m_txHeader = header;
+   g.unlock();
+
+   epSendPacket(pkt);
+}
+
+/**
+ * Parse the header of the next message at m_outPtr.
+ *
+ * @return Size of the header or 0 if it was not received completely
+ */
+size_t TcpEndpoint::parseHeader(HeaderFields &hdr)
+{
+   const uint8_t *buf = reinterpret_cast<const uint8_t *>(m_slab->getData() + m_outPtr);
+   size_t len = m_inPtr - m_outPtr;
+
+   if (m_rxCompact) {
+      return m_rxHeader.decode(buf, len, hdr);
+   }
+
+   if (len < HEADER_SIZE) {
+      return 0;
+   }
+
+   PacketHeader fixed;
+   std::memcpy(&fixed, buf, HEADER_SIZE);
+   hdr.m_msgLen = fixed.m_msgLen;
+   hdr.m_eventId = fixed.m_eventId;
+   hdr.m_senderAddr = fixed.m_senderAddr;
+   hdr.m_receiverAddr = fixed.m_receiverAddr;
+   hdr.m_type = fixed.m_type;
+   hdr.m_codec = 0;
+   hdr.m_priority = fixed.m_priority != 0 ? fixed.m_priority - 1u : static_cast<unsigned>(PRIORITY_NORMAL);
+   hdr.m_fragment = 0;
+   hdr.m_totalLen = 0;
+   hdr.m_timeToLive = 0;
+   hdr.m_conflatable = (fixed.m_flags & HEADER_CONFLATABLE) != 0;
+
+   return HEADER_SIZE;
+}
+
+/**
+ * Process a complete message or fragment. The payload starts at @p offset in
+ * the slab.
+ *
+ * @return False if the peer violated the protocol
+ */
+bool TcpEndpoint::received(HeaderFields &hdr, size_t offset)
+{
+   if (hdr.m_fragment == 0) {
+      return deliver(hdr, m_slab, offset);
+   }
+
+   ReceiveSlab *slab;
+   if (!m_reassembler.add(hdr, m_slab->getData() + offset, slab)) {
+      m_log << tsd::common::logging::LogLevel::Warn
+            << "TcpEndpoint: unexpected fragment" << &std::endl;
+      return false;
+   }
+   if (slab == NULL) {
+      // more to come or dropped because of the reassembly limit
+      return true;
+   }
+
+   bool ret = deliver(hdr, slab, 0);
+   slab->deref();
+   return ret;
+}
+
+/**
+ * Pass a complete message up. The payload starts at @p offset in @p slab.
+ *
+ * @return False if the peer violated the protocol
+ */
+bool TcpEndpoint::deliver(const HeaderFields &hdr, ReceiveSlab *slab, size_t offset)
+{
+   std::auto_ptr<Packet> pkt;
+   if (hdr.m_codec != 0) {
+      pkt = m_compressor.decompress(hdr, slab->getData() + offset);
+      if (pkt.get() == NULL) {
+         m_log << tsd::common::logging::LogLevel::Warn
+               << "TcpEndpoint: corrupt compressed packet" << &std::endl;
+         return false;
+      }
+   } else {
+      pkt.reset(new Packet(static_cast<tsd::communication::messaging::Packet::Type>(hdr.m_type),
+                           hdr.m_senderAddr, hdr.m_receiverAddr,
+                           hdr.m_eventId, slab, offset,
+                           hdr.m_msgLen));
+   }
+   pkt->setPriority(static_cast<MessagePriority>(hdr.m_priority));
+   pkt->setConflatable(hdr.m_conflatable);
+   if (hdr.m_timeToLive != 0) {
+      pkt->setDeadline(Packet::makeDeadline(tsd::common::system::Clock::getTickCounter(),
+                                            hdr.m_timeToLive));
+   }
+
+   if (pkt->getType() == Packet::COMPACT_HEADER) {
+      return receivedMarker(*pkt);
    }
 
-   return (pending_num > 0) ? offset : PARTIAL_PACKET_DONE;
+   epReceivedPacket(pkt);
+   return true;
 }
 
+/**
+ * The peer switched to the compact header. Answer with our own marker unless
+ * we started the negotiation.
+ */
+bool TcpEndpoint::receivedMarker(Packet &pkt)
+{
+   if (m_rxCompact || !m_rxHeader.parseMarker(pkt)) {
+      m_log << tsd::common::logging::LogLevel::Warn
+            << "TcpEndpoint: invalid compact header marker" << &std::endl;
+      return false;
+   }
+
+   m_rxCompact = true;
+   sendCompactMarker(m_rxHeader.reverse());
+
+   // our marker is queued, everything behind it may be compressed...
+   m_compressor.setPeerCodecs(m_rxHeader.getCodecs());
+
+   // ...fragmented and carry the time to live
+   tsd::common::system::MutexGuard g(m_lock);
+   if (m_rxHeader.getFeatures() & CompactHeader::FEATURE_FRAGMENTS) {
+      m_sendLanes.setFragmentSize(m_fragmentSize);
+   }
+   m_txTimeToLive = (m_rxHeader.getFeatures() & CompactHeader::FEATURE_TIME_TO_LIVE) != 0;
+   return true;
+}
@@ -5,20 +5,51 @@
 #include <memory>
 
 #include <tsd/common/logging/Logger.hpp>
+#include <tsd/common/system/CondVar.hpp>
 #include <tsd/common/system/Mutex.hpp>
+#include <tsd/common/system/MutexGuard.hpp>
+#include <tsd/common/types/typedef.hpp>
+#include <tsd/communication/messaging/types.hpp>
 
+#include "CompactHeader.hpp"
+#include "PacketCompressor.hpp"
+#include "PacketReassembler.hpp"
 #include "Select.hpp"
+#include "SendScheduler.hpp"
 
 namespace tsd { namespace communication { namespace messaging {
 
 class Packet;
+class ReceiveSlab;
 
 class TcpEndpoint
    : private ISelectEventHandler
 {
-   void received(const char *buffer);
-   ssize_t sendPartialPacket(Packet *pkt, size_t offset);
+   struct SendBatch;
+
+   struct ZeroCopyPacket {
+      Packet *m_packet;
+      uint32_t m_seq;         // last notification ID that references the packet
+   };
+
+   size_t parseHeader(HeaderFields &hdr);
+   bool received(HeaderFields &hdr, size_t offset);
+   bool deliver(const HeaderFields &hdr, ReceiveSlab *slab, size_t offset);
+   bool receivedMarker(Packet &pkt);
+   void prepareSlab(size_t pending);
+   bool flushSendQueue(tsd::common::system::MutexGuard &g);
+   size_t prepareBatch(size_t &iovcnt, bool &zeroCopy);
+   ssize_t writeBatch(size_t iovcnt, bool zeroCopy, uint32_t &calls);
+   void completeBatch(size_t written, bool zeroCopy);
+   void reapZeroCopy();
    void setDisconnected();
+   bool admitPacket(const Packet *pkt);
+   bool waitForSpace();
+
+   inline size_t getQueuedPackets() const
+   {
+      return m_sendQueuePackets + m_sendLanes.size();
+   }
 
    bool selectReadable();  // ISelectEventHandler
    bool selectWritable();  // ISelectEventHandler
@@ -28,18 +59,44 @@ class TcpEndpoint
    int m_socket;
    SelectSource* m_selectSource;
    tsd::common::system::Mutex m_lock;
-   std::deque<Packet*> m_sendQueue;
+   tsd::common::system::CondVar m_sendCondition;
+   std::deque<SendChunk> m_sendQueue;   // picked from m_sendLanes, in wire order
+   size_t m_sendQueuePackets;          // last chunks in m_sendQueue
+   SendScheduler m_sendLanes;
    size_t m_sendOffset;
+   bool m_flushing;
+   bool m_writePending;
+   SendBatch *m_batch;
+   size_t m_zeroCopyThreshold;
+   bool m_zeroCopy;
+   uint32_t m_zeroCopySeq;
+   std::deque<ZeroCopyPacket> m_zeroCopyPending;
+   uint32_t m_sendCapacity;
+   OverflowPolicy m_overflowPolicy;
+   uint32_t m_blockTimeout;
+   uint32_t m_blockedSenders;
+   uint64_t m_droppedPackets;
+   thread_id_t m_ioThread;
+   CompactHeader m_txHeader;
+   bool m_txMarkerQueued;     // everything behind the marker is compact
+   Packet *m_txMarker;        // queued marker, NULL once it was sent
+   bool m_txCompact;          // marker was sent completely
+   PacketCompressor m_compressor;
+   uint32_t m_fragmentSize;
+   bool m_txTimeToLive;       // peer decodes the time to live of messages
 
-   char *m_buffer;
-   uint32_t m_bufferSize;
+   ReceiveSlab *m_slab;
    size_t m_inPtr;
    size_t m_outPtr;
+   CompactHeader m_rxHeader;
+   bool m_rxCompact;
+   PacketReassembler m_reassembler;
 
    bool m_alive;
 
 protected:
    bool epSendPacket(std::auto_ptr<Packet> pkt);
+   void sendCompactMarker(const CompactHeader &header);
    virtual void epReceivedPacket(std::auto_ptr<Packet> pkt) = 0;
    virtual void epDisconnected() = 0;
 
@@ -48,7 +105,17 @@ public:
    virtual ~TcpEndpoint();
 
    bool init(int fd, Select &selector);
+   void detachSelect();
    void cleanup();
+   void reset();
+
+   void setSendQueueLimit(uint32_t capacity, OverflowPolicy policy, uint32_t blockTimeout);
+   void setZeroCopyThreshold(size_t threshold);
+   bool setCompression(size_t threshold, const std::string &codec);
+   void setFragmentation(size_t fragmentSize, size_t reassemblyLimit);
+   uint64_t getDroppedPackets();
+   uint64_t getExpiredPackets();
+   CompressionStats getCompressionStats();
 };
 
 } } }
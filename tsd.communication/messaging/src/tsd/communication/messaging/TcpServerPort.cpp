@@ -12,15 +12,17 @@
 #include <sys/types.h>
 #include <sys/un.h>
 #include <unistd.h>
+#include <vector>
 
 #include <tsd/common/assert.hpp>
 #include <tsd/common/logging/Logger.hpp>
 #include <tsd/common/system/Mutex.hpp>
-#include <tsd/common/system/Thread.hpp>
 #include <tsd/communication/messaging/ConnectionException.hpp>
 
 #include "IPort.hpp"
 #include "Packet.hpp"
+#include "PayloadCodec.hpp"
+#include "Reactor.hpp"
 #include "Router.hpp"
 #include "Select.hpp"
 #include "SocketHelper.hpp"
@@ -40,8 +42,9 @@ namespace {
 namespace tsd { namespace communication { namespace messaging {
 
    class TcpServerPort::Impl
-      : private tsd::common::system::Thread
    {
+      class Shard;
+
       class ListenSocket
          : public ISelectEventHandler
       {
@@ -76,7 +79,7 @@ namespace tsd { namespace communication { namespace messaging {
          : public TcpEndpoint
          , public IPort
       {
-         TcpServerPort::Impl &m_server;
+         Shard &m_shard;
 
       protected:
          void epReceivedPacket(std::auto_ptr<Packet> pkt);  // TcpEndpoint
@@ -86,30 +89,91 @@ namespace tsd { namespace communication { namespace messaging {
          void stopPort();  // IPort
 
       public:
-         Client(TcpServerPort::Impl &server);
+         Client(Shard &shard);
          ~Client();
 
          bool init(int fd, Select &selector);
          bool sendPacket(std::auto_ptr<Packet> pkt);  // IPort
+         using IPort::setCompactHeaders;
       };
 
-      void addClient(int fd);
-      void delClient(Client *client);
+      /**
+       * The clients of the server on one loop of the Reactor.
+       *
+       * Every client is served by exactly one loop for its whole lifetime.
+       * New clients are handed over through m_pendingAdds because the Select
+       * of the loop must only be touched by the loop thread itself.
+       */
+      class Shard
+         : private IReactorTask
+      {
+         typedef std::set<Client*> ClientList;
+         typedef std::deque<Client*> ClientQueue;
+         typedef std::deque<int> FdQueue;
+
+         TcpServerPort::Impl &m_server;
+         ReactorLoop &m_loop;
+         bool m_running;
+         bool m_scheduled;
+         ClientList m_clients;
+         FdQueue m_pendingAdds;
+         ClientQueue m_pendingDeletes;
+         tsd::common::system::Mutex m_lock;
+         uint64_t m_droppedPackets; // of already disconnected clients
+         uint64_t m_expiredPackets; // dito
+         CompressionStats m_compressionStats; // of already disconnected clients, too
+
+         void addClient(int fd);
+         void schedule(tsd::common::system::MutexGuard &g);
+         void processPending();
+         void shutdown();
+         void reactorRun(); // IReactorTask
+
+      public:
+         Shard(TcpServerPort::Impl &server, ReactorLoop &loop);
+         ~Shard();
+
+         void startShard();
+         void stopShard();
+
+         inline ReactorLoop& getLoop() { return m_loop; }
+         inline TcpServerPort::Impl& getServer() { return m_server; }
+
+         void queueClient(int fd);
+         void delClient(Client *client);
+         size_t getLoad();
+         uint64_t getDroppedPackets();
+         uint64_t getExpiredPackets();
+         CompressionStats getCompressionStats();
+         void setSendQueueLimit(uint32_t capacity, OverflowPolicy policy, uint32_t blockTimeout);
+      };
 
-      void run(); // tsd::common::system::Thread
+      void addClient(int fd);
+      void startShards();
+      void watchListenSocket();
+      void unwatchListenSocket();
+      void disposeListenSource();
 
-      typedef std::set<Client*> ClientList;
-      typedef std::deque<Client*> ClientQueue;
+      typedef std::vector<Shard*> ShardList;
 
       Router &m_router;
       bool m_running;
-      Select m_select;
-      ClientList m_clients;
+      ShardList m_shards;
+      std::vector<ReactorLoop*> m_loops;
+      unsigned m_numThreads;
       tsd::common::system::Mutex m_lock;
       tsd::common::logging::Logger m_log;
       ListenSocket m_listenSocket;
-      ClientQueue m_pendingDeletes;
       SelectSource* m_selectSource;
+      uint32_t m_sendCapacity;
+      OverflowPolicy m_overflowPolicy;
+      uint32_t m_blockTimeout;
+      size_t m_zeroCopyThreshold;
+      bool m_compactHeaders;
+      size_t m_compressThreshold;
+      std::string m_codec;
+      size_t m_fragmentSize;
+      size_t m_reassemblyLimit;
 
    public:
       Impl(Router &router);
@@ -118,6 +182,15 @@ namespace tsd { namespace communication { namespace messaging {
       void disconnect();
       void initV4(uint32_t addr, uint16_t port, uint32_t sndBuf, uint32_t rcvBuf);
       void initUnix(const std::string &path);
+      void setIoThreads(unsigned threads);
+      void setSendQueueLimit(uint32_t capacity, OverflowPolicy policy, uint32_t blockTimeout);
+      void setZeroCopyThreshold(size_t threshold);
+      void setCompactHeaders(bool enable);
+      bool setCompression(size_t threshold, const std::string &codec);
+      void setFragmentation(size_t fragmentSize, size_t reassemblyLimit);
+      uint64_t getDroppedPackets();
+      uint64_t getExpiredPackets();
+      CompressionStats getCompressionStats();
       uint16_t getBoundPort()
       {
          return m_listenSocket.getBoundPort();
@@ -130,6 +203,7 @@ namespace tsd { namespace communication { namespace messaging {
 
 } } }
 
+using tsd::communication::messaging::CompressionStats;
 using tsd::communication::messaging::ConnectionException;
 using tsd::communication::messaging::TcpServerPort;
 
@@ -322,10 +396,10 @@ bool TcpServerPort::Impl::ListenSocket::selectError()
 
 /*****************************************************************************/
 
-TcpServerPort::Impl::Client::Client(TcpServerPort::Impl &server)
-   : TcpEndpoint(server.m_log)
-   , IPort(server.m_router)
-   , m_server(server)
+TcpServerPort::Impl::Client::Client(Shard &shard)
+   : TcpEndpoint(shard.getServer().m_log)
+   , IPort(shard.getServer().m_router)
+   , m_shard(shard)
 {
 }
 
@@ -340,7 +414,7 @@ void TcpServerPort::Impl::Client::epReceivedPacket(std::auto_ptr<Packet> pkt)
 
 void TcpServerPort::Impl::Client::epDisconnected()
 {
-   m_server.delClient(this);
+   m_shard.delClient(this);
 }
 
 bool TcpServerPort::Impl::Client::startPort()
@@ -377,20 +451,250 @@ bool TcpServerPort::Impl::Client::init(int fd, Select &selector)
 
 /*****************************************************************************/
 
+TcpServerPort::Impl::Shard::Shard(TcpServerPort::Impl &server, ReactorLoop &loop)
+   : m_server(server)
+   , m_loop(loop)
+   , m_running(false)
+   , m_scheduled(false)
+   , m_droppedPackets(0)
+   , m_expiredPackets(0)
+{
+}
+
+TcpServerPort::Impl::Shard::~Shard()
+{
+   // connections that were never picked up by the loop
+   while (!m_pendingAdds.empty()) {
+      close(m_pendingAdds.front());
+      m_pendingAdds.pop_front();
+   }
+}
+
+void TcpServerPort::Impl::Shard::startShard()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   m_running = true;
+}
+
+/**
+ * Disconnect all clients. Returns after the loop did so.
+ */
+void TcpServerPort::Impl::Shard::stopShard()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   if (m_running) {
+      m_running = false;
+      g.unlock();
+      m_loop.call(*this, &Shard::shutdown);
+   }
+}
+
+/**
+ * Make sure the loop processes the pending lists. Called with the lock held.
+ */
+void TcpServerPort::Impl::Shard::schedule(tsd::common::system::MutexGuard &g)
+{
+   if (m_running && !m_scheduled) {
+      m_scheduled = true;
+      g.unlock();
+      m_loop.post(this);
+   }
+}
+
+/**
+ * Hand over a new connection to the shard. May be called from any thread.
+ */
+void TcpServerPort::Impl::Shard::queueClient(int fd)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   m_pendingAdds.push_back(fd);
+   schedule(g);
+}
+
+void TcpServerPort::Impl::Shard::delClient(Client *client)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   m_pendingDeletes.push_back(client);
+   schedule(g);
+}
+
+/**
+ * Number of connections that are served or about to be served by the shard.
+ */
+size_t TcpServerPort::Impl::Shard::getLoad()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   return m_clients.size() + m_pendingAdds.size() - m_pendingDeletes.size();
+}
+
+uint64_t TcpServerPort::Impl::Shard::getDroppedPackets()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   uint64_t ret = m_droppedPackets;
+   for (ClientList::iterator it(m_clients.begin()); it != m_clients.end(); ++it) {
+      ret += (*it)->getDroppedPackets();
+   }
+
+   return ret;
+}
+
+uint64_t TcpServerPort::Impl::Shard::getExpiredPackets()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   uint64_t ret = m_expiredPackets;
+   for (ClientList::iterator it(m_clients.begin()); it != m_clients.end(); ++it) {
+      ret += (*it)->getExpiredPackets();
+   }
+
+   return ret;
+}
+
+CompressionStats TcpServerPort::Impl::Shard::getCompressionStats()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   CompressionStats ret = m_compressionStats;
+   for (ClientList::iterator it(m_clients.begin()); it != m_clients.end(); ++it) {
+      ret += (*it)->getCompressionStats();
+   }
+
+   return ret;
+}
+
+void TcpServerPort::Impl::Shard::setSendQueueLimit(uint32_t capacity, OverflowPolicy policy,
+                                                   uint32_t blockTimeout)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   for (ClientList::iterator it(m_clients.begin()); it != m_clients.end(); ++it) {
+      (*it)->setSendQueueLimit(capacity, policy, blockTimeout);
+   }
+}
+
+void TcpServerPort::Impl::Shard::addClient(int fd)
+{
+   std::auto_ptr<Client> client(new Client(*this));
+
+   tsd::common::system::MutexGuard sg(m_server.m_lock);
+   client->setSendQueueLimit(m_server.m_sendCapacity, m_server.m_overflowPolicy,
+                             m_server.m_blockTimeout);
+   client->setZeroCopyThreshold(m_server.m_zeroCopyThreshold);
+   client->setCompactHeaders(m_server.m_compactHeaders);
+   client->setCompression(m_server.m_compressThreshold, m_server.m_codec);
+   client->setFragmentation(m_server.m_fragmentSize, m_server.m_reassemblyLimit);
+   sg.unlock();
+
+   bool ok = client->init(fd, m_loop.getSelect());
+   if (ok) {
+      tsd::common::system::MutexGuard g(m_lock);
+      m_clients.insert(client.release());
+   } else {
+      m_server.m_log << tsd::common::logging::LogLevel::Error
+                     << "Client init failed!" << &std::endl;
+   }
+}
+
+/**
+ * Work off the pending lists. Runs on the loop.
+ */
+void TcpServerPort::Impl::Shard::processPending()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   while (!m_pendingAdds.empty()) {
+      int fd = m_pendingAdds.front();
+      m_pendingAdds.pop_front();
+
+      // the client registers at the router
+      g.unlock();
+      addClient(fd);
+      g.lock();
+   }
+
+   while (!m_pendingDeletes.empty()) {
+      Client *client = m_pendingDeletes.front();
+      m_pendingDeletes.pop_front();
+      m_clients.erase(client);
+      m_droppedPackets += client->getDroppedPackets();
+      m_expiredPackets += client->getExpiredPackets();
+      m_compressionStats += client->getCompressionStats();
+
+      // drop the lock when deleting the client because we up-call to the router
+      g.unlock();
+      client->finish();
+      delete client;
+      g.lock();
+   }
+}
+
+void TcpServerPort::Impl::Shard::reactorRun()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+   m_scheduled = false;
+   g.unlock();
+
+   processPending();
+}
+
+/**
+ * Clean up all clients. Runs on the loop.
+ */
+void TcpServerPort::Impl::Shard::shutdown()
+{
+   // disconnected clients must not be deleted twice
+   processPending();
+
+   tsd::common::system::MutexGuard g(m_lock);
+   ClientList clients;
+   clients.swap(m_clients);
+   for (ClientList::iterator it(clients.begin()); it != clients.end(); ++it) {
+      m_droppedPackets += (*it)->getDroppedPackets();
+      m_expiredPackets += (*it)->getExpiredPackets();
+      m_compressionStats += (*it)->getCompressionStats();
+   }
+   g.unlock();
+
+   for (ClientList::iterator it(clients.begin()); it != clients.end(); ++it) {
+      (*it)->finish();
+      delete *it;
+   }
+}
+
+/*****************************************************************************/
+
 TcpServerPort::Impl::Impl(tsd::communication::messaging::Router &router)
-   : tsd::common::system::Thread("TcpServerPort")
-   , m_router(router)
+   : m_router(router)
    , m_running(false)
+   , m_numThreads(1)
    , m_log("tsd.communication.TcpServerPort")
    , m_listenSocket(*this)
    , m_selectSource(NULL)
+   , m_sendCapacity(UNLIMITED_CAPACITY)
+   , m_overflowPolicy(OVERFLOW_DROP_NEWEST)
+   , m_blockTimeout(0)
+   , m_zeroCopyThreshold(0)
+   , m_compactHeaders(false)
+   , m_compressThreshold(0)
+   , m_codec("lz")
+   , m_fragmentSize(DEFAULT_FRAGMENT_SIZE)
+   , m_reassemblyLimit(DEFAULT_REASSEMBLY_LIMIT)
 {
 }
 
 TcpServerPort::Impl::~Impl()
 {
    if (m_selectSource != NULL) {
-      m_selectSource->dispose();
+      unwatchListenSocket();
+   }
+
+   for (ShardList::iterator it(m_shards.begin()); it != m_shards.end(); ++it) {
+      delete *it;
+   }
+
+   for (std::vector<ReactorLoop*>::iterator it(m_loops.begin()); it != m_loops.end(); ++it) {
+      Reactor::detach(*it);
    }
 }
 
@@ -400,96 +704,194 @@ void TcpServerPort::Impl::disconnect()
    if (m_running) {
       m_running = false;
       g.unlock();
-      m_select.interrupt();
-      join();
+
+      // Stop accepting before the shards are stopped so that nothing is
+      // handed over to an already stopped shard.
+      unwatchListenSocket();
+      for (ShardList::iterator it(m_shards.begin()); it != m_shards.end(); ++it) {
+         (*it)->stopShard();
+      }
    }
 }
 
-void TcpServerPort::Impl::initV4(uint32_t addr, uint16_t port, uint32_t sndBuf, uint32_t rcvBuf)
+/**
+ * Attach to the Reactor with one shard per loop. The listen socket is served
+ * by the loop of the first shard.
+ */
+void TcpServerPort::Impl::startShards()
 {
-   if (!m_select.init()) {
+   if (!Reactor::attach(m_numThreads, m_loops)) {
       throw ConnectionException("Selector init failed!");
    }
 
-   m_listenSocket.initV4(addr, port, sndBuf, rcvBuf);
+   for (std::vector<ReactorLoop*>::iterator it(m_loops.begin()); it != m_loops.end(); ++it) {
+      m_shards.push_back(new Shard(*this, **it));
+      m_shards.back()->startShard();
+   }
 
-   m_selectSource = m_select.add(m_listenSocket.getFd(), &m_listenSocket, true, false);
+   m_shards.front()->getLoop().call(*this, &Impl::watchListenSocket);
    if (m_selectSource == NULL) {
       throw ConnectionException("Could not monitor listen socket for read!");
    }
 
    m_running = true;
-   start();
 }
 
-void TcpServerPort::Impl::initUnix(const std::string &path)
+/**
+ * Runs on the loop of the first shard.
+ */
+void TcpServerPort::Impl::watchListenSocket()
 {
-   if (!m_select.init()) {
-      throw ConnectionException("Selector init failed!");
+   m_selectSource = m_shards.front()->getLoop().getSelect().add(m_listenSocket.getFd(),
+                                                                &m_listenSocket, true, false);
+}
+
+void TcpServerPort::Impl::unwatchListenSocket()
+{
+   m_shards.front()->getLoop().call(*this, &Impl::disposeListenSource);
+}
+
+/**
+ * Runs on the loop of the first shard.
+ */
+void TcpServerPort::Impl::disposeListenSource()
+{
+   if (m_selectSource != NULL) {
+      m_selectSource->dispose();
+      m_selectSource = NULL;
    }
+}
 
+void TcpServerPort::Impl::initV4(uint32_t addr, uint16_t port, uint32_t sndBuf, uint32_t rcvBuf)
+{
+   m_listenSocket.initV4(addr, port, sndBuf, rcvBuf);
+   startShards();
+}
+
+void TcpServerPort::Impl::initUnix(const std::string &path)
+{
    m_listenSocket.initUnix(path);
+   startShards();
+}
 
-   m_selectSource = m_select.add(m_listenSocket.getFd(), &m_listenSocket, true, false);
-   if (m_selectSource == NULL) {
-      throw ConnectionException("Could not monitor listen socket for read!");
+void TcpServerPort::Impl::setIoThreads(unsigned threads)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   // only applies before the port is initialized
+   if (m_shards.empty() && threads > 0) {
+      m_numThreads = threads;
    }
+}
 
-   m_running = true;
-   start();
+void TcpServerPort::Impl::setSendQueueLimit(uint32_t capacity, OverflowPolicy policy,
+                                            uint32_t blockTimeout)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   m_sendCapacity = capacity;
+   m_overflowPolicy = policy;
+   m_blockTimeout = blockTimeout;
+
+   for (ShardList::iterator it(m_shards.begin()); it != m_shards.end(); ++it) {
+      (*it)->setSendQueueLimit(capacity, policy, blockTimeout);
+   }
 }
 
-void TcpServerPort::Impl::addClient(int fd)
+void TcpServerPort::Impl::setZeroCopyThreshold(size_t threshold)
 {
-   std::auto_ptr<Client> client(new Client(*this));
-   bool ok = client->init(fd, m_select);
-   if (ok) {
-      m_clients.insert(client.release());
-   } else {
-      m_log << tsd::common::logging::LogLevel::Error
-            << "Client init failed!" << &std::endl;
+   tsd::common::system::MutexGuard g(m_lock);
+
+   // only applies to clients that connect afterwards
+   m_zeroCopyThreshold = threshold;
+}
+
+void TcpServerPort::Impl::setCompactHeaders(bool enable)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   // only applies to clients that connect afterwards
+   m_compactHeaders = enable;
+}
+
+bool TcpServerPort::Impl::setCompression(size_t threshold, const std::string &codec)
+{
+   if (PayloadCodec::find(codec) == NULL) {
+      return false;
+   }
+
+   tsd::common::system::MutexGuard g(m_lock);
+
+   // only applies to clients that connect afterwards
+   m_compressThreshold = threshold;
+   m_codec = codec;
+   return true;
+}
+
+void TcpServerPort::Impl::setFragmentation(size_t fragmentSize, size_t reassemblyLimit)
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   // only applies to clients that connect afterwards
+   m_fragmentSize = fragmentSize;
+   m_reassemblyLimit = reassemblyLimit;
+}
+
+uint64_t TcpServerPort::Impl::getDroppedPackets()
+{
+   tsd::common::system::MutexGuard g(m_lock);
+
+   uint64_t ret = 0;
+   for (ShardList::iterator it(m_shards.begin()); it != m_shards.end(); ++it) {
+      ret += (*it)->getDroppedPackets();
    }
+
+   return ret;
 }
 
-void TcpServerPort::Impl::delClient(Client *client)
+uint64_t TcpServerPort::Impl::getExpiredPackets()
 {
    tsd::common::system::MutexGuard g(m_lock);
-   m_pendingDeletes.push_back(client);
-   g.unlock();
 
-   m_select.interrupt();
+   uint64_t ret = 0;
+   for (ShardList::iterator it(m_shards.begin()); it != m_shards.end(); ++it) {
+      ret += (*it)->getExpiredPackets();
+   }
+
+   return ret;
 }
 
-void TcpServerPort::Impl::run()
+CompressionStats TcpServerPort::Impl::getCompressionStats()
 {
    tsd::common::system::MutexGuard g(m_lock);
 
-   while (m_running) {
-      // dispatch and wait for interrupt
-      g.unlock();
-      m_select.dispatch();
-      g.lock();
+   CompressionStats ret;
+   for (ShardList::iterator it(m_shards.begin()); it != m_shards.end(); ++it) {
+      ret += (*it)->getCompressionStats();
+   }
 
-      // process pending lists
-      while (!m_pendingDeletes.empty()) {
-         Client *client = m_pendingDeletes.front();
-         m_pendingDeletes.pop_front();
-         m_clients.erase(client);
-
-         // drop the lock when deleting the client because we up-call to the router
-         g.unlock();
-         client->finish();
-         delete client;
-         g.lock();
+   return ret;
+}
+
+/**
+ * Hand new connection to the shard with the fewest connections.
+ *
+ * Called on the loop of the first shard from the listen socket.
+ */
+void TcpServerPort::Impl::addClient(int fd)
+{
+   Shard *target = m_shards.front();
+   size_t load = target->getLoad();
+
+   for (ShardList::iterator it(m_shards.begin() + 1); it != m_shards.end(); ++it) {
+      size_t l = (*it)->getLoad();
+      if (l < load) {
+         target = *it;
+         load = l;
       }
    }
 
-   // clean up all clients
-   g.unlock();
-   for (ClientList::iterator it(m_clients.begin()); it != m_clients.end(); ++it) {
-      (*it)->finish();
-      delete *it;
-   }
+   target->queueClient(fd);
 }
 
 /*****************************************************************************/
@@ -510,6 +912,52 @@ void TcpServerPort::disconnect()
    m_p->disconnect();
 }
 
+uint64_t TcpServerPort::getDroppedPackets()
+{
+   return m_p->getDroppedPackets();
+}
+
+uint64_t TcpServerPort::getExpiredPackets()
+{
+   return m_p->getExpiredPackets();
+}
+
+CompressionStats TcpServerPort::getCompressionStats()
+{
+   return m_p->getCompressionStats();
+}
+
+void TcpServerPort::setSendQueueLimit(uint32_t capacity, OverflowPolicy policy,
+                                      uint32_t blockTimeout)
+{
+   m_p->setSendQueueLimit(capacity, policy, blockTimeout);
+}
+
+void TcpServerPort::setZeroCopyThreshold(size_t threshold)
+{
+   m_p->setZeroCopyThreshold(threshold);
+}
+
+void TcpServerPort::setCompactHeaders(bool enable)
+{
+   m_p->setCompactHeaders(enable);
+}
+
+bool TcpServerPort::setCompression(size_t threshold, const std::string &codec)
+{
+   return m_p->setCompression(threshold, codec);
+}
+
+void TcpServerPort::setFragmentation(size_t fragmentSize, size_t reassemblyLimit)
+{
+   m_p->setFragmentation(fragmentSize, reassemblyLimit);
+}
+
+void TcpServerPort::setIoThreads(unsigned threads)
+{
+   m_p->setIoThreads(threads);
+}
+
 void TcpServerPort::initV4(uint32_t addr, uint16_t port, uint32_t sndBuf, uint32_t rcvBuf)
 {
    m_p->initV4(addr, port, sndBuf, rcvBuf);
@@ -4,6 +4,7 @@
 #include <netinet/in.h>
 
 #include <tsd/communication/messaging/Connection.hpp>
+#include <tsd/communication/messaging/types.hpp>
 
 namespace tsd { namespace communication { namespace messaging {
 
@@ -18,6 +19,46 @@ public:
    ~TcpServerPort();
 
    void disconnect(); // IConnection
+   uint64_t getDroppedPackets(); // IConnection
+   uint64_t getExpiredPackets(); // IConnection
+   CompressionStats getCompressionStats(); // IConnection
+
+   void setSendQueueLimit(uint32_t capacity, OverflowPolicy policy,
+                          uint32_t blockTimeout = 100);
+   void setZeroCopyThreshold(size_t threshold);
+
+   /**
+    * Offer the compact packet header to connecting peers. Peers that do not
+    * know it keep using the fixed header. Disabled by default.
+    */
+   void setCompactHeaders(bool enable);
+
+   /**
+    * Compress payloads of at least @p threshold bytes for peers that enabled
+    * compression, too. Zero disables compression, which is the default. Only
+    * applies to peers that connect afterwards.
+    *
+    * @return False if the codec is unknown
+    */
+   bool setCompression(size_t threshold, const std::string &codec = "lz");
+
+   /**
+    * Send payloads of more than @p fragmentSize bytes in fragments to peers
+    * that can reassemble them, zero disables it. Incoming fragments are
+    * reassembled with at most @p reassemblyLimit bytes in progress. Only
+    * applies to peers that connect afterwards.
+    */
+   void setFragmentation(size_t fragmentSize, size_t reassemblyLimit);
+
+   /**
+    * Serve the connections with @p threads I/O threads.
+    *
+    * The port uses that many distinct loops of the Reactor, growing the pool
+    * if necessary. New connections are assigned to the loop with the fewest
+    * connections of this port and stay there. Must be called before initV4()
+    * or initUnix(). The default is a single loop.
+    */
+   void setIoThreads(unsigned threads);
 
    void initV4(uint32_t addr = INADDR_ANY, uint16_t port = 24710,
                uint32_t sndBuf = 0, uint32_t rcvBuf = 0);
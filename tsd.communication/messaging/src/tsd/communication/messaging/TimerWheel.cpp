@@ -0,0 +1,320 @@
+#include <tsd/common/assert.hpp>
+#include <tsd/common/system/Clock.hpp>
+
+#include "TimerWheel.hpp"
+
+using tsd::communication::event::TsdEvent;
+
+namespace tsd { namespace communication { namespace messaging {
+
+namespace {
+
+   const uint32_t WHEEL_RANGE = 1u << (TimerWheel::LEVEL_BITS * TimerWheel::NUM_LEVELS);
+   const uint32_t INDEX_MASK = (1u << TimerWheel::INDEX_BITS) - 1u;
+   const uint32_t GENERATION_MASK = (1u << (31 - TimerWheel::INDEX_BITS)) - 1u;
+
+   /**
+    * Find first occupied slot, starting at @p start and wrapping around.
+    *
+    * @return Distance of the slot from @p start
+    */
+   inline unsigned firstOccupied(uint64_t bits, unsigned start)
+   {
+      if (start != 0) {
+         bits = (bits >> start) | (bits << (TimerWheel::LEVEL_SIZE - start));
+      }
+#ifdef __GNUC__
+      return static_cast<unsigned>(__builtin_ctzll(bits));
+#else
+      unsigned ret = 0;
+      while ((bits & 1u) == 0) {
+         bits >>= 1;
+         ret++;
+      }
+      return ret;
+#endif
+   }
+
+}
+
+TimerWheel::TimerWheel()
+   : m_time(0)
+   , m_numArmed(0)
+{
+   for (unsigned level = 0; level < NUM_LEVELS; level++) {
+      for (unsigned index = 0; index < LEVEL_SIZE; index++) {
+         m_wheel[level][index].m_head = NULL;
+         m_wheel[level][index].m_tail = NULL;
+      }
+      m_occupied[level] = 0;
+   }
+   m_due.m_head = NULL;
+   m_due.m_tail = NULL;
+}
+
+TimerWheel::~TimerWheel()
+{
+   for (std::deque<Timer>::iterator it(m_entries.begin()); it != m_entries.end(); ++it) {
+      delete it->m_event;
+   }
+}
+
+TimerWheel::Timer *TimerWheel::add(TsdEvent *event, uint32_t now, uint32_t ms, bool cyclic)
+{
+   // Nothing pending. Skip the idle time instead of catching up later.
+   if (m_numArmed == 0) {
+      m_time = now;
+   }
+
+   /*
+    * Recycle the oldest free entry first. This keeps stale references from
+    * matching a new timer for as long as possible.
+    */
+   uint32_t index;
+   if (!m_freeEntries.empty()) {
+      index = m_freeEntries.front();
+      m_freeEntries.pop_front();
+   } else {
+      ASSERT_FATAL(m_entries.size() < MAX_TIMERS, "Too many timers");
+      index = static_cast<uint32_t>(m_entries.size());
+      m_entries.push_back(Timer());
+   }
+
+   Timer *t = &m_entries[index];
+   t->m_generation = (t->m_generation + 1u) & GENERATION_MASK;
+   t->m_ref = (t->m_generation << (INDEX_BITS + 1)) | (index << 1) | 1u;
+   t->m_event = event;
+   t->m_expires = now + ms;
+   t->m_interval = cyclic ? ms : 0;
+   t->m_queued = 0;
+
+   schedule(t);
+   m_numArmed++;
+
+   return t;
+}
+
+TimerWheel::Timer *TimerWheel::find(TimerRef_t ref)
+{
+   if ((ref & 1u) == 0) {
+      return NULL;
+   }
+
+   uint32_t index = (ref >> 1) & INDEX_MASK;
+   if (index >= m_entries.size()) {
+      return NULL;
+   }
+
+   Timer *t = &m_entries[index];
+   return t->m_ref == ref ? t : NULL;
+}
+
+void TimerWheel::rearm(Timer *t)
+{
+   schedule(t);
+   m_numArmed++;
+}
+
+void TimerWheel::cancel(Timer *t)
+{
+   if (t->isArmed()) {
+      unlink(t);
+      m_numArmed--;
+   }
+}
+
+void TimerWheel::remove(Timer *t)
+{
+   cancel(t);
+   delete t->m_event;
+   t->m_event = NULL;
+   t->m_queued = 0;
+   m_freeEntries.push_back((t->m_ref >> 1) & INDEX_MASK);
+   t->m_ref = 0;
+}
+
+TimerWheel::Timer *TimerWheel::expire(uint32_t now)
+{
+   while (m_due.m_head == NULL) {
+      if (m_numArmed == 0 || tsd::common::system::Clock::tickTimeBefore(now, m_time)) {
+         return NULL;
+      }
+
+      // jump over empty slots
+      uint32_t offset = nextEventOffset();
+      if (offset > now - m_time) {
+         m_time = now + 1;
+         return NULL;
+      }
+
+      m_time += offset;
+      processTick();
+   }
+
+   Timer *t = m_due.m_head;
+   unlink(t);
+   m_numArmed--;
+
+   return t;
+}
+
+uint32_t TimerWheel::nextTimeout(uint32_t now) const
+{
+   uint32_t ret = 0;
+
+   if (m_numArmed > 0) {
+      uint32_t next = m_time + nextEventOffset();
+      ret = tsd::common::system::Clock::tickTimeAfter(next, now) ? next - now : 1;
+   }
+
+   return ret;
+}
+
+/**
+ * Put timer into the slot matching its expiry time.
+ *
+ * Timers that are already due go directly to the due list.
+ */
+void TimerWheel::schedule(Timer *t)
+{
+   if (tsd::common::system::Clock::tickTimeBefore(t->m_expires, m_time)) {
+      link(&m_due, t);
+      return;
+   }
+
+   uint32_t delta = t->m_expires - m_time;
+   if (delta >= WHEEL_RANGE) {
+      // out of range: park in last level, cascaded again later
+      delta = WHEEL_RANGE - 1;
+   }
+
+   unsigned level = 0;
+   while (delta >= (1u << (LEVEL_BITS * (level + 1)))) {
+      level++;
+   }
+
+   unsigned index = ((m_time + delta) >> (LEVEL_BITS * level)) & (LEVEL_SIZE - 1);
+   link(&m_wheel[level][index], t);
+   m_occupied[level] |= static_cast<uint64_t>(1) << index;
+}
+
+void TimerWheel::link(Slot *slot, Timer *t)
+{
+   t->m_prev = slot->m_tail;
+   t->m_next = NULL;
+   if (slot->m_tail != NULL) {
+      slot->m_tail->m_next = t;
+   } else {
+      slot->m_head = t;
+   }
+   slot->m_tail = t;
+   t->m_slot = slot;
+}
+
+void TimerWheel::unlink(Timer *t)
+{
+   Slot *slot = t->m_slot;
+
+   if (t->m_prev != NULL) {
+      t->m_prev->m_next = t->m_next;
+   } else {
+      slot->m_head = t->m_next;
+   }
+   if (t->m_next != NULL) {
+      t->m_next->m_prev = t->m_prev;
+   } else {
+      slot->m_tail = t->m_prev;
+   }
+   t->m_slot = NULL;
+
+   if (slot->m_head == NULL && slot != &m_due) {
+      size_t pos = slot - &m_wheel[0][0];
+      m_occupied[pos / LEVEL_SIZE] &= ~(static_cast<uint64_t>(1) << (pos % LEVEL_SIZE));
+   }
+}
+
+/**
+ * Move all timers of a slot to the finer levels.
+ */
+void TimerWheel::cascade(unsigned level, unsigned index)
+{
+   Timer *t = m_wheel[level][index].m_head;
+   m_wheel[level][index].m_head = NULL;
+   m_wheel[level][index].m_tail = NULL;
+   m_occupied[level] &= ~(static_cast<uint64_t>(1) << index);
+
+   while (t != NULL) {
+      Timer *next = t->m_next;
+      schedule(t);
+      t = next;
+   }
+}
+
+/**
+ * Process the tick at m_time.
+ *
+ * Cascades the higher levels if their slot boundary is reached and moves all
+ * timers that expire at this tick to the due list.
+ */
+void TimerWheel::processTick()
+{
+   for (unsigned level = 1; level < NUM_LEVELS; level++) {
+      if ((m_time & ((1u << (LEVEL_BITS * level)) - 1u)) != 0) {
+         break;
+      }
+      cascade(level, (m_time >> (LEVEL_BITS * level)) & (LEVEL_SIZE - 1));
+   }
+
+   unsigned index = m_time & (LEVEL_SIZE - 1);
+   Slot &slot = m_wheel[0][index];
+   if (slot.m_head != NULL) {
+      for (Timer *t = slot.m_head; t != NULL; t = t->m_next) {
+         t->m_slot = &m_due;
+      }
+      slot.m_head->m_prev = m_due.m_tail;
+      if (m_due.m_tail != NULL) {
+         m_due.m_tail->m_next = slot.m_head;
+      } else {
+         m_due.m_head = slot.m_head;
+      }
+      m_due.m_tail = slot.m_tail;
+      slot.m_head = NULL;
+      slot.m_tail = NULL;
+      m_occupied[0] &= ~(static_cast<uint64_t>(1) << index);
+   }
+
+   m_time++;
+}
+
+/**
+ * Distance from m_time to the next tick where something has to be done.
+ *
+ * This is either the next expiry in the first level or the next boundary of
+ * an occupied slot in the higher levels. Must only be called if at least one
+ * timer is armed.
+ */
+uint32_t TimerWheel::nextEventOffset() const
+{
+   if (m_due.m_head != NULL) {
+      return 0;
+   }
+
+   uint32_t ret = WHEEL_RANGE;
+   for (unsigned level = 0; level < NUM_LEVELS; level++) {
+      if (m_occupied[level] == 0) {
+         continue;
+      }
+
+      unsigned shift = LEVEL_BITS * level;
+      uint32_t boundary = (0u - m_time) & ((1u << shift) - 1u);
+      unsigned index = ((m_time + boundary) >> shift) & (LEVEL_SIZE - 1);
+      uint32_t offset = boundary + (firstOccupied(m_occupied[level], index) << shift);
+      if (offset < ret) {
+         ret = offset;
+      }
+   }
+
+   return ret;
+}
+
+} } }
@@ -0,0 +1,150 @@
+#ifndef TSD_COMMUNICATION_MESSAGING_TIMERWHEEL_HPP
+#define TSD_COMMUNICATION_MESSAGING_TIMERWHEEL_HPP
+
+#include <deque>
+
+#include <tsd/common/types/typedef.hpp>
+#include <tsd/communication/event/TsdEvent.hpp>
+#include <tsd/communication/messaging/types.hpp>
+
+namespace tsd { namespace communication { namespace messaging {
+
+/**
+ * Hierarchical timer wheel with millisecond resolution.
+ *
+ * Timers are hashed by their expiry time into NUM_LEVELS wheels of
+ * LEVEL_SIZE slots each. The first level has a resolution of 1ms, every
+ * further level is LEVEL_SIZE times coarser. When the wheel time reaches a
+ * slot of a higher level its timers are cascaded down into the finer levels.
+ * Timers that are further away than the whole wheel range are parked in the
+ * last level and cascaded repeatedly until they are in range.
+ *
+ * Adding, cancelling and looking up timers is O(1). The timer reference
+ * encodes the index into the timer table together with a generation counter
+ * so that stale references of freed timers are rejected.
+ *
+ * A timer that has expired stays allocated until it is freed explicitly. The
+ * owner uses this to keep track of expiry messages that are still queued.
+ *
+ * The class is not thread safe. All access must be serialized by the owner.
+ */
+class TimerWheel
+{
+public:
+   enum {
+      LEVEL_BITS = 6,
+      LEVEL_SIZE = 1 << LEVEL_BITS,
+      NUM_LEVELS = 4,
+      INDEX_BITS = 20,
+      MAX_TIMERS = 1 << INDEX_BITS
+   };
+
+   struct Slot;
+
+   struct Timer {
+      tsd::communication::event::TsdEvent *m_event;
+      uint32_t m_expires;
+      uint32_t m_interval;
+      TimerRef_t m_ref;       // zero if the entry is free
+      uint32_t m_queued;      // expiry messages of this timer that are queued
+      uint32_t m_generation;
+      Timer *m_prev;
+      Timer *m_next;
+      Slot *m_slot;           // NULL if not armed
+
+      inline bool isArmed() const { return m_slot != NULL; }
+   };
+
+   struct Slot {
+      Timer *m_head;
+      Timer *m_tail;
+   };
+
+private:
+   std::deque<Timer> m_entries;
+   std::deque<uint32_t> m_freeEntries;
+   Slot m_wheel[NUM_LEVELS][LEVEL_SIZE];
+   uint64_t m_occupied[NUM_LEVELS];
+   Slot m_due;
+   uint32_t m_time;
+   uint32_t m_numArmed;
+
+   void schedule(Timer *t);
+   void link(Slot *slot, Timer *t);
+   void unlink(Timer *t);
+   void cascade(unsigned level, unsigned index);
+   void processTick();
+   uint32_t nextEventOffset() const;
+
+   TimerWheel(const TimerWheel&);
+   TimerWheel& operator=(const TimerWheel&);
+
+public:
+   TimerWheel();
+   ~TimerWheel();
+
+   /**
+    * Arm a new timer.
+    *
+    * Takes ownership of @p event. The returned pointer stays valid until the
+    * timer is freed.
+    *
+    * @param event   Expiry message
+    * @param now     Current tick counter
+    * @param ms      Timer value in milliseconds
+    * @param cyclic  True for a cyclic timer
+    * @return Timer entry
+    */
+   Timer *add(tsd::communication::event::TsdEvent *event, uint32_t now, uint32_t ms,
+              bool cyclic);
+
+   /**
+    * Look up an allocated timer by its reference.
+    *
+    * @return Timer entry or NULL if the reference is unknown or stale
+    */
+   Timer *find(TimerRef_t ref);
+
+   /**
+    * Arm an expired timer again at its m_expires time.
+    */
+   void rearm(Timer *t);
+
+   /**
+    * Disarm timer. The timer stays allocated.
+    */
+   void cancel(Timer *t);
+
+   /**
+    * Disarm and free timer. Deletes the expiry message if still owned.
+    */
+   void remove(Timer *t);
+
+   /**
+    * Get next expired timer.
+    *
+    * Expired timers are returned in order of their expiry time. The timer is
+    * disarmed but stays allocated.
+    *
+    * @param now  Current tick counter
+    * @return Expired timer or NULL if no timer is due at @p now
+    */
+   Timer *expire(uint32_t now);
+
+   /**
+    * Calculate when the wheel needs attention the next time.
+    *
+    * The result might be earlier than the next actual expiry if timers have
+    * to be cascaded first.
+    *
+    * @param now  Current tick counter
+    * @return Time in ms, at least 1, or 0 if no timer is armed
+    */
+   uint32_t nextTimeout(uint32_t now) const;
+
+   inline bool empty() const { return m_numArmed == 0; }
+};
+
+} } }
+
+#endif
@@ -14,6 +14,7 @@
 #include <tsd/communication/messaging/ConnectionException.hpp>
 
 #include "ConnectionImpl.hpp"
+#include "PayloadCodec.hpp"
 #include "UioShmPort.hpp"
 
 
@@ -53,6 +54,11 @@ namespace tsd { namespace communication { namespace messaging {
       void initConnect(const std::string &url, const std::string &subDomain);
       void initListen(const std::string &url);
       void disconnect();
+      void setCompactHeaders(bool enable);
+      bool setCompression(size_t threshold, const std::string &codec);
+      void setFragmentation(size_t fragmentSize, size_t reassemblyLimit);
+      uint64_t getExpiredPackets();
+      CompressionStats getCompressionStats();
    };
 
    class UioShmPort::Listener
@@ -185,6 +191,31 @@ void UioShmPortHalf::initConnect(const std::string &url, const std::string &subD
    }
 }
 
+void UioShmPortHalf::setCompactHeaders(bool enable)
+{
+   m_connection->setCompactHeaders(enable);
+}
+
+bool UioShmPortHalf::setCompression(size_t threshold, const std::string &codec)
+{
+   return m_connection->setCompression(threshold, codec);
+}
+
+void UioShmPortHalf::setFragmentation(size_t fragmentSize, size_t reassemblyLimit)
+{
+   m_connection->setFragmentation(fragmentSize, reassemblyLimit);
+}
+
+uint64_t UioShmPortHalf::getExpiredPackets()
+{
+   return m_connection->getExpiredPackets();
+}
+
+tsd::communication::messaging::CompressionStats UioShmPortHalf::getCompressionStats()
+{
+   return m_connection->getCompressionStats();
+}
+
 // tsd::common::utils::DuplexShm
 void UioShmPortHalf::wakeRemote()
 {
@@ -342,6 +373,11 @@ UioShmPort::UioShmPort(Router &router)
    : m_router(router)
    , m_listener(0)
    , m_connector(0)
+   , m_compactHeaders(false)
+   , m_compressThreshold(0)
+   , m_codec("lz")
+   , m_fragmentSize(DEFAULT_FRAGMENT_SIZE)
+   , m_reassemblyLimit(DEFAULT_REASSEMBLY_LIMIT)
 { }
 
 UioShmPort::~UioShmPort()
@@ -356,6 +392,9 @@ void UioShmPort::connectUpstream(const std::string &url, const std::string &subD
    }
 
    std::auto_ptr<Connector> connector(new Connector(m_router));
+   connector->setCompactHeaders(m_compactHeaders);
+   connector->setCompression(m_compressThreshold, m_codec);
+   connector->setFragmentation(m_fragmentSize, m_reassemblyLimit);
    connector->initConnect(url, subDomain);
    m_connector = connector.release();
 }
@@ -367,6 +406,9 @@ void UioShmPort::listenDownstream(const std::string &url)
    }
 
    std::auto_ptr<Listener> listener(new Listener(m_router));
+   listener->setCompactHeaders(m_compactHeaders);
+   listener->setCompression(m_compressThreshold, m_codec);
+   listener->setFragmentation(m_fragmentSize, m_reassemblyLimit);
    listener->initListen(url);
    m_listener = listener.release();
 }
@@ -385,3 +427,49 @@ void UioShmPort::disconnect()
       m_connector = 0;
    }
 }
+
+uint64_t UioShmPort::getExpiredPackets()
+{
+   if (m_listener != 0) {
+      return m_listener->getExpiredPackets();
+   }
+   if (m_connector != 0) {
+      return m_connector->getExpiredPackets();
+   }
+
+   return 0;
+}
+
+tsd::communication::messaging::CompressionStats UioShmPort::getCompressionStats()
+{
+   if (m_listener != 0) {
+      return m_listener->getCompressionStats();
+   }
+   if (m_connector != 0) {
+      return m_connector->getCompressionStats();
+   }
+
+   return CompressionStats();
+}
+
+void UioShmPort::setCompactHeaders(bool enable)
+{
+   m_compactHeaders = enable;
+}
+
+bool UioShmPort::setCompression(size_t threshold, const std::string &codec)
+{
+   if (PayloadCodec::find(codec) == NULL) {
+      return false;
+   }
+
+   m_compressThreshold = threshold;
+   m_codec = codec;
+   return true;
+}
+
+void UioShmPort::setFragmentation(size_t fragmentSize, size_t reassemblyLimit)
+{
+   m_fragmentSize = fragmentSize;
+   m_reassemblyLimit = reassemblyLimit;
+}
@@ -18,6 +18,11 @@ class UioShmPort
    Router &m_router;
    Listener *m_listener;
    Connector *m_connector;
+   bool m_compactHeaders;
+   size_t m_compressThreshold;
+   std::string m_codec;
+   size_t m_fragmentSize;
+   size_t m_reassemblyLimit;
 
 public:
    UioShmPort(Router &router);
@@ -27,6 +32,31 @@ public:
    void listenDownstream(const std::string &url);
 
    void disconnect(); // IConnection
+   uint64_t getExpiredPackets(); // IConnection
+   CompressionStats getCompressionStats(); // IConnection
+
+   /**
+    * Negotiate the compact packet header with the peer. Must be called
+    * before connectUpstream() or listenDownstream(). Disabled by default.
+    */
+   void setCompactHeaders(bool enable);
+
+   /**
+    * Compress payloads of at least @p threshold bytes if the peer enabled
+    * compression, too. Zero disables compression, which is the default. Must
+    * be called before connectUpstream() or listenDownstream().
+    *
+    * @return False if the codec is unknown
+    */
+   bool setCompression(size_t threshold, const std::string &codec = "lz");
+
+   /**
+    * Send payloads of more than @p fragmentSize bytes in fragments if the
+    * peer can reassemble them, zero disables it. Incoming fragments are
+    * reassembled with at most @p reassemblyLimit bytes in progress. Must be
+    * called before connectUpstream() or listenDownstream().
+    */
+   void setFragmentation(size_t fragmentSize, size_t reassemblyLimit);
 };
 
 } } }
@@ -71,6 +71,7 @@ class NameServerTestSuite: public CPPUNIT_NS::TestFixture
    CPPUNIT_TEST(test_auth_tree_search);
    CPPUNIT_TEST(test_auth_tree_timout);
    CPPUNIT_TEST(test_disconnect_stub_1);
+   CPPUNIT_TEST(test_deregister_stub);
 
    // FIXME: broken tests
    //CPPUNIT_TEST(test_disconnect_stub_2);
@@ -382,6 +383,37 @@ public:
       CPPUNIT_ASSERT(checkIfcExist("foo", leafQ.get()));
    }
 
+   /**
+    * Deregister a name on the root router while its interface stays alive.
+    * Another leaf router that has cached the name must not find it anymore.
+    */
+   void test_deregister_stub()
+   {
+      Router rootRouter("root");
+      Router leaf1Router("leaf1");
+      InternalPort portRoot2Leaf1;
+      CPPUNIT_ASSERT(portRoot2Leaf1.connect(rootRouter, leaf1Router));
+      Router leaf2Router("leaf2");
+      InternalPort portRoot2Leaf2;
+      CPPUNIT_ASSERT(portRoot2Leaf2.connect(rootRouter, leaf2Router));
+
+      std::auto_ptr<IQueue> pubQ(new Queue("publisher", leaf1Router));
+      std::auto_ptr<IQueue> subQ(new Queue("subscriber", leaf2Router));
+
+      std::auto_ptr<ILocalIfc> pubIfc(
+         pubQ->registerInterface(SampleFactory::getInstance(), "foo"));
+      CPPUNIT_ASSERT(checkIfcExist("foo", subQ.get(), 5000));
+
+      leaf1Router.unpublishInterface("foo", pubIfc->getLocalIfcAddr());
+
+      bool found = true;
+      for (int i = 0; i < 100 && found; i++) {
+         tsd::common::system::Thread::sleep(20);
+         found = checkIfcExist("foo", subQ.get(), 0);
+      }
+      CPPUNIT_ASSERT(!found);
+   }
+
    /**
     * Register an interface from a leaf router through a stub resolver across
     * two hops. After the network split the inteface must not be registered on
@@ -0,0 +1,169 @@
+#include <sstream>
+#include <unistd.h>
+
+#include <UnitTest.hpp>
+#include <cppunit/CppUnit.hpp>
+
+#include <tsd/communication/messaging/Connection.hpp>
+#include <tsd/communication/messaging/ConnectionException.hpp>
+
+// internal API
+#include <tsd/communication/messaging/Router.hpp>
+#include <tsd/communication/messaging/ShmPort.hpp>
+
+#include "TransportSuite.hpp"
+
+
+namespace tsd { namespace communication { namespace messaging {
+
+   class ShmPortConnection
+      : public IConnection
+   {
+      ShmPort *m_northPort;
+      ShmPort *m_southPort;
+
+   public:
+      ShmPortConnection()
+         : m_northPort(0)
+         , m_southPort(0)
+      { }
+
+      ~ShmPortConnection()
+      {
+         ShmPortConnection::disconnect();
+         if (m_northPort != 0) {
+            delete m_northPort;
+         }
+         if (m_southPort != 0) {
+            delete m_southPort;
+         }
+      }
+
+      void connect(Router &upstreamRouter, Router &downstreamRouter,
+                   const std::string &name, const std::string &subDomain)
+      {
+         m_northPort = new ShmPort(upstreamRouter);
+         m_northPort->listenDownstream(name);
+
+         m_southPort = new ShmPort(downstreamRouter);
+         m_southPort->connectUpstream(name, subDomain);
+      }
+
+      // IConnection
+      void disconnect()
+      {
+         if (m_southPort != 0) {
+            m_southPort->disconnect();
+         }
+         if (m_northPort != 0) {
+            m_northPort->disconnect();
+         }
+      }
+   };
+
+} } }
+
+using namespace tsd::communication::messaging;
+
+namespace {
+
+   /**
+    * Create a name that is unique on the host.
+    */
+   std::string uniqueName()
+   {
+      static unsigned counter = 0;
+
+      std::stringstream name;
+      name << "tsd.communication.messaging.test." << getpid() << "."
+           << __sync_fetch_and_add(&counter, 1u);
+      return name.str();
+   }
+
+}
+
+/*****************************************************************************/
+
+/**
+ * Transport test case for same-host shared memory.
+ *
+ * Every connection gets its own listening port because a ShmPort serves only
+ * a single peer.
+ */
+class ShmPortConnectionTestSuite
+   : public TransportSuite
+{
+   CPPUNIT_TEST_SUB_SUITE(ShmPortConnectionTestSuite, TransportSuite);
+
+   // special tests from TransportSuite
+   CPPUNIT_TEST(test_bulk_multi);
+   CPPUNIT_TEST(test_bulk_connect_disconnect);
+
+   // local tests
+   CPPUNIT_TEST(test_connect_std);
+   CPPUNIT_TEST(test_connect_reconnect);
+   CPPUNIT_TEST(test_connect_throws);
+   CPPUNIT_TEST_SUITE_END();
+
+protected:
+   // TransportSuite
+   IConnection* createConnection(Router &north, Router &south, const std::string &subDomain)
+   {
+      std::auto_ptr<ShmPortConnection> conn(new ShmPortConnection);
+      conn->connect(north, south, uniqueName(), subDomain);
+      return conn.release();
+   }
+
+public:
+   /**
+    * Test shared memory connection through standard interface.
+    *
+    * Open a standard listening port and connect the local router to it.
+    */
+   void test_connect_std()
+   {
+      std::string name(uniqueName());
+
+      Router rootRouter("root");
+      ShmPort rootServer(rootRouter);
+      rootServer.listenDownstream(name);
+
+      std::auto_ptr<IConnection> conn(connectUpstream("shm://" + name));
+      CPPUNIT_ASSERT(conn.get() != NULL);
+      conn->disconnect();
+   }
+
+   /**
+    * Test that the listening port accepts the next peer after the first one
+    * went away.
+    */
+   void test_connect_reconnect()
+   {
+      std::string name(uniqueName());
+
+      Router rootRouter("root");
+      ShmPort rootServer(rootRouter);
+      rootServer.listenDownstream(name);
+
+      for (int i = 0; i < 3; i++) {
+         Router leafRouter("leaf");
+         ShmPort leafClient(leafRouter);
+         leafClient.connectUpstream(name, "");
+         leafClient.disconnect();
+      }
+   }
+
+   /**
+    * Test that connection to a non-existing port throws exception.
+    */
+   void test_connect_throws()
+   {
+      std::auto_ptr<IConnection> conn;
+
+      CPPUNIT_ASSERT_THROW(conn.reset(connectUpstream("shm://" + uniqueName())),
+         ConnectionException);
+   }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ShmPortConnectionTestSuite);
@@ -32,9 +32,11 @@ namespace {
       std::auto_ptr<TcpServerPort> m_port;
       tsd::common::system::Mutex m_lock;
       uint16_t m_tcpPort;
+      unsigned m_ioThreads;
+      bool m_compactHeaders;
 
    public:
-      TcpServerWrapper(Router &router);
+      TcpServerWrapper(Router &router, unsigned ioThreads, bool compactHeaders);
       ~TcpServerWrapper();
 
       IConnection* createConnection(Router &south, const std::string &subDomain);
@@ -46,10 +48,11 @@ namespace {
    {
       TcpServerWrapper &m_srvWrap;
       uint16_t m_serverPort;
+      bool m_compactHeaders;
       TcpClientPort *m_client;
 
    public:
-      TcpClientWrapper(TcpServerWrapper &srvWrap, uint16_t port);
+      TcpClientWrapper(TcpServerWrapper &srvWrap, uint16_t port, bool compactHeaders);
       ~TcpClientWrapper();
 
       void init(Router &south, const std::string &subDomain);
@@ -60,10 +63,12 @@ namespace {
 
 /*****************************************************************************/
 
-TcpServerWrapper::TcpServerWrapper(Router &router)
+TcpServerWrapper::TcpServerWrapper(Router &router, unsigned ioThreads, bool compactHeaders)
    : m_router(router)
    , m_users(0)
    , m_tcpPort(0)
+   , m_ioThreads(ioThreads)
+   , m_compactHeaders(compactHeaders)
 { }
 
 TcpServerWrapper::~TcpServerWrapper()
@@ -75,6 +80,8 @@ IConnection* TcpServerWrapper::createConnection(Router &south, const std::string
 
    if (m_users == 0) {
       std::auto_ptr<TcpServerPort> port(new TcpServerPort(m_router));
+      port->setIoThreads(m_ioThreads);
+      port->setCompactHeaders(m_compactHeaders);
       port->initV4(INADDR_LOOPBACK, 0, 4000, 4000);
       m_tcpPort = port->getBoundPort();
       CPPUNIT_ASSERT(m_tcpPort != 0);
@@ -83,7 +90,7 @@ IConnection* TcpServerWrapper::createConnection(Router &south, const std::string
    m_users++;
 
    // create wrapper and initilialize asynchronously
-   std::auto_ptr<TcpClientWrapper> conn(new TcpClientWrapper(*this, m_tcpPort));
+   std::auto_ptr<TcpClientWrapper> conn(new TcpClientWrapper(*this, m_tcpPort, m_compactHeaders));
    g.unlock();
    conn->init(south, subDomain);
    return conn.release();
@@ -102,9 +109,11 @@ void TcpServerWrapper::delConnection()
 
 /*****************************************************************************/
 
-TcpClientWrapper::TcpClientWrapper(TcpServerWrapper &srvWrap, uint16_t port)
+TcpClientWrapper::TcpClientWrapper(TcpServerWrapper &srvWrap, uint16_t port,
+                                   bool compactHeaders)
    : m_srvWrap(srvWrap)
    , m_serverPort(port)
+   , m_compactHeaders(compactHeaders)
    , m_client(0)
 {
 }
@@ -118,6 +127,7 @@ TcpClientWrapper::~TcpClientWrapper()
 void TcpClientWrapper::init(Router &south, const std::string &subDomain)
 {
    std::auto_ptr<TcpClientPort> clientPort(new TcpClientPort(south, subDomain));
+   clientPort->setCompactHeaders(m_compactHeaders);
    clientPort->initV4(INADDR_LOOPBACK, m_serverPort, 4000, 4000);
 
    m_client = clientPort.release();
@@ -140,6 +150,8 @@ class TcpConnectionTestSuite
    typedef std::map<Router*, TcpServerWrapper*> ServerMap;
    ServerMap m_servers;
    tsd::common::system::Mutex m_lock;
+   unsigned m_ioThreads;
+   bool m_compactHeaders;
 
    CPPUNIT_TEST_SUB_SUITE(TcpConnectionTestSuite, TransportSuite);
 
@@ -151,6 +163,7 @@ class TcpConnectionTestSuite
    CPPUNIT_TEST(test_connect_std_client);
    CPPUNIT_TEST(test_connect_std_server);
    CPPUNIT_TEST(test_connect_throws);
+   CPPUNIT_TEST(test_compact_headers_mixed);
    CPPUNIT_TEST_SUITE_END();
 
 protected:
@@ -173,7 +186,8 @@ protected:
 
          ServerMap::iterator it(m_servers.find(&north));
          if (it == m_servers.end()) {
-            m_servers[&north] = srvWrap = new TcpServerWrapper(north);
+            m_servers[&north] = srvWrap = new TcpServerWrapper(north, m_ioThreads,
+                                                                m_compactHeaders);
          } else {
             srvWrap = it->second;
          }
@@ -183,6 +197,11 @@ protected:
    }
 
 public:
+   explicit TcpConnectionTestSuite(unsigned ioThreads = 1, bool compactHeaders = false)
+      : m_ioThreads(ioThreads)
+      , m_compactHeaders(compactHeaders)
+   { }
+
    // TestFixture
    void tearDown()
    {
@@ -244,6 +263,113 @@ public:
          ConnectionException);
    }
 
+   /**
+    * Test peers with and without compact headers.
+    *
+    * Exchange a message in each direction for every combination. Compression
+    * needs the compact header, i.e. payloads must only be compressed if both
+    * sides enabled it. Otherwise the fixed header is kept in both directions.
+    */
+   void test_compact_headers_mixed()
+   {
+      for (unsigned i = 0; i < 4; i++) {
+         bool serverCompact = (i & 1) != 0;
+         bool clientCompact = (i & 2) != 0;
+
+         Router rootRouter("root");
+         Router leafRouter("leaf");
+
+         TcpServerPort rootServer(rootRouter);
+         rootServer.setCompactHeaders(serverCompact);
+         CPPUNIT_ASSERT(rootServer.setCompression(64));
+         rootServer.initV4(INADDR_LOOPBACK, 0);
+         uint16_t port = rootServer.getBoundPort();
+         CPPUNIT_ASSERT(port != 0);
+
+         TcpClientPort leafClient(leafRouter);
+         leafClient.setCompactHeaders(clientCompact);
+         CPPUNIT_ASSERT(leafClient.setCompression(64));
+         leafClient.initV4(INADDR_LOOPBACK, port);
+
+         std::auto_ptr<IQueue> serverQueue(new Queue("srv", rootRouter));
+         std::auto_ptr<ILocalIfc> serverIfc(serverQueue->registerInterface(SampleFactory::getInstance(), "ping"));
+
+         std::auto_ptr<IQueue> clientQueue(new Queue("cnt", leafRouter));
+         std::auto_ptr<IRemoteIfc> clientIfc(clientQueue->connectInterface("ping", SampleFactory::getInstance()));
+
+         std::string payload;
+         payload.resize(4096, 'j');
+
+         clientIfc->sendMessage(std::auto_ptr<TsdEvent>(new StringInd(payload)));
+         std::auto_ptr<TsdEvent> msg1 = serverQueue->readMessage(3000);
+         CPPUNIT_ASSERT(msg1.get() != NULL);
+         StringInd *realMsg1 = dynamic_cast<StringInd*>(msg1.get());
+         CPPUNIT_ASSERT(realMsg1 != NULL);
+         CPPUNIT_ASSERT(realMsg1->m_string == payload);
+
+         serverIfc->sendMessage(msg1->getSenderAddr(), std::auto_ptr<TsdEvent>(new StringInd(payload)));
+         std::auto_ptr<TsdEvent> msg2 = clientQueue->readMessage(3000);
+         CPPUNIT_ASSERT(msg2.get() != NULL);
+         StringInd *realMsg2 = dynamic_cast<StringInd*>(msg2.get());
+         CPPUNIT_ASSERT(realMsg2 != NULL);
+         CPPUNIT_ASSERT(realMsg2->m_string == payload);
+
+         bool compact = serverCompact && clientCompact;
+         CPPUNIT_ASSERT_EQUAL(compact, leafClient.getCompressionStats().m_compressedPackets > 0);
+         CPPUNIT_ASSERT_EQUAL(compact, rootServer.getCompressionStats().m_compressedPackets > 0);
+
+         leafClient.disconnect();
+         rootServer.disconnect();
+      }
+   }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TcpConnectionTestSuite);
+
+/**
+ * Same transport tests with a server that spreads its connections over two
+ * I/O threads.
+ *
+ * Connections are assigned to the thread with the fewest connections, i.e.
+ * consecutive clients of a test alternate between both threads.
+ */
+class TcpPoolConnectionTestSuite
+   : public TcpConnectionTestSuite
+{
+   CPPUNIT_TEST_SUB_SUITE(TcpPoolConnectionTestSuite, TransportSuite);
+
+   // special tests from TransportSuite
+   CPPUNIT_TEST(test_bulk_multi);
+   CPPUNIT_TEST(test_bulk_connect_disconnect);
+   CPPUNIT_TEST(test_bulk_disconnect_busy);
+   CPPUNIT_TEST_SUITE_END();
+
+public:
+   TcpPoolConnectionTestSuite()
+      : TcpConnectionTestSuite(2)
+   { }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TcpPoolConnectionTestSuite);
+
+/**
+ * Same transport tests with compact headers enabled on both sides.
+ */
+class TcpCompactConnectionTestSuite
+   : public TcpConnectionTestSuite
+{
+   CPPUNIT_TEST_SUB_SUITE(TcpCompactConnectionTestSuite, TransportSuite);
+
+   // special tests from TransportSuite
+   CPPUNIT_TEST(test_bulk_multi);
+   CPPUNIT_TEST(test_bulk_connect_disconnect);
+   CPPUNIT_TEST_SUITE_END();
+
+public:
+   TcpCompactConnectionTestSuite()
+      : TcpConnectionTestSuite(1, true)
+   { }
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TcpCompactConnectionTestSuite);
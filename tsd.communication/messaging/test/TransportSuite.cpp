@@ -506,3 +506,52 @@ void TransportSuite::test_bulk_connect_disconnect()
 
    beacon.shutdown();
 }
+
+/**
+ * Test disconnects while the server is busy.
+ *
+ * Four routers are connected to a common "root" router. Two of them exchange
+ * 100000 messages as fast as possible while the other two disconnect. A
+ * transport that serves its connections from several I/O threads thus sees
+ * connections close on threads that are busy with others. The message flow
+ * must not be disturbed and new connections must still be accepted.
+ */
+void TransportSuite::test_bulk_disconnect_busy()
+{
+   Router rootRouter("root");
+   Router leafA1Router("leafA1");
+   Router leafA2Router("leafA2");
+   Router leafB1Router("leafB1");
+   Router leafB2Router("leafB2");
+
+   // connect all routers
+   std::auto_ptr<IConnection> a1Connection(createConnection(rootRouter, leafA1Router));
+   std::auto_ptr<IConnection> a2Connection(createConnection(rootRouter, leafA2Router));
+   std::auto_ptr<IConnection> b1Connection(createConnection(rootRouter, leafB1Router));
+   std::auto_ptr<IConnection> b2Connection(createConnection(rootRouter, leafB2Router));
+
+   // start message flow and drop the idle connections meanwhile
+   BulkPair pair;
+   pair.init(leafA1Router, leafA2Router, "a", 100000);
+   b1Connection.reset();
+   b2Connection.reset();
+
+   // wait for end
+   pair.finish();
+
+   // server must still be usable
+   Router leafC1Router("leafC1");
+   std::auto_ptr<IConnection> c1Connection(createConnection(rootRouter, leafC1Router));
+
+   std::auto_ptr<IQueue> q1(new Queue("server", rootRouter));
+   std::auto_ptr<ILocalIfc> serverIfc(
+      q1->registerInterface(SampleFactory::getInstance(), "test.busy"));
+
+   std::auto_ptr<IQueue> q2(new Queue("client", leafC1Router));
+   std::auto_ptr<IRemoteIfc> clientIfc(
+      q2->connectInterface("test.busy", SampleFactory::getInstance()));
+
+   clientIfc->sendMessage(std::auto_ptr<TsdEvent>(new StringInd("foobar")));
+   std::auto_ptr<TsdEvent> msg = q1->readMessage(3000);
+   CPPUNIT_ASSERT(msg.get() != NULL);
+}
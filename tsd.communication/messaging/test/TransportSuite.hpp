@@ -48,6 +48,7 @@ public:
 
    void test_bulk_multi();
    void test_bulk_connect_disconnect();
+   void test_bulk_disconnect_busy();
 };
 
 } } }
@@ -31,6 +31,9 @@ class ILocalIfcMock : public ILocalIfc
       MOCK_METHOD1(broadcastMessage,
                    void(tsd::communication::event::TsdEvent& msg));
 
+      MOCK_METHOD1(setLastValueCache,
+                   void(const std::vector<uint32_t>& events));
+
       MonitorRef_t monitor(std::auto_ptr<event::TsdEvent> event, event::IfcAddr_t addr)
       {
           monitor(*event, addr);
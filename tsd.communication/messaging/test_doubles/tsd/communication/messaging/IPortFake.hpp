@@ -0,0 +1,230 @@
+//////////////////////////////////////////////////////////////////////
+/// @file IPortFake.hpp
+/// @brief Header file for Fake for IPort
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#ifndef TSD_COMMUNICATION_MESSAGING_IPORTFAKE_HPP
+#define TSD_COMMUNICATION_MESSAGING_IPORTFAKE_HPP
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <tsd/common/ipc/networkinteger.h>
+#include <tsd/communication/messaging/IPort.hpp>
+#include <tsd/communication/messaging/Packet.hpp>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+
+/**
+ * Fakeclass for IPort
+ *
+ * Port without a peer. The test plays the peer: it injects the received
+ * packets and inspects the sent ones. Everything that a real port does on its
+ * io-thread runs on the thread of the fake in the order it was posted.
+ *
+ * @brief Fakeclass for IPort
+ */
+class IPortFake : public IPort
+{
+   std::mutex                           m_mutex;
+   std::condition_variable              m_condition;
+   std::deque<std::function<void()>>    m_actions;
+   std::vector<std::shared_ptr<Packet>> m_sent;
+   std::thread                          m_thread;
+   bool                                 m_stop;
+
+   void run()
+   {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      while (!m_stop)
+      {
+         if (m_actions.empty())
+         {
+            m_condition.wait(lock);
+            continue;
+         }
+         std::function<void()> action = m_actions.front();
+         m_actions.pop_front();
+         lock.unlock();
+         action();
+         lock.lock();
+      }
+   }
+
+   void post(const std::function<void()>& action)
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_actions.push_back(action);
+      m_condition.notify_all();
+   }
+
+public:
+   using IPort::isSuspended;
+   using IPort::resumeUpstream;
+   using IPort::setPersistent;
+
+   explicit IPortFake(Router& router) : IPort(router), m_stop(false)
+   {
+   }
+
+   ~IPortFake()
+   {
+      finish();
+   }
+
+   bool startPort() override
+   {
+      m_stop   = false;
+      m_thread = std::thread(&IPortFake::run, this);
+      return true;
+   }
+
+   void stopPort() override
+   {
+      {
+         std::lock_guard<std::mutex> lock(m_mutex);
+         m_stop = true;
+         m_condition.notify_all();
+      }
+      if (m_thread.joinable())
+      {
+         m_thread.join();
+      }
+   }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+   bool sendPacket(std::auto_ptr<Packet> pkt) override
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_sent.push_back(std::shared_ptr<Packet>(pkt.release()));
+      m_condition.notify_all();
+      return true;
+   }
+
+   void inject(std::auto_ptr<Packet> pkt)
+   {
+      std::shared_ptr<Packet> shared(pkt.release());
+      post([this, shared]() { receivedPacket(std::auto_ptr<Packet>(new Packet(*shared))); });
+   }
+
+   /**
+    * Let the peer offer the subnet @p addr, see the DHCP wire format in
+    * IPort.cpp.
+    */
+   void injectOffer(tsd::communication::event::IfcAddr_t addr, uint8_t prefixLength, uint8_t flags)
+   {
+      struct
+      {
+         tsd::common::ipc::NetworkInteger<uint32_t> m_version;
+         uint8_t                                    m_prefixLength;
+         uint8_t                                    m_flags;
+         uint8_t                                    m_padding[2];
+         tsd::common::ipc::NetworkInteger<uint64_t> m_addr;
+         tsd::common::ipc::NetworkInteger<uint64_t> m_nameServer;
+      } offer;
+      std::memset(&offer, 0, sizeof(offer));
+      offer.m_version      = 1U;
+      offer.m_prefixLength = prefixLength;
+      offer.m_flags        = flags;
+      offer.m_addr         = addr;
+      offer.m_nameServer   = addr | 1U;
+      inject(std::auto_ptr<Packet>(
+         new Packet(Packet::DHCP_OFFER, 0, 0, 0, reinterpret_cast<const char*>(&offer), sizeof(offer))));
+   }
+#pragma GCC diagnostic pop
+
+   void link()
+   {
+      post([this]() { connected(); });
+   }
+
+   void unlink()
+   {
+      post([this]() { disconnected(); });
+   }
+
+   /**
+    * Wait until everything that was posted before has been processed.
+    */
+   void sync()
+   {
+      std::shared_ptr<std::promise<void>> done(std::make_shared<std::promise<void>>());
+      std::future<void>                   finished(done->get_future());
+      post([done]() { done->set_value(); });
+      finished.wait();
+   }
+
+   /**
+    * Wait for the @p count-th packet of @p type that the port sent.
+    *
+    * @return The packet or null if it was not sent within one second.
+    */
+   std::shared_ptr<Packet> waitSent(Packet::Type type, size_t count = 1U)
+   {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      std::shared_ptr<Packet>      found;
+      m_condition.wait_for(lock, std::chrono::seconds(1), [&]() {
+         size_t seen = 0U;
+         for (const std::shared_ptr<Packet>& pkt : m_sent)
+         {
+            if ((pkt->getType() == type) && (++seen == count))
+            {
+               found = pkt;
+               return true;
+            }
+         }
+         return false;
+      });
+      return found;
+   }
+
+   size_t countSent(Packet::Type type)
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      size_t                      seen = 0U;
+      for (const std::shared_ptr<Packet>& pkt : m_sent)
+      {
+         if (pkt->getType() == type)
+         {
+            ++seen;
+         }
+      }
+      return seen;
+   }
+
+   /**
+    * Event IDs of the sent packets of @p type in the order they were sent.
+    */
+   std::vector<uint32_t> sentEvents(Packet::Type type)
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      std::vector<uint32_t>       events;
+      for (const std::shared_ptr<Packet>& pkt : m_sent)
+      {
+         if (pkt->getType() == type)
+         {
+            events.push_back(pkt->getEventId());
+         }
+      }
+      return events;
+   }
+};
+
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
+
+#endif // TSD_COMMUNICATION_MESSAGING_IPORTFAKE_HPP
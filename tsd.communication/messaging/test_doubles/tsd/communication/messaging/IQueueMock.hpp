@@ -69,6 +69,11 @@ class IQueueMock : public IQueue
                                                           IMessageSelector *selector));
 
 
+      MOCK_METHOD4(readMessages,
+                   size_t(std::vector<tsd::communication::event::TsdEvent*> &events,
+                          size_t max, uint32_t timeout, IMessageSelector *selector));
+
+
       void sendSelfMessage(std::auto_ptr<tsd::communication::event::TsdEvent> msg)
       {
          sendSelfMessage(*msg);
@@ -86,6 +91,21 @@ class IQueueMock : public IQueue
 
       MOCK_METHOD1(stopTimer,
                    bool(TimerRef_t timer));
+
+      MOCK_METHOD3(setCapacity,
+                   void(uint32_t capacity, OverflowPolicy policy, uint32_t blockTimeout));
+
+      MOCK_METHOD0(getDroppedMessages,
+                   uint64_t());
+
+      MOCK_METHOD1(setPriority,
+                   void(MessagePriority priority));
+
+      MOCK_METHOD1(setTimeToLive,
+                   void(uint32_t ms));
+
+      MOCK_METHOD0(getExpiredMessages,
+                   uint64_t());
 };
 
 }
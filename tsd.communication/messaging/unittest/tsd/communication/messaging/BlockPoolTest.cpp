@@ -0,0 +1,113 @@
+//////////////////////////////////////////////////////////////////////
+/// @file BlockPoolTest.cpp
+/// @brief Unit Tests to test BlockPool
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#include "BlockPoolTest.hpp"
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+#include <tsd/communication/messaging/BlockPool.hpp>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+
+void BlockPoolTest::test_GetBlockSize_DifferentSizes_RoundedUpToSizeClass()
+{
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Smallest class is not as expected", size_t{BlockPool::MIN_BLOCK},
+                                BlockPool::getBlockSize(1));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Exact class size is not expected to change", size_t{256},
+                                BlockPool::getBlockSize(256));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Size is expected to be rounded up", size_t{512}, BlockPool::getBlockSize(257));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Largest class is not as expected", size_t{BlockPool::MAX_BLOCK},
+                                BlockPool::getBlockSize(BlockPool::MAX_BLOCK));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Large size is not expected to change", size_t{BlockPool::MAX_BLOCK + 1},
+                                BlockPool::getBlockSize(BlockPool::MAX_BLOCK + 1));
+}
+
+void BlockPoolTest::test_Allocate_AfterRelease_BlockReused()
+{
+   void* first = BlockPool::allocate(100);
+   std::memset(first, 0xa5, BlockPool::getBlockSize(100));
+   BlockPool::release(first, 100);
+
+   void* second = BlockPool::allocate(120);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Block of same size class is expected to be reused", first, second);
+   BlockPool::release(second, 120);
+}
+
+void BlockPoolTest::test_Release_OnOtherThread_BlocksUsable()
+{
+   const size_t       count = 1000;
+   std::vector<void*> blocks;
+
+   for (unsigned round = 0; round < 3; round++) {
+      for (size_t i = 0; i < count; i++) {
+         blocks.push_back(BlockPool::allocate(64));
+         std::memset(blocks.back(), static_cast<int>(i), 64);
+      }
+      std::set<void*> distinct(blocks.begin(), blocks.end());
+      CPPUNIT_ASSERT_EQUAL_MESSAGE("Blocks are expected to be distinct", count, distinct.size());
+
+      std::thread other([&blocks]() {
+         for (size_t i = 0; i < blocks.size(); i++) {
+            BlockPool::release(blocks[i], 64);
+         }
+      });
+      other.join();
+      blocks.clear();
+   }
+}
+
+void BlockPoolTest::test_Release_ManyLargeBlocks_IdleBytesBounded()
+{
+   const size_t       count = 1000;
+   std::vector<void*> blocks;
+   size_t             before = BlockPool::getIdleBytes();
+
+   for (size_t i = 0; i < count; i++) {
+      blocks.push_back(BlockPool::allocate(BlockPool::MAX_BLOCK));
+   }
+   for (size_t i = 0; i < blocks.size(); i++) {
+      BlockPool::release(blocks[i], BlockPool::MAX_BLOCK);
+   }
+
+   CPPUNIT_ASSERT_MESSAGE("Released blocks are expected to be given back to the heap",
+                          BlockPool::getIdleBytes() < before + 1024u * 1024u);
+}
+
+void BlockPoolTest::test_Release_ThreadExits_CachedBlocksKept()
+{
+   const size_t count = 4;
+   size_t       allocated = 0;
+   size_t       released = 0;
+
+   std::thread other([&allocated, &released]() {
+      std::vector<void*> blocks;
+      for (size_t i = 0; i < count; i++) {
+         blocks.push_back(BlockPool::allocate(256));
+      }
+      allocated = BlockPool::getIdleBytes();
+      for (size_t i = 0; i < blocks.size(); i++) {
+         BlockPool::release(blocks[i], 256);
+      }
+      released = BlockPool::getIdleBytes();
+   });
+   other.join();
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Released blocks are expected to stay in the cache of the thread", allocated,
+                                released);
+   CPPUNIT_ASSERT_MESSAGE("Cached blocks are expected to be kept when the thread exits",
+                          BlockPool::getIdleBytes() >= allocated + count * 256);
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(BlockPoolTest);
+
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
@@ -0,0 +1,75 @@
+//////////////////////////////////////////////////////////////////////
+/// @file BlockPoolTest.hpp
+/// @brief Header file for Unit Tests to test BlockPool
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#ifndef TSD_COMMUNICATION_MESSAGING_BLOCKPOOLTEST_HPP
+#define TSD_COMMUNICATION_MESSAGING_BLOCKPOOLTEST_HPP
+
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+
+/**
+ * Testclass for BlockPool
+ *
+ * @brief Testclass for BlockPool
+ */
+class BlockPoolTest : public CPPUNIT_NS::TestFixture
+{
+public:
+   /**
+    * @brief Test scenario: sizes below, inside and above the size classes
+    *
+    * @tsd_testobject tsd::communication::messaging::BlockPool::getBlockSize
+    * @tsd_testexpected rounded up to the size class, large sizes unchanged
+    */
+   void test_GetBlockSize_DifferentSizes_RoundedUpToSizeClass();
+   /**
+    * @brief Test scenario: block released and same size allocated again
+    *
+    * @tsd_testobject tsd::communication::messaging::BlockPool::allocate
+    * @tsd_testexpected released block reused
+    */
+   void test_Allocate_AfterRelease_BlockReused();
+   /**
+    * @brief Test scenario: blocks allocated on one thread and released on another
+    *
+    * @tsd_testobject tsd::communication::messaging::BlockPool::release
+    * @tsd_testexpected blocks stay usable and distinct
+    */
+   void test_Release_OnOtherThread_BlocksUsable();
+   /**
+    * @brief Test scenario: many blocks of the largest size class released
+    *
+    * @tsd_testobject tsd::communication::messaging::BlockPool::release
+    * @tsd_testexpected only a bounded number of bytes kept for reuse
+    */
+   void test_Release_ManyLargeBlocks_IdleBytesBounded();
+   /**
+    * @brief Test scenario: blocks released into the cache of a thread that exits
+    *
+    * @tsd_testobject tsd::communication::messaging::BlockPool::release
+    * @tsd_testexpected cached blocks kept for reuse after the thread exited
+    */
+   void test_Release_ThreadExits_CachedBlocksKept();
+
+   CPPUNIT_TEST_SUITE(BlockPoolTest);
+   CPPUNIT_TEST(test_GetBlockSize_DifferentSizes_RoundedUpToSizeClass);
+   CPPUNIT_TEST(test_Allocate_AfterRelease_BlockReused);
+   CPPUNIT_TEST(test_Release_OnOtherThread_BlocksUsable);
+   CPPUNIT_TEST(test_Release_ManyLargeBlocks_IdleBytesBounded);
+   CPPUNIT_TEST(test_Release_ThreadExits_CachedBlocksKept);
+   CPPUNIT_TEST_SUITE_END();
+};
+
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
+
+#endif // TSD_COMMUNICATION_MESSAGING_BLOCKPOOLTEST_HPP
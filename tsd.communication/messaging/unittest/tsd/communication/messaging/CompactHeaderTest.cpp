@@ -0,0 +1,227 @@
+//////////////////////////////////////////////////////////////////////
+/// @file CompactHeaderTest.cpp
+/// @brief Unit Tests to test CompactHeader
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#include "CompactHeaderTest.hpp"
+#include <cstring>
+#include <memory>
+#include <string>
+#include <tsd/communication/messaging/CompactHeader.hpp>
+#include <tsd/communication/messaging/Packet.hpp>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+namespace {
+const tsd::communication::event::IfcAddr_t LOCAL_BASE{0x0000012300000000ull};
+const tsd::communication::event::IfcAddr_t PEER_BASE{0x0000012301000000ull};
+const char*                                DEFAULT_BUFFER{"testbuffer"};
+const size_t                               FIXED_HEADER_SIZE{28};
+
+CompactHeader receiverOf(const CompactHeader& tx)
+{
+   std::unique_ptr<Packet> marker{tx.createMarker().release()};
+   CompactHeader           rx;
+   CPPUNIT_ASSERT_MESSAGE("Marker is expected to be valid", rx.parseMarker(*marker));
+   return rx;
+}
+
+void checkFields(const HeaderFields& hdr, Packet& pkt)
+{
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Type is not as expected", static_cast<uint8_t>(pkt.getType()), hdr.m_type);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Length is not as expected", pkt.getBufferLength(), static_cast<size_t>(hdr.m_msgLen));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Event id is not as expected", pkt.getEventId(), hdr.m_eventId);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Sender is not as expected", pkt.getSenderAddr(), hdr.m_senderAddr);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Receiver is not as expected", pkt.getReceiverAddr(), hdr.m_receiverAddr);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Priority is not as expected", static_cast<uint8_t>(pkt.getPriority()), hdr.m_priority);
+}
+}
+
+void CompactHeaderTest::test_Encode_PortAddresses_ShortHeaderDecoded()
+{
+   CompactHeader tx(LOCAL_BASE, PEER_BASE);
+   CompactHeader rx = receiverOf(tx);
+   Packet        pkt(Packet::UNICAST_MESSAGE, LOCAL_BASE | 42u, PEER_BASE | 7u, 0x1234, DEFAULT_BUFFER,
+              static_cast<uint32_t>(strlen(DEFAULT_BUFFER)));
+
+   uint8_t buf[CompactHeader::MAX_SIZE];
+   size_t  len = tx.encode(buf, pkt);
+   CPPUNIT_ASSERT_MESSAGE("Header is expected to be smaller than the fixed one", len < FIXED_HEADER_SIZE / 2);
+
+   HeaderFields hdr;
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Whole header is expected to be consumed", len, rx.decode(buf, len, hdr));
+   checkFields(hdr, pkt);
+}
+
+void CompactHeaderTest::test_Encode_UnrelatedAddresses_AllFieldsDecoded()
+{
+   CompactHeader tx(LOCAL_BASE, PEER_BASE);
+   CompactHeader rx = receiverOf(tx);
+   Packet        pkt(static_cast<Packet::Type>(0xff), 0xffffffffffffffffull, 0x0000004500000001ull, 0xffffffffu, NULL, 0);
+
+   uint8_t buf[CompactHeader::MAX_SIZE];
+   size_t  len = tx.encode(buf, pkt);
+   CPPUNIT_ASSERT_MESSAGE("Header is expected to fit into MAX_SIZE", len <= CompactHeader::MAX_SIZE);
+
+   HeaderFields hdr;
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Whole header is expected to be consumed", len, rx.decode(buf, len, hdr));
+   checkFields(hdr, pkt);
+}
+
+void CompactHeaderTest::test_Decode_Truncated_ZeroReturned()
+{
+   CompactHeader tx(LOCAL_BASE, PEER_BASE);
+   Packet        pkt(Packet::MULTICAST_MESSAGE, PEER_BASE | 3u, 0x0000777700000005ull, 300, DEFAULT_BUFFER,
+              static_cast<uint32_t>(strlen(DEFAULT_BUFFER)));
+
+   uint8_t buf[CompactHeader::MAX_SIZE];
+   size_t  len = tx.encode(buf, pkt);
+
+   HeaderFields hdr;
+   for (size_t i = 0; i < len; i++) {
+      CPPUNIT_ASSERT_EQUAL_MESSAGE("Incomplete header must not be decoded", static_cast<size_t>(0),
+                                   receiverOf(tx).decode(buf, i, hdr));
+   }
+}
+
+void CompactHeaderTest::test_Encode_NonDefaultPriority_PriorityDecoded()
+{
+   CompactHeader tx(LOCAL_BASE, PEER_BASE);
+   CompactHeader rx = receiverOf(tx);
+   Packet        pkt(Packet::UNICAST_MESSAGE, LOCAL_BASE | 42u, PEER_BASE | 7u, 0x1234, DEFAULT_BUFFER,
+              static_cast<uint32_t>(strlen(DEFAULT_BUFFER)));
+
+   uint8_t buf[CompactHeader::MAX_SIZE];
+   size_t  defaultLen = tx.encode(buf, pkt);
+
+   pkt.setPriority(PRIORITY_BULK);
+   size_t len = tx.encode(buf, pkt);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Priority is expected to cost one byte", defaultLen + 1, len);
+
+   HeaderFields hdr;
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Whole header is expected to be consumed", len, rx.decode(buf, len, hdr));
+   checkFields(hdr, pkt);
+   for (size_t i = 0; i < len; i++) {
+      CPPUNIT_ASSERT_EQUAL_MESSAGE("Incomplete header must not be decoded", static_cast<size_t>(0),
+                                   rx.decode(buf, i, hdr));
+   }
+}
+
+void CompactHeaderTest::test_Encode_Fragments_FlagsAndTotalDecoded()
+{
+   CompactHeader tx(LOCAL_BASE, PEER_BASE);
+   CompactHeader rx = receiverOf(tx);
+   std::string   payload(100000, 'x');
+   Packet        pkt(Packet::UNICAST_MESSAGE, LOCAL_BASE | 42u, PEER_BASE | 7u, 0x1234, payload.data(),
+              static_cast<uint32_t>(payload.size()));
+
+   uint8_t      buf[CompactHeader::MAX_SIZE];
+   HeaderFields hdr;
+   size_t       len = tx.encode(buf, pkt, 16384, FRAGMENT_MORE);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Whole header is expected to be consumed", len, rx.decode(buf, len, hdr));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Flags are not as expected", static_cast<uint8_t>(FRAGMENT_MORE), hdr.m_fragment);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Total length is not as expected", 100000u, hdr.m_totalLen);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Length is not as expected", 16384u, hdr.m_msgLen);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Priority is not as expected", static_cast<uint8_t>(PRIORITY_NORMAL), hdr.m_priority);
+   for (size_t i = 0; i < len; i++) {
+      CPPUNIT_ASSERT_EQUAL_MESSAGE("Incomplete header must not be decoded", static_cast<size_t>(0),
+                                   rx.decode(buf, i, hdr));
+   }
+
+   pkt.setPriority(PRIORITY_BULK);
+   len = tx.encode(buf, pkt, 1696, FRAGMENT_CONT);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Whole header is expected to be consumed", len, rx.decode(buf, len, hdr));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Flags are not as expected", static_cast<uint8_t>(FRAGMENT_CONT), hdr.m_fragment);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Total length is only expected in the first fragment", 0u, hdr.m_totalLen);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Length is not as expected", 1696u, hdr.m_msgLen);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Priority is not as expected", static_cast<uint8_t>(PRIORITY_BULK), hdr.m_priority);
+}
+
+void CompactHeaderTest::test_Encode_TimeToLive_TimeToLiveDecoded()
+{
+   CompactHeader tx(LOCAL_BASE, PEER_BASE);
+   CompactHeader rx = receiverOf(tx);
+   std::string   payload(100000, 'x');
+   Packet        pkt(Packet::UNICAST_MESSAGE, LOCAL_BASE | 42u, PEER_BASE | 7u, 0x1234, payload.data(),
+              static_cast<uint32_t>(payload.size()));
+
+   uint8_t      buf[CompactHeader::MAX_SIZE];
+   HeaderFields hdr;
+   size_t       plain = tx.encode(buf, pkt);
+   size_t       len   = tx.encode(buf, pkt, static_cast<uint32_t>(payload.size()), 0, 250u);
+   CPPUNIT_ASSERT_MESSAGE("Extension and time to live are expected to be added", len > plain);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Whole header is expected to be consumed", len, rx.decode(buf, len, hdr));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Time to live is not as expected", 250u, hdr.m_timeToLive);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Flags are not as expected", static_cast<uint8_t>(0), hdr.m_fragment);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Length is not as expected", 100000u, hdr.m_msgLen);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Priority is not as expected", static_cast<uint8_t>(PRIORITY_NORMAL), hdr.m_priority);
+
+   len = tx.encode(buf, pkt, 16384, FRAGMENT_MORE, 0xffffffffu);
+   CPPUNIT_ASSERT_MESSAGE("Header is expected to fit", len <= static_cast<size_t>(CompactHeader::MAX_SIZE));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Whole header is expected to be consumed", len, rx.decode(buf, len, hdr));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Time to live is not as expected", 0xffffffffu, hdr.m_timeToLive);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Total length is not as expected", 100000u, hdr.m_totalLen);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Length is not as expected", 16384u, hdr.m_msgLen);
+   for (size_t i = 0; i < len; i++) {
+      CPPUNIT_ASSERT_EQUAL_MESSAGE("Incomplete header must not be decoded", static_cast<size_t>(0),
+                                   rx.decode(buf, i, hdr));
+   }
+
+   len = tx.encode(buf, pkt);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Whole header is expected to be consumed", len, rx.decode(buf, len, hdr));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Time to live is not expected", 0u, hdr.m_timeToLive);
+}
+
+void CompactHeaderTest::test_Encode_Conflatable_ConflatableDecoded()
+{
+   CompactHeader tx(LOCAL_BASE, PEER_BASE);
+   CompactHeader rx = receiverOf(tx);
+   Packet        pkt(Packet::MULTICAST_MESSAGE, LOCAL_BASE | 42u, PEER_BASE | 7u, 0x1234, "state", 5);
+
+   uint8_t      buf[CompactHeader::MAX_SIZE];
+   HeaderFields hdr;
+   size_t       len = tx.encode(buf, pkt);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Whole header is expected to be consumed", len, rx.decode(buf, len, hdr));
+   CPPUNIT_ASSERT_MESSAGE("Message is not expected to be conflatable", !hdr.m_conflatable);
+
+   pkt.setConflatable(true);
+   len = tx.encode(buf, pkt);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Whole header is expected to be consumed", len, rx.decode(buf, len, hdr));
+   CPPUNIT_ASSERT_MESSAGE("Message is expected to be conflatable", hdr.m_conflatable);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Priority is not as expected", static_cast<uint8_t>(PRIORITY_NORMAL), hdr.m_priority);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Event is not as expected", 0x1234u, hdr.m_eventId);
+}
+
+void CompactHeaderTest::test_ParseMarker_CreatedMarker_BasesTakenOver()
+{
+   CompactHeader tx(LOCAL_BASE, PEER_BASE);
+   tx.setCodecs(0x3u);
+   tx.setFeatures(CompactHeader::FEATURE_FRAGMENTS);
+   std::unique_ptr<Packet> marker{tx.createMarker().release()};
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Type is not as expected", Packet::COMPACT_HEADER, marker->getType());
+
+   CompactHeader rx;
+   CPPUNIT_ASSERT_MESSAGE("Marker is expected to be valid", rx.parseMarker(*marker));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Local base is not as expected", LOCAL_BASE, rx.getLocalBase());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Peer base is not as expected", PEER_BASE, rx.getPeerBase());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Codecs are not as expected", 0x3u, rx.getCodecs());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Features are not as expected",
+                                static_cast<uint32_t>(CompactHeader::FEATURE_FRAGMENTS), rx.getFeatures());
+
+   Packet invalid(Packet::COMPACT_HEADER, 0, 0, 0, DEFAULT_BUFFER, static_cast<uint32_t>(strlen(DEFAULT_BUFFER)));
+   CPPUNIT_ASSERT_MESSAGE("Marker with wrong size is expected to be rejected", !rx.parseMarker(invalid));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Bases must not change", LOCAL_BASE, rx.getLocalBase());
+
+   CompactHeader answer = rx.reverse();
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Answer is expected to swap the bases", PEER_BASE, answer.getLocalBase());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Answer is expected to swap the bases", LOCAL_BASE, answer.getPeerBase());
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(CompactHeaderTest);
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
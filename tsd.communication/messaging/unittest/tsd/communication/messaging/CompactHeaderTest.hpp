@@ -0,0 +1,99 @@
+//////////////////////////////////////////////////////////////////////
+/// @file CompactHeaderTest.hpp
+/// @brief Header file for Unit Tests to test CompactHeader
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#ifndef TSD_COMMUNICATION_MESSAGING_COMPACTHEADERTEST_HPP
+#define TSD_COMMUNICATION_MESSAGING_COMPACTHEADERTEST_HPP
+
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+
+/**
+ * Testclass for CompactHeader
+ *
+ * @brief Testclass for CompactHeader
+ */
+class CompactHeaderTest : public CPPUNIT_NS::TestFixture
+{
+public:
+   /**
+    * @brief Test scenario: addresses relative to the bases of the port
+    *
+    * @tsd_testobject tsd::communication::messaging::CompactHeader::encode
+    * @tsd_testexpected header is smaller than the fixed one and decoded by the peer
+    */
+   void test_Encode_PortAddresses_ShortHeaderDecoded();
+   /**
+    * @brief Test scenario: addresses unrelated to the bases and maximum field values
+    *
+    * @tsd_testobject tsd::communication::messaging::CompactHeader::encode
+    * @tsd_testexpected header fits into MAX_SIZE and all fields decoded
+    */
+   void test_Encode_UnrelatedAddresses_AllFieldsDecoded();
+   /**
+    * @brief Test scenario: header is truncated
+    *
+    * @tsd_testobject tsd::communication::messaging::CompactHeader::decode
+    * @tsd_testexpected zero returned for every incomplete prefix
+    */
+   void test_Decode_Truncated_ZeroReturned();
+   /**
+    * @brief Test scenario: message with a priority other than normal encoded
+    *
+    * @tsd_testobject tsd::communication::messaging::CompactHeader::encode
+    * @tsd_testexpected one extra byte used, priority decoded
+    */
+   void test_Encode_NonDefaultPriority_PriorityDecoded();
+   /**
+    * @brief Test scenario: first and last fragment of a large message encoded
+    *
+    * @tsd_testobject tsd::communication::messaging::CompactHeader::encode
+    * @tsd_testexpected fragment flags decoded, total length only in the first fragment
+    */
+   void test_Encode_Fragments_FlagsAndTotalDecoded();
+   /**
+    * @brief Test scenario: encode message with time to live, whole and as first fragment
+    *
+    * @tsd_testobject tsd::communication::messaging::CompactHeader::encode
+    * @tsd_testexpected time to live decoded next to total length, zero if not sent
+    */
+   void test_Encode_TimeToLive_TimeToLiveDecoded();
+   /**
+    * @brief Test scenario: encode a conflatable message
+    *
+    * @tsd_testobject tsd::communication::messaging::CompactHeader::encode
+    * @tsd_testexpected flag decoded from the extension
+    */
+   void test_Encode_Conflatable_ConflatableDecoded();
+   /**
+    * @brief Test scenario: marker created and parsed
+    *
+    * @tsd_testobject tsd::communication::messaging::CompactHeader::parseMarker
+    * @tsd_testexpected bases, codecs and features taken over from marker, invalid markers rejected, answer swaps bases
+    */
+   void test_ParseMarker_CreatedMarker_BasesTakenOver();
+
+   CPPUNIT_TEST_SUITE(CompactHeaderTest);
+   CPPUNIT_TEST(test_Encode_PortAddresses_ShortHeaderDecoded);
+   CPPUNIT_TEST(test_Encode_UnrelatedAddresses_AllFieldsDecoded);
+   CPPUNIT_TEST(test_Decode_Truncated_ZeroReturned);
+   CPPUNIT_TEST(test_Encode_NonDefaultPriority_PriorityDecoded);
+   CPPUNIT_TEST(test_Encode_Fragments_FlagsAndTotalDecoded);
+   CPPUNIT_TEST(test_Encode_TimeToLive_TimeToLiveDecoded);
+   CPPUNIT_TEST(test_Encode_Conflatable_ConflatableDecoded);
+   CPPUNIT_TEST(test_ParseMarker_CreatedMarker_BasesTakenOver);
+   CPPUNIT_TEST_SUITE_END();
+};
+
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
+
+#endif // TSD_COMMUNICATION_MESSAGING_COMPACTHEADERTEST_HPP
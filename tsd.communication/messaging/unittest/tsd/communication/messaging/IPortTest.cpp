@@ -0,0 +1,257 @@
+//////////////////////////////////////////////////////////////////////
+/// @file IPortTest.cpp
+/// @brief Unit Tests to test IPort
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#include "IPortTest.hpp"
+#include <cstring>
+#include <memory>
+#include <tsd/common/ipc/networkinteger.h>
+#include <tsd/common/logging/LoggingManager.hpp>
+#include <tsd/communication/messaging/IPortFake.hpp>
+#include <tsd/communication/messaging/Packet.hpp>
+#include <tsd/communication/messaging/Router.hpp>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+
+namespace {
+
+using tsd::common::ipc::NetworkInteger;
+using tsd::communication::event::IfcAddr_t;
+
+// wire format of the DHCP packets, see IPort.cpp
+struct DhcpOffer
+{
+   NetworkInteger<uint32_t> m_version;
+   uint8_t                  m_prefixLength;
+   uint8_t                  m_flags;
+   uint8_t                  m_padding[2];
+   NetworkInteger<uint64_t> m_addr;
+   NetworkInteger<uint64_t> m_nameServer;
+};
+
+struct DhcpRequest
+{
+   NetworkInteger<uint32_t> m_version;
+   uint8_t                  m_prefixLength;
+   uint8_t                  m_padding[3];
+   NetworkInteger<uint64_t> m_addr;
+};
+
+constexpr uint8_t   DHCP_FLAG_REQUEST = 1U;
+constexpr uint8_t   PREFIX_LENGTH     = 8U;
+constexpr IfcAddr_t SUBNET_A          = UINT64_C(0x0100000000000000);
+constexpr IfcAddr_t SUBNET_B          = UINT64_C(0x0200000000000000);
+constexpr IfcAddr_t SUBNET_C          = UINT64_C(0x0500000000000000);
+constexpr IfcAddr_t REMOTE_ADDR       = UINT64_C(0x0300000000000005);
+
+std::auto_ptr<Packet> makeRequest(IfcAddr_t addr)
+{
+   DhcpRequest req;
+   std::memset(&req, 0, sizeof(req));
+   req.m_version      = 1U;
+   req.m_prefixLength = PREFIX_LENGTH;
+   req.m_addr         = addr;
+   return std::auto_ptr<Packet>(
+      new Packet(Packet::DHCP_REQUEST, 0, 0, 0, reinterpret_cast<const char*>(&req), sizeof(req)));
+}
+
+IfcAddr_t offeredAddr(const std::shared_ptr<Packet>& pkt)
+{
+   DhcpOffer offer;
+   std::memset(&offer, 0, sizeof(offer));
+   if (pkt && (pkt->getBufferLength() == sizeof(offer)))
+   {
+      std::memcpy(&offer, pkt->getBufferPtr(), sizeof(offer));
+   }
+   return offer.m_addr;
+}
+
+IfcAddr_t requestedAddr(const std::shared_ptr<Packet>& pkt)
+{
+   DhcpRequest req;
+   std::memset(&req, 0, sizeof(req));
+   if (pkt && (pkt->getBufferLength() == sizeof(req)))
+   {
+      std::memcpy(&req, pkt->getBufferPtr(), sizeof(req));
+   }
+   return req.m_addr;
+}
+
+/**
+ * Connect a persistent upstream port to subnet A and break the connection.
+ */
+void connectAndSuspend(IPortFake& port)
+{
+   port.setPersistent(true);
+   port.link();
+   port.injectOffer(SUBNET_A, PREFIX_LENGTH, DHCP_FLAG_REQUEST);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Upstream port not connected", true, port.initUpstream(""));
+   port.unlink();
+   port.sync();
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Port not suspended after disconnect", true, port.isSuspended());
+}
+}
+
+void IPortTest::tearDown()
+{
+   tsd::common::logging::LoggingManager::cleanup();
+}
+
+void IPortTest::test_ProcessDhcpRequest_FreeSubnetRequested_PortMovedAndOffered()
+{
+   Router    router("top");
+   IPortFake port(router);
+   port.link();
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Downstream port not started", true, port.initDownstream());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("First subnet not offered", SUBNET_A, offeredAddr(port.waitSent(Packet::DHCP_OFFER)));
+
+   port.inject(makeRequest(SUBNET_C));
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Requested subnet not offered", SUBNET_C, offeredAddr(port.waitSent(Packet::DHCP_OFFER, 2U)));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Port not moved to requested subnet", SUBNET_C, port.getLocalAddr());
+   IfcAddr_t nameServer = 0U;
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Previous subnet not freed", true, router.reserveDownstreamAddr(SUBNET_A, PREFIX_LENGTH, nameServer));
+}
+
+void IPortTest::test_ProcessDhcpRequest_SubnetInUse_PreviousOfferRepeated()
+{
+   Router    router("top");
+   IPortFake port(router);
+   IfcAddr_t nameServer = 0U;
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Subnet not reserved", true, router.reserveDownstreamAddr(SUBNET_C, PREFIX_LENGTH, nameServer));
+   port.link();
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Downstream port not started", true, port.initDownstream());
+   IfcAddr_t offered = offeredAddr(port.waitSent(Packet::DHCP_OFFER));
+
+   port.inject(makeRequest(SUBNET_C));
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Previous offer not repeated", offered, offeredAddr(port.waitSent(Packet::DHCP_OFFER, 2U)));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Port moved unexpectedly", offered, port.getLocalAddr());
+}
+
+void IPortTest::test_ProcessDhcpRequest_AfterOtherTraffic_RequestIgnored()
+{
+   Router    router("top");
+   IPortFake port(router);
+   port.link();
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Downstream port not started", true, port.initDownstream());
+   IfcAddr_t offered = offeredAddr(port.waitSent(Packet::DHCP_OFFER));
+
+   port.inject(std::auto_ptr<Packet>(new Packet(Packet::UNICAST_MESSAGE, offered + 1U, REMOTE_ADDR)));
+   port.inject(makeRequest(SUBNET_C));
+   port.sync();
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Request answered unexpectedly", size_t(1), port.countSent(Packet::DHCP_OFFER));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Port moved unexpectedly", offered, port.getLocalAddr());
+}
+
+void IPortTest::test_ResumeUpstream_PreviousSubnetOffered_AddressKept()
+{
+   Router    router("leaf");
+   IPortFake port(router);
+   connectAndSuspend(port);
+   IfcAddr_t oldAddr = port.getLocalAddr();
+
+   port.link();
+   port.injectOffer(SUBNET_A, PREFIX_LENGTH, DHCP_FLAG_REQUEST);
+
+   port.sync();
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Port not resumed", true, port.resumeUpstream(""));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Request sent unexpectedly", size_t(0), port.countSent(Packet::DHCP_REQUEST));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Address changed", oldAddr, port.getLocalAddr());
+}
+
+void IPortTest::test_ResumeUpstream_RequestGranted_AddressKept()
+{
+   Router    router("leaf");
+   IPortFake port(router);
+   connectAndSuspend(port);
+   IfcAddr_t oldAddr = port.getLocalAddr();
+
+   port.link();
+   port.injectOffer(SUBNET_B, PREFIX_LENGTH, DHCP_FLAG_REQUEST);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Previous subnet not requested", SUBNET_A, requestedAddr(port.waitSent(Packet::DHCP_REQUEST)));
+   port.injectOffer(SUBNET_A, PREFIX_LENGTH, 0U);
+
+   port.sync();
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Port not resumed", true, port.resumeUpstream(""));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Address changed", oldAddr, port.getLocalAddr());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Port still suspended", false, port.isSuspended());
+}
+
+void IPortTest::test_ResumeUpstream_RequestRefused_FreshOfferUsed()
+{
+   Router    router("leaf");
+   IPortFake port(router);
+   connectAndSuspend(port);
+
+   port.link();
+   port.injectOffer(SUBNET_B, PREFIX_LENGTH, DHCP_FLAG_REQUEST);
+   CPPUNIT_ASSERT_MESSAGE("Previous subnet not requested", port.waitSent(Packet::DHCP_REQUEST) != nullptr);
+   port.injectOffer(SUBNET_B, PREFIX_LENGTH, 0U);
+
+   port.sync();
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Port not resumed", true, port.resumeUpstream(""));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Fresh offer not used", SUBNET_B + (UINT64_C(1) << INTERFACE_ADDR_SIZE), port.getLocalAddr());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Requested more than once", size_t(1), port.countSent(Packet::DHCP_REQUEST));
+}
+
+void IPortTest::test_ResumeUpstream_PeerWithoutRequestSupport_FreshOfferUsed()
+{
+   Router    router("leaf");
+   IPortFake port(router);
+   connectAndSuspend(port);
+
+   port.link();
+   port.injectOffer(SUBNET_B, PREFIX_LENGTH, 0U);
+
+   port.sync();
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Port not resumed", true, port.resumeUpstream(""));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Request sent to old peer", size_t(0), port.countSent(Packet::DHCP_REQUEST));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Fresh offer not used", SUBNET_B + (UINT64_C(1) << INTERFACE_ADDR_SIZE), port.getLocalAddr());
+}
+
+void IPortTest::test_ResumeUpstream_DisconnectedWhileRebinding_FalseReturnedAndSuspended()
+{
+   Router    router("leaf");
+   IPortFake port(router);
+   connectAndSuspend(port);
+
+   port.link();
+   port.unlink();
+   port.sync();
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Port resumed without offer", false, port.resumeUpstream(""));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Port not suspended", true, port.isSuspended());
+}
+
+void IPortTest::test_Disconnected_PersistentPort_TrafficDroppedUntilResumed()
+{
+   Router    router("leaf");
+   IPortFake port(router);
+   connectAndSuspend(port);
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Packet routed to suspended port", false,
+      router.routePacket(std::auto_ptr<Packet>(new Packet(Packet::UNICAST_MESSAGE, port.getLocalAddr(), REMOTE_ADDR))));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Packet sent while suspended", size_t(0), port.countSent(Packet::UNICAST_MESSAGE));
+
+   port.link();
+   port.injectOffer(SUBNET_A, PREFIX_LENGTH, DHCP_FLAG_REQUEST);
+   port.sync();
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Port not resumed", true, port.resumeUpstream(""));
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Packet not routed after resume", true,
+      router.routePacket(std::auto_ptr<Packet>(new Packet(Packet::UNICAST_MESSAGE, port.getLocalAddr(), REMOTE_ADDR))));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Dropped packet sent after resume", size_t(1), port.countSent(Packet::UNICAST_MESSAGE));
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(IPortTest);
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
@@ -0,0 +1,111 @@
+//////////////////////////////////////////////////////////////////////
+/// @file IPortTest.hpp
+/// @brief Header file for Unit Tests to test IPort
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#ifndef TSD_COMMUNICATION_MESSAGING_IPORTTEST_HPP
+#define TSD_COMMUNICATION_MESSAGING_IPORTTEST_HPP
+
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+
+/**
+ * Testclass for IPort
+ *
+ * @brief Testclass for IPort
+ */
+class IPortTest : public CPPUNIT_NS::TestFixture
+{
+public:
+   /**
+    * @brief tearDown function called after every test
+    */
+   void tearDown() override;
+   /**
+    * @brief Test scenario: free subnet requested before any other packet
+    *
+    * @tsd_testobject tsd::communication::messaging::IPort::ProcessDhcpRequest
+    * @tsd_testexpected port moved to requested subnet and offered it
+    */
+   void test_ProcessDhcpRequest_FreeSubnetRequested_PortMovedAndOffered();
+   /**
+    * @brief Test scenario: subnet requested that is already in use
+    *
+    * @tsd_testobject tsd::communication::messaging::IPort::ProcessDhcpRequest
+    * @tsd_testexpected port kept its subnet and offered it again
+    */
+   void test_ProcessDhcpRequest_SubnetInUse_PreviousOfferRepeated();
+   /**
+    * @brief Test scenario: subnet requested after the peer sent other packets
+    *
+    * @tsd_testobject tsd::communication::messaging::IPort::ProcessDhcpRequest
+    * @tsd_testexpected request ignored
+    */
+   void test_ProcessDhcpRequest_AfterOtherTraffic_RequestIgnored();
+   /**
+    * @brief Test scenario: peer offers the previous subnet again
+    *
+    * @tsd_testobject tsd::communication::messaging::IPort::ResumeUpstream
+    * @tsd_testexpected no request sent and address kept
+    */
+   void test_ResumeUpstream_PreviousSubnetOffered_AddressKept();
+   /**
+    * @brief Test scenario: peer offers another subnet and grants the request for the previous one
+    *
+    * @tsd_testobject tsd::communication::messaging::IPort::ResumeUpstream
+    * @tsd_testexpected previous subnet requested and address kept
+    */
+   void test_ResumeUpstream_RequestGranted_AddressKept();
+   /**
+    * @brief Test scenario: peer refuses the request for the previous subnet
+    *
+    * @tsd_testobject tsd::communication::messaging::IPort::ResumeUpstream
+    * @tsd_testexpected fresh offer used as new address
+    */
+   void test_ResumeUpstream_RequestRefused_FreshOfferUsed();
+   /**
+    * @brief Test scenario: peer does not support DHCP_REQUEST and offers another subnet
+    *
+    * @tsd_testobject tsd::communication::messaging::IPort::ResumeUpstream
+    * @tsd_testexpected no request sent and fresh offer used as new address
+    */
+   void test_ResumeUpstream_PeerWithoutRequestSupport_FreshOfferUsed();
+   /**
+    * @brief Test scenario: connection breaks again before the offer arrived
+    *
+    * @tsd_testobject tsd::communication::messaging::IPort::ResumeUpstream
+    * @tsd_testexpected false returned and port still suspended
+    */
+   void test_ResumeUpstream_DisconnectedWhileRebinding_FalseReturnedAndSuspended();
+   /**
+    * @brief Test scenario: packets routed upstream while the port is suspended and after it was resumed
+    *
+    * @tsd_testobject tsd::communication::messaging::IPort::Disconnected
+    * @tsd_testexpected packets dropped while suspended and sent again after resume
+    */
+   void test_Disconnected_PersistentPort_TrafficDroppedUntilResumed();
+
+   CPPUNIT_TEST_SUITE(IPortTest);
+   CPPUNIT_TEST(test_ProcessDhcpRequest_FreeSubnetRequested_PortMovedAndOffered);
+   CPPUNIT_TEST(test_ProcessDhcpRequest_SubnetInUse_PreviousOfferRepeated);
+   CPPUNIT_TEST(test_ProcessDhcpRequest_AfterOtherTraffic_RequestIgnored);
+   CPPUNIT_TEST(test_ResumeUpstream_PreviousSubnetOffered_AddressKept);
+   CPPUNIT_TEST(test_ResumeUpstream_RequestGranted_AddressKept);
+   CPPUNIT_TEST(test_ResumeUpstream_RequestRefused_FreshOfferUsed);
+   CPPUNIT_TEST(test_ResumeUpstream_PeerWithoutRequestSupport_FreshOfferUsed);
+   CPPUNIT_TEST(test_ResumeUpstream_DisconnectedWhileRebinding_FalseReturnedAndSuspended);
+   CPPUNIT_TEST(test_Disconnected_PersistentPort_TrafficDroppedUntilResumed);
+   CPPUNIT_TEST_SUITE_END();
+};
+
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
+
+#endif // TSD_COMMUNICATION_MESSAGING_IPORTTEST_HPP
@@ -27,6 +27,39 @@ void IMessageFactoryTest::test_GetEventIds_JustRun_StdVectorReturned()
 }
 CPPUNIT_TEST_SUITE_REGISTRATION(IMessageFactoryTest);
 
+void IMessageSelectorTest::test_EventIdSelector_MatchingAndOtherEvent_OnlyMatchingAccepted()
+{
+   EventIdSelector                     testObj(42u);
+   tsd::communication::event::TsdEvent matching(42u);
+   tsd::communication::event::TsdEvent other(43u);
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Wrong kind", IMessageSelector::SELECT_EVENT_ID, testObj.getKind());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Wrong key", uint64_t{42u}, testObj.getKey());
+   CPPUNIT_ASSERT_MESSAGE("Matching event rejected", testObj.filterEvent(&matching));
+   CPPUNIT_ASSERT_MESSAGE("Other event accepted", !testObj.filterEvent(&other));
+}
+
+void IMessageSelectorTest::test_SenderSelector_MatchingAndOtherSender_OnlyMatchingAccepted()
+{
+   SenderSelector                      testObj(0x100000002ull);
+   tsd::communication::event::TsdEvent matching(1u);
+   tsd::communication::event::TsdEvent other(1u);
+   matching.setSenderAddr(0x100000002ull);
+   other.setSenderAddr(0x2ull);
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Wrong kind", IMessageSelector::SELECT_SENDER, testObj.getKind());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Wrong key", uint64_t{0x100000002ull}, testObj.getKey());
+   CPPUNIT_ASSERT_MESSAGE("Matching event rejected", testObj.filterEvent(&matching));
+   CPPUNIT_ASSERT_MESSAGE("Other event accepted", !testObj.filterEvent(&other));
+}
+
+void IMessageSelectorTest::test_GetKind_CustomSelector_GenericKindReturned()
+{
+   IMessageSelectorMock testObj;
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Wrong kind", IMessageSelector::SELECT_GENERIC, testObj.getKind());
+}
+CPPUNIT_TEST_SUITE_REGISTRATION(IMessageSelectorTest);
+
 void IQueueTest::test_Destructor_JustRun_ObjectDestroyed()
 {
    IQueue* testObj;
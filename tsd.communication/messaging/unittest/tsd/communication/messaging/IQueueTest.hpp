@@ -39,6 +39,43 @@ public:
    CPPUNIT_TEST_SUITE_END();
 };
 
+/**
+ * Testclass for IMessageSelector
+ *
+ * @brief Testclass for IMessageSelector
+ */
+class IMessageSelectorTest : public CPPUNIT_NS::TestFixture
+{
+public:
+   /**
+    * @brief Test scenario: events with matching and other event ID
+    *
+    * @tsd_testobject tsd::communication::messaging::EventIdSelector::FilterEvent
+    * @tsd_testexpected only matching event accepted, kind and key set
+    */
+   void test_EventIdSelector_MatchingAndOtherEvent_OnlyMatchingAccepted();
+   /**
+    * @brief Test scenario: events from matching and other sender
+    *
+    * @tsd_testobject tsd::communication::messaging::SenderSelector::FilterEvent
+    * @tsd_testexpected only matching event accepted, kind and key set
+    */
+   void test_SenderSelector_MatchingAndOtherSender_OnlyMatchingAccepted();
+   /**
+    * @brief Test scenario: custom selector
+    *
+    * @tsd_testobject tsd::communication::messaging::IMessageSelector::GetKind
+    * @tsd_testexpected generic kind returned
+    */
+   void test_GetKind_CustomSelector_GenericKindReturned();
+
+   CPPUNIT_TEST_SUITE(IMessageSelectorTest);
+   CPPUNIT_TEST(test_EventIdSelector_MatchingAndOtherEvent_OnlyMatchingAccepted);
+   CPPUNIT_TEST(test_SenderSelector_MatchingAndOtherSender_OnlyMatchingAccepted);
+   CPPUNIT_TEST(test_GetKind_CustomSelector_GenericKindReturned);
+   CPPUNIT_TEST_SUITE_END();
+};
+
 /**
  * Testclass for IQueue
  *
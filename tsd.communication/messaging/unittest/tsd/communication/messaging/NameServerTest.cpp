@@ -19,6 +19,8 @@ namespace messaging {
 namespace {
 const std::string DEFAULT_SERVER_NAME = "NameServer";
 const uint32_t    DEFAULT_TIMEOUT{1};
+const uint32_t    NEGATIVE_TIMEOUT{50};
+const uint32_t    LOOKUP_TIMEOUT{1000};
 const bool        IS_NAME_SERVER{true};
 const std::string DEFAULT_INTERFACE_NAME           = "notNullLookupName";
 const std::string INTERFACE_NAME_WITH_SLASH        = "/notNullLookupName";
@@ -281,6 +283,63 @@ void NameServerTest::test_LookupInterface_WithRunningThreadAndInterfaceNameHasHo
    CPPUNIT_ASSERT_EQUAL_MESSAGE("Thread was not stopped", false, testObj.isRunning());
 }
 
+void NameServerTest::test_LookupInterface_CachedInterface_TrueReturned()
+{
+   Router           router(DEFAULT_SERVER_NAME);
+   NameServerHelper testObj(router);
+   CPPUNIT_ASSERT_NO_THROW_MESSAGE("It is expected that this method does not throw exceptions", testObj.init());
+   tsd::communication::event::IfcAddr_t address = testObj.getInterfaceAddr();
+   tsd::communication::event::IfcAddr_t remoteAddr{1};
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE(
+      "Publish interface returned false", true, testObj.publishInterface(DEFAULT_INTERFACE_NAME, address, false));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE(
+      "Lookup interface returned false", true, testObj.lookupInterface(DEFAULT_INTERFACE_NAME, LOOKUP_TIMEOUT, remoteAddr));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Wrong address returned", address, remoteAddr);
+   remoteAddr = 1;
+   CPPUNIT_ASSERT_EQUAL_MESSAGE(
+      "Cached lookup returned false", true, testObj.lookupInterface(DEFAULT_INTERFACE_NAME, 0, remoteAddr));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Wrong cached address returned", address, remoteAddr);
+   CPPUNIT_ASSERT_NO_THROW_MESSAGE("It is expected that this method does not throw exceptions", testObj.fini());
+}
+
+void NameServerTest::test_LookupInterface_CachedInterfaceDeregistered_FalseReturned()
+{
+   Router           router(DEFAULT_SERVER_NAME);
+   NameServerHelper testObj(router);
+   CPPUNIT_ASSERT_NO_THROW_MESSAGE("It is expected that this method does not throw exceptions", testObj.init());
+   tsd::communication::event::IfcAddr_t address = testObj.getInterfaceAddr();
+   tsd::communication::event::IfcAddr_t remoteAddr{1};
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE(
+      "Publish interface returned false", true, testObj.publishInterface(DEFAULT_INTERFACE_NAME, address, false));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE(
+      "Lookup interface returned false", true, testObj.lookupInterface(DEFAULT_INTERFACE_NAME, LOOKUP_TIMEOUT, remoteAddr));
+   CPPUNIT_ASSERT_NO_THROW_MESSAGE("It is expected that this method does not throw exceptions",
+                                   testObj.unpublishInterface(DEFAULT_INTERFACE_NAME, address));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE(
+      "Lookup interface returned true", false, testObj.lookupInterface(DEFAULT_INTERFACE_NAME, DEFAULT_TIMEOUT, remoteAddr));
+   CPPUNIT_ASSERT_NO_THROW_MESSAGE("It is expected that this method does not throw exceptions", testObj.fini());
+}
+
+void NameServerTest::test_LookupInterface_RegisteredAfterNegativeReply_TrueReturned()
+{
+   Router           router(DEFAULT_SERVER_NAME);
+   NameServerHelper testObj(router);
+   CPPUNIT_ASSERT_NO_THROW_MESSAGE("It is expected that this method does not throw exceptions", testObj.init());
+   tsd::communication::event::IfcAddr_t address = testObj.getInterfaceAddr();
+   tsd::communication::event::IfcAddr_t remoteAddr{1};
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE(
+      "Lookup interface returned true", false, testObj.lookupInterface(DEFAULT_INTERFACE_NAME, NEGATIVE_TIMEOUT, remoteAddr));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE(
+      "Publish interface returned false", true, testObj.publishInterface(DEFAULT_INTERFACE_NAME, address, false));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE(
+      "Lookup interface returned false", true, testObj.lookupInterface(DEFAULT_INTERFACE_NAME, LOOKUP_TIMEOUT, remoteAddr));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Wrong address returned", address, remoteAddr);
+   CPPUNIT_ASSERT_NO_THROW_MESSAGE("It is expected that this method does not throw exceptions", testObj.fini());
+}
+
 void NameServerTest::test_MakeLocal_JustRun_NothingHappens()
 {
    Router     router(DEFAULT_SERVER_NAME);
@@ -172,6 +172,27 @@ public:
     * @tsd_testexpected false returned
     */
    void test_LookupInterface_WithRunningThreadAndInterfaceNameHasHostName_FalseReturned();
+   /**
+    * @brief Test scenario: interface was resolved before and is looked up again without timeout
+    *
+    * @tsd_testobject tsd::communication::messaging::NameServer::LookupInterface
+    * @tsd_testexpected true returned from cache
+    */
+   void test_LookupInterface_CachedInterface_TrueReturned();
+   /**
+    * @brief Test scenario: cached interface was deregistered
+    *
+    * @tsd_testobject tsd::communication::messaging::NameServer::LookupInterface
+    * @tsd_testexpected false returned
+    */
+   void test_LookupInterface_CachedInterfaceDeregistered_FalseReturned();
+   /**
+    * @brief Test scenario: interface is registered after a failed lookup
+    *
+    * @tsd_testobject tsd::communication::messaging::NameServer::LookupInterface
+    * @tsd_testexpected true returned
+    */
+   void test_LookupInterface_RegisteredAfterNegativeReply_TrueReturned();
    /**
     * @brief Test scenario: just run
     *
@@ -250,6 +271,9 @@ public:
    CPPUNIT_TEST(test_LookupInterface_ReturningNullMessage_FalseReturned);
    CPPUNIT_TEST(test_LookupInterface_WithRunningThreadAndManyEntriesInAuthDomainVec_FalseReturned);
    CPPUNIT_TEST(test_LookupInterface_WithRunningThreadAndInterfaceNameHasHostName_FalseReturned);
+   CPPUNIT_TEST(test_LookupInterface_CachedInterface_TrueReturned);
+   CPPUNIT_TEST(test_LookupInterface_CachedInterfaceDeregistered_FalseReturned);
+   CPPUNIT_TEST(test_LookupInterface_RegisteredAfterNegativeReply_TrueReturned);
    CPPUNIT_TEST(test_MakeLocal_JustRun_NothingHappens);
    CPPUNIT_TEST(test_MakeStubResolver_MemberStubResolver_FalseReturned);
    CPPUNIT_TEST(test_MakeStubResolver_NotMemberStubResolverAndMemberUpstreamNameServerEqualsLoopbackAddress_TrueReturned);
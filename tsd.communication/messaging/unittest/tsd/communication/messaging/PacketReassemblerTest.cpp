@@ -0,0 +1,140 @@
+//////////////////////////////////////////////////////////////////////
+/// @file PacketReassemblerTest.cpp
+/// @brief Unit Tests to test PacketReassembler
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#include "PacketReassemblerTest.hpp"
+#include <algorithm>
+#include <string>
+#include <tsd/communication/messaging/PacketReassembler.hpp>
+#include <tsd/communication/messaging/ReceiveSlab.hpp>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+namespace {
+const tsd::communication::event::IfcAddr_t SENDER{0x0000012300000005ull};
+const tsd::communication::event::IfcAddr_t RECEIVER{0x0000012301000007ull};
+const uint32_t                             FRAGMENT_SIZE{400};
+
+std::string payload(size_t size, char fill)
+{
+   std::string ret;
+   for (size_t i = 0; i < size; i++) {
+      ret += static_cast<char>(fill + i % 23);
+   }
+   return ret;
+}
+
+// header of the fragment at @p offset as the sender would encode it
+HeaderFields fragment(const std::string& data, uint32_t offset, tsd::communication::event::IfcAddr_t sender = SENDER)
+{
+   HeaderFields hdr{};
+   hdr.m_senderAddr   = sender;
+   hdr.m_receiverAddr = RECEIVER;
+   hdr.m_eventId      = 42;
+   hdr.m_type         = 0;
+   hdr.m_msgLen       = std::min(FRAGMENT_SIZE, static_cast<uint32_t>(data.size()) - offset);
+   hdr.m_fragment     = (offset > 0) ? FRAGMENT_CONT : 0;
+   if (offset + hdr.m_msgLen < data.size()) {
+      hdr.m_fragment |= FRAGMENT_MORE;
+   }
+   if (offset == 0) {
+      hdr.m_totalLen = static_cast<uint32_t>(data.size());
+   }
+   return hdr;
+}
+
+// feeds all fragments at and behind @p offset, returns the completed payload
+std::string addRest(PacketReassembler& reassembler, const std::string& data, uint32_t offset,
+                    tsd::communication::event::IfcAddr_t sender = SENDER)
+{
+   std::string ret;
+   for (; offset < data.size(); offset += FRAGMENT_SIZE) {
+      HeaderFields hdr = fragment(data, offset, sender);
+      ReceiveSlab* slab;
+      CPPUNIT_ASSERT_MESSAGE("Fragment is expected to be accepted", reassembler.add(hdr, data.data() + offset, slab));
+      if (slab != nullptr) {
+         CPPUNIT_ASSERT_EQUAL_MESSAGE("Length is not as expected", data.size(), static_cast<size_t>(hdr.m_msgLen));
+         CPPUNIT_ASSERT_EQUAL_MESSAGE("Flags are expected to be cleared", static_cast<uint8_t>(0), hdr.m_fragment);
+         ret.assign(slab->getData(), hdr.m_msgLen);
+         slab->deref();
+      }
+   }
+   return ret;
+}
+
+bool addOne(PacketReassembler& reassembler, HeaderFields hdr, const std::string& data, uint32_t offset)
+{
+   ReceiveSlab* slab;
+   bool         ret = reassembler.add(hdr, data.data() + offset, slab);
+   CPPUNIT_ASSERT_MESSAGE("No packet is expected to complete", slab == nullptr);
+   return ret;
+}
+}
+
+void PacketReassemblerTest::test_Add_InterleavedPairs_PacketsComplete()
+{
+   PacketReassembler reassembler;
+   reassembler.setLimit(DEFAULT_REASSEMBLY_LIMIT);
+   std::string first  = payload(1000, 'a');
+   std::string second = payload(900, 'A');
+
+   CPPUNIT_ASSERT_MESSAGE("Fragment is expected to be accepted", addOne(reassembler, fragment(first, 0), first, 0));
+   CPPUNIT_ASSERT_MESSAGE("Fragment is expected to be accepted",
+                          addOne(reassembler, fragment(second, 0, SENDER + 1u), second, 0));
+   CPPUNIT_ASSERT_MESSAGE("Fragment is expected to be accepted", addOne(reassembler, fragment(first, 400), first, 400));
+
+   CPPUNIT_ASSERT_MESSAGE("Second packet is not as expected", second == addRest(reassembler, second, 400, SENDER + 1u));
+   CPPUNIT_ASSERT_MESSAGE("First packet is not as expected", first == addRest(reassembler, first, 800));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Nothing is expected to be dropped", static_cast<uint64_t>(0), reassembler.getDropped());
+}
+
+void PacketReassemblerTest::test_Add_UnexpectedFragment_Rejected()
+{
+   PacketReassembler reassembler;
+   reassembler.setLimit(DEFAULT_REASSEMBLY_LIMIT);
+   std::string data = payload(1000, 'a');
+
+   CPPUNIT_ASSERT_MESSAGE("Continuation without start is expected to be rejected",
+                          !addOne(reassembler, fragment(data, 400), data, 400));
+
+   CPPUNIT_ASSERT_MESSAGE("Fragment is expected to be accepted", addOne(reassembler, fragment(data, 0), data, 0));
+   HeaderFields early = fragment(data, 400);
+   early.m_fragment   = FRAGMENT_CONT;
+   CPPUNIT_ASSERT_MESSAGE("Early last fragment is expected to be rejected", !addOne(reassembler, early, data, 400));
+   CPPUNIT_ASSERT_MESSAGE("Discarded packet must not continue",
+                          !addOne(reassembler, fragment(data, 800), data, 800));
+
+   CPPUNIT_ASSERT_MESSAGE("Fragment is expected to be accepted", addOne(reassembler, fragment(data, 0), data, 0));
+   CPPUNIT_ASSERT_MESSAGE("Second start is expected to be rejected", !addOne(reassembler, fragment(data, 0), data, 0));
+
+   // a new packet starts cleanly afterwards
+   CPPUNIT_ASSERT_MESSAGE("Packet is not as expected", data == addRest(reassembler, data, 0));
+}
+
+void PacketReassemblerTest::test_Add_LimitExceeded_PacketDropped()
+{
+   PacketReassembler reassembler;
+   reassembler.setLimit(1500);
+   std::string large = payload(2000, 'a');
+   std::string small = payload(600, 'A');
+
+   // the only packet in progress may exceed the limit
+   CPPUNIT_ASSERT_MESSAGE("Fragment is expected to be accepted", addOne(reassembler, fragment(large, 0), large, 0));
+   CPPUNIT_ASSERT_MESSAGE("Dropped packet is not expected to complete",
+                          addRest(reassembler, small, 0, SENDER + 1u).empty());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Drop is expected to be counted", static_cast<uint64_t>(1), reassembler.getDropped());
+   CPPUNIT_ASSERT_MESSAGE("Large packet is not as expected", large == addRest(reassembler, large, 400));
+
+   CPPUNIT_ASSERT_MESSAGE("Packet is expected after the memory was released",
+                          small == addRest(reassembler, small, 0, SENDER + 1u));
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(PacketReassemblerTest);
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
@@ -0,0 +1,59 @@
+//////////////////////////////////////////////////////////////////////
+/// @file PacketReassemblerTest.hpp
+/// @brief Header file for Unit Tests to test PacketReassembler
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#ifndef TSD_COMMUNICATION_MESSAGING_PACKETREASSEMBLERTEST_HPP
+#define TSD_COMMUNICATION_MESSAGING_PACKETREASSEMBLERTEST_HPP
+
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+
+/**
+ * Testclass for PacketReassembler
+ *
+ * @brief Testclass for PacketReassembler
+ */
+class PacketReassemblerTest : public CPPUNIT_NS::TestFixture
+{
+public:
+   /**
+    * @brief Test scenario: fragments of two address pairs received interleaved
+    *
+    * @tsd_testobject tsd::communication::messaging::PacketReassembler::add
+    * @tsd_testexpected both packets complete with their original payload
+    */
+   void test_Add_InterleavedPairs_PacketsComplete();
+   /**
+    * @brief Test scenario: fragments that do not fit to the packet in progress
+    *
+    * @tsd_testobject tsd::communication::messaging::PacketReassembler::add
+    * @tsd_testexpected fragments rejected, packet in progress discarded
+    */
+   void test_Add_UnexpectedFragment_Rejected();
+   /**
+    * @brief Test scenario: second packet started while the limit is used up
+    *
+    * @tsd_testobject tsd::communication::messaging::PacketReassembler::add
+    * @tsd_testexpected second packet dropped and counted, first packet completes
+    */
+   void test_Add_LimitExceeded_PacketDropped();
+
+   CPPUNIT_TEST_SUITE(PacketReassemblerTest);
+   CPPUNIT_TEST(test_Add_InterleavedPairs_PacketsComplete);
+   CPPUNIT_TEST(test_Add_UnexpectedFragment_Rejected);
+   CPPUNIT_TEST(test_Add_LimitExceeded_PacketDropped);
+   CPPUNIT_TEST_SUITE_END();
+};
+
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
+
+#endif // TSD_COMMUNICATION_MESSAGING_PACKETREASSEMBLERTEST_HPP
@@ -8,7 +8,11 @@
 //////////////////////////////////////////////////////////////////////
 
 #include "PacketTest.hpp"
+#include <cstring>
+#include <vector>
+#include <tsd/common/ipc/rpcbuffer.h>
 #include <tsd/communication/messaging/Packet.hpp>
+#include <tsd/communication/messaging/ReceiveSlab.hpp>
 
 namespace tsd {
 namespace communication {
@@ -19,6 +23,18 @@ const Packet::Type                         DEFAULT_TYPE{Packet::OOB_BASE};
 const tsd::communication::event::IfcAddr_t DEFAULT_SENDER{1};
 const tsd::communication::event::IfcAddr_t DEFAULT_RECEIVER{2};
 const char*                                DEFAULT_BUFFER{"testbuffer"};
+
+class LargeEvent : public tsd::communication::event::TsdEvent
+{
+public:
+   LargeEvent() : TsdEvent(DEFAULT_EVENT_ID) {}
+   void serialize(tsd::common::ipc::RpcBuffer& buf) const override
+   {
+      for (uint32_t i = 0; i < 4096u; i++) {
+         buf << i;
+      }
+   }
+};
 }
 
 void PacketTest::test_Constructor_WithObj_ObjectCreated()
@@ -142,6 +158,56 @@ void PacketTest::test_GetBufferPtr_JustRun_BitAndMemberBufferReturned()
    CPPUNIT_ASSERT_EQUAL_MESSAGE("Buffer length is not as expected", DEFAULT_BUFFER[0], *packet->getBufferPtr());
 }
 
+void PacketTest::test_Constructor_CopyWithPayload_PayloadSharedAndHeaderCopied()
+{
+   std::unique_ptr<Packet> orig{
+      new Packet(DEFAULT_TYPE, DEFAULT_SENDER, DEFAULT_RECEIVER, DEFAULT_EVENT_ID, DEFAULT_BUFFER, strlen(DEFAULT_BUFFER))};
+   Packet copy(*orig);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Payload is expected to be shared", orig->getBufferPtr(), copy.getBufferPtr());
+
+   copy.setReceiverAddr(DEFAULT_SENDER);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Header of original must not change", DEFAULT_RECEIVER, orig->getReceiverAddr());
+
+   orig.reset();
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Payload must survive the original", strlen(DEFAULT_BUFFER), copy.getBufferLength());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Payload must survive the original", DEFAULT_BUFFER[0], *copy.getBufferPtr());
+}
+
+void PacketTest::test_Constructor_WithSlab_PayloadBorrowedAndSlabReleased()
+{
+   ReceiveSlab *slab = ReceiveSlab::allocate();
+   std::memcpy(slab->getData() + 8, DEFAULT_BUFFER, strlen(DEFAULT_BUFFER));
+
+   std::unique_ptr<Packet> orig{new Packet(DEFAULT_TYPE, DEFAULT_SENDER, DEFAULT_RECEIVER, DEFAULT_EVENT_ID, slab, 8,
+                                           static_cast<uint32_t>(strlen(DEFAULT_BUFFER)))};
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Payload is expected to point into the slab", slab->getData() + 8, orig->getBufferPtr());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Buffer length is not as expected", strlen(DEFAULT_BUFFER), orig->getBufferLength());
+   CPPUNIT_ASSERT_MESSAGE("Slab is expected to be referenced by the packet", slab->isShared());
+
+   std::unique_ptr<Packet> copy{new Packet(*orig)};
+   orig.reset();
+   CPPUNIT_ASSERT_MESSAGE("Slab is expected to be referenced by the copy", slab->isShared());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Payload must survive the original", DEFAULT_BUFFER[0], *copy->getBufferPtr());
+
+   copy.reset();
+   CPPUNIT_ASSERT_MESSAGE("Slab is expected to be released by the last packet", !slab->isShared());
+   slab->deref();
+}
+
+void PacketTest::test_Constructor_WithLargeMsg_WholeMsgSerialized()
+{
+   LargeEvent                  msg;
+   std::vector<char>           expected;
+   tsd::common::ipc::RpcBuffer rpcBuf;
+   rpcBuf.init(&expected);
+   msg.serialize(rpcBuf);
+
+   Packet packet(&msg, false);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Buffer length is not as expected", expected.size(), packet.getBufferLength());
+   CPPUNIT_ASSERT_MESSAGE("Payload is not as expected",
+                          std::memcmp(&expected[0], packet.getBufferPtr(), expected.size()) == 0);
+}
+
 CPPUNIT_TEST_SUITE_REGISTRATION(PacketTest);
 } // namespace messaging
 } // namespace communication
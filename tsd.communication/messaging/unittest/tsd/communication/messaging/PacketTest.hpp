@@ -115,6 +115,27 @@ public:
     * @tsd_testexpected bit and member buffer returned
     */
    void test_GetBufferPtr_JustRun_BitAndMemberBufferReturned();
+   /**
+    * @brief Test scenario: copy of packet with payload
+    *
+    * @tsd_testobject tsd::communication::messaging::Packet::Constructor
+    * @tsd_testexpected payload shared and header copied
+    */
+   void test_Constructor_CopyWithPayload_PayloadSharedAndHeaderCopied();
+   /**
+    * @brief Test scenario: payload in receive slab
+    *
+    * @tsd_testobject tsd::communication::messaging::Packet::Constructor
+    * @tsd_testexpected payload borrowed from slab and slab released with last copy
+    */
+   void test_Constructor_WithSlab_PayloadBorrowedAndSlabReleased();
+   /**
+    * @brief Test scenario: event larger than the initial serialization block
+    *
+    * @tsd_testobject tsd::communication::messaging::Packet::Constructor
+    * @tsd_testexpected whole event serialized
+    */
+   void test_Constructor_WithLargeMsg_WholeMsgSerialized();
 
    CPPUNIT_TEST_SUITE(PacketTest);
    CPPUNIT_TEST(test_Constructor_WithObj_ObjectCreated);
@@ -130,6 +151,9 @@ public:
    CPPUNIT_TEST(test_GetEventId_JustRun_MemberEventIdReturned);
    CPPUNIT_TEST(test_GetBufferLength_JustRun_MemberBufferSizeReturned);
    CPPUNIT_TEST(test_GetBufferPtr_JustRun_BitAndMemberBufferReturned);
+   CPPUNIT_TEST(test_Constructor_CopyWithPayload_PayloadSharedAndHeaderCopied);
+   CPPUNIT_TEST(test_Constructor_WithSlab_PayloadBorrowedAndSlabReleased);
+   CPPUNIT_TEST(test_Constructor_WithLargeMsg_WholeMsgSerialized);
    CPPUNIT_TEST_SUITE_END();
 };
 
@@ -0,0 +1,104 @@
+//////////////////////////////////////////////////////////////////////
+/// @file PayloadCodecTest.cpp
+/// @brief Unit Tests to test PayloadCodec
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#include "PayloadCodecTest.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <tsd/communication/messaging/PayloadCodec.hpp>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+namespace {
+std::vector<uint8_t> repetitivePayload(size_t size)
+{
+   std::string s;
+   char        rec[64];
+   for (unsigned i = 0; s.size() < size; i++) {
+      snprintf(rec, sizeof(rec), "{\"id\":%u,\"name\":\"segment\",\"valid\":true},", i);
+      s += rec;
+   }
+   return std::vector<uint8_t>(s.begin(), s.begin() + size);
+}
+
+std::vector<uint8_t> randomPayload(size_t size)
+{
+   std::vector<uint8_t> ret(size);
+   srand(42);
+   for (size_t i = 0; i < size; i++) {
+      ret[i] = static_cast<uint8_t>(rand());
+   }
+   return ret;
+}
+
+const PayloadCodec& lzCodec()
+{
+   const PayloadCodec* codec = PayloadCodec::find("lz");
+   CPPUNIT_ASSERT_MESSAGE("Codec is expected to exist", codec != nullptr);
+   return *codec;
+}
+}
+
+void PayloadCodecTest::test_Find_NameAndId_CodecFound()
+{
+   const PayloadCodec& codec = lzCodec();
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Id is not as expected", static_cast<unsigned>(PayloadCodec::LZ), codec.getId());
+   CPPUNIT_ASSERT_MESSAGE("Lookup by id is expected to succeed", PayloadCodec::find(PayloadCodec::LZ) == &codec);
+   CPPUNIT_ASSERT_MESSAGE("Unknown name is expected to fail", PayloadCodec::find("zstd") == nullptr);
+   CPPUNIT_ASSERT_MESSAGE("NONE is expected to have no codec", PayloadCodec::find(PayloadCodec::NONE) == nullptr);
+   CPPUNIT_ASSERT_MESSAGE("Unknown id is expected to fail", PayloadCodec::find(PayloadCodec::MAX_ID) == nullptr);
+   CPPUNIT_ASSERT_MESSAGE("Codec is expected to be supported",
+                          (PayloadCodec::getSupported() & (1u << PayloadCodec::LZ)) != 0);
+}
+
+void PayloadCodecTest::test_Compress_RepetitivePayload_RoundTrip()
+{
+   const PayloadCodec& codec = lzCodec();
+   std::vector<uint8_t>   src   = repetitivePayload(20000);
+   std::vector<uint8_t>   dst(src.size());
+
+   size_t len = codec.compress(&src[0], src.size(), &dst[0], dst.size());
+   CPPUNIT_ASSERT_MESSAGE("Payload is expected to shrink", len > 0 && len < src.size() / 2);
+
+   std::vector<uint8_t> out(src.size());
+   CPPUNIT_ASSERT_MESSAGE("Decompression is expected to succeed", codec.decompress(&dst[0], len, &out[0], out.size()));
+   CPPUNIT_ASSERT_MESSAGE("Payload is not as expected", src == out);
+}
+
+void PayloadCodecTest::test_Compress_RandomPayload_ZeroReturned()
+{
+   const PayloadCodec& codec = lzCodec();
+   std::vector<uint8_t>   src   = randomPayload(4096);
+   std::vector<uint8_t>   dst(src.size());
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Incompressible payload is expected to be rejected", static_cast<size_t>(0),
+                                codec.compress(&src[0], src.size(), &dst[0], dst.size()));
+}
+
+void PayloadCodecTest::test_Decompress_CorruptData_Rejected()
+{
+   const PayloadCodec& codec = lzCodec();
+   std::vector<uint8_t>   src   = repetitivePayload(4096);
+   std::vector<uint8_t>   dst(src.size());
+   size_t              len = codec.compress(&src[0], src.size(), &dst[0], dst.size());
+   CPPUNIT_ASSERT_MESSAGE("Payload is expected to shrink", len > 0);
+
+   std::vector<uint8_t> out(src.size() + 1);
+   CPPUNIT_ASSERT_MESSAGE("Truncated data is expected to be rejected",
+                          !codec.decompress(&dst[0], len / 2, &out[0], src.size()));
+   CPPUNIT_ASSERT_MESSAGE("Shorter raw length is expected to be rejected",
+                          !codec.decompress(&dst[0], len, &out[0], src.size() - 1));
+   CPPUNIT_ASSERT_MESSAGE("Longer raw length is expected to be rejected",
+                          !codec.decompress(&dst[0], len, &out[0], src.size() + 1));
+}
+
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
@@ -0,0 +1,67 @@
+//////////////////////////////////////////////////////////////////////
+/// @file PayloadCodecTest.hpp
+/// @brief Header file for Unit Tests to test PayloadCodec
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#ifndef TSD_COMMUNICATION_MESSAGING_PAYLOADCODECTEST_HPP
+#define TSD_COMMUNICATION_MESSAGING_PAYLOADCODECTEST_HPP
+
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+
+/**
+ * Testclass for PayloadCodec
+ *
+ * @brief Testclass for PayloadCodec
+ */
+class PayloadCodecTest : public CPPUNIT_NS::TestFixture
+{
+public:
+   /**
+    * @brief Test scenario: codec looked up by name and id
+    *
+    * @tsd_testobject tsd::communication::messaging::PayloadCodec::find
+    * @tsd_testexpected lz codec found, unknown names and ids rejected
+    */
+   void test_Find_NameAndId_CodecFound();
+   /**
+    * @brief Test scenario: repetitive payload compressed
+    *
+    * @tsd_testobject tsd::communication::messaging::PayloadCodec::compress
+    * @tsd_testexpected output smaller than input and decompressed to the original
+    */
+   void test_Compress_RepetitivePayload_RoundTrip();
+   /**
+    * @brief Test scenario: random payload compressed into a buffer of the input size
+    *
+    * @tsd_testobject tsd::communication::messaging::PayloadCodec::compress
+    * @tsd_testexpected zero returned
+    */
+   void test_Compress_RandomPayload_ZeroReturned();
+   /**
+    * @brief Test scenario: compressed data truncated or with wrong raw length
+    *
+    * @tsd_testobject tsd::communication::messaging::PayloadCodec::decompress
+    * @tsd_testexpected false returned
+    */
+   void test_Decompress_CorruptData_Rejected();
+
+   CPPUNIT_TEST_SUITE(PayloadCodecTest);
+   CPPUNIT_TEST(test_Find_NameAndId_CodecFound);
+   CPPUNIT_TEST(test_Compress_RepetitivePayload_RoundTrip);
+   CPPUNIT_TEST(test_Compress_RandomPayload_ZeroReturned);
+   CPPUNIT_TEST(test_Decompress_CorruptData_Rejected);
+   CPPUNIT_TEST_SUITE_END();
+};
+
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
+
+#endif // TSD_COMMUNICATION_MESSAGING_PAYLOADCODECTEST_HPP
@@ -8,9 +8,13 @@
 //////////////////////////////////////////////////////////////////////
 
 #include "QueueInternalTest.hpp"
+#include <algorithm>
 #include <chrono>
 #include <functional>
+#include <thread>
+#include <vector>
 #include <tsd/common/logging/LoggingManager.hpp>
+#include <tsd/common/system/Clock.hpp>
 #include <tsd/common/system/Thread.hpp>
 #include <tsd/communication/messaging/AddressInUseException.hpp>
 #include <tsd/communication/messaging/IIfcNotifiyMock.hpp>
@@ -20,6 +24,7 @@
 #include <tsd/communication/messaging/NameServer.cpp>
 #include <tsd/communication/messaging/QueueInternal.hpp>
 #include <tsd/communication/messaging/Router.hpp>
+#include <tsd/communication/messaging/ShardedLock.hpp>
 
 namespace tsd {
 namespace communication {
@@ -51,6 +56,53 @@ private:
    tsd::communication::event::TsdEvent* m_Message;
 };
 
+/**
+ * Selector with a filter only, i.e. the queue cannot index its messages.
+ */
+class EventIdFilter : public IMessageSelector
+{
+public:
+   explicit EventIdFilter(uint32_t eventId) : m_EventId(eventId)
+   {
+   }
+   bool filterEvent(tsd::communication::event::TsdEvent* event) const override
+   {
+      return event->getEventId() == m_EventId;
+   }
+
+private:
+   uint32_t m_EventId;
+};
+
+/**
+ * Event that counts how often it was cloned.
+ */
+class CloneCountingEvent : public tsd::communication::event::TsdEvent
+{
+public:
+   static uint32_t s_Clones;
+
+   explicit CloneCountingEvent(uint32_t eventId) : tsd::communication::event::TsdEvent(eventId)
+   {
+   }
+   tsd::communication::event::TsdEvent* clone() const override
+   {
+      s_Clones++;
+      return new CloneCountingEvent(getEventId());
+   }
+};
+
+uint32_t CloneCountingEvent::s_Clones = 0u;
+
+/**
+ * Read a message from @p queue and return its event ID, zero if none arrived.
+ */
+static uint32_t readEventId(std::shared_ptr<Queue> queue, uint32_t timeout, IMessageSelector* selector = NULL)
+{
+   std::auto_ptr<tsd::communication::event::TsdEvent> msg(queue->readMessage(timeout, selector));
+   return (msg.get() != NULL) ? msg->getEventId() : 0u;
+}
+
 QueueTest::~QueueTest()
 {
    tsd::common::logging::LoggingManager::cleanup();
@@ -316,6 +368,207 @@ void QueueTest::test_ReadMessage_InvokeWhenTimersEmptyTimeoutInfinitePullMessage
    CPPUNIT_ASSERT_MESSAGE("Message not equal to one pushed", retMsg->getEventId() == testEventId);
 }
 
+void QueueTest::test_ReadMessages_MoreMessagesQueuedThanMax_ExpectingMaxMessagesReturnedInOrder()
+{
+   for (uint32_t id = 1u; id <= 5u; id++) {
+      m_TestMessage.reset(new tsd::communication::event::TsdEvent(id));
+      m_TestObject->pushMessage(m_TestMessage, 0);
+   }
+   std::vector<tsd::communication::event::TsdEvent*> events;
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Expected max messages read", size_t(3), m_TestObject->readMessages(events, 3, 0));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Expected messages appended", size_t(3), events.size());
+   for (uint32_t i = 0; i < events.size(); i++) {
+      CPPUNIT_ASSERT_EQUAL_MESSAGE("Messages not in queue order", i + 1u, events[i]->getEventId());
+      delete events[i];
+   }
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Remaining message expected", 4u, m_TestObject->readMessage(0)->getEventId());
+}
+
+void QueueTest::test_ReadMessages_EmptyQueueWithTimeout_ExpectingNothingReturned()
+{
+   std::vector<tsd::communication::event::TsdEvent*> events;
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("No message expected", size_t(0), m_TestObject->readMessages(events, 3, 1));
+   CPPUNIT_ASSERT_MESSAGE("Vector expected to be untouched", events.empty());
+}
+
+void QueueTest::test_ReadMessage_EventIdSelectorMessageQueued_ExpectingMatchingMessageReturned()
+{
+   for (uint32_t id = 1; id <= 3; id++) {
+      m_TestObject->sendSelfMessage(std::auto_ptr<tsd::communication::event::TsdEvent>(
+         new tsd::communication::event::TsdEvent(id)));
+   }
+
+   EventIdSelector                                    selector(2u);
+   std::auto_ptr<tsd::communication::event::TsdEvent> msg(m_TestObject->readMessage(0, &selector));
+   CPPUNIT_ASSERT_MESSAGE("No message returned", msg.get() != NULL);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Wrong message selected", 2u, msg->getEventId());
+
+   msg = m_TestObject->readMessage(0);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Order of remaining messages changed", 1u, msg->getEventId());
+   msg = m_TestObject->readMessage(0);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Order of remaining messages changed", 3u, msg->getEventId());
+}
+
+void QueueTest::test_ReadMessage_EventIdSelectorWaiting_ExpectingMatchingMessageReturned()
+{
+   std::shared_ptr<Queue> queue = m_TestObject;
+   std::thread            sender([queue]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      for (uint32_t i = 0; i < 50; i++) {
+         queue->sendSelfMessage(std::auto_ptr<tsd::communication::event::TsdEvent>(
+            new tsd::communication::event::TsdEvent(1u)));
+      }
+      queue->sendSelfMessage(std::auto_ptr<tsd::communication::event::TsdEvent>(
+         new tsd::communication::event::TsdEvent(2u)));
+   });
+
+   EventIdSelector                                    selector(2u);
+   std::auto_ptr<tsd::communication::event::TsdEvent> msg(m_TestObject->readMessage(1000, &selector));
+   sender.join();
+
+   CPPUNIT_ASSERT_MESSAGE("No message returned", msg.get() != NULL);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Wrong message selected", 2u, msg->getEventId());
+
+   std::vector<tsd::communication::event::TsdEvent*> events;
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Other messages not left in queue", size_t(50),
+                                m_TestObject->readMessages(events, 100, 0));
+   for (size_t i = 0; i < events.size(); i++) {
+      delete events[i];
+   }
+}
+
+void QueueTest::test_ReadMessage_EventIdSelectorSteadyBacklog_MatchesReturnedOthersInOrder()
+{
+   for (uint32_t i = 0; i < 100; i++) {
+      for (uint32_t id = 1; id <= 2; id++) {
+         m_TestObject->sendSelfMessage(std::auto_ptr<tsd::communication::event::TsdEvent>(
+            new tsd::communication::event::TsdEvent(id)));
+      }
+   }
+
+   EventIdSelector selector(2u);
+   for (uint32_t i = 0; i < 150; i++) {
+      std::auto_ptr<tsd::communication::event::TsdEvent> msg(m_TestObject->readMessage(0, &selector));
+      CPPUNIT_ASSERT_MESSAGE("No message returned", msg.get() != NULL);
+      CPPUNIT_ASSERT_EQUAL_MESSAGE("Wrong message selected", 2u, msg->getEventId());
+
+      m_TestObject->sendSelfMessage(std::auto_ptr<tsd::communication::event::TsdEvent>(
+         new tsd::communication::event::TsdEvent(3u)));
+      if (i < 50) {
+         m_TestObject->sendSelfMessage(std::auto_ptr<tsd::communication::event::TsdEvent>(
+            new tsd::communication::event::TsdEvent(2u)));
+      }
+   }
+   CPPUNIT_ASSERT_MESSAGE("No match expected", m_TestObject->readMessage(0, &selector).get() == NULL);
+
+   std::vector<tsd::communication::event::TsdEvent*> events;
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Other messages not left in queue", size_t(250),
+                                m_TestObject->readMessages(events, 500, 0));
+   for (size_t i = 0; i < events.size(); i++) {
+      CPPUNIT_ASSERT_EQUAL_MESSAGE("Order of remaining messages changed", i < 100 ? 1u : 3u,
+                                   events[i]->getEventId());
+      delete events[i];
+   }
+}
+
+void QueueTest::test_ReadMessage_MonitorSelector_ExpectingMonitorMessageReturned()
+{
+   uint32_t monitor = m_TestObject->makeRef();
+   m_TestObject->sendSelfMessage(std::auto_ptr<tsd::communication::event::TsdEvent>(
+      new tsd::communication::event::TsdEvent(1u)));
+   m_TestObject->pushMessage(std::auto_ptr<tsd::communication::event::TsdEvent>(
+      new tsd::communication::event::TsdEvent(1u)), monitor);
+
+   MonitorSelector                                    selector(monitor);
+   std::auto_ptr<tsd::communication::event::TsdEvent> msg(m_TestObject->readMessage(0, &selector));
+   CPPUNIT_ASSERT_MESSAGE("No message returned", msg.get() != NULL);
+
+   msg = m_TestObject->readMessage(0, &selector);
+   CPPUNIT_ASSERT_MESSAGE("Monitor message returned twice", msg.get() == NULL);
+   msg = m_TestObject->readMessage(0);
+   CPPUNIT_ASSERT_MESSAGE("Other message gone", msg.get() != NULL);
+}
+
+void QueueTest::test_ReadMessage_SeveralReadersWaiting_EachMessageReadOnce()
+{
+   std::shared_ptr<Queue>   queue = m_TestObject;
+   std::vector<uint32_t>    received(4u, 0u);
+   std::vector<std::thread> readers;
+   for (size_t i = 0; i < received.size(); i++) {
+      readers.push_back(std::thread([queue, &received, i]() { received[i] = readEventId(queue, 1000); }));
+   }
+
+   std::this_thread::sleep_for(std::chrono::milliseconds(50));
+   for (uint32_t id = 1u; id <= received.size(); id++) {
+      m_TestObject->sendSelfMessage(std::auto_ptr<tsd::communication::event::TsdEvent>(
+         new tsd::communication::event::TsdEvent(id)));
+   }
+   for (size_t i = 0; i < readers.size(); i++) {
+      readers[i].join();
+   }
+
+   std::sort(received.begin(), received.end());
+   for (uint32_t i = 0; i < received.size(); i++) {
+      CPPUNIT_ASSERT_EQUAL_MESSAGE("Every message expected to be read exactly once", i + 1u, received[i]);
+   }
+}
+
+void QueueTest::test_ReadMessage_GenericSelectorAndPlainReaderWaiting_BothServed()
+{
+   std::shared_ptr<Queue> queue = m_TestObject;
+   uint32_t               selected(0u), plain(0u);
+   std::thread            selective([queue, &selected]() {
+      EventIdFilter selector(2u);
+      selected = readEventId(queue, 1000, &selector);
+   });
+   // the selective reader blocks first and is the first to be woken
+   std::this_thread::sleep_for(std::chrono::milliseconds(20));
+   std::thread reader([queue, &plain]() { plain = readEventId(queue, 1000); });
+
+   std::this_thread::sleep_for(std::chrono::milliseconds(50));
+   uint32_t start = tsd::common::system::Clock::getTickCounter();
+   m_TestObject->sendSelfMessage(std::auto_ptr<tsd::communication::event::TsdEvent>(
+      new tsd::communication::event::TsdEvent(1u)));
+   std::this_thread::sleep_for(std::chrono::milliseconds(20));
+   m_TestObject->sendSelfMessage(std::auto_ptr<tsd::communication::event::TsdEvent>(
+      new tsd::communication::event::TsdEvent(2u)));
+   selective.join();
+   reader.join();
+   uint32_t elapsed = tsd::common::system::Clock::getTickCounter() - start;
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Plain reader not served", 1u, plain);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Selective reader not served", 2u, selected);
+   CPPUNIT_ASSERT_MESSAGE("Reader only served after its timeout", elapsed < 500u);
+}
+
+void QueueTest::test_ReadMessage_EventIdSelectorAndPlainReaderWaiting_BothServed()
+{
+   std::shared_ptr<Queue> queue = m_TestObject;
+   uint32_t               selected(0u), plain(0u);
+   std::thread            selective([queue, &selected]() {
+      EventIdSelector selector(2u);
+      selected = readEventId(queue, 1000, &selector);
+   });
+   // the selective reader blocks first and is the first to be woken
+   std::this_thread::sleep_for(std::chrono::milliseconds(20));
+   std::thread reader([queue, &plain]() { plain = readEventId(queue, 1000); });
+
+   std::this_thread::sleep_for(std::chrono::milliseconds(50));
+   uint32_t start = tsd::common::system::Clock::getTickCounter();
+   m_TestObject->sendSelfMessage(std::auto_ptr<tsd::communication::event::TsdEvent>(
+      new tsd::communication::event::TsdEvent(1u)));
+   std::this_thread::sleep_for(std::chrono::milliseconds(20));
+   m_TestObject->sendSelfMessage(std::auto_ptr<tsd::communication::event::TsdEvent>(
+      new tsd::communication::event::TsdEvent(2u)));
+   selective.join();
+   reader.join();
+   uint32_t elapsed = tsd::common::system::Clock::getTickCounter() - start;
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Plain reader not served", 1u, plain);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Selective reader not served", 2u, selected);
+   CPPUNIT_ASSERT_MESSAGE("Reader only served after its timeout", elapsed < 500u);
+}
+
 void QueueTest::test_SendSelfMessage_InvokeProvidedMessage_ExpectingNoThrows()
 {
    m_TestMessage.reset(new tsd::communication::event::TsdEvent(1u));
@@ -384,6 +637,64 @@ void QueueTest::test_StopTimer_InvokeProvidedNotExistingRefInTimers_ExpectingTru
    CPPUNIT_ASSERT_EQUAL_MESSAGE("StopTimer returned false unexpectedly", false, m_TestObject->stopTimer(retRef));
 }
 
+void QueueTest::test_StopTimer_ExpiryAlreadyQueued_ExpectingTimerMessageRemoved()
+{
+   m_TestMessage.reset(new tsd::communication::event::TsdEvent(1u));
+   uint32_t retRef = m_TestObject->startTimer(m_TestMessage, 1, false);
+   tsd::common::system::Thread::sleep(10);
+
+   // queues the expired timer message in front of the self message
+   m_TestObject->sendSelfMessage(std::auto_ptr<tsd::communication::event::TsdEvent>(
+      new tsd::communication::event::TsdEvent(2u)));
+   m_TestObject->stopTimer(retRef);
+
+   std::auto_ptr<tsd::communication::event::TsdEvent> msg(m_TestObject->readMessage(0));
+   CPPUNIT_ASSERT_MESSAGE("No message returned", msg.get() != NULL);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Timer message not removed", 2u, msg->getEventId());
+   msg = m_TestObject->readMessage(0);
+   CPPUNIT_ASSERT_MESSAGE("Unexpected message returned", msg.get() == NULL);
+}
+
+void QueueTest::test_StartTimer_TimersStartedOutOfOrder_ExpectingMessagesInExpiryOrder()
+{
+   const uint32_t timeouts[] = { 30u, 10u, 100u, 20u };
+   for (uint32_t i = 0; i < 4; i++) {
+      m_TestMessage.reset(new tsd::communication::event::TsdEvent(timeouts[i]));
+      m_TestObject->startTimer(m_TestMessage, timeouts[i], false);
+   }
+
+   const uint32_t expected[] = { 10u, 20u, 30u, 100u };
+   for (uint32_t i = 0; i < 4; i++) {
+      std::auto_ptr<tsd::communication::event::TsdEvent> msg(m_TestObject->readMessage(1000));
+      CPPUNIT_ASSERT_MESSAGE("Timer did not expire", msg.get() != NULL);
+      CPPUNIT_ASSERT_EQUAL_MESSAGE("Timer expired out of order", expected[i], msg->getEventId());
+   }
+}
+
+void QueueTest::test_StartTimer_ReaderWaitingForLaterTimer_EarlierTimerReadInTime()
+{
+   m_TestMessage.reset(new tsd::communication::event::TsdEvent(1u));
+   m_TestObject->startTimer(m_TestMessage, 10000, false);
+
+   std::shared_ptr<Queue> queue = m_TestObject;
+   std::thread            starter([queue]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      queue->startTimer(std::auto_ptr<tsd::communication::event::TsdEvent>(
+                           new tsd::communication::event::TsdEvent(2u)),
+                        50,
+                        false);
+   });
+
+   uint32_t                                           start = tsd::common::system::Clock::getTickCounter();
+   std::auto_ptr<tsd::communication::event::TsdEvent> msg(m_TestObject->readMessage());
+   uint32_t                                           elapsed = tsd::common::system::Clock::getTickCounter() - start;
+   starter.join();
+
+   CPPUNIT_ASSERT_MESSAGE("No timer expired", msg.get() != NULL);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Earlier timer expected", 2u, msg->getEventId());
+   CPPUNIT_ASSERT_MESSAGE("Reader not woken for the earlier timer", elapsed < 1000u);
+}
+
 void QueueTest::test_GetName_InvokeAfterCreatingWithName_ExpectingNameMatchingWithOnePassedToCtor()
 {
    std::string expectedName("testQueueName");
@@ -496,6 +807,308 @@ void QueueTest::test_PushMessage_InvokeWhenTimersEmptyMulticastFalse_ExpectingNo
    CPPUNIT_ASSERT_NO_THROW_MESSAGE("pushMessage failed with a throw", m_TestObject->pushMessage(m_TestMessage, 0, false));
 }
 
+void QueueTest::test_SetCapacity_PushToFullQueueDropNewest_NewMessageDroppedAndCounted()
+{
+   m_TestObject->setCapacity(2, OVERFLOW_DROP_NEWEST);
+   for (uint32_t id = 1u; id <= 3u; id++) {
+      m_TestMessage.reset(new tsd::communication::event::TsdEvent(id));
+      m_TestMessage->setReceiverAddr(1u);
+      m_TestObject->pushMessage(m_TestMessage);
+   }
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("One message should have been dropped", uint64_t(1), m_TestObject->getDroppedMessages());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("First message expected", 1u, m_TestObject->readMessage(0)->getEventId());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Second message expected", 2u, m_TestObject->readMessage(0)->getEventId());
+   CPPUNIT_ASSERT_MESSAGE("Queue should be empty", m_TestObject->readMessage(0).get() == nullptr);
+}
+
+void QueueTest::test_SetCapacity_PushToFullQueueDropOldest_OldestMessageDroppedAndCounted()
+{
+   m_TestObject->setCapacity(2, OVERFLOW_DROP_OLDEST);
+   for (uint32_t id = 1u; id <= 3u; id++) {
+      m_TestMessage.reset(new tsd::communication::event::TsdEvent(id));
+      m_TestMessage->setReceiverAddr(1u);
+      m_TestObject->pushMessage(m_TestMessage);
+   }
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("One message should have been dropped", uint64_t(1), m_TestObject->getDroppedMessages());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Second message expected", 2u, m_TestObject->readMessage(0)->getEventId());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Third message expected", 3u, m_TestObject->readMessage(0)->getEventId());
+   CPPUNIT_ASSERT_MESSAGE("Queue should be empty", m_TestObject->readMessage(0).get() == nullptr);
+}
+
+void QueueTest::test_SetCapacity_MessagesTakenFromMiddle_SpaceAvailable()
+{
+   m_TestObject->setCapacity(4, OVERFLOW_DROP_NEWEST);
+   for (uint32_t id = 1u; id <= 4u; id++) {
+      m_TestMessage.reset(new tsd::communication::event::TsdEvent(id));
+      m_TestMessage->setReceiverAddr(1u);
+      m_TestObject->pushMessage(m_TestMessage);
+   }
+   for (uint32_t id = 2u; id <= 3u; id++) {
+      EventIdSelector selector(id);
+      CPPUNIT_ASSERT_EQUAL_MESSAGE("Selected message expected", id, m_TestObject->readMessage(0, &selector)->getEventId());
+   }
+
+   for (uint32_t id = 5u; id <= 7u; id++) {
+      m_TestMessage.reset(new tsd::communication::event::TsdEvent(id));
+      m_TestMessage->setReceiverAddr(1u);
+      m_TestObject->pushMessage(m_TestMessage);
+   }
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Only the last message should have been dropped", uint64_t(1), m_TestObject->getDroppedMessages());
+   for (uint32_t id : {1u, 4u, 5u, 6u}) {
+      CPPUNIT_ASSERT_EQUAL_MESSAGE("Remaining messages expected in order", id, m_TestObject->readMessage(0)->getEventId());
+   }
+   CPPUNIT_ASSERT_MESSAGE("Queue should be empty", m_TestObject->readMessage(0).get() == nullptr);
+}
+
+void QueueTest::test_SetCapacity_PushToFullQueueCoalesce_SameEventReplaced()
+{
+   const uint32_t ids[] = {1u, 2u, 1u, 3u};
+   m_TestObject->setCapacity(2, OVERFLOW_COALESCE);
+   for (uint32_t id : ids) {
+      m_TestMessage.reset(new tsd::communication::event::TsdEvent(id));
+      m_TestMessage->setReceiverAddr(1u);
+      m_TestObject->pushMessage(m_TestMessage);
+   }
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Two messages should have been dropped", uint64_t(2), m_TestObject->getDroppedMessages());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Second message expected", 2u, m_TestObject->readMessage(0)->getEventId());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Coalesced message expected", 1u, m_TestObject->readMessage(0)->getEventId());
+   CPPUNIT_ASSERT_MESSAGE("Queue should be empty", m_TestObject->readMessage(0).get() == nullptr);
+}
+
+void QueueTest::test_SetCapacity_PushToFullQueueBlockWithoutReader_DroppedAfterTimeout()
+{
+   m_TestObject->setCapacity(1, OVERFLOW_BLOCK, 10);
+   for (uint32_t id = 1u; id <= 2u; id++) {
+      m_TestMessage.reset(new tsd::communication::event::TsdEvent(id));
+      m_TestMessage->setReceiverAddr(1u);
+      m_TestObject->pushMessage(m_TestMessage, 0, false, true);
+   }
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("One message should have been dropped", uint64_t(1), m_TestObject->getDroppedMessages());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("First message expected", 1u, m_TestObject->readMessage(0)->getEventId());
+}
+
+void QueueTest::test_SetCapacity_SenderBlocked_RouterNotLocked()
+{
+   IMessageFactoryMock         testMsgFc;
+   Queue                       sendQueue("sendQueue", *m_TestRouter.get());
+   std::shared_ptr<ILocalIfc>  localIfc(m_TestObject->registerInterface(testMsgFc));
+   std::shared_ptr<IRemoteIfc> remoteIfc(sendQueue.connectInterface(localIfc.get(), testMsgFc));
+   m_TestObject->setCapacity(1, OVERFLOW_BLOCK, 2000);
+   remoteIfc->sendMessage(std::auto_ptr<tsd::communication::event::TsdEvent>(new tsd::communication::event::TsdEvent(1u)));
+
+   std::thread sender([remoteIfc]() {
+      remoteIfc->sendMessage(std::auto_ptr<tsd::communication::event::TsdEvent>(new tsd::communication::event::TsdEvent(2u)));
+   });
+   std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+   // takes the writer lock of the router
+   std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+   std::shared_ptr<ILocalIfc>            otherIfc(m_TestObject->registerInterface(testMsgFc));
+   std::chrono::steady_clock::duration   elapsed = std::chrono::steady_clock::now() - start;
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("First message expected", 1u, m_TestObject->readMessage(0)->getEventId());
+   sender.join();
+   CPPUNIT_ASSERT_MESSAGE("Router was locked by the blocked sender", elapsed < std::chrono::milliseconds(1000));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Blocked message expected", 2u, m_TestObject->readMessage(0)->getEventId());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Nothing should have been dropped", uint64_t(0), m_TestObject->getDroppedMessages());
+}
+
+void QueueTest::test_SetCapacity_PushToFullQueueBlockWithRouterLock_DroppedImmediately()
+{
+   m_TestObject->setCapacity(1, OVERFLOW_BLOCK, INFINITE_TIMEOUT);
+   ShardedLock            testLock;
+   ShardedLock::ReadGuard g(testLock);
+
+   uint32_t start = tsd::common::system::Clock::getTickCounter();
+   for (uint32_t id = 1u; id <= 2u; id++) {
+      m_TestMessage.reset(new tsd::communication::event::TsdEvent(id));
+      m_TestMessage->setReceiverAddr(1u);
+      m_TestObject->pushMessage(m_TestMessage, 0, false, true);
+   }
+   uint32_t elapsed = tsd::common::system::Clock::getTickCounter() - start;
+
+   CPPUNIT_ASSERT_MESSAGE("Sender must not be blocked", elapsed < 1000u);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("One message should have been dropped", uint64_t(1), m_TestObject->getDroppedMessages());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("First message expected", 1u, m_TestObject->readMessage(0)->getEventId());
+}
+
+void QueueTest::test_ReadMessage_ExpiredMessagesQueued_ExpiredSkippedAndCounted()
+{
+   uint32_t now      = tsd::common::system::Clock::getTickCounter();
+   uint32_t expired  = Packet::makeDeadline(now - 10u, 5u);
+   uint32_t deadline = Packet::makeDeadline(now, 100000u);
+   const uint32_t deadlines[] = {expired, 0u, expired, deadline, expired};
+   for (uint32_t id = 1u; id <= 5u; id++) {
+      m_TestMessage.reset(new tsd::communication::event::TsdEvent(id));
+      m_TestMessage->setReceiverAddr(1u);
+      m_TestObject->pushMessage(m_TestMessage, 0, false, false, deadlines[id - 1u]);
+   }
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Message without deadline expected", 2u, m_TestObject->readMessage(0)->getEventId());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Message with future deadline expected", 4u, m_TestObject->readMessage(0)->getEventId());
+   CPPUNIT_ASSERT_MESSAGE("Queue should be empty", m_TestObject->readMessage(0).get() == nullptr);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Three messages should have expired", uint64_t(3), m_TestObject->getExpiredMessages());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Expired messages are not overflow drops", uint64_t(0), m_TestObject->getDroppedMessages());
+}
+
+void QueueTest::test_PushPacket_PacketExpired_DroppedAndCounted()
+{
+   tsd::communication::event::IfcAddr_t testAddr(0xFFFFFFFF);
+   IMessageFactoryMock                  testMsgFc;
+   IIfcNotifiyMock*                     notifiyMock = new IIfcNotifiyMock;
+   std::shared_ptr<IIfcNotifiy>         testNotifier(notifiyMock);
+   m_TestObject->interfaceAdded(testAddr, testNotifier.get(), testMsgFc);
+   tsd::communication::event::TsdEvent testEvent(1u);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic   ignored "-Wdeprecated-declarations"
+   std::auto_ptr<Packet> testPacket(new Packet(&testEvent, false));
+#pragma GCC diagnostic pop
+   testPacket->setReceiverAddr(testAddr);
+   testPacket->setDeadline(Packet::makeDeadline(tsd::common::system::Clock::getTickCounter() - 10u, 5u));
+   EXPECT_CALL(testMsgFc, createEventRelay(_)).Times(0);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("pushPacket returned false unexpectedly", true, m_TestObject->pushPacket(testPacket, false));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Packet should have expired", uint64_t(1), m_TestObject->getExpiredMessages());
+   CPPUNIT_ASSERT_MESSAGE("Queue should be empty", m_TestObject->readMessage(0).get() == nullptr);
+
+   CPPUNIT_ASSERT_MESSAGE("Verifying and clearing expectations failed", Mock::VerifyAndClearExpectations(&testMsgFc));
+}
+
+void QueueTest::test_SetLastValueCache_SubscribeAfterBroadcast_LastValuesReceived()
+{
+   IMessageFactoryMock        testMsgFc;
+   Queue                      sendQueue("sendQueue", *m_TestRouter.get());
+   std::shared_ptr<ILocalIfc> localIfc(sendQueue.registerInterface(testMsgFc));
+   localIfc->setLastValueCache(std::vector<uint32_t>{1u, 2u});
+   for (uint32_t id : {1u, 2u, 3u}) {
+      localIfc->broadcastMessage(std::auto_ptr<tsd::communication::event::TsdEvent>(new tsd::communication::event::TsdEvent(id)));
+   }
+
+   std::shared_ptr<IRemoteIfc> remoteIfc(m_TestObject->connectInterface(localIfc.get(), testMsgFc));
+   CPPUNIT_ASSERT_MESSAGE("Nothing expected before subscribing", m_TestObject->readMessage(0).get() == nullptr);
+   remoteIfc->subscribe(1u);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Cached value of subscribed event expected", 1u, m_TestObject->readMessage(0)->getEventId());
+   CPPUNIT_ASSERT_MESSAGE("Only one cached value expected", m_TestObject->readMessage(0).get() == nullptr);
+   remoteIfc->subscribe(std::vector<uint32_t>{1u, 2u, 3u});
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Cached value of new subscription expected", 2u, m_TestObject->readMessage(0)->getEventId());
+   CPPUNIT_ASSERT_MESSAGE("Uncached and already received events expected to be skipped", m_TestObject->readMessage(0).get() == nullptr);
+}
+
+void QueueTest::test_SetSubscriptions_FilteredReceiver_OnlySubscribedEventsQueued()
+{
+   IMessageFactoryMock                  testMsgFc;
+   IIfcNotifiyMock*                     notifiyMock = new IIfcNotifiyMock;
+   std::shared_ptr<IIfcNotifiy>         testNotifier(notifiyMock);
+   Queue                                sendQueue("sendQueue", *m_TestRouter.get());
+   tsd::communication::event::IfcAddr_t senderAddr   = m_TestRouter->allocateIfcAddr(&sendQueue);
+   tsd::communication::event::IfcAddr_t receiverAddr = m_TestRouter->allocateIfcAddr(m_TestObject.get());
+   m_TestObject->interfaceAdded(receiverAddr, testNotifier.get(), testMsgFc);
+   EXPECT_CALL(*notifiyMock, isSubscribed(_)).WillRepeatedly(Return(true));
+
+   m_TestRouter->joinGroup(senderAddr, receiverAddr);
+   m_TestRouter->setSubscriptions(senderAddr, receiverAddr, std::set<uint32_t>{2u});
+   for (uint32_t id : {1u, 2u, 3u}) {
+      m_TestRouter->sendBroadcastMessage(senderAddr, std::auto_ptr<tsd::communication::event::TsdEvent>(new tsd::communication::event::TsdEvent(id)));
+   }
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Subscribed event expected", 2u, m_TestObject->readMessage(0)->getEventId());
+   CPPUNIT_ASSERT_MESSAGE("Unsubscribed events expected to be dropped by the router", m_TestObject->readMessage(0).get() == nullptr);
+   m_TestObject->interfaceRemoved(receiverAddr);
+}
+
+void QueueTest::test_ReadMessage_GenericSelectorSharedEventsQueued_OnlyMatchCloned()
+{
+   IMessageFactoryMock                  testMsgFc;
+   IIfcNotifiyMock*                     notifiyMock = new IIfcNotifiyMock;
+   std::shared_ptr<IIfcNotifiy>         testNotifier(notifiyMock);
+   Queue                                sendQueue("sendQueue", *m_TestRouter.get());
+   tsd::communication::event::IfcAddr_t senderAddr    = m_TestRouter->allocateIfcAddr(&sendQueue);
+   tsd::communication::event::IfcAddr_t receiverAddr1 = m_TestRouter->allocateIfcAddr(m_TestObject.get());
+   tsd::communication::event::IfcAddr_t receiverAddr2 = m_TestRouter->allocateIfcAddr(m_TestObject.get());
+   m_TestObject->interfaceAdded(receiverAddr1, testNotifier.get(), testMsgFc);
+   m_TestObject->interfaceAdded(receiverAddr2, testNotifier.get(), testMsgFc);
+   EXPECT_CALL(*notifiyMock, isSubscribed(_)).WillRepeatedly(Return(true));
+
+   // two receivers keep every broadcast shared
+   m_TestRouter->joinGroup(senderAddr, receiverAddr1);
+   m_TestRouter->joinGroup(senderAddr, receiverAddr2);
+   m_TestRouter->setSubscriptions(senderAddr, receiverAddr1, std::set<uint32_t>{1u, 2u, 3u});
+   m_TestRouter->setSubscriptions(senderAddr, receiverAddr2, std::set<uint32_t>{1u, 2u, 3u});
+   for (uint32_t id : {1u, 2u, 3u}) {
+      m_TestRouter->sendBroadcastMessage(senderAddr, std::auto_ptr<tsd::communication::event::TsdEvent>(new CloneCountingEvent(id)));
+   }
+
+   CloneCountingEvent::s_Clones = 0u;
+   EventIdFilter                                      selector(3u);
+   std::auto_ptr<tsd::communication::event::TsdEvent> msg(m_TestObject->readMessage(0, &selector));
+   CPPUNIT_ASSERT_MESSAGE("No message returned", msg.get() != NULL);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Wrong message selected", 3u, msg->getEventId());
+   CPPUNIT_ASSERT_MESSAGE("Receiver address not set",
+                          msg->getReceiverAddr() == receiverAddr1 || msg->getReceiverAddr() == receiverAddr2);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Only the selected event expected to be cloned", 1u, CloneCountingEvent::s_Clones);
+
+   std::vector<tsd::communication::event::TsdEvent*> events;
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Other messages not left in queue", size_t(5), m_TestObject->readMessages(events, 10, 0));
+   for (size_t i = 0; i < events.size(); i++) {
+      delete events[i];
+   }
+   m_TestObject->interfaceRemoved(receiverAddr1);
+   m_TestObject->interfaceRemoved(receiverAddr2);
+}
+
+void QueueTest::test_SetSubscriptions_SubscriptionsChanged_PreviousSetReplaced()
+{
+   IMessageFactoryMock                  testMsgFc;
+   IIfcNotifiyMock*                     notifiyMock = new IIfcNotifiyMock;
+   std::shared_ptr<IIfcNotifiy>         testNotifier(notifiyMock);
+   Queue                                sendQueue("sendQueue", *m_TestRouter.get());
+   tsd::communication::event::IfcAddr_t senderAddr   = m_TestRouter->allocateIfcAddr(&sendQueue);
+   tsd::communication::event::IfcAddr_t receiverAddr = m_TestRouter->allocateIfcAddr(m_TestObject.get());
+   m_TestObject->interfaceAdded(receiverAddr, testNotifier.get(), testMsgFc);
+   EXPECT_CALL(*notifiyMock, isSubscribed(_)).WillRepeatedly(Return(true));
+
+   m_TestRouter->joinGroup(senderAddr, receiverAddr);
+   m_TestRouter->setSubscriptions(senderAddr, receiverAddr, std::set<uint32_t>{1u});
+   m_TestRouter->setSubscriptions(senderAddr, receiverAddr, std::set<uint32_t>{2u});
+   for (uint32_t id : {1u, 2u}) {
+      m_TestRouter->sendBroadcastMessage(senderAddr, std::auto_ptr<tsd::communication::event::TsdEvent>(new tsd::communication::event::TsdEvent(id)));
+   }
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Event of new subscriptions expected", 2u, m_TestObject->readMessage(0)->getEventId());
+   CPPUNIT_ASSERT_MESSAGE("Event of previous subscriptions expected to be dropped", m_TestObject->readMessage(0).get() == nullptr);
+   m_TestObject->interfaceRemoved(receiverAddr);
+}
+
+void QueueTest::test_LeaveGroup_FilteredReceiverJoinsAgain_PreviousSubscriptionsDropped()
+{
+   IMessageFactoryMock                  testMsgFc;
+   IIfcNotifiyMock*                     notifiyMock = new IIfcNotifiyMock;
+   std::shared_ptr<IIfcNotifiy>         testNotifier(notifiyMock);
+   Queue                                sendQueue("sendQueue", *m_TestRouter.get());
+   tsd::communication::event::IfcAddr_t senderAddr    = m_TestRouter->allocateIfcAddr(&sendQueue);
+   tsd::communication::event::IfcAddr_t receiverAddr1 = m_TestRouter->allocateIfcAddr(m_TestObject.get());
+   tsd::communication::event::IfcAddr_t receiverAddr2 = m_TestRouter->allocateIfcAddr(m_TestObject.get());
+   m_TestObject->interfaceAdded(receiverAddr1, testNotifier.get(), testMsgFc);
+   m_TestObject->interfaceAdded(receiverAddr2, testNotifier.get(), testMsgFc);
+   EXPECT_CALL(*notifiyMock, isSubscribed(_)).WillRepeatedly(Return(true));
+
+   // the second receiver keeps the group alive
+   m_TestRouter->joinGroup(senderAddr, receiverAddr1);
+   m_TestRouter->joinGroup(senderAddr, receiverAddr2);
+   m_TestRouter->setSubscriptions(senderAddr, receiverAddr1, std::set<uint32_t>{1u, 2u, 3u});
+   m_TestRouter->setSubscriptions(senderAddr, receiverAddr2, std::set<uint32_t>{1u, 2u, 3u});
+   m_TestRouter->setSubscriptions(senderAddr, receiverAddr1, std::set<uint32_t>{1u});
+   m_TestRouter->setSubscriptions(senderAddr, receiverAddr2, std::set<uint32_t>{2u});
+   m_TestRouter->leaveGroup(senderAddr, receiverAddr1);
+   m_TestRouter->joinGroup(senderAddr, receiverAddr1);
+   for (uint32_t id : {1u, 2u}) {
+      m_TestRouter->sendBroadcastMessage(senderAddr, std::auto_ptr<tsd::communication::event::TsdEvent>(new tsd::communication::event::TsdEvent(id)));
+   }
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Event of remaining receiver expected", 2u, m_TestObject->readMessage(0)->getEventId());
+   CPPUNIT_ASSERT_MESSAGE("Subscriptions expected to be dropped on leave", m_TestObject->readMessage(0).get() == nullptr);
+   m_TestObject->interfaceRemoved(receiverAddr1);
+   m_TestObject->interfaceRemoved(receiverAddr2);
+}
+
 void QueueTest::test_PushPacket_InvokeWhenFactoryExistsAndProvidesValidMessage_ExpectingTrueReturned()
 {
    tsd::communication::event::IfcAddr_t testAddr(0xFFFFFFFF);
@@ -170,6 +170,69 @@ public:
     * @tsd_testexpected expecting message returned previously pushed
     */
    void test_ReadMessage_InvokeWhenTimersEmptyTimeoutInfinitePullMessageNotNullAfterDelay_ExpectingMessageReturnedPreviouslyPushed();
+   /**
+    * @brief Test scenario: more messages queued than requested
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::ReadMessages
+    * @tsd_testexpected expecting max messages returned in queue order
+    */
+   void test_ReadMessages_MoreMessagesQueuedThanMax_ExpectingMaxMessagesReturnedInOrder();
+   /**
+    * @brief Test scenario: empty queue with timeout
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::ReadMessages
+    * @tsd_testexpected expecting nothing returned
+    */
+   void test_ReadMessages_EmptyQueueWithTimeout_ExpectingNothingReturned();
+   /**
+    * @brief Test scenario: event ID selector, matching message already queued
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::ReadMessage
+    * @tsd_testexpected matching message returned, others left in order
+    */
+   void test_ReadMessage_EventIdSelectorMessageQueued_ExpectingMatchingMessageReturned();
+   /**
+    * @brief Test scenario: event ID selector, matching message pushed after other messages while waiting
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::ReadMessage
+    * @tsd_testexpected matching message returned, others left in queue
+    */
+   void test_ReadMessage_EventIdSelectorWaiting_ExpectingMatchingMessageReturned();
+   /**
+    * @brief Test scenario: event ID selector reads from a backlog that never runs empty
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::ReadMessage
+    * @tsd_testexpected queued and newly pushed matches returned, others left in order
+    */
+   void test_ReadMessage_EventIdSelectorSteadyBacklog_MatchesReturnedOthersInOrder();
+   /**
+    * @brief Test scenario: monitor selector, monitor message queued behind other messages
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::ReadMessage
+    * @tsd_testexpected monitor message returned
+    */
+   void test_ReadMessage_MonitorSelector_ExpectingMonitorMessageReturned();
+   /**
+    * @brief Test scenario: several readers wait when as many messages are pushed
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::ReadMessage
+    * @tsd_testexpected every reader woken and every message read exactly once
+    */
+   void test_ReadMessage_SeveralReadersWaiting_EachMessageReadOnce();
+   /**
+    * @brief Test scenario: reader with a filter only selector and plain reader wait, other message pushed first
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::ReadMessage
+    * @tsd_testexpected both readers get their message
+    */
+   void test_ReadMessage_GenericSelectorAndPlainReaderWaiting_BothServed();
+   /**
+    * @brief Test scenario: reader with event ID selector and plain reader wait, other message pushed first
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::ReadMessage
+    * @tsd_testexpected both readers get their message
+    */
+   void test_ReadMessage_EventIdSelectorAndPlainReaderWaiting_BothServed();
    /**
     * @brief Test scenario: invoke provided message
     *
@@ -212,6 +275,27 @@ public:
     * @tsd_testexpected expecting true returned
     */
    void test_StopTimer_InvokeProvidedNotExistingRefInTimers_ExpectingTrueReturned();
+   /**
+    * @brief Test scenario: one-shot timer expired and its message is queued
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::StopTimer
+    * @tsd_testexpected timer message removed from queue
+    */
+   void test_StopTimer_ExpiryAlreadyQueued_ExpectingTimerMessageRemoved();
+   /**
+    * @brief Test scenario: timers started in different order than they expire
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::StartTimer
+    * @tsd_testexpected timer messages received in order of expiry
+    */
+   void test_StartTimer_TimersStartedOutOfOrder_ExpectingMessagesInExpiryOrder();
+   /**
+    * @brief Test scenario: reader waits for a late timer when an earlier timer is started
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::StartTimer
+    * @tsd_testexpected reader woken and earlier timer read when it expires
+    */
+   void test_StartTimer_ReaderWaitingForLaterTimer_EarlierTimerReadInTime();
    /**
     * @brief Test scenario: invoke after creating with name
     *
@@ -268,6 +352,104 @@ public:
     * @tsd_testexpected expecting no throws
     */
    void test_PushMessage_InvokeWhenTimersEmptyMulticastFalse_ExpectingNoThrows();
+   /**
+    * @brief Test scenario: push to full queue with drop newest policy
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::SetCapacity
+    * @tsd_testexpected new message dropped and counted
+    */
+   void test_SetCapacity_PushToFullQueueDropNewest_NewMessageDroppedAndCounted();
+   /**
+    * @brief Test scenario: push to full queue with drop oldest policy
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::SetCapacity
+    * @tsd_testexpected oldest message dropped and counted
+    */
+   void test_SetCapacity_PushToFullQueueDropOldest_OldestMessageDroppedAndCounted();
+   /**
+    * @brief Test scenario: messages taken from the middle of a full queue, then more pushed
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::SetCapacity
+    * @tsd_testexpected taken messages not counted against the capacity
+    */
+   void test_SetCapacity_MessagesTakenFromMiddle_SpaceAvailable();
+   /**
+    * @brief Test scenario: push to full queue with coalesce policy
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::SetCapacity
+    * @tsd_testexpected queued message with same event id replaced by new one
+    */
+   void test_SetCapacity_PushToFullQueueCoalesce_SameEventReplaced();
+   /**
+    * @brief Test scenario: push to full queue with block policy and no reader
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::SetCapacity
+    * @tsd_testexpected new message dropped after block timeout
+    */
+   void test_SetCapacity_PushToFullQueueBlockWithoutReader_DroppedAfterTimeout();
+   /**
+    * @brief Test scenario: send to a full queue with blocking policy while another interface is registered
+    *
+    * @tsd_testobject tsd::communication::messaging::Router::RouteLocalEvent
+    * @tsd_testexpected the blocked sender does not hold the router lock and is delivered once space is available
+    */
+   void test_SetCapacity_SenderBlocked_RouterNotLocked();
+   /**
+    * @brief Test scenario: push to a full queue with blocking policy while a router lock is held
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::SetCapacity
+    * @tsd_testexpected the message is dropped right away instead of blocking
+    */
+   void test_SetCapacity_PushToFullQueueBlockWithRouterLock_DroppedImmediately();
+   /**
+    * @brief Test scenario: read from queue with messages whose deadline passed
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::ReadMessage
+    * @tsd_testexpected expired messages skipped and counted
+    */
+   void test_ReadMessage_ExpiredMessagesQueued_ExpiredSkippedAndCounted();
+   /**
+    * @brief Test scenario: invoke with packet whose deadline passed
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::PushPacket
+    * @tsd_testexpected packet dropped without deserializing and counted
+    */
+   void test_PushPacket_PacketExpired_DroppedAndCounted();
+   /**
+    * @brief Test scenario: broadcast cached and uncached events before a receiver subscribes
+    *
+    * @tsd_testobject tsd::communication::messaging::LocalIfc::SetLastValueCache
+    * @tsd_testexpected only the last values of newly subscribed cached events are received
+    */
+   void test_SetLastValueCache_SubscribeAfterBroadcast_LastValuesReceived();
+   /**
+    * @brief Test scenario: receiver subscribed to some events of a broadcasting sender
+    *
+    * @tsd_testobject tsd::communication::messaging::Router::SetSubscriptions
+    * @tsd_testexpected only subscribed events put into the queue
+    */
+   void test_SetSubscriptions_FilteredReceiver_OnlySubscribedEventsQueued();
+   /**
+    * @brief Test scenario: receiver changes its subscriptions
+    *
+    * @tsd_testobject tsd::communication::messaging::Router::SetSubscriptions
+    * @tsd_testexpected only events of the new subscriptions put into the queue
+    */
+   void test_SetSubscriptions_SubscriptionsChanged_PreviousSetReplaced();
+   /**
+    * @brief Test scenario: filter only selector, shared multicast events queued before the match
+    *
+    * @tsd_testobject tsd::communication::messaging::QueueInternal::ReadMessage
+    * @tsd_testexpected only the selected event cloned, others left in queue
+    */
+   void test_ReadMessage_GenericSelectorSharedEventsQueued_OnlyMatchCloned();
+   /**
+    * @brief Test scenario: subscribed receiver leaves the group and joins again
+    *
+    * @tsd_testobject tsd::communication::messaging::Router::LeaveGroup
+    * @tsd_testexpected previous subscriptions not applied anymore
+    */
+   void test_LeaveGroup_FilteredReceiverJoinsAgain_PreviousSubscriptionsDropped();
    /**
     * @brief Test scenario: invoke when factory exists and provides valid message
     *
@@ -362,12 +544,24 @@ public:
    CPPUNIT_TEST(test_ReadMessage_InvokeWhenTimersEmptyTimeoutInfinitePullMessageNotNull_ExpectingMessageReturnedPreviouslyPushed);
    CPPUNIT_TEST(test_ReadMessage_InvokeWhenTimersNotEmptyTimeoutNotInfinitePullMessageNull_ExpectingNullMessageReturned);
    CPPUNIT_TEST(test_ReadMessage_InvokeWhenTimersEmptyTimeoutInfinitePullMessageNotNullAfterDelay_ExpectingMessageReturnedPreviouslyPushed);
+   CPPUNIT_TEST(test_ReadMessages_MoreMessagesQueuedThanMax_ExpectingMaxMessagesReturnedInOrder);
+   CPPUNIT_TEST(test_ReadMessages_EmptyQueueWithTimeout_ExpectingNothingReturned);
+   CPPUNIT_TEST(test_ReadMessage_EventIdSelectorMessageQueued_ExpectingMatchingMessageReturned);
+   CPPUNIT_TEST(test_ReadMessage_EventIdSelectorWaiting_ExpectingMatchingMessageReturned);
+   CPPUNIT_TEST(test_ReadMessage_EventIdSelectorSteadyBacklog_MatchesReturnedOthersInOrder);
+   CPPUNIT_TEST(test_ReadMessage_MonitorSelector_ExpectingMonitorMessageReturned);
+   CPPUNIT_TEST(test_ReadMessage_SeveralReadersWaiting_EachMessageReadOnce);
+   CPPUNIT_TEST(test_ReadMessage_GenericSelectorAndPlainReaderWaiting_BothServed);
+   CPPUNIT_TEST(test_ReadMessage_EventIdSelectorAndPlainReaderWaiting_BothServed);
    CPPUNIT_TEST(test_SendSelfMessage_InvokeProvidedMessage_ExpectingNoThrows);
    CPPUNIT_TEST(test_StartTimer_InvokeAfterAlreadyAddingTimer_ExpectingUniqueRefsReturned);
    CPPUNIT_TEST(test_StartTimer_InvokeWhenAddingExistingRef_CaseNotTestable);
    CPPUNIT_TEST(test_StopTimer_InvokeProvidedExistingRefInTimersCyclic_ExpectingTrueReturned);
    CPPUNIT_TEST(test_StopTimer_InvokeProvidedExistingRefInTimersOneTime_ExpectingTrueReturned);
    CPPUNIT_TEST(test_StopTimer_InvokeProvidedNotExistingRefInTimers_ExpectingTrueReturned);
+   CPPUNIT_TEST(test_StopTimer_ExpiryAlreadyQueued_ExpectingTimerMessageRemoved);
+   CPPUNIT_TEST(test_StartTimer_TimersStartedOutOfOrder_ExpectingMessagesInExpiryOrder);
+   CPPUNIT_TEST(test_StartTimer_ReaderWaitingForLaterTimer_EarlierTimerReadInTime);
    CPPUNIT_TEST(test_GetName_InvokeAfterCreatingWithName_ExpectingNameMatchingWithOnePassedToCtor);
    CPPUNIT_TEST(test_InterfaceAdded_InvokeProvidedAllArguments_ExpectingNoThrows);
    CPPUNIT_TEST(test_InterfaceRemoved_InvokeWhenEventWithSameReceiverAddressExistsInEventQueue_ExpectingNoThrows);
@@ -376,6 +570,20 @@ public:
    CPPUNIT_TEST(test_PushMessage_InvokeWhenTimersEmptyMulticastTrueNotificationNull_ExpectingNoThrows);
    CPPUNIT_TEST(test_PushMessage_WithLocalIfcAndMulticastTrue_MessageNotPutIntoQueue);
    CPPUNIT_TEST(test_PushMessage_InvokeWhenTimersEmptyMulticastFalse_ExpectingNoThrows);
+   CPPUNIT_TEST(test_SetCapacity_PushToFullQueueDropNewest_NewMessageDroppedAndCounted);
+   CPPUNIT_TEST(test_SetCapacity_PushToFullQueueDropOldest_OldestMessageDroppedAndCounted);
+   CPPUNIT_TEST(test_SetCapacity_MessagesTakenFromMiddle_SpaceAvailable);
+   CPPUNIT_TEST(test_SetCapacity_PushToFullQueueCoalesce_SameEventReplaced);
+   CPPUNIT_TEST(test_SetCapacity_PushToFullQueueBlockWithoutReader_DroppedAfterTimeout);
+   CPPUNIT_TEST(test_SetCapacity_SenderBlocked_RouterNotLocked);
+   CPPUNIT_TEST(test_SetCapacity_PushToFullQueueBlockWithRouterLock_DroppedImmediately);
+   CPPUNIT_TEST(test_ReadMessage_ExpiredMessagesQueued_ExpiredSkippedAndCounted);
+   CPPUNIT_TEST(test_PushPacket_PacketExpired_DroppedAndCounted);
+   CPPUNIT_TEST(test_SetLastValueCache_SubscribeAfterBroadcast_LastValuesReceived);
+   CPPUNIT_TEST(test_SetSubscriptions_FilteredReceiver_OnlySubscribedEventsQueued);
+   CPPUNIT_TEST(test_SetSubscriptions_SubscriptionsChanged_PreviousSetReplaced);
+   CPPUNIT_TEST(test_ReadMessage_GenericSelectorSharedEventsQueued_OnlyMatchCloned);
+   CPPUNIT_TEST(test_LeaveGroup_FilteredReceiverJoinsAgain_PreviousSubscriptionsDropped);
    CPPUNIT_TEST(test_PushPacket_InvokeWhenFactoryExistsAndProvidesValidMessage_ExpectingTrueReturned);
    CPPUNIT_TEST(test_PushPacket_InvokeWhenFactoryExistsAndProvidesNullMessage_ExpectingFalseReturned);
    CPPUNIT_TEST(test_PushPacket_InvokeWhenFactoryDoesntExist_ExpectingFalseReturned);
@@ -0,0 +1,118 @@
+//////////////////////////////////////////////////////////////////////
+/// @file ReactorTest.cpp
+/// @brief Unit Tests to test Reactor
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#include "ReactorTest.hpp"
+#include <set>
+#include <vector>
+#include <tsd/common/logging/LoggingManager.hpp>
+#include <tsd/communication/messaging/Reactor.hpp>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+
+namespace {
+
+class RecordingTask : public IReactorTask
+{
+   ReactorLoop&      m_loop;
+   std::vector<int>& m_log;
+   int               m_id;
+
+public:
+   bool m_onLoopThread;
+
+   RecordingTask(ReactorLoop& loop, std::vector<int>& log, int id)
+      : m_loop(loop), m_log(log), m_id(id), m_onLoopThread(false)
+   {
+   }
+
+   void reactorRun() override
+   {
+      m_onLoopThread = m_loop.isLoopThread();
+      m_log.push_back(m_id);
+   }
+};
+}
+
+void ReactorTest::tearDown()
+{
+   Reactor::configure(1, "");
+   tsd::common::logging::LoggingManager::cleanup();
+}
+
+void ReactorTest::test_Call_FromOtherThread_TaskExecutedOnLoopThread()
+{
+   ReactorLoop* loop = Reactor::attach();
+   CPPUNIT_ASSERT_MESSAGE("attach failed", loop != nullptr);
+
+   std::vector<int> log;
+   RecordingTask    task(*loop, log, 1);
+   loop->call(task);
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("task expected to be executed", static_cast<size_t>(1), log.size());
+   CPPUNIT_ASSERT_MESSAGE("task expected to run on loop thread", task.m_onLoopThread);
+   CPPUNIT_ASSERT_MESSAGE("caller is not the loop thread", !loop->isLoopThread());
+
+   Reactor::detach(loop);
+}
+
+void ReactorTest::test_Post_SeveralTasks_ExecutedInOrder()
+{
+   ReactorLoop* loop = Reactor::attach();
+   CPPUNIT_ASSERT_MESSAGE("attach failed", loop != nullptr);
+
+   std::vector<int> log;
+   RecordingTask    first(*loop, log, 1);
+   RecordingTask    second(*loop, log, 2);
+   RecordingTask    third(*loop, log, 3);
+   loop->post(&first);
+   loop->post(&second);
+   loop->call(third);
+
+   std::vector<int> expected{1, 2, 3};
+   CPPUNIT_ASSERT_MESSAGE("tasks expected to run in order", expected == log);
+
+   Reactor::detach(loop);
+}
+
+void ReactorTest::test_Attach_PoolOfOneThread_SameLoopReturned()
+{
+   Reactor::configure(1, "");
+
+   ReactorLoop* first  = Reactor::attach();
+   ReactorLoop* second = Reactor::attach();
+   CPPUNIT_ASSERT_MESSAGE("attach failed", first != nullptr && second != nullptr);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("ports expected to share the loop", first, second);
+
+   Reactor::detach(second);
+   Reactor::detach(first);
+}
+
+void ReactorTest::test_Attach_MoreLoopsThanConfigured_DistinctLoopsReturned()
+{
+   Reactor::configure(1, "");
+
+   std::vector<ReactorLoop*> loops;
+   CPPUNIT_ASSERT_MESSAGE("attach failed", Reactor::attach(3, loops));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("wrong number of loops", static_cast<size_t>(3), loops.size());
+
+   std::set<ReactorLoop*> distinct(loops.begin(), loops.end());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("loops expected to be distinct", static_cast<size_t>(3), distinct.size());
+
+   for (ReactorLoop* loop : loops)
+   {
+      Reactor::detach(loop);
+   }
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ReactorTest);
+
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
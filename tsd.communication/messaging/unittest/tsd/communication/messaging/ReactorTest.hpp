@@ -0,0 +1,71 @@
+//////////////////////////////////////////////////////////////////////
+/// @file ReactorTest.hpp
+/// @brief Header file for Unit Tests to test Reactor
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#ifndef TSD_COMMUNICATION_MESSAGING_REACTORTEST_HPP
+#define TSD_COMMUNICATION_MESSAGING_REACTORTEST_HPP
+
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+
+/**
+ * Testclass for Reactor
+ *
+ * @brief Testclass for Reactor
+ */
+class ReactorTest : public CPPUNIT_NS::TestFixture
+{
+public:
+   /**
+    * @brief tearDown function called after every test
+    */
+   void tearDown() override;
+   /**
+    * @brief Test scenario: called from other thread
+    *
+    * @tsd_testobject tsd::communication::messaging::ReactorLoop::Call
+    * @tsd_testexpected task executed on loop thread before call returns
+    */
+   void test_Call_FromOtherThread_TaskExecutedOnLoopThread();
+   /**
+    * @brief Test scenario: several tasks posted
+    *
+    * @tsd_testobject tsd::communication::messaging::ReactorLoop::Post
+    * @tsd_testexpected tasks executed in order
+    */
+   void test_Post_SeveralTasks_ExecutedInOrder();
+   /**
+    * @brief Test scenario: two ports with a pool of one thread
+    *
+    * @tsd_testobject tsd::communication::messaging::Reactor::Attach
+    * @tsd_testexpected same loop returned
+    */
+   void test_Attach_PoolOfOneThread_SameLoopReturned();
+   /**
+    * @brief Test scenario: more loops requested than configured
+    *
+    * @tsd_testobject tsd::communication::messaging::Reactor::Attach
+    * @tsd_testexpected distinct loops returned
+    */
+   void test_Attach_MoreLoopsThanConfigured_DistinctLoopsReturned();
+
+   CPPUNIT_TEST_SUITE(ReactorTest);
+   CPPUNIT_TEST(test_Call_FromOtherThread_TaskExecutedOnLoopThread);
+   CPPUNIT_TEST(test_Post_SeveralTasks_ExecutedInOrder);
+   CPPUNIT_TEST(test_Attach_PoolOfOneThread_SameLoopReturned);
+   CPPUNIT_TEST(test_Attach_MoreLoopsThanConfigured_DistinctLoopsReturned);
+   CPPUNIT_TEST_SUITE_END();
+};
+
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
+
+#endif // TSD_COMMUNICATION_MESSAGING_REACTORTEST_HPP
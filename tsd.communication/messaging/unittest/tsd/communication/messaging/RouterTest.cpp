@@ -11,8 +11,12 @@
 #define _GLIBCXX_TR1_FUNCTIONAL 0
 
 #include "RouterTest.hpp"
+#include <cstring>
+#include <vector>
+#include <tsd/common/ipc/networkinteger.h>
 #include <tsd/common/logging/LoggingManager.hpp>
 #include <tsd/communication/event/TsdEvent.hpp>
+#include <tsd/communication/messaging/IPortFake.hpp>
 #include <tsd/communication/messaging/IPortMock.hpp>
 #include <tsd/communication/messaging/Packet.hpp>
 #include <tsd/communication/messaging/QueueInternal.hpp>
@@ -22,6 +26,84 @@ namespace tsd {
 namespace communication {
 namespace messaging {
 
+namespace {
+
+using tsd::common::ipc::NetworkInteger;
+using tsd::communication::event::IfcAddr_t;
+
+constexpr uint8_t   PREFIX_LENGTH = 8U;
+constexpr uint32_t  FILTERED      = 1U;
+constexpr IfcAddr_t SUBNET_A      = UINT64_C(0x0100000000000000);
+constexpr IfcAddr_t REMOTE_ADDR   = UINT64_C(0x0300000000000005);
+
+/**
+ * Interface 5 of the router behind a downstream port.
+ */
+IfcAddr_t peerIfcAddr(IPort& port)
+{
+   return port.getLocalAddr() + (UINT64_C(1) << INTERFACE_ADDR_SIZE) + 5U;
+}
+
+/**
+ * MULTICAST_SUBSCRIBE of @p receiver. The first word is the filter flag,
+ * followed by the event IDs, see Router::announceSubscriptions().
+ */
+std::auto_ptr<Packet> makeSubscribe(IfcAddr_t receiver, IfcAddr_t sender, const std::vector<uint32_t>& words)
+{
+   std::vector<NetworkInteger<uint32_t>> payload(words.size());
+   for (size_t i = 0U; i < words.size(); ++i)
+   {
+      payload[i] = words[i];
+   }
+   return std::auto_ptr<Packet>(new Packet(Packet::MULTICAST_SUBSCRIBE,
+                                           receiver,
+                                           sender,
+                                           0,
+                                           reinterpret_cast<const char*>(payload.data()),
+                                           static_cast<uint32_t>(payload.size() * sizeof(NetworkInteger<uint32_t>))));
+}
+
+std::vector<uint32_t> subscribeWords(const std::shared_ptr<Packet>& pkt)
+{
+   std::vector<uint32_t> words;
+   if (pkt)
+   {
+      std::vector<NetworkInteger<uint32_t>> payload(pkt->getBufferLength() / sizeof(NetworkInteger<uint32_t>));
+      std::memcpy(payload.data(), pkt->getBufferPtr(), payload.size() * sizeof(NetworkInteger<uint32_t>));
+      words.assign(payload.begin(), payload.end());
+   }
+   return words;
+}
+
+void broadcast(Router& router, IfcAddr_t sender, const std::vector<uint32_t>& events)
+{
+   for (uint32_t id : events)
+   {
+      router.sendBroadcastMessage(sender, std::auto_ptr<tsd::communication::event::TsdEvent>(new tsd::communication::event::TsdEvent(id)));
+   }
+}
+
+/**
+ * Connect @p port as upstream port to subnet A.
+ */
+void connectUpstream(IPortFake& port)
+{
+   port.link();
+   port.injectOffer(SUBNET_A, PREFIX_LENGTH, 0U);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Upstream port not connected", true, port.initUpstream(""));
+}
+
+/**
+ * Connect @p port as downstream port and wait for its offer.
+ */
+void connectDownstream(IPortFake& port)
+{
+   port.link();
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Downstream port not started", true, port.initDownstream());
+   CPPUNIT_ASSERT_MESSAGE("No offer sent to downstream peer", port.waitSent(Packet::DHCP_OFFER) != nullptr);
+}
+}
+
 void RouterTest::setUp()
 {
    m_TestObjectName = "testName";
@@ -139,6 +221,47 @@ void RouterTest::test_FreeDownstreamAddr_InvokeAfterAddingAddress_ExpectingNoThr
    CPPUNIT_ASSERT_NO_THROW_MESSAGE("freeDownStream failed with a throw", m_TestObj->freeDownstreamAddr(testAddr));
 }
 
+void RouterTest::test_ReserveDownstreamAddr_InvokeProvidedFreeSubnet_ExpectingTrueReturned()
+{
+   tsd::communication::event::IfcAddr_t testAddr{0}, testNameServAddr{0};
+   uint8_t                              testPrefix{0};
+   m_TestObj->allocateDownstreamAddr(testAddr, testPrefix, testNameServAddr);
+   m_TestObj->freeDownstreamAddr(testAddr);
+   tsd::communication::event::IfcAddr_t retNameServAddr{0};
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("reserveDownstreamAddr returned false when true expected",
+                                true,
+                                m_TestObj->reserveDownstreamAddr(testAddr, testPrefix, retNameServAddr));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Name server of reserved subnet doesn't match expected", testNameServAddr, retNameServAddr);
+}
+
+void RouterTest::test_ReserveDownstreamAddr_InvokeProvidedSubnetInUse_ExpectingFalseReturned()
+{
+   tsd::communication::event::IfcAddr_t testAddr{0}, testNameServAddr{0};
+   uint8_t                              testPrefix{0};
+   m_TestObj->allocateDownstreamAddr(testAddr, testPrefix, testNameServAddr);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("reserveDownstreamAddr returned true when false expected",
+                                false,
+                                m_TestObj->reserveDownstreamAddr(testAddr, testPrefix, testNameServAddr));
+}
+
+void RouterTest::test_ReserveDownstreamAddr_InvokeProvidedOtherPrefixLength_ExpectingFalseReturned()
+{
+   tsd::communication::event::IfcAddr_t testAddr{0x0500000000000000}, testNameServAddr{0};
+   uint8_t                              testPrefix{16};
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("reserveDownstreamAddr returned true when false expected",
+                                false,
+                                m_TestObj->reserveDownstreamAddr(testAddr, testPrefix, testNameServAddr));
+}
+
+void RouterTest::test_ReserveDownstreamAddr_InvokeProvidedSubnetZero_ExpectingFalseReturned()
+{
+   tsd::communication::event::IfcAddr_t testAddr{0}, testNameServAddr{0};
+   uint8_t                              testPrefix{8};
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("reserveDownstreamAddr returned true when false expected",
+                                false,
+                                m_TestObj->reserveDownstreamAddr(testAddr, testPrefix, testNameServAddr));
+}
+
 void RouterTest::test_AddDownstreamPort_InvokeProvidedPort_ExpectingNoThrows()
 {
    IPortMock*             testPortMock = new IPortMock(*m_TestObj.get());
@@ -188,6 +311,29 @@ void RouterTest::test_AddUpstreamPort_InvokeWhenSubNetsNotEmpty_ExpectingFalseRe
       "addUpstreamPort returned false when true expected", false, m_TestObj->addUpstreamPort(testPort.get(), testNameServAddr, ""));
 }
 
+void RouterTest::test_ResumeUpstreamPort_InvokeProvidedSuspendedDefaultGateway_ExpectingTrueReturned()
+{
+   tsd::communication::event::IfcAddr_t testNameServAddr{2};
+   IPortMock*                           testPortMock = new IPortMock(*m_TestObj.get());
+   std::shared_ptr<IPort>               testPort(testPortMock);
+   m_TestObj->addUpstreamPort(testPort.get(), testNameServAddr, "");
+   m_TestObj->suspendUpstreamPort(testPort.get());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("resumeUpstreamPort returned false when true expected",
+                                true,
+                                m_TestObj->resumeUpstreamPort(testPort.get(), testNameServAddr, ""));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Port is not default gateway anymore", true, m_TestObj->hasUpstreamPort());
+}
+
+void RouterTest::test_ResumeUpstreamPort_InvokeProvidedPortNotDefaultGateway_ExpectingFalseReturned()
+{
+   tsd::communication::event::IfcAddr_t testNameServAddr{2};
+   IPortMock*                           testPortMock = new IPortMock(*m_TestObj.get());
+   std::shared_ptr<IPort>               testPort(testPortMock);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("resumeUpstreamPort returned true when false expected",
+                                false,
+                                m_TestObj->resumeUpstreamPort(testPort.get(), testNameServAddr, ""));
+}
+
 void RouterTest::test_DelPort_InvokeProvidedPortExistingInPortsAndIsDefaultGateway_ExpectingNoThrows()
 {
    tsd::communication::event::IfcAddr_t testNameServAddr{1};
@@ -204,6 +350,32 @@ void RouterTest::test_DelPort_InvokeProvidedPortNotExistingInPortsAndNotDefaultG
    CPPUNIT_ASSERT_NO_THROW_MESSAGE("delPort failed with a throw", m_TestObj->delPort(testPort.get()));
 }
 
+void RouterTest::test_DelPort_ReceiverBehindVanishedPort_DroppedFromAnnouncedSubscriptions()
+{
+   IPortFake upstream(*m_TestObj.get());
+   IPortFake downstream(*m_TestObj.get());
+   Queue     testQueue("testQueue", *m_TestObj.get());
+   connectUpstream(upstream);
+   connectDownstream(downstream);
+   IfcAddr_t remoteReceiver = peerIfcAddr(downstream);
+   downstream.inject(std::auto_ptr<Packet>(new Packet(Packet::MULTICAST_JOIN, remoteReceiver, REMOTE_ADDR)));
+   downstream.inject(makeSubscribe(remoteReceiver, REMOTE_ADDR, {FILTERED, 1U, 9U}));
+   downstream.sync();
+   CPPUNIT_ASSERT_MESSAGE("Remote subscriptions not announced upstream",
+                          (std::vector<uint32_t>{FILTERED, 1U, 9U}) == subscribeWords(upstream.waitSent(Packet::MULTICAST_SUBSCRIBE)));
+   IfcAddr_t localReceiver = m_TestObj->allocateIfcAddr(&testQueue);
+   m_TestObj->joinGroup(REMOTE_ADDR, localReceiver);
+   m_TestObj->setSubscriptions(REMOTE_ADDR, localReceiver, std::set<uint32_t>{1U});
+
+   downstream.unlink();
+   downstream.sync();
+   m_TestObj->setSubscriptions(REMOTE_ADDR, localReceiver, std::set<uint32_t>{1U, 2U});
+
+   CPPUNIT_ASSERT_MESSAGE("Subscriptions of vanished receiver still announced",
+                          (std::vector<uint32_t>{FILTERED, 1U, 2U}) == subscribeWords(upstream.waitSent(Packet::MULTICAST_SUBSCRIBE, 2U)));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Unchanged subscriptions announced again", size_t(2), upstream.countSent(Packet::MULTICAST_SUBSCRIBE));
+}
+
 void RouterTest::test_IsAnyPortAddr_InvokeProvidedPortSameToDefaultGateway_ExpectingTrueReturned()
 {
    tsd::communication::event::IfcAddr_t testNameServAddr{1};
@@ -312,6 +484,35 @@ void RouterTest::test_LeaveGroup_InvokeProvidedNonLocalSenderNotInStubsAndMatchi
    CPPUNIT_ASSERT_EQUAL_MESSAGE("leaveGroup returned false unexpected", false, m_TestObj->leaveGroup(testSenderDiffAddr, testReceiverAddr));
 }
 
+void RouterTest::test_SetSubscriptions_StubbedGroup_UnionAnnouncedUpstream()
+{
+   IPortFake upstream(*m_TestObj.get());
+   Queue     testQueue("testQueue", *m_TestObj.get());
+   connectUpstream(upstream);
+   IfcAddr_t receiver1 = m_TestObj->allocateIfcAddr(&testQueue);
+   IfcAddr_t receiver2 = m_TestObj->allocateIfcAddr(&testQueue);
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("joinGroup returned false unexpectedly", true, m_TestObj->joinGroup(REMOTE_ADDR, receiver1));
+   std::shared_ptr<Packet> announced = upstream.waitSent(Packet::MULTICAST_SUBSCRIBE);
+   CPPUNIT_ASSERT_MESSAGE("Empty subscriptions not announced", (std::vector<uint32_t>{FILTERED}) == subscribeWords(announced));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Subscriptions not sent to publisher", REMOTE_ADDR, announced->getReceiverAddr());
+
+   m_TestObj->setSubscriptions(REMOTE_ADDR, receiver1, std::set<uint32_t>{1U, 7U});
+   m_TestObj->joinGroup(REMOTE_ADDR, receiver2);
+   m_TestObj->setSubscriptions(REMOTE_ADDR, receiver2, std::set<uint32_t>{9U});
+   CPPUNIT_ASSERT_MESSAGE("Union of subscriptions not announced",
+                          (std::vector<uint32_t>{FILTERED, 1U, 7U, 9U}) == subscribeWords(upstream.waitSent(Packet::MULTICAST_SUBSCRIBE, 3U)));
+
+   m_TestObj->setSubscriptions(REMOTE_ADDR, receiver2, std::set<uint32_t>{8U});
+   CPPUNIT_ASSERT_MESSAGE("Updated subscriptions not announced",
+                          (std::vector<uint32_t>{FILTERED, 1U, 7U, 8U}) == subscribeWords(upstream.waitSent(Packet::MULTICAST_SUBSCRIBE, 4U)));
+
+   m_TestObj->leaveGroup(REMOTE_ADDR, receiver2);
+   CPPUNIT_ASSERT_MESSAGE("Subscriptions of leaving receiver still announced",
+                          (std::vector<uint32_t>{FILTERED, 1U, 7U}) == subscribeWords(upstream.waitSent(Packet::MULTICAST_SUBSCRIBE, 5U)));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Unchanged subscriptions announced again", size_t(5), upstream.countSent(Packet::MULTICAST_SUBSCRIBE));
+}
+
 void RouterTest::test_RoutePacket_InvokeWhenEgressPortNullIngressNotNullPacketTypeMulticastJoin_ExpectingTrueReturned()
 {
    tsd::communication::event::IfcAddr_t testSenderAddr{0xffffffff}, testReceiverAddr{0xffffffff}, testNameServAddr{2};
@@ -374,6 +575,33 @@ void RouterTest::test_RoutePacket_InvokeWhenEgressPortNullIngressNotNullPacketTy
    CPPUNIT_ASSERT_EQUAL_MESSAGE("routePacket returned true unexpectedly", false, m_TestObj->routePacket(m_TestPacket, testPort.get()));
 }
 
+void RouterTest::test_RoutePacket_SubscriptionsFromDownstreamPort_OnlySubscribedBroadcastsSent()
+{
+   IPortFake downstream(*m_TestObj.get());
+   Queue     testQueue("testQueue", *m_TestObj.get());
+   IfcAddr_t publisher = m_TestObj->allocateIfcAddr(&testQueue);
+   connectDownstream(downstream);
+   IfcAddr_t remoteReceiver = peerIfcAddr(downstream);
+   IfcAddr_t remotePublisher = downstream.getLocalAddr() | publisher;
+   downstream.inject(std::auto_ptr<Packet>(new Packet(Packet::MULTICAST_JOIN, remoteReceiver, remotePublisher)));
+   downstream.sync();
+   broadcast(*m_TestObj.get(), publisher, {1U, 2U});
+   CPPUNIT_ASSERT_MESSAGE("Receiver without subscriptions expected to get everything",
+                          (std::vector<uint32_t>{1U, 2U}) == downstream.sentEvents(Packet::MULTICAST_MESSAGE));
+
+   downstream.inject(makeSubscribe(remoteReceiver, remotePublisher, {FILTERED, 1U, 7U}));
+   downstream.sync();
+   broadcast(*m_TestObj.get(), publisher, {1U, 2U, 7U});
+   CPPUNIT_ASSERT_MESSAGE("Only subscribed events expected after subscription",
+                          (std::vector<uint32_t>{1U, 2U, 1U, 7U}) == downstream.sentEvents(Packet::MULTICAST_MESSAGE));
+
+   downstream.inject(makeSubscribe(remoteReceiver, remotePublisher, {FILTERED, 2U}));
+   downstream.sync();
+   broadcast(*m_TestObj.get(), publisher, {1U, 2U, 7U});
+   CPPUNIT_ASSERT_MESSAGE("Previous subscriptions not replaced",
+                          (std::vector<uint32_t>{1U, 2U, 1U, 7U, 2U}) == downstream.sentEvents(Packet::MULTICAST_MESSAGE));
+}
+
 void RouterTest::test_SendUnicastMessage_InvokeProvidedSenderReceiverAndMessage_ExpectingNoThrows()
 {
    tsd::communication::event::IfcAddr_t testSenderAddr{0xffffffff}, testReceiverAddr{2};
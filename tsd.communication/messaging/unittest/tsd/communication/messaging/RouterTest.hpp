@@ -123,6 +123,34 @@ public:
     * @tsd_testexpected expecting no throws
     */
    void test_FreeDownstreamAddr_InvokeAfterAddingAddress_ExpectingNoThrows();
+   /**
+    * @brief Test scenario: invoke provided free subnet
+    *
+    * @tsd_testobject tsd::communication::messaging::Router::ReserveDownstreamAddr
+    * @tsd_testexpected expecting true returned
+    */
+   void test_ReserveDownstreamAddr_InvokeProvidedFreeSubnet_ExpectingTrueReturned();
+   /**
+    * @brief Test scenario: invoke provided subnet in use
+    *
+    * @tsd_testobject tsd::communication::messaging::Router::ReserveDownstreamAddr
+    * @tsd_testexpected expecting false returned
+    */
+   void test_ReserveDownstreamAddr_InvokeProvidedSubnetInUse_ExpectingFalseReturned();
+   /**
+    * @brief Test scenario: invoke provided other prefix length
+    *
+    * @tsd_testobject tsd::communication::messaging::Router::ReserveDownstreamAddr
+    * @tsd_testexpected expecting false returned
+    */
+   void test_ReserveDownstreamAddr_InvokeProvidedOtherPrefixLength_ExpectingFalseReturned();
+   /**
+    * @brief Test scenario: invoke provided subnet zero
+    *
+    * @tsd_testobject tsd::communication::messaging::Router::ReserveDownstreamAddr
+    * @tsd_testexpected expecting false returned
+    */
+   void test_ReserveDownstreamAddr_InvokeProvidedSubnetZero_ExpectingFalseReturned();
    /**
     * @brief Test scenario: invoke provided port
     *
@@ -158,6 +186,20 @@ public:
     * @tsd_testexpected expecting false returned
     */
    void test_AddUpstreamPort_InvokeWhenSubNetsNotEmpty_ExpectingFalseReturned();
+   /**
+    * @brief Test scenario: invoke provided suspended default gateway
+    *
+    * @tsd_testobject tsd::communication::messaging::Router::ResumeUpstreamPort
+    * @tsd_testexpected expecting true returned
+    */
+   void test_ResumeUpstreamPort_InvokeProvidedSuspendedDefaultGateway_ExpectingTrueReturned();
+   /**
+    * @brief Test scenario: invoke provided port not default gateway
+    *
+    * @tsd_testobject tsd::communication::messaging::Router::ResumeUpstreamPort
+    * @tsd_testexpected expecting false returned
+    */
+   void test_ResumeUpstreamPort_InvokeProvidedPortNotDefaultGateway_ExpectingFalseReturned();
    /**
     * @brief Test scenario: invoke provided port existing in ports and is default gateway
     *
@@ -172,6 +214,13 @@ public:
     * @tsd_testexpected expecting no throws
     */
    void test_DelPort_InvokeProvidedPortNotExistingInPortsAndNotDefaultGateway_ExpectingNoThrows();
+   /**
+    * @brief Test scenario: downstream port of a subscribed remote receiver vanishes and a local receiver changes its subscriptions
+    *
+    * @tsd_testobject tsd::communication::messaging::Router::DelPort
+    * @tsd_testexpected subscriptions of the remote receiver no longer announced upstream
+    */
+   void test_DelPort_ReceiverBehindVanishedPort_DroppedFromAnnouncedSubscriptions();
    /**
     * @brief Test scenario: invoke provided port same to default gateway
     *
@@ -270,6 +319,13 @@ public:
     * @tsd_testexpected expecting false returned
     */
    void test_LeaveGroup_InvokeProvidedNonLocalSenderNotInStubsAndMatchingReceiver_ExpectingFalseReturned();
+   /**
+    * @brief Test scenario: local receivers of a remote sender join, change their subscriptions and leave
+    *
+    * @tsd_testobject tsd::communication::messaging::Router::SetSubscriptions
+    * @tsd_testexpected union of the subscriptions announced upstream whenever it changed
+    */
+   void test_SetSubscriptions_StubbedGroup_UnionAnnouncedUpstream();
    /**
     * @brief Test scenario: invoke when egress port null ingress not null packet type multicast join
     *
@@ -319,6 +375,13 @@ public:
     * @tsd_testexpected expecting false returned
     */
    void test_RoutePacket_InvokeWhenEgressPortNullIngressNotNullPacketTypeDhcpOffer_ExpectingFalseReturned();
+   /**
+    * @brief Test scenario: remote receiver behind a downstream port joins a local group, subscribes and changes its subscriptions
+    *
+    * @tsd_testobject tsd::communication::messaging::Router::RoutePacket
+    * @tsd_testexpected all broadcasts sent until the first subscription, afterwards only the currently subscribed ones
+    */
+   void test_RoutePacket_SubscriptionsFromDownstreamPort_OnlySubscribedBroadcastsSent();
    /**
     * @brief Test scenario: invoke provided sender receiver and message
     *
@@ -373,13 +436,20 @@ public:
    CPPUNIT_TEST(test_AllocateDownstreamAddr_DefaultGatewayNull_ExpectingTrueReturned);
    CPPUNIT_TEST(test_AllocateDownstreamAddr_DefaultGatewayNotNull_ExpectingTrueReturned);
    CPPUNIT_TEST(test_FreeDownstreamAddr_InvokeAfterAddingAddress_ExpectingNoThrows);
+   CPPUNIT_TEST(test_ReserveDownstreamAddr_InvokeProvidedFreeSubnet_ExpectingTrueReturned);
+   CPPUNIT_TEST(test_ReserveDownstreamAddr_InvokeProvidedSubnetInUse_ExpectingFalseReturned);
+   CPPUNIT_TEST(test_ReserveDownstreamAddr_InvokeProvidedOtherPrefixLength_ExpectingFalseReturned);
+   CPPUNIT_TEST(test_ReserveDownstreamAddr_InvokeProvidedSubnetZero_ExpectingFalseReturned);
    CPPUNIT_TEST(test_AddDownstreamPort_InvokeProvidedPort_ExpectingNoThrows);
    CPPUNIT_TEST(test_AddUpstreamPort_InvokeWhenDefaultGatewayNullSubNetsNotEmptySubDomainEmpty_ExpectingTrueReturned);
    CPPUNIT_TEST(test_AddUpstreamPort_InvokeWhenDefaultGatewayNullSubNetsNotEmptySubDomainNotEmpty_ExpectingTrueReturned);
    CPPUNIT_TEST(test_AddUpstreamPort_InvokeWhenDefaultGatewayNotNull_ExpectingFalseReturned);
    CPPUNIT_TEST(test_AddUpstreamPort_InvokeWhenSubNetsNotEmpty_ExpectingFalseReturned);
+   CPPUNIT_TEST(test_ResumeUpstreamPort_InvokeProvidedSuspendedDefaultGateway_ExpectingTrueReturned);
+   CPPUNIT_TEST(test_ResumeUpstreamPort_InvokeProvidedPortNotDefaultGateway_ExpectingFalseReturned);
    CPPUNIT_TEST(test_DelPort_InvokeProvidedPortExistingInPortsAndIsDefaultGateway_ExpectingNoThrows);
    CPPUNIT_TEST(test_DelPort_InvokeProvidedPortNotExistingInPortsAndNotDefaultGateway_ExpectingNoThrows);
+   CPPUNIT_TEST(test_DelPort_ReceiverBehindVanishedPort_DroppedFromAnnouncedSubscriptions);
    CPPUNIT_TEST(test_IsAnyPortAddr_InvokeProvidedPortSameToDefaultGateway_ExpectingTrueReturned);
    CPPUNIT_TEST(test_IsAnyPortAddr_InvokeProvidedPortExistingInPortsDefaultGatewayNull_ExpectingTrueReturned);
    CPPUNIT_TEST(test_IsAnyPortAddr_InvokeProvidedPortNotDefaultGateway_ExpectingTrueReturned);
@@ -394,6 +464,7 @@ public:
    CPPUNIT_TEST(test_LeaveGroup_InvokeProvidedNonLocalSenderAndMatchingReceiver_ExpectingTrueReturned);
    CPPUNIT_TEST(test_LeaveGroup_InvokeProvidedNonLocalSenderAndNotMatchingReceiver_ExpectingFalseReturned);
    CPPUNIT_TEST(test_LeaveGroup_InvokeProvidedNonLocalSenderNotInStubsAndMatchingReceiver_ExpectingFalseReturned);
+   CPPUNIT_TEST(test_SetSubscriptions_StubbedGroup_UnionAnnouncedUpstream);
    CPPUNIT_TEST(test_RoutePacket_InvokeWhenEgressPortNullIngressNotNullPacketTypeMulticastJoin_ExpectingTrueReturned);
    CPPUNIT_TEST(test_RoutePacket_InvokeWhenEgressPortNullIngressPortNotNullPacketTypeMulticastLeave_ExpectingTrueReturned);
    CPPUNIT_TEST(test_RoutePacket_InvokeWhenEgressPortNullIngressPortNotNullPacketTypeDeathNotification_ExpectingTrueReturned);
@@ -401,6 +472,7 @@ public:
    CPPUNIT_TEST(test_RoutePacket_InvokeWhenEgressPortNullIngressPortNullPacketTypeMulticastMessageGroupNotExisting_ExpectingFalseReturned);
    CPPUNIT_TEST(test_RoutePacket_InvokeWhenPacketTypeMulticastMessageGroupExistingFoundEqualLoopBackAddress_ExpectingFalseReturned);
    CPPUNIT_TEST(test_RoutePacket_InvokeWhenEgressPortNullIngressNotNullPacketTypeDhcpOffer_ExpectingFalseReturned);
+   CPPUNIT_TEST(test_RoutePacket_SubscriptionsFromDownstreamPort_OnlySubscribedBroadcastsSent);
    CPPUNIT_TEST(test_SendUnicastMessage_InvokeProvidedSenderReceiverAndMessage_ExpectingNoThrows);
    CPPUNIT_TEST(test_SendBroadcastMessage_InvokeWhenGroupExistingAndFoundIsNotLocalAddress_ExpectingNoThrows);
    CPPUNIT_TEST(test_SendBroadcastMessage_InvokeWhenGroupExistingAndFoundIsLocalAddress_ExpectingNoThrows);
@@ -0,0 +1,248 @@
+//////////////////////////////////////////////////////////////////////
+/// @file SendSchedulerTest.cpp
+/// @brief Unit Tests to test SendScheduler
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#include "SendSchedulerTest.hpp"
+#include <memory>
+#include <string>
+#include <tsd/communication/messaging/Packet.hpp>
+#include <tsd/communication/messaging/SendScheduler.hpp>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+namespace {
+const tsd::communication::event::IfcAddr_t SENDER{0x0000012300000005ull};
+const tsd::communication::event::IfcAddr_t RECEIVER{0x0000012301000007ull};
+const std::string                          PAYLOAD(1000, 'x');
+
+Packet* message(MessagePriority prio, uint32_t eventId, tsd::communication::event::IfcAddr_t sender = SENDER)
+{
+   Packet* pkt = new Packet(Packet::UNICAST_MESSAGE, sender, RECEIVER, eventId, PAYLOAD.data(),
+                            static_cast<uint32_t>(PAYLOAD.size()));
+   pkt->setPriority(prio);
+   return pkt;
+}
+
+// control packets of another pair, the same pair would keep them in order
+Packet* control(uint32_t eventId)
+{
+   return new Packet(Packet::MULTICAST_JOIN, RECEIVER, SENDER, eventId, NULL, 0);
+}
+
+uint32_t popEventId(SendScheduler& sched)
+{
+   SendChunk chunk;
+   CPPUNIT_ASSERT_MESSAGE("Packet is expected to be queued", sched.pop(chunk));
+   CPPUNIT_ASSERT_MESSAGE("Whole packet is expected", chunk.isLast() && chunk.m_offset == 0u);
+   std::unique_ptr<Packet> pkt{chunk.m_packet};
+   return pkt->getEventId();
+}
+}
+
+void SendSchedulerTest::test_Pop_ControlBehindBulk_ControlFirst()
+{
+   SendScheduler sched;
+   for (uint32_t i = 0; i < 10; i++) {
+      sched.push(message(PRIORITY_BULK, i));
+   }
+   sched.push(control(100));
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Size is not as expected", static_cast<size_t>(11), sched.size());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Control packet is expected first", 100u, popEventId(sched));
+   for (uint32_t i = 0; i < 10; i++) {
+      CPPUNIT_ASSERT_EQUAL_MESSAGE("Bulk order is not as expected", i, popEventId(sched));
+   }
+   CPPUNIT_ASSERT_MESSAGE("Scheduler is expected to be empty", sched.empty());
+   SendChunk chunk;
+   CPPUNIT_ASSERT_MESSAGE("No packet is expected", !sched.pop(chunk));
+}
+
+void SendSchedulerTest::test_Pop_BackloggedLanes_WeightedShare()
+{
+   // different senders keep the two flows in separate buckets
+   SendScheduler sched;
+   for (uint32_t i = 0; i < 90; i++) {
+      sched.push(message(PRIORITY_BULK, 1000 + i, SENDER + 1u));
+      sched.push(message(PRIORITY_REALTIME, i));
+   }
+
+   unsigned realtime = 0;
+   for (unsigned i = 0; i < 90; i++) {
+      if (popEventId(sched) < 1000) {
+         realtime++;
+      }
+   }
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Realtime share is not as expected", 80u, realtime);
+}
+
+void SendSchedulerTest::test_Push_SamePairMixedPriorities_OrderKept()
+{
+   SendScheduler sched;
+   sched.push(message(PRIORITY_BULK, 0));
+   sched.push(message(PRIORITY_REALTIME, 1));
+   sched.push(message(PRIORITY_NORMAL, 2));
+   sched.push(message(PRIORITY_REALTIME, 3, SENDER + 1u));
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Unrelated realtime packet is expected first", 3u, popEventId(sched));
+   for (uint32_t i = 0; i < 3; i++) {
+      CPPUNIT_ASSERT_EQUAL_MESSAGE("Order is not as expected", i, popEventId(sched));
+   }
+
+   // the bucket is free again and the priority takes effect
+   sched.push(message(PRIORITY_BULK, 4, SENDER + 1u));
+   sched.push(message(PRIORITY_REALTIME, 5));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Realtime packet is expected first", 5u, popEventId(sched));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Bulk packet is expected last", 4u, popEventId(sched));
+}
+
+void SendSchedulerTest::test_DropOldest_MixedLanes_ControlKept()
+{
+   SendScheduler sched;
+   sched.push(control(0));
+   sched.push(message(PRIORITY_REALTIME, 1, SENDER + 1u));
+   sched.push(message(PRIORITY_NORMAL, 2));
+   sched.push(message(PRIORITY_NORMAL, 3));
+
+   CPPUNIT_ASSERT_MESSAGE("Drop is expected to succeed", sched.dropOldest());
+   CPPUNIT_ASSERT_MESSAGE("Drop is expected to succeed", sched.dropOldest());
+   CPPUNIT_ASSERT_MESSAGE("Drop is expected to succeed", sched.dropOldest());
+   CPPUNIT_ASSERT_MESSAGE("Control packet must not be dropped", !sched.dropOldest());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Control packet is expected to be left", 0u, popEventId(sched));
+
+   sched.push(message(PRIORITY_REALTIME, 4, SENDER + 1u));
+   sched.push(message(PRIORITY_NORMAL, 5));
+   sched.push(message(PRIORITY_NORMAL, 6));
+   CPPUNIT_ASSERT_MESSAGE("Drop is expected to succeed", sched.dropOldest());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Realtime packet is expected to be kept", 4u, popEventId(sched));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Newer normal packet is expected to be kept", 6u, popEventId(sched));
+}
+
+void SendSchedulerTest::test_DropMatching_QueuedEvent_NewestDropped()
+{
+   SendScheduler sched;
+   sched.push(message(PRIORITY_NORMAL, 1));
+   sched.push(message(PRIORITY_NORMAL, 2));
+   sched.push(message(PRIORITY_NORMAL, 1));
+
+   std::unique_ptr<Packet> other{message(PRIORITY_NORMAL, 1, SENDER + 1u)};
+   CPPUNIT_ASSERT_MESSAGE("Other sender must not match", !sched.dropMatching(other.get()));
+
+   std::unique_ptr<Packet> update{message(PRIORITY_NORMAL, 1)};
+   CPPUNIT_ASSERT_MESSAGE("Drop is expected to succeed", sched.dropMatching(update.get()));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Size is not as expected", static_cast<size_t>(2), sched.size());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Oldest packet is expected to be kept", 1u, popEventId(sched));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Unrelated packet is expected to be kept", 2u, popEventId(sched));
+   CPPUNIT_ASSERT_MESSAGE("Nothing is expected to match", !sched.dropMatching(update.get()));
+}
+
+void SendSchedulerTest::test_Replace_ConflatableMessages_ReplacedInPlace()
+{
+   SendScheduler sched;
+   for (uint32_t i = 1; i <= 2; i++) {
+      Packet* state = message(PRIORITY_NORMAL, i);
+      state->setConflatable(true);
+      sched.push(state);
+   }
+
+   Packet* update = message(PRIORITY_NORMAL, 1);
+   update->setConflatable(true);
+   CPPUNIT_ASSERT_MESSAGE("Replace is expected to succeed", sched.replace(update));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Size is not as expected", static_cast<size_t>(2), sched.size());
+
+   // a non-conflatable message must not be overtaken
+   sched.push(message(PRIORITY_NORMAL, 3));
+   std::unique_ptr<Packet> blocked{message(PRIORITY_NORMAL, 2)};
+   blocked->setConflatable(true);
+   CPPUNIT_ASSERT_MESSAGE("Replace must not overtake", !sched.replace(blocked.get()));
+   std::unique_ptr<Packet> other{message(PRIORITY_NORMAL, 1, SENDER + 1u)};
+   other->setConflatable(true);
+   CPPUNIT_ASSERT_MESSAGE("Other sender must not match", !sched.replace(other.get()));
+
+   SendChunk chunk;
+   CPPUNIT_ASSERT_MESSAGE("Packet is expected to be queued", sched.pop(chunk));
+   CPPUNIT_ASSERT_MESSAGE("Update is expected at the old position", chunk.m_packet == update);
+   delete chunk.m_packet;
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Order is not as expected", 2u, popEventId(sched));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Order is not as expected", 3u, popEventId(sched));
+   CPPUNIT_ASSERT_MESSAGE("Scheduler is expected to be empty", sched.empty());
+}
+
+void SendSchedulerTest::test_Pop_FragmentedPacket_OtherTrafficInterleaved()
+{
+   SendScheduler sched;
+   sched.setFragmentSize(400);
+   sched.push(message(PRIORITY_NORMAL, 1));
+
+   SendChunk chunk;
+   CPPUNIT_ASSERT_MESSAGE("Fragment is expected", sched.pop(chunk));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Offset is not as expected", 0u, chunk.m_offset);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Length is not as expected", 400u, chunk.m_length);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Flags are not as expected", static_cast<uint8_t>(FRAGMENT_MORE),
+                                chunk.m_fragment);
+   CPPUNIT_ASSERT_MESSAGE("Partially sent packet must not be dropped", !sched.dropOldest());
+
+   // the same pair waits for the rest, another one goes in between
+   sched.push(message(PRIORITY_NORMAL, 2));
+   Packet* urgent = new Packet(Packet::UNICAST_MESSAGE, SENDER + 1u, RECEIVER, 3, PAYLOAD.data(), 100);
+   urgent->setPriority(PRIORITY_REALTIME);
+   sched.push(urgent);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Realtime packet is expected in between", 3u, popEventId(sched));
+
+   CPPUNIT_ASSERT_MESSAGE("Fragment is expected", sched.pop(chunk));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Offset is not as expected", 400u, chunk.m_offset);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Flags are not as expected",
+                                static_cast<uint8_t>(FRAGMENT_MORE | FRAGMENT_CONT), chunk.m_fragment);
+   CPPUNIT_ASSERT_MESSAGE("Fragment is expected", sched.pop(chunk));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Offset is not as expected", 800u, chunk.m_offset);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Length is not as expected", 200u, chunk.m_length);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Flags are not as expected", static_cast<uint8_t>(FRAGMENT_CONT),
+                                chunk.m_fragment);
+   CPPUNIT_ASSERT_MESSAGE("Last fragment is expected", chunk.isLast());
+   std::unique_ptr<Packet> pkt{chunk.m_packet};
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Packet is not as expected", 1u, pkt->getEventId());
+
+   CPPUNIT_ASSERT_MESSAGE("Fragment is expected", sched.pop(chunk));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Next packet is not as expected", 2u, chunk.m_packet->getEventId());
+   sched.clear();
+}
+
+void SendSchedulerTest::test_Pop_ExpiredMessages_DroppedAndCounted()
+{
+   SendScheduler sched;
+   sched.setFragmentSize(400);
+   const uint32_t deadlines[] = {900u, 1500u, 900u};
+   for (uint32_t i = 0; i < 3; i++) {
+      Packet* pkt = message(PRIORITY_NORMAL, i + 1u);
+      pkt->setDeadline(deadlines[i]);
+      sched.push(pkt);
+   }
+
+   SendChunk chunk;
+   CPPUNIT_ASSERT_MESSAGE("Fragment is expected", sched.pop(chunk, 1000u));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Expired packet is expected to be skipped", 2u, chunk.m_packet->getEventId());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Remaining time is not as expected", 500u, chunk.m_timeToLive);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Expired count is not as expected", uint64_t(1), sched.getExpired());
+
+   // expired meanwhile but partially sent
+   CPPUNIT_ASSERT_MESSAGE("Fragment is expected", sched.pop(chunk, 2000u));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Offset is not as expected", 400u, chunk.m_offset);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Minimal remaining time is expected", 1u, chunk.m_timeToLive);
+   CPPUNIT_ASSERT_MESSAGE("Fragment is expected", sched.pop(chunk, 2000u));
+   CPPUNIT_ASSERT_MESSAGE("Last fragment is expected", chunk.isLast());
+   std::unique_ptr<Packet> pkt{chunk.m_packet};
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Packet is not as expected", 2u, pkt->getEventId());
+
+   CPPUNIT_ASSERT_MESSAGE("Last packet is expected to be dropped", !sched.pop(chunk, 2000u));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Expired count is not as expected", uint64_t(2), sched.getExpired());
+   CPPUNIT_ASSERT_MESSAGE("Scheduler is expected to be empty", sched.empty());
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SendSchedulerTest);
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
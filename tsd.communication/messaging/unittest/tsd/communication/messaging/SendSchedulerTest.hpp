@@ -0,0 +1,99 @@
+//////////////////////////////////////////////////////////////////////
+/// @file SendSchedulerTest.hpp
+/// @brief Header file for Unit Tests to test SendScheduler
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#ifndef TSD_COMMUNICATION_MESSAGING_SENDSCHEDULERTEST_HPP
+#define TSD_COMMUNICATION_MESSAGING_SENDSCHEDULERTEST_HPP
+
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+
+/**
+ * Testclass for SendScheduler
+ *
+ * @brief Testclass for SendScheduler
+ */
+class SendSchedulerTest : public CPPUNIT_NS::TestFixture
+{
+public:
+   /**
+    * @brief Test scenario: control packet queued behind a bulk backlog
+    *
+    * @tsd_testobject tsd::communication::messaging::SendScheduler::pop
+    * @tsd_testexpected control packet taken first
+    */
+   void test_Pop_ControlBehindBulk_ControlFirst();
+   /**
+    * @brief Test scenario: realtime and bulk lanes backlogged with equal packets
+    *
+    * @tsd_testobject tsd::communication::messaging::SendScheduler::pop
+    * @tsd_testexpected realtime lane served eight times as often as the bulk lane
+    */
+   void test_Pop_BackloggedLanes_WeightedShare();
+   /**
+    * @brief Test scenario: packets of one sender and receiver queued with different priorities
+    *
+    * @tsd_testobject tsd::communication::messaging::SendScheduler::push
+    * @tsd_testexpected packets taken in queuing order
+    */
+   void test_Push_SamePairMixedPriorities_OrderKept();
+   /**
+    * @brief Test scenario: oldest message dropped with control and normal packets queued
+    *
+    * @tsd_testobject tsd::communication::messaging::SendScheduler::dropOldest
+    * @tsd_testexpected normal message dropped, control packet never dropped
+    */
+   void test_DropOldest_MixedLanes_ControlKept();
+   /**
+    * @brief Test scenario: packet matched against queued messages
+    *
+    * @tsd_testobject tsd::communication::messaging::SendScheduler::dropMatching
+    * @tsd_testexpected newest queued message with same event and addresses dropped
+    */
+   void test_DropMatching_QueuedEvent_NewestDropped();
+   /**
+    * @brief Test scenario: conflatable messages queued with and without a non-conflatable one behind
+    *
+    * @tsd_testobject tsd::communication::messaging::SendScheduler::replace
+    * @tsd_testexpected queued message replaced in place unless the new one would overtake a non-conflatable one
+    */
+   void test_Replace_ConflatableMessages_ReplacedInPlace();
+   /**
+    * @brief Test scenario: packet above the fragment size queued before other traffic
+    *
+    * @tsd_testobject tsd::communication::messaging::SendScheduler::pop
+    * @tsd_testexpected packet handed out in fragments, other pairs sent in between, same pair after the last fragment
+    */
+   void test_Pop_FragmentedPacket_OtherTrafficInterleaved();
+   /**
+    * @brief Test scenario: messages with passed and future deadlines queued, one of them fragmented
+    *
+    * @tsd_testobject tsd::communication::messaging::SendScheduler::pop
+    * @tsd_testexpected expired messages dropped and counted, partially sent message completed, remaining time handed out
+    */
+   void test_Pop_ExpiredMessages_DroppedAndCounted();
+
+   CPPUNIT_TEST_SUITE(SendSchedulerTest);
+   CPPUNIT_TEST(test_Pop_ControlBehindBulk_ControlFirst);
+   CPPUNIT_TEST(test_Pop_BackloggedLanes_WeightedShare);
+   CPPUNIT_TEST(test_Push_SamePairMixedPriorities_OrderKept);
+   CPPUNIT_TEST(test_DropOldest_MixedLanes_ControlKept);
+   CPPUNIT_TEST(test_DropMatching_QueuedEvent_NewestDropped);
+   CPPUNIT_TEST(test_Replace_ConflatableMessages_ReplacedInPlace);
+   CPPUNIT_TEST(test_Pop_FragmentedPacket_OtherTrafficInterleaved);
+   CPPUNIT_TEST(test_Pop_ExpiredMessages_DroppedAndCounted);
+   CPPUNIT_TEST_SUITE_END();
+};
+
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
+
+#endif // TSD_COMMUNICATION_MESSAGING_SENDSCHEDULERTEST_HPP
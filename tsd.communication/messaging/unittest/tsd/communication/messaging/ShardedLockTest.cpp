@@ -0,0 +1,86 @@
+//////////////////////////////////////////////////////////////////////
+/// @file ShardedLockTest.cpp
+/// @brief Unit Tests to test ShardedLock
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#include "ShardedLockTest.hpp"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <tsd/communication/messaging/ShardedLock.hpp>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+
+void ShardedLockTest::test_CurrentShard_CalledTwiceFromSameThread_SameValidShardReturned()
+{
+   unsigned first  = ShardedLock::currentShard();
+   unsigned second = ShardedLock::currentShard();
+
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Shard of thread is expected to be stable", first, second);
+   CPPUNIT_ASSERT_MESSAGE("Shard out of range", first < static_cast<unsigned>(ShardedLock::NUM_SHARDS));
+}
+
+void ShardedLockTest::test_ReadGuard_TakenWhileHoldingWriteGuard_NoDeadlock()
+{
+   ShardedLock testLock;
+
+   ShardedLock::WriteGuard w(testLock);
+   {
+      ShardedLock::ReadGuard r(testLock);
+   }
+   w.unlock();
+
+   ShardedLock::ReadGuard r(testLock);
+   CPPUNIT_ASSERT_MESSAGE("Nested locking returned", true);
+}
+
+void ShardedLockTest::test_WriteGuard_ReaderOnOtherThread_ReaderBlockedUntilUnlock()
+{
+   ShardedLock       testLock;
+   std::atomic<bool> readerDone{false};
+
+   ShardedLock::WriteGuard w(testLock);
+   std::thread             reader([&testLock, &readerDone]() {
+      ShardedLock::ReadGuard r(testLock);
+      readerDone = true;
+   });
+
+   std::this_thread::sleep_for(std::chrono::milliseconds(50));
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Reader must not pass while writer holds lock", false, readerDone.load());
+
+   w.unlock();
+   reader.join();
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Reader expected to pass after writer released lock", true, readerDone.load());
+}
+
+void ShardedLockTest::test_IsHeldByCurrentThread_NestedGuards_HeldUntilLastRelease()
+{
+   ShardedLock testLock;
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Lock must not be held initially", false, ShardedLock::isHeldByCurrentThread());
+
+   ShardedLock::WriteGuard w(testLock);
+   {
+      ShardedLock::ReadGuard r(testLock);
+      r.unlock();
+      CPPUNIT_ASSERT_EQUAL_MESSAGE("Writer still holds the lock", true, ShardedLock::isHeldByCurrentThread());
+   }
+
+   bool heldByOther = true;
+   std::thread other([&heldByOther]() { heldByOther = ShardedLock::isHeldByCurrentThread(); });
+   other.join();
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Lock is not held by other thread", false, heldByOther);
+
+   w.unlock();
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Lock must not be held after release", false, ShardedLock::isHeldByCurrentThread());
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(ShardedLockTest);
+
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
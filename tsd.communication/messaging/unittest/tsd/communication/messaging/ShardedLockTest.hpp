@@ -0,0 +1,67 @@
+//////////////////////////////////////////////////////////////////////
+/// @file ShardedLockTest.hpp
+/// @brief Header file for Unit Tests to test ShardedLock
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#ifndef TSD_COMMUNICATION_MESSAGING_SHARDEDLOCKTEST_HPP
+#define TSD_COMMUNICATION_MESSAGING_SHARDEDLOCKTEST_HPP
+
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+
+/**
+ * Testclass for ShardedLock
+ *
+ * @brief Testclass for ShardedLock
+ */
+class ShardedLockTest : public CPPUNIT_NS::TestFixture
+{
+public:
+   /**
+    * @brief Test scenario: called twice from same thread
+    *
+    * @tsd_testobject tsd::communication::messaging::ShardedLock::CurrentShard
+    * @tsd_testexpected same valid shard returned
+    */
+   void test_CurrentShard_CalledTwiceFromSameThread_SameValidShardReturned();
+   /**
+    * @brief Test scenario: read guard taken while holding write guard
+    *
+    * @tsd_testobject tsd::communication::messaging::ShardedLock::ReadGuard
+    * @tsd_testexpected no dead-lock
+    */
+   void test_ReadGuard_TakenWhileHoldingWriteGuard_NoDeadlock();
+   /**
+    * @brief Test scenario: reader on other thread while write guard held
+    *
+    * @tsd_testobject tsd::communication::messaging::ShardedLock::WriteGuard
+    * @tsd_testexpected reader blocked until write guard released
+    */
+   void test_WriteGuard_ReaderOnOtherThread_ReaderBlockedUntilUnlock();
+   /**
+    * @brief Test scenario: nested guards taken and released
+    *
+    * @tsd_testobject tsd::communication::messaging::ShardedLock::IsHeldByCurrentThread
+    * @tsd_testexpected held until the outermost guard is released, never held on other threads
+    */
+   void test_IsHeldByCurrentThread_NestedGuards_HeldUntilLastRelease();
+
+   CPPUNIT_TEST_SUITE(ShardedLockTest);
+   CPPUNIT_TEST(test_CurrentShard_CalledTwiceFromSameThread_SameValidShardReturned);
+   CPPUNIT_TEST(test_ReadGuard_TakenWhileHoldingWriteGuard_NoDeadlock);
+   CPPUNIT_TEST(test_WriteGuard_ReaderOnOtherThread_ReaderBlockedUntilUnlock);
+   CPPUNIT_TEST(test_IsHeldByCurrentThread_NestedGuards_HeldUntilLastRelease);
+   CPPUNIT_TEST_SUITE_END();
+};
+
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
+
+#endif // TSD_COMMUNICATION_MESSAGING_SHARDEDLOCKTEST_HPP
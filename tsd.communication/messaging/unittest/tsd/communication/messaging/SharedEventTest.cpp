@@ -0,0 +1,53 @@
+//////////////////////////////////////////////////////////////////////
+/// @file SharedEventTest.cpp
+/// @brief Unit Tests to test SharedEvent
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#include "SharedEventTest.hpp"
+#include <tsd/communication/event/TsdEvent.hpp>
+#include <tsd/communication/messaging/SharedEvent.hpp>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+namespace {
+const uint32_t                             DEFAULT_EVENT_ID{1};
+const tsd::communication::event::IfcAddr_t DEFAULT_SENDER{1};
+const tsd::communication::event::IfcAddr_t DEFAULT_RECEIVER{2};
+} // namespace
+
+void SharedEventTest::test_Take_InvokeWithLastReference_OriginalEventReturnedWithReceiverSet()
+{
+   tsd::communication::event::TsdEvent* orig = new tsd::communication::event::TsdEvent(DEFAULT_EVENT_ID);
+   SharedEvent* shared = new SharedEvent(std::auto_ptr<tsd::communication::event::TsdEvent>(orig));
+
+   std::auto_ptr<tsd::communication::event::TsdEvent> ret = shared->take(DEFAULT_RECEIVER);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Original event expected", orig, ret.get());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Receiver address is not as expected", DEFAULT_RECEIVER, ret->getReceiverAddr());
+}
+
+void SharedEventTest::test_Take_InvokeWithOtherReferences_CloneReturnedWithAddressesSet()
+{
+   tsd::communication::event::TsdEvent* orig = new tsd::communication::event::TsdEvent(DEFAULT_EVENT_ID);
+   orig->setSenderAddr(DEFAULT_SENDER);
+   SharedEvent* shared = new SharedEvent(std::auto_ptr<tsd::communication::event::TsdEvent>(orig));
+   shared->ref();
+
+   std::auto_ptr<tsd::communication::event::TsdEvent> ret = shared->take(DEFAULT_RECEIVER);
+   CPPUNIT_ASSERT_MESSAGE("Clone expected", orig != ret.get());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Event id is not as expected", DEFAULT_EVENT_ID, ret->getEventId());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Sender address is not as expected", DEFAULT_SENDER, ret->getSenderAddr());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Receiver address is not as expected", DEFAULT_RECEIVER, ret->getReceiverAddr());
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Shared event must stay intact", orig, shared->get());
+
+   shared->deref();
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(SharedEventTest);
+
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
@@ -0,0 +1,51 @@
+//////////////////////////////////////////////////////////////////////
+/// @file SharedEventTest.hpp
+/// @brief Header file for Unit Tests to test SharedEvent
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#ifndef TSD_COMMUNICATION_MESSAGING_SHAREDEVENTTEST_HPP
+#define TSD_COMMUNICATION_MESSAGING_SHAREDEVENTTEST_HPP
+
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+
+/**
+ * Testclass for SharedEvent
+ *
+ * @brief Testclass for SharedEvent
+ */
+class SharedEventTest : public CPPUNIT_NS::TestFixture
+{
+public:
+   /**
+    * @brief Test scenario: invoke with last reference
+    *
+    * @tsd_testobject tsd::communication::messaging::SharedEvent::Take
+    * @tsd_testexpected original event returned with receiver set
+    */
+   void test_Take_InvokeWithLastReference_OriginalEventReturnedWithReceiverSet();
+   /**
+    * @brief Test scenario: invoke while other references exist
+    *
+    * @tsd_testobject tsd::communication::messaging::SharedEvent::Take
+    * @tsd_testexpected clone returned with addresses set
+    */
+   void test_Take_InvokeWithOtherReferences_CloneReturnedWithAddressesSet();
+
+   CPPUNIT_TEST_SUITE(SharedEventTest);
+   CPPUNIT_TEST(test_Take_InvokeWithLastReference_OriginalEventReturnedWithReceiverSet);
+   CPPUNIT_TEST(test_Take_InvokeWithOtherReferences_CloneReturnedWithAddressesSet);
+   CPPUNIT_TEST_SUITE_END();
+};
+
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
+
+#endif // TSD_COMMUNICATION_MESSAGING_SHAREDEVENTTEST_HPP
@@ -21,6 +21,7 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 #include <thread>
+#include <vector>
 
 #include <tsd/common/logging/LoggingManager.hpp>
 #include <tsd/common/system/Semaphore.hpp>
@@ -399,6 +400,106 @@ void TcpEndpointTest::test_SelectError_WithNegativeOffset_NoExceptionThrown()
    CPPUNIT_ASSERT_MESSAGE("Mock was not verified",
                           ::testing::Mock::VerifyAndClearExpectations(static_cast<TcpEndpointMock*>(m_TestObj.get())));
 }
+
+void TcpEndpointTest::test_EpSendPacket_ManyPacketsWithZeroCopyThreshold_AllPacketsWritten()
+{
+   const size_t HEADER_SIZE{28};
+   const size_t NUM_PACKETS{100};
+   const size_t bufferLen{strlen(DEFAULT_BUFFER)};
+
+   int sv[2];
+   CPPUNIT_ASSERT_MESSAGE("Socketpair failed", socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+
+   // not supported on unix sockets, the endpoint must fall back to writev()
+   m_TestObj->setZeroCopyThreshold(1);
+   m_TestObj->init(sv[0], *m_Select.get());
+
+   bool sendRet = true;
+   for (size_t i = 0; i < NUM_PACKETS; ++i)
+   {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wconversion"
+      m_Packet.reset(new Packet(DEFAULT_TYPE, DEFAULT_SENDER, DEFAULT_RECEIVER, static_cast<uint32_t>(i),
+                                DEFAULT_BUFFER, bufferLen));
+#pragma GCC diagnostic pop
+      sendRet = m_TestObj->epSendPacket(m_Packet) && sendRet;
+   }
+
+   std::vector<char> received;
+   char              buffer[4096];
+   while (received.size() < NUM_PACKETS * (HEADER_SIZE + bufferLen))
+   {
+      ssize_t bytes = read(sv[1], buffer, sizeof(buffer));
+      if (bytes < 1) break;
+      received.insert(received.end(), buffer, buffer + bytes);
+   }
+
+   m_TestObj->cleanup();
+   close(sv[1]);
+
+   CPPUNIT_ASSERT_MESSAGE("Packet send failed", sendRet);
+   CPPUNIT_ASSERT_EQUAL(NUM_PACKETS * (HEADER_SIZE + bufferLen), received.size());
+   for (size_t i = 0; i < NUM_PACKETS; ++i)
+   {
+      const char* pkt = &received[i * (HEADER_SIZE + bufferLen)];
+      uint32_t    eventId;
+      memcpy(&eventId, pkt + 4, sizeof(eventId));
+      CPPUNIT_ASSERT_EQUAL(static_cast<uint32_t>(i), ntohl(eventId));
+      CPPUNIT_ASSERT_MESSAGE("Payload corrupted", memcmp(pkt + HEADER_SIZE, DEFAULT_BUFFER, bufferLen) == 0);
+   }
+
+   CPPUNIT_ASSERT_MESSAGE("Mock was not verified",
+                          ::testing::Mock::VerifyAndClearExpectations(static_cast<TcpEndpointMock*>(m_TestObj.get())));
+}
+
+void TcpEndpointTest::test_EpSendPacket_OobPacketBeforeMessage_HeaderStaysFixedSize()
+{
+   const size_t HEADER_SIZE{28};
+   const size_t bufferLen{strlen(DEFAULT_BUFFER)};
+   const size_t frameLen{HEADER_SIZE + bufferLen};
+
+   int sv[2];
+   CPPUNIT_ASSERT_MESSAGE("Socketpair failed", socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+   // a compact header shortens the stream, do not wait for the missing bytes forever
+   struct timeval timeout = {1, 0};
+   setsockopt(sv[1], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+   m_TestObj->init(sv[0], *m_Select.get());
+
+   const Packet::Type types[] = {Packet::OOB_BASE, Packet::UNICAST_MESSAGE};
+   bool               sendRet = true;
+   for (size_t i = 0; i < 2; ++i)
+   {
+      m_Packet.reset(new Packet(types[i], DEFAULT_SENDER, DEFAULT_RECEIVER, static_cast<uint32_t>(i + 1),
+                                DEFAULT_BUFFER, static_cast<uint32_t>(bufferLen)));
+      sendRet = m_TestObj->epSendPacket(m_Packet) && sendRet;
+   }
+
+   std::vector<char> received;
+   char              buffer[256];
+   while (received.size() < 2 * frameLen)
+   {
+      ssize_t bytes = read(sv[1], buffer, sizeof(buffer));
+      if (bytes < 1) break;
+      received.insert(received.end(), buffer, buffer + bytes);
+   }
+
+   m_TestObj->cleanup();
+   close(sv[1]);
+
+   CPPUNIT_ASSERT_MESSAGE("Packet send failed", sendRet);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Frames not written with the fixed header", 2 * frameLen, received.size());
+   for (size_t i = 0; i < 2; ++i)
+   {
+      const char* pkt = &received[i * frameLen];
+      uint32_t    msgLen;
+      uint32_t    eventId;
+      memcpy(&msgLen, pkt, sizeof(msgLen));
+      memcpy(&eventId, pkt + 4, sizeof(eventId));
+      CPPUNIT_ASSERT_EQUAL_MESSAGE("Length not in fixed header", static_cast<uint32_t>(bufferLen), ntohl(msgLen));
+      CPPUNIT_ASSERT_EQUAL_MESSAGE("Event ID not in fixed header", static_cast<uint32_t>(i + 1), ntohl(eventId));
+      CPPUNIT_ASSERT_MESSAGE("Payload corrupted", memcmp(pkt + HEADER_SIZE, DEFAULT_BUFFER, bufferLen) == 0);
+   }
+}
 CPPUNIT_TEST_SUITE_REGISTRATION(TcpEndpointTest);
 } // namespace messaging
 } // namespace communication
@@ -120,6 +120,20 @@ public:
     * @tsd_testexpected no exception thrown
     */
    void test_SelectError_WithNegativeOffset_NoExceptionThrown();
+   /**
+    * @brief Test scenario: many packets with zero copy threshold on unix socket
+    *
+    * @tsd_testobject tsd::communication::messaging::TcpEndpoint::EpSendPacket
+    * @tsd_testexpected all packets written in order
+    */
+   void test_EpSendPacket_ManyPacketsWithZeroCopyThreshold_AllPacketsWritten();
+   /**
+    * @brief Test scenario: out-of-band packet of the first OOB type sent before a message
+    *
+    * @tsd_testobject tsd::communication::messaging::TcpEndpoint::EpSendPacket
+    * @tsd_testexpected both packets written with the fixed size header
+    */
+   void test_EpSendPacket_OobPacketBeforeMessage_HeaderStaysFixedSize();
 
    CPPUNIT_TEST_SUITE(TcpEndpointTest);
    CPPUNIT_TEST(test_EpSendPacket_WithEmptySendQueueAndZeroOffset_TrueReturned);
@@ -132,6 +146,8 @@ public:
    CPPUNIT_TEST(test_SelectWritable_WithNegativeOffset_NoExceptionThrown);
    CPPUNIT_TEST(test_SelectReadable_WithNotEmptyMessage_NoExceptionThrown);
    CPPUNIT_TEST(test_SelectError_WithNegativeOffset_NoExceptionThrown);
+   CPPUNIT_TEST(test_EpSendPacket_ManyPacketsWithZeroCopyThreshold_AllPacketsWritten);
+   CPPUNIT_TEST(test_EpSendPacket_OobPacketBeforeMessage_HeaderStaysFixedSize);
    CPPUNIT_TEST_SUITE_END();
 
 private:
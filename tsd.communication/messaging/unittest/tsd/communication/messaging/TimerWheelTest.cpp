@@ -0,0 +1,112 @@
+//////////////////////////////////////////////////////////////////////
+/// @file TimerWheelTest.cpp
+/// @brief Unit Tests to test TimerWheel
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#include "TimerWheelTest.hpp"
+#include <tsd/communication/messaging/TimerWheel.hpp>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+
+namespace {
+
+/// Advance the wheel tick by tick and return the tick where @p ref expired.
+uint32_t runUntilExpired(TimerWheel &wheel, uint32_t now, TimerRef_t ref, uint32_t maxTicks)
+{
+   for (uint32_t i = 0; i <= maxTicks; i++, now++) {
+      TimerWheel::Timer *t;
+      while ((t = wheel.expire(now)) != nullptr) {
+         if (t->m_ref == ref) {
+            return now;
+         }
+      }
+   }
+   return now;
+}
+
+} // namespace
+
+void TimerWheelTest::test_Expire_TimersInAllLevels_ExpiringExactlyInTime()
+{
+   const uint32_t start       = 1000u;
+   const uint32_t timeouts[]  = {0u, 1u, 63u, 64u, 65u, 4095u, 4096u, 100000u, 300000u};
+
+   for (uint32_t timeout : timeouts) {
+      TimerWheel         wheel;
+      TimerWheel::Timer *t = wheel.add(nullptr, start, timeout, false);
+      CPPUNIT_ASSERT_EQUAL_MESSAGE("Timer expired at wrong time", start + timeout,
+                                   runUntilExpired(wheel, start, t->m_ref, timeout + 1u));
+   }
+}
+
+void TimerWheelTest::test_Expire_TimerBeyondWheelRange_ExpiringExactlyInTime()
+{
+   const uint32_t timeout = (1u << (TimerWheel::LEVEL_BITS * TimerWheel::NUM_LEVELS)) + 12345u;
+   TimerWheel     wheel;
+
+   TimerWheel::Timer *t = wheel.add(nullptr, 0u, timeout, false);
+   CPPUNIT_ASSERT_MESSAGE("Timer expired too early", wheel.expire(timeout - 1u) == nullptr);
+   TimerWheel::Timer *expired = wheel.expire(timeout);
+   CPPUNIT_ASSERT_MESSAGE("Timer did not expire", expired == t);
+}
+
+void TimerWheelTest::test_Expire_TickCounterWrapsAround_ExpiringExactlyInTime()
+{
+   const uint32_t start = 0xFFFFFF00u;
+   TimerWheel     wheel;
+
+   TimerWheel::Timer *t = wheel.add(nullptr, start, 1000u, false);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Timer expired at wrong time", start + 1000u,
+                                runUntilExpired(wheel, start, t->m_ref, 1001u));
+}
+
+void TimerWheelTest::test_Find_RemovedTimer_ExpectingNullReturned()
+{
+   TimerWheel wheel;
+
+   TimerRef_t ref = wheel.add(nullptr, 0u, 100u, false)->m_ref;
+   CPPUNIT_ASSERT_MESSAGE("Armed timer not found", wheel.find(ref) != nullptr);
+   wheel.remove(wheel.find(ref));
+   CPPUNIT_ASSERT_MESSAGE("Removed timer found", wheel.find(ref) == nullptr);
+
+   TimerRef_t newRef = wheel.add(nullptr, 0u, 100u, false)->m_ref;
+   CPPUNIT_ASSERT_MESSAGE("Reference reused", ref != newRef);
+   CPPUNIT_ASSERT_MESSAGE("Stale reference found", wheel.find(ref) == nullptr);
+   CPPUNIT_ASSERT_MESSAGE("Monitor reference accepted", wheel.find(newRef & ~1u) == nullptr);
+}
+
+void TimerWheelTest::test_Cancel_ArmedTimer_NeverExpiring()
+{
+   TimerWheel wheel;
+
+   TimerWheel::Timer *t = wheel.add(nullptr, 0u, 10u, false);
+   wheel.cancel(t);
+   CPPUNIT_ASSERT_MESSAGE("Cancelled timer still armed", !t->isArmed());
+   CPPUNIT_ASSERT_MESSAGE("Wheel not empty", wheel.empty());
+   CPPUNIT_ASSERT_MESSAGE("Cancelled timer expired", wheel.expire(100u) == nullptr);
+   wheel.remove(t);
+}
+
+void TimerWheelTest::test_NextTimeout_WithAndWithoutTimers_ExpectingNotLaterThanNextExpiry()
+{
+   TimerWheel wheel;
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Timeout without timers", 0u, wheel.nextTimeout(0u));
+
+   wheel.add(nullptr, 0u, 5000u, false);
+   uint32_t timeout = wheel.nextTimeout(0u);
+   CPPUNIT_ASSERT_MESSAGE("Timeout out of range", timeout > 0u && timeout <= 5000u);
+
+   wheel.add(nullptr, 0u, 20u, false);
+   CPPUNIT_ASSERT_EQUAL_MESSAGE("Earlier timer not considered", 20u, wheel.nextTimeout(0u));
+}
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TimerWheelTest);
+
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
@@ -0,0 +1,83 @@
+//////////////////////////////////////////////////////////////////////
+/// @file TimerWheelTest.hpp
+/// @brief Header file for Unit Tests to test TimerWheel
+///
+/// Copyright (c) Preh Car Connect GmbH
+/// CONFIDENTIAL
+//////////////////////////////////////////////////////////////////////
+
+#ifndef TSD_COMMUNICATION_MESSAGING_TIMERWHEELTEST_HPP
+#define TSD_COMMUNICATION_MESSAGING_TIMERWHEELTEST_HPP
+
+#include <cppunit/extensions/HelperMacros.h>
+
+namespace tsd {
+namespace communication {
+namespace messaging {
+
+/**
+ * Testclass for TimerWheel
+ *
+ * @brief Testclass for TimerWheel
+ */
+class TimerWheelTest : public CPPUNIT_NS::TestFixture
+{
+public:
+   /**
+    * @brief Test scenario: timers in all levels of the wheel
+    *
+    * @tsd_testobject tsd::communication::messaging::TimerWheel::Expire
+    * @tsd_testexpected every timer expires exactly at its expiry time
+    */
+   void test_Expire_TimersInAllLevels_ExpiringExactlyInTime();
+   /**
+    * @brief Test scenario: timer beyond wheel range
+    *
+    * @tsd_testobject tsd::communication::messaging::TimerWheel::Expire
+    * @tsd_testexpected timer expires exactly at its expiry time
+    */
+   void test_Expire_TimerBeyondWheelRange_ExpiringExactlyInTime();
+   /**
+    * @brief Test scenario: tick counter wraps around while timer is armed
+    *
+    * @tsd_testobject tsd::communication::messaging::TimerWheel::Expire
+    * @tsd_testexpected timer expires exactly at its expiry time
+    */
+   void test_Expire_TickCounterWrapsAround_ExpiringExactlyInTime();
+   /**
+    * @brief Test scenario: look up removed timer
+    *
+    * @tsd_testobject tsd::communication::messaging::TimerWheel::Find
+    * @tsd_testexpected stale reference rejected even if the entry is reused
+    */
+   void test_Find_RemovedTimer_ExpectingNullReturned();
+   /**
+    * @brief Test scenario: cancel armed timer
+    *
+    * @tsd_testobject tsd::communication::messaging::TimerWheel::Cancel
+    * @tsd_testexpected timer never expires
+    */
+   void test_Cancel_ArmedTimer_NeverExpiring();
+   /**
+    * @brief Test scenario: query next timeout
+    *
+    * @tsd_testobject tsd::communication::messaging::TimerWheel::NextTimeout
+    * @tsd_testexpected zero without timers, never later than the next expiry
+    */
+   void test_NextTimeout_WithAndWithoutTimers_ExpectingNotLaterThanNextExpiry();
+
+   CPPUNIT_TEST_SUITE(TimerWheelTest);
+   CPPUNIT_TEST(test_Expire_TimersInAllLevels_ExpiringExactlyInTime);
+   CPPUNIT_TEST(test_Expire_TimerBeyondWheelRange_ExpiringExactlyInTime);
+   CPPUNIT_TEST(test_Expire_TickCounterWrapsAround_ExpiringExactlyInTime);
+   CPPUNIT_TEST(test_Find_RemovedTimer_ExpectingNullReturned);
+   CPPUNIT_TEST(test_Cancel_ArmedTimer_NeverExpiring);
+   CPPUNIT_TEST(test_NextTimeout_WithAndWithoutTimers_ExpectingNotLaterThanNextExpiry);
+   CPPUNIT_TEST_SUITE_END();
+};
+
+} // namespace messaging
+} // namespace communication
+} // namespace tsd
+
+#endif // TSD_COMMUNICATION_MESSAGING_TIMERWHEELTEST_HPP